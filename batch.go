@@ -0,0 +1,162 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"os"
+	"syscall"
+)
+
+// BatchItem describes one container launched by RunBatch.
+type BatchItem struct {
+	ID        string
+	Spec      *ContainerSpec
+	IO        *IOConfig     // nil behaves as an empty IOConfig
+	Overrides *RunOverrides // optional, see RunWithOverrides
+}
+
+// BatchResult is the outcome of one BatchItem. Exactly one of Result and Err
+// is set.
+type BatchResult struct {
+	Result *RunResult
+	Err    error
+}
+
+// RunBatch launches several containers like RunWithIO, in a single cgo call.
+//
+// The pipes of all items are created and every child is forked in one pass;
+// the setup handshakes are then collected while the children finish their
+// setup concurrently. This amortizes the per-launch cgo and scheduling cost
+// for bursts of containers.
+//
+// Results are returned in the order of items. A failing item does not stop
+// the others. Items whose IOConfig selects a Launcher or Spawn, or whose
+// spec has an overlay rootfs (WithOverlayRootfs), are launched individually
+// through RunWithIO.
+func (x *RuntimeContext) RunBatch(items []BatchItem) []BatchResult {
+	results := make([]BatchResult, len(items))
+	if len(items) == 0 {
+		return results
+	}
+	if x == nil || x.c == nil {
+		for i := range results {
+			results[i].Err = errors.New("libcrun: invalid runtime context or container spec")
+		}
+		return results
+	}
+
+	handler := x.effectiveLogHandler()
+	cItems := make([]C.struct_go_crun_batch_item, 0, len(items))
+	covs := make([]cOverrides, 0, len(items))
+	var passFiles []*os.File            // passthrough duplicates, closed once launched
+	index := make([]int, 0, len(items)) // cItems position -> items position
+	ioCfgs := make([]*IOConfig, len(items))
+
+	for i, item := range items {
+		ioCfg := item.IO
+		if ioCfg == nil {
+			ioCfg = &IOConfig{}
+		}
+		ioCfgs[i] = ioCfg
+
+		if ioCfg.Launcher != nil || ioCfg.Spawn || item.Spec.overlayRootfs() != nil {
+			results[i].Result, results[i].Err = x.runWithIO(item.ID, item.Spec, item.Overrides, ioCfg)
+			continue
+		}
+		if item.Spec == nil || item.Spec.c == nil {
+			results[i].Err = errors.New("libcrun: invalid runtime context or container spec")
+			continue
+		}
+		c, err := x.acquireLaunchContext(item.ID, item.Spec, true)
+		if err != nil {
+			results[i].Err = err
+			continue
+		}
+
+		var want C.int
+		pass := [3]C.int{-1, -1, -1}
+		stdout, stderr := ioCfg.outputs()
+		streams := [3]struct {
+			v   any
+			bit C.int
+		}{
+			{ioCfg.Stdin, C.GO_CRUN_BATCH_STDIN},
+			{stdout, C.GO_CRUN_BATCH_STDOUT},
+			{stderr, C.GO_CRUN_BATCH_STDERR},
+		}
+		for k, st := range streams {
+			if st.v == nil {
+				continue
+			}
+			if f := passthroughFile(st.v); f != nil {
+				passFiles = append(passFiles, f)
+				pass[k] = C.int(f.Fd())
+				continue
+			}
+			want |= st.bit
+		}
+		if handler != nil {
+			want |= C.GO_CRUN_BATCH_LOG
+		}
+		cov := item.Overrides.toC(x.childVerbosity())
+		covs = append(covs, cov)
+		cItems = append(cItems, C.struct_go_crun_batch_item{
+			ctx:       c,
+			container: item.Spec.c,
+			overrides: cov.c,
+			flags:     runFlags(RunOptions{}),
+			want_fds:  want,
+			pass_fds:  pass,
+		})
+		index = append(index, i)
+	}
+
+	if len(cItems) > 0 {
+		C.go_crun_run_batch(&cItems[0], C.int(len(cItems)))
+	}
+	for _, f := range passFiles {
+		f.Close()
+	}
+
+	for k := range cItems {
+		ci := &cItems[k]
+		i := index[k]
+		x.releaseContext(ci.ctx)
+		covs[k].free()
+
+		if ci.err != nil {
+			results[i].Err = fromLibcrunErr(&ci.err)
+			x.cgroupLaunchDone(items[i].ID)
+			continue
+		}
+		stdinW := fileFromFd(ci.stdin_fd, "stdin")
+		stdoutR := fileFromFd(ci.stdout_fd, "stdout")
+		stderrR := fileFromFd(ci.stderr_fd, "stderr")
+		logR := fileFromFd(ci.log_fd, "log")
+		// Resizing a pipe after the child holds the other end is fine:
+		// F_SETPIPE_SZ applies to the shared pipe buffer.
+		for _, f := range []*os.File{stdinW, stdoutR, stderrR} {
+			resizePipe(f, ioCfgs[i].PipeSize)
+		}
+		results[i].Result = x.startRunIO(items[i].ID, ioCfgs[i], handler,
+			stdinW, stdoutR, stderrR, logR, ci.pid)
+		x.indexLaunchIO(items[i].ID, results[i].Result)
+		x.cgroupLaunchedIO(items[i].ID, results[i].Result)
+	}
+	return results
+}
+
+// fileFromFd wraps a C-created pipe end, or returns nil for -1. The fd is
+// made nonblocking so that, as with os.Pipe, it is served by the netpoller.
+func fileFromFd(fd C.int, name string) *os.File {
+	if fd < 0 {
+		return nil
+	}
+	_ = syscall.SetNonblock(int(fd), true)
+	return os.NewFile(uintptr(fd), name)
+}
@@ -0,0 +1,45 @@
+//go:build linux && cgo
+
+package crun
+
+import "testing"
+
+func TestRunBatchEmpty(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+
+	if got := rc.RunBatch(nil); len(got) != 0 {
+		t.Errorf("RunBatch(nil) returned %d results", len(got))
+	}
+}
+
+func TestRunBatchInvalidItems(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+
+	results := rc.RunBatch([]BatchItem{
+		{ID: "a"},
+		{ID: "b", Spec: &ContainerSpec{}},
+	})
+	if len(results) != 2 {
+		t.Fatalf("got %d results, want 2", len(results))
+	}
+	for i, r := range results {
+		if r.Err == nil || r.Result != nil {
+			t.Errorf("item %d: want error only, got %+v", i, r)
+		}
+	}
+
+	var nilRC *RuntimeContext
+	for i, r := range nilRC.RunBatch([]BatchItem{{ID: "c"}}) {
+		if r.Err == nil {
+			t.Errorf("item %d: nil context should fail", i)
+		}
+	}
+}
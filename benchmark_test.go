@@ -3,14 +3,24 @@
 package crun
 
 import (
+	"context"
 	"encoding/json"
+	"errors"
 	"fmt"
+	"io"
+	"math/bits"
 	"os"
 	"os/exec"
 	"path/filepath"
+	"runtime"
+	"strconv"
+	"strings"
 	"sync"
+	"sync/atomic"
+	"syscall"
 	"testing"
 	"time"
+	"unsafe"
 
 	"github.com/opencontainers/runtime-spec/specs-go"
 )
@@ -38,77 +48,998 @@ func BenchmarkContainerThroughput(b *testing.B) {
 	}
 	defer rc.Close()
 
+	launcher, err := NewLauncher(16)
+	if err != nil {
+		b.Fatalf("Failed to create launcher: %v", err)
+	}
+	defer launcher.Close()
+
+	// Simulate a large-heap host: fork cost grows with the parent's
+	// address space, spawn and launcher cost do not
+	ballast := benchHeapBallast(b)
+	defer runtime.KeepAlive(ballast)
+
+	strategies := []struct {
+		name string
+		io   IOConfig
+	}{
+		{"fork", IOConfig{}},
+		{"spawn", IOConfig{Spawn: true}},
+		{"launcher", IOConfig{Launcher: launcher}},
+	}
+
 	durations := []time.Duration{1 * time.Second, 5 * time.Second}
 	parallelisms := []int{1, 4, 8, 16}
 
-	for _, duration := range durations {
-		for _, parallelism := range parallelisms {
-			name := fmt.Sprintf("P%d_T%ds", parallelism, int(duration.Seconds()))
-			b.Run(name, func(b *testing.B) {
+	for _, strategy := range strategies {
+		for _, duration := range durations {
+			for _, parallelism := range parallelisms {
+				name := fmt.Sprintf("%s/P%d_T%ds", strategy.name, parallelism, int(duration.Seconds()))
+				ioCfg := strategy.io
+				b.Run(name, func(b *testing.B) {
+					for n := 0; n < b.N; n++ {
+						var (
+							completed int64
+							failed    int64
+							mu        sync.Mutex
+							wg        sync.WaitGroup
+						)
+
+						done := make(chan struct{})
+						time.AfterFunc(duration, func() { close(done) })
+
+						for w := 0; w < parallelism; w++ {
+							wg.Add(1)
+							go func(workerID int) {
+								defer wg.Done()
+								localCompleted := 0
+								localFailed := 0
+
+								for i := 0; ; i++ {
+									select {
+									case <-done:
+										mu.Lock()
+										completed += int64(localCompleted)
+										failed += int64(localFailed)
+										mu.Unlock()
+										return
+									default:
+									}
+
+									containerID := fmt.Sprintf("tp-%d-%d", workerID, i)
+									spec, err := NewSpec(false,
+										WithRootPath(rootfs),
+										WithContainerTTY(false),
+										WithArgs("/bin/true"),
+									)
+									if err != nil {
+										localFailed++
+										continue
+									}
+
+									cfg := ioCfg
+									result, err := rc.RunWithIO(containerID, spec, &cfg)
+									if err != nil {
+										spec.Close()
+										localFailed++
+										continue
+									}
+
+									_, _ = result.Wait()
+									localCompleted++
+									_ = result.Container.Delete(true)
+									spec.Close()
+								}
+							}(w)
+						}
+
+						wg.Wait()
+
+						rate := float64(completed) / duration.Seconds()
+						b.ReportMetric(rate, "containers/s")
+						b.ReportMetric(float64(failed), "failed")
+					}
+				})
+			}
+		}
+	}
+}
+
+// BenchmarkBurstStart measures starting a burst of containers at once, one
+// RunWithIO per container versus a single RunBatch.
+// Run with: make benchmark
+func BenchmarkBurstStart(b *testing.B) {
+	if os.Getuid() != 0 {
+		b.Skip("Benchmark requires root privileges")
+	}
+
+	rootfs := os.Getenv("TEST_ROOTFS")
+	if rootfs == "" {
+		rootfs = "/tmp/test-rootfs"
+	}
+	if _, err := os.Stat(rootfs); os.IsNotExist(err) {
+		b.Skip("No test rootfs found. Set TEST_ROOTFS env var or create /tmp/test-rootfs with busybox")
+	}
+
+	rc, err := NewRuntimeContext(RuntimeConfig{
+		StateRoot: b.TempDir(),
+	})
+	if err != nil {
+		b.Fatalf("Failed to create runtime context: %v", err)
+	}
+	defer rc.Close()
+
+	for _, burst := range []int{16, 64, 256} {
+		for _, mode := range []string{"RunWithIO", "RunBatch"} {
+			b.Run(fmt.Sprintf("%s/N%d", mode, burst), func(b *testing.B) {
 				for n := 0; n < b.N; n++ {
-					var (
-						completed int64
-						failed    int64
-						mu        sync.Mutex
-						wg        sync.WaitGroup
-					)
+					items := make([]BatchItem, burst)
+					for i := range items {
+						spec, err := NewSpec(false,
+							WithRootPath(rootfs),
+							WithContainerTTY(false),
+							WithArgs("/bin/true"),
+						)
+						if err != nil {
+							b.Fatalf("Failed to create spec: %v", err)
+						}
+						items[i] = BatchItem{ID: fmt.Sprintf("burst-%d-%d", n, i), Spec: spec}
+					}
+
+					start := time.Now()
+					var results []BatchResult
+					if mode == "RunBatch" {
+						results = rc.RunBatch(items)
+					} else {
+						results = make([]BatchResult, burst)
+						for i, item := range items {
+							results[i].Result, results[i].Err = rc.RunWithIO(item.ID, item.Spec, &IOConfig{})
+						}
+					}
+					elapsed := time.Since(start)
+
+					failed := 0
+					for i, r := range results {
+						if r.Err != nil {
+							failed++
+						} else {
+							_, _ = r.Result.Wait()
+							_ = r.Result.Container.Delete(true)
+						}
+						items[i].Spec.Close()
+					}
+
+					b.ReportMetric(float64(burst)/elapsed.Seconds(), "launches/s")
+					b.ReportMetric(float64(failed), "failed")
+				}
+			})
+		}
+	}
+}
+
+// BenchmarkCgroupManager compares the create/delete throughput of the
+// cgroupfs and systemd cgroup managers, the latter with containers in a
+// slice of their own prepared up front (PrepareSlices) or left to systemd.
+// Needs systemd for the systemd cases. Run with: make benchmark
+func BenchmarkCgroupManager(b *testing.B) {
+	if os.Getuid() != 0 {
+		b.Skip("Benchmark requires root privileges")
+	}
+
+	rootfs := os.Getenv("TEST_ROOTFS")
+	if rootfs == "" {
+		rootfs = "/tmp/test-rootfs"
+	}
+	if _, err := os.Stat(rootfs); os.IsNotExist(err) {
+		b.Skip("No test rootfs found. Set TEST_ROOTFS env var or create /tmp/test-rootfs with busybox")
+	}
+	_, err := os.Stat("/run/systemd/system")
+	haveSystemd := err == nil
+
+	managers := []struct {
+		name    string
+		systemd bool
+		slice   string // cgroupsPath slice, "" for the default
+		prepare bool
+	}{
+		{"cgroupfs", false, "", false},
+		{"systemd", true, "", false},
+		{"systemd-slice", true, "libcrun-bench.slice", false},
+		{"systemd-prepared-slice", true, "libcrun-bench-prepared.slice", true},
+	}
+	for _, m := range managers {
+		for _, parallelism := range []int{1, 8} {
+			b.Run(fmt.Sprintf("%s/P%d", m.name, parallelism), func(b *testing.B) {
+				if m.systemd && !haveSystemd {
+					b.Skip("systemd is not running")
+				}
+				rc, err := NewRuntimeContext(RuntimeConfig{
+					StateRoot:     b.TempDir(),
+					SystemdCgroup: m.systemd,
+				})
+				if err != nil {
+					b.Fatalf("Failed to create runtime context: %v", err)
+				}
+				defer rc.Close()
+				if m.prepare {
+					if err := rc.PrepareSlices(m.slice); err != nil {
+						b.Fatalf("PrepareSlices failed: %v", err)
+					}
+				}
+
+				var seq, failed atomic.Int64
+				start := time.Now()
+				var wg sync.WaitGroup
+				per := (b.N + parallelism - 1) / parallelism
+				for w := 0; w < parallelism; w++ {
+					wg.Add(1)
+					go func() {
+						defer wg.Done()
+						for i := 0; i < per; i++ {
+							id := fmt.Sprintf("cgm-%d", seq.Add(1))
+							opts := []SpecOption{WithRootPath(rootfs), WithContainerTTY(false), WithArgs("/bin/true")}
+							if m.slice != "" {
+								opts = append(opts, WithCgroupsPath(m.slice+":crun:"+id))
+							}
+							spec, err := NewSpec(false, opts...)
+							if err != nil {
+								failed.Add(1)
+								continue
+							}
+							ctr, err := rc.Create(id, spec, CreateOptions{})
+							spec.Close()
+							if err != nil {
+								failed.Add(1)
+								continue
+							}
+							_ = ctr.Delete(true)
+						}
+					}()
+				}
+				wg.Wait()
+				elapsed := time.Since(start)
+				b.ReportMetric(float64(per*parallelism)/elapsed.Seconds(), "containers/s")
+				b.ReportMetric(float64(failed.Load()), "failed")
+			})
+		}
+	}
+}
+
+// BenchmarkFeatureCost measures what each isolation feature adds to the
+// start of a /bin/true container: every case is the baseline spec with
+// one feature toggled, and reports its p50 latency (create to exit and
+// delete) and the delta against the baseline's. The baseline is NewSpec's
+// default: rootful, its own namespaces (network included), no seccomp
+// profile, no resource limits, pivot_root. Set BENCH_FEATURES_JSON to a
+// file path to save the results. Run with: make benchmark
+func BenchmarkFeatureCost(b *testing.B) {
+	if os.Getuid() != 0 {
+		b.Skip("Benchmark requires root privileges")
+	}
+
+	rootfs := os.Getenv("TEST_ROOTFS")
+	if rootfs == "" {
+		rootfs = "/tmp/test-rootfs"
+	}
+	if _, err := os.Stat(rootfs); os.IsNotExist(err) {
+		b.Skip("No test rootfs found. Set TEST_ROOTFS env var or create /tmp/test-rootfs with busybox")
+	}
+
+	// A profile of the size of a runtime's default one: allow by default,
+	// deny a few dozen syscalls
+	seccomp := func(sp *specs.Spec) {
+		denied := []string{"acct", "add_key", "bpf", "clock_adjtime", "clock_settime", "create_module",
+			"delete_module", "finit_module", "get_kernel_syms", "get_mempolicy", "init_module", "ioperm",
+			"iopl", "kcmp", "kexec_file_load", "kexec_load", "keyctl", "lookup_dcookie", "mbind", "mount",
+			"move_pages", "nfsservctl", "open_by_handle_at", "perf_event_open", "personality", "pivot_root",
+			"process_vm_readv", "process_vm_writev", "ptrace", "query_module", "quotactl", "reboot",
+			"request_key", "set_mempolicy", "setns", "settimeofday", "stime", "swapoff", "swapon", "sysfs",
+			"umount", "umount2", "unshare", "uselib", "userfaultfd", "ustat", "vm86", "vm86old"}
+		sp.Linux.Seccomp = &specs.LinuxSeccomp{
+			DefaultAction: specs.ActAllow,
+			Syscalls:      []specs.LinuxSyscall{{Names: denied, Action: specs.ActErrno}},
+		}
+	}
+	limits := []SpecOption{WithMemoryLimit(256 << 20), WithPidsLimit(64), WithCPUQuota(50000)}
+	var mounts []SpecOption
+	for i := 0; i < 8; i++ {
+		mounts = append(mounts, WithMount("tmpfs", fmt.Sprintf("/tmp/bench-%d", i), "tmpfs", []string{"size=1m"}))
+	}
+
+	features := []struct {
+		name     string
+		rootless bool // NewSpec's rootless spec: a user namespace mapping root
+		opts     []SpecOption
+		cfg      func(*RuntimeConfig)
+	}{
+		{name: "baseline"},
+		{name: "host-network", opts: []SpecOption{WithHostNetwork()}},
+		{name: "seccomp", opts: []SpecOption{seccomp}},
+		{name: "cgroup-limits", opts: limits},
+		{name: "no-cgroup", cfg: func(c *RuntimeConfig) { c.ForceNoCgroup = true }},
+		{name: "userns", rootless: true},
+		{name: "no-pivot", cfg: func(c *RuntimeConfig) { c.NoPivot = true }},
+		{name: "mounts-8", opts: mounts},
+	}
+
+	results := make(map[string]phaseSummary, len(features))
+	var baseline uint64
+	for _, f := range features {
+		b.Run(f.name, func(b *testing.B) {
+			cfg := RuntimeConfig{StateRoot: b.TempDir()}
+			if f.cfg != nil {
+				f.cfg(&cfg)
+			}
+			rc, err := NewRuntimeContext(cfg)
+			if err != nil {
+				b.Fatalf("Failed to create runtime context: %v", err)
+			}
+			defer rc.Close()
+			opts := append([]SpecOption{WithRootPath(rootfs), WithContainerTTY(false), WithArgs("/bin/true")}, f.opts...)
+
+			var hist phaseHistogram
+			failed := 0
+			for n := 0; n < b.N; n++ {
+				spec, err := NewSpec(f.rootless, opts...)
+				if err != nil {
+					b.Fatalf("Failed to create spec: %v", err)
+				}
+				start := time.Now()
+				res, err := rc.RunWithIO(fmt.Sprintf("feat-%s-%d", f.name, n), spec, &IOConfig{})
+				if err == nil {
+					var code int
+					code, err = res.Wait()
+					_ = res.Container.Delete(true)
+					if err == nil && code != 0 {
+						err = fmt.Errorf("exit code %d", code)
+					}
+				}
+				hist.record(time.Since(start))
+				spec.Close()
+				if err != nil {
+					if failed == 0 {
+						b.Logf("%s: %v", f.name, err)
+					}
+					failed++
+				}
+			}
+
+			s := hist.summary()
+			b.ReportMetric(float64(s.P50)/1e3, "p50-us")
+			b.ReportMetric(float64(s.P99)/1e3, "p99-us")
+			if f.name == "baseline" {
+				baseline = s.P50
+			} else if baseline > 0 {
+				b.ReportMetric((float64(s.P50)-float64(baseline))/1e3, "delta-p50-us")
+			}
+			b.ReportMetric(float64(failed), "failed")
+			results[f.name] = s
+		})
+	}
+
+	if path := os.Getenv("BENCH_FEATURES_JSON"); path != "" {
+		out, err := json.MarshalIndent(results, "", "  ")
+		if err != nil {
+			b.Fatalf("Marshal failed: %v", err)
+		}
+		if err := os.WriteFile(path, out, 0o644); err != nil {
+			b.Fatalf("WriteFile failed: %v", err)
+		}
+	}
+}
+
+// BenchmarkWasmStart compares the start of a Wasm function under the spin
+// handler with the plain RunWithIO start of a /bin/true container. It is
+// timed from the launch to spin's "Serving" line, once the module is
+// compiled or loaded: "wasm-cold" gives each launch an empty module cache,
+// so it compiles every time, and "wasm-cached" shares one cache, warmed
+// before the timing, so it compiles only once. Needs the spin CLI at
+// /usr/local/bin/spin and BENCH_WASM_ROOTFS, a rootfs holding a spin.toml
+// app at its root. Run with: make benchmark
+func BenchmarkWasmStart(b *testing.B) {
+	if os.Getuid() != 0 {
+		b.Skip("Benchmark requires root privileges")
+	}
+
+	rootfs := os.Getenv("TEST_ROOTFS")
+	if rootfs == "" {
+		rootfs = "/tmp/test-rootfs"
+	}
+	if _, err := os.Stat(rootfs); os.IsNotExist(err) {
+		b.Skip("No test rootfs found. Set TEST_ROOTFS env var or create /tmp/test-rootfs with busybox")
+	}
+	wasmRootfs := os.Getenv("BENCH_WASM_ROOTFS")
+	if wasmRootfs == "" {
+		b.Skip("Set BENCH_WASM_ROOTFS to a rootfs with a spin app to run the Wasm benchmark")
+	}
+	if _, err := os.Stat("/usr/local/bin/spin"); err != nil {
+		b.Skip("The spin handler needs the spin CLI at /usr/local/bin/spin")
+	}
+
+	b.Run("plain", func(b *testing.B) {
+		rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: b.TempDir()})
+		if err != nil {
+			b.Fatalf("Failed to create runtime context: %v", err)
+		}
+		defer rc.Close()
+		spec, err := NewSpec(false, WithRootPath(rootfs), WithContainerTTY(false), WithArgs("/bin/true"))
+		if err != nil {
+			b.Fatalf("Failed to create spec: %v", err)
+		}
+		defer spec.Close()
+		for n := 0; n < b.N; n++ {
+			res, err := rc.RunWithIO(fmt.Sprintf("plain-%d", n), spec, &IOConfig{})
+			if err != nil {
+				b.Fatalf("RunWithIO failed: %v", err)
+			}
+			_, _ = res.Wait()
+			_ = res.Container.Delete(true)
+		}
+	})
+
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: b.TempDir(), Handler: "spin"})
+	if err != nil {
+		b.Fatalf("Failed to create runtime context: %v", err)
+	}
+	defer rc.Close()
+	// serve starts the app with the module cache in dir and returns once
+	// it serves
+	serve := func(b *testing.B, id, dir string) {
+		spec, err := NewSpec(false, WithRootPath(wasmRootfs), WithContainerTTY(false), WithArgs("/"), WithWasmModuleCache(dir))
+		if err != nil {
+			b.Fatalf("Failed to create spec: %v", err)
+		}
+		defer spec.Close()
+		ready := make(chan struct{})
+		res, err := rc.RunWithIO(id, spec, &IOConfig{Stdout: &lineSignal{line: "Serving", ch: ready}, Stderr: io.Discard})
+		if err != nil {
+			b.Fatalf("RunWithIO failed: %v", err)
+		}
+		exited := make(chan struct{})
+		go func() {
+			_, _ = res.Wait()
+			close(exited)
+		}()
+		select {
+		case <-ready:
+		case <-exited:
+			_ = res.Container.Delete(true)
+			b.Fatalf("%s exited before serving", id)
+		}
+		b.StopTimer()
+		_ = res.Container.Kill(SIGKILL)
+		<-exited
+		_ = res.Container.Delete(true)
+		b.StartTimer()
+	}
+
+	b.Run("wasm-cold", func(b *testing.B) {
+		for n := 0; n < b.N; n++ {
+			b.StopTimer()
+			dir := b.TempDir()
+			b.StartTimer()
+			serve(b, fmt.Sprintf("wasm-cold-%d", n), dir)
+		}
+	})
+
+	b.Run("wasm-cached", func(b *testing.B) {
+		dir := b.TempDir()
+		serve(b, "wasm-warmup", dir)
+		b.ResetTimer()
+		for n := 0; n < b.N; n++ {
+			serve(b, fmt.Sprintf("wasm-cached-%d", n), dir)
+		}
+	})
+}
 
+// BenchmarkSnapshotStart compares a cold start, where each instance runs
+// its warm-up, with restoring instances from a golden snapshot taken after
+// the warm-up. Needs CRIU. Run with: make benchmark
+func BenchmarkSnapshotStart(b *testing.B) {
+	if os.Getuid() != 0 {
+		b.Skip("Benchmark requires root privileges")
+	}
+
+	rootfs := os.Getenv("TEST_ROOTFS")
+	if rootfs == "" {
+		rootfs = "/tmp/test-rootfs"
+	}
+	if _, err := os.Stat(rootfs); os.IsNotExist(err) {
+		b.Skip("No test rootfs found. Set TEST_ROOTFS env var or create /tmp/test-rootfs with busybox")
+	}
+
+	rc, err := NewRuntimeContext(RuntimeConfig{
+		StateRoot: b.TempDir(),
+	})
+	if err != nil {
+		b.Fatalf("Failed to create runtime context: %v", err)
+	}
+	defer rc.Close()
+
+	// The "function": a busy warm-up loop, then it serves one request
+	// read from stdin
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", `i=0; while [ $i -lt 200000 ]; do i=$((i+1)); done; echo warm; read req; echo "done $req"`),
+	)
+	if err != nil {
+		b.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	b.Run("cold", func(b *testing.B) {
+		for n := 0; n < b.N; n++ {
+			res, err := rc.RunWithIO(fmt.Sprintf("cold-%d", n), spec, &IOConfig{Stdin: strings.NewReader("x\n"), Stdout: io.Discard})
+			if err != nil {
+				b.Fatalf("RunWithIO failed: %v", err)
+			}
+			_, _ = res.Wait()
+			_ = res.Container.Delete(true)
+		}
+	})
+
+	// Template: boot once, wait for the warm-up, snapshot it
+	stdinR, stdinW := io.Pipe()
+	defer stdinW.Close()
+	warm := make(chan struct{})
+	tmpl, err := rc.RunWithIO("snapshot-template", spec, &IOConfig{Stdin: stdinR, Stdout: &lineSignal{line: "warm", ch: warm}})
+	if err != nil {
+		b.Fatalf("RunWithIO failed: %v", err)
+	}
+	defer func() {
+		_ = tmpl.Container.Kill(SIGKILL)
+		_, _ = tmpl.Wait()
+		_ = tmpl.Container.Delete(true)
+	}()
+	<-warm
+	snap, err := tmpl.Container.Snapshot(filepath.Join(b.TempDir(), "golden"))
+	if err != nil {
+		b.Skipf("Snapshot failed (CRIU available?): %v", err)
+	}
+
+	b.Run("snapshot", func(b *testing.B) {
+		for n := 0; n < b.N; n++ {
+			res, err := rc.StartFromSnapshot(fmt.Sprintf("snap-%d", n), snap, &IOConfig{Stdin: strings.NewReader("x\n"), Stdout: io.Discard})
+			if err != nil {
+				b.Fatalf("StartFromSnapshot failed: %v", err)
+			}
+			_, _ = res.Wait()
+			_ = res.Container.Delete(true)
+		}
+	})
+}
+
+// lineSignal closes ch the first time line is written.
+type lineSignal struct {
+	line string
+	ch   chan struct{}
+	once sync.Once
+}
+
+func (w *lineSignal) Write(p []byte) (int, error) {
+	if strings.Contains(string(p), w.line) {
+		w.once.Do(func() { close(w.ch) })
+	}
+	return len(p), nil
+}
+
+// BenchmarkProbe compares the cost of a readiness check run by ExecWithIO
+// with Probe.Exec, and with a Probe.TCP connect, in a running container.
+// Besides the latency it reports the CPU time of this process and its
+// children per check, the cost a node pays for every probe.
+// Run with: make benchmark
+func BenchmarkProbe(b *testing.B) {
+	if os.Getuid() != 0 {
+		b.Skip("Benchmark requires root privileges")
+	}
+
+	rootfs := os.Getenv("TEST_ROOTFS")
+	if rootfs == "" {
+		rootfs = "/tmp/test-rootfs"
+	}
+	if _, err := os.Stat(rootfs); os.IsNotExist(err) {
+		b.Skip("No test rootfs found. Set TEST_ROOTFS env var or create /tmp/test-rootfs with busybox")
+	}
+
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: b.TempDir()})
+	if err != nil {
+		b.Fatalf("Failed to create runtime context: %v", err)
+	}
+	defer rc.Close()
+
+	// busybox nc serves one connection per start, hence the loop
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "while true; do nc -l -p 8080 </dev/null; done"),
+	)
+	if err != nil {
+		b.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+	res, err := rc.RunWithIO("probe-target", spec, &IOConfig{})
+	if err != nil {
+		b.Fatalf("RunWithIO failed: %v", err)
+	}
+	defer func() {
+		_ = res.Container.Kill(SIGKILL)
+		_, _ = res.Wait()
+		_ = res.Container.Delete(true)
+	}()
+	probe, err := res.Container.Probe()
+	if err != nil {
+		b.Fatalf("Probe failed: %v", err)
+	}
+	defer probe.Close()
+
+	cpuTime := func() time.Duration {
+		var self, children syscall.Rusage
+		_ = syscall.Getrusage(syscall.RUSAGE_SELF, &self)
+		_ = syscall.Getrusage(syscall.RUSAGE_CHILDREN, &children)
+		total := int64(0)
+		for _, ru := range []*syscall.Rusage{&self, &children} {
+			total += ru.Utime.Nano() + ru.Stime.Nano()
+		}
+		return time.Duration(total)
+	}
+	ctx := context.Background()
+	for _, bc := range []struct {
+		name  string
+		check func() error
+	}{
+		{"exec", func() error {
+			r, err := res.Container.ExecWithIO(&specs.Process{Args: []string{"/bin/true"}, Cwd: "/"}, &IOConfig{})
+			if err != nil {
+				return err
+			}
+			_, err = r.Wait()
+			return err
+		}},
+		{"probe-exec", func() error {
+			_, err := probe.Exec(ctx, "/bin/true")
+			return err
+		}},
+		{"probe-tcp", func() error {
+			// The listener may be between two nc runs
+			for i := 0; ; i++ {
+				err := probe.TCP(ctx, ":8080")
+				if !errors.Is(err, syscall.ECONNREFUSED) || i == 1000 {
+					return err
+				}
+			}
+		}},
+	} {
+		b.Run(bc.name, func(b *testing.B) {
+			start := cpuTime()
+			for n := 0; n < b.N; n++ {
+				if err := bc.check(); err != nil {
+					b.Fatalf("check failed: %v", err)
+				}
+			}
+			b.ReportMetric(float64(cpuTime()-start)/float64(b.N), "cpu-ns/op")
+		})
+	}
+}
+
+// BenchmarkLifecyclePhases times each phase of a container's life
+// separately, across the P1..P16 parallelism matrix, and reports
+// p50/p90/p99/max per phase.
+//
+// Two flows are measured. "create" goes through NewSpec, Create, Start,
+// the process exit and Delete. "run" goes through NewSpec, the pipe setup,
+// RunWithIO (fork and child handshake; it sets up its own pipes again),
+// the process exit, which includes libcrun's create and start in the
+// child, and Delete.
+//
+// Set BENCH_PHASES_JSON to a file path to also write the results as JSON,
+// for comparing releases. Run with: make benchmark
+func BenchmarkLifecyclePhases(b *testing.B) {
+	if os.Getuid() != 0 {
+		b.Skip("Benchmark requires root privileges")
+	}
+
+	rootfs := os.Getenv("TEST_ROOTFS")
+	if rootfs == "" {
+		rootfs = "/tmp/test-rootfs"
+	}
+	if _, err := os.Stat(rootfs); os.IsNotExist(err) {
+		b.Skip("No test rootfs found. Set TEST_ROOTFS env var or create /tmp/test-rootfs with busybox")
+	}
+
+	rc, err := NewRuntimeContext(RuntimeConfig{
+		StateRoot: b.TempDir(),
+	})
+	if err != nil {
+		b.Fatalf("Failed to create runtime context: %v", err)
+	}
+	defer rc.Close()
+
+	flows := []struct {
+		name   string
+		phases []string
+		run    func(id string, ph *phaseRecorder) error
+	}{
+		{"create", []string{"spec", "create", "start", "exit", "delete"}, func(id string, ph *phaseRecorder) error {
+			spec, err := NewSpec(false, WithRootPath(rootfs), WithContainerTTY(false), WithArgs("/bin/true"))
+			if err != nil {
+				return err
+			}
+			defer spec.Close()
+			ph.mark("spec")
+			ctr, err := rc.Create(id, spec, CreateOptions{})
+			if err != nil {
+				return err
+			}
+			defer ctr.Delete(true)
+			ph.mark("create")
+			_, pid, _ := ctr.Status()
+			pidfd, _, errno := syscall.Syscall(sysPidfdOpen, uintptr(pid), 0, 0)
+			if errno != 0 {
+				return errno
+			}
+			if err := ctr.Start(); err != nil {
+				syscall.Close(int(pidfd))
+				return err
+			}
+			ph.mark("start")
+			if err := waitPidfd(int(pidfd)); err != nil {
+				return err
+			}
+			ph.mark("exit")
+			if err := ctr.Delete(true); err != nil {
+				return err
+			}
+			ph.mark("delete")
+			return nil
+		}},
+		{"run", []string{"spec", "pipes", "fork_handshake", "exit", "delete"}, func(id string, ph *phaseRecorder) error {
+			spec, err := NewSpec(false, WithRootPath(rootfs), WithContainerTTY(false), WithArgs("/bin/true"))
+			if err != nil {
+				return err
+			}
+			defer spec.Close()
+			ph.mark("spec")
+			ioCfg := &IOConfig{Stdout: io.Discard, Stderr: io.Discard}
+			p, err := openRunPipes(ioCfg, false)
+			if err != nil {
+				return err
+			}
+			p.closeChild()
+			p.closeParent()
+			ph.mark("pipes")
+			res, err := rc.RunWithIO(id, spec, ioCfg)
+			if err != nil {
+				return err
+			}
+			defer res.Container.Delete(true)
+			ph.mark("fork_handshake")
+			if _, err := res.Wait(); err != nil {
+				return err
+			}
+			ph.mark("exit")
+			if err := res.Container.Delete(true); err != nil {
+				return err
+			}
+			ph.mark("delete")
+			return nil
+		}},
+	}
+
+	const duration = time.Second
+	results := map[string]map[string]phaseSummary{}
+
+	for _, flow := range flows {
+		for _, parallelism := range []int{1, 4, 8, 16} {
+			name := fmt.Sprintf("%s/P%d", flow.name, parallelism)
+			b.Run(name, func(b *testing.B) {
+				hists := make(map[string]*phaseHistogram, len(flow.phases))
+				for _, p := range flow.phases {
+					hists[p] = &phaseHistogram{}
+				}
+				var (
+					failed int64
+					mu     sync.Mutex
+					wg     sync.WaitGroup
+				)
+				for n := 0; n < b.N; n++ {
 					done := make(chan struct{})
 					time.AfterFunc(duration, func() { close(done) })
-
 					for w := 0; w < parallelism; w++ {
 						wg.Add(1)
 						go func(workerID int) {
 							defer wg.Done()
-							localCompleted := 0
-							localFailed := 0
-
+							ph := newPhaseRecorder(flow.phases)
+							localFailed := int64(0)
 							for i := 0; ; i++ {
 								select {
 								case <-done:
 									mu.Lock()
-									completed += int64(localCompleted)
-									failed += int64(localFailed)
+									for p, h := range ph.hists {
+										hists[p].merge(h)
+									}
+									failed += localFailed
 									mu.Unlock()
 									return
 								default:
 								}
-
-								containerID := fmt.Sprintf("tp-%d-%d", workerID, i)
-								spec, err := NewSpec(false,
-									WithRootPath(rootfs),
-									WithContainerTTY(false),
-									WithArgs("/bin/true"),
-								)
-								if err != nil {
-									localFailed++
-									continue
-								}
-
-								result, err := rc.RunWithIO(containerID, spec, &IOConfig{})
-								if err != nil {
-									spec.Close()
+								ph.begin()
+								if err := flow.run(fmt.Sprintf("ph-%d-%d-%d", n, workerID, i), ph); err != nil {
 									localFailed++
-									continue
 								}
-
-								_, _ = result.Wait()
-								localCompleted++
-								_ = result.Container.Delete(true)
-								spec.Close()
 							}
 						}(w)
 					}
-
 					wg.Wait()
+				}
 
-					rate := float64(completed) / duration.Seconds()
-					b.ReportMetric(rate, "containers/s")
-					b.ReportMetric(float64(failed), "failed")
+				summary := make(map[string]phaseSummary, len(flow.phases))
+				for _, p := range flow.phases {
+					s := hists[p].summary()
+					summary[p] = s
+					b.ReportMetric(float64(s.P50)/1e3, p+"-p50-us")
+					b.ReportMetric(float64(s.P99)/1e3, p+"-p99-us")
 				}
+				b.ReportMetric(float64(failed), "failed")
+				mu.Lock()
+				results[name] = summary
+				mu.Unlock()
 			})
 		}
 	}
+
+	if path := os.Getenv("BENCH_PHASES_JSON"); path != "" {
+		out, err := json.MarshalIndent(results, "", "  ")
+		if err != nil {
+			b.Fatalf("Marshal failed: %v", err)
+		}
+		if err := os.WriteFile(path, out, 0o644); err != nil {
+			b.Fatalf("WriteFile failed: %v", err)
+		}
+	}
+}
+
+const sysPidfdOpen = 434
+
+// waitPidfd waits until the process of pidfd exits, reaps it if it is our
+// child, and closes pidfd.
+func waitPidfd(pidfd int) error {
+	defer syscall.Close(pidfd)
+	pfd := struct {
+		fd             int32
+		events, revent int16
+	}{fd: int32(pidfd), events: 0x1} // POLLIN
+	for {
+		_, _, errno := syscall.Syscall(syscall.SYS_POLL, uintptr(unsafe.Pointer(&pfd)), 1, ^uintptr(0))
+		if errno == 0 {
+			break
+		}
+		if errno != syscall.EINTR {
+			return errno
+		}
+	}
+	// waitid(P_PIDFD, pidfd, NULL, WEXITED|WNOHANG); ECHILD when the
+	// container init is not our child
+	const pPidfd = 3
+	syscall.Syscall6(syscall.SYS_WAITID, pPidfd, uintptr(pidfd), 0, syscall.WEXITED|syscall.WNOHANG, 0, 0)
+	return nil
+}
+
+// phaseRecorder times consecutive phases of one worker.
+type phaseRecorder struct {
+	last  time.Time
+	hists map[string]*phaseHistogram
+}
+
+func newPhaseRecorder(phases []string) *phaseRecorder {
+	r := &phaseRecorder{hists: make(map[string]*phaseHistogram, len(phases))}
+	for _, p := range phases {
+		r.hists[p] = &phaseHistogram{}
+	}
+	return r
+}
+
+func (r *phaseRecorder) begin() { r.last = time.Now() }
+
+// mark records the time since the previous mark (or begin) for phase.
+func (r *phaseRecorder) mark(phase string) {
+	now := time.Now()
+	r.hists[phase].record(now.Sub(r.last))
+	r.last = now
+}
+
+// phaseHistogram is a log-linear (HDR-style) latency histogram: exact below
+// 32ns, then 16 buckets per power of two, so a reported percentile is
+// within 1/16 of the true value.
+type phaseHistogram struct {
+	counts [32 + 59*16]uint64
+	n      uint64
+	max    uint64
+	sum    uint64
+}
+
+func phaseBucket(v uint64) int {
+	if v < 32 {
+		return int(v)
+	}
+	e := bits.Len64(v) - 5 // v>>e is in [16, 32)
+	return 32 + (e-1)*16 + int(v>>e) - 16
+}
+
+// phaseBucketMax is the largest value mapped to bucket i.
+func phaseBucketMax(i int) uint64 {
+	if i < 32 {
+		return uint64(i)
+	}
+	e := (i-32)/16 + 1
+	return (uint64((i-32)%16+16+1) << e) - 1
+}
+
+func (h *phaseHistogram) record(d time.Duration) {
+	v := uint64(max(d, 0))
+	h.counts[phaseBucket(v)]++
+	h.n++
+	h.sum += v
+	h.max = max(h.max, v)
+}
+
+func (h *phaseHistogram) merge(o *phaseHistogram) {
+	for i, c := range o.counts {
+		h.counts[i] += c
+	}
+	h.n += o.n
+	h.sum += o.sum
+	h.max = max(h.max, o.max)
+}
+
+// percentile returns the upper bound of the bucket holding quantile q.
+func (h *phaseHistogram) percentile(q float64) uint64 {
+	if h.n == 0 {
+		return 0
+	}
+	rank := uint64(q*float64(h.n) + 0.5)
+	rank = min(max(rank, 1), h.n)
+	var seen uint64
+	for i, c := range h.counts {
+		seen += c
+		if seen >= rank {
+			return min(phaseBucketMax(i), h.max)
+		}
+	}
+	return h.max
+}
+
+// phaseSummary is the JSON form of a phaseHistogram, in nanoseconds.
+type phaseSummary struct {
+	Count uint64 `json:"count"`
+	Mean  uint64 `json:"mean_ns"`
+	P50   uint64 `json:"p50_ns"`
+	P90   uint64 `json:"p90_ns"`
+	P99   uint64 `json:"p99_ns"`
+	Max   uint64 `json:"max_ns"`
+}
+
+func (h *phaseHistogram) summary() phaseSummary {
+	s := phaseSummary{Count: h.n, P50: h.percentile(0.50), P90: h.percentile(0.90), P99: h.percentile(0.99), Max: h.max}
+	if h.n > 0 {
+		s.Mean = h.sum / h.n
+	}
+	return s
+}
+
+// benchHeapBallast allocates and touches BENCH_HEAP_MB megabytes (default 0)
+// so the process has a large resident heap while benchmarking.
+func benchHeapBallast(b *testing.B) []byte {
+	mb, _ := strconv.Atoi(os.Getenv("BENCH_HEAP_MB"))
+	if mb <= 0 {
+		return nil
+	}
+	ballast := make([]byte, mb<<20)
+	for i := 0; i < len(ballast); i += os.Getpagesize() {
+		ballast[i] = 1
+	}
+	b.Logf("heap ballast: %d MB", mb)
+	return ballast
 }
 
 // BenchmarkPodman measures podman throughput for comparison with libcrun-go.
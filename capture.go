@@ -0,0 +1,122 @@
+//go:build linux
+
+package crun
+
+import (
+	"io"
+	"sync"
+)
+
+// Capture is an io.Writer with a fixed memory cap, for capturing the
+// output of containers that may write without bound: it keeps the first
+// head bytes written and the last tail bytes, in a ring, and counts the
+// bytes dropped between them. Give it to IOConfig.Stdout or Stderr:
+//
+//	out := crun.NewCapture(64<<10, 64<<10)
+//	result, err := rc.RunWithIO(id, spec, &crun.IOConfig{Stdout: out})
+//	...
+//	out.WriteTo(os.Stdout)
+//	if n := out.Truncated(); n > 0 { ... }
+//
+// Memory is allocated as output arrives, up to head+tail bytes. A Capture
+// can be read while it is written to.
+type Capture struct {
+	mu       sync.Mutex
+	head     []byte
+	headCap  int
+	ring     []byte
+	tailCap  int
+	start, n int // ring[start:] then ring[:...] holds n bytes
+	total    int64
+}
+
+// NewCapture returns a Capture keeping at most head+tail bytes.
+func NewCapture(head, tail int) *Capture {
+	return &Capture{headCap: max(head, 0), tailCap: max(tail, 0)}
+}
+
+// Write records p. It never fails.
+func (c *Capture) Write(p []byte) (int, error) {
+	written := len(p)
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	c.total += int64(written)
+	if room := c.headCap - len(c.head); room > 0 {
+		k := min(room, len(p))
+		if cap(c.head)-len(c.head) < k {
+			// grow by hand: append could overshoot the cap
+			grown := make([]byte, len(c.head), min(c.headCap, max(2*cap(c.head), len(c.head)+k, 4096)))
+			copy(grown, c.head)
+			c.head = grown
+		}
+		c.head = append(c.head, p[:k]...)
+		p = p[k:]
+	}
+	if len(p) == 0 || c.tailCap == 0 {
+		return written, nil
+	}
+	if c.ring == nil {
+		c.ring = make([]byte, c.tailCap)
+	}
+	if len(p) >= c.tailCap {
+		copy(c.ring, p[len(p)-c.tailCap:])
+		c.start, c.n = 0, c.tailCap
+		return written, nil
+	}
+	w := (c.start + c.n) % c.tailCap
+	k := copy(c.ring[w:], p)
+	copy(c.ring, p[k:])
+	if c.n += len(p); c.n > c.tailCap {
+		c.start = (c.start + c.n - c.tailCap) % c.tailCap
+		c.n = c.tailCap
+	}
+	return written, nil
+}
+
+// Head returns a copy of the first bytes written, up to the head size.
+func (c *Capture) Head() []byte {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return append([]byte(nil), c.head...)
+}
+
+// Tail returns a copy of the last bytes written after the head, up to the
+// tail size.
+func (c *Capture) Tail() []byte {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return c.appendTail(nil)
+}
+
+func (c *Capture) appendTail(b []byte) []byte {
+	first := min(c.n, c.tailCap-c.start)
+	b = append(b, c.ring[c.start:c.start+first]...)
+	return append(b, c.ring[:c.n-first]...)
+}
+
+// Bytes returns a copy of the head followed by the tail.
+func (c *Capture) Bytes() []byte {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return c.appendTail(append(make([]byte, 0, len(c.head)+c.n), c.head...))
+}
+
+// Len returns the number of bytes written so far.
+func (c *Capture) Len() int64 {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return c.total
+}
+
+// Truncated returns the number of bytes written but not kept.
+func (c *Capture) Truncated() int64 {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return c.total - int64(len(c.head)+c.n)
+}
+
+// WriteTo writes the head followed by the tail to w.
+func (c *Capture) WriteTo(w io.Writer) (int64, error) {
+	n, err := w.Write(c.Bytes())
+	return int64(n), err
+}
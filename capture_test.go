@@ -0,0 +1,89 @@
+//go:build linux
+
+package crun
+
+import (
+	"bytes"
+	"fmt"
+	"math/rand"
+	"os"
+	"strings"
+	"testing"
+)
+
+func TestCaptureKeepsHeadAndTail(t *testing.T) {
+	c := NewCapture(4, 6)
+	for _, s := range []string{"ab", "cdef", "ghi", "jklmnop", "q"} {
+		if n, err := c.Write([]byte(s)); n != len(s) || err != nil {
+			t.Fatalf("Write(%q) = %d, %v", s, n, err)
+		}
+	}
+	// abcdefghijklmnopq: head abcd, tail lmnopq
+	if got := string(c.Head()); got != "abcd" {
+		t.Errorf("Head = %q", got)
+	}
+	if got := string(c.Tail()); got != "lmnopq" {
+		t.Errorf("Tail = %q", got)
+	}
+	if c.Len() != 17 || c.Truncated() != 7 {
+		t.Errorf("Len = %d, Truncated = %d; want 17, 7", c.Len(), c.Truncated())
+	}
+	var out bytes.Buffer
+	if _, err := c.WriteTo(&out); err != nil || out.String() != "abcdlmnopq" {
+		t.Errorf("WriteTo = %q, %v", out.String(), err)
+	}
+}
+
+func TestCaptureMatchesReference(t *testing.T) {
+	rng := rand.New(rand.NewSource(1))
+	for _, size := range [][2]int{{0, 0}, {0, 100}, {100, 0}, {10, 37}, {5000, 5000}} {
+		c := NewCapture(size[0], size[1])
+		var all []byte
+		for i := 0; i < 200; i++ {
+			p := make([]byte, rng.Intn(300))
+			rng.Read(p)
+			all = append(all, p...)
+			c.Write(p)
+		}
+		head := all[:min(size[0], len(all))]
+		rest := all[len(head):]
+		tail := rest[len(rest)-min(size[1], len(rest)):]
+		if !bytes.Equal(c.Bytes(), append(append([]byte(nil), head...), tail...)) {
+			t.Errorf("capture(%d, %d) of %d bytes does not keep the head and tail", size[0], size[1], len(all))
+		}
+		if want := int64(len(all) - len(head) - len(tail)); c.Truncated() != want {
+			t.Errorf("capture(%d, %d): Truncated = %d, want %d", size[0], size[1], c.Truncated(), want)
+		}
+	}
+}
+
+func TestCaptureBoundsMemory(t *testing.T) {
+	c := NewCapture(1000, 1000)
+	for i := 0; i < 10000; i++ {
+		fmt.Fprintf(c, "line %d\n", i)
+	}
+	if cap(c.head) > 1000 || len(c.ring) > 1000 {
+		t.Errorf("capture holds %d+%d bytes, want at most 1000+1000", cap(c.head), len(c.ring))
+	}
+	if !strings.HasSuffix(string(c.Tail()), "line 9999\n") {
+		t.Errorf("tail does not end with the last line: %q", c.Tail())
+	}
+}
+
+func TestCaptureFromPipe(t *testing.T) {
+	r, w, err := os.Pipe()
+	if err != nil {
+		t.Fatalf("Pipe failed: %v", err)
+	}
+	payload := strings.Repeat("0123456789", 100000)
+	go func() {
+		_, _ = w.WriteString(payload)
+		w.Close()
+	}()
+	c := NewCapture(10, 10)
+	copyStream(c, r, r, nil, nil)
+	r.Close()
+	if got := string(c.Bytes()); got != "01234567890123456789" || c.Len() != int64(len(payload)) {
+		t.Errorf("captured %q of %d bytes", got, c.Len())
+	}
+}
@@ -0,0 +1,376 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"bytes"
+	"context"
+	"errors"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"sync"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// CgroupPoolStats reports a CgroupPool.
+type CgroupPoolStats struct {
+	// Idle is the number of empty cgroups ready for a container, InUse
+	// the number assigned to one, recycles in progress included.
+	Idle, InUse int
+	// Created counts the cgroups the pool created, Reused the assignments
+	// served by an idle one, and Discarded the cgroups removed instead of
+	// recycled: past the pool's size, still populated, or removed by
+	// another process.
+	Created, Reused, Discarded int64
+}
+
+// cgroupRecycleTimeout bounds the wait for a returned cgroup to empty; one
+// still populated then is discarded.
+const cgroupRecycleTimeout = 10 * time.Second
+
+// CgroupPool recycles the cgroups of short-lived containers: creating and
+// removing a cgroup directory, with the controller setup of its parent,
+// is a large share of the create and delete of a container that runs for
+// a fraction of a second. Set RuntimeConfig.CgroupPool to use it: every
+// container the context launches with the cgroupfs manager (not
+// SystemdCgroup) and without linux.cgroupsPath in its spec enters an
+// empty cgroup of the pool, created by NewCgroupPool under a parent with
+// its controllers enabled already. Delete leaves the directory, after
+// killing what is left in it, and the pool resets its limits to the
+// defaults once it is empty and hands it to the next container.
+//
+// Only cgroup v2 is supported. Containers launched through an
+// IOConfig.Launcher or with IOConfig.Spawn run libcrun in a helper forked
+// before their launch or in another program, which do not see the pool's
+// assignments: they are assigned no pooled cgroup and get one of their
+// own, as without the pool.
+type CgroupPool struct {
+	parent string // cgroup path under cgroupRoot, with a leading '/'
+	size   int
+
+	mu        sync.Mutex
+	idle      []string          // cgroup paths
+	byKey     map[string]string // cgroup path by cgroupPoolKey
+	seq       uint64
+	closed    bool
+	recycling int
+	pending   sync.WaitGroup // recycles in progress
+
+	created, reused, discarded int64
+}
+
+// NewCgroupPool creates parent, a cgroup path such as "libcrun-pool"
+// relative to the cgroup v2 mount, if needed, enables the controllers
+// available along the way to it in its own and its ancestors'
+// cgroup.subtree_control, and creates size empty cgroups in it. At most
+// size idle cgroups are kept: the pool creates more when they run out,
+// and removes the surplus as containers are deleted.
+func NewCgroupPool(parent string, size int) (*CgroupPool, error) {
+	if _, err := os.Stat(filepath.Join(cgroupRoot, "cgroup.controllers")); err != nil {
+		return nil, errors.New("libcrun: a cgroup pool needs the unified cgroup hierarchy (cgroup v2)")
+	}
+	p := filepath.Clean("/" + parent)
+	if p == "/" {
+		return nil, errors.New("libcrun: a cgroup pool needs a parent other than the root cgroup")
+	}
+	if err := os.MkdirAll(filepath.Join(cgroupRoot, p), 0o755); err != nil {
+		return nil, err
+	}
+	enableCgroupControllers(p)
+	pool := &CgroupPool{parent: p, size: max(size, 0), byKey: map[string]string{}}
+	for i := 0; i < pool.size; i++ {
+		path, err := pool.createLocked()
+		if err != nil {
+			pool.Close()
+			return nil, err
+		}
+		pool.idle = append(pool.idle, path)
+	}
+	return pool, nil
+}
+
+// enableCgroupControllers enables, from the root cgroup down to path
+// included, the controllers of each cgroup for its children. A controller
+// that cannot be enabled, as in a cgroup with processes of its own, is
+// left out.
+func enableCgroupControllers(path string) {
+	dir := cgroupRoot
+	for _, elem := range append([]string{""}, strings.Split(strings.Trim(path, "/"), "/")...) {
+		dir = filepath.Join(dir, elem)
+		b, err := os.ReadFile(filepath.Join(dir, "cgroup.controllers"))
+		if err != nil {
+			return
+		}
+		for _, c := range strings.Fields(string(b)) {
+			_ = writeCgroupFile(dir, "cgroup.subtree_control", "+"+c)
+		}
+	}
+}
+
+// writeCgroupFile writes value to an existing control file of the cgroup
+// directory dir.
+func writeCgroupFile(dir, file, value string) error {
+	f, err := os.OpenFile(filepath.Join(dir, file), os.O_WRONLY, 0)
+	if err != nil {
+		return err
+	}
+	_, err = f.WriteString(value)
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	return err
+}
+
+// Parent returns the cgroup path of the pool's parent.
+func (p *CgroupPool) Parent() string { return p.parent }
+
+// Stats returns the pool's counters.
+func (p *CgroupPool) Stats() CgroupPoolStats {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	return CgroupPoolStats{
+		Idle:      len(p.idle),
+		InUse:     len(p.byKey) + p.recycling,
+		Created:   p.created,
+		Reused:    p.reused,
+		Discarded: p.discarded,
+	}
+}
+
+// Close waits for the recycles in progress and removes the idle cgroups.
+// Containers still holding a cgroup keep it; their Delete removes it. No
+// launch through a context using the pool may be in progress. Close is
+// idempotent.
+func (p *CgroupPool) Close() error {
+	p.mu.Lock()
+	if p.closed {
+		p.mu.Unlock()
+		return nil
+	}
+	p.closed = true
+	p.mu.Unlock()
+	p.pending.Wait()
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	for _, path := range p.idle {
+		p.discardLocked(path)
+	}
+	p.idle = nil
+	return nil
+}
+
+// createLocked creates a cgroup, named after a sequence number the
+// parent has no cgroup for.
+func (p *CgroupPool) createLocked() (string, error) {
+	for {
+		p.seq++
+		path := p.parent + "/" + strconv.FormatUint(p.seq, 10)
+		err := syscall.Mkdir(filepath.Join(cgroupRoot, path), 0o755)
+		if err == syscall.EEXIST {
+			continue // left by a previous process, maybe to a container
+		}
+		if err != nil {
+			return "", &os.PathError{Op: "mkdir", Path: filepath.Join(cgroupRoot, path), Err: err}
+		}
+		p.created++
+		return path, nil
+	}
+}
+
+func (p *CgroupPool) discardLocked(path string) {
+	_ = syscall.Rmdir(filepath.Join(cgroupRoot, path))
+	p.discarded++
+}
+
+// cgroupPoolKey identifies container id of stateRoot ("" for libcrun's
+// default).
+func cgroupPoolKey(stateRoot, id string) string { return stateRoot + "\x00" + id }
+
+// assign gives container id of stateRoot a cgroup, an idle one if any,
+// unless it has one already.
+func (p *CgroupPool) assign(stateRoot *C.char, id string) error {
+	key := cgroupPoolKey(C.GoString(stateRoot), id)
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.closed {
+		return errors.New("libcrun: cgroup pool closed")
+	}
+	if _, ok := p.byKey[key]; ok {
+		return nil
+	}
+	var path string
+	if n := len(p.idle); n > 0 {
+		path = p.idle[n-1]
+		p.idle = p.idle[:n-1]
+		p.reused++
+	} else {
+		var err error
+		if path, err = p.createLocked(); err != nil {
+			return err
+		}
+	}
+	cid, cpath := C.CString(id), C.CString(path)
+	defer C.free(unsafe.Pointer(cid))
+	defer C.free(unsafe.Pointer(cpath))
+	if C.go_crun_cgroup_pool_assign(stateRoot, cid, cpath) < 0 {
+		p.idle = append(p.idle, path)
+		return errors.New("libcrun: failed to allocate cgroup assignment")
+	}
+	p.byKey[key] = path
+	return nil
+}
+
+// release takes back the cgroup of container id of stateRoot, if it has
+// one, and recycles it in the background.
+func (p *CgroupPool) release(stateRoot *C.char, id string) {
+	if p == nil {
+		return
+	}
+	key := cgroupPoolKey(C.GoString(stateRoot), id)
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	path, ok := p.byKey[key]
+	if !ok {
+		return
+	}
+	delete(p.byKey, key)
+	cid := C.CString(id)
+	C.go_crun_cgroup_pool_assign(stateRoot, cid, nil)
+	C.free(unsafe.Pointer(cid))
+	p.recycling++
+	p.pending.Add(1)
+	go p.recycle(path)
+}
+
+// recycle waits for the cgroup at path to empty, resets it and makes it
+// idle, or removes it when the pool has enough idle cgroups or is closed.
+func (p *CgroupPool) recycle(path string) {
+	defer p.pending.Done()
+	dir := filepath.Join(cgroupRoot, path)
+	ctx, cancel := context.WithTimeout(context.Background(), cgroupRecycleTimeout)
+	empty := waitUnpopulated(ctx, filepath.Join(dir, "cgroup.events"))
+	cancel()
+	_, err := os.Stat(dir)
+	if empty && err == nil {
+		resetCgroup(dir)
+	}
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	p.recycling--
+	switch {
+	case err != nil:
+		p.discarded++ // removed by someone else
+	case !empty || p.closed || len(p.idle) >= p.size:
+		p.discardLocked(path)
+	default:
+		p.idle = append(p.idle, path)
+	}
+}
+
+// cgroupDefaults are the cgroup v2 limits a container's spec may set, at
+// the values of a new cgroup. They are written directly rather than
+// through libcrun_update_cgroup_resources, which only writes the limits
+// the resources it is given set.
+var cgroupDefaults = [...]struct{ file, value string }{
+	{"cgroup.freeze", "0"},
+	{"memory.min", "0"},
+	{"memory.low", "0"},
+	{"memory.high", "max"},
+	{"memory.max", "max"},
+	{"memory.swap.high", "max"},
+	{"memory.swap.max", "max"},
+	{"memory.oom.group", "0"},
+	{"pids.max", "max"},
+	{"cpu.weight", "100"},
+	{"cpu.max", "max 100000"},
+	{"cpu.idle", "0"},
+	{"cpuset.cpus", "\n"},
+	{"cpuset.mems", "\n"},
+	{"io.weight", "default 100"},
+}
+
+// resetCgroup brings the empty cgroup dir back to the state of a new one:
+// its descendants removed, no controller enabled for them, and the limits
+// of cgroupDefaults, of io.max and of the hugetlb controller lifted.
+func resetCgroup(dir string) {
+	removeCgroupChildren(dir)
+	if b, err := os.ReadFile(filepath.Join(dir, "cgroup.subtree_control")); err == nil {
+		for _, c := range strings.Fields(string(b)) {
+			_ = writeCgroupFile(dir, "cgroup.subtree_control", "-"+c)
+		}
+	}
+	for _, d := range cgroupDefaults {
+		_ = writeCgroupFile(dir, d.file, d.value)
+	}
+	if b, err := os.ReadFile(filepath.Join(dir, "io.max")); err == nil {
+		for _, line := range bytes.Split(b, []byte("\n")) {
+			if dev, _, ok := bytes.Cut(line, []byte(" ")); ok {
+				_ = writeCgroupFile(dir, "io.max", string(dev)+" rbps=max wbps=max riops=max wiops=max")
+			}
+		}
+	}
+	hugetlb, _ := filepath.Glob(filepath.Join(dir, "hugetlb.*.max"))
+	for _, f := range hugetlb {
+		_ = writeCgroupFile(dir, filepath.Base(f), "max")
+	}
+}
+
+// removeCgroupChildren removes the cgroups under dir, deepest first.
+func removeCgroupChildren(dir string) {
+	entries, err := os.ReadDir(dir)
+	if err != nil {
+		return
+	}
+	for _, e := range entries {
+		if e.IsDir() {
+			child := filepath.Join(dir, e.Name())
+			removeCgroupChildren(child)
+			_ = syscall.Rmdir(child)
+		}
+	}
+}
+
+// stateRootDir is the state root of the context, libcrun's default when
+// unset.
+func (x *RuntimeContext) stateRootDir() string {
+	if x.c.state_root != nil {
+		return C.GoString(x.c.state_root)
+	}
+	return "/run/crun"
+}
+
+// cgroupLaunchDone takes back the pooled cgroup of container id when its
+// launch is over and the container does not exist: the launch failed, or
+// ran the container to completion (Run without Detach).
+func (x *RuntimeContext) cgroupLaunchDone(id string) {
+	if x.cgroupPool == nil {
+		return
+	}
+	if _, err := os.Lstat(filepath.Join(x.stateRootDir(), id, "status")); err == nil {
+		return
+	}
+	x.cgroupPool.release(x.c.state_root, id)
+}
+
+// cgroupLaunchedIO is cgroupLaunchDone for a launch by a forked child
+// (RunWithIO, RunBatch, RestoreWithIO), once the child exits.
+func (x *RuntimeContext) cgroupLaunchedIO(id string, res *RunResult) {
+	if x.cgroupPool == nil {
+		return
+	}
+	wait := res.Wait
+	res.Wait = func() (int, error) {
+		code, err := wait()
+		x.cgroupLaunchDone(id)
+		return code, err
+	}
+}
@@ -0,0 +1,251 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+// fakeCgroupPool points cgroupRoot at a fake cgroup v2 mount and returns a
+// pool of size there, with a context using it.
+func fakeCgroupPool(t *testing.T, size int) (*CgroupPool, *RuntimeContext) {
+	t.Helper()
+	old := cgroupRoot
+	cgroupRoot = t.TempDir()
+	t.Cleanup(func() { cgroupRoot = old })
+	if err := os.WriteFile(filepath.Join(cgroupRoot, "cgroup.controllers"), []byte("cpu memory pids\n"), 0o644); err != nil {
+		t.Fatal(err)
+	}
+	if err := os.WriteFile(filepath.Join(cgroupRoot, "cgroup.subtree_control"), nil, 0o644); err != nil {
+		t.Fatal(err)
+	}
+	p, err := NewCgroupPool("libcrun-pool", size)
+	if err != nil {
+		t.Fatalf("NewCgroupPool failed: %v", err)
+	}
+	t.Cleanup(func() { p.Close() })
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir(), CgroupPool: p})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	t.Cleanup(func() { rc.Close() })
+	return p, rc
+}
+
+// launchPooled assigns container id a cgroup, as its launch does, and
+// returns its directory, faked as empty.
+func launchPooled(t *testing.T, p *CgroupPool, rc *RuntimeContext, id string) string {
+	t.Helper()
+	cl, err := rc.acquireLaunchContext(id, nil, true)
+	if err != nil {
+		t.Fatalf("acquireLaunchContext failed: %v", err)
+	}
+	rc.releaseContext(cl)
+	p.mu.Lock()
+	path := p.byKey[cgroupPoolKey(rc.stateRootDir(), id)]
+	p.mu.Unlock()
+	if path == "" {
+		t.Fatalf("no cgroup assigned to %s", id)
+	}
+	dir := filepath.Join(cgroupRoot, path)
+	if err := os.WriteFile(filepath.Join(dir, "cgroup.events"), []byte("populated 0\nfrozen 0\n"), 0o644); err != nil {
+		t.Fatal(err)
+	}
+	return dir
+}
+
+func TestCgroupPoolNeedsCgroupV2(t *testing.T) {
+	old := cgroupRoot
+	cgroupRoot = t.TempDir()
+	defer func() { cgroupRoot = old }()
+	if _, err := NewCgroupPool("libcrun-pool", 1); err == nil {
+		t.Fatal("NewCgroupPool succeeded without cgroup.controllers")
+	}
+}
+
+func TestCgroupPoolRecycles(t *testing.T) {
+	p, rc := fakeCgroupPool(t, 2)
+	if got := p.Stats(); got.Idle != 2 || got.Created != 2 {
+		t.Fatalf("Stats() after NewCgroupPool = %+v, want 2 idle, 2 created", got)
+	}
+	if b, _ := os.ReadFile(filepath.Join(cgroupRoot, "cgroup.subtree_control")); string(b) == "" {
+		t.Error("controllers not enabled in the root cgroup")
+	}
+
+	dir := launchPooled(t, p, rc, "a")
+	if got := p.Stats(); got.Idle != 1 || got.InUse != 1 || got.Reused != 1 {
+		t.Fatalf("Stats() after a launch = %+v, want 1 idle, 1 in use, 1 reused", got)
+	}
+	// The container's limits are lifted before the next one gets the cgroup
+	if err := os.WriteFile(filepath.Join(dir, "pids.max"), []byte("512"), 0o644); err != nil {
+		t.Fatal(err)
+	}
+	if err := os.Mkdir(filepath.Join(dir, "sub"), 0o755); err != nil {
+		t.Fatal(err)
+	}
+
+	// A relaunch of the same container keeps its cgroup
+	if again := launchPooled(t, p, rc, "a"); again != dir {
+		t.Fatalf("relaunch got %s, want %s", again, dir)
+	}
+	rc.cgroupPool.release(rc.c.state_root, "a")
+	waitFor(t, "the cgroup to be idle again", func() bool { return p.Stats().Idle == 2 })
+	if b, _ := os.ReadFile(filepath.Join(dir, "pids.max")); string(b) != "max" {
+		t.Errorf("pids.max = %q after recycling, want max", b)
+	}
+	if _, err := os.Stat(filepath.Join(dir, "sub")); !os.IsNotExist(err) {
+		t.Errorf("child cgroup left after recycling: %v", err)
+	}
+	if got := p.Stats(); got.InUse != 0 || got.Created != 2 {
+		t.Errorf("Stats() after recycling = %+v, want none in use, 2 created", got)
+	}
+}
+
+func TestCgroupPoolGrowsAndDiscards(t *testing.T) {
+	p, rc := fakeCgroupPool(t, 1)
+	launchPooled(t, p, rc, "a")
+	launchPooled(t, p, rc, "b")
+	if got := p.Stats(); got.Idle != 0 || got.InUse != 2 || got.Created != 2 {
+		t.Fatalf("Stats() = %+v, want 2 in use, 2 created", got)
+	}
+	rc.cgroupPool.release(rc.c.state_root, "a")
+	rc.cgroupPool.release(rc.c.state_root, "b")
+	waitFor(t, "the cgroups to be returned", func() bool { return p.Stats().InUse == 0 })
+	if got := p.Stats(); got.Idle != 1 || got.Discarded != 1 {
+		t.Errorf("Stats() = %+v, want 1 idle, 1 discarded past the size", got)
+	}
+}
+
+func TestCgroupPoolRemovedCgroupDiscarded(t *testing.T) {
+	p, rc := fakeCgroupPool(t, 1)
+	dir := launchPooled(t, p, rc, "a")
+	if err := os.RemoveAll(dir); err != nil {
+		t.Fatal(err)
+	}
+	rc.cgroupPool.release(rc.c.state_root, "a")
+	waitFor(t, "the cgroup to be returned", func() bool { return p.Stats().InUse == 0 })
+	if got := p.Stats(); got.Idle != 0 || got.Discarded != 1 {
+		t.Errorf("Stats() = %+v, want the removed cgroup discarded", got)
+	}
+}
+
+func TestCgroupLaunchDone(t *testing.T) {
+	p, rc := fakeCgroupPool(t, 1)
+	launchPooled(t, p, rc, "kept")
+	// A container that exists keeps its cgroup until Delete
+	state := filepath.Join(rc.stateRootDir(), "kept")
+	if err := os.MkdirAll(state, 0o700); err != nil {
+		t.Fatal(err)
+	}
+	if err := os.WriteFile(filepath.Join(state, "status"), []byte("{}"), 0o600); err != nil {
+		t.Fatal(err)
+	}
+	rc.cgroupLaunchDone("kept")
+	if got := p.Stats(); got.InUse != 1 {
+		t.Fatalf("Stats() = %+v, want the cgroup kept", got)
+	}
+	// One whose launch left nothing behind gives it back
+	os.RemoveAll(state)
+	rc.cgroupLaunchDone("kept")
+	waitFor(t, "the cgroup to be returned", func() bool { return p.Stats().Idle == 1 })
+}
+
+func TestCgroupPoolIgnoredWithSystemd(t *testing.T) {
+	p, _ := fakeCgroupPool(t, 1)
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir(), CgroupPool: p, SystemdCgroup: true})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+	cl, err := rc.acquireLaunchContext("a", nil, true)
+	if err != nil {
+		t.Fatalf("acquireLaunchContext failed: %v", err)
+	}
+	rc.releaseContext(cl)
+	if got := p.Stats(); got.InUse != 0 {
+		t.Errorf("Stats() = %+v, want no cgroup assigned with SystemdCgroup", got)
+	}
+}
+
+func TestCgroupPoolClosed(t *testing.T) {
+	p, rc := fakeCgroupPool(t, 1)
+	if err := p.Close(); err != nil {
+		t.Fatalf("Close failed: %v", err)
+	}
+	if _, err := rc.acquireLaunchContext("a", nil, true); err == nil {
+		t.Fatal("acquireLaunchContext succeeded with a closed pool")
+	}
+	if err := p.Close(); err != nil {
+		t.Fatalf("second Close failed: %v", err)
+	}
+}
+
+func TestCgroupPoolClosedReleasesNotify(t *testing.T) {
+	p, _ := fakeCgroupPool(t, 1)
+	h, err := NewNotifyHub("")
+	if err != nil {
+		t.Fatalf("NewNotifyHub failed: %v", err)
+	}
+	defer h.Close()
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir(), CgroupPool: p, Notify: h})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+	if _, _, err := h.register("live"); err != nil {
+		t.Fatalf("register failed: %v", err)
+	}
+
+	p.Close()
+	for _, id := range []string{"a", "live"} {
+		if _, err := rc.acquireLaunchContext(id, nil, true); err == nil {
+			t.Fatalf("acquireLaunchContext(%s) succeeded with a closed pool", id)
+		}
+	}
+	h.mu.Lock()
+	a, live := h.byID["a"], h.byID["live"]
+	h.mu.Unlock()
+	if a != nil {
+		t.Error("notify socket of a failed launch left registered")
+	}
+	if live == nil {
+		t.Error("notify socket of an existing container released")
+	}
+}
+
+func TestCgroupPoolSkippedForHelpers(t *testing.T) {
+	p, rc := fakeCgroupPool(t, 1)
+	cl, err := rc.acquireLaunchContext("a", nil, false)
+	if err != nil {
+		t.Fatalf("acquireLaunchContext failed: %v", err)
+	}
+	rc.releaseContext(cl)
+	if got := p.Stats(); got.InUse != 0 || got.Idle != 1 {
+		t.Errorf("Stats() = %+v, want no cgroup assigned to a helper launch", got)
+	}
+}
+
+func TestCgroupPoolSkippedForStartAndCgroupsPath(t *testing.T) {
+	p, rc := fakeCgroupPool(t, 1)
+	// Start carries the notify socket, but is not a launch
+	cl, err := rc.acquireContext("a")
+	if err != nil {
+		t.Fatalf("acquireContext failed: %v", err)
+	}
+	rc.releaseContext(cl)
+
+	spec, err := NewSpec(false, WithCgroupsPath("/elsewhere/b"))
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	defer spec.Close()
+	if cl, err = rc.acquireLaunchContext("b", spec, true); err != nil {
+		t.Fatalf("acquireLaunchContext failed: %v", err)
+	}
+	rc.releaseContext(cl)
+	if got := p.Stats(); got.InUse != 0 || got.Idle != 1 {
+		t.Errorf("Stats() = %+v, want no cgroup assigned to a start or a spec with linux.cgroupsPath", got)
+	}
+}
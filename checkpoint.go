@@ -0,0 +1,351 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"time"
+	"unsafe"
+)
+
+// CheckpointOptions configures Container.Checkpoint (CRIU dump).
+type CheckpointOptions struct {
+	ImagePath string // directory receiving the images (required)
+	WorkPath  string // CRIU logs and work files (default: ImagePath)
+
+	// PreDump dumps the memory only, leaving the container running, so a
+	// later dump with ParentPath set to this image only writes the pages
+	// dirtied since.
+	PreDump bool
+	// ParentPath is the image of a previous pre-dump, relative to
+	// ImagePath (e.g. "../pre-1").
+	ParentPath string
+
+	LeaveRunning   bool // keep the container running after the dump
+	TCPEstablished bool // checkpoint established TCP connections
+	TCPClose       bool // do not checkpoint TCP connections, close them on restore
+	ShellJob       bool // allow an external controlling terminal
+	ExtUnixSk      bool // allow external unix sockets
+	FileLocks      bool // checkpoint file locks
+}
+
+// RestoreOptions configures RuntimeContext.Restore.
+type RestoreOptions struct {
+	ImagePath string // directory holding the images (required)
+	WorkPath  string // CRIU logs and work files (default: ImagePath)
+
+	// Bundle overrides RuntimeConfig.Bundle for this restore; the
+	// container's config.json is read from the bundle.
+	Bundle string
+	// Detach returns once the container is restored instead of waiting
+	// for it to exit.
+	Detach        bool
+	ConsoleSocket string
+
+	TCPEstablished bool
+	TCPClose       bool
+	ShellJob       bool
+	ExtUnixSk      bool
+	FileLocks      bool
+}
+
+// Checkpoint dumps the container's state to o.ImagePath with CRIU. Unless
+// o.LeaveRunning or o.PreDump is set, the container is stopped afterwards.
+func (c *Container) Checkpoint(o CheckpointOptions) error {
+	x := c.runtime
+	if x == nil || x.c == nil {
+		return errors.New("libcrun: invalid runtime context")
+	}
+	if o.ImagePath == "" {
+		return errors.New("libcrun: checkpoint needs an image path")
+	}
+	cr := newCROptions(o.ImagePath, o.WorkPath)
+	defer cr.free()
+	cr.c.pre_dump = C.bool(o.PreDump)
+	if o.ParentPath != "" {
+		cr.c.parent_path = C.CString(o.ParentPath)
+	}
+	cr.c.leave_running = C.bool(o.LeaveRunning)
+	cr.c.tcp_established = C.bool(o.TCPEstablished)
+	cr.c.tcp_close = C.bool(o.TCPClose)
+	cr.c.shell_job = C.bool(o.ShellJob)
+	cr.c.ext_unix_sk = C.bool(o.ExtUnixSk)
+	cr.c.file_locks = C.bool(o.FileLocks)
+
+	r := c.ref()
+	cid := r.cidFor(c.ID)
+	defer r.release(cid)
+	var err C.libcrun_error_t
+	logged := x.beginLog(cid)
+	rc := C.libcrun_container_checkpoint(x.c, cid, cr.c, &err)
+	endLog(logged)
+	if rc < 0 {
+		return fromLibcrunErr(&err)
+	}
+	return nil
+}
+
+// Restore recreates container id from the images in o.ImagePath.
+func (x *RuntimeContext) Restore(id string, o RestoreOptions) (*Container, error) {
+	if x == nil || x.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context")
+	}
+	if o.ImagePath == "" {
+		return nil, errors.New("libcrun: restore needs an image path")
+	}
+	cr := o.toC()
+	defer cr.free()
+
+	c, cerr := x.acquireRestoreContext(id, o.Bundle)
+	if cerr != nil {
+		return nil, cerr
+	}
+	defer x.cgroupLaunchDone(id)
+	var err C.libcrun_error_t
+	logged := x.beginLog(c.id)
+	rc := C.libcrun_container_restore(c, c.id, cr.c, &err)
+	endLog(logged)
+	x.releaseRestoreContext(c)
+	if rc < 0 {
+		return nil, fromLibcrunErr(&err)
+	}
+	x.indexLaunch(id, o.Detach)
+	return &Container{ID: id, runtime: x, launched: true}, nil
+}
+
+// RestoreWithIO restores container id, like Restore, from a forked child
+// whose stdio are ioCfg's streams, as RunWithIO does for a new container.
+// Standard streams that were pipes at checkpoint time are reconnected to
+// the new ones. It returns once the restore is under way; Wait reports the
+// exit code of the restored container. o.Detach is ignored.
+func (x *RuntimeContext) RestoreWithIO(id string, o RestoreOptions, ioCfg *IOConfig) (*RunResult, error) {
+	if x == nil || x.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context")
+	}
+	if o.ImagePath == "" {
+		return nil, errors.New("libcrun: restore needs an image path")
+	}
+	if ioCfg == nil {
+		ioCfg = &IOConfig{}
+	}
+	handler := x.effectiveLogHandler()
+	p, err := openRunPipes(ioCfg, handler != nil)
+	if err != nil {
+		return nil, err
+	}
+	stdinFd, stdoutFd, stderrFd, logFd := p.childFds()
+
+	c, runErr := x.acquireRestoreContext(id, o.Bundle)
+	if runErr != nil {
+		p.closeChild()
+		p.closeParent()
+		return nil, runErr
+	}
+	cr := o.toC()
+	var childPid C.pid_t
+	var cerr C.libcrun_error_t
+	rc := C.go_crun_restore_with_pipes(c, cr.c, C.int(x.childVerbosity()),
+		stdinFd, stdoutFd, stderrFd, logFd, &childPid, &cerr)
+	cr.free()
+	x.releaseRestoreContext(c)
+
+	p.closeChild()
+	if rc < 0 {
+		p.closeParent()
+		x.cgroupLaunchDone(id)
+		return nil, fromLibcrunErr(&cerr)
+	}
+	res := x.startRunIO(id, ioCfg, handler, p.stdinW, p.stdoutR, p.stderrR, p.logR, childPid)
+	x.indexLaunchIO(id, res)
+	x.cgroupLaunchedIO(id, res)
+	return res, nil
+}
+
+// acquireRestoreContext is acquireLaunchContext with the bundle replaced
+// when bundle is not empty. Release it with releaseRestoreContext.
+func (x *RuntimeContext) acquireRestoreContext(id, bundle string) (*C.libcrun_context_t, error) {
+	c, err := x.acquireLaunchContext(id, nil, true)
+	if err != nil {
+		return nil, err
+	}
+	if bundle != "" {
+		c.bundle = C.CString(bundle)
+	}
+	return c, nil
+}
+
+func (x *RuntimeContext) releaseRestoreContext(c *C.libcrun_context_t) {
+	if c.bundle != x.c.bundle {
+		C.free(unsafe.Pointer(c.bundle))
+		c.bundle = x.c.bundle // the clone borrows the base strings
+	}
+	x.releaseContext(c)
+}
+
+// toC converts o to a libcrun_checkpoint_restore_t.
+func (o *RestoreOptions) toC() crOptions {
+	cr := newCROptions(o.ImagePath, o.WorkPath)
+	cr.c.detach = C.bool(o.Detach)
+	if o.ConsoleSocket != "" {
+		cr.c.console_socket = C.CString(o.ConsoleSocket)
+	}
+	cr.c.tcp_established = C.bool(o.TCPEstablished)
+	cr.c.tcp_close = C.bool(o.TCPClose)
+	cr.c.shell_job = C.bool(o.ShellJob)
+	cr.c.ext_unix_sk = C.bool(o.ExtUnixSk)
+	cr.c.file_locks = C.bool(o.FileLocks)
+	return cr
+}
+
+// crOptions is a C libcrun_checkpoint_restore_t, valid until free.
+type crOptions struct {
+	c *C.libcrun_checkpoint_restore_t
+}
+
+func newCROptions(image, work string) crOptions {
+	c := (*C.libcrun_checkpoint_restore_t)(C.calloc(1, C.size_t(unsafe.Sizeof(C.libcrun_checkpoint_restore_t{}))))
+	c.image_path = C.CString(image)
+	if work != "" {
+		c.work_path = C.CString(work)
+	}
+	// -1 lets libcrun pick its defaults, as the crun CLI does
+	c.manage_cgroups_mode = -1
+	c.network_lock_method = -1
+	return crOptions{c: c}
+}
+
+func (cr crOptions) free() {
+	C.free(unsafe.Pointer(cr.c.image_path))
+	C.free(unsafe.Pointer(cr.c.work_path))
+	C.free(unsafe.Pointer(cr.c.parent_path))
+	C.free(unsafe.Pointer(cr.c.console_socket))
+	C.free(unsafe.Pointer(cr.c))
+}
+
+// MigrationOptions configures Container.CheckpointIterative.
+type MigrationOptions struct {
+	// Dir receives the pre-dumps (pre-1, pre-2, ...) and the final dump
+	// (final). It is created if needed.
+	Dir string
+	// MaxPreDumps bounds the number of pre-dumps. 0 selects 5.
+	MaxPreDumps int
+	// DirtyBytes ends the pre-dump phase once a pre-dump wrote at most this
+	// many bytes of memory pages. 0 selects 16 MiB.
+	DirtyBytes int64
+	// Checkpoint holds the options of the final dump; ImagePath, PreDump
+	// and ParentPath are set by CheckpointIterative.
+	Checkpoint CheckpointOptions
+}
+
+// PreDumpStat describes one pre-dump of CheckpointIterative.
+type PreDumpStat struct {
+	Path     string
+	Bytes    int64 // memory pages written
+	Duration time.Duration
+}
+
+// MigrationResult is the outcome of CheckpointIterative.
+type MigrationResult struct {
+	ImagePath string // the final dump, to pass to Restore
+	PreDumps  []PreDumpStat
+	Final     PreDumpStat // the final dump, during which the container was frozen
+}
+
+// Default bounds of CheckpointIterative.
+const (
+	defaultMaxPreDumps = 5
+	defaultDirtyBytes  = 16 << 20
+)
+
+// CheckpointIterative checkpoints the container for live migration. It
+// runs pre-dumps, each chained to the previous one, while the container
+// keeps running, until a pre-dump writes at most o.DirtyBytes, stops
+// shrinking, or o.MaxPreDumps is reached. The final dump then only writes
+// the pages dirtied since the last pre-dump, which keeps the window during
+// which the container is frozen short.
+func (c *Container) CheckpointIterative(o MigrationOptions) (*MigrationResult, error) {
+	return iterativeCheckpoint(c.Checkpoint, o)
+}
+
+func iterativeCheckpoint(dump func(CheckpointOptions) error, o MigrationOptions) (*MigrationResult, error) {
+	if o.Dir == "" {
+		return nil, errors.New("libcrun: migration needs a directory")
+	}
+	if o.MaxPreDumps <= 0 {
+		o.MaxPreDumps = defaultMaxPreDumps
+	}
+	if o.DirtyBytes <= 0 {
+		o.DirtyBytes = defaultDirtyBytes
+	}
+	res := &MigrationResult{}
+	run := func(name string, pre bool, parent string) (PreDumpStat, error) {
+		path := filepath.Join(o.Dir, name)
+		if err := os.MkdirAll(path, 0o700); err != nil {
+			return PreDumpStat{}, err
+		}
+		co := o.Checkpoint
+		co.ImagePath, co.PreDump, co.ParentPath = path, pre, ""
+		if co.WorkPath != "" {
+			co.WorkPath = filepath.Join(co.WorkPath, name)
+		}
+		if parent != "" {
+			co.ParentPath = filepath.Join("..", parent)
+		}
+		start := time.Now()
+		if err := dump(co); err != nil {
+			return PreDumpStat{}, err
+		}
+		return PreDumpStat{Path: path, Bytes: imagePagesBytes(path), Duration: time.Since(start)}, nil
+	}
+
+	parent := ""
+	for i := 1; i <= o.MaxPreDumps; i++ {
+		name := "pre-" + strconv.Itoa(i)
+		st, err := run(name, true, parent)
+		if err != nil {
+			return res, err
+		}
+		res.PreDumps = append(res.PreDumps, st)
+		parent = name
+		if st.Bytes <= o.DirtyBytes {
+			break
+		}
+		// Stop when the dirty set does not shrink meaningfully any more
+		if n := len(res.PreDumps); n > 1 && st.Bytes*10 >= res.PreDumps[n-2].Bytes*9 {
+			break
+		}
+	}
+	st, err := run("final", false, parent)
+	if err != nil {
+		return res, err
+	}
+	res.Final = st
+	res.ImagePath = st.Path
+	return res, nil
+}
+
+// imagePagesBytes returns the size of the memory page images in dir.
+func imagePagesBytes(dir string) int64 {
+	entries, err := os.ReadDir(dir)
+	if err != nil {
+		return 0
+	}
+	var n int64
+	for _, e := range entries {
+		if !strings.HasPrefix(e.Name(), "pages-") || !strings.HasSuffix(e.Name(), ".img") {
+			continue
+		}
+		if info, err := e.Info(); err == nil {
+			n += info.Size()
+		}
+	}
+	return n
+}
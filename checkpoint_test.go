@@ -0,0 +1,108 @@
+//go:build linux
+
+package crun
+
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+// fakeDump writes a pages image whose size is taken from sizes, one per
+// call, and records the options it was called with.
+func fakeDump(t *testing.T, sizes []int64, calls *[]CheckpointOptions) func(CheckpointOptions) error {
+	return func(o CheckpointOptions) error {
+		*calls = append(*calls, o)
+		size := int64(1024)
+		if i := len(*calls) - 1; i < len(sizes) {
+			size = sizes[i]
+		}
+		if err := os.WriteFile(filepath.Join(o.ImagePath, "pages-1.img"), make([]byte, size), 0o600); err != nil {
+			t.Fatalf("WriteFile failed: %v", err)
+		}
+		return os.WriteFile(filepath.Join(o.ImagePath, "inventory.img"), make([]byte, 4096), 0o600)
+	}
+}
+
+func TestIterativeCheckpointConverges(t *testing.T) {
+	dir := t.TempDir()
+	var calls []CheckpointOptions
+	res, err := iterativeCheckpoint(fakeDump(t, []int64{1 << 20, 256 << 10, 1 << 10}, &calls),
+		MigrationOptions{Dir: dir, DirtyBytes: 4 << 10, Checkpoint: CheckpointOptions{TCPEstablished: true}})
+	if err != nil {
+		t.Fatalf("iterativeCheckpoint failed: %v", err)
+	}
+	// Three pre-dumps (the third is below DirtyBytes), then the final dump
+	if len(res.PreDumps) != 3 || len(calls) != 4 {
+		t.Fatalf("got %d pre-dumps and %d dumps, want 3 and 4", len(res.PreDumps), len(calls))
+	}
+	for i, c := range calls {
+		pre := i < 3
+		if c.PreDump != pre || !c.TCPEstablished {
+			t.Errorf("dump %d: PreDump=%v TCPEstablished=%v", i, c.PreDump, c.TCPEstablished)
+		}
+	}
+	if calls[0].ParentPath != "" || calls[1].ParentPath != "../pre-1" || calls[3].ParentPath != "../pre-3" {
+		t.Errorf("parent chain = %q, %q, %q", calls[0].ParentPath, calls[1].ParentPath, calls[3].ParentPath)
+	}
+	if res.PreDumps[0].Bytes != 1<<20 {
+		t.Errorf("pre-dump bytes = %d, want only the pages images counted", res.PreDumps[0].Bytes)
+	}
+	if res.ImagePath != filepath.Join(dir, "final") || res.Final.Path != res.ImagePath {
+		t.Errorf("ImagePath = %q", res.ImagePath)
+	}
+}
+
+func TestIterativeCheckpointStopsWhenNotShrinking(t *testing.T) {
+	var calls []CheckpointOptions
+	res, err := iterativeCheckpoint(fakeDump(t, []int64{1 << 20, 1000 << 10, 64}, &calls),
+		MigrationOptions{Dir: t.TempDir(), DirtyBytes: 4 << 10, MaxPreDumps: 5})
+	if err != nil {
+		t.Fatalf("iterativeCheckpoint failed: %v", err)
+	}
+	if len(res.PreDumps) != 2 {
+		t.Errorf("got %d pre-dumps, want 2 (second did not shrink)", len(res.PreDumps))
+	}
+
+	calls = nil
+	res, err = iterativeCheckpoint(fakeDump(t, []int64{8 << 20, 4 << 20, 2 << 20}, &calls),
+		MigrationOptions{Dir: t.TempDir(), DirtyBytes: 4 << 10, MaxPreDumps: 2})
+	if err != nil {
+		t.Fatalf("iterativeCheckpoint failed: %v", err)
+	}
+	if len(res.PreDumps) != 2 || len(calls) != 3 {
+		t.Errorf("got %d pre-dumps and %d dumps, want MaxPreDumps (2) and 3", len(res.PreDumps), len(calls))
+	}
+}
+
+func TestIterativeCheckpointError(t *testing.T) {
+	boom := errors.New("boom")
+	n := 0
+	_, err := iterativeCheckpoint(func(CheckpointOptions) error {
+		if n++; n == 2 {
+			return boom
+		}
+		return nil
+	}, MigrationOptions{Dir: t.TempDir(), DirtyBytes: 1})
+	if err != boom {
+		t.Errorf("err = %v, want the dump error", err)
+	}
+	if _, err := iterativeCheckpoint(nil, MigrationOptions{}); err == nil {
+		t.Error("missing directory accepted")
+	}
+}
+
+func TestCheckpointRestoreValidation(t *testing.T) {
+	rc := fakeStateRoot(t, "c1")
+	if err := rc.Get("c1").Checkpoint(CheckpointOptions{}); err == nil {
+		t.Error("Checkpoint without image path succeeded")
+	}
+	if _, err := rc.Restore("c1", RestoreOptions{}); err == nil {
+		t.Error("Restore without image path succeeded")
+	}
+	// Fake containers are not running: the dump itself fails
+	if err := rc.Get("c1").Checkpoint(CheckpointOptions{ImagePath: t.TempDir()}); err == nil {
+		t.Error("Checkpoint of a stopped container succeeded")
+	}
+}
@@ -0,0 +1,225 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"runtime"
+	"sync/atomic"
+	"unsafe"
+)
+
+// CMemStats reports the C allocations the binding holds, which the Go GC
+// does not see: the parsed specs of ContainerSpec, the contexts of
+// RuntimeContext and their per-call clones, and the pid arrays of the
+// calls reading a cgroup's processes. Sizes are estimates of what the
+// allocator holds, not exact counts.
+type CMemStats struct {
+	// Specs and SpecBytes are the live ContainerSpecs and their estimated
+	// size. A parsed spec costs about twice its JSON: libcrun keeps the
+	// text, as the container's config.json, next to the tree.
+	Specs, SpecBytes int64
+	// Contexts and ContextBytes are the live RuntimeContexts and their
+	// estimated size, clones included.
+	Contexts, ContextBytes int64
+	// ContextClones are the per-call clones, in use or idle.
+	ContextClones int64
+	// PidArrays and PidArrayBytes are the pid arrays being copied out of
+	// libcrun.
+	PidArrays, PidArrayBytes int64
+
+	// SpecsLoaded and SpecsFreed count the specs loaded and released;
+	// SpecsFinalized counts those released by their finalizer because
+	// Close was never called (leaked until the GC ran). Likewise for the
+	// contexts.
+	SpecsLoaded, SpecsFreed, SpecsFinalized           int64
+	ContextsCreated, ContextsFreed, ContextsFinalized int64
+
+	// GCs counts the collections forced because the estimated C memory
+	// went past the threshold of SetCMemGCThreshold.
+	GCs int64
+}
+
+// Bytes is the total estimated C memory.
+func (s CMemStats) Bytes() int64 { return s.SpecBytes + s.ContextBytes + s.PidArrayBytes }
+
+// defaultCMemGCThreshold is the initial threshold of SetCMemGCThreshold.
+const defaultCMemGCThreshold = 64 << 20
+
+var cmem struct {
+	specs, specBytes         atomic.Int64
+	contexts, contextBytes   atomic.Int64
+	clones                   atomic.Int64
+	pidArrays, pidArrayBytes atomic.Int64
+
+	specsLoaded, specsFreed, specsFinalized           atomic.Int64
+	contextsCreated, contextsFreed, contextsFinalized atomic.Int64
+
+	threshold atomic.Int64 // bytes; 0 disables forced collections
+	next      atomic.Int64 // bytes that trigger the next forced collection
+	gcRunning atomic.Bool
+	gcs       atomic.Int64
+}
+
+func init() {
+	cmem.threshold.Store(defaultCMemGCThreshold)
+	cmem.next.Store(defaultCMemGCThreshold)
+}
+
+// ReadCMemStats returns the current C memory accounting.
+func ReadCMemStats() CMemStats {
+	return CMemStats{
+		Specs:             cmem.specs.Load(),
+		SpecBytes:         cmem.specBytes.Load(),
+		Contexts:          cmem.contexts.Load(),
+		ContextBytes:      cmem.contextBytes.Load(),
+		ContextClones:     cmem.clones.Load(),
+		PidArrays:         cmem.pidArrays.Load(),
+		PidArrayBytes:     cmem.pidArrayBytes.Load(),
+		SpecsLoaded:       cmem.specsLoaded.Load(),
+		SpecsFreed:        cmem.specsFreed.Load(),
+		SpecsFinalized:    cmem.specsFinalized.Load(),
+		ContextsCreated:   cmem.contextsCreated.Load(),
+		ContextsFreed:     cmem.contextsFreed.Load(),
+		ContextsFinalized: cmem.contextsFinalized.Load(),
+		GCs:               cmem.gcs.Load(),
+	}
+}
+
+// SetCMemGCThreshold sets the estimated C memory (CMemStats.Bytes) past
+// which the binding forces a garbage collection, so that the finalizers of
+// unreachable specs and contexts release their C memory: the GC paces
+// itself on the Go heap only, and a program creating specs at a high rate
+// would otherwise let its RSS run far ahead of what the GC sees. Like
+// GOGC, the next collection is forced once the C memory live after the
+// previous one has doubled, and never below bytes. 0 or less disables
+// forced collections. It returns the previous threshold; the initial one
+// is 64 MiB.
+func SetCMemGCThreshold(bytes int64) int64 {
+	bytes = max(bytes, 0)
+	prev := cmem.threshold.Swap(bytes)
+	cmem.next.Store(bytes)
+	return prev
+}
+
+// cmemGrew runs after every allocation accounted for: it starts a
+// collection when the C memory went past the threshold, unless one is
+// running.
+func cmemGrew() {
+	threshold := cmem.threshold.Load()
+	if threshold <= 0 || ReadCMemStats().Bytes() < cmem.next.Load() {
+		return
+	}
+	if !cmem.gcRunning.CompareAndSwap(false, true) {
+		return
+	}
+	go func() {
+		defer cmem.gcRunning.Store(false)
+		runtime.GC()
+		// The finalizers queued by the collection run on their own
+		// goroutine; this is the live memory as well as can be told
+		cmem.gcs.Add(1)
+		cmem.next.Store(max(threshold, 2*ReadCMemStats().Bytes()))
+	}()
+}
+
+// trackSpec accounts for c, freshly loaded, and installs its finalizer.
+func trackSpec(c *ContainerSpec) {
+	c.cost = specCost(c.c)
+	cmem.specs.Add(1)
+	cmem.specBytes.Add(c.cost)
+	cmem.specsLoaded.Add(1)
+	runtime.SetFinalizer(c, func(cc *ContainerSpec) {
+		if cc.c != nil {
+			cmem.specsFinalized.Add(1)
+		}
+		_ = cc.Close()
+	})
+	cmemGrew()
+}
+
+// untrackSpec accounts for the release of c.
+func untrackSpec(c *ContainerSpec) {
+	cmem.specs.Add(-1)
+	cmem.specBytes.Add(-c.cost)
+	cmem.specsFreed.Add(1)
+}
+
+// specCost estimates the C memory of a parsed spec: its JSON text, which
+// libcrun keeps, and about as much again for the parsed tree.
+func specCost(ctr *C.libcrun_container_t) int64 {
+	n := int64(unsafe.Sizeof(*ctr)) + int64(unsafe.Sizeof(*ctr.container_def))
+	if ctr.config_file_content != nil {
+		n += 2 * int64(C.strlen(ctr.config_file_content))
+	}
+	return n
+}
+
+// trackContext accounts for x, freshly created, and installs its
+// finalizer.
+func trackContext(x *RuntimeContext) {
+	x.cost = contextCost(x.c)
+	cmem.contexts.Add(1)
+	cmem.contextBytes.Add(x.cost)
+	cmem.contextsCreated.Add(1)
+	runtime.SetFinalizer(x, func(xx *RuntimeContext) {
+		if xx.c != nil {
+			cmem.contextsFinalized.Add(1)
+		}
+		_ = xx.Close()
+	})
+	cmemGrew()
+}
+
+// untrackContext accounts for the release of x.
+func untrackContext(x *RuntimeContext) {
+	cmem.contexts.Add(-1)
+	cmem.contextBytes.Add(-x.cost)
+	cmem.contextsFreed.Add(1)
+}
+
+// contextCost estimates the C memory of a context and its strings.
+func contextCost(c *C.libcrun_context_t) int64 {
+	n := int64(unsafe.Sizeof(*c))
+	for _, s := range []*C.char{c.state_root, c.id, c.bundle, c.console_socket, c.pid_file, c.notify_socket, c.handler} {
+		if s != nil {
+			n += int64(C.strlen(s)) + 1
+		}
+	}
+	return n
+}
+
+// contextCloneCost is the C memory of a context clone, its id aside.
+const contextCloneCost = int64(unsafe.Sizeof(C.libcrun_context_t{}))
+
+func trackContextClone() {
+	cmem.clones.Add(1)
+	cmem.contextBytes.Add(contextCloneCost)
+	cmemGrew()
+}
+
+// freeContextClone frees cl, a clone from go_crun_clone_context, if not
+// nil.
+func freeContextClone(cl *C.libcrun_context_t) {
+	if cl == nil {
+		return
+	}
+	C.go_crun_free_context_clone(cl)
+	cmem.clones.Add(-1)
+	cmem.contextBytes.Add(-contextCloneCost)
+}
+
+// trackPidArray accounts for an array of n pids until the returned func
+// is called.
+func trackPidArray(n int) func() {
+	bytes := int64(n) * int64(unsafe.Sizeof(C.pid_t(0)))
+	cmem.pidArrays.Add(1)
+	cmem.pidArrayBytes.Add(bytes)
+	return func() {
+		cmem.pidArrays.Add(-1)
+		cmem.pidArrayBytes.Add(-bytes)
+	}
+}
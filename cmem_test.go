@@ -0,0 +1,105 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"runtime"
+	"testing"
+)
+
+func TestCMemStatsSpec(t *testing.T) {
+	before := ReadCMemStats()
+	spec, err := NewSpec(true, WithArgs("/bin/true"))
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	if spec.cost <= 0 {
+		t.Fatalf("spec cost = %d", spec.cost)
+	}
+	live := ReadCMemStats()
+	if live.SpecsLoaded-before.SpecsLoaded != 1 {
+		t.Errorf("SpecsLoaded grew by %d, want 1", live.SpecsLoaded-before.SpecsLoaded)
+	}
+	if live.Specs < 1 || live.SpecBytes < spec.cost {
+		t.Errorf("live specs = %d (%d bytes), want at least 1 (%d bytes)", live.Specs, live.SpecBytes, spec.cost)
+	}
+	spec.Close()
+	spec.Close()
+	if freed := ReadCMemStats().SpecsFreed - before.SpecsFreed; freed < 1 {
+		t.Errorf("SpecsFreed grew by %d after Close", freed)
+	}
+}
+
+func TestCMemStatsSpecFinalized(t *testing.T) {
+	before := ReadCMemStats().SpecsFinalized
+	func() {
+		if _, err := NewSpec(true); err != nil {
+			t.Fatalf("NewSpec failed: %v", err)
+		}
+	}()
+	waitFor(t, "the leaked spec to be finalized", func() bool {
+		runtime.GC()
+		return ReadCMemStats().SpecsFinalized > before
+	})
+}
+
+func TestCMemStatsContext(t *testing.T) {
+	before := ReadCMemStats()
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	if rc.cost <= 0 {
+		t.Fatalf("context cost = %d", rc.cost)
+	}
+	cl, err := rc.acquireContext("c1")
+	if err != nil {
+		t.Fatalf("acquireContext failed: %v", err)
+	}
+	if n := ReadCMemStats().ContextClones; n < 1 {
+		t.Errorf("ContextClones = %d with a clone in use", n)
+	}
+	rc.releaseContext(cl)
+	clones := ReadCMemStats().ContextClones
+	cl, _ = rc.acquireContext("c2") // reused from the free list
+	rc.releaseContext(cl)
+	if n := ReadCMemStats().ContextClones; n != clones {
+		t.Errorf("ContextClones = %d after reusing a clone, want %d", n, clones)
+	}
+	rc.Close()
+	after := ReadCMemStats()
+	if after.ContextsCreated-before.ContextsCreated != 1 || after.ContextsFreed-before.ContextsFreed < 1 {
+		t.Errorf("contexts created/freed grew by %d/%d, want 1/1",
+			after.ContextsCreated-before.ContextsCreated, after.ContextsFreed-before.ContextsFreed)
+	}
+	if after.ContextClones != clones-1 {
+		t.Errorf("ContextClones = %d after Close, want %d", after.ContextClones, clones-1)
+	}
+}
+
+func TestCMemGCThreshold(t *testing.T) {
+	prev := SetCMemGCThreshold(1)
+	t.Cleanup(func() { SetCMemGCThreshold(prev) })
+	if prev != defaultCMemGCThreshold {
+		t.Errorf("initial threshold = %d, want %d", prev, defaultCMemGCThreshold)
+	}
+	before := ReadCMemStats().GCs
+	spec, err := NewSpec(true)
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	defer spec.Close()
+	waitFor(t, "a forced collection", func() bool { return ReadCMemStats().GCs > before })
+
+	SetCMemGCThreshold(0)
+	waitFor(t, "the collection to end", func() bool { return !cmem.gcRunning.Load() })
+	before = ReadCMemStats().GCs
+	s2, err := NewSpec(true)
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	s2.Close()
+	if n := ReadCMemStats().GCs; n != before {
+		t.Errorf("%d collections forced with the threshold disabled", n-before)
+	}
+}
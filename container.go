@@ -4,6 +4,7 @@ package crun
 
 import (
 	"encoding/json"
+	"sync"
 
 	specs "github.com/opencontainers/runtime-spec/specs-go"
 )
@@ -12,39 +13,53 @@ import (
 type Container struct {
 	ID      string
 	runtime *RuntimeContext
+	res     resourceCache // values applied by Update
+
+	refOnce  sync.Once
+	cref     *containerRef // C id and cached status, see ref
+	launched bool          // started or exec'd into through this context (pidfd Kill)
 }
 
 // Start starts a previously created container.
 func (c *Container) Start() error {
-	return c.runtime.startContainer(c.ID)
+	return c.runtime.startContainer(c.ID, c.ref())
 }
 
 // Kill sends a signal to the container's init process.
 func (c *Container) Kill(sig Signal) error {
-	return c.runtime.killContainer(c.ID, sig)
+	return c.runtime.killContainer(c.ID, c.ref(), sig)
 }
 
 // Delete removes the container.
 func (c *Container) Delete(force bool) error {
-	return c.runtime.deleteContainer(c.ID, force)
+	return c.runtime.deleteContainer(c.ID, c.ref(), force)
 }
 
 // State returns the current state of the container.
 func (c *Container) State() (*ContainerState, error) {
-	jsonStr, err := c.runtime.containerStateJSON(c.ID)
-	if err != nil {
-		return nil, err
-	}
 	var state ContainerState
-	if err := json.Unmarshal([]byte(jsonStr), &state); err != nil {
+	if err := c.runtime.readState(c.ID, c.ref(), true, &state, nil); err != nil {
 		return nil, err
 	}
 	return &state, nil
 }
 
+// Status returns the container's status and, while it is running, its pid.
+// It reads only libcrun's status file, skipping the bundle, creation time
+// and annotations that State loads, and does not allocate on the Go heap;
+// use it for frequent polling. While the container's init lives, the
+// handle serves the status file from its cache.
+func (c *Container) Status() (ContainerStatus, int, error) {
+	var state ContainerState
+	if err := c.runtime.readState(c.ID, c.ref(), false, &state, nil); err != nil {
+		return "", 0, err
+	}
+	return state.Status, state.Pid, nil
+}
+
 // StateJSON returns the raw JSON state of the container.
 func (c *Container) StateJSON() (string, error) {
-	return c.runtime.containerStateJSON(c.ID)
+	return c.runtime.containerStateJSON(c.ID, c.ref())
 }
 
 // execConfig holds configuration for exec operations.
@@ -52,6 +67,7 @@ type execConfig struct {
 	detach   bool
 	terminal bool
 	cwd      string
+	cgroup   string
 }
 
 // ExecOption is a functional option for configuring exec operations.
@@ -72,8 +88,40 @@ func WithWorkingDir(cwd string) ExecOption {
 	return func(c *execConfig) { c.cwd = cwd }
 }
 
+// WithExecCgroup places the exec process in the given sub-cgroup of the
+// container (cgroup v2), e.g. to account probes separately.
+func WithExecCgroup(path string) ExecOption {
+	return func(c *execConfig) { c.cgroup = path }
+}
+
 // Exec executes a process in the container.
 func (c *Container) Exec(proc *specs.Process, opts ...ExecOption) error {
+	b, cfg, err := execProcessJSON(proc, opts)
+	if err != nil {
+		return err
+	}
+	return c.runtime.execJSON(c.ID, c.ref(), string(b), cfg.cgroup)
+}
+
+// ExecWithIO executes a process in the container with isolated I/O
+// streams, like RunWithIO does for containers: a forked child performs the
+// exec with ioCfg's stdin/stdout/stderr and lives as long as the process.
+// It returns once the process is launched; Wait on the result reports its
+// exit code and, with pidfds, parks the goroutine rather than an OS thread,
+// so many execs can run in parallel.
+//
+// ioCfg.Launcher and ioCfg.Spawn are not used. WithDetach does not apply:
+// the process is always waited for by its child, and reaped by Wait.
+func (c *Container) ExecWithIO(proc *specs.Process, ioCfg *IOConfig, opts ...ExecOption) (*RunResult, error) {
+	b, cfg, err := execProcessJSON(proc, opts)
+	if err != nil {
+		return nil, err
+	}
+	return c.runtime.execWithIO(c.ID, c.ref(), string(b), nil, nil, cfg.cgroup, ioCfg)
+}
+
+// execProcessJSON applies opts to a copy of proc and serializes it.
+func execProcessJSON(proc *specs.Process, opts []ExecOption) ([]byte, *execConfig, error) {
 	cfg := &execConfig{}
 	for _, opt := range opts {
 		opt(cfg)
@@ -90,43 +138,45 @@ func (c *Container) Exec(proc *specs.Process, opts ...ExecOption) error {
 
 	b, err := json.Marshal(&execProc)
 	if err != nil {
-		return err
+		return nil, nil, err
 	}
-	return c.runtime.execJSON(c.ID, string(b))
+	return b, cfg, nil
 }
 
-// UpdateResources updates the container's resource limits.
+// UpdateResources updates the container's resource limits. See Update for
+// a typed variant that only writes the values that change.
 func (c *Container) UpdateResources(res *specs.LinuxResources) error {
 	b, err := json.Marshal(res)
 	if err != nil {
 		return err
 	}
-	return c.runtime.updateContainer(c.ID, string(b))
+	c.res.reset()
+	return c.runtime.updateContainer(c.ID, c.ref(), string(b))
 }
 
 // Pause pauses/freezes the container.
 func (c *Container) Pause() error {
-	return c.runtime.pauseContainer(c.ID)
+	return c.runtime.pauseContainer(c.ID, c.ref())
 }
 
 // Unpause unpauses/thaws the container.
 func (c *Container) Unpause() error {
-	return c.runtime.unpauseContainer(c.ID)
+	return c.runtime.unpauseContainer(c.ID, c.ref())
 }
 
 // KillAll sends a signal to all processes in the container.
 func (c *Container) KillAll(sig Signal) error {
-	return c.runtime.killAllContainer(c.ID, sig)
+	return c.runtime.killAllContainer(c.ID, c.ref(), sig)
 }
 
 // IsRunning returns true if the container is currently running.
 func (c *Container) IsRunning() (bool, error) {
-	return c.runtime.isContainerRunning(c.ID)
+	return c.runtime.isContainerRunning(c.ID, c.ref())
 }
 
 // PIDs returns the list of process IDs in the container.
 // If recurse is true, includes PIDs from child cgroups.
 func (c *Container) PIDs(recurse bool) ([]int, error) {
-	return c.runtime.containerPIDs(c.ID, recurse)
+	return c.runtime.containerPIDs(c.ID, c.ref(), recurse)
 }
 
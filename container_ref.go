@@ -0,0 +1,78 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"runtime"
+	"sync"
+	"unsafe"
+)
+
+// containerRef is the C side of a Container handle: its id as a C string,
+// converted once, and its libcrun status (pid, process start time, cgroup
+// path) as last read from state_root. Kill, IsRunning, Status and PIDs
+// reuse the status while the pid is alive with the recorded start time,
+// which rules out pid reuse, and only read the status file again once the
+// process is gone. The cache is per handle; operations using it are
+// serialized.
+//
+// For containers launched through this context, Kill also keeps a pidfd of
+// the init process, opened on first use, and signals it with a single
+// pidfd_send_signal, which cannot hit a reused pid. Other handles, and
+// kernels without pidfds, signal through libcrun.
+type containerRef struct {
+	mu sync.Mutex // guards c.status and c.cached
+	c  *C.struct_go_crun_container_ref
+}
+
+// ref returns the handle's containerRef, allocating it on first use.
+func (c *Container) ref() *containerRef {
+	c.refOnce.Do(func() {
+		// C.malloc never returns nil
+		cr := (*C.struct_go_crun_container_ref)(C.malloc(C.size_t(unsafe.Sizeof(C.struct_go_crun_container_ref{}))))
+		C.memset(unsafe.Pointer(cr), 0, C.size_t(unsafe.Sizeof(*cr)))
+		cr.id = C.CString(c.ID)
+		cr.pidfd = -1
+		if c.launched {
+			cr.use_pidfd = 1
+		}
+		r := &containerRef{c: cr}
+		runtime.SetFinalizer(r, func(r *containerRef) { C.go_crun_ref_free(r.c) })
+		c.cref = r
+	})
+	return c.cref
+}
+
+// cidFor returns the C id of container id: r's when r is set (a call
+// through a Container handle), else a fresh copy. Pass it to release once
+// the call is done.
+func (r *containerRef) cidFor(id string) *C.char {
+	if r == nil {
+		return C.CString(id)
+	}
+	return r.c.id
+}
+
+// release frees a cid returned by cidFor, and keeps r (whose finalizer
+// frees its id) alive until then.
+func (r *containerRef) release(cid *C.char) {
+	if r == nil {
+		C.free(unsafe.Pointer(cid))
+	}
+	runtime.KeepAlive(r)
+}
+
+// invalidate drops the cached status, e.g. once the container is deleted.
+func (r *containerRef) invalidate() {
+	if r == nil {
+		return
+	}
+	r.mu.Lock()
+	C.go_crun_ref_invalidate(r.c)
+	r.mu.Unlock()
+}
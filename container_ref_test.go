@@ -0,0 +1,176 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"unsafe"
+)
+
+// fakeLiveContainer writes a status file for id whose init is a real
+// sleep process, and returns that process.
+func fakeLiveContainer(t testing.TB, rc *RuntimeContext, id string) *exec.Cmd {
+	t.Helper()
+	return fakeLiveContainerCmd(t, rc, id, exec.Command("sleep", "60"))
+}
+
+// fakeLiveContainerCmd is fakeLiveContainer with cmd as the init.
+func fakeLiveContainerCmd(t testing.TB, rc *RuntimeContext, id string, cmd *exec.Cmd) *exec.Cmd {
+	t.Helper()
+	if err := cmd.Start(); err != nil {
+		t.Fatalf("Start failed: %v", err)
+	}
+	t.Cleanup(func() {
+		cmd.Process.Kill()
+		cmd.Wait()
+	})
+	stat, err := os.ReadFile("/proc/" + strconv.Itoa(cmd.Process.Pid) + "/stat")
+	if err != nil {
+		t.Fatalf("ReadFile failed: %v", err)
+	}
+	// starttime is the 22nd field, the 20th after the parenthesized comm
+	fields := strings.Fields(string(stat[strings.LastIndexByte(string(stat), ')')+1:]))
+	status := `{"pid":` + strconv.Itoa(cmd.Process.Pid) + `,"process-start-time":` + fields[19] +
+		`,"cgroup-path":"","scope":"","rootfs":"/rootfs","systemd-cgroup":false,"bundle":"/bundle",` +
+		`"created":"2024-05-06T07:08:09Z","detached":true,"external_descriptors":"[]"}`
+	stateRoot := goStringAt(unsafe.Pointer(rc.c.state_root))
+	writeFakeContainer(t, stateRoot, id)
+	if err := os.WriteFile(filepath.Join(stateRoot, id, "status"), []byte(status), 0o600); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+	return cmd
+}
+
+func TestContainerRefCachesStatus(t *testing.T) {
+	rc := fakeStateRoot(t)
+	cmd := fakeLiveContainer(t, rc, "c1")
+	ctr := rc.Get("c1")
+
+	if running, err := ctr.IsRunning(); err != nil || !running {
+		t.Fatalf("IsRunning = %v, %v; want true", running, err)
+	}
+	// While the process lives, the cached status is used
+	stateRoot := goStringAt(unsafe.Pointer(rc.c.state_root))
+	if err := os.Remove(filepath.Join(stateRoot, "c1", "status")); err != nil {
+		t.Fatalf("Remove failed: %v", err)
+	}
+	if running, err := ctr.IsRunning(); err != nil || !running {
+		t.Fatalf("cached IsRunning = %v, %v; want true", running, err)
+	}
+	status, pid, err := ctr.Status()
+	if err != nil || status != StatusRunning || pid != cmd.Process.Pid {
+		t.Fatalf("cached Status = %q, %d, %v; want running, %d", status, pid, err, cmd.Process.Pid)
+	}
+	// A handle without the cache reads the (now missing) status file
+	if _, err := rc.Get("c1").IsRunning(); err == nil {
+		t.Error("IsRunning of a fresh handle succeeded without a status file")
+	}
+
+	if err := ctr.Kill(SIGKILL); err != nil {
+		t.Fatalf("cached Kill failed: %v", err)
+	}
+	cmd.Wait()
+	// Once the process is gone, the status file is read again
+	if _, err := ctr.IsRunning(); err == nil {
+		t.Error("IsRunning succeeded after the process exited and the status file was removed")
+	}
+}
+
+func TestContainerRefStoppedContainer(t *testing.T) {
+	ctr := fakeStateRoot(t, "c1").Get("c1")
+	for i := 0; i < 2; i++ {
+		if running, err := ctr.IsRunning(); err != nil || running {
+			t.Fatalf("IsRunning = %v, %v; want false", running, err)
+		}
+		if status, _, err := ctr.Status(); err != nil || status != StatusStopped {
+			t.Fatalf("Status = %q, %v; want stopped", status, err)
+		}
+	}
+	if err := ctr.Kill(SIGTERM); err == nil {
+		t.Error("Kill of a stopped container succeeded")
+	}
+}
+
+func BenchmarkContainerIsRunning(b *testing.B) {
+	rc := fakeStateRoot(b)
+	fakeLiveContainer(b, rc, "c1")
+	b.Run("cached", func(b *testing.B) {
+		ctr := rc.Get("c1")
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			if running, err := ctr.IsRunning(); err != nil || !running {
+				b.Fatalf("IsRunning = %v, %v", running, err)
+			}
+		}
+	})
+	b.Run("uncached", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			if running, err := rc.isContainerRunning("c1", nil); err != nil || !running {
+				b.Fatalf("IsRunning = %v, %v", running, err)
+			}
+		}
+	})
+}
+
+func TestContainerRefPidfdKill(t *testing.T) {
+	rc := fakeStateRoot(t)
+	cmd := fakeLiveContainer(t, rc, "c1")
+	ctr := &Container{ID: "c1", runtime: rc, launched: true}
+
+	if err := ctr.Kill(SIGCONT); err != nil {
+		t.Fatalf("Kill failed: %v", err)
+	}
+	if ctr.ref().c.pidfd < 0 {
+		t.Skip("pidfds not supported")
+	}
+	// Signals no longer need the status file
+	stateRoot := goStringAt(unsafe.Pointer(rc.c.state_root))
+	status, err := os.ReadFile(filepath.Join(stateRoot, "c1", "status"))
+	if err != nil {
+		t.Fatalf("ReadFile failed: %v", err)
+	}
+	if err := os.Remove(filepath.Join(stateRoot, "c1", "status")); err != nil {
+		t.Fatalf("Remove failed: %v", err)
+	}
+	if err := ctr.Kill(SIGKILL); err != nil {
+		t.Fatalf("pidfd Kill failed: %v", err)
+	}
+	cmd.Wait()
+
+	// Once the process is gone, Kill reports libcrun's error
+	if err := os.WriteFile(filepath.Join(stateRoot, "c1", "status"), status, 0o600); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+	if err := ctr.Kill(SIGTERM); err == nil {
+		t.Error("Kill of an exited process succeeded")
+	}
+	if ctr.ref().c.pidfd >= 0 {
+		t.Error("pidfd kept after the process exited")
+	}
+}
+
+func BenchmarkContainerKill(b *testing.B) {
+	rc := fakeStateRoot(b)
+	fakeLiveContainer(b, rc, "c1")
+	for _, launched := range []bool{true, false} {
+		name := "pidfd"
+		if !launched {
+			name = "libcrun"
+		}
+		b.Run(name, func(b *testing.B) {
+			ctr := &Container{ID: "c1", runtime: rc, launched: launched}
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				if err := ctr.Kill(SIGCONT); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
@@ -2,7 +2,17 @@
 
 package crun
 
-import "testing"
+import (
+	"encoding/json"
+	"errors"
+	"fmt"
+	"os"
+	"path/filepath"
+	"reflect"
+	"testing"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
 
 func TestExecOptionWithDetach(t *testing.T) {
 	cfg := &execConfig{}
@@ -34,3 +44,244 @@ func TestExecOptionWithWorkingDir(t *testing.T) {
 	}
 }
 
+func TestExecOptionWithExecCgroup(t *testing.T) {
+	cfg := &execConfig{}
+	WithExecCgroup("probes")(cfg)
+
+	if cfg.cgroup != "probes" {
+		t.Errorf("cgroup = %q, want probes", cfg.cgroup)
+	}
+}
+
+func TestExecProcessJSON(t *testing.T) {
+	proc := &specs.Process{Args: []string{"sh"}, Cwd: "/"}
+	b, cfg, err := execProcessJSON(proc, []ExecOption{WithWorkingDir("/tmp"), WithExecTTY(), WithExecCgroup("sub")})
+	if err != nil {
+		t.Fatalf("execProcessJSON failed: %v", err)
+	}
+	var got specs.Process
+	if err := json.Unmarshal(b, &got); err != nil {
+		t.Fatalf("Unmarshal failed: %v", err)
+	}
+	if got.Cwd != "/tmp" || !got.Terminal || cfg.cgroup != "sub" {
+		t.Errorf("got process %+v, cgroup %q", got, cfg.cgroup)
+	}
+	if proc.Cwd != "/" || proc.Terminal {
+		t.Error("options modified the caller's process")
+	}
+}
+
+func TestExecWithIONotRunning(t *testing.T) {
+	ctr := fakeStateRoot(t, "c1").Get("c1")
+	res, err := ctr.ExecWithIO(&specs.Process{Args: []string{"true"}, Cwd: "/"}, &IOConfig{})
+	if err != nil {
+		t.Fatalf("ExecWithIO failed: %v", err)
+	}
+	// The exec fails in the child, which reports it through its exit code
+	if code, err := res.Wait(); err != nil || code == 0 {
+		t.Errorf("Wait = %d, %v; want a non-zero exit code", code, err)
+	}
+}
+
+// writeFakeContainer writes the files libcrun keeps for a stopped container
+// (its pid does not exist), so the state readers can be exercised without
+// creating one.
+func writeFakeContainer(t testing.TB, root, id string) {
+	t.Helper()
+	dir := filepath.Join(root, id)
+	if err := os.MkdirAll(dir, 0o700); err != nil {
+		t.Fatalf("MkdirAll failed: %v", err)
+	}
+	status := `{"pid":999999999,"process-start-time":1,"cgroup-path":"","scope":"","rootfs":"/rootfs",` +
+		`"systemd-cgroup":false,"bundle":"/bundle/` + id + `","created":"2024-05-06T07:08:09.123456789Z",` +
+		`"detached":true,"external_descriptors":"[]"}`
+	config := `{"ociVersion":"1.0.0","root":{"path":"/rootfs"},"process":{"cwd":"/","args":["sh"]},` +
+		`"annotations":{"org.example.a":"1","org.example.b":"2"}}`
+	if err := os.WriteFile(filepath.Join(dir, "status"), []byte(status), 0o600); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+	if err := os.WriteFile(filepath.Join(dir, "config.json"), []byte(config), 0o600); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+}
+
+// fakeStateRoot returns a context whose state root holds fake containers ids.
+func fakeStateRoot(t testing.TB, ids ...string) *RuntimeContext {
+	t.Helper()
+	root := t.TempDir()
+	for _, id := range ids {
+		writeFakeContainer(t, root, id)
+	}
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: root})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	t.Cleanup(func() { rc.Close() })
+	return rc
+}
+
+func TestContainerStateMatchesJSON(t *testing.T) {
+	ctr := fakeStateRoot(t, "c1").Get("c1")
+
+	state, err := ctr.State()
+	if err != nil {
+		t.Fatalf("State failed: %v", err)
+	}
+	raw, err := ctr.StateJSON()
+	if err != nil {
+		t.Fatalf("StateJSON failed: %v", err)
+	}
+	var want ContainerState
+	if err := json.Unmarshal([]byte(raw), &want); err != nil {
+		t.Fatalf("Unmarshal failed: %v", err)
+	}
+	if !reflect.DeepEqual(*state, want) {
+		t.Errorf("State() = %+v\nJSON state = %+v", *state, want)
+	}
+
+	status, pid, err := ctr.Status()
+	if err != nil {
+		t.Fatalf("Status failed: %v", err)
+	}
+	if status != StatusStopped || pid != 0 {
+		t.Errorf("Status() = %q/%d, want %q/0", status, pid, StatusStopped)
+	}
+	if allocs := testing.AllocsPerRun(10, func() { _, _, _ = ctr.Status() }); allocs != 0 {
+		t.Errorf("Status allocates %v times, want 0", allocs)
+	}
+}
+
+func TestContainerStateNotFound(t *testing.T) {
+	rc := fakeStateRoot(t, "c1")
+	for _, get := range []func() error{
+		func() error { _, err := rc.Get("missing").State(); return err },
+		func() error { _, _, err := rc.Get("missing").Status(); return err },
+	} {
+		if err := get(); !errors.Is(err, ErrContainerNotFound) {
+			t.Errorf("err = %v, want ErrContainerNotFound", err)
+		}
+	}
+}
+
+func BenchmarkContainerState(b *testing.B) {
+	ctr := fakeStateRoot(b, "c1").Get("c1")
+	b.Run("JSON", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			raw, _ := ctr.StateJSON()
+			var st ContainerState
+			_ = json.Unmarshal([]byte(raw), &st)
+		}
+	})
+	b.Run("State", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			_, _ = ctr.State()
+		}
+	})
+	b.Run("Status", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			_, _, _ = ctr.Status()
+		}
+	})
+}
+
+func fakeIDs(n int) []string {
+	ids := make([]string, n)
+	for i := range ids {
+		ids[i] = fmt.Sprintf("c%04d", i)
+	}
+	return ids
+}
+
+func TestListWithState(t *testing.T) {
+	ids := fakeIDs(300)
+	rc := fakeStateRoot(t, ids...)
+
+	for _, workers := range []int{0, 1, 4} {
+		list, err := rc.ListWithState(nil, ListOptions{Workers: workers})
+		if err != nil {
+			t.Fatalf("workers=%d: ListWithState failed: %v", workers, err)
+		}
+		if len(list) != len(ids) {
+			t.Fatalf("workers=%d: got %d containers, want %d", workers, len(list), len(ids))
+		}
+		seen := make(map[string]bool)
+		for _, st := range list {
+			seen[st.ID] = true
+			if st.Status != StatusStopped || st.Pid != 0 || st.Bundle != "/bundle/"+st.ID {
+				t.Errorf("workers=%d: unexpected entry %+v", workers, st)
+			}
+			if st.Created.IsZero() || st.OciVersion == "" {
+				t.Errorf("workers=%d: entry %s misses Created/OciVersion", workers, st.ID)
+			}
+		}
+		if len(seen) != len(ids) {
+			t.Errorf("workers=%d: got %d distinct ids, want %d", workers, len(seen), len(ids))
+		}
+	}
+
+	// The entries match what the per-container State reports
+	list, _ := rc.ListWithState(nil, ListOptions{})
+	state, err := rc.Get(list[0].ID).State()
+	if err != nil {
+		t.Fatalf("State failed: %v", err)
+	}
+	state.Annotations = nil
+	if !reflect.DeepEqual(*state, list[0]) {
+		t.Errorf("ListWithState entry = %+v, State = %+v", list[0], *state)
+	}
+}
+
+func TestListWithStateReusesSlice(t *testing.T) {
+	rc := fakeStateRoot(t, fakeIDs(50)...)
+	list, err := rc.ListWithState(nil, ListOptions{})
+	if err != nil {
+		t.Fatalf("ListWithState failed: %v", err)
+	}
+	again, err := rc.ListWithState(list, ListOptions{})
+	if err != nil {
+		t.Fatalf("ListWithState failed: %v", err)
+	}
+	if &again[0] != &list[0] {
+		t.Error("dst should be reused when it has enough capacity")
+	}
+	// Only the few cgo out-parameters are allocated, not one per container
+	if allocs := testing.AllocsPerRun(5, func() { list, _ = rc.ListWithState(list, ListOptions{}) }); allocs > 5 {
+		t.Errorf("repeated sweep allocates %v times, want a constant few", allocs)
+	}
+}
+
+func TestListWithStateEmpty(t *testing.T) {
+	rc := fakeStateRoot(t)
+	list, err := rc.ListWithState(make([]ContainerState, 3), ListOptions{Workers: 8})
+	if err != nil {
+		t.Fatalf("ListWithState failed: %v", err)
+	}
+	if len(list) != 0 {
+		t.Errorf("got %d containers from an empty state root", len(list))
+	}
+}
+
+func BenchmarkListWithState(b *testing.B) {
+	rc := fakeStateRoot(b, fakeIDs(1000)...)
+	b.Run("ListThenState", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			ctrs, _ := rc.List()
+			for _, c := range ctrs {
+				_, _ = c.State()
+			}
+		}
+	})
+	for _, workers := range []int{1, 4} {
+		b.Run(fmt.Sprintf("Workers%d", workers), func(b *testing.B) {
+			var list []ContainerState
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				list, _ = rc.ListWithState(list, ListOptions{Workers: workers})
+			}
+		})
+	}
+}
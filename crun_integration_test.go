@@ -4,14 +4,18 @@ package crun
 
 import (
 	"bytes"
+	"context"
+	"encoding/json"
 	"errors"
 	"fmt"
 	"net"
 	"os"
 	"path/filepath"
+	"reflect"
 	"strconv"
 	"strings"
 	"sync"
+	"syscall"
 	"testing"
 	"time"
 
@@ -113,6 +117,95 @@ func TestIntegration_CreateStartDelete(t *testing.T) {
 	}
 }
 
+func TestIntegration_StateMatchesJSON(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "exit 0"),
+		WithAnnotation("org.example.key", "value"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	ctr, err := rc.Create("test-state-typed", spec, CreateOptions{})
+	if err != nil {
+		t.Fatalf("Failed to create container: %v", err)
+	}
+	defer ctr.Delete(true)
+
+	state, err := ctr.State()
+	if err != nil {
+		t.Fatalf("Failed to get state: %v", err)
+	}
+	raw, err := ctr.StateJSON()
+	if err != nil {
+		t.Fatalf("Failed to get JSON state: %v", err)
+	}
+	var want ContainerState
+	if err := json.Unmarshal([]byte(raw), &want); err != nil {
+		t.Fatalf("Failed to parse JSON state: %v", err)
+	}
+	if !reflect.DeepEqual(*state, want) {
+		t.Errorf("State() = %+v\nJSON state = %+v", *state, want)
+	}
+
+	status, pid, err := ctr.Status()
+	if err != nil {
+		t.Fatalf("Failed to get status: %v", err)
+	}
+	if status != want.Status || pid != want.Pid {
+		t.Errorf("Status() = %q/%d, want %q/%d", status, pid, want.Status, want.Pid)
+	}
+}
+
+func TestIntegration_WarmPool(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/true"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	pool, err := rc.NewWarmPool(spec, WarmPoolOptions{Size: 2, IDPrefix: "test-warm-"})
+	if err != nil {
+		t.Fatalf("NewWarmPool failed: %v", err)
+	}
+	defer pool.Close()
+
+	deadline := time.Now().Add(30 * time.Second)
+	for pool.Len() < 2 {
+		if time.Now().After(deadline) {
+			t.Fatalf("pool did not fill: %v", pool.Err())
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+
+	ctr, err := pool.Get(context.Background())
+	if err != nil {
+		t.Fatalf("Get failed: %v", err)
+	}
+	defer ctr.Delete(true)
+	if status, _, err := ctr.Status(); err != nil || status != StatusCreated {
+		t.Fatalf("Status = %q, %v; want created", status, err)
+	}
+	if err := ctr.Start(); err != nil {
+		t.Fatalf("Start failed: %v", err)
+	}
+}
+
 func TestIntegration_Run(t *testing.T) {
 	skipIfNotRoot(t)
 	rootfs := testRootfs(t)
@@ -154,6 +247,553 @@ func TestIntegration_Run(t *testing.T) {
 	}
 }
 
+func TestIntegration_RunWithOnLines(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "echo one; echo two >&2; printf three"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	var mu sync.Mutex
+	got := map[Stream][]string{}
+	result, err := rc.RunWithIO("test-run-lines", spec, &IOConfig{
+		OnLines: func(lines []StreamLine) {
+			mu.Lock()
+			defer mu.Unlock()
+			for _, l := range lines {
+				got[l.Stream] = append(got[l.Stream], string(l.Data))
+			}
+		},
+	})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+	if exitCode, err := result.Wait(); err != nil || exitCode != 0 {
+		t.Fatalf("Wait = %d, %v", exitCode, err)
+	}
+	defer result.Container.Delete(true)
+
+	mu.Lock()
+	defer mu.Unlock()
+	if want := []string{"one", "three"}; !reflect.DeepEqual(got[StreamStdout], want) {
+		t.Errorf("stdout lines = %q, want %q", got[StreamStdout], want)
+	}
+	if want := []string{"two"}; !reflect.DeepEqual(got[StreamStderr], want) {
+		t.Errorf("stderr lines = %q, want %q", got[StreamStderr], want)
+	}
+}
+
+func TestIntegration_RunWithIOEngine(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+	engine, err := NewIOEngine(IOEngineOptions{})
+	if err != nil {
+		t.Fatalf("NewIOEngine failed: %v", err)
+	}
+	defer engine.Close()
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "echo out; echo err >&2"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	var stdout, stderr bytes.Buffer
+	results := rc.RunBatch([]BatchItem{{ID: "test-run-engine", Spec: spec, IO: &IOConfig{
+		Stdout: &stdout, Stderr: &stderr, Engine: engine,
+	}}})
+	if results[0].Err != nil {
+		t.Fatalf("Failed to run container: %v", results[0].Err)
+	}
+	if exitCode, err := results[0].Result.Wait(); err != nil || exitCode != 0 {
+		t.Fatalf("Wait = %d, %v", exitCode, err)
+	}
+	defer results[0].Result.Container.Delete(true)
+	if stdout.String() != "out\n" || stderr.String() != "err\n" {
+		t.Errorf("stdout = %q, stderr = %q", stdout.String(), stderr.String())
+	}
+	if n := engine.Streams(); n != 0 {
+		t.Errorf("engine still serves %d streams", n)
+	}
+}
+
+func TestIntegration_RunWithTTY(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(true),
+		WithArgs("/bin/sh", "-c", "stty size"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	var out bytes.Buffer
+	res, err := rc.RunWithTTY("test-run-tty", spec, TTYConfig{Stdout: &out, Rows: 24, Cols: 100})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+	defer res.Container.Delete(true)
+	defer res.PTY.Close()
+	if exitCode, err := res.Wait(); err != nil || exitCode != 0 {
+		t.Fatalf("Wait = %d, %v", exitCode, err)
+	}
+	if got := strings.TrimSpace(out.String()); got != "24 100" {
+		t.Errorf("stty size = %q, want %q", got, "24 100")
+	}
+}
+
+func TestIntegration_RunWithIOCtxDeadline(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sleep", "30"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	ctx, cancel := context.WithTimeout(context.Background(), 500*time.Millisecond)
+	defer cancel()
+	start := time.Now()
+	result, err := rc.RunWithIOCtx(ctx, "test-run-ctx", spec, &IOConfig{})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+	defer result.Container.Delete(true)
+	if _, err := result.Wait(); !errors.Is(err, context.DeadlineExceeded) {
+		t.Fatalf("Wait = %v, want DeadlineExceeded", err)
+	}
+	if d := time.Since(start); d > 10*time.Second {
+		t.Errorf("container outlived its deadline by %v", d)
+	}
+}
+
+func TestIntegration_CreateStartCtx(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sleep", "30"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	ctx, cancel := context.WithTimeout(context.Background(), 30*time.Second)
+	defer cancel()
+	ctr, err := rc.CreateCtx(ctx, "test-create-ctx", spec, CreateOptions{})
+	if err != nil {
+		t.Fatalf("CreateCtx failed: %v", err)
+	}
+	defer ctr.Delete(true)
+	if status, _, err := ctr.Status(); err != nil || status != StatusCreated {
+		t.Fatalf("Status = %q, %v; want created", status, err)
+	}
+	if err := ctr.StartCtx(ctx); err != nil {
+		t.Fatalf("StartCtx failed: %v", err)
+	}
+	if err := ctr.ExecCtx(ctx, &specs.Process{Args: []string{"/bin/true"}, Cwd: "/"}); err != nil {
+		t.Errorf("ExecCtx failed: %v", err)
+	}
+	ctr.Kill(SIGKILL)
+}
+
+func TestIntegration_Stop(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	for _, tc := range []struct {
+		name   string
+		script string
+		killed bool
+	}{
+		{"graceful", "trap 'exit 0' TERM; while true; do sleep 0.1; done", false},
+		{"escalated", "exec sleep 30", true},
+	} {
+		t.Run(tc.name, func(t *testing.T) {
+			spec, err := NewSpec(false,
+				WithRootPath(rootfs),
+				WithContainerTTY(false),
+				WithArgs("/bin/sh", "-c", tc.script),
+			)
+			if err != nil {
+				t.Fatalf("Failed to create spec: %v", err)
+			}
+			defer spec.Close()
+			result, err := rc.RunWithIO("test-stop-"+tc.name, spec, &IOConfig{})
+			if err != nil {
+				t.Fatalf("Failed to run container: %v", err)
+			}
+			defer result.Container.Delete(true)
+			time.Sleep(200 * time.Millisecond) // let the shell set its trap
+
+			res, err := result.Container.Stop(context.Background(), time.Second)
+			if err != nil {
+				t.Fatalf("Stop failed: %v", err)
+			}
+			if res.Killed != tc.killed {
+				t.Errorf("Killed = %v, want %v", res.Killed, tc.killed)
+			}
+			if !tc.killed && res.Duration >= time.Second {
+				t.Errorf("graceful stop took %v", res.Duration)
+			}
+			result.Wait()
+			if res, err := result.Container.Stop(context.Background(), time.Second); err != nil || res != (StopResult{}) {
+				t.Errorf("Stop of a stopped container = %+v, %v", res, err)
+			}
+		})
+	}
+}
+
+func TestIntegration_RunWithLauncher(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	launcher, err := NewLauncher(2)
+	if err != nil {
+		t.Fatalf("Failed to create launcher: %v", err)
+	}
+	defer launcher.Close()
+
+	for i := 0; i < 3; i++ {
+		spec, err := NewSpec(false,
+			WithRootPath(rootfs),
+			WithContainerTTY(false),
+			WithArgs("/bin/sh", "-c", "echo hello"),
+		)
+		if err != nil {
+			t.Fatalf("Failed to create spec: %v", err)
+		}
+
+		var stdout bytes.Buffer
+		result, err := rc.RunWithIO(fmt.Sprintf("test-launcher-%d", i), spec, &IOConfig{
+			Stdout:   &stdout,
+			Launcher: launcher,
+		})
+		spec.Close()
+		if err != nil {
+			t.Fatalf("Failed to run container: %v", err)
+		}
+
+		exitCode, err := result.Wait()
+		if err != nil {
+			t.Fatalf("Failed to wait for container: %v", err)
+		}
+		if exitCode != 0 {
+			t.Errorf("Expected exit code 0, got %d", exitCode)
+		}
+		if got := strings.TrimSpace(stdout.String()); got != "hello" {
+			t.Errorf("Expected stdout 'hello', got %q", got)
+		}
+		result.Container.Delete(true)
+	}
+}
+
+func TestIntegration_RunWithSpawn(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "read line; echo $line"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	var stdout bytes.Buffer
+	result, err := rc.RunWithIO("test-spawn", spec, &IOConfig{
+		Stdin:  strings.NewReader("hello\n"),
+		Stdout: &stdout,
+		Spawn:  true,
+	})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+
+	exitCode, err := result.Wait()
+	if err != nil {
+		t.Fatalf("Failed to wait for container: %v", err)
+	}
+	if exitCode != 0 {
+		t.Errorf("Expected exit code 0, got %d", exitCode)
+	}
+	if got := strings.TrimSpace(stdout.String()); got != "hello" {
+		t.Errorf("Expected stdout 'hello', got %q", got)
+	}
+
+	if err := result.Container.Delete(true); err != nil {
+		t.Fatalf("Failed to delete container: %v", err)
+	}
+}
+
+func TestIntegration_ContextLogRouting(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	var mu sync.Mutex
+	var entries []LogEntry
+	rc.SetLogHandler(func(e LogEntry) {
+		mu.Lock()
+		entries = append(entries, e)
+		mu.Unlock()
+	})
+	rc.SetLogVerbosity(VerbosityDebug)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/true"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	result, err := rc.RunWithIO("test-log-route", spec, &IOConfig{})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+	if _, err := result.Wait(); err != nil {
+		t.Fatalf("Failed to wait for container: %v", err)
+	}
+	if err := result.Container.Delete(true); err != nil {
+		t.Fatalf("Failed to delete container: %v", err)
+	}
+
+	mu.Lock()
+	defer mu.Unlock()
+	if len(entries) == 0 {
+		t.Fatal("expected debug logs from the container child")
+	}
+	for _, e := range entries {
+		if e.ContainerID != "test-log-route" {
+			t.Errorf("entry %q tagged %q, want %q", e.Message, e.ContainerID, "test-log-route")
+		}
+	}
+	if GetVerbosity() == VerbosityDebug {
+		t.Error("per-context verbosity leaked into the process-wide setting")
+	}
+}
+
+func TestIntegration_Watch(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+	events, err := rc.Watch(ctx)
+	if err != nil {
+		t.Fatalf("Watch failed: %v", err)
+	}
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/true"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	result, err := rc.RunWithIO("test-watch", spec, &IOConfig{})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+	if _, err := result.Wait(); err != nil {
+		t.Fatalf("Failed to wait for container: %v", err)
+	}
+	if err := result.Container.Delete(true); err != nil {
+		t.Fatalf("Failed to delete container: %v", err)
+	}
+
+	want := []EventType{EventCreated, EventStarted, EventExited, EventDeleted}
+	for _, typ := range want {
+		select {
+		case ev := <-events:
+			if ev.Type != typ || ev.ID != "test-watch" {
+				t.Fatalf("got event %+v, want %s for test-watch", ev, typ)
+			}
+		case <-time.After(10 * time.Second):
+			t.Fatalf("timed out waiting for %s", typ)
+		}
+	}
+}
+
+func TestIntegration_RunBatch(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	const numContainers = 8
+	items := make([]BatchItem, numContainers)
+	outputs := make([]bytes.Buffer, numContainers)
+	for i := range items {
+		spec, err := NewSpec(false,
+			WithRootPath(rootfs),
+			WithContainerTTY(false),
+			WithArgs("/bin/sh", "-c", fmt.Sprintf("echo batch-%d", i)),
+		)
+		if err != nil {
+			t.Fatalf("Failed to create spec: %v", err)
+		}
+		defer spec.Close()
+		items[i] = BatchItem{
+			ID:   fmt.Sprintf("test-batch-%d", i),
+			Spec: spec,
+			IO:   &IOConfig{Stdout: &outputs[i]},
+		}
+	}
+
+	results := rc.RunBatch(items)
+	for i, r := range results {
+		if r.Err != nil {
+			t.Fatalf("container %d: failed to run: %v", i, r.Err)
+		}
+		exitCode, err := r.Result.Wait()
+		if err != nil {
+			t.Fatalf("container %d: failed to wait: %v", i, err)
+		}
+		if exitCode != 0 {
+			t.Errorf("container %d: expected exit code 0, got %d", i, exitCode)
+		}
+		if got, want := strings.TrimSpace(outputs[i].String()), fmt.Sprintf("batch-%d", i); got != want {
+			t.Errorf("container %d: expected stdout %q, got %q", i, want, got)
+		}
+		r.Result.Container.Delete(true)
+	}
+}
+
+func TestIntegration_RunWithOverrides(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	// One parsed spec, launched several times with different overrides
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "echo base"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	cases := []struct {
+		ov   *RunOverrides
+		want string
+	}{
+		{&RunOverrides{Args: []string{"/bin/sh", "-c", "echo one"}}, "one"},
+		{&RunOverrides{Args: []string{"/bin/sh", "-c", "echo $FOO"}, Env: []string{"FOO=two"}}, "two"},
+		{&RunOverrides{Args: []string{"/bin/hostname"}, Hostname: "three"}, "three"},
+		{nil, "base"},
+	}
+	for i, tc := range cases {
+		var stdout bytes.Buffer
+		result, err := rc.RunWithOverrides(fmt.Sprintf("test-overrides-%d", i), spec, tc.ov,
+			&IOConfig{Stdout: &stdout})
+		if err != nil {
+			t.Fatalf("case %d: failed to run container: %v", i, err)
+		}
+		if _, err := result.Wait(); err != nil {
+			t.Fatalf("case %d: failed to wait for container: %v", i, err)
+		}
+		if got := strings.TrimSpace(stdout.String()); got != tc.want {
+			t.Errorf("case %d: expected stdout %q, got %q", i, tc.want, got)
+		}
+		result.Container.Delete(true)
+	}
+}
+
+func TestIntegration_RunWithFilePassthrough(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "cat; echo done"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	dir := t.TempDir()
+	in := filepath.Join(dir, "in")
+	if err := os.WriteFile(in, []byte("hello\n"), 0644); err != nil {
+		t.Fatalf("Failed to write input: %v", err)
+	}
+	stdin, err := os.Open(in)
+	if err != nil {
+		t.Fatalf("Failed to open input: %v", err)
+	}
+	defer stdin.Close()
+	stdout, err := os.Create(filepath.Join(dir, "out"))
+	if err != nil {
+		t.Fatalf("Failed to create output: %v", err)
+	}
+	defer stdout.Close()
+
+	// Both files are handed to the container without pipes
+	result, err := rc.RunWithIO("test-passthrough", spec, &IOConfig{
+		Stdin:  stdin,
+		Stdout: stdout,
+	})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+	if exitCode, err := result.Wait(); err != nil || exitCode != 0 {
+		t.Fatalf("Wait = %d, %v; want 0, nil", exitCode, err)
+	}
+	defer result.Container.Delete(true)
+
+	got, err := os.ReadFile(stdout.Name())
+	if err != nil {
+		t.Fatalf("Failed to read output: %v", err)
+	}
+	if string(got) != "hello\ndone\n" {
+		t.Errorf("Expected output %q, got %q", "hello\ndone\n", got)
+	}
+}
+
 func TestIntegration_List(t *testing.T) {
 	skipIfNotRoot(t)
 	rootfs := testRootfs(t)
@@ -249,12 +889,103 @@ func TestIntegration_ContainerNotFound(t *testing.T) {
 		t.Fatal("Expected error for nonexistent container")
 	}
 
-	if !errors.Is(err, ErrContainerNotFound) {
-		t.Errorf("Expected ErrContainerNotFound, got %v", err)
+	if !errors.Is(err, ErrContainerNotFound) {
+		t.Errorf("Expected ErrContainerNotFound, got %v", err)
+	}
+}
+
+func TestIntegration_UpdateResources(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sleep", "300"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	ctr, err := rc.Create("test-update", spec, CreateOptions{})
+	if err != nil {
+		t.Fatalf("Failed to create container: %v", err)
+	}
+	defer ctr.Delete(true)
+
+	if err := ctr.Start(); err != nil {
+		t.Fatalf("Failed to start container: %v", err)
+	}
+
+	// Update memory limit
+	memLimit := int64(256 * 1024 * 1024)
+	err = ctr.UpdateResources(&specs.LinuxResources{
+		Memory: &specs.LinuxMemory{
+			Limit: &memLimit,
+		},
+	})
+	if err != nil {
+		t.Errorf("Failed to update resources: %v", err)
+	}
+}
+
+func TestIntegration_UpdateTyped(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sleep", "300"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	var ctrs []*Container
+	for _, id := range []string{"test-update-typed-1", "test-update-typed-2"} {
+		ctr, err := rc.Create(id, spec, CreateOptions{})
+		if err != nil {
+			t.Fatalf("Failed to create container: %v", err)
+		}
+		defer ctr.Delete(true)
+		if err := ctr.Start(); err != nil {
+			t.Fatalf("Failed to start container: %v", err)
+		}
+		ctrs = append(ctrs, ctr)
+	}
+
+	memLimit, pids := int64(128*1024*1024), int64(32)
+	if err := ctrs[0].Update(ResourceUpdate{MemoryLimit: &memLimit, PidsLimit: &pids}); err != nil {
+		t.Fatalf("Update failed: %v", err)
+	}
+	memLimit = 192 * 1024 * 1024
+	items := make([]ResourceUpdateItem, len(ctrs))
+	for i, ctr := range ctrs {
+		items[i] = ResourceUpdateItem{Container: ctr, Update: ResourceUpdate{MemoryLimit: &memLimit, PidsLimit: &pids}}
+	}
+	for i, err := range rc.UpdateMany(items) {
+		if err != nil {
+			t.Errorf("UpdateMany item %d: %v", i, err)
+		}
+	}
+	for _, ctr := range ctrs {
+		st, err := ctr.Stats()
+		if err != nil {
+			t.Fatalf("Stats failed: %v", err)
+		}
+		if st.Memory.Max != uint64(memLimit) || st.Pids.Max != uint64(pids) {
+			t.Errorf("%s: memory limit %d, pids limit %d; want %d, %d",
+				ctr.ID, st.Memory.Max, st.Pids.Max, memLimit, pids)
+		}
 	}
 }
 
-func TestIntegration_UpdateResources(t *testing.T) {
+func TestIntegration_HotMounts(t *testing.T) {
 	skipIfNotRoot(t)
 	rootfs := testRootfs(t)
 	rc := testRuntimeContext(t)
@@ -269,25 +1000,46 @@ func TestIntegration_UpdateResources(t *testing.T) {
 	}
 	defer spec.Close()
 
-	ctr, err := rc.Create("test-update", spec, CreateOptions{})
+	ctr, err := rc.Create("test-hot-mounts", spec, CreateOptions{})
 	if err != nil {
 		t.Fatalf("Failed to create container: %v", err)
 	}
 	defer ctr.Delete(true)
-
 	if err := ctr.Start(); err != nil {
 		t.Fatalf("Failed to start container: %v", err)
 	}
-
-	// Update memory limit
-	memLimit := int64(256 * 1024 * 1024)
-	err = ctr.UpdateResources(&specs.LinuxResources{
-		Memory: &specs.LinuxMemory{
-			Limit: &memLimit,
-		},
-	})
+	_, pid, err := ctr.Status()
 	if err != nil {
-		t.Errorf("Failed to update resources: %v", err)
+		t.Fatalf("Status failed: %v", err)
+	}
+
+	mounts := []specs.Mount{
+		{Destination: "/mnt/hot-a", Type: "bind", Source: t.TempDir(), Options: []string{"rbind", "rw"}},
+		{Destination: "/mnt/hot-b", Type: "bind", Source: t.TempDir(), Options: []string{"rbind", "ro"}},
+	}
+	mounted := func(dest string) bool {
+		b, err := os.ReadFile(fmt.Sprintf("/proc/%d/mountinfo", pid))
+		if err != nil {
+			t.Fatalf("ReadFile failed: %v", err)
+		}
+		return strings.Contains(string(b), " "+dest+" ")
+	}
+
+	if err := ctr.AddMounts(mounts); err != nil {
+		t.Fatalf("AddMounts failed: %v", err)
+	}
+	for _, m := range mounts {
+		if !mounted(m.Destination) {
+			t.Errorf("%s not mounted after AddMounts", m.Destination)
+		}
+	}
+	if err := ctr.RemoveMounts(mounts); err != nil {
+		t.Fatalf("RemoveMounts failed: %v", err)
+	}
+	for _, m := range mounts {
+		if mounted(m.Destination) {
+			t.Errorf("%s still mounted after RemoveMounts", m.Destination)
+		}
 	}
 }
 
@@ -343,6 +1095,109 @@ func TestIntegration_PauseUnpause(t *testing.T) {
 	}
 }
 
+func TestIntegration_ExecWithIO(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sleep", "30"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	result, err := rc.RunWithIO("test-exec-io", spec, &IOConfig{})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+	defer func() {
+		result.Container.Kill(SIGKILL)
+		result.Wait()
+		result.Container.Delete(true)
+	}()
+
+	// Several execs in parallel, each with its own stdout
+	const n = 4
+	outs := make([]bytes.Buffer, n)
+	results := make([]*RunResult, n)
+	for i := range results {
+		proc := &specs.Process{Args: []string{"/bin/sh", "-c", "echo exec-" + strconv.Itoa(i) + "; exit 3"}, Cwd: "/"}
+		results[i], err = result.Container.ExecWithIO(proc, &IOConfig{Stdout: &outs[i]})
+		if err != nil {
+			t.Fatalf("ExecWithIO %d failed: %v", i, err)
+		}
+	}
+	for i, r := range results {
+		code, err := r.Wait()
+		if err != nil {
+			t.Fatalf("Wait %d failed: %v", i, err)
+		}
+		if code != 3 {
+			t.Errorf("exec %d exit code = %d, want 3", i, code)
+		}
+		if got, want := strings.TrimSpace(outs[i].String()), "exec-"+strconv.Itoa(i); got != want {
+			t.Errorf("exec %d stdout = %q, want %q", i, got, want)
+		}
+	}
+}
+
+func TestIntegration_PreparedExec(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sleep", "30"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	result, err := rc.RunWithIO("test-prepared-exec", spec, &IOConfig{})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+	defer func() {
+		result.Container.Kill(SIGKILL)
+		result.Wait()
+		result.Container.Delete(true)
+	}()
+
+	p, err := PrepareExec(&specs.Process{Args: []string{"/bin/sh", "-c", "echo $PROBE"}, Cwd: "/", Env: []string{"PROBE=base"}})
+	if err != nil {
+		t.Fatalf("PrepareExec failed: %v", err)
+	}
+	defer p.Close()
+
+	for _, tc := range []struct {
+		ov   *ExecOverrides
+		want string
+	}{
+		{nil, "base"},
+		{&ExecOverrides{Env: []string{"PROBE=override"}}, "override"},
+		{nil, "base"},
+	} {
+		var out bytes.Buffer
+		r, err := p.ExecWithIO(result.Container, tc.ov, &IOConfig{Stdout: &out})
+		if err != nil {
+			t.Fatalf("ExecWithIO failed: %v", err)
+		}
+		if code, err := r.Wait(); err != nil || code != 0 {
+			t.Fatalf("Wait = %d, %v", code, err)
+		}
+		if got := strings.TrimSpace(out.String()); got != tc.want {
+			t.Errorf("stdout = %q, want %q", got, tc.want)
+		}
+	}
+}
+
 func TestIntegration_PIDs(t *testing.T) {
 	skipIfNotRoot(t)
 	rootfs := testRootfs(t)
@@ -832,3 +1687,307 @@ func TestIntegration_Terminal(t *testing.T) {
 		t.Fatalf("Failed to start container: %v", err)
 	}
 }
+
+func TestIntegration_OverlayRootfs(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithOverlayRootfs([]string{rootfs}, 16<<20),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "echo written > /overlay-test && cat /overlay-test"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	for i := 0; i < 2; i++ {
+		id := fmt.Sprintf("test-overlay-%d", i)
+		var stdout bytes.Buffer
+		result, err := rc.RunWithIO(id, spec, &IOConfig{Stdout: &stdout})
+		if err != nil {
+			t.Fatalf("Failed to run container: %v", err)
+		}
+		if code, err := result.Wait(); err != nil || code != 0 {
+			t.Fatalf("Wait = %d, %v", code, err)
+		}
+		if got := strings.TrimSpace(stdout.String()); got != "written" {
+			t.Errorf("Expected stdout 'written', got %q", got)
+		}
+		if err := result.Container.Delete(true); err != nil {
+			t.Fatalf("Failed to delete container: %v", err)
+		}
+		if _, err := os.Lstat(rc.overlayDir(id)); !os.IsNotExist(err) {
+			t.Errorf("overlay of %s left behind: %v", id, err)
+		}
+	}
+
+	if _, err := os.Lstat(filepath.Join(rootfs, "overlay-test")); !os.IsNotExist(err) {
+		t.Errorf("container write reached the lower layer: %v", err)
+	}
+}
+
+func TestIntegration_DeviceProgramReuse(t *testing.T) {
+	skipIfNotRoot(t)
+	var cg, bpf syscall.Statfs_t
+	if syscall.Statfs("/sys/fs/cgroup", &cg) != nil || cg.Type != 0x63677270 || // CGROUP2_SUPER_MAGIC
+		syscall.Statfs("/sys/fs/bpf", &bpf) != nil || bpf.Type != 0xcafe4a11 { // BPF_FS_MAGIC
+		t.Skip("needs cgroup v2 and a bpffs at /sys/fs/bpf")
+	}
+	rootfs := testRootfs(t)
+	rc, err := NewRuntimeContext(RuntimeConfig{Bundle: t.TempDir(), StateRoot: t.TempDir(), DeviceProgramReuse: true})
+	if err != nil {
+		t.Fatalf("Failed to create RuntimeContext: %v", err)
+	}
+	defer rc.Close()
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/true"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	pinned := func() []string {
+		names, _ := filepath.Glob("/sys/fs/bpf/libcrun-go/dev-*")
+		return names
+	}
+	before := pinned()
+	var ctrs []*Container
+	defer func() {
+		for _, ctr := range ctrs {
+			ctr.Delete(true)
+		}
+	}()
+	for i := 0; i < 2; i++ {
+		ctr, err := rc.Create(fmt.Sprintf("test-devprog-%d", i), spec, CreateOptions{})
+		if err != nil {
+			t.Fatalf("Failed to create container: %v", err)
+		}
+		ctrs = append(ctrs, ctr)
+	}
+	if after := pinned(); len(after) > len(before)+1 || len(after) == 0 {
+		t.Errorf("pinned device programs %v -> %v; want the shared program pinned once", before, after)
+	}
+
+	// The last context using reuse removes the pins on Close
+	for _, ctr := range ctrs {
+		ctr.Delete(true)
+	}
+	ctrs = nil
+	rc.Close()
+	if left := pinned(); len(left) != 0 {
+		t.Errorf("pinned device programs left after Close: %v", left)
+	}
+}
+
+func TestIntegration_SeccompAgent(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	var mu sync.Mutex
+	var containers []string
+	agent, err := NewSeccompAgent("", SeccompNotifyHandlerFunc(func(req *SeccompRequest) SeccompResponse {
+		mu.Lock()
+		containers = append(containers, req.Container)
+		mu.Unlock()
+		return SeccompResponse{Errno: syscall.EROFS}
+	}))
+	if err != nil {
+		t.Fatalf("NewSeccompAgent failed: %v", err)
+	}
+	defer agent.Close()
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "mkdir /tmp/denied || echo refused"),
+		WithSeccompNotify(agent, "mkdir", "mkdirat"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	var stdout, stderr bytes.Buffer
+	result, err := rc.RunWithIO("test-seccomp-agent", spec, &IOConfig{Stdout: &stdout, Stderr: &stderr})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+	defer result.Container.Delete(true)
+	if code, err := result.Wait(); err != nil || code != 0 {
+		t.Fatalf("Wait = %d, %v", code, err)
+	}
+	if got := strings.TrimSpace(stdout.String()); got != "refused" {
+		t.Errorf("stdout = %q, want the mkdir refused", got)
+	}
+	if !strings.Contains(stderr.String(), "Read-only file system") {
+		t.Errorf("stderr = %q, want the agent's EROFS", stderr.String())
+	}
+	mu.Lock()
+	defer mu.Unlock()
+	if len(containers) == 0 || containers[0] != "test-seccomp-agent" {
+		t.Errorf("notified containers = %v", containers)
+	}
+}
+
+func TestIntegration_WaitStatus(t *testing.T) {
+	skipIfNotRoot(t)
+	if _, err := os.Stat("/sys/fs/cgroup/cgroup.controllers"); err != nil {
+		t.Skip("Final cgroup counters need cgroup v2")
+	}
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "i=0; while [ $i -lt 100000 ]; do i=$((i+1)); done"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	for _, ioCfg := range []IOConfig{{}, {Spawn: true}} {
+		result, err := rc.RunWithIO("test-wait-status", spec, &ioCfg)
+		if err != nil {
+			t.Fatalf("Failed to run container: %v", err)
+		}
+		st, err := result.WaitStatus()
+		result.Container.Delete(true)
+		if err != nil {
+			t.Fatalf("WaitStatus failed: %v", err)
+		}
+		if st.ExitCode != 0 || st.Usage == nil {
+			t.Errorf("WaitStatus = %+v, want exit code 0 with usage", st)
+		}
+		if st.Cgroup == nil {
+			t.Fatal("WaitStatus without the final cgroup counters")
+		}
+		if st.Cgroup.ID != "test-wait-status" || st.Cgroup.CPU.UsageUsec == 0 {
+			t.Errorf("Cgroup = %+v, want the container's CPU time", *st.Cgroup)
+		}
+		if left, _ := filepath.Glob(filepath.Join(rc.stateRootDir(), ".exit-*")); len(left) != 0 {
+			t.Errorf("snapshots left in the state root: %v", left)
+		}
+	}
+}
+
+func TestIntegration_RunDetachChild(t *testing.T) {
+	skipIfNotRoot(t)
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+	if processReaper.Load() == nil {
+		r, err := newReaper(ReaperOptions{Subreaper: true})
+		if err != nil {
+			t.Fatalf("newReaper failed: %v", err)
+		}
+		processReaper.Store(r)
+		t.Cleanup(func() {
+			processReaper.Store(nil)
+			r.close()
+			syscall.RawSyscall(syscall.SYS_PRCTL, prSetChildSubreaper, 0, 0)
+		})
+	}
+
+	spec, err := NewSpec(false,
+		WithRootPath(rootfs),
+		WithContainerTTY(false),
+		WithArgs("/bin/sh", "-c", "echo started; sleep 1; exit 4"),
+	)
+	if err != nil {
+		t.Fatalf("Failed to create spec: %v", err)
+	}
+	defer spec.Close()
+
+	var stdout bytes.Buffer
+	result, err := rc.RunWithIO("test-detach-child", spec, &IOConfig{Stdout: &stdout, DetachChild: true})
+	if err != nil {
+		t.Fatalf("Failed to run container: %v", err)
+	}
+	defer result.Container.Delete(true)
+	// The child is gone while the container still runs
+	child := int(result.waiter.pid)
+	waitFor(t, "the child to exit", func() bool { return syscall.Kill(child, 0) == syscall.ESRCH })
+	if running, err := result.Container.IsRunning(); err != nil || !running {
+		t.Errorf("IsRunning after the child exited = %v, %v", running, err)
+	}
+
+	st, err := result.WaitStatus()
+	if err != nil {
+		t.Fatalf("WaitStatus failed: %v", err)
+	}
+	if st.ExitCode != 4 || st.Usage == nil {
+		t.Errorf("WaitStatus = %+v, want the init's exit code 4 with usage", st)
+	}
+	if got := strings.TrimSpace(stdout.String()); got != "started" {
+		t.Errorf("stdout = %q, want %q", got, "started")
+	}
+	if _, err := result.Container.State(); err == nil {
+		t.Error("container left behind after Wait")
+	}
+}
+
+func TestIntegration_FreezeGroup(t *testing.T) {
+	skipIfNotRoot(t)
+	if _, err := os.Stat("/sys/fs/cgroup/cgroup.controllers"); err != nil {
+		t.Skip("Freezing a cgroup group needs cgroup v2")
+	}
+	rootfs := testRootfs(t)
+	rc := testRuntimeContext(t)
+	const group = "libcrun-test-tenant"
+	defer os.Remove(filepath.Join(cgroupRoot, group))
+
+	var ctrs []*Container
+	for _, id := range []string{"test-freeze-group-1", "test-freeze-group-2"} {
+		spec, err := NewSpec(false,
+			WithRootPath(rootfs),
+			WithContainerTTY(false),
+			WithArgs("/bin/sleep", "300"),
+			WithCgroupsPath("/"+group+"/"+id),
+		)
+		if err != nil {
+			t.Fatalf("Failed to create spec: %v", err)
+		}
+		defer spec.Close()
+		ctr, err := rc.Create(id, spec, CreateOptions{})
+		if err != nil {
+			t.Fatalf("Failed to create container: %v", err)
+		}
+		defer ctr.Delete(true)
+		if err := ctr.Start(); err != nil {
+			t.Fatalf("Failed to start container: %v", err)
+		}
+		ctrs = append(ctrs, ctr)
+	}
+
+	frozen := func(id string) bool {
+		b, err := os.ReadFile(filepath.Join(cgroupRoot, group, id, "cgroup.events"))
+		return err == nil && groupFrozen(b)
+	}
+	ctx, cancel := context.WithTimeout(context.Background(), 10*time.Second)
+	defer cancel()
+	if err := rc.FreezeGroup(ctx, group); err != nil {
+		t.Fatalf("FreezeGroup failed: %v", err)
+	}
+	for _, ctr := range ctrs {
+		if !frozen(ctr.ID) {
+			t.Errorf("container %s not frozen after FreezeGroup", ctr.ID)
+		}
+	}
+	if err := rc.ThawGroup(ctx, group); err != nil {
+		t.Fatalf("ThawGroup failed: %v", err)
+	}
+	for _, ctr := range ctrs {
+		if frozen(ctr.ID) {
+			t.Errorf("container %s still frozen after ThawGroup", ctr.ID)
+		}
+	}
+}
@@ -0,0 +1,69 @@
+//go:build linux
+
+package crun
+
+import (
+	"os"
+	"syscall"
+)
+
+// epollLoop is an epoll instance waited on from the netpoller: its
+// descriptor is non-blocking, and the netpoller reports it readable when a
+// descriptor in it is, so that the goroutine of an event loop parks
+// without holding a thread. The reaper, NotifyHub and SeccompAgent run
+// theirs on one.
+type epollLoop struct {
+	f  *os.File
+	rc syscall.RawConn
+}
+
+func newEpollLoop(name string) (*epollLoop, error) {
+	epfd, err := syscall.EpollCreate1(syscall.EPOLL_CLOEXEC)
+	if err != nil {
+		return nil, os.NewSyscallError("epoll_create1", err)
+	}
+	if err := syscall.SetNonblock(epfd, true); err != nil {
+		syscall.Close(epfd)
+		return nil, os.NewSyscallError("fcntl", err)
+	}
+	f := os.NewFile(uintptr(epfd), name)
+	rc, err := f.SyscallConn()
+	if err != nil {
+		f.Close()
+		return nil, err
+	}
+	return &epollLoop{f: f, rc: rc}, nil
+}
+
+// fd returns the epoll descriptor, for epoll_ctl, without switching it to
+// blocking mode as File.Fd would. It is -1 once the loop is closed.
+func (l *epollLoop) fd() int {
+	fd := -1
+	_ = l.rc.Control(func(f uintptr) { fd = int(f) })
+	return fd
+}
+
+// wait fills events with the ready descriptors and returns their number,
+// always at least one. It fails once the loop is closed, which ends the
+// event loop.
+func (l *epollLoop) wait(events []syscall.EpollEvent) (int, error) {
+	n := 0
+	var werr error
+	err := l.rc.Read(func(fd uintptr) bool {
+		n, werr = syscall.EpollWait(int(fd), events, 0)
+		if werr == syscall.EINTR {
+			return false
+		}
+		return n > 0 || werr != nil
+	})
+	if err != nil {
+		return 0, err
+	}
+	if werr != nil {
+		return 0, os.NewSyscallError("epoll_wait", werr)
+	}
+	return n, nil
+}
+
+// close closes the epoll descriptor, making a wait in progress fail.
+func (l *epollLoop) close() error { return l.f.Close() }
@@ -0,0 +1,57 @@
+//go:build linux
+
+package crun
+
+import (
+	"syscall"
+	"testing"
+	"time"
+)
+
+func TestEpollLoop(t *testing.T) {
+	l, err := newEpollLoop("test-epoll")
+	if err != nil {
+		t.Fatalf("newEpollLoop failed: %v", err)
+	}
+	var p [2]int
+	if err := syscall.Pipe2(p[:], syscall.O_CLOEXEC|syscall.O_NONBLOCK); err != nil {
+		t.Fatal(err)
+	}
+	defer syscall.Close(p[0])
+	defer syscall.Close(p[1])
+	ev := syscall.EpollEvent{Events: syscall.EPOLLIN, Fd: int32(p[0])}
+	if err := syscall.EpollCtl(l.fd(), syscall.EPOLL_CTL_ADD, p[0], &ev); err != nil {
+		t.Fatal(err)
+	}
+
+	go func() {
+		time.Sleep(50 * time.Millisecond)
+		syscall.Write(p[1], []byte("x"))
+	}()
+	events := make([]syscall.EpollEvent, 4)
+	if n, err := l.wait(events); err != nil || n != 1 || events[0].Fd != int32(p[0]) {
+		t.Fatalf("wait = %d, %v, want the pipe ready", n, err)
+	}
+
+	// Closing ends a wait in progress
+	var buf [1]byte
+	syscall.Read(p[0], buf[:])
+	done := make(chan error)
+	go func() {
+		_, err := l.wait(events)
+		done <- err
+	}()
+	time.Sleep(50 * time.Millisecond)
+	l.close()
+	select {
+	case err := <-done:
+		if err == nil {
+			t.Error("wait succeeded on a closed loop")
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("wait not ended by close")
+	}
+	if fd := l.fd(); fd != -1 {
+		t.Errorf("fd() = %d after close, want -1", fd)
+	}
+}
@@ -2,7 +2,7 @@
 
 package crun
 
-import "strings"
+import "syscall"
 
 // ErrorCode represents specific error types from libcrun operations.
 type ErrorCode int
@@ -26,42 +26,46 @@ var (
 )
 
 // Error wraps libcrun errors with structured error codes.
+//
+// Code is assigned by the C helpers when the error is converted, so
+// checking it (or using errors.Is) does not inspect the message.
 type Error struct {
 	Code    ErrorCode
-	Message string
-	Status  int   // errno value
-	cause   error // underlying error
+	Message string // libcrun's message, without the errno description
+	Status  int    // errno value
+	cause   error  // underlying error
 }
 
-func (e *Error) Error() string { return e.Message }
+// Error returns Message, followed by the errno description when Status is
+// set. It is only formatted when called.
+func (e *Error) Error() string {
+	if e.Status == 0 {
+		return e.Message
+	}
+	return e.Message + ": " + syscall.Errno(e.Status).Error()
+}
 
 func (e *Error) Unwrap() error { return e.cause }
 
+// errnoError returns the Error of a failed system call on a cgroup or
+// inotify file, classified by its errno: only ENOENT is ErrNotFound, so
+// that a watch limit or an allocation failure does not read as a missing
+// container.
+func errnoError(msg string, err error) *Error {
+	errno, _ := err.(syscall.Errno)
+	code := ErrUnknown
+	switch errno {
+	case syscall.ENOENT:
+		code = ErrNotFound
+	case syscall.EPERM, syscall.EACCES:
+		code = ErrPermissionDenied
+	}
+	return &Error{Code: code, Message: msg, Status: int(errno), cause: err}
+}
+
 func (e *Error) Is(target error) bool {
 	if t, ok := target.(*Error); ok {
 		return e.Code == t.Code
 	}
 	return false
 }
-
-// classifyError attempts to determine the error code from the error message.
-func classifyError(msg string, status int) ErrorCode {
-	lower := strings.ToLower(msg)
-	switch {
-	case strings.Contains(lower, "not found") || strings.Contains(lower, "does not exist"):
-		return ErrNotFound
-	case strings.Contains(lower, "already exists"):
-		return ErrAlreadyExists
-	case strings.Contains(lower, "invalid") || strings.Contains(lower, "parse"):
-		return ErrInvalidSpec
-	case strings.Contains(lower, "permission") || status == 1 || status == 13: // EPERM, EACCES
-		return ErrPermissionDenied
-	case strings.Contains(lower, "not running"):
-		return ErrContainerNotRunning
-	case strings.Contains(lower, "running"):
-		return ErrContainerRunning
-	default:
-		return ErrUnknown
-	}
-}
-
@@ -4,6 +4,7 @@ package crun
 
 import (
 	"errors"
+	"syscall"
 	"testing"
 )
 
@@ -46,12 +47,73 @@ func TestClassifyError(t *testing.T) {
 		{"container is running", 0, ErrContainerRunning},
 		{"container is not running", 0, ErrContainerNotRunning},
 		{"unknown error", 0, ErrUnknown},
+		{"Container NOT FOUND", 0, ErrNotFound},  // case-insensitive
+		{"cannot open spec", 22, ErrInvalidSpec}, // strerror(EINVAL) = "Invalid argument"
 	}
 
 	for _, tt := range tests {
-		got := classifyError(tt.msg, tt.status)
+		got := classifyMessage(tt.msg, tt.status)
 		if got != tt.want {
-			t.Errorf("classifyError(%q, %d) = %v, want %v", tt.msg, tt.status, got, tt.want)
+			t.Errorf("classifyMessage(%q, %d) = %v, want %v", tt.msg, tt.status, got, tt.want)
+		}
+	}
+}
+
+func TestErrorMessage(t *testing.T) {
+	err := &Error{Code: ErrNotFound, Message: "cannot open state", Status: 2}
+	if got, want := err.Error(), "cannot open state: no such file or directory"; got != want {
+		t.Errorf("Error() = %q, want %q", got, want)
+	}
+	err.Status = 0
+	if got := err.Error(); got != "cannot open state" {
+		t.Errorf("Error() without errno = %q", got)
+	}
+}
+
+func TestErrnoError(t *testing.T) {
+	for errno, want := range map[syscall.Errno]ErrorCode{
+		syscall.ENOENT: ErrNotFound,
+		syscall.EPERM:  ErrPermissionDenied,
+		syscall.EACCES: ErrPermissionDenied,
+		syscall.ENOSPC: ErrUnknown, // max_user_watches
+		syscall.ENOMEM: ErrUnknown,
+	} {
+		err := errnoError("cannot watch", errno)
+		if err.Code != want || err.Status != int(errno) {
+			t.Errorf("errnoError(%v) = %v (status %d), want code %v", errno, err.Code, err.Status, want)
+		}
+		if !errors.Is(err, errno) {
+			t.Errorf("errnoError(%v) does not wrap its errno", errno)
+		}
+	}
+}
+
+func BenchmarkClassifyMessage(b *testing.B) {
+	msgs := []struct {
+		msg    string
+		status int
+	}{
+		{"container `c1` does not exist", 2},
+		{"container `c1` already exists", 17},
+		{"open `/run/crun/c1/status`: Permission denied", 13},
+		{"the container `c1` is not in running state", 0},
+		{"write to `/sys/fs/cgroup/c1/memory.max`: Device or resource busy", 16},
+	}
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		m := &msgs[i%len(msgs)]
+		_ = classifyMessage(m.msg, m.status)
+	}
+}
+
+// BenchmarkFromLibcrunErr measures the conversion of a libcrun error into
+// an *Error, including its classification, through the cheapest failing
+// libcrun call: parsing a truncated spec.
+func BenchmarkFromLibcrunErr(b *testing.B) {
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if _, err := LoadContainerSpecFromJSON("{"); err == nil {
+			b.Fatal("LoadContainerSpecFromJSON accepted invalid JSON")
 		}
 	}
 }
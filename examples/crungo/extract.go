@@ -0,0 +1,460 @@
+//go:build linux && cgo
+
+package main
+
+import (
+	"archive/tar"
+	"fmt"
+	"io"
+	"os"
+	"path/filepath"
+	"strings"
+	"syscall"
+	"unsafe"
+)
+
+// Constants and *at calls missing from package syscall.
+const (
+	oPath             = 0x200000   // O_PATH
+	atSymlinkNofollow = 0x100      // AT_SYMLINK_NOFOLLOW
+	atRemovedir       = 0x200      // AT_REMOVEDIR
+	ficlone           = 0x40049409 // FICLONE
+)
+
+func symlinkat(target string, dirfd int, name string) error {
+	t, err := syscall.BytePtrFromString(target)
+	if err != nil {
+		return err
+	}
+	n, err := syscall.BytePtrFromString(name)
+	if err != nil {
+		return err
+	}
+	if _, _, errno := syscall.Syscall(syscall.SYS_SYMLINKAT, uintptr(unsafe.Pointer(t)), uintptr(dirfd), uintptr(unsafe.Pointer(n))); errno != 0 {
+		return errno
+	}
+	return nil
+}
+
+func linkat(olddirfd int, oldname string, newdirfd int, newname string) error {
+	o, err := syscall.BytePtrFromString(oldname)
+	if err != nil {
+		return err
+	}
+	n, err := syscall.BytePtrFromString(newname)
+	if err != nil {
+		return err
+	}
+	if _, _, errno := syscall.Syscall6(syscall.SYS_LINKAT, uintptr(olddirfd), uintptr(unsafe.Pointer(o)), uintptr(newdirfd), uintptr(unsafe.Pointer(n)), 0, 0); errno != 0 {
+		return errno
+	}
+	return nil
+}
+
+// extractor unpacks tar entries under a root directory with *at calls
+// relative to directory fds, instead of resolving every path from /. It
+// remembers the directories it has made sure exist, keeps the fd of the
+// last parent directory open (entries are grouped by directory), and only
+// removes an existing path when creating an entry fails with EEXIST.
+type extractor struct {
+	root     string
+	rootFd   int
+	dirs     map[string]bool // directories known to exist, relative to root
+	parent   string
+	parentFd int
+	chown    bool
+	buf      []byte
+	lazy     *lazyLayer // set while extracting an eStargz layer lazily
+}
+
+func newExtractor(root string) (*extractor, error) {
+	fd, err := syscall.Open(root, syscall.O_DIRECTORY|syscall.O_RDONLY|syscall.O_CLOEXEC, 0)
+	if err != nil {
+		return nil, &os.PathError{Op: "open", Path: root, Err: err}
+	}
+	return &extractor{
+		root:     root,
+		rootFd:   fd,
+		dirs:     map[string]bool{".": true},
+		parentFd: -1,
+		chown:    os.Geteuid() == 0,
+		buf:      make([]byte, 128<<10),
+	}, nil
+}
+
+func (e *extractor) close() {
+	e.forget()
+	syscall.Close(e.rootFd)
+}
+
+// forget drops the directory cache, after a removal that may have taken
+// cached directories with it.
+func (e *extractor) forget() {
+	if e.parentFd >= 0 {
+		syscall.Close(e.parentFd)
+	}
+	e.parent, e.parentFd = "", -1
+	e.dirs = map[string]bool{".": true}
+}
+
+// mkdirAll creates the directory rel and its missing parents with mode.
+func (e *extractor) mkdirAll(rel string, mode uint32) error {
+	if e.dirs[rel] {
+		return nil
+	}
+	if err := e.mkdirAll(filepath.Dir(rel), 0o755); err != nil {
+		return err
+	}
+	if err := syscall.Mkdirat(e.rootFd, rel, mode); err != nil && err != syscall.EEXIST {
+		return err
+	}
+	e.dirs[rel] = true
+	return nil
+}
+
+// dirFd returns an fd of the directory rel, creating it if needed. It is
+// owned by the extractor.
+func (e *extractor) dirFd(rel string) (int, error) {
+	if rel == "." {
+		return e.rootFd, nil
+	}
+	if rel == e.parent {
+		return e.parentFd, nil
+	}
+	if err := e.mkdirAll(rel, 0o755); err != nil {
+		return -1, err
+	}
+	fd, err := syscall.Openat(e.rootFd, rel, oPath|syscall.O_DIRECTORY|syscall.O_CLOEXEC, 0)
+	if err != nil {
+		return -1, err
+	}
+	if e.parentFd >= 0 {
+		syscall.Close(e.parentFd)
+	}
+	e.parent, e.parentFd = rel, fd
+	return fd, nil
+}
+
+// create calls mk to create the entry name in dirfd, replacing whatever
+// file or empty directory is already there.
+func (e *extractor) create(dirfd int, name string, mk func() error) error {
+	err := mk()
+	if err != syscall.EEXIST {
+		return err
+	}
+	if err := syscall.Unlinkat(dirfd, name); err == syscall.EISDIR {
+		if err := e.rmdir(dirfd, name); err != nil {
+			return err
+		}
+	} else if err != nil && err != syscall.ENOENT {
+		return err
+	}
+	return mk()
+}
+
+// rmdir removes the empty directory name in dirfd. The cached parent fd
+// stays valid: it is dirfd or a directory elsewhere, as name was empty.
+func (e *extractor) rmdir(dirfd int, name string) error {
+	n, err := syscall.BytePtrFromString(name)
+	if err != nil {
+		return err
+	}
+	if _, _, errno := syscall.Syscall(syscall.SYS_UNLINKAT, uintptr(dirfd), uintptr(unsafe.Pointer(n)), atRemovedir); errno != 0 {
+		return errno
+	}
+	e.dirs = map[string]bool{".": true}
+	return nil
+}
+
+// lchown gives the entry name in dirfd the owner of hdr, when running as
+// root and hdr is not owned by root. Ids not mapped in the user namespace
+// are left alone.
+func (e *extractor) lchown(dirfd int, name string, hdr *tar.Header) error {
+	if !e.chown || hdr.Uid == 0 && hdr.Gid == 0 {
+		return nil
+	}
+	if err := syscall.Fchownat(dirfd, name, hdr.Uid, hdr.Gid, atSymlinkNofollow); err != nil && err != syscall.EINVAL {
+		return err
+	}
+	return nil
+}
+
+// removeAll removes rel and everything below it.
+func (e *extractor) removeAll(rel string) {
+	os.RemoveAll(filepath.Join(e.root, rel))
+	e.forget()
+}
+
+func (e *extractor) dir(rel string, hdr *tar.Header) error {
+	if err := e.mkdirAll(filepath.Dir(rel), 0o755); err != nil {
+		return err
+	}
+	err := syscall.Mkdirat(e.rootFd, rel, uint32(hdr.Mode)&0o777)
+	if err == syscall.EEXIST {
+		e.dirs[rel] = true
+		return nil
+	}
+	if err != nil {
+		return err
+	}
+	e.dirs[rel] = true
+	return e.lchown(e.rootFd, rel, hdr)
+}
+
+func (e *extractor) file(rel string, hdr *tar.Header, r io.Reader) error {
+	dirfd, err := e.dirFd(filepath.Dir(rel))
+	if err != nil {
+		return err
+	}
+	name := filepath.Base(rel)
+	var fd int
+	err = e.create(dirfd, name, func() (err error) {
+		fd, err = syscall.Openat(dirfd, name, syscall.O_CREAT|syscall.O_EXCL|syscall.O_WRONLY|syscall.O_CLOEXEC, uint32(hdr.Mode)&0o777)
+		return err
+	})
+	if err != nil {
+		return err
+	}
+	err = e.write(fd, r, hdr.Size)
+	if err == nil && e.chown && (hdr.Uid != 0 || hdr.Gid != 0) {
+		if err = syscall.Fchown(fd, hdr.Uid, hdr.Gid); err == syscall.EINVAL {
+			err = nil
+		}
+	}
+	if cerr := syscall.Close(fd); err == nil {
+		err = cerr
+	}
+	return err
+}
+
+// write copies size bytes of r to fd through the extractor's buffer, which
+// io.Copy would allocate for every file.
+func (e *extractor) write(fd int, r io.Reader, size int64) error {
+	for size > 0 {
+		buf := e.buf
+		if size < int64(len(buf)) {
+			buf = buf[:size]
+		}
+		n, err := io.ReadFull(r, buf)
+		for off := 0; off < n; {
+			w, werr := syscall.Write(fd, buf[off:n])
+			if werr != nil {
+				return werr
+			}
+			off += w
+		}
+		if err != nil {
+			return err
+		}
+		size -= int64(n)
+	}
+	return nil
+}
+
+func (e *extractor) symlink(rel string, hdr *tar.Header) error {
+	dirfd, err := e.dirFd(filepath.Dir(rel))
+	if err != nil {
+		return err
+	}
+	name := filepath.Base(rel)
+	if err := e.create(dirfd, name, func() error { return symlinkat(hdr.Linkname, dirfd, name) }); err != nil {
+		return err
+	}
+	return e.lchown(dirfd, name, hdr)
+}
+
+// link hardlinks rel to the earlier entry target, or copies it where
+// hardlinks are not supported.
+func (e *extractor) link(rel, target string) error {
+	dirfd, err := e.dirFd(filepath.Dir(rel))
+	if err != nil {
+		return err
+	}
+	name := filepath.Base(rel)
+	err = e.create(dirfd, name, func() error { return linkat(e.rootFd, target, dirfd, name) })
+	if err == nil || err == syscall.ENOENT {
+		return err
+	}
+	if copyErr := e.copy(target, dirfd, name); copyErr != nil {
+		return fmt.Errorf("%w (copy also failed: %v)", err, copyErr)
+	}
+	return nil
+}
+
+// copy copies target to name in dirfd: a reflink where the filesystem
+// supports it, else copy_file_range through os.File.ReadFrom.
+func (e *extractor) copy(target string, dirfd int, name string) error {
+	sfd, err := syscall.Openat(e.rootFd, target, syscall.O_RDONLY|syscall.O_CLOEXEC, 0)
+	if err != nil {
+		return err
+	}
+	src := os.NewFile(uintptr(sfd), filepath.Join(e.root, target))
+	defer src.Close()
+	info, err := src.Stat()
+	if err != nil {
+		return err
+	}
+	var dfd int
+	err = e.create(dirfd, name, func() (err error) {
+		dfd, err = syscall.Openat(dirfd, name, syscall.O_CREAT|syscall.O_EXCL|syscall.O_WRONLY|syscall.O_CLOEXEC, uint32(info.Mode().Perm()))
+		return err
+	})
+	if err != nil {
+		return err
+	}
+	dst := os.NewFile(uintptr(dfd), name)
+	defer dst.Close()
+	if _, _, errno := syscall.Syscall(syscall.SYS_IOCTL, uintptr(dfd), ficlone, uintptr(sfd)); errno != 0 {
+		if _, err := io.Copy(dst, src); err != nil {
+			return err
+		}
+	}
+	return dst.Close()
+}
+
+// whiteout records the whiteout name (".wh.<file>" or ".wh..wh..opq") in
+// the directory dir in the form overlayfs understands: an opaque xattr on
+// dir, or a 0:0 character device hiding <file>.
+func (e *extractor) whiteout(dir, name string) error {
+	fd, err := e.dirFd(dir)
+	if err != nil {
+		return fmt.Errorf("failed to create directory %s: %w", filepath.Join(e.root, dir), err)
+	}
+	if name == ".wh..wh..opq" {
+		path := filepath.Join(e.root, dir)
+		if err := syscall.Setxattr(path, "trusted.overlay.opaque", []byte("y"), 0); err != nil {
+			return fmt.Errorf("failed to mark %s opaque: %w", path, err)
+		}
+		return nil
+	}
+	target := strings.TrimPrefix(name, ".wh.")
+	err = syscall.Mknodat(fd, target, syscall.S_IFCHR, 0)
+	if err == syscall.EEXIST {
+		e.removeAll(filepath.Join(dir, target))
+		if fd, err = e.dirFd(dir); err == nil {
+			err = syscall.Mknodat(fd, target, syscall.S_IFCHR, 0)
+		}
+	}
+	if err != nil {
+		return fmt.Errorf("failed to create whiteout %s: %w", filepath.Join(e.root, dir, target), err)
+	}
+	return nil
+}
+
+// entryPath returns the path of a tar entry relative to the layer root,
+// or false if it escapes it.
+func entryPath(name string) (string, bool) {
+	p := strings.TrimLeft(filepath.Clean(name), "/")
+	if p == "" {
+		return ".", true
+	}
+	return p, p != ".." && !strings.HasPrefix(p, "../")
+}
+
+// extractTar extracts a layer tarball to targetDir and returns the number
+// of entries. See extractLayer for overlay.
+func extractTar(r io.Reader, targetDir string, overlay bool) (int, error) {
+	e, err := newExtractor(targetDir)
+	if err != nil {
+		return 0, err
+	}
+	defer e.close()
+	n, _, err := e.extract(tar.NewReader(r), overlay)
+	return n, err
+}
+
+// extract extracts the entries of tr and returns their number. With
+// e.lazy it reports whether it stopped at the prefetch landmark of an
+// eStargz layer, leaving the rest of tr for later.
+func (e *extractor) extract(tr *tar.Reader, overlay bool) (int, bool, error) {
+	targetDir := e.root
+	fileCount := 0
+	for {
+		if e.lazy.stopped() {
+			return fileCount, false, errExtractStopped
+		}
+		header, err := tr.Next()
+		if err == io.EOF {
+			break
+		}
+		if err != nil {
+			return fileCount, false, fmt.Errorf("failed to read tar entry: %w", err)
+		}
+
+		fileCount++
+
+		// Clean the path to prevent path traversal
+		cleanPath, ok := entryPath(header.Name)
+		if !ok {
+			continue // Skip paths that try to escape
+		}
+		targetPath := filepath.Join(targetDir, cleanPath)
+
+		// eStargz metadata is not part of the image
+		switch cleanPath {
+		case prefetchLandmark, noPrefetchLandmark:
+			if e.lazy.prefetching() {
+				return fileCount, true, nil
+			}
+			continue
+		case stargzTOC:
+			continue
+		}
+
+		// Handle whiteout files (deletions in overlay filesystem)
+		baseName := filepath.Base(cleanPath)
+		if strings.HasPrefix(baseName, ".wh.") {
+			target := filepath.Join(filepath.Dir(cleanPath), strings.TrimPrefix(baseName, ".wh."))
+			if overlay {
+				if err := e.whiteout(filepath.Dir(cleanPath), baseName); err != nil {
+					return fileCount, false, err
+				}
+			} else {
+				// This is a whiteout marker - delete the corresponding file
+				e.removeUnshadowed(target)
+			}
+			e.lazy.record(target, true)
+			continue
+		}
+		if cleanPath == "." || e.lazy.shadowed(cleanPath) {
+			continue
+		}
+
+		switch header.Typeflag {
+		case tar.TypeDir:
+			if err := e.dir(cleanPath, header); err != nil {
+				return fileCount, false, fmt.Errorf("failed to create directory %s: %w", targetPath, err)
+			}
+
+		case tar.TypeReg:
+			if err := e.file(cleanPath, header, tr); err != nil {
+				return fileCount, false, fmt.Errorf("failed to create file %s: %w", targetPath, err)
+			}
+
+		case tar.TypeSymlink:
+			if err := e.symlink(cleanPath, header); err != nil {
+				return fileCount, false, fmt.Errorf("failed to create symlink %s -> %s: %w", targetPath, header.Linkname, err)
+			}
+
+		case tar.TypeLink:
+			linkTarget, ok := entryPath(header.Linkname)
+			if !ok {
+				continue
+			}
+			if err := e.link(cleanPath, linkTarget); err != nil {
+				return fileCount, false, fmt.Errorf("failed to create hardlink %s -> %s: %w", targetPath, filepath.Join(targetDir, linkTarget), err)
+			}
+
+		case tar.TypeChar, tar.TypeBlock:
+			// Skip device nodes - we can't create them without root and they're rarely needed
+			continue
+
+		case tar.TypeFifo:
+			// Skip FIFOs
+			continue
+		}
+		e.lazy.record(cleanPath, header.Typeflag != tar.TypeDir)
+	}
+
+	return fileCount, false, nil
+}
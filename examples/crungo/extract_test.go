@@ -0,0 +1,175 @@
+//go:build linux && cgo
+
+package main
+
+import (
+	"archive/tar"
+	"bytes"
+	"errors"
+	"fmt"
+	"os"
+	"path/filepath"
+	"syscall"
+	"testing"
+)
+
+// entriesTar returns a tarball of hdrs; regular files hold the byte "x".
+func entriesTar(t testing.TB, hdrs ...*tar.Header) *bytes.Buffer {
+	t.Helper()
+	var buf bytes.Buffer
+	tw := tar.NewWriter(&buf)
+	for _, hdr := range hdrs {
+		if hdr.Typeflag == tar.TypeReg {
+			hdr.Size = 1
+		}
+		if err := tw.WriteHeader(hdr); err != nil {
+			t.Fatalf("WriteHeader failed: %v", err)
+		}
+		if hdr.Size > 0 {
+			tw.Write([]byte("x"))
+		}
+	}
+	tw.Close()
+	return &buf
+}
+
+// layerTar returns a tarball of regular files and, for names ending in
+// "/", directories.
+func layerTar(t testing.TB, names ...string) *bytes.Buffer {
+	t.Helper()
+	hdrs := make([]*tar.Header, len(names))
+	for i, name := range names {
+		hdrs[i] = &tar.Header{Name: name, Mode: 0644, Typeflag: tar.TypeReg}
+		if name[len(name)-1] == '/' {
+			hdrs[i] = &tar.Header{Name: name, Mode: 0755, Typeflag: tar.TypeDir}
+		}
+	}
+	return entriesTar(t, hdrs...)
+}
+
+func TestExtractTarAppliesWhiteouts(t *testing.T) {
+	dir := t.TempDir()
+	os.WriteFile(filepath.Join(dir, "old"), []byte("lower"), 0644)
+	if _, err := extractTar(layerTar(t, "etc/", "etc/a", ".wh.old"), dir, false); err != nil {
+		t.Fatalf("extractTar failed: %v", err)
+	}
+	if _, err := os.Stat(filepath.Join(dir, "old")); !os.IsNotExist(err) {
+		t.Errorf("whiteout not applied: %v", err)
+	}
+	if _, err := os.Stat(filepath.Join(dir, "etc", "a")); err != nil {
+		t.Errorf("file missing: %v", err)
+	}
+}
+
+func TestExtractTarOverlayWhiteouts(t *testing.T) {
+	dir := t.TempDir()
+	n, err := extractTar(layerTar(t, "etc/", "etc/a", ".wh.old", "var/.wh..wh..opq"), dir, true)
+	if errors.Is(err, os.ErrPermission) {
+		t.Skip("overlay whiteouts need CAP_MKNOD and CAP_SYS_ADMIN")
+	}
+	if err != nil || n != 4 {
+		t.Fatalf("extractTar = %d, %v", n, err)
+	}
+	var st syscall.Stat_t
+	if err := syscall.Stat(filepath.Join(dir, "old"), &st); err != nil {
+		t.Fatalf("whiteout missing: %v", err)
+	}
+	if st.Mode&syscall.S_IFMT != syscall.S_IFCHR || st.Rdev != 0 {
+		t.Errorf("whiteout mode = %o, rdev = %d; want a 0:0 char device", st.Mode, st.Rdev)
+	}
+	val := make([]byte, 1)
+	if n, err := syscall.Getxattr(filepath.Join(dir, "var"), "trusted.overlay.opaque", val); err != nil || string(val[:n]) != "y" {
+		t.Errorf("opaque xattr = %q, %v", val, err)
+	}
+}
+
+func TestExtractTarReplacesEntries(t *testing.T) {
+	dir := t.TempDir()
+	lower := entriesTar(t,
+		&tar.Header{Name: "a/b/file", Mode: 0644, Typeflag: tar.TypeReg},
+		&tar.Header{Name: "a/link", Typeflag: tar.TypeSymlink, Linkname: "b/file"},
+		&tar.Header{Name: "a/empty/", Mode: 0755, Typeflag: tar.TypeDir},
+	)
+	if _, err := extractTar(lower, dir, false); err != nil {
+		t.Fatalf("extractTar(lower) failed: %v", err)
+	}
+	upper := entriesTar(t,
+		&tar.Header{Name: "a/link", Mode: 0600, Typeflag: tar.TypeReg},
+		&tar.Header{Name: "a/b/file", Typeflag: tar.TypeSymlink, Linkname: "../link"},
+		&tar.Header{Name: "a/empty", Typeflag: tar.TypeLink, Linkname: "a/link"},
+		&tar.Header{Name: "/abs/file", Mode: 0644, Typeflag: tar.TypeReg},
+		&tar.Header{Name: "../escape", Mode: 0644, Typeflag: tar.TypeReg},
+		&tar.Header{Name: "a/evil", Typeflag: tar.TypeLink, Linkname: "../../etc/passwd"},
+	)
+	if n, err := extractTar(upper, dir, false); err != nil || n != 6 {
+		t.Fatalf("extractTar(upper) = %d, %v", n, err)
+	}
+
+	if fi, err := os.Lstat(filepath.Join(dir, "a", "link")); err != nil || !fi.Mode().IsRegular() || fi.Mode().Perm() != 0600 {
+		t.Errorf("a/link = %v, %v; want a 0600 regular file", fi, err)
+	}
+	if target, err := os.Readlink(filepath.Join(dir, "a", "b", "file")); err != nil || target != "../link" {
+		t.Errorf("a/b/file -> %q, %v; want ../link", target, err)
+	}
+	var link, empty syscall.Stat_t
+	syscall.Stat(filepath.Join(dir, "a", "link"), &link)
+	if err := syscall.Stat(filepath.Join(dir, "a", "empty"), &empty); err != nil || empty.Ino != link.Ino {
+		t.Errorf("a/empty is not a hardlink of a/link: %v", err)
+	}
+	if _, err := os.Stat(filepath.Join(dir, "abs", "file")); err != nil {
+		t.Errorf("absolute entry not extracted under the root: %v", err)
+	}
+	for _, name := range []string{"../escape", "a/evil"} {
+		if _, err := os.Lstat(filepath.Join(dir, name)); !os.IsNotExist(err) {
+			t.Errorf("escaping entry %s extracted: %v", name, err)
+		}
+	}
+}
+
+func TestExtractTarOwners(t *testing.T) {
+	if os.Geteuid() != 0 {
+		t.Skip("needs root")
+	}
+	dir := t.TempDir()
+	tarball := entriesTar(t,
+		&tar.Header{Name: "d/", Mode: 0755, Typeflag: tar.TypeDir, Uid: 1000, Gid: 1001},
+		&tar.Header{Name: "d/f", Mode: 0644, Typeflag: tar.TypeReg, Uid: 1002, Gid: 1003},
+		&tar.Header{Name: "d/l", Typeflag: tar.TypeSymlink, Linkname: "f", Uid: 1004, Gid: 1005},
+	)
+	if _, err := extractTar(tarball, dir, false); err != nil {
+		t.Fatalf("extractTar failed: %v", err)
+	}
+	for name, want := range map[string][2]uint32{"d": {1000, 1001}, "d/f": {1002, 1003}, "d/l": {1004, 1005}} {
+		var st syscall.Stat_t
+		if err := syscall.Lstat(filepath.Join(dir, name), &st); err != nil || st.Uid != want[0] || st.Gid != want[1] {
+			t.Errorf("%s owner = %d:%d, %v; want %d:%d", name, st.Uid, st.Gid, err, want[0], want[1])
+		}
+	}
+}
+
+func BenchmarkExtractTarSmallFiles(b *testing.B) {
+	var names []string
+	for d := 0; d < 100; d++ {
+		names = append(names, fmt.Sprintf("usr/share/d%d/", d))
+		for f := 0; f < 100; f++ {
+			names = append(names, fmt.Sprintf("usr/share/d%d/f%d", d, f))
+		}
+	}
+	tarball := layerTar(b, names...).Bytes()
+	b.SetBytes(int64(len(tarball)))
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		b.StopTimer()
+		dir, err := os.MkdirTemp("", "crungo-bench-")
+		if err != nil {
+			b.Fatalf("MkdirTemp failed: %v", err)
+		}
+		b.StartTimer()
+		if _, err := extractTar(bytes.NewReader(tarball), dir, false); err != nil {
+			b.Fatalf("extractTar failed: %v", err)
+		}
+		b.StopTimer()
+		os.RemoveAll(dir)
+		b.StartTimer()
+	}
+}
@@ -3,13 +3,15 @@
 package main
 
 import (
-	"archive/tar"
+	"errors"
 	"fmt"
 	"io"
 	"os"
 	"path/filepath"
-	"strings"
+	"runtime"
+	"sync"
 
+	crun "github.com/danielealbano/libcrun-go"
 	"github.com/google/go-containerregistry/pkg/authn"
 	"github.com/google/go-containerregistry/pkg/name"
 	v1 "github.com/google/go-containerregistry/pkg/v1"
@@ -29,6 +31,25 @@ type ImageConfig struct {
 type PulledImage struct {
 	RootFS string      // Path to extracted rootfs
 	Config ImageConfig // Image configuration
+
+	overlay *crun.OverlayRootfs // set when assembled from the layer cache
+	stop    chan struct{}       // set while layers extract in the background
+	done    chan struct{}
+}
+
+// Cleanup removes the rootfs: unmounts the overlay (keeping the cached
+// layers) or deletes the extracted directory, once background extraction
+// is stopped.
+func (p *PulledImage) Cleanup() error {
+	if p.stop != nil {
+		close(p.stop)
+		<-p.done
+		p.stop = nil
+	}
+	if p.overlay != nil {
+		return p.overlay.Close()
+	}
+	return os.RemoveAll(p.RootFS)
 }
 
 // formatBytes formats bytes into human-readable format.
@@ -45,13 +66,13 @@ func formatBytes(bytes int64) string {
 	return fmt.Sprintf("%.1f %cB", float64(bytes)/float64(div), "KMGTPE"[exp])
 }
 
-// PullAndExtract pulls an OCI image and extracts it to a temporary directory.
-// The caller is responsible for cleaning up the returned rootfs path.
-func PullAndExtract(imageRef string) (*PulledImage, error) {
+// pullImage resolves an OCI image and reads its configuration. Layers are
+// only downloaded once they are read.
+func pullImage(imageRef string) (v1.Image, ImageConfig, error) {
 	// Parse the image reference
 	ref, err := name.ParseReference(imageRef)
 	if err != nil {
-		return nil, fmt.Errorf("invalid image reference %q: %w", imageRef, err)
+		return nil, ImageConfig{}, fmt.Errorf("invalid image reference %q: %w", imageRef, err)
 	}
 
 	fmt.Printf("Pulling image: %s\n", ref.Name())
@@ -59,21 +80,30 @@ func PullAndExtract(imageRef string) (*PulledImage, error) {
 	// Pull the image using default keychain (reads ~/.docker/config.json)
 	img, err := remote.Image(ref, remote.WithAuthFromKeychain(authn.DefaultKeychain))
 	if err != nil {
-		return nil, fmt.Errorf("failed to pull image: %w", err)
+		return nil, ImageConfig{}, fmt.Errorf("failed to pull image: %w", err)
 	}
 
 	// Get image config
 	configFile, err := img.ConfigFile()
 	if err != nil {
-		return nil, fmt.Errorf("failed to get image config: %w", err)
+		return nil, ImageConfig{}, fmt.Errorf("failed to get image config: %w", err)
 	}
 
-	config := ImageConfig{
+	return img, ImageConfig{
 		Entrypoint: configFile.Config.Entrypoint,
 		Cmd:        configFile.Config.Cmd,
 		Env:        configFile.Config.Env,
 		WorkingDir: configFile.Config.WorkingDir,
 		User:       configFile.Config.User,
+	}, nil
+}
+
+// PullAndExtract pulls an OCI image and extracts it to a temporary directory.
+// The caller is responsible for cleaning up the returned rootfs path.
+func PullAndExtract(imageRef string) (*PulledImage, error) {
+	img, config, err := pullImage(imageRef)
+	if err != nil {
+		return nil, err
 	}
 
 	// Create temporary directory for rootfs
@@ -102,13 +132,159 @@ func PullAndExtract(imageRef string) (*PulledImage, error) {
 	}, nil
 }
 
+// PullAndExtractLazy is PullAndExtract for eStargz images: it returns
+// once the prioritized files of every layer are extracted, and extracts
+// the rest in the background until Cleanup. Other images are extracted
+// whole.
+func PullAndExtractLazy(imageRef string) (*PulledImage, error) {
+	img, config, err := pullImage(imageRef)
+	if err != nil {
+		return nil, err
+	}
+
+	rootfs, err := os.MkdirTemp("", "crungo-rootfs-*")
+	if err != nil {
+		return nil, fmt.Errorf("failed to create temp directory: %w", err)
+	}
+
+	fmt.Printf("Extracting to: %s\n", rootfs)
+	rest, err := extractImageLazy(img, rootfs)
+	if err != nil {
+		os.RemoveAll(rootfs)
+		return nil, fmt.Errorf("failed to extract image: %w", err)
+	}
+	pulled := &PulledImage{
+		RootFS: rootfs,
+		Config: config,
+		stop:   make(chan struct{}),
+		done:   make(chan struct{}),
+	}
+	go func() {
+		defer close(pulled.done)
+		if err := rest(pulled.stop); err != nil {
+			fmt.Fprintf(os.Stderr, "Warning: background extraction failed: %v\n", err)
+		}
+	}()
+
+	// Create minimal /etc/passwd if it doesn't exist (required by libcrun);
+	// the image's own, if still to be extracted, replaces it
+	if err := ensurePasswd(rootfs); err != nil {
+		pulled.Cleanup()
+		return nil, fmt.Errorf("failed to create /etc/passwd: %w", err)
+	}
+
+	fmt.Println("Done!")
+	return pulled, nil
+}
+
+// PullWithLayerCache pulls an OCI image and mounts its rootfs as an
+// overlayfs of the layers in store, keyed by DiffID. Only layers that are
+// not cached yet are downloaded and extracted, so a warm start costs the
+// same whatever the image size. Cleanup unmounts the rootfs and drops the
+// container's changes; the layers stay cached.
+func PullWithLayerCache(imageRef string, store *crun.LayerStore) (*PulledImage, error) {
+	img, config, err := pullImage(imageRef)
+	if err != nil {
+		return nil, err
+	}
+	layers, err := img.Layers()
+	if err != nil {
+		return nil, fmt.Errorf("failed to get layers: %w", err)
+	}
+
+	// Layers are extracted into separate directories, so missing ones can
+	// all be fetched and unpacked at once; only the overlay stacks them
+	fmt.Printf("Preparing %d layers:\n", len(layers))
+	dirs := make([]string, len(layers))
+	errs := make([]error, len(layers))
+	sem := make(chan struct{}, layerFetchWorkers)
+	var wg sync.WaitGroup
+	var printMu sync.Mutex
+	for i, layer := range layers {
+		layerNum := i + 1
+		diffID, err := layer.DiffID()
+		if err != nil {
+			return nil, fmt.Errorf("failed to get layer %d digest: %w", layerNum, err)
+		}
+		if store.Has(diffID.String()) {
+			fmt.Printf("  [%d/%d] %s cached ✓\n", layerNum, len(layers), diffID.Hex[:12])
+			dirs[i], errs[i] = store.Path(diffID.String())
+			continue
+		}
+		sem <- struct{}{} // taken in layer order, so lower layers start first
+		wg.Add(1)
+		go func() {
+			defer func() { <-sem; wg.Done() }()
+			var files int
+			dirs[i], errs[i] = store.Ensure(diffID.String(), func(dir string) (err error) {
+				files, err = extractLayer(layer, dir, true)
+				return err
+			})
+			size, _ := layer.Size()
+			printMu.Lock()
+			defer printMu.Unlock()
+			if errs[i] != nil {
+				fmt.Printf("  [%d/%d] %s (%s) ✗\n", layerNum, len(layers), diffID.Hex[:12], formatBytes(size))
+			} else {
+				fmt.Printf("  [%d/%d] %s (%s) extracted %d files ✓\n", layerNum, len(layers), diffID.Hex[:12], formatBytes(size), files)
+			}
+		}()
+	}
+	wg.Wait()
+	for i, err := range errs {
+		if err != nil {
+			return nil, fmt.Errorf("failed to extract layer %d: %w", i+1, err)
+		}
+	}
+
+	dir, err := os.MkdirTemp("", "crungo-rootfs-*")
+	if err != nil {
+		return nil, fmt.Errorf("failed to create temp directory: %w", err)
+	}
+	overlay, err := crun.NewOverlayRootfs(dir, dirs...)
+	if err != nil {
+		os.RemoveAll(dir)
+		return nil, fmt.Errorf("failed to mount rootfs: %w", err)
+	}
+
+	// Create minimal /etc/passwd if it doesn't exist (written to the upper layer)
+	if err := ensurePasswd(overlay.Path); err != nil {
+		overlay.Close()
+		return nil, fmt.Errorf("failed to create /etc/passwd: %w", err)
+	}
+
+	fmt.Println("Done!")
+	return &PulledImage{
+		RootFS:  overlay.Path,
+		Config:  config,
+		overlay: overlay,
+	}, nil
+}
+
+// layerFetchWorkers bounds how many layers are downloaded and decompressed
+// at once.
+var layerFetchWorkers = min(max(runtime.NumCPU(), 2), 8)
+
 // extractImage extracts all layers of an image to the target directory.
+// Layers are applied in order, so that whiteouts remove what lower layers
+// added, while the following ones are downloaded and decompressed in the
+// background.
 func extractImage(img v1.Image, targetDir string) error {
 	layers, err := img.Layers()
 	if err != nil {
 		return fmt.Errorf("failed to get layers: %w", err)
 	}
 
+	spoolDir, err := os.MkdirTemp("", "crungo-layers-*")
+	if err != nil {
+		return fmt.Errorf("failed to create temp directory: %w", err)
+	}
+	defer os.RemoveAll(spoolDir)
+	fetch := startLayerFetch(len(layers), spoolDir, func(i int) (io.ReadCloser, error) {
+		return layers[i].Uncompressed()
+	})
+	defer fetch.close()
+
 	totalLayers := len(layers)
 	fmt.Printf("Downloading and extracting %d layers:\n", totalLayers)
 
@@ -118,148 +294,201 @@ func extractImage(img v1.Image, targetDir string) error {
 		// Get layer size for progress
 		size, _ := layer.Size()
 
-		fmt.Printf("  [%d/%d] Downloading %s... ", layerNum, totalLayers, formatBytes(size))
+		fmt.Printf("  [%d/%d] Extracting %s... ", layerNum, totalLayers, formatBytes(size))
 
-		if err := extractLayerWithProgress(layer, targetDir, layerNum, totalLayers); err != nil {
+		reader, err := fetch.next(i)
+		if err != nil {
+			fmt.Println("✗")
+			return fmt.Errorf("failed to download layer %d: %w", layerNum, err)
+		}
+		fileCount, err := extractTar(reader, targetDir, false)
+		reader.Close()
+		if err != nil {
 			fmt.Println("✗")
 			return fmt.Errorf("failed to extract layer %d: %w", layerNum, err)
 		}
+		fmt.Printf("extracted %d files ✓\n", fileCount)
 	}
 
 	return nil
 }
 
-// extractLayerWithProgress extracts a single layer with progress indication.
-func extractLayerWithProgress(layer v1.Layer, targetDir string, layerNum, totalLayers int) error {
-	reader, err := layer.Uncompressed()
+// layerFetch downloads and decompresses layers in the background, up to
+// layerFetchWorkers at a time and lowest first, spooling each uncompressed
+// tar to an unlinked file that the caller reads as it grows, so that it can
+// apply them one by one, in order, while they download.
+type layerFetch struct {
+	dir    string
+	layers []*spooledLayer
+	stop   chan struct{}
+	wg     sync.WaitGroup
+}
+
+// spooledLayer is the spool file of a layer and how much of it is written.
+type spooledLayer struct {
+	mu      sync.Mutex
+	cond    sync.Cond
+	file    *os.File // read side, set once the spool is created
+	written int64
+	done    bool
+	err     error
+}
+
+// startLayerFetch starts fetching n layers, opened with open, into dir.
+func startLayerFetch(n int, dir string, open func(i int) (io.ReadCloser, error)) *layerFetch {
+	f := &layerFetch{
+		dir:    dir,
+		layers: make([]*spooledLayer, n),
+		stop:   make(chan struct{}),
+	}
+	for i := range f.layers {
+		l := &spooledLayer{}
+		l.cond.L = &l.mu
+		f.layers[i] = l
+	}
+	queue := make(chan int)
+	go func() {
+		defer close(queue)
+		for i := 0; i < n; i++ {
+			select {
+			case queue <- i:
+			case <-f.stop:
+				return
+			}
+		}
+	}()
+	for w := 0; w < min(layerFetchWorkers, n); w++ {
+		f.wg.Add(1)
+		go func() {
+			defer f.wg.Done()
+			buf := make([]byte, 256<<10)
+			for i := range queue {
+				l := f.layers[i]
+				err := f.spool(l, open, i, buf)
+				l.mu.Lock()
+				l.done, l.err = true, err
+				l.cond.Broadcast()
+				l.mu.Unlock()
+			}
+		}()
+	}
+	return f
+}
+
+func (f *layerFetch) spool(l *spooledLayer, open func(i int) (io.ReadCloser, error), i int, buf []byte) error {
+	r, err := open(i)
 	if err != nil {
 		return fmt.Errorf("failed to get uncompressed layer: %w", err)
 	}
-	defer reader.Close()
-
-	tr := tar.NewReader(reader)
+	defer r.Close()
+	out, err := os.CreateTemp(f.dir, "layer-*.tar")
+	if err != nil {
+		return err
+	}
+	defer out.Close()
+	in, err := os.Open(out.Name())
+	os.Remove(out.Name()) // both ends stay open
+	if err != nil {
+		return err
+	}
+	l.mu.Lock()
+	l.file = in
+	l.cond.Broadcast()
+	l.mu.Unlock()
 
-	fileCount := 0
 	for {
-		header, err := tr.Next()
-		if err == io.EOF {
-			break
+		select {
+		case <-f.stop:
+			return errors.New("layer download cancelled")
+		default:
 		}
-		if err != nil {
-			return fmt.Errorf("failed to read tar entry: %w", err)
+		n, rerr := r.Read(buf)
+		if n > 0 {
+			if _, err := out.Write(buf[:n]); err != nil {
+				return err
+			}
+			l.mu.Lock()
+			l.written += int64(n)
+			l.cond.Broadcast()
+			l.mu.Unlock()
 		}
-
-		fileCount++
-
-		// Handle whiteout files (deletions in overlay filesystem)
-		baseName := filepath.Base(header.Name)
-		if strings.HasPrefix(baseName, ".wh.") {
-			// This is a whiteout marker - delete the corresponding file
-			targetName := strings.TrimPrefix(baseName, ".wh.")
-			targetPath := filepath.Join(targetDir, filepath.Dir(header.Name), targetName)
-			os.RemoveAll(targetPath)
-			continue
+		if rerr == io.EOF {
+			return nil
 		}
-
-		// Clean the path to prevent path traversal
-		cleanPath := filepath.Clean(header.Name)
-		if strings.HasPrefix(cleanPath, "..") {
-			continue // Skip paths that try to escape
+		if rerr != nil {
+			return rerr
 		}
+	}
+}
 
-		targetPath := filepath.Join(targetDir, cleanPath)
-
-		switch header.Typeflag {
-		case tar.TypeDir:
-			if err := os.MkdirAll(targetPath, os.FileMode(header.Mode)); err != nil {
-				return fmt.Errorf("failed to create directory %s: %w", targetPath, err)
-			}
-
-		case tar.TypeReg:
-			// Ensure parent directory exists
-			if err := os.MkdirAll(filepath.Dir(targetPath), 0755); err != nil {
-				return fmt.Errorf("failed to create parent directory for %s: %w", targetPath, err)
-			}
-
-			// Remove existing file if it exists (layers can overwrite)
-			os.Remove(targetPath)
-
-			file, err := os.OpenFile(targetPath, os.O_CREATE|os.O_WRONLY|os.O_TRUNC, os.FileMode(header.Mode))
-			if err != nil {
-				return fmt.Errorf("failed to create file %s: %w", targetPath, err)
-			}
-
-			if _, err := io.Copy(file, tr); err != nil {
-				file.Close()
-				return fmt.Errorf("failed to write file %s: %w", targetPath, err)
-			}
-			file.Close()
-
-		case tar.TypeSymlink:
-			// Ensure parent directory exists
-			if err := os.MkdirAll(filepath.Dir(targetPath), 0755); err != nil {
-				return fmt.Errorf("failed to create parent directory for symlink %s: %w", targetPath, err)
-			}
-
-			// Remove existing file/symlink if it exists
-			os.Remove(targetPath)
-
-			if err := os.Symlink(header.Linkname, targetPath); err != nil {
-				return fmt.Errorf("failed to create symlink %s -> %s: %w", targetPath, header.Linkname, err)
-			}
-
-		case tar.TypeLink:
-			// Ensure parent directory exists
-			if err := os.MkdirAll(filepath.Dir(targetPath), 0755); err != nil {
-				return fmt.Errorf("failed to create parent directory for hardlink %s: %w", targetPath, err)
-			}
-
-			// Remove existing file if it exists
-			os.Remove(targetPath)
+// next returns the uncompressed tar of layer i once its download started.
+// Reads block until the data is spooled.
+func (f *layerFetch) next(i int) (io.ReadCloser, error) {
+	l := f.layers[i]
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	for l.file == nil && !l.done {
+		l.cond.Wait()
+	}
+	if l.file == nil {
+		return nil, l.err
+	}
+	return &spoolReader{l: l}, nil
+}
 
-			linkTarget := filepath.Join(targetDir, header.Linkname)
-			if err := os.Link(linkTarget, targetPath); err != nil {
-				// If hard link fails, try copying the file
-				if copyErr := copyFile(linkTarget, targetPath); copyErr != nil {
-					return fmt.Errorf("failed to create hardlink %s -> %s: %w (copy also failed: %v)", targetPath, linkTarget, err, copyErr)
-				}
-			}
+// close stops fetching layers and waits for the workers.
+func (f *layerFetch) close() {
+	close(f.stop)
+	f.wg.Wait()
+}
 
-		case tar.TypeChar, tar.TypeBlock:
-			// Skip device nodes - we can't create them without root and they're rarely needed
-			continue
+// spoolReader reads a spooled layer, waiting for the writer as needed.
+type spoolReader struct {
+	l   *spooledLayer
+	off int64
+}
 
-		case tar.TypeFifo:
-			// Skip FIFOs
-			continue
+func (r *spoolReader) Read(p []byte) (int, error) {
+	l := r.l
+	l.mu.Lock()
+	for r.off >= l.written && !l.done {
+		l.cond.Wait()
+	}
+	avail := l.written - r.off
+	err := l.err
+	l.mu.Unlock()
+	if avail == 0 {
+		if err == nil {
+			err = io.EOF
 		}
+		return 0, err
 	}
-
-	fmt.Printf("extracted %d files ✓\n", fileCount)
-	return nil
-}
-
-// copyFile copies a file from src to dst.
-func copyFile(src, dst string) error {
-	srcFile, err := os.Open(src)
-	if err != nil {
-		return err
+	if int64(len(p)) > avail {
+		p = p[:avail]
 	}
-	defer srcFile.Close()
-
-	srcInfo, err := srcFile.Stat()
-	if err != nil {
-		return err
+	n, err := l.file.ReadAt(p, r.off)
+	r.off += int64(n)
+	if err == io.EOF && n > 0 {
+		err = nil
 	}
+	return n, err
+}
 
-	dstFile, err := os.OpenFile(dst, os.O_CREATE|os.O_WRONLY|os.O_TRUNC, srcInfo.Mode())
+func (r *spoolReader) Close() error {
+	return r.l.file.Close()
+}
+
+// extractLayer extracts a single layer and returns the number of entries.
+// With overlay, whiteouts are kept as overlayfs whiteouts instead of being
+// applied, so that the layer can be stacked with the others.
+func extractLayer(layer v1.Layer, targetDir string, overlay bool) (int, error) {
+	reader, err := layer.Uncompressed()
 	if err != nil {
-		return err
+		return 0, fmt.Errorf("failed to get uncompressed layer: %w", err)
 	}
-	defer dstFile.Close()
+	defer reader.Close()
 
-	_, err = io.Copy(dstFile, srcFile)
-	return err
+	return extractTar(reader, targetDir, overlay)
 }
 
 // ensurePasswd creates a minimal /etc/passwd file if it doesn't exist.
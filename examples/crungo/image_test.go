@@ -3,6 +3,9 @@
 package main
 
 import (
+	"bytes"
+	"errors"
+	"io"
 	"os"
 	"path/filepath"
 	"testing"
@@ -141,6 +144,52 @@ func TestEnsurePasswdExisting(t *testing.T) {
 	}
 }
 
+// layerTar builds a layer tarball of dirs and regular files (content "x").
+func TestLayerFetchAppliesInOrder(t *testing.T) {
+	spool := t.TempDir()
+	layers := []*bytes.Buffer{
+		layerTar(t, "etc/", "etc/a", "etc/b"),
+		layerTar(t, "etc/.wh.a"),
+		layerTar(t, "etc/a"),
+	}
+	fetch := startLayerFetch(len(layers)+1, spool, func(i int) (io.ReadCloser, error) {
+		if i == len(layers) {
+			return nil, errors.New("registry unreachable")
+		}
+		return io.NopCloser(layers[i]), nil
+	})
+	defer fetch.close()
+
+	dir := t.TempDir()
+	for i := range layers {
+		r, err := fetch.next(i)
+		if err != nil {
+			t.Fatalf("next(%d) failed: %v", i, err)
+		}
+		_, err = extractTar(r, dir, false)
+		r.Close()
+		if err != nil {
+			t.Fatalf("extractTar(%d) failed: %v", i, err)
+		}
+		if i == 1 {
+			if _, err := os.Stat(filepath.Join(dir, "etc", "a")); !os.IsNotExist(err) {
+				t.Errorf("etc/a after its whiteout: %v", err)
+			}
+		}
+	}
+	for _, name := range []string{"a", "b"} {
+		if _, err := os.Stat(filepath.Join(dir, "etc", name)); err != nil {
+			t.Errorf("etc/%s missing: %v", name, err)
+		}
+	}
+	if _, err := fetch.next(len(layers)); err == nil {
+		t.Error("next succeeded for a layer that failed to download")
+	}
+	if left, _ := os.ReadDir(spool); len(left) != 0 {
+		t.Errorf("spool files left behind: %v", left)
+	}
+}
+
 func contains(s, substr string) bool {
 	return len(s) >= len(substr) && (s == substr || len(s) > 0 && containsAt(s, substr, 0))
 }
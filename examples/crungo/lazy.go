@@ -0,0 +1,233 @@
+//go:build linux && cgo
+
+package main
+
+import (
+	"archive/tar"
+	"errors"
+	"fmt"
+	"io"
+	"os"
+	"path/filepath"
+
+	v1 "github.com/google/go-containerregistry/pkg/v1"
+)
+
+// eStargz layers are gzipped tarballs like any other, but the files a
+// workload needs at startup come first, followed by a ".prefetch.landmark"
+// entry (or, when there are none, a leading ".no.prefetch.landmark"), and
+// the table of contents is a trailing "stargz.index.json". A lazy pull
+// extracts every layer up to its landmark, starts the container, and
+// extracts the rest in the background. Layers without a landmark are
+// extracted whole before the container starts.
+const (
+	prefetchLandmark   = ".prefetch.landmark"
+	noPrefetchLandmark = ".no.prefetch.landmark"
+	stargzTOC          = "stargz.index.json"
+)
+
+var errExtractStopped = errors.New("extraction stopped")
+
+// layerOwners records the paths extracted with the prioritized files of
+// each layer. The rest of a layer is extracted after the prioritized files
+// of the layers above it, and must leave what those replaced alone.
+type layerOwners struct {
+	exact   map[string]int // path -> highest layer that wrote it
+	subtree map[string]int // file or whiteout -> highest layer hiding what is below it
+	below   map[string]int // directory -> highest layer that wrote below it
+}
+
+func newLayerOwners() *layerOwners {
+	return &layerOwners{exact: map[string]int{}, subtree: map[string]int{}, below: map[string]int{}}
+}
+
+func raise(m map[string]int, path string, index int) {
+	if old, ok := m[path]; !ok || index > old {
+		m[path] = index
+	}
+}
+
+func above(m map[string]int, path string, index int) bool {
+	owner, ok := m[path]
+	return ok && owner > index
+}
+
+// lazyLayer is the state of a lazy extraction of layer index.
+type lazyLayer struct {
+	owners   *layerOwners
+	index    int
+	prefetch bool // extracting the prioritized files, up to the landmark
+	stop     <-chan struct{}
+}
+
+func (l *lazyLayer) stopped() bool {
+	if l == nil || l.stop == nil {
+		return false
+	}
+	select {
+	case <-l.stop:
+		return true
+	default:
+		return false
+	}
+}
+
+func (l *lazyLayer) prefetching() bool {
+	return l != nil && l.prefetch
+}
+
+// hidden reports whether a layer above replaced path, or one of its
+// parents, with a file or a whiteout.
+func (l *lazyLayer) hidden(path string) bool {
+	for p := path; ; p = filepath.Dir(p) {
+		if above(l.owners.subtree, p, l.index) {
+			return true
+		}
+		if p == "." {
+			return false
+		}
+	}
+}
+
+// shadowed reports whether path was extracted by a layer above, and the
+// entry of this layer must be skipped.
+func (l *lazyLayer) shadowed(path string) bool {
+	return l != nil && (above(l.owners.exact, path, l.index) || l.hidden(path))
+}
+
+// record notes that the prioritized files of the layer wrote path; hides
+// is set for anything but a directory, which merges with lower layers.
+func (l *lazyLayer) record(path string, hides bool) {
+	if !l.prefetching() {
+		return
+	}
+	raise(l.owners.exact, path, l.index)
+	if hides {
+		raise(l.owners.subtree, path, l.index)
+	}
+	for d := filepath.Dir(path); d != "."; d = filepath.Dir(d) {
+		raise(l.owners.below, d, l.index)
+	}
+}
+
+// removeUnshadowed applies the whiteout of rel like removeAll, but keeps
+// what layers above already extracted there.
+func (e *extractor) removeUnshadowed(rel string) {
+	l := e.lazy
+	if l == nil {
+		e.removeAll(rel)
+		return
+	}
+	if l.hidden(rel) {
+		return
+	}
+	if !above(l.owners.exact, rel, l.index) && !above(l.owners.below, rel, l.index) {
+		e.removeAll(rel)
+		return
+	}
+	entries, _ := os.ReadDir(filepath.Join(e.root, rel))
+	for _, ent := range entries {
+		e.removeUnshadowed(filepath.Join(rel, ent.Name()))
+	}
+}
+
+// extractPrioritized extracts layer index from tr up to its prefetch
+// landmark, and reports whether the rest is left for extractRemaining.
+func extractPrioritized(tr *tar.Reader, targetDir string, index int, owners *layerOwners) (int, bool, error) {
+	e, err := newExtractor(targetDir)
+	if err != nil {
+		return 0, false, err
+	}
+	defer e.close()
+	e.lazy = &lazyLayer{owners: owners, index: index, prefetch: true}
+	return e.extract(tr, false)
+}
+
+// extractRemaining extracts the rest of layer index from tr, once the
+// prioritized files of every layer are extracted. It returns
+// errExtractStopped if stop is closed first.
+func extractRemaining(tr *tar.Reader, targetDir string, index int, owners *layerOwners, stop <-chan struct{}) (int, error) {
+	e, err := newExtractor(targetDir)
+	if err != nil {
+		return 0, err
+	}
+	defer e.close()
+	e.lazy = &lazyLayer{owners: owners, index: index, stop: stop}
+	n, _, err := e.extract(tr, false)
+	return n, err
+}
+
+// extractImageLazy extracts the prioritized files of every layer of img to
+// targetDir, and returns a function extracting the rest, to be run once,
+// in the background, until stop is closed.
+func extractImageLazy(img v1.Image, targetDir string) (func(stop <-chan struct{}) error, error) {
+	layers, err := img.Layers()
+	if err != nil {
+		return nil, fmt.Errorf("failed to get layers: %w", err)
+	}
+
+	spoolDir, err := os.MkdirTemp("", "crungo-layers-*")
+	if err != nil {
+		return nil, fmt.Errorf("failed to create temp directory: %w", err)
+	}
+	fetch := startLayerFetch(len(layers), spoolDir, func(i int) (io.ReadCloser, error) {
+		return layers[i].Uncompressed()
+	})
+	readers := make([]io.ReadCloser, len(layers))
+	rest := make([]*tar.Reader, len(layers))
+	cleanup := func() {
+		for _, r := range readers {
+			if r != nil {
+				r.Close()
+			}
+		}
+		fetch.close()
+		os.RemoveAll(spoolDir)
+	}
+
+	owners := newLayerOwners()
+	fmt.Printf("Extracting the prioritized files of %d layers:\n", len(layers))
+	for i, layer := range layers {
+		layerNum := i + 1
+		size, _ := layer.Size()
+		fmt.Printf("  [%d/%d] Extracting %s... ", layerNum, len(layers), formatBytes(size))
+
+		r, err := fetch.next(i)
+		if err != nil {
+			fmt.Println("✗")
+			cleanup()
+			return nil, fmt.Errorf("failed to download layer %d: %w", layerNum, err)
+		}
+		tr := tar.NewReader(r)
+		fileCount, more, err := extractPrioritized(tr, targetDir, i, owners)
+		if err != nil {
+			r.Close()
+			fmt.Println("✗")
+			cleanup()
+			return nil, fmt.Errorf("failed to extract layer %d: %w", layerNum, err)
+		}
+		if more {
+			readers[i], rest[i] = r, tr
+			fmt.Printf("prefetched %d files, the rest in the background ✓\n", fileCount)
+		} else {
+			r.Close()
+			fmt.Printf("extracted %d files ✓\n", fileCount)
+		}
+	}
+
+	return func(stop <-chan struct{}) error {
+		defer cleanup()
+		for i, tr := range rest {
+			if tr == nil {
+				continue
+			}
+			if _, err := extractRemaining(tr, targetDir, i, owners, stop); err != nil {
+				if err == errExtractStopped {
+					return nil
+				}
+				return fmt.Errorf("failed to extract layer %d: %w", i+1, err)
+			}
+		}
+		return nil
+	}, nil
+}
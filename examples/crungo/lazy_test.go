@@ -0,0 +1,68 @@
+//go:build linux && cgo
+
+package main
+
+import (
+	"archive/tar"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+func TestLazyExtractKeepsLayerOrder(t *testing.T) {
+	dir := t.TempDir()
+	layers := [][]string{
+		{"opt/", "opt/keep", "opt/gone", "etc/", "etc/passwd"},
+		{".no.prefetch.landmark", ".wh.opt", "etc/.wh.passwd", "usr/", "usr/lib"},
+		{"opt/", "opt/new", "etc/passwd", "usr/.wh.lib", ".prefetch.landmark", "srv/late", "stargz.index.json"},
+	}
+	owners := newLayerOwners()
+	var rest []*tar.Reader
+	for i, names := range layers {
+		tr := tar.NewReader(layerTar(t, names...))
+		_, more, err := extractPrioritized(tr, dir, i, owners)
+		if err != nil {
+			t.Fatalf("extractPrioritized(%d) failed: %v", i, err)
+		}
+		if more != (i > 0) {
+			t.Errorf("extractPrioritized(%d) more = %v", i, more)
+		}
+		rest = append(rest, tr)
+	}
+	if _, err := os.Stat(filepath.Join(dir, "srv", "late")); !os.IsNotExist(err) {
+		t.Errorf("file after the landmark extracted early: %v", err)
+	}
+	for i := 1; i < len(rest); i++ {
+		if _, err := extractRemaining(rest[i], dir, i, owners, nil); err != nil {
+			t.Fatalf("extractRemaining(%d) failed: %v", i, err)
+		}
+	}
+
+	for _, name := range []string{"opt/new", "etc/passwd", "srv/late"} {
+		if _, err := os.Stat(filepath.Join(dir, name)); err != nil {
+			t.Errorf("%s missing: %v", name, err)
+		}
+	}
+	for _, name := range []string{"opt/keep", "opt/gone", "usr/lib", ".prefetch.landmark", "stargz.index.json"} {
+		if _, err := os.Lstat(filepath.Join(dir, name)); !os.IsNotExist(err) {
+			t.Errorf("%s present: %v", name, err)
+		}
+	}
+}
+
+func TestLazyExtractStops(t *testing.T) {
+	dir := t.TempDir()
+	tr := tar.NewReader(layerTar(t, ".no.prefetch.landmark", "a", "b"))
+	owners := newLayerOwners()
+	if _, more, err := extractPrioritized(tr, dir, 0, owners); err != nil || !more {
+		t.Fatalf("extractPrioritized = %v, %v", more, err)
+	}
+	stop := make(chan struct{})
+	close(stop)
+	if _, err := extractRemaining(tr, dir, 0, owners, stop); err != errExtractStopped {
+		t.Errorf("extractRemaining after stop = %v, want errExtractStopped", err)
+	}
+	if _, err := os.Stat(filepath.Join(dir, "a")); !os.IsNotExist(err) {
+		t.Errorf("extracted after stop: %v", err)
+	}
+}
@@ -3,7 +3,6 @@
 package main
 
 import (
-	"bytes"
 	"fmt"
 	"io"
 	"math/rand"
@@ -36,6 +35,8 @@ var (
 	entrypoint    string
 	netMode       string
 	crunDebug     bool
+	layerCache    string
+	lazy          bool
 )
 
 func main() {
@@ -68,6 +69,10 @@ The container is automatically removed when it exits.`,
 	runCmd.Flags().StringVar(&entrypoint, "entrypoint", "", "Override the image entrypoint")
 	runCmd.Flags().StringVar(&netMode, "net", "none", "Network mode: 'none' (isolated) or 'host' (share host network)")
 	runCmd.Flags().BoolVar(&crunDebug, "crun-debug", false, "Enable libcrun debug logs")
+	runCmd.Flags().StringVar(&layerCache, "layer-cache", "/var/cache/crungo/layers",
+		"Directory of extracted layers shared by runs, the rootfs is an overlay of them ('' extracts a fresh copy per run)")
+	runCmd.Flags().BoolVar(&lazy, "lazy", false,
+		"Start once the prioritized files of eStargz layers are extracted, and extract the rest in the background (ignores --layer-cache)")
 
 	rootCmd.AddCommand(runCmd)
 
@@ -94,12 +99,31 @@ func runContainer(cmd *cobra.Command, args []string) error {
 		ctrName = generateName()
 	}
 
-	// Pull and extract image
-	pulled, err := PullAndExtract(imageRef)
-	if err != nil {
-		return fmt.Errorf("failed to pull image: %w", err)
+	// Pull the image, and extract the layers not cached yet
+	var pulled *PulledImage
+	if lazy {
+		var err error
+		pulled, err = PullAndExtractLazy(imageRef)
+		if err != nil {
+			return fmt.Errorf("failed to pull image: %w", err)
+		}
+	} else if layerCache != "" {
+		store, err := crun.NewLayerStore(layerCache)
+		if err != nil {
+			return fmt.Errorf("failed to open layer cache: %w", err)
+		}
+		pulled, err = PullWithLayerCache(imageRef, store)
+		if err != nil {
+			return fmt.Errorf("failed to pull image: %w", err)
+		}
+	} else {
+		var err error
+		pulled, err = PullAndExtract(imageRef)
+		if err != nil {
+			return fmt.Errorf("failed to pull image: %w", err)
+		}
 	}
-	defer os.RemoveAll(pulled.RootFS)
+	defer pulled.Cleanup()
 
 	// Create state root
 	stateRoot, err := os.MkdirTemp("", "crungo-state-*")
@@ -287,6 +311,23 @@ func determineCommand(config ImageConfig, containerCmd []string) []string {
 	return config.Cmd
 }
 
+// Output kept per stream by runNonInteractive.
+const (
+	captureHeadSize = 1 << 20
+	captureTailSize = 1 << 20
+)
+
+// printCapture writes the captured head and tail of a stream to w, with a
+// note of how much was dropped in between.
+func printCapture(w io.Writer, c *crun.Capture) {
+	head, tail := c.Head(), c.Tail()
+	w.Write(head)
+	if n := c.Truncated(); n > 0 {
+		fmt.Fprintf(w, "\n[... %d bytes truncated ...]\n", n)
+	}
+	w.Write(tail)
+}
+
 func runNonInteractive(stateRoot, ctrName string, specOpts []crun.SpecOption) error {
 	// Create runtime context (no console socket needed)
 	rc, err := crun.NewRuntimeContext(crun.RuntimeConfig{
@@ -304,11 +345,14 @@ func runNonInteractive(stateRoot, ctrName string, specOpts []crun.SpecOption) er
 	}
 	defer spec.Close()
 
-	var stdout, stderr bytes.Buffer
+	// Keep the first and last MiB of each stream, so that a runaway
+	// container cannot exhaust our memory
+	stdout := crun.NewCapture(captureHeadSize, captureTailSize)
+	stderr := crun.NewCapture(captureHeadSize, captureTailSize)
 
 	result, err := rc.RunWithIO(ctrName, spec, &crun.IOConfig{
-		Stdout: &stdout,
-		Stderr: &stderr,
+		Stdout: stdout,
+		Stderr: stderr,
 	})
 	if err != nil {
 		return fmt.Errorf("failed to run container: %w", err)
@@ -320,12 +364,8 @@ func runNonInteractive(stateRoot, ctrName string, specOpts []crun.SpecOption) er
 	}
 
 	// Print output
-	if stdout.Len() > 0 {
-		io.Copy(os.Stdout, &stdout)
-	}
-	if stderr.Len() > 0 {
-		io.Copy(os.Stderr, &stderr)
-	}
+	printCapture(os.Stdout, stdout)
+	printCapture(os.Stderr, stderr)
 
 	// Show exit code
 	fmt.Fprintf(os.Stderr, "Container exited with code %d\n", exitCode)
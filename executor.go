@@ -0,0 +1,166 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"runtime"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// ExecutorStats reports the executor of a RuntimeContext created with
+// RuntimeConfig.Workers.
+type ExecutorStats struct {
+	// Workers is the number of worker threads, 0 without an executor.
+	Workers int
+	// Queued and Running are the calls waiting for a worker and being
+	// run; MaxQueued is the highest Queued seen.
+	Queued, Running, MaxQueued int64
+	// Completed counts the calls run, and QueueWait adds up the time they
+	// waited for a worker.
+	Completed int64
+	QueueWait time.Duration
+}
+
+// executor runs blocking libcrun calls on a fixed set of goroutines, each
+// locked to an OS thread of its own for good: however many goroutines
+// call libcrun at once, that many threads are blocked in C at most, where
+// the Go runtime would start a thread for each blocked call. The threads
+// exit with their worker, which discards whatever thread state the calls
+// altered.
+type executor struct {
+	tasks   chan *executorTask
+	workers int
+	wg      sync.WaitGroup
+
+	queued, running, maxQueued atomic.Int64
+	completed, waitNs          atomic.Int64
+}
+
+type executorTask struct {
+	fn      func()
+	panic   any
+	enqueue time.Time
+	done    chan struct{}
+}
+
+var executorTaskPool = sync.Pool{New: func() any { return &executorTask{done: make(chan struct{}, 1)} }}
+
+func newExecutor(workers int) *executor {
+	e := &executor{tasks: make(chan *executorTask), workers: workers}
+	e.wg.Add(workers)
+	for i := 0; i < workers; i++ {
+		go e.work()
+	}
+	return e
+}
+
+func (e *executor) work() {
+	defer e.wg.Done()
+	runtime.LockOSThread() // never unlocked: the thread exits with the goroutine
+	for t := range e.tasks {
+		e.queued.Add(-1)
+		e.running.Add(1)
+		e.waitNs.Add(int64(time.Since(t.enqueue)))
+		t.panic = runTask(t.fn)
+		e.running.Add(-1)
+		e.completed.Add(1)
+		t.done <- struct{}{}
+	}
+}
+
+func runTask(fn func()) (p any) {
+	defer func() { p = recover() }()
+	fn()
+	return nil
+}
+
+// run runs fn on a worker and returns once it is done. A panic of fn, such
+// as one of a log handler, is raised again in the caller.
+func (e *executor) run(fn func()) {
+	t := executorTaskPool.Get().(*executorTask)
+	t.fn, t.enqueue = fn, time.Now()
+	if q := e.queued.Add(1); q > e.maxQueued.Load() {
+		e.maxQueued.Store(q) // racy, but a queue depth is approximate anyway
+	}
+	e.tasks <- t
+	<-t.done
+	p := t.panic
+	*t = executorTask{done: t.done}
+	executorTaskPool.Put(t)
+	if p != nil {
+		panic(p)
+	}
+}
+
+// close stops the workers once the calls in progress are done.
+func (e *executor) close() {
+	close(e.tasks)
+	e.wg.Wait()
+}
+
+func (e *executor) stats() ExecutorStats {
+	return ExecutorStats{
+		Workers:   e.workers,
+		Queued:    e.queued.Load(),
+		Running:   e.running.Load(),
+		MaxQueued: e.maxQueued.Load(),
+		Completed: e.completed.Load(),
+		QueueWait: time.Duration(e.waitNs.Load()),
+	}
+}
+
+// ExecutorStats returns the queue metrics of the context's executor, zero
+// without one.
+func (x *RuntimeContext) ExecutorStats() ExecutorStats {
+	if x == nil || x.exec == nil {
+		return ExecutorStats{}
+	}
+	return x.exec.stats()
+}
+
+// onWorker runs fn, a blocking libcrun call, on the context's executor
+// when it has one, else in the calling goroutine.
+func (x *RuntimeContext) onWorker(fn func() C.int) C.int {
+	if x.exec == nil {
+		return fn()
+	}
+	var rc C.int
+	x.exec.run(func() { rc = fn() })
+	return rc
+}
+
+// blocking is onWorker for a call whose logs are attributed to container
+// cid (beginLog), on the thread that makes the call.
+func (x *RuntimeContext) blocking(cid *C.char, fn func() C.int) C.int {
+	if x.exec == nil {
+		logged := x.beginLog(cid)
+		rc := fn()
+		endLog(logged)
+		return rc
+	}
+	var rc C.int
+	x.exec.run(func() {
+		logged := x.beginLog(cid)
+		rc = fn()
+		endLog(logged)
+	})
+	return rc
+}
+
+// blockingUnlessAttached is blocking for an in-process exec, which waits
+// for the process to exit unless the context detaches: only a detached
+// one goes to a worker.
+func (x *RuntimeContext) blockingUnlessAttached(cid *C.char, fn func() C.int) C.int {
+	if !bool(x.c.detach) {
+		logged := x.beginLog(cid)
+		defer endLog(logged)
+		return fn()
+	}
+	return x.blocking(cid, fn)
+}
@@ -0,0 +1,93 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"sync"
+	"syscall"
+	"testing"
+)
+
+func TestExecutorBoundsThreads(t *testing.T) {
+	e := newExecutor(2)
+	defer e.close()
+
+	const calls = 16
+	release := make(chan struct{})
+	var mu sync.Mutex
+	tids := map[int]bool{}
+	var wg sync.WaitGroup
+	for i := 0; i < calls; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			e.run(func() {
+				mu.Lock()
+				tids[syscall.Gettid()] = true
+				mu.Unlock()
+				<-release
+			})
+		}()
+	}
+	waitFor(t, "the workers to be busy and the rest queued", func() bool {
+		st := e.stats()
+		return st.Running == 2 && st.Queued == calls-2
+	})
+	close(release)
+	wg.Wait()
+
+	if len(tids) > 2 {
+		t.Errorf("calls ran on %d threads, want at most 2", len(tids))
+	}
+	st := e.stats()
+	if st.Workers != 2 || st.Completed != calls || st.Queued != 0 || st.Running != 0 {
+		t.Errorf("stats = %+v", st)
+	}
+	if st.MaxQueued < calls-2 || st.QueueWait <= 0 {
+		t.Errorf("MaxQueued = %d, QueueWait = %v", st.MaxQueued, st.QueueWait)
+	}
+}
+
+func TestExecutorPanic(t *testing.T) {
+	e := newExecutor(1)
+	defer e.close()
+	func() {
+		defer func() {
+			if p := recover(); p != "boom" {
+				t.Errorf("recovered %v, want boom", p)
+			}
+		}()
+		e.run(func() { panic("boom") })
+	}()
+	ran := false
+	e.run(func() { ran = true }) // the worker survived
+	if !ran {
+		t.Error("call after a panic did not run")
+	}
+}
+
+func TestRuntimeContextWorkers(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir(), Workers: 2})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+	if _, err := rc.ListIDs(); err != nil {
+		t.Fatalf("ListIDs failed: %v", err)
+	}
+	if _, _, err := rc.Get("missing").Status(); err == nil {
+		t.Error("Status of a missing container succeeded")
+	}
+	if st := rc.ExecutorStats(); st.Workers != 2 || st.Completed != 2 {
+		t.Errorf("ExecutorStats = %+v, want 2 workers and 2 calls", st)
+	}
+
+	plain, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer plain.Close()
+	if st := plain.ExecutorStats(); st != (ExecutorStats{}) {
+		t.Errorf("ExecutorStats without workers = %+v", st)
+	}
+}
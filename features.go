@@ -0,0 +1,246 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"strconv"
+	"sync"
+	"syscall"
+	"unsafe"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+// CgroupFeatures reports the cgroup managers libcrun supports.
+type CgroupFeatures struct {
+	V1          bool
+	V2          bool
+	Systemd     bool
+	SystemdUser bool
+}
+
+// SeccompFeatures reports libcrun's seccomp support.
+type SeccompFeatures struct {
+	Enabled   bool
+	Actions   []string // e.g. "SCMP_ACT_ERRNO"
+	Operators []string // e.g. "SCMP_CMP_EQ"
+	Archs     []string // e.g. "SCMP_ARCH_X86_64"
+}
+
+// RuntimeFeatures describes what this libcrun build supports, as reported
+// by libcrun_container_get_features (the data of "crun features").
+type RuntimeFeatures struct {
+	OCIVersionMin string
+	OCIVersionMax string
+	Hooks         []string
+	MountOptions  []string
+	Namespaces    []string
+	Capabilities  []string
+	Cgroup        CgroupFeatures
+	Seccomp       SeccompFeatures
+	AppArmor      bool
+	SELinux       bool
+	IDMapMounts   bool
+	IntelRdt      bool
+	NetDevices    bool
+
+	Version           string // crun version
+	Commit            string
+	CheckpointRestore bool // built with CRIU support
+
+	namespaces   map[string]struct{}
+	capabilities map[string]struct{}
+	actions      map[string]struct{}
+	operators    map[string]struct{}
+	archs        map[string]struct{}
+}
+
+var features struct {
+	once sync.Once
+	f    *RuntimeFeatures
+	err  error
+}
+
+// Features returns the features of the linked libcrun. They are queried
+// once per process; the result must not be modified.
+func Features() (*RuntimeFeatures, error) {
+	features.once.Do(func() {
+		features.f, features.err = loadFeatures()
+	})
+	return features.f, features.err
+}
+
+func loadFeatures() (*RuntimeFeatures, error) {
+	var info *C.struct_features_info_s
+	var err C.libcrun_error_t
+	if C.go_crun_get_features(&info, &err) < 0 {
+		return nil, fromLibcrunErr(&err)
+	}
+	defer C.go_crun_free_features(info)
+
+	lx := &info.linux
+	f := &RuntimeFeatures{
+		OCIVersionMin: optGoString(info.oci_version_min),
+		OCIVersionMax: optGoString(info.oci_version_max),
+		Hooks:         goStrv(info.hooks),
+		MountOptions:  goStrv(info.mount_options),
+		Namespaces:    goStrv(lx.namespaces),
+		Capabilities:  goStrv(lx.capabilities),
+		Cgroup: CgroupFeatures{
+			V1:          bool(lx.cgroup.v1),
+			V2:          bool(lx.cgroup.v2),
+			Systemd:     bool(lx.cgroup.systemd),
+			SystemdUser: bool(lx.cgroup.systemd_user),
+		},
+		Seccomp: SeccompFeatures{
+			Enabled:   bool(lx.seccomp.enabled),
+			Actions:   goStrv(lx.seccomp.actions),
+			Operators: goStrv(lx.seccomp.operators),
+			Archs:     goStrv(lx.seccomp.archs),
+		},
+		AppArmor:          bool(lx.apparmor.enabled),
+		SELinux:           bool(lx.selinux.enabled),
+		IDMapMounts:       bool(lx.mount_ext.idmap.enabled),
+		IntelRdt:          bool(lx.intel_rdt.enabled),
+		NetDevices:        bool(lx.net_devices.enabled),
+		Version:           optGoString(info.annotations.run_oci_crun_version),
+		Commit:            optGoString(info.annotations.run_oci_crun_commit),
+		CheckpointRestore: bool(info.annotations.run_oci_crun_checkpoint_enabled),
+	}
+	f.namespaces = stringSet(f.Namespaces)
+	f.capabilities = stringSet(f.Capabilities)
+	f.actions = stringSet(f.Seccomp.Actions)
+	f.operators = stringSet(f.Seccomp.Operators)
+	f.archs = stringSet(f.Seccomp.Archs)
+	return f, nil
+}
+
+func optGoString(s *C.char) string {
+	if s == nil {
+		return ""
+	}
+	return C.GoString(s)
+}
+
+// goStrv copies a NULL-terminated C string vector.
+func goStrv(v **C.char) []string {
+	if v == nil {
+		return nil
+	}
+	var out []string
+	for p := v; *p != nil; p = (**C.char)(unsafe.Add(unsafe.Pointer(p), unsafe.Sizeof(*p))) {
+		out = append(out, C.GoString(*p))
+	}
+	return out
+}
+
+func stringSet(v []string) map[string]struct{} {
+	m := make(map[string]struct{}, len(v))
+	for _, s := range v {
+		m[s] = struct{}{}
+	}
+	return m
+}
+
+// unsupported returns the ErrInvalidSpec error of a rejected configuration.
+func unsupported(what string) error {
+	return &Error{Code: ErrInvalidSpec, Message: "unsupported by libcrun: " + what, Status: int(syscall.ENOTSUP)}
+}
+
+// CheckSpec reports the first setting of sp that this libcrun cannot
+// apply: namespaces, capabilities, seccomp actions, operators and
+// architectures, idmapped mounts and Intel RDT (which also needs resctrl
+// mounted on the host). The error matches ErrInvalidContainerSpec.
+//
+// Lists that libcrun reports empty are not checked. It only looks at the
+// spec, so it runs in microseconds; NewContainerSpec calls it so that such
+// specs fail before any fork.
+func (f *RuntimeFeatures) CheckSpec(sp *specs.Spec) error {
+	if p := sp.Process; p != nil && p.Capabilities != nil {
+		c := p.Capabilities
+		for _, set := range [][]string{c.Bounding, c.Effective, c.Inheritable, c.Permitted, c.Ambient} {
+			for _, name := range set {
+				if _, ok := f.capabilities[name]; !ok && len(f.capabilities) > 0 {
+					return unsupported("capability " + strconv.Quote(name))
+				}
+			}
+		}
+	}
+	for i := range sp.Mounts {
+		m := &sp.Mounts[i]
+		if !f.IDMapMounts && (len(m.UIDMappings) > 0 || len(m.GIDMappings) > 0 || containsString(m.Options, "idmap")) {
+			return unsupported("idmapped mount " + strconv.Quote(m.Destination))
+		}
+	}
+	l := sp.Linux
+	if l == nil {
+		return nil
+	}
+	for _, ns := range l.Namespaces {
+		if _, ok := f.namespaces[string(ns.Type)]; !ok && len(f.namespaces) > 0 {
+			return unsupported("namespace " + strconv.Quote(string(ns.Type)))
+		}
+	}
+	if s := l.Seccomp; s != nil {
+		if !f.Seccomp.Enabled {
+			return unsupported("seccomp")
+		}
+		if err := f.checkSeccompAction(s.DefaultAction); err != nil {
+			return err
+		}
+		for _, a := range s.Architectures {
+			if _, ok := f.archs[string(a)]; !ok && len(f.archs) > 0 {
+				return unsupported("seccomp architecture " + strconv.Quote(string(a)))
+			}
+		}
+		for i := range s.Syscalls {
+			sc := &s.Syscalls[i]
+			if err := f.checkSeccompAction(sc.Action); err != nil {
+				return err
+			}
+			for _, arg := range sc.Args {
+				if _, ok := f.operators[string(arg.Op)]; !ok && len(f.operators) > 0 {
+					return unsupported("seccomp operator " + strconv.Quote(string(arg.Op)))
+				}
+			}
+		}
+	}
+	if l.IntelRdt != nil {
+		if !f.IntelRdt {
+			return unsupported("intelRdt")
+		}
+		if !resctrlMounted() {
+			return unsupported("intelRdt: resctrl is not mounted at " + resctrlRoot)
+		}
+	}
+	return nil
+}
+
+func (f *RuntimeFeatures) checkSeccompAction(a specs.LinuxSeccompAction) error {
+	if _, ok := f.actions[string(a)]; !ok && len(f.actions) > 0 {
+		return unsupported("seccomp action " + strconv.Quote(string(a)))
+	}
+	return nil
+}
+
+// rdtgroupSuperMagic is the f_type of resctrl.
+const rdtgroupSuperMagic = 0x7655821
+
+func resctrlMounted() bool {
+	var st syscall.Statfs_t
+	return syscall.Statfs(resctrlRoot, &st) == nil && st.Type == rdtgroupSuperMagic
+}
+
+// ValidateSpec checks sp against Features, see RuntimeFeatures.CheckSpec.
+// It succeeds without checking when the features cannot be queried.
+func ValidateSpec(sp *specs.Spec) error {
+	f, err := Features()
+	if err != nil {
+		return nil
+	}
+	return f.CheckSpec(sp)
+}
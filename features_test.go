@@ -0,0 +1,108 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"errors"
+	"testing"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+func TestFeatures(t *testing.T) {
+	f, err := Features()
+	if err != nil {
+		t.Fatalf("Features failed: %v", err)
+	}
+	if f2, _ := Features(); f2 != f {
+		t.Error("Features is not memoized")
+	}
+	if f.OCIVersionMax == "" || len(f.Namespaces) == 0 || len(f.Capabilities) == 0 {
+		t.Errorf("incomplete features: %+v", f)
+	}
+	if !containsString(f.Namespaces, "mount") || !containsString(f.Capabilities, "CAP_SYS_ADMIN") {
+		t.Errorf("namespaces %v / capabilities %v miss basic entries", f.Namespaces, f.Capabilities)
+	}
+}
+
+func TestCheckSpec(t *testing.T) {
+	f, err := Features()
+	if err != nil {
+		t.Fatalf("Features failed: %v", err)
+	}
+	base, err := DefaultSpec(false)
+	if err != nil {
+		t.Fatalf("DefaultSpec failed: %v", err)
+	}
+	if err := f.CheckSpec(base); err != nil {
+		t.Fatalf("default spec rejected: %v", err)
+	}
+
+	cases := []struct {
+		name string
+		mod  func(*specs.Spec)
+	}{
+		{"namespace", func(sp *specs.Spec) {
+			sp.Linux.Namespaces = append(sp.Linux.Namespaces, specs.LinuxNamespace{Type: "bogus"})
+		}},
+		{"capability", WithCapability("CAP_BOGUS")},
+		{"seccomp action", func(sp *specs.Spec) {
+			sp.Linux.Seccomp = &specs.LinuxSeccomp{DefaultAction: "SCMP_ACT_BOGUS"}
+		}},
+		{"seccomp arch", func(sp *specs.Spec) {
+			sp.Linux.Seccomp = &specs.LinuxSeccomp{DefaultAction: specs.ActAllow, Architectures: []specs.Arch{"SCMP_ARCH_BOGUS"}}
+		}},
+		{"seccomp operator", func(sp *specs.Spec) {
+			sp.Linux.Seccomp = &specs.LinuxSeccomp{DefaultAction: specs.ActAllow, Syscalls: []specs.LinuxSyscall{{
+				Names: []string{"read"}, Action: specs.ActErrno,
+				Args: []specs.LinuxSeccompArg{{Op: "SCMP_CMP_BOGUS"}},
+			}}}
+		}},
+	}
+	for _, tc := range cases {
+		sp, _ := DefaultSpec(false)
+		tc.mod(sp)
+		err := f.CheckSpec(sp)
+		if !f.Seccomp.Enabled && sp.Linux.Seccomp != nil {
+			// Rejected as a whole, before the action is looked at
+			tc.name = "seccomp"
+		}
+		if !errors.Is(err, ErrInvalidContainerSpec) {
+			t.Errorf("%s: CheckSpec = %v, want ErrInvalidContainerSpec", tc.name, err)
+		}
+		if _, err := NewContainerSpec(sp); !errors.Is(err, ErrInvalidContainerSpec) {
+			t.Errorf("%s: NewContainerSpec = %v, want ErrInvalidContainerSpec", tc.name, err)
+		}
+	}
+}
+
+func TestCheckSpecIntelRdtNeedsResctrl(t *testing.T) {
+	old := resctrlRoot
+	resctrlRoot = t.TempDir()
+	defer func() { resctrlRoot = old }()
+
+	sp, err := DefaultSpec(false)
+	if err != nil {
+		t.Fatalf("DefaultSpec failed: %v", err)
+	}
+	WithIntelRdt("", "L3:0=f", "")(sp)
+	if err := ValidateSpec(sp); !errors.Is(err, ErrInvalidContainerSpec) {
+		t.Errorf("ValidateSpec = %v, want ErrInvalidContainerSpec without resctrl", err)
+	}
+}
+
+func BenchmarkValidateSpec(b *testing.B) {
+	sp, err := DefaultSpec(false)
+	if err != nil {
+		b.Fatalf("DefaultSpec failed: %v", err)
+	}
+	if _, err := Features(); err != nil {
+		b.Fatalf("Features failed: %v", err)
+	}
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if err := ValidateSpec(sp); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
@@ -0,0 +1,130 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"context"
+	"errors"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+// fakeFreezeGroup points cgroupRoot at a fake cgroup v2 mount with a
+// thawed cgroup at path, and returns its directory and a context.
+func fakeFreezeGroup(t *testing.T, path string) (string, *RuntimeContext) {
+	t.Helper()
+	old := cgroupRoot
+	cgroupRoot = t.TempDir()
+	t.Cleanup(func() { cgroupRoot = old })
+	if err := os.WriteFile(filepath.Join(cgroupRoot, "cgroup.controllers"), []byte("cpu memory pids\n"), 0o644); err != nil {
+		t.Fatal(err)
+	}
+	dir := filepath.Join(cgroupRoot, path)
+	if err := os.MkdirAll(dir, 0o755); err != nil {
+		t.Fatal(err)
+	}
+	if err := os.WriteFile(filepath.Join(dir, "cgroup.freeze"), []byte("0"), 0o644); err != nil {
+		t.Fatal(err)
+	}
+	if err := os.WriteFile(filepath.Join(dir, "cgroup.events"), []byte("populated 1\nfrozen 0\n"), 0o644); err != nil {
+		t.Fatal(err)
+	}
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	t.Cleanup(func() { rc.Close() })
+	return dir, rc
+}
+
+// kernelFreezes plays the kernel: once dir's cgroup.freeze holds want, it
+// reports frozen in cgroup.events.
+func kernelFreezes(dir, want, frozen string) {
+	go func() {
+		for i := 0; i < 500; i++ {
+			if b, _ := os.ReadFile(filepath.Join(dir, "cgroup.freeze")); string(b) == want {
+				_ = os.WriteFile(filepath.Join(dir, "cgroup.events"), []byte("populated 1\nfrozen "+frozen+"\n"), 0o644)
+				return
+			}
+			time.Sleep(10 * time.Millisecond)
+		}
+	}()
+}
+
+func TestFreezeGroup(t *testing.T) {
+	dir, rc := fakeFreezeGroup(t, "tenant-a")
+	ctx, cancel := context.WithTimeout(context.Background(), 10*time.Second)
+	defer cancel()
+
+	kernelFreezes(dir, "1", "1")
+	if err := rc.FreezeGroup(ctx, "tenant-a"); err != nil {
+		t.Fatalf("FreezeGroup failed: %v", err)
+	}
+	if b, _ := os.ReadFile(filepath.Join(dir, "cgroup.freeze")); string(b) != "1" {
+		t.Errorf("cgroup.freeze = %q, want %q", b, "1")
+	}
+	// Already frozen: no wait
+	if err := rc.FreezeGroup(ctx, "/tenant-a/"); err != nil {
+		t.Errorf("second FreezeGroup failed: %v", err)
+	}
+
+	kernelFreezes(dir, "0", "0")
+	if err := rc.ThawGroup(ctx, "tenant-a"); err != nil {
+		t.Fatalf("ThawGroup failed: %v", err)
+	}
+	if b, _ := os.ReadFile(filepath.Join(dir, "cgroup.freeze")); string(b) != "0" {
+		t.Errorf("cgroup.freeze = %q, want %q", b, "0")
+	}
+}
+
+func TestFreezeGroupCanceled(t *testing.T) {
+	_, rc := fakeFreezeGroup(t, "tenant-a")
+	ctx, cancel := context.WithTimeout(context.Background(), 100*time.Millisecond)
+	defer cancel()
+
+	if err := rc.FreezeGroup(ctx, "tenant-a"); !errors.Is(err, context.DeadlineExceeded) {
+		t.Errorf("FreezeGroup = %v, want %v", err, context.DeadlineExceeded)
+	}
+}
+
+func TestFreezeGroupSlice(t *testing.T) {
+	dir, rc := fakeFreezeGroup(t, "tenant.slice/tenant-a.slice")
+	ctx, cancel := context.WithTimeout(context.Background(), 10*time.Second)
+	defer cancel()
+
+	kernelFreezes(dir, "1", "1")
+	if err := rc.FreezeGroup(ctx, "tenant-a.slice"); err != nil {
+		t.Fatalf("FreezeGroup failed: %v", err)
+	}
+	for slice, want := range map[string]string{
+		"a.slice":     "/a.slice",
+		"a-b-c.slice": "/a.slice/a-b.slice/a-b-c.slice",
+		"-.slice":     "/",
+	} {
+		if got := sliceCgroupPath(slice); got != want {
+			t.Errorf("sliceCgroupPath(%q) = %q, want %q", slice, got, want)
+		}
+	}
+}
+
+func TestFreezeGroupInvalid(t *testing.T) {
+	_, rc := fakeFreezeGroup(t, "tenant-a")
+	ctx := context.Background()
+
+	for _, bad := range []string{"", "/", "-.slice", "../tenant-a", "tenant-a/../.."} {
+		if err := rc.FreezeGroup(ctx, bad); err == nil {
+			t.Errorf("FreezeGroup(%q) succeeded", bad)
+		}
+	}
+	var e *Error
+	if err := rc.FreezeGroup(ctx, "tenant-b"); !errors.As(err, &e) || e.Code != ErrNotFound {
+		t.Errorf("FreezeGroup of a missing group = %v, want a not found error", err)
+	}
+
+	os.Remove(filepath.Join(cgroupRoot, "cgroup.controllers"))
+	if err := rc.FreezeGroup(ctx, "tenant-a"); err == nil {
+		t.Error("FreezeGroup succeeded without cgroup v2")
+	}
+}
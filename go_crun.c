@@ -1,22 +1,58 @@
 // go_crun.c - C helper function implementations for libcrun Go bindings
 #include "libcrun/include/go_crun.h"
+#include <libcrun/cgroup.h>
+#include <libcrun/cgroup-internal.h>
+#include <libcrun/cgroup-utils.h>
+#include <libcrun/custom-handler.h>
+#include <libcrun/linux.h>
+#include <libcrun/seccomp.h>
+#include <libcrun/ebpf.h>
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <dirent.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <poll.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <limits.h>
+#include <linux/bpf.h>
+#include <linux/capability.h>
 
 // Forward declaration of the Go callback (defined via //export in runtime.go)
-extern void goLogCallback(uintptr_t handle, int errno_, const char *msg, int verbosity);
+extern void goLogCallback(uintptr_t handle, int errno_, const char *msg, int verbosity, const char *id);
 
 // Global handle for the Go log callback (0 = no callback set)
 static uintptr_t go_log_handle = 0;
 
+// Per-thread routing set by go_crun_log_enter for the duration of one
+// libcrun call: the RuntimeContext's handle (0 = use the global one) and
+// the id of the container being operated on.
+static __thread uintptr_t go_log_tls_handle = 0;
+static __thread const char *go_log_tls_id = NULL;
+
+// Set once any thread has routed logs; keeps go_crun_log_callback installed
+static int go_log_routed = 0;
+
 // C wrapper matching crun_output_handler signature
 static void go_crun_log_callback(int errno_, const char *msg, int verbosity, void *arg) {
-    (void)arg; // We use the global handle instead
-    if (go_log_handle != 0) {
-        goLogCallback(go_log_handle, errno_, msg, verbosity);
+    uintptr_t h = go_log_tls_handle != 0 ? go_log_tls_handle : go_log_handle;
+    if (h != 0) {
+        goLogCallback(h, errno_, msg, verbosity, go_log_tls_id);
+    } else {
+        log_write_to_stderr(errno_, msg, verbosity, arg);
     }
 }
 
@@ -25,10 +61,31 @@ void go_crun_set_log_handler(uintptr_t handle) {
     crun_set_output_handler(go_crun_log_callback, NULL);
 }
 
+static void go_crun_install_log_callback(void) {
+    __atomic_store_n(&go_log_routed, 1, __ATOMIC_RELEASE);
+    crun_set_output_handler(go_crun_log_callback, NULL);
+}
+
+void go_crun_log_enter(uintptr_t handle, const char *id) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, go_crun_install_log_callback);
+    go_log_tls_handle = handle;
+    go_log_tls_id = id;
+}
+
+void go_crun_log_leave(void) {
+    go_log_tls_handle = 0;
+    go_log_tls_id = NULL;
+}
+
 void go_crun_reset_log_handler(void) {
     go_log_handle = 0;
-    // Reset to default stderr handler (not NULL, which would cause SIGSEGV)
-    crun_set_output_handler(log_write_to_stderr, NULL);
+    // Reset to default stderr handler (not NULL, which would cause SIGSEGV).
+    // With routing in use the wrapper stays; it falls back to stderr itself.
+    if (__atomic_load_n(&go_log_routed, __ATOMIC_ACQUIRE))
+        crun_set_output_handler(go_crun_log_callback, NULL);
+    else
+        crun_set_output_handler(log_write_to_stderr, NULL);
 }
 
 // Log handler that writes structured log entries to a pipe.
@@ -36,34 +93,93 @@ void go_crun_reset_log_handler(void) {
 // The arg parameter is the file descriptor (cast to intptr_t).
 static void log_write_to_pipe(int errno_, const char *msg, int verbosity, void *arg) {
     int fd = (int)(intptr_t)arg;
-    int32_t e = (int32_t)errno_;
-    int32_t v = (int32_t)verbosity;
-    uint32_t len = (uint32_t)strlen(msg);
-    ssize_t ignored __attribute__((unused));
-    
-    // Write header and message (best effort, ignore errors)
-    ignored = write(fd, &e, sizeof(e));
-    ignored = write(fd, &v, sizeof(v));
-    ignored = write(fd, &len, sizeof(len));
-    ignored = write(fd, msg, len);
+    int32_t hdr[3];
+    size_t len = strlen(msg);
+    struct iovec iov[2];
+
+    // Header (errno, verbosity, length) and body go out in one writev so the
+    // frame is not interleaved with other writers; frames up to PIPE_BUF are
+    // atomic on a pipe.
+    hdr[0] = (int32_t)errno_;
+    hdr[1] = (int32_t)verbosity;
+    hdr[2] = (int32_t)(uint32_t)len;
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = (void *)msg;
+    iov[1].iov_len = len;
+
+    // Best effort: finish short writes, give up on errors
+    struct iovec *v = iov;
+    int cnt = 2;
+    while (cnt > 0) {
+        ssize_t n = writev(fd, v, cnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        while (cnt > 0 && (size_t)n >= v->iov_len) {
+            n -= v->iov_len;
+            v++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            v->iov_base = (char *)v->iov_base + n;
+            v->iov_len -= n;
+        }
+    }
 }
 
-// ---- libcrun error → C string helper ----
-char* go_crun_err_to_cstr(libcrun_error_t *err, int *status) {
-  if (status) *status = 0;
-  if (err == NULL || *err == NULL) return NULL;
+// ---- libcrun error classification ----
+// Matches needle against the message, then against strerror(status): the
+// categories were historically derived from the formatted "msg: strerror"
+// text and must stay stable.
+static int go_crun_err_mentions(const char *msg, const char *serr, const char *needle) {
+  return strcasestr(msg, needle) != NULL || (serr != NULL && strcasestr(serr, needle) != NULL);
+}
 
-  char *p = NULL;
-  if (status) *status = (*err)->status;
+int go_crun_err_category(const char *msg, int status) {
+  const char *serr = status != 0 ? strerror(status) : NULL;
+  if (msg == NULL) msg = "";
+  if (go_crun_err_mentions(msg, serr, "not found") || go_crun_err_mentions(msg, serr, "does not exist"))
+    return GO_CRUN_ERR_NOT_FOUND;
+  if (go_crun_err_mentions(msg, serr, "already exists"))
+    return GO_CRUN_ERR_ALREADY_EXISTS;
+  if (go_crun_err_mentions(msg, serr, "invalid") || go_crun_err_mentions(msg, serr, "parse"))
+    return GO_CRUN_ERR_INVALID_SPEC;
+  if (go_crun_err_mentions(msg, serr, "permission") || status == EPERM || status == EACCES)
+    return GO_CRUN_ERR_PERMISSION_DENIED;
+  if (go_crun_err_mentions(msg, serr, "not running"))
+    return GO_CRUN_ERR_CONTAINER_NOT_RUNNING;
+  if (go_crun_err_mentions(msg, serr, "running"))
+    return GO_CRUN_ERR_CONTAINER_RUNNING;
+  return GO_CRUN_ERR_UNKNOWN;
+}
 
-  if ((*err)->status == 0) {
-    p = strdup((*err)->msg);
-  } else {
-    if (asprintf(&p, "%s: %s", (*err)->msg, strerror((*err)->status)) < 0)
-      p = NULL;
-  }
+int go_crun_err_classify_release(libcrun_error_t *err) {
+  if (err == NULL || *err == NULL) return GO_CRUN_ERR_UNKNOWN;
+  int category = go_crun_err_category((*err)->msg, (*err)->status);
   libcrun_error_release(err);
-  return p;
+  return category;
+}
+
+// ---- Custom handlers ----
+// One handler manager serves every context of the process: libcrun refuses
+// a Handler, or a container annotated for one, without a manager, and the
+// handlers it registers are static and shared. It is created on first use
+// and never freed.
+static struct custom_handler_manager_s *go_crun_handlers;
+static pthread_once_t go_crun_handlers_once = PTHREAD_ONCE_INIT;
+
+static void go_crun_handlers_init(void) {
+  libcrun_error_t err = NULL;
+  go_crun_handlers = libcrun_handler_manager_create(&err);
+  if (go_crun_handlers == NULL)
+    libcrun_error_release(&err);
+}
+
+struct custom_handler_manager_s *go_crun_handler_manager(void) {
+  pthread_once(&go_crun_handlers_once, go_crun_handlers_init);
+  return go_crun_handlers;
 }
 
 // ---- RuntimeContext allocation / free ----
@@ -71,6 +187,7 @@ libcrun_context_t* go_crun_new_context(void) {
   libcrun_context_t *ctx = (libcrun_context_t*) calloc(1, sizeof(libcrun_context_t));
   if (!ctx) return NULL;
   ctx->fifo_exec_wait_fd = -1;
+  ctx->handler_manager = go_crun_handler_manager();
   return ctx;
 }
 
@@ -86,15 +203,41 @@ void go_crun_free_context(libcrun_context_t *ctx) {
   free(ctx);
 }
 
+// ---- Per-operation context clones ----
+// A clone is a shallow copy of a base context: it shares the base's strings,
+// which must outlive it, and owns only its id. dst may be a previous clone to
+// reuse (its id is released) or NULL to allocate a new one.
+libcrun_context_t* go_crun_clone_context(libcrun_context_t *dst, const libcrun_context_t *base, const char *id) {
+  char *owned_id = NULL;
+  if (id) {
+    owned_id = strdup(id);
+    if (!owned_id) return NULL;
+  }
+  if (!dst) {
+    dst = (libcrun_context_t*) malloc(sizeof(libcrun_context_t));
+    if (!dst) {
+      free(owned_id);
+      return NULL;
+    }
+  } else {
+    free((char*)dst->id);
+  }
+  memcpy(dst, base, sizeof(*dst));
+  dst->id = owned_id;
+  return dst;
+}
+
+void go_crun_free_context_clone(libcrun_context_t *ctx) {
+  if (!ctx) return;
+  free((char*)ctx->id);
+  free(ctx);
+}
+
 // ---- Container release (mirror Python binding: free container_def) ----
 void go_crun_free_container(libcrun_container_t *ctr) {
-  if (!ctr) return;
-  if (ctr->container_def) {
-    free_runtime_spec_schema_config_schema(ctr->container_def);
-    ctr->container_def = NULL;
-  }
-  // libcrun doesn't expose a destructor for the opaque container struct here;
-  // Python binding frees only container_def. We do the same.
+  // Frees container_def and also the JSON text libcrun keeps next to it,
+  // which is as large as the document
+  libcrun_container_free(ctr);
 }
 
 // ---- JSON sinks via open_memstream ----
@@ -149,11 +292,18 @@ void go_crun_free_strv(char **v, int n) {
   free(v);
 }
 
+int go_crun_state_dir(const char *state_root, char **out, libcrun_error_t *err) {
+  return get_run_directory(out, state_root, err);
+}
+
 // ---- Exec/update: runtime process JSON ----
-int go_crun_exec_json(libcrun_context_t *ctx, const char *id, const char *json, libcrun_error_t *err) {
+static runtime_spec_schema_config_schema_process *go_crun_parse_process(const char *json, libcrun_error_t *err) {
   char errbuf[1024] = {0};
   yajl_val tree = yajl_tree_parse(json, errbuf, sizeof(errbuf));
-  if (!tree) return libcrun_make_error(err, 0, "cannot parse the data: `%s`", errbuf);
+  if (!tree) {
+    libcrun_make_error(err, 0, "cannot parse the data: `%s`", errbuf);
+    return NULL;
+  }
 
   parser_error p_err = NULL;
   struct parser_context pctx = { 0, stderr };
@@ -162,16 +312,63 @@ int go_crun_exec_json(libcrun_context_t *ctx, const char *id, const char *json,
   yajl_tree_free(tree);
 
   if (!proc) {
-    int rc = libcrun_make_error(err, 0, "cannot parse process: %s", p_err ? p_err : "unknown");
+    libcrun_make_error(err, 0, "cannot parse process: %s", p_err ? p_err : "unknown");
     free(p_err);
-    return rc;
   }
+  return proc;
+}
+
+// Execs proc, or a shallow copy of it with the args, env and cwd of ov
+// (NULL = none), so that a prepared process is never modified
+static int go_crun_exec_process(libcrun_context_t *ctx, const char *id,
+                                const runtime_spec_schema_config_schema_process *proc,
+                                const struct go_crun_overrides *ov,
+                                const char *cgroup, libcrun_error_t *err) {
+  runtime_spec_schema_config_schema_process p = *proc;
+  if (ov) {
+    if (ov->args) {
+      p.args = ov->args;
+      p.args_len = (size_t)ov->args_len;
+    }
+    if (ov->env) {
+      p.env = ov->env;
+      p.env_len = (size_t)ov->env_len;
+    }
+    if (ov->cwd) p.cwd = (char *)ov->cwd;
+  }
+
+  struct libcrun_container_exec_options_s opts;
+  memset(&opts, 0, sizeof(opts));
+  opts.struct_size = sizeof(opts);
+  opts.process = &p;
+  opts.cgroup = cgroup;
+  return libcrun_container_exec_with_options(ctx, id, &opts, err);
+}
+
+int go_crun_exec_json(libcrun_context_t *ctx, const char *id, const char *json, const char *cgroup, libcrun_error_t *err) {
+  runtime_spec_schema_config_schema_process *proc = go_crun_parse_process(json, err);
+  if (!proc) return -1;
 
-  int rc = libcrun_container_exec(ctx, id, proc, err);
+  int rc = go_crun_exec_process(ctx, id, proc, NULL, cgroup, err);
   free_runtime_spec_schema_config_schema_process(proc);
   return rc;
 }
 
+// ---- Prepared exec processes ----
+runtime_spec_schema_config_schema_process *go_crun_prepare_process(const char *json, libcrun_error_t *err) {
+  return go_crun_parse_process(json, err);
+}
+
+void go_crun_free_process(runtime_spec_schema_config_schema_process *proc) {
+  if (proc) free_runtime_spec_schema_config_schema_process(proc);
+}
+
+int go_crun_exec_prepared(libcrun_context_t *ctx, const char *id,
+                          const runtime_spec_schema_config_schema_process *proc,
+                          const struct go_crun_overrides *ov, const char *cgroup, libcrun_error_t *err) {
+  return go_crun_exec_process(ctx, id, proc, ov, cgroup, err);
+}
+
 // ---- Pause/Unpause ----
 int go_crun_pause(libcrun_context_t *ctx, const char *id, libcrun_error_t *err) {
   return libcrun_container_pause(ctx, id, err);
@@ -191,6 +388,75 @@ int go_crun_update(libcrun_context_t *ctx, const char *id, const char *content,
   return libcrun_container_update(ctx, id, content, len, err);
 }
 
+// ---- Update container resources from section/name/value triples ----
+int go_crun_update_values(libcrun_context_t *ctx, const char *id, struct libcrun_update_value_s *values, size_t len,
+                          libcrun_error_t *err) {
+  return libcrun_container_update_from_values(ctx, id, values, len, err);
+}
+
+int go_crun_update_batch(libcrun_context_t *ctx, struct go_crun_update_item *items, int n, int route_logs) {
+  int failed = 0;
+  for (int i = 0; i < n; i++) {
+    struct go_crun_update_item *item = &items[i];
+    if (route_logs)
+      go_log_tls_id = item->id;
+    if (libcrun_container_update_from_values(ctx, item->id, item->values, item->len, &item->err) < 0)
+      failed++;
+  }
+  return failed;
+}
+
+// ---- Intel RDT ----
+int go_crun_update_intel_rdt(libcrun_context_t *ctx, const char *id, const char *l3_cache_schema,
+                             const char *mem_bw_schema, char *const *schemata, libcrun_error_t *err) {
+  struct libcrun_intel_rdt_update update = {
+    .l3_cache_schema = l3_cache_schema,
+    .mem_bw_schema = mem_bw_schema,
+    .schemata = schemata,
+  };
+  return libcrun_container_update_intel_rdt(ctx, id, &update, err);
+}
+
+int go_crun_intel_rdt_group(libcrun_context_t *ctx, const char *id, char **clos_id, int *monitoring,
+                            libcrun_error_t *err) {
+  char *dir = NULL, *config = NULL;
+  *clos_id = NULL;
+  *monitoring = 0;
+  int rc = libcrun_get_state_directory(&dir, ctx->state_root, id, err);
+  if (rc < 0) return rc;
+  rc = asprintf(&config, "%s/config.json", dir);
+  free(dir);
+  if (rc < 0) return libcrun_make_error(err, ENOMEM, "cannot build config path");
+  libcrun_container_t *container = libcrun_container_load_from_file(config, err);
+  free(config);
+  if (!container) return -1;
+
+  rc = 0;
+  runtime_spec_schema_config_schema *def = container->container_def;
+  if (def && def->linux && def->linux->intel_rdt) {
+    runtime_spec_schema_config_linux_intel_rdt *rdt = def->linux->intel_rdt;
+    if (rdt->clos_id && !(*clos_id = strdup(rdt->clos_id)))
+      rc = libcrun_make_error(err, ENOMEM, "cannot copy closID");
+    else {
+      *monitoring = rdt->enable_monitoring;
+      rc = 1;
+    }
+  }
+  libcrun_container_free(container);
+  return rc;
+}
+
+// ---- Runtime features ----
+int go_crun_get_features(struct features_info_s **out, libcrun_error_t *err) {
+  libcrun_context_t ctx = {0};
+  *out = NULL;
+  return libcrun_container_get_features(&ctx, out, err);
+}
+
+void go_crun_free_features(struct features_info_s *info) {
+  cleanup_struct_features_free(&info);
+}
+
 // ---- Read container status for IsRunning check ----
 int go_crun_is_running(const char *state_root, const char *id, libcrun_error_t *err) {
   libcrun_container_status_t status = {0};
@@ -203,6 +469,271 @@ int go_crun_is_running(const char *state_root, const char *id, libcrun_error_t *
   return running;
 }
 
+// The pid recorded for the init of container id, whether it still runs or not
+int go_crun_status_pid(const char *state_root, const char *id, pid_t *pid, libcrun_error_t *err) {
+  libcrun_container_status_t status = {0};
+  int rc = libcrun_read_container_status(&status, state_root, id, err);
+  if (rc < 0) {
+    return rc;
+  }
+  *pid = status.pid;
+  libcrun_free_container_status(&status);
+  return 0;
+}
+
+// ---- Typed state ----
+// Same data as libcrun_container_state, without going through JSON.
+// The error is returned in out->err so that callers need a single
+// allocation for the whole call.
+int go_crun_read_state(libcrun_context_t *ctx, const char *id, int flags, struct go_crun_state *out) {
+  libcrun_container_status_t status = {0};
+  memset(out, 0, sizeof(*out));
+  libcrun_error_t *err = &out->err;
+
+  int rc = libcrun_read_container_status(&status, ctx->state_root, id, err);
+  if (rc < 0) return rc;
+
+  const char *state = NULL;
+  int running = 0;
+  rc = libcrun_get_container_state_string(id, &status, ctx->state_root, &state, &running, err);
+  if (rc < 0) goto out;
+  out->status = state;
+  out->pid = running ? status.pid : 0;
+
+  if (flags & GO_CRUN_STATE_CGROUP) {
+    out->cgroup_path = status.cgroup_path;
+    status.cgroup_path = NULL;
+  }
+  if (flags & GO_CRUN_STATE_DETAILS) {
+    // Hand the status strings over instead of copying them
+    out->bundle = status.bundle;
+    status.bundle = NULL;
+    out->created = status.created;
+    status.created = NULL;
+
+    // Annotations come from the config.json saved in the state directory
+    char *dir = NULL;
+    rc = libcrun_get_state_directory(&dir, ctx->state_root, id, err);
+    if (rc < 0) goto out;
+    char *config = NULL;
+    if (asprintf(&config, "%s/config.json", dir) < 0) {
+      free(dir);
+      rc = libcrun_make_error(err, ENOMEM, "cannot build config path");
+      goto out;
+    }
+    free(dir);
+    out->container = libcrun_container_load_from_file(config, err);
+    free(config);
+    if (!out->container) {
+      rc = -1;
+      goto out;
+    }
+    json_map_string_string *ann = out->container->container_def->annotations;
+    if (ann) {
+      out->annotation_keys = ann->keys;
+      out->annotation_values = ann->values;
+      out->annotations_len = (int)ann->len;
+    }
+  }
+  rc = 0;
+
+out:
+  libcrun_free_container_status(&status);
+  if (rc < 0) go_crun_free_state(out);
+  return rc;
+}
+
+void go_crun_free_state(struct go_crun_state *s) {
+  libcrun_error_t err = s->err;
+  free(s->bundle);
+  free(s->created);
+  free(s->cgroup_path);
+  if (s->container) libcrun_container_free(s->container);
+  memset(s, 0, sizeof(*s));
+  s->err = err;
+}
+
+// ---- Container handles ----
+static void go_crun_ref_drop_status(struct go_crun_container_ref *ref) {
+  libcrun_free_container_status(&ref->status);
+  memset(&ref->status, 0, sizeof(ref->status));
+  ref->cached = 0;
+}
+
+static void go_crun_ref_close_pidfd(struct go_crun_container_ref *ref) {
+  if (ref->pidfd >= 0) close(ref->pidfd);
+  ref->pidfd = -1;
+  ref->use_pidfd = 0;
+}
+
+void go_crun_ref_invalidate(struct go_crun_container_ref *ref) {
+  go_crun_ref_drop_status(ref);
+  go_crun_ref_close_pidfd(ref);
+}
+
+void go_crun_ref_free(struct go_crun_container_ref *ref) {
+  if (!ref) return;
+  go_crun_ref_invalidate(ref);
+  free(ref->id);
+  free(ref);
+}
+
+// Makes ref->status current: the cached one while its process is alive
+// (libcrun_is_container_running checks the pid and its start time), else
+// a fresh read of the status file. Returns whether the process is running.
+static int go_crun_ref_status(libcrun_context_t *ctx, struct go_crun_container_ref *ref, libcrun_error_t *err) {
+  int rc;
+  if (ref->cached) {
+    rc = libcrun_is_container_running(&ref->status, err);
+    if (rc != 0) return rc;
+  }
+  go_crun_ref_drop_status(ref);
+  rc = libcrun_read_container_status(&ref->status, ctx->state_root, ref->id, err);
+  if (rc < 0) return rc;
+  rc = libcrun_is_container_running(&ref->status, err);
+  if (rc < 0) return rc;
+  ref->cached = rc;
+  return rc;
+}
+
+int go_crun_ref_is_running(libcrun_context_t *ctx, struct go_crun_container_ref *ref, libcrun_error_t *err) {
+  return go_crun_ref_status(ctx, ref, err);
+}
+
+// Opens ref->pidfd for the init process. The status is checked again once
+// the pidfd is open, as the pid may have been reused in between. On any
+// failure the pidfd stays closed and Kill goes through libcrun.
+static void go_crun_ref_open_pidfd(libcrun_context_t *ctx, struct go_crun_container_ref *ref) {
+  libcrun_error_t err = NULL;
+  int rc = go_crun_ref_status(ctx, ref, &err);
+  if (rc <= 0) goto fail;
+  int fd = go_crun_pidfd_open(ref->status.pid);
+  if (fd < 0) {
+    if (errno == ENOSYS) ref->use_pidfd = 0;
+    return;
+  }
+  if (libcrun_check_pid_valid(&ref->status, &err) != 1) {
+    close(fd);
+    goto fail;
+  }
+  ref->pidfd = fd;
+  return;
+
+fail:
+  if (err) libcrun_error_release(&err);
+}
+
+// Same as libcrun_container_kill, but a single pidfd_send_signal once the
+// pidfd is open. When the process is gone the pidfd is dropped, and the
+// error is the one libcrun reports.
+int go_crun_ref_kill(libcrun_context_t *ctx, struct go_crun_container_ref *ref, const char *signal, libcrun_error_t *err) {
+  int sig = str2sig(signal);
+  if (sig < 0) return libcrun_make_error(err, 0, "unknown signal `%s`", signal);
+#ifdef SYS_pidfd_send_signal
+  if (ref->use_pidfd && ref->pidfd < 0) go_crun_ref_open_pidfd(ctx, ref);
+  if (ref->pidfd >= 0) {
+    if (syscall(SYS_pidfd_send_signal, ref->pidfd, sig, NULL, 0) == 0) return 0;
+    if (errno != ESRCH) return libcrun_make_error(err, errno, "pidfd_send_signal");
+    go_crun_ref_close_pidfd(ref);
+  }
+#endif
+  int rc = go_crun_ref_status(ctx, ref, err);
+  if (rc < 0) return rc;
+  return libcrun_kill_linux(&ref->status, sig, err);
+}
+
+// Same as libcrun_container_read_pids
+int go_crun_ref_read_pids(libcrun_context_t *ctx, struct go_crun_container_ref *ref, int recurse, pid_t **out_pids,
+                          int *out_len, libcrun_error_t *err) {
+  int rc = go_crun_ref_status(ctx, ref, err);
+  if (rc < 0) return rc;
+  if (ref->status.cgroup_path == NULL || ref->status.cgroup_path[0] == '\0')
+    return libcrun_make_error(err, 0, "the container is not using cgroups");
+  struct libcrun_cgroup_status *cg = libcrun_cgroup_make_status(&ref->status);
+  if (!cg) return libcrun_make_error(err, ENOMEM, "cannot allocate cgroup status");
+  pid_t *pids = NULL;
+  rc = libcrun_cgroup_read_pids(cg, recurse ? true : false, &pids, err);
+  libcrun_cgroup_status_free(cg);
+  if (rc < 0) return rc;
+  *out_pids = pids;
+  *out_len = rc;
+  return 0;
+}
+
+int go_crun_ref_read_state(libcrun_context_t *ctx, struct go_crun_container_ref *ref, int flags,
+                           struct go_crun_state *out) {
+  memset(out, 0, sizeof(*out));
+  libcrun_error_t *err = &out->err;
+  int rc = go_crun_ref_status(ctx, ref, err);
+  if (rc < 0) return rc;
+
+  const char *state = NULL;
+  int running = 0;
+  rc = libcrun_get_container_state_string(ref->id, &ref->status, ctx->state_root, &state, &running, err);
+  if (rc < 0) return rc;
+  out->status = state;
+  out->pid = running ? ref->status.pid : 0;
+  if ((flags & GO_CRUN_STATE_CGROUP) && ref->status.cgroup_path) {
+    out->cgroup_path = strdup(ref->status.cgroup_path);
+    if (!out->cgroup_path) return libcrun_make_error(err, ENOMEM, "strdup failed");
+  }
+  return 0;
+}
+
+// ---- Listing with status ----
+int go_crun_list_entries(const char *state_root, struct go_crun_list_entry **out, int *out_len, libcrun_error_t *err) {
+  libcrun_container_list_t *lst = NULL, *it = NULL;
+  int rc = libcrun_get_containers_list(&lst, state_root, err);
+  if (rc < 0) return rc;
+
+  int n = 0;
+  for (it = lst; it; it = it->next) n++;
+  struct go_crun_list_entry *arr = calloc((size_t)n + 1, sizeof(*arr));
+  if (!arr) {
+    libcrun_free_containers_list(lst);
+    return libcrun_make_error(err, ENOMEM, "calloc failed");
+  }
+  // Take over the names instead of duplicating them
+  int i = 0;
+  for (it = lst; it; it = it->next) {
+    arr[i++].id = it->name;
+    it->name = NULL;
+  }
+  libcrun_free_containers_list(lst);
+  *out = arr;
+  *out_len = n;
+  return 0;
+}
+
+void go_crun_read_list_states(const char *state_root, struct go_crun_list_entry *entries, int from, int to) {
+  for (int i = from; i < to; i++) {
+    struct go_crun_list_entry *e = &entries[i];
+    libcrun_container_status_t status = {0};
+    if (e->id == NULL || libcrun_read_container_status(&status, state_root, e->id, &e->err) < 0)
+      continue;
+    int running = 0;
+    if (libcrun_get_container_state_string(e->id, &status, state_root, &e->status, &running, &e->err) == 0) {
+      e->pid = running ? status.pid : 0;
+      e->bundle = status.bundle;
+      status.bundle = NULL;
+      e->created = status.created;
+      status.created = NULL;
+    }
+    libcrun_free_container_status(&status);
+  }
+}
+
+void go_crun_free_list_entries(struct go_crun_list_entry *entries, int n) {
+  if (!entries) return;
+  for (int i = 0; i < n; i++) {
+    free(entries[i].id);
+    free(entries[i].bundle);
+    free(entries[i].created);
+    if (entries[i].err) libcrun_error_release(&entries[i].err);
+  }
+  free(entries);
+}
+
 // ---- Read PIDs ----
 int go_crun_read_pids(libcrun_context_t *ctx, const char *id, int recurse, pid_t **out_pids, int *out_len, libcrun_error_t *err) {
   pid_t *pids = NULL;
@@ -217,147 +748,2478 @@ void go_crun_free_pids(pid_t *pids) {
   if (pids) free(pids);
 }
 
-// ---- Run container with isolated I/O via fork ----
-int go_crun_run_with_pipes(
-    libcrun_context_t *ctx,
-    libcrun_container_t *container,
-    unsigned int flags,
-    int stdin_fd,
-    int stdout_fd,
-    int stderr_fd,
-    int log_fd,
-    pid_t *out_pid,
-    libcrun_error_t *err
-) {
-  // Create a pipe to communicate errors from child to parent
-  int error_pipe[2];
-  if (pipe(error_pipe) < 0) {
-    return libcrun_make_error(err, errno, "pipe failed");
-  }
+// ---- Per-run spec overrides ----
 
-  pid_t pid = fork();
-  if (pid < 0) {
-    close(error_pipe[0]);
-    close(error_pipe[1]);
-    return libcrun_make_error(err, errno, "fork failed");
+static char **go_crun_strv_dup(char *const *v, size_t n) {
+  char **out = calloc(n + 1, sizeof(char *));
+  if (!out) return NULL;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = strdup(v[i]);
+    if (!out[i]) {
+      for (size_t j = 0; j < i; j++) free(out[j]);
+      free(out);
+      return NULL;
+    }
   }
+  return out;
+}
 
-  if (pid == 0) {
-    // Child process
-    close(error_pipe[0]); // Close read end
-    ssize_t ignored __attribute__((unused));
-
-    // Set up log handler for child process.
-    // The Go callback is not valid after fork, so we either:
-    // - Use log_write_to_pipe if log_fd >= 0 (parent will read from pipe)
-    // - Fall back to log_write_to_stderr otherwise
-    if (log_fd >= 0) {
-      crun_set_output_handler(log_write_to_pipe, (void *)(intptr_t)log_fd);
-    } else {
-      crun_set_output_handler(log_write_to_stderr, NULL);
-    }
+static void go_crun_strv_free(char **v, size_t n) {
+  if (!v) return;
+  for (size_t i = 0; i < n; i++) free(v[i]);
+  free(v);
+}
 
-    // Redirect stdin
-    if (stdin_fd >= 0) {
-      if (dup2(stdin_fd, STDIN_FILENO) < 0) {
-        int e = errno;
-        ignored = write(error_pipe[1], &e, sizeof(e));
-        _exit(1);
-      }
-      close(stdin_fd);
-    } else {
-      // Redirect stdin to /dev/null
-      int null_fd = open("/dev/null", O_RDONLY);
-      if (null_fd >= 0) {
-        dup2(null_fd, STDIN_FILENO);
-        close(null_fd);
-      }
-    }
+// Releases the fields of an overrides struct whose strings are heap owned.
+static void go_crun_free_overrides_fields(struct go_crun_overrides *ov) {
+  go_crun_strv_free(ov->args, (size_t)ov->args_len);
+  go_crun_strv_free(ov->env, (size_t)ov->env_len);
+  free((char *)ov->cwd);
+  free((char *)ov->hostname);
+  free((char *)ov->root_path);
+  memset(ov, 0, sizeof(*ov));
+}
 
-    // Redirect stdout
-    if (stdout_fd >= 0) {
-      if (dup2(stdout_fd, STDOUT_FILENO) < 0) {
-        int e = errno;
-        ignored = write(error_pipe[1], &e, sizeof(e));
-        _exit(1);
-      }
-      close(stdout_fd);
-    }
+static int go_crun_replace_str(char **dst, const char *src) {
+  char *s = strdup(src);
+  if (!s) return -1;
+  free(*dst);
+  *dst = s;
+  return 0;
+}
 
-    // Redirect stderr
-    if (stderr_fd >= 0) {
-      if (dup2(stderr_fd, STDERR_FILENO) < 0) {
-        int e = errno;
-        ignored = write(error_pipe[1], &e, sizeof(e));
-        _exit(1);
-      }
-      close(stderr_fd);
-    }
+// libcrun stores config_file_content as the container's config.json;
+// regenerate it after changing container_def so the saved config matches
+// what actually runs
+static int go_crun_regenerate_config(libcrun_container_t *container, libcrun_error_t *err) {
+  if (!container->config_file_content) return 0;
+  parser_error p_err = NULL;
+  struct parser_context pctx = { OPT_GEN_SIMPLIFY, stderr };
+  char *json = runtime_spec_schema_config_schema_generate_json(container->container_def, &pctx, &p_err);
+  if (!json) {
+    int rc = libcrun_make_error(err, 0, "cannot serialize container spec: %s", p_err ? p_err : "unknown");
+    free(p_err);
+    return rc;
+  }
+  free(container->config_file_content);
+  container->config_file_content = json;
+  return 0;
+}
 
-    // Signal success to parent (write 0)
-    int zero = 0;
-    ignored = write(error_pipe[1], &zero, sizeof(zero));
-    close(error_pipe[1]);
+int go_crun_apply_overrides(libcrun_container_t *container, const struct go_crun_overrides *ov, libcrun_error_t *err) {
+  runtime_spec_schema_config_schema *def = container->container_def;
+  if (!ov) return 0;
+  if (!ov->args && !ov->env && !ov->cwd && !ov->hostname && !ov->root_path) return 0;
+  if (!def) return libcrun_make_error(err, EINVAL, "container has no spec");
 
-    // Run the container
-    libcrun_error_t child_err = NULL;
-    int rc = libcrun_container_run(ctx, container, flags, &child_err);
-    if (child_err) {
-      libcrun_error_release(&child_err);
+  if (ov->args || ov->env || ov->cwd) {
+    if (!def->process) {
+      def->process = calloc(1, sizeof(*def->process));
+      if (!def->process) goto oom;
     }
-    // Exit with the container's exit code (rc is the exit status from libcrun)
-    _exit(rc < 0 ? 1 : rc);
+  }
+  if (ov->args) {
+    char **args = go_crun_strv_dup(ov->args, (size_t)ov->args_len);
+    if (!args) goto oom;
+    go_crun_strv_free(def->process->args, def->process->args_len);
+    def->process->args = args;
+    def->process->args_len = (size_t)ov->args_len;
+  }
+  if (ov->env) {
+    char **env = go_crun_strv_dup(ov->env, (size_t)ov->env_len);
+    if (!env) goto oom;
+    go_crun_strv_free(def->process->env, def->process->env_len);
+    def->process->env = env;
+    def->process->env_len = (size_t)ov->env_len;
+  }
+  if (ov->cwd && go_crun_replace_str(&def->process->cwd, ov->cwd) < 0) goto oom;
+  if (ov->hostname && go_crun_replace_str(&def->hostname, ov->hostname) < 0) goto oom;
+  if (ov->root_path) {
+    if (!def->root) {
+      def->root = calloc(1, sizeof(*def->root));
+      if (!def->root) goto oom;
+    }
+    if (go_crun_replace_str(&def->root->path, ov->root_path) < 0) goto oom;
   }
 
-  // Parent process
-  close(error_pipe[1]); // Close write end
+  return go_crun_regenerate_config(container, err);
 
-  // NOTE: Do NOT close stdin_fd/stdout_fd/stderr_fd here.
-  // Go owns these file descriptors and will close them via os.File.Close().
-  // Closing them here would cause double-close issues in concurrent scenarios.
+oom:
+  return libcrun_make_error(err, ENOMEM, "cannot apply run overrides");
+}
 
-  // Check if child setup succeeded
-  int child_errno = 0;
-  ssize_t n = read(error_pipe[0], &child_errno, sizeof(child_errno));
-  close(error_pipe[0]);
+int go_crun_spec_enable_rdt_monitoring(libcrun_container_t *container, libcrun_error_t *err) {
+  runtime_spec_schema_config_schema *def = container->container_def;
+  if (!def || !def->linux || !def->linux->intel_rdt) return 0;
+  def->linux->intel_rdt->enable_monitoring = true;
+  def->linux->intel_rdt->enable_monitoring_present = 1;
+  return go_crun_regenerate_config(container, err);
+}
 
-  if (n != sizeof(child_errno)) {
-    // Child died before writing
-    waitpid(pid, NULL, 0);
-    return libcrun_make_error(err, 0, "child process failed unexpectedly");
+// Parses json, a runtime-spec object, into a yajl tree
+static yajl_val go_crun_parse_tree(const char *json, const char *what, libcrun_error_t *err) {
+  char errbuf[1024] = {0};
+  yajl_val tree = yajl_tree_parse(json, errbuf, sizeof(errbuf));
+  if (!tree) libcrun_make_error(err, 0, "cannot parse %s: `%s`", what, errbuf);
+  return tree;
+}
+
+int go_crun_spec_set_placement(libcrun_container_t *container, const char *memory_policy, const char *exec_cpu_affinity,
+                               libcrun_error_t *err) {
+  runtime_spec_schema_config_schema *def = container->container_def;
+  struct parser_context pctx = { 0, stderr };
+  parser_error p_err = NULL;
+  yajl_val tree;
+  if (!def) return libcrun_make_error(err, EINVAL, "container has no spec");
+
+  if (memory_policy) {
+    if (!(tree = go_crun_parse_tree(memory_policy, "memory policy", err))) return -1;
+    runtime_spec_schema_config_linux_memory_policy *mp =
+      make_runtime_spec_schema_config_linux_memory_policy(tree, &pctx, &p_err);
+    yajl_tree_free(tree);
+    if (!mp) goto parse_error;
+    if (!def->linux && !(def->linux = calloc(1, sizeof(*def->linux)))) {
+      free_runtime_spec_schema_config_linux_memory_policy(mp);
+      return libcrun_make_error(err, ENOMEM, "cannot set the memory policy");
+    }
+    free_runtime_spec_schema_config_linux_memory_policy(def->linux->memory_policy);
+    def->linux->memory_policy = mp;
   }
 
-  if (child_errno != 0) {
-    // Child failed during setup
-    waitpid(pid, NULL, 0);
-    return libcrun_make_error(err, child_errno, "child process setup failed");
+  if (exec_cpu_affinity) {
+    if (!def->process) return libcrun_make_error(err, EINVAL, "exec CPU affinity needs a process");
+    if (!(tree = go_crun_parse_tree(exec_cpu_affinity, "exec CPU affinity", err))) return -1;
+    runtime_spec_schema_config_schema_process_exec_cpu_affinity *aff =
+      make_runtime_spec_schema_config_schema_process_exec_cpu_affinity(tree, &pctx, &p_err);
+    yajl_tree_free(tree);
+    if (!aff) goto parse_error;
+    free_runtime_spec_schema_config_schema_process_exec_cpu_affinity(def->process->exec_cpu_affinity);
+    def->process->exec_cpu_affinity = aff;
   }
 
-  *out_pid = pid;
-  return 0;
+  return go_crun_regenerate_config(container, err);
+
+parse_error:
+  libcrun_make_error(err, 0, "cannot parse placement: %s", p_err ? p_err : "unknown");
+  free(p_err);
+  return -1;
 }
 
-// ---- Wait for forked container child ----
-int go_crun_wait(pid_t pid, int *exit_code, libcrun_error_t *err) {
-  int status;
-  pid_t ret;
+// ---- Exit snapshots ----
+// A container child run to completion (go_crun_child_exec) copies the
+// accounting files of the container's cgroup v2 to
+// <state root>/.exit-<pid> when libcrun destroys the cgroup, for the
+// parent to read once it reaped the child. The state root's hidden
+// entries are not containers.
 
-  do {
-    ret = waitpid(pid, &status, 0);
-  } while (ret < 0 && errno == EINTR);
+static int go_crun_write_all(int fd, const char *p, size_t n);
 
-  if (ret < 0) {
-    return libcrun_make_error(err, errno, "waitpid failed");
+static const char *const go_crun_exit_snapshot_files[] = {
+  "cgroup.controllers", "cpu.stat", "memory.current", "memory.max", "memory.peak",
+  "memory.swap.current", "memory.stat", "pids.current", "pids.max", "io.stat",
+};
+
+// The state root of the container this process runs, NULL unless it is a
+// container child
+static const char *go_crun_exit_snapshot_root = NULL;
+
+static void go_crun_exit_snapshot_arm(libcrun_context_t *ctx) {
+  go_crun_exit_snapshot_root = ctx->state_root ? ctx->state_root : "/run/crun";
+}
+
+// Copies name from src to dst, both directories; a file src lacks is skipped
+static void go_crun_exit_snapshot_copy(int src, int dst, const char *name) {
+  char buf[8192];
+  size_t len = 0;
+  ssize_t n = 0;
+  int fd = openat(src, name, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return;
+  while (len < sizeof(buf)) {
+    n = read(fd, buf + len, sizeof(buf) - len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    len += (size_t) n;
   }
+  close(fd);
+  if (n < 0) return;
+  fd = openat(dst, name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd < 0) return;
+  if (go_crun_write_all(fd, buf, len) < 0) {
+    // A truncated file would parse as a smaller count
+    unlinkat(dst, name, 0);
+  }
+  close(fd);
+}
 
-  if (WIFEXITED(status)) {
-    *exit_code = WEXITSTATUS(status);
-  } else if (WIFSIGNALED(status)) {
-    *exit_code = 128 + WTERMSIG(status);
+// Called before the cgroup is destroyed; failures leave no or a partial
+// snapshot, which the parent reads as missing counters
+static void go_crun_exit_snapshot(struct libcrun_cgroup_status *cgroup_status) {
+  char path[PATH_MAX];
+  libcrun_error_t tmp = NULL;
+  int src, dst;
+  if (go_crun_exit_snapshot_root == NULL || cgroup_status == NULL || cgroup_status->path == NULL ||
+      cgroup_status->path[0] == '\0')
+    return;
+  int mode = libcrun_get_cgroup_mode(&tmp);
+  if (tmp) libcrun_error_release(&tmp);
+  if (mode != CGROUP_MODE_UNIFIED) return;
+  // Once per process: a failed launch may destroy the cgroup more than once
+  const char *root = go_crun_exit_snapshot_root;
+  go_crun_exit_snapshot_root = NULL;
+
+  snprintf(path, sizeof(path), CGROUP_ROOT "/%s", cgroup_status->path);
+  src = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (src < 0) return;
+  snprintf(path, sizeof(path), "%s/.exit-%d", root, (int) getpid());
+  if (mkdir(path, 0700) < 0 && errno != EEXIST) {
+    close(src);
+    return;
+  }
+  dst = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dst >= 0) {
+    for (size_t i = 0; i < sizeof(go_crun_exit_snapshot_files) / sizeof(go_crun_exit_snapshot_files[0]); i++)
+      go_crun_exit_snapshot_copy(src, dst, go_crun_exit_snapshot_files[i]);
+    close(dst);
+  }
+  close(src);
+}
+
+// ---- Forked container child ----
+
+// Redirects the stdio of a forked child and routes its libcrun logs. On
+// failure the errno is reported on error_fd and the child exits.
+static void go_crun_child_stdio(int stdin_fd, int stdout_fd, int stderr_fd, int log_fd, int error_fd) {
+  ssize_t ignored __attribute__((unused));
+
+  // Set up log handler for child process.
+  // The Go callback is not valid after fork, so we either:
+  // - Use log_write_to_pipe if log_fd >= 0 (parent will read from pipe)
+  // - Fall back to log_write_to_stderr otherwise
+  if (log_fd >= 0) {
+    crun_set_output_handler(log_write_to_pipe, (void *)(intptr_t)log_fd);
   } else {
-    *exit_code = -1;
+    crun_set_output_handler(log_write_to_stderr, NULL);
+  }
+
+  // Redirect stdin
+  if (stdin_fd >= 0) {
+    if (dup2(stdin_fd, STDIN_FILENO) < 0) {
+      int e = errno;
+      ignored = write(error_fd, &e, sizeof(e));
+      _exit(1);
+    }
+    close(stdin_fd);
+  } else {
+    // Redirect stdin to /dev/null
+    int null_fd = open("/dev/null", O_RDONLY);
+    if (null_fd >= 0) {
+      dup2(null_fd, STDIN_FILENO);
+      close(null_fd);
+    }
+  }
+
+  // Redirect stdout
+  if (stdout_fd >= 0) {
+    if (dup2(stdout_fd, STDOUT_FILENO) < 0) {
+      int e = errno;
+      ignored = write(error_fd, &e, sizeof(e));
+      _exit(1);
+    }
+    close(stdout_fd);
+  }
+
+  // Redirect stderr
+  if (stderr_fd >= 0) {
+    if (dup2(stderr_fd, STDERR_FILENO) < 0) {
+      int e = errno;
+      ignored = write(error_fd, &e, sizeof(e));
+      _exit(1);
+    }
+    close(stderr_fd);
+  }
+}
+
+// Body of the child process that runs a container with redirected stdio.
+// Reports the setup result on error_fd (0 = success, errno otherwise) and
+// never returns: the process exits with the container's exit code.
+static void __attribute__((noreturn)) go_crun_child_exec(
+    libcrun_context_t *ctx,
+    libcrun_container_t *container,
+    const struct go_crun_overrides *overrides,
+    unsigned int flags,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    int error_fd
+) {
+  ssize_t ignored __attribute__((unused));
+
+  // Per-context verbosity only affects this child
+  if (overrides && overrides->verbosity >= 0) {
+    libcrun_set_verbosity(overrides->verbosity);
+  }
+
+  go_crun_child_stdio(stdin_fd, stdout_fd, stderr_fd, log_fd, error_fd);
+
+  // Patch the per-run fields; the parent's parsed spec is untouched
+  // since the child works on its own copy of the address space
+  if (overrides) {
+    libcrun_error_t ov_err = NULL;
+    if (go_crun_apply_overrides(container, overrides, &ov_err) < 0) {
+      int e = ov_err && ov_err->status ? ov_err->status : EINVAL;
+      libcrun_error_release(&ov_err);
+      ignored = write(error_fd, &e, sizeof(e));
+      _exit(1);
+    }
+  }
+
+  // Signal success to parent (write 0)
+  int zero = 0;
+  ignored = write(error_fd, &zero, sizeof(zero));
+  close(error_fd);
+
+  // Run the container; once detached, the cgroup outlives this process
+  if (!ctx->detach) go_crun_exit_snapshot_arm(ctx);
+  libcrun_error_t child_err = NULL;
+  int rc = libcrun_container_run(ctx, container, flags, &child_err);
+  if (child_err) {
+    libcrun_error_release(&child_err);
+  }
+  // Exit with the container's exit code (rc is the exit status from libcrun)
+  _exit(rc < 0 ? 1 : rc);
+}
+
+// Reads the setup result written by go_crun_child_exec.
+// Returns 0 on success, the child's errno if its setup failed, or -1 if the
+// child died before reporting anything.
+static int go_crun_read_child_setup(int error_fd) {
+  int child_errno = 0;
+  ssize_t n;
+  do {
+    n = read(error_fd, &child_errno, sizeof(child_errno));
+  } while (n < 0 && errno == EINTR);
+  if (n != sizeof(child_errno)) return -1;
+  return child_errno;
+}
+
+// Collects the setup result of the forked child pid on error_fd (and closes
+// it). A child whose setup failed is reaped; otherwise *out_pid is set.
+static int go_crun_await_child_setup(pid_t pid, int error_fd, pid_t *out_pid, libcrun_error_t *err) {
+  int child_errno = go_crun_read_child_setup(error_fd);
+  close(error_fd);
+
+  if (child_errno < 0) {
+    // Child died before writing
+    waitpid(pid, NULL, 0);
+    return libcrun_make_error(err, 0, "child process failed unexpectedly");
+  }
+
+  if (child_errno != 0) {
+    // Child failed during setup
+    waitpid(pid, NULL, 0);
+    return libcrun_make_error(err, child_errno, "child process setup failed");
+  }
+
+  *out_pid = pid;
+  return 0;
+}
+
+// ---- Run container with isolated I/O via fork ----
+int go_crun_run_with_pipes(
+    libcrun_context_t *ctx,
+    libcrun_container_t *container,
+    const struct go_crun_overrides *overrides,
+    unsigned int flags,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    libcrun_error_t *err
+) {
+  // Create a pipe to communicate errors from child to parent
+  int error_pipe[2];
+  if (pipe(error_pipe) < 0) {
+    return libcrun_make_error(err, errno, "pipe failed");
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(error_pipe[0]);
+    close(error_pipe[1]);
+    return libcrun_make_error(err, errno, "fork failed");
+  }
+
+  if (pid == 0) {
+    // Child process
+    close(error_pipe[0]); // Close read end
+    go_crun_child_exec(ctx, container, overrides, flags, stdin_fd, stdout_fd, stderr_fd, log_fd, error_pipe[1]);
+  }
+
+  // Parent process
+  close(error_pipe[1]); // Close write end
+
+  // NOTE: Do NOT close stdin_fd/stdout_fd/stderr_fd here.
+  // Go owns these file descriptors and will close them via os.File.Close().
+  // Closing them here would cause double-close issues in concurrent scenarios.
+  return go_crun_await_child_setup(pid, error_pipe[0], out_pid, err);
+}
+
+// ---- Exec into a container with isolated I/O via fork ----
+
+// The forked child runs libcrun_container_exec_with_options without
+// detaching, so it lives as long as the exec'd process and exits with its
+// exit code, exactly like a go_crun_run_with_pipes child.
+int go_crun_exec_prepared_with_pipes(
+    libcrun_context_t *ctx,
+    const char *id,
+    const runtime_spec_schema_config_schema_process *proc,
+    const struct go_crun_overrides *ov,
+    const char *cgroup,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    libcrun_error_t *err
+) {
+  int error_pipe[2];
+  if (pipe(error_pipe) < 0) {
+    return libcrun_make_error(err, errno, "pipe failed");
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(error_pipe[0]);
+    close(error_pipe[1]);
+    return libcrun_make_error(err, errno, "fork failed");
+  }
+
+  if (pid == 0) {
+    ssize_t ignored __attribute__((unused));
+    close(error_pipe[0]);
+    if (ov && ov->verbosity >= 0) {
+      libcrun_set_verbosity(ov->verbosity);
+    }
+    go_crun_child_stdio(stdin_fd, stdout_fd, stderr_fd, log_fd, error_pipe[1]);
+
+    int zero = 0;
+    ignored = write(error_pipe[1], &zero, sizeof(zero));
+    close(error_pipe[1]);
+
+    // Wait for the process: the child's lifetime is the exec's
+    ctx->detach = false;
+    libcrun_error_t child_err = NULL;
+    int rc = go_crun_exec_process(ctx, id, proc, ov, cgroup, &child_err);
+    if (child_err) {
+      libcrun_error_release(&child_err);
+    }
+    _exit(rc < 0 ? 1 : rc);
+  }
+
+  close(error_pipe[1]);
+  return go_crun_await_child_setup(pid, error_pipe[0], out_pid, err);
+}
+
+int go_crun_exec_with_pipes(
+    libcrun_context_t *ctx,
+    const char *id,
+    const char *process_json,
+    const struct go_crun_overrides *ov,
+    const char *cgroup,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    libcrun_error_t *err
+) {
+  // Parse in the parent so that a bad process is reported synchronously
+  runtime_spec_schema_config_schema_process *proc = go_crun_parse_process(process_json, err);
+  if (!proc) return -1;
+
+  int rc = go_crun_exec_prepared_with_pipes(ctx, id, proc, ov, cgroup, stdin_fd, stdout_fd, stderr_fd,
+                                            log_fd, out_pid, err);
+  free_runtime_spec_schema_config_schema_process(proc);
+  return rc;
+}
+
+// ---- Restore a checkpoint with isolated I/O via fork ----
+
+// The child restores without detaching, so it exits with the restored
+// container's exit code. libcrun hands the child's stdio to CRIU for the
+// standard streams that were pipes at checkpoint time.
+int go_crun_restore_with_pipes(
+    libcrun_context_t *ctx,
+    libcrun_checkpoint_restore_t *cr_options,
+    int verbosity,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    libcrun_error_t *err
+) {
+  int error_pipe[2];
+  if (pipe(error_pipe) < 0) {
+    return libcrun_make_error(err, errno, "pipe failed");
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(error_pipe[0]);
+    close(error_pipe[1]);
+    return libcrun_make_error(err, errno, "fork failed");
+  }
+
+  if (pid == 0) {
+    ssize_t ignored __attribute__((unused));
+    close(error_pipe[0]);
+    if (verbosity >= 0) {
+      libcrun_set_verbosity(verbosity);
+    }
+    go_crun_child_stdio(stdin_fd, stdout_fd, stderr_fd, log_fd, error_pipe[1]);
+
+    int zero = 0;
+    ignored = write(error_pipe[1], &zero, sizeof(zero));
+    close(error_pipe[1]);
+
+    ctx->detach = false;
+    cr_options->detach = false;
+    libcrun_error_t child_err = NULL;
+    int rc = libcrun_container_restore(ctx, ctx->id, cr_options, &child_err);
+    if (child_err) {
+      libcrun_error_release(&child_err);
+    }
+    _exit(rc < 0 ? 1 : rc);
+  }
+
+  close(error_pipe[1]);
+  return go_crun_await_child_setup(pid, error_pipe[0], out_pid, err);
+}
+
+// ---- Batch launch ----
+
+static void go_crun_close_fd(int *fd) {
+  if (*fd >= 0) {
+    close(*fd);
+    *fd = -1;
   }
+}
+
+static void go_crun_batch_close_parent_fds(struct go_crun_batch_item *item) {
+  go_crun_close_fd(&item->stdin_fd);
+  go_crun_close_fd(&item->stdout_fd);
+  go_crun_close_fd(&item->stderr_fd);
+  go_crun_close_fd(&item->log_fd);
+}
 
+// Creates a pipe and returns the child end, storing the parent end in *parent.
+// child_reads selects the direction.
+static int go_crun_batch_pipe(int *parent, bool child_reads, int *child, libcrun_error_t *err) {
+  int p[2];
+  if (pipe2(p, O_CLOEXEC) < 0) return libcrun_make_error(err, errno, "pipe failed");
+  *parent = child_reads ? p[1] : p[0];
+  *child = child_reads ? p[0] : p[1];
   return 0;
 }
 
+int go_crun_run_batch(struct go_crun_batch_item *items, int n) {
+  // Setup handshake read ends, one per forked item
+  int *error_fds = malloc(sizeof(int) * (size_t)(n > 0 ? n : 1));
+  if (!error_fds) {
+    for (int i = 0; i < n; i++) {
+      items[i].stdin_fd = items[i].stdout_fd = items[i].stderr_fd = items[i].log_fd = -1;
+      libcrun_make_error(&items[i].err, ENOMEM, "cannot allocate batch state");
+    }
+    return -1;
+  }
+
+  // Pass 1: create the pipes and fork every child without waiting for it
+  for (int i = 0; i < n; i++) {
+    struct go_crun_batch_item *item = &items[i];
+    int child[4] = { -1, -1, -1, -1 };
+    int error_pipe[2] = { -1, -1 };
+
+    item->stdin_fd = item->stdout_fd = item->stderr_fd = item->log_fd = -1;
+    item->pid = 0;
+    item->err = NULL;
+    error_fds[i] = -1;
+
+    if (((item->want_fds & GO_CRUN_BATCH_STDIN) && go_crun_batch_pipe(&item->stdin_fd, true, &child[0], &item->err) < 0) ||
+        ((item->want_fds & GO_CRUN_BATCH_STDOUT) && go_crun_batch_pipe(&item->stdout_fd, false, &child[1], &item->err) < 0) ||
+        ((item->want_fds & GO_CRUN_BATCH_STDERR) && go_crun_batch_pipe(&item->stderr_fd, false, &child[2], &item->err) < 0) ||
+        ((item->want_fds & GO_CRUN_BATCH_LOG) && go_crun_batch_pipe(&item->log_fd, false, &child[3], &item->err) < 0)) {
+      goto item_failed;
+    }
+    // Caller-provided descriptors are used as is and stay owned by the caller
+    int child_fds[4] = { child[0], child[1], child[2], child[3] };
+    for (int k = 0; k < 3; k++) {
+      if (child_fds[k] < 0) child_fds[k] = item->pass_fds[k];
+    }
+    if (pipe2(error_pipe, O_CLOEXEC) < 0) {
+      libcrun_make_error(&item->err, errno, "pipe failed");
+      goto item_failed;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      libcrun_make_error(&item->err, errno, "fork failed");
+      goto item_failed;
+    }
+
+    if (pid == 0) {
+      // Drop every parent-side end created so far, so no sibling keeps
+      // another container's stdin open or its stdout from reaching EOF
+      for (int j = 0; j <= i; j++) {
+        go_crun_batch_close_parent_fds(&items[j]);
+        if (j < i) go_crun_close_fd(&error_fds[j]);
+      }
+      close(error_pipe[0]);
+      go_crun_child_exec(item->ctx, item->container, item->overrides, item->flags,
+                         child_fds[0], child_fds[1], child_fds[2], child_fds[3], error_pipe[1]);
+    }
+
+    item->pid = pid;
+    error_fds[i] = error_pipe[0];
+    close(error_pipe[1]);
+    for (int k = 0; k < 4; k++) go_crun_close_fd(&child[k]);
+    continue;
+
+  item_failed:
+    for (int k = 0; k < 4; k++) go_crun_close_fd(&child[k]);
+    go_crun_close_fd(&error_pipe[0]);
+    go_crun_close_fd(&error_pipe[1]);
+    go_crun_batch_close_parent_fds(item);
+  }
+
+  // Pass 2: collect the handshakes; the children have been setting up
+  // concurrently, so most results are already waiting in the pipes
+  int failed = 0;
+  for (int i = 0; i < n; i++) {
+    struct go_crun_batch_item *item = &items[i];
+    if (error_fds[i] < 0) {
+      failed++;
+      continue;
+    }
+
+    int child_errno = go_crun_read_child_setup(error_fds[i]);
+    close(error_fds[i]);
+    if (child_errno == 0) continue;
+
+    waitpid(item->pid, NULL, 0);
+    item->pid = 0;
+    if (child_errno < 0) {
+      libcrun_make_error(&item->err, 0, "child process failed unexpectedly");
+    } else {
+      libcrun_make_error(&item->err, child_errno, "child process setup failed");
+    }
+    go_crun_batch_close_parent_fds(item);
+    failed++;
+  }
+
+  free(error_fds);
+  return failed;
+}
+
+// ---- Lifecycle operations in a forked child ----
+
+// The child runs the operation as the calling process would have, writes
+// its reply (a single write, atomic on a pipe) and exits. Unlike the
+// calling process, it can be killed while stuck in the operation; the
+// descriptors it shares with the processes it forks are close-on-exec.
+int go_crun_call_forked(const struct go_crun_call *call, pid_t *out_pid, int *out_fd, libcrun_error_t *err) {
+  int p[2];
+  if (pipe2(p, O_CLOEXEC) < 0) return libcrun_make_error(err, errno, "pipe failed");
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(p[0]);
+    close(p[1]);
+    return libcrun_make_error(err, errno, "fork failed");
+  }
+
+  if (pid == 0) {
+    ssize_t ignored __attribute__((unused));
+    struct go_crun_call_reply reply;
+    libcrun_error_t call_err = NULL;
+    int rc = -1;
+
+    close(p[0]);
+    memset(&reply, 0, sizeof(reply));
+    if (call->verbosity >= 0) {
+      libcrun_set_verbosity(call->verbosity);
+    }
+    // The Go callback is not valid after fork
+    if (call->log_fd >= 0) {
+      crun_set_output_handler(log_write_to_pipe, (void *)(intptr_t)call->log_fd);
+    } else {
+      crun_set_output_handler(log_write_to_stderr, NULL);
+    }
+
+    switch (call->op) {
+    case GO_CRUN_CALL_CREATE:
+      rc = libcrun_container_create(call->ctx, call->container, call->flags, &call_err);
+      break;
+    case GO_CRUN_CALL_RUN:
+      rc = libcrun_container_run(call->ctx, call->container, call->flags, &call_err);
+      break;
+    case GO_CRUN_CALL_START:
+      rc = libcrun_container_start(call->ctx, call->id, &call_err);
+      break;
+    case GO_CRUN_CALL_EXEC:
+      rc = go_crun_exec_json(call->ctx, call->id, call->process_json, call->cgroup, &call_err);
+      break;
+    default:
+      libcrun_make_error(&call_err, EINVAL, "unknown operation %d", call->op);
+    }
+
+    reply.rc = rc < 0 ? -1 : rc;
+    if (rc < 0 && call_err) {
+      reply.status = call_err->status;
+      snprintf(reply.msg, sizeof(reply.msg), "%s", call_err->msg);
+    }
+    if (call_err) {
+      libcrun_error_release(&call_err);
+    }
+    ignored = write(p[1], &reply, sizeof(reply));
+    _exit(0);
+  }
+
+  close(p[1]);
+  *out_pid = pid;
+  *out_fd = p[0];
+  return 0;
+}
+
+int go_crun_call_reply_result(const struct go_crun_call_reply *reply, libcrun_error_t *err) {
+  if (reply->rc >= 0) return reply->rc;
+  return libcrun_make_error(err, reply->status, "%.*s", (int)sizeof(reply->msg), reply->msg);
+}
+
+int go_crun_pidfd_send_signal(int pidfd, int sig) {
+#ifdef SYS_pidfd_send_signal
+  return (int)syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+#else
+  (void)pidfd;
+  (void)sig;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+// ---- Wait for forked container child ----
+int go_crun_wait(pid_t pid, int *exit_code, struct rusage *usage, libcrun_error_t *err) {
+  int status;
+  pid_t ret;
+
+  do {
+    ret = wait4(pid, &status, 0, usage);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0) {
+    return libcrun_make_error(err, errno, "waitpid failed");
+  }
+
+  if (WIFEXITED(status)) {
+    *exit_code = WEXITSTATUS(status);
+  } else if (WIFSIGNALED(status)) {
+    *exit_code = 128 + WTERMSIG(status);
+  } else {
+    *exit_code = -1;
+  }
+
+  return 0;
+}
+
+// ---- pidfd-based wait ----
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+int go_crun_pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+  (void)pid;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+int go_crun_pidfd_exited(int pidfd) {
+  struct pollfd p = { .fd = pidfd, .events = POLLIN };
+  int rc;
+  do {
+    rc = poll(&p, 1, 0);
+  } while (rc < 0 && errno == EINTR);
+  return rc > 0 ? 1 : 0;
+}
+
+int go_crun_wait_pidfd(int pidfd, int *exit_code, struct rusage *usage, libcrun_error_t *err) {
+  siginfo_t info;
+  int ret;
+
+  memset(&info, 0, sizeof(info));
+  // The raw syscall, unlike the libc wrapper, also returns the rusage
+  do {
+    ret = (int)syscall(SYS_waitid, P_PIDFD, pidfd, &info, WEXITED | WNOHANG, usage);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret < 0) {
+    return libcrun_make_error(err, errno, "waitid failed");
+  }
+
+  // WNOHANG and the child is still running
+  if (info.si_pid == 0) return 0;
+
+  switch (info.si_code) {
+  case CLD_EXITED:
+    *exit_code = info.si_status;
+    break;
+  case CLD_KILLED:
+  case CLD_DUMPED:
+    *exit_code = 128 + info.si_status;
+    break;
+  default:
+    *exit_code = -1;
+  }
+  return 1;
+}
+
+
+// ---- Launcher helper processes (zygote) ----
+//
+// A launcher is a small, long-lived helper forked from the Go process while
+// its heap is still small. It receives run requests over a unix socket (the
+// stdio/log fds travel alongside via SCM_RIGHTS) and clones the container
+// child from its own address space, so the cost of duplicating the address
+// space no longer depends on the size of the Go heap.
+//
+// The child is cloned with CLONE_PARENT: it becomes a direct child of the Go
+// process, so go_crun_wait and the rest of the RunWithIO machinery are
+// unaffected.
+//
+// Wire format of a request frame: [payload_len:4][payload:payload_len]
+// Payload: [flags:4][verbosity:4][bools:4][7 x context string][fd_mask:4][config json]
+//          [overrides: args vector][env vector][cwd][hostname][root path]
+// Strings are encoded as [len:4][bytes:len], with len 0xffffffff for NULL;
+// vectors as [count:4][count x string], with count 0xffffffff for NULL.
+
+#define GO_CRUN_LAUNCHER_MAX_FDS 4
+#define GO_CRUN_LAUNCHER_MAX_REQUEST (64u * 1024u * 1024u)
+#define GO_CRUN_NULL_STRING 0xffffffffu
+
+struct go_crun_launcher_reply {
+  int32_t rc;     // 0 on success, -1 on failure
+  int32_t status; // errno associated with the failure
+  int32_t pid;    // launched child (> 0 even on failure if it must be reaped)
+  char msg[500];
+};
+
+struct go_crun_buf {
+  char *data;
+  size_t len;
+  size_t cap;
+};
+
+static int go_crun_buf_put(struct go_crun_buf *b, const void *p, size_t n) {
+  if (b->len + n > b->cap) {
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < b->len + n) cap *= 2;
+    char *data = realloc(b->data, cap);
+    if (!data) return -1;
+    b->data = data;
+    b->cap = cap;
+  }
+  memcpy(b->data + b->len, p, n);
+  b->len += n;
+  return 0;
+}
+
+static int go_crun_buf_put_u32(struct go_crun_buf *b, uint32_t v) {
+  return go_crun_buf_put(b, &v, sizeof(v));
+}
+
+static int go_crun_buf_put_str(struct go_crun_buf *b, const char *s) {
+  if (!s) return go_crun_buf_put_u32(b, GO_CRUN_NULL_STRING);
+  uint32_t len = (uint32_t)strlen(s);
+  if (go_crun_buf_put_u32(b, len) < 0) return -1;
+  return go_crun_buf_put(b, s, len);
+}
+
+struct go_crun_reader {
+  const char *p;
+  size_t left;
+};
+
+static int go_crun_rd_u32(struct go_crun_reader *r, uint32_t *v) {
+  if (r->left < sizeof(*v)) return -1;
+  memcpy(v, r->p, sizeof(*v));
+  r->p += sizeof(*v);
+  r->left -= sizeof(*v);
+  return 0;
+}
+
+static int go_crun_rd_str(struct go_crun_reader *r, char **out) {
+  uint32_t len;
+  *out = NULL;
+  if (go_crun_rd_u32(r, &len) < 0) return -1;
+  if (len == GO_CRUN_NULL_STRING) return 0;
+  if (r->left < len) return -1;
+  char *s = malloc((size_t)len + 1);
+  if (!s) return -1;
+  memcpy(s, r->p, len);
+  s[len] = '\0';
+  r->p += len;
+  r->left -= len;
+  *out = s;
+  return 0;
+}
+
+static int go_crun_write_full(int fd, const void *p, size_t n) {
+  const char *c = p;
+  while (n > 0) {
+    ssize_t w = send(fd, c, n, MSG_NOSIGNAL);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) return -1;
+    c += w;
+    n -= (size_t)w;
+  }
+  return 0;
+}
+
+static int go_crun_read_full(int fd, void *p, size_t n) {
+  char *c = p;
+  while (n > 0) {
+    ssize_t r = read(fd, c, n);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) return -1;
+    c += r;
+    n -= (size_t)r;
+  }
+  return 0;
+}
+
+// Serializes the context, flags and spec of a run request. The spec is sent
+// as JSON: the original document when libcrun kept it, otherwise regenerated
+// from the parsed tree.
+static int go_crun_buf_put_strv(struct go_crun_buf *b, char *const *v, int n) {
+  if (!v) return go_crun_buf_put_u32(b, GO_CRUN_NULL_STRING);
+  if (go_crun_buf_put_u32(b, (uint32_t)n) < 0) return -1;
+  for (int i = 0; i < n; i++) {
+    if (go_crun_buf_put_str(b, v[i]) < 0) return -1;
+  }
+  return 0;
+}
+
+static int go_crun_rd_strv(struct go_crun_reader *r, char ***out, int *out_len) {
+  uint32_t n;
+  *out = NULL;
+  *out_len = 0;
+  if (go_crun_rd_u32(r, &n) < 0) return -1;
+  if (n == GO_CRUN_NULL_STRING) return 0;
+  // Every element takes at least its 4-byte length
+  if (n > r->left / sizeof(uint32_t)) return -1;
+  char **v = calloc((size_t)n + 1, sizeof(char *));
+  if (!v) return -1;
+  for (uint32_t i = 0; i < n; i++) {
+    if (go_crun_rd_str(r, &v[i]) < 0 || v[i] == NULL) {
+      go_crun_strv_free(v, i + 1);
+      return -1;
+    }
+  }
+  *out = v;
+  *out_len = (int)n;
+  return 0;
+}
+
+// Device program reuse (see go_crun_set_ebpf_reuse), off by default. Run
+// requests carry it to Launcher helpers and spawned processes, which are
+// started before it may be turned on.
+static int go_crun_ebpf_reuse = 0;
+
+static int go_crun_encode_run_request(struct go_crun_buf *b, libcrun_context_t *ctx,
+                                      libcrun_container_t *container,
+                                      const struct go_crun_overrides *ov, unsigned int flags,
+                                      uint32_t fd_mask, libcrun_error_t *err) {
+  char *generated = NULL;
+  const char *config = container->config_file_content;
+  if (!config) {
+    parser_error p_err = NULL;
+    struct parser_context pctx = { OPT_GEN_SIMPLIFY, stderr };
+    generated = runtime_spec_schema_config_schema_generate_json(container->container_def, &pctx, &p_err);
+    if (!generated) {
+      int rc = libcrun_make_error(err, 0, "cannot serialize container spec: %s", p_err ? p_err : "unknown");
+      free(p_err);
+      return rc;
+    }
+    config = generated;
+  }
+
+  uint32_t bools = (ctx->systemd_cgroup ? 1u : 0u) | (ctx->detach ? 2u : 0u) |
+                   (ctx->no_new_keyring ? 4u : 0u) | (ctx->force_no_cgroup ? 8u : 0u) |
+                   (ctx->no_pivot ? 16u : 0u) | (go_crun_ebpf_reuse ? 32u : 0u);
+  int failed = go_crun_buf_put_u32(b, flags) < 0 ||
+               go_crun_buf_put_u32(b, (uint32_t)(ov && ov->verbosity >= 0 ? ov->verbosity : libcrun_get_verbosity())) < 0 ||
+               go_crun_buf_put_u32(b, bools) < 0 ||
+               go_crun_buf_put_str(b, ctx->state_root) < 0 ||
+               go_crun_buf_put_str(b, ctx->id) < 0 ||
+               go_crun_buf_put_str(b, ctx->bundle) < 0 ||
+               go_crun_buf_put_str(b, ctx->console_socket) < 0 ||
+               go_crun_buf_put_str(b, ctx->pid_file) < 0 ||
+               go_crun_buf_put_str(b, ctx->notify_socket) < 0 ||
+               go_crun_buf_put_str(b, ctx->handler) < 0 ||
+               go_crun_buf_put_u32(b, fd_mask) < 0 ||
+               go_crun_buf_put_str(b, config) < 0 ||
+               go_crun_buf_put_strv(b, ov ? ov->args : NULL, ov ? ov->args_len : 0) < 0 ||
+               go_crun_buf_put_strv(b, ov ? ov->env : NULL, ov ? ov->env_len : 0) < 0 ||
+               go_crun_buf_put_str(b, ov ? ov->cwd : NULL) < 0 ||
+               go_crun_buf_put_str(b, ov ? ov->hostname : NULL) < 0 ||
+               go_crun_buf_put_str(b, ov ? ov->root_path : NULL) < 0;
+  free(generated);
+  if (failed) return libcrun_make_error(err, ENOMEM, "cannot serialize run request");
+  return 0;
+}
+
+// Decodes a run request into a freshly allocated context and container,
+// with the request's overrides already applied.
+static int go_crun_decode_run_request(const char *payload, size_t len, libcrun_context_t **out_ctx,
+                                      libcrun_container_t **out_container, unsigned int *flags,
+                                      int *verbosity, uint32_t *fd_mask, libcrun_error_t *err) {
+  struct go_crun_reader r = { payload, len };
+  uint32_t v_flags, v_verbosity, bools;
+  char *config = NULL;
+  struct go_crun_overrides ov = {0};
+  char *ov_cwd = NULL, *ov_hostname = NULL, *ov_root = NULL;
+
+  libcrun_context_t *ctx = go_crun_new_context();
+  if (!ctx) return libcrun_make_error(err, ENOMEM, "cannot allocate context");
+
+  int failed = go_crun_rd_u32(&r, &v_flags) < 0 ||
+               go_crun_rd_u32(&r, &v_verbosity) < 0 ||
+               go_crun_rd_u32(&r, &bools) < 0 ||
+               go_crun_rd_str(&r, (char **)&ctx->state_root) < 0 ||
+               go_crun_rd_str(&r, (char **)&ctx->id) < 0 ||
+               go_crun_rd_str(&r, (char **)&ctx->bundle) < 0 ||
+               go_crun_rd_str(&r, (char **)&ctx->console_socket) < 0 ||
+               go_crun_rd_str(&r, (char **)&ctx->pid_file) < 0 ||
+               go_crun_rd_str(&r, (char **)&ctx->notify_socket) < 0 ||
+               go_crun_rd_str(&r, (char **)&ctx->handler) < 0 ||
+               go_crun_rd_u32(&r, fd_mask) < 0 ||
+               go_crun_rd_str(&r, &config) < 0 ||
+               config == NULL ||
+               go_crun_rd_strv(&r, &ov.args, &ov.args_len) < 0 ||
+               go_crun_rd_strv(&r, &ov.env, &ov.env_len) < 0 ||
+               go_crun_rd_str(&r, &ov_cwd) < 0 ||
+               go_crun_rd_str(&r, &ov_hostname) < 0 ||
+               go_crun_rd_str(&r, &ov_root) < 0;
+  ov.cwd = ov_cwd;
+  ov.hostname = ov_hostname;
+  ov.root_path = ov_root;
+  if (failed) {
+    free(config);
+    go_crun_free_overrides_fields(&ov);
+    go_crun_free_context(ctx);
+    return libcrun_make_error(err, EINVAL, "malformed run request");
+  }
+
+  ctx->systemd_cgroup = (bools & 1u) != 0;
+  ctx->detach = (bools & 2u) != 0;
+  ctx->no_new_keyring = (bools & 4u) != 0;
+  ctx->force_no_cgroup = (bools & 8u) != 0;
+  ctx->no_pivot = (bools & 16u) != 0;
+  go_crun_ebpf_reuse = (bools & 32u) != 0;
+
+  libcrun_container_t *container = libcrun_container_load_from_memory(config, err);
+  free(config);
+  if (container && go_crun_apply_overrides(container, &ov, err) < 0) {
+    libcrun_container_free(container);
+    container = NULL;
+  }
+  go_crun_free_overrides_fields(&ov);
+  if (!container) {
+    go_crun_free_context(ctx);
+    return -1;
+  }
+
+  *out_ctx = ctx;
+  *out_container = container;
+  *flags = v_flags;
+  *verbosity = (int)v_verbosity;
+  return 0;
+}
+
+static int go_crun_send_frame(int sock, const struct go_crun_buf *b, const int *fds, int nfds) {
+  uint32_t len = (uint32_t)b->len;
+  struct iovec iov = { &len, sizeof(len) };
+  union {
+    char buf[CMSG_SPACE(sizeof(int) * GO_CRUN_LAUNCHER_MAX_FDS)];
+    struct cmsghdr align;
+  } cmsgbuf;
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (nfds > 0) {
+    memset(&cmsgbuf, 0, sizeof(cmsgbuf));
+    msg.msg_control = cmsgbuf.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)nfds);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * (size_t)nfds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * (size_t)nfds);
+  }
+
+  ssize_t w;
+  do {
+    w = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  } while (w < 0 && errno == EINTR);
+  if (w != (ssize_t)sizeof(len)) return -1;
+  return go_crun_write_full(sock, b->data, b->len);
+}
+
+// Returns 1 when a frame was received, 0 on EOF, -1 on error.
+static int go_crun_recv_frame(int sock, char **payload, size_t *len, int *fds, int *nfds) {
+  uint32_t plen = 0;
+  struct iovec iov = { &plen, sizeof(plen) };
+  union {
+    char buf[CMSG_SPACE(sizeof(int) * GO_CRUN_LAUNCHER_MAX_FDS)];
+    struct cmsghdr align;
+  } cmsgbuf;
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cmsgbuf.buf;
+  msg.msg_controllen = sizeof(cmsgbuf.buf);
+
+  ssize_t r;
+  do {
+    r = recvmsg(sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+  } while (r < 0 && errno == EINTR);
+  if (r == 0) return 0;
+  if (r != (ssize_t)sizeof(plen)) return -1;
+
+  *nfds = 0;
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      int n = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+      memcpy(fds + *nfds, CMSG_DATA(cmsg), sizeof(int) * (size_t)n);
+      *nfds += n;
+    }
+  }
+
+  if (plen > GO_CRUN_LAUNCHER_MAX_REQUEST) return -1;
+  char *data = malloc(plen ? plen : 1);
+  if (!data) return -1;
+  if (go_crun_read_full(sock, data, plen) < 0) {
+    free(data);
+    return -1;
+  }
+  *payload = data;
+  *len = plen;
+  return 1;
+}
+
+// The helper inherits the Go runtime's signal handlers, which must never run
+// outside of Go. Restore the default dispositions and an empty signal mask.
+static void go_crun_reset_signals(void) {
+  sigset_t none;
+  sigemptyset(&none);
+  sigprocmask(SIG_SETMASK, &none, NULL);
+  for (int sig = 1; sig < NSIG; sig++) {
+    if (sig == SIGKILL || sig == SIGSTOP) continue;
+    signal(sig, SIG_DFL);
+  }
+}
+
+// Closes every fd above stderr except keep, so the helper does not pin the
+// Go process's files open for its whole lifetime.
+static void go_crun_close_fds_except(int keep) {
+  DIR *d = opendir("/proc/self/fd");
+  if (!d) return;
+  int dfd = dirfd(d);
+  struct dirent *de;
+  while ((de = readdir(d)) != NULL) {
+    if (de->d_name[0] == '.') continue;
+    int fd = atoi(de->d_name);
+    if (fd > STDERR_FILENO && fd != keep && fd != dfd) close(fd);
+  }
+  closedir(d);
+}
+
+static void go_crun_launcher_reply_error(struct go_crun_launcher_reply *r, libcrun_error_t *err) {
+  r->rc = -1;
+  if (err && *err) {
+    r->status = (*err)->status;
+    snprintf(r->msg, sizeof(r->msg), "%s", (*err)->msg);
+    libcrun_error_release(err);
+  }
+}
+
+static void go_crun_launcher_handle(int sock, const char *payload, size_t len, int *fds, int nfds,
+                                    struct go_crun_launcher_reply *reply) {
+  libcrun_error_t err = NULL;
+  libcrun_context_t *ctx = NULL;
+  libcrun_container_t *container = NULL;
+  unsigned int flags = 0;
+  int verbosity = 0;
+  uint32_t fd_mask = 0;
+
+  if (go_crun_decode_run_request(payload, len, &ctx, &container, &flags, &verbosity, &fd_mask, &err) < 0) {
+    go_crun_launcher_reply_error(reply, &err);
+    return;
+  }
+
+  // Map the received fds back to stdin/stdout/stderr/log following fd_mask
+  int slots[GO_CRUN_LAUNCHER_MAX_FDS] = { -1, -1, -1, -1 };
+  int used = 0;
+  for (int i = 0; i < GO_CRUN_LAUNCHER_MAX_FDS; i++) {
+    if (fd_mask & (1u << i)) {
+      if (used < nfds) slots[i] = fds[used];
+      used++;
+    }
+  }
+
+  if (used != nfds) {
+    libcrun_make_error(&err, EINVAL, "run request carries %d fds, expected %d", nfds, used);
+    go_crun_launcher_reply_error(reply, &err);
+    goto out;
+  }
+
+  libcrun_set_verbosity(verbosity);
+
+  int error_pipe[2];
+  if (pipe(error_pipe) < 0) {
+    libcrun_make_error(&err, errno, "pipe failed");
+    go_crun_launcher_reply_error(reply, &err);
+    goto out;
+  }
+
+  pid_t pid = (pid_t)syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0);
+  if (pid < 0) {
+    close(error_pipe[0]);
+    close(error_pipe[1]);
+    libcrun_make_error(&err, errno, "clone failed");
+    go_crun_launcher_reply_error(reply, &err);
+    goto out;
+  }
+
+  if (pid == 0) {
+    close(sock);
+    close(error_pipe[0]);
+    go_crun_child_exec(ctx, container, NULL, flags, slots[0], slots[1], slots[2], slots[3], error_pipe[1]);
+  }
+
+  close(error_pipe[1]);
+  int child_errno = go_crun_read_child_setup(error_pipe[0]);
+  close(error_pipe[0]);
+
+  // The child belongs to the Go process: it is reaped there, even on failure.
+  reply->pid = pid;
+  if (child_errno < 0) {
+    reply->rc = -1;
+    snprintf(reply->msg, sizeof(reply->msg), "child process failed unexpectedly");
+  } else if (child_errno != 0) {
+    reply->rc = -1;
+    reply->status = child_errno;
+    snprintf(reply->msg, sizeof(reply->msg), "child process setup failed");
+  }
+
+out:
+  libcrun_container_free(container);
+  go_crun_free_context(ctx);
+}
+
+static void __attribute__((noreturn)) go_crun_launcher_serve(int sock) {
+  go_crun_reset_signals();
+  // The Go log callback must not be reached from the helper
+  go_log_handle = 0;
+  crun_set_output_handler(log_write_to_stderr, NULL);
+  go_crun_close_fds_except(sock);
+
+  for (;;) {
+    int fds[GO_CRUN_LAUNCHER_MAX_FDS];
+    int nfds = 0;
+    char *payload = NULL;
+    size_t len = 0;
+
+    // EOF means the Go process closed the launcher (or exited)
+    if (go_crun_recv_frame(sock, &payload, &len, fds, &nfds) <= 0) _exit(0);
+
+    struct go_crun_launcher_reply reply;
+    memset(&reply, 0, sizeof(reply));
+    go_crun_launcher_handle(sock, payload, len, fds, nfds, &reply);
+
+    for (int i = 0; i < nfds; i++) close(fds[i]);
+    free(payload);
+
+    if (go_crun_write_full(sock, &reply, sizeof(reply)) < 0) _exit(0);
+  }
+}
+
+int go_crun_launcher_start(int *out_sock, pid_t *out_pid, libcrun_error_t *err) {
+  int sv[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+    return libcrun_make_error(err, errno, "socketpair failed");
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(sv[0]);
+    close(sv[1]);
+    return libcrun_make_error(err, errno, "fork failed");
+  }
+
+  if (pid == 0) {
+    close(sv[0]);
+    go_crun_launcher_serve(sv[1]);
+  }
+
+  close(sv[1]);
+  *out_sock = sv[0];
+  *out_pid = pid;
+  return 0;
+}
+
+int go_crun_launcher_run(
+    int sock,
+    libcrun_context_t *ctx,
+    libcrun_container_t *container,
+    const struct go_crun_overrides *overrides,
+    unsigned int flags,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    int *out_broken,
+    libcrun_error_t *err
+) {
+  int in[GO_CRUN_LAUNCHER_MAX_FDS] = { stdin_fd, stdout_fd, stderr_fd, log_fd };
+  int fds[GO_CRUN_LAUNCHER_MAX_FDS];
+  int nfds = 0;
+  uint32_t fd_mask = 0;
+  for (int i = 0; i < GO_CRUN_LAUNCHER_MAX_FDS; i++) {
+    if (in[i] >= 0) {
+      fd_mask |= 1u << i;
+      fds[nfds++] = in[i];
+    }
+  }
+
+  *out_broken = 0;
+  struct go_crun_buf b = {0};
+  if (go_crun_encode_run_request(&b, ctx, container, overrides, flags, fd_mask, err) < 0) {
+    free(b.data);
+    return -1;
+  }
+  int rc = go_crun_send_frame(sock, &b, fds, nfds);
+  free(b.data);
+  if (rc < 0) {
+    *out_broken = 1;
+    return libcrun_make_error(err, errno, "cannot send run request to launcher");
+  }
+
+  struct go_crun_launcher_reply reply;
+  if (go_crun_read_full(sock, &reply, sizeof(reply)) < 0) {
+    *out_broken = 1;
+    return libcrun_make_error(err, errno, "launcher process exited unexpectedly");
+  }
+
+  if (reply.rc < 0) {
+    if (reply.pid > 0) waitpid(reply.pid, NULL, 0);
+    reply.msg[sizeof(reply.msg) - 1] = '\0';
+    return libcrun_make_error(err, reply.status, "%s", reply.msg);
+  }
+
+  *out_pid = reply.pid;
+  return 0;
+}
+
+void go_crun_launcher_stop(int sock, pid_t pid) {
+  if (sock >= 0) close(sock);
+  if (pid > 0) {
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+      ;
+  }
+}
+
+// ---- Spawned launcher (posix_spawn) ----
+//
+// Alternative to fork for RunWithIO: posix_spawn re-executes the current
+// binary (glibc implements it with clone(CLONE_VM|CLONE_VFORK) on a private
+// stack), so the parent's page tables are never duplicated. The spawned
+// process is intercepted by go_crun_spawn_init before the Go runtime starts,
+// decodes the run request (same encoding as the launcher helpers) and becomes
+// the container child.
+//
+// Fixed fd layout in the spawned process:
+//   3: memfd holding the encoded run request
+//   4: error pipe (setup result, see go_crun_child_exec)
+//   5..8: stdin, stdout, stderr, log (present according to the request fd_mask)
+
+#define GO_CRUN_SPAWN_ENV "_LIBCRUN_GO_SPAWN"
+#define GO_CRUN_SPAWN_REQUEST_FD 3
+#define GO_CRUN_SPAWN_ERROR_FD 4
+#define GO_CRUN_SPAWN_STDIO_FD 5
+// Source fds are moved at or above this before the file actions run, so no
+// dup2 can clobber a source that is still needed
+#define GO_CRUN_SPAWN_SOURCE_MIN_FD 16
+
+extern char **environ;
+
+static int go_crun_write_all(int fd, const char *p, size_t n) {
+  while (n > 0) {
+    ssize_t w = write(fd, p, n);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) return -1;
+    p += w;
+    n -= (size_t)w;
+  }
+  return 0;
+}
+
+static void __attribute__((noreturn)) go_crun_spawn_fail(int e) {
+  ssize_t ignored __attribute__((unused));
+  ignored = write(GO_CRUN_SPAWN_ERROR_FD, &e, sizeof(e));
+  _exit(1);
+}
+
+static void __attribute__((noreturn)) go_crun_spawn_main(void) {
+  struct stat st;
+  if (fstat(GO_CRUN_SPAWN_REQUEST_FD, &st) < 0) go_crun_spawn_fail(errno);
+
+  size_t len = (size_t)st.st_size;
+  char *payload = malloc(len ? len : 1);
+  if (!payload) go_crun_spawn_fail(ENOMEM);
+  for (size_t off = 0; off < len;) {
+    ssize_t r = pread(GO_CRUN_SPAWN_REQUEST_FD, payload + off, len - off, (off_t)off);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) go_crun_spawn_fail(r < 0 ? errno : EIO);
+    off += (size_t)r;
+  }
+  close(GO_CRUN_SPAWN_REQUEST_FD);
+
+  libcrun_error_t err = NULL;
+  libcrun_context_t *ctx = NULL;
+  libcrun_container_t *container = NULL;
+  unsigned int flags = 0;
+  int verbosity = 0;
+  uint32_t fd_mask = 0;
+  if (go_crun_decode_run_request(payload, len, &ctx, &container, &flags, &verbosity, &fd_mask, &err) < 0) {
+    int e = err && err->status ? err->status : EINVAL;
+    libcrun_error_release(&err);
+    go_crun_spawn_fail(e);
+  }
+  free(payload);
+  libcrun_set_verbosity(verbosity);
+
+  int slots[GO_CRUN_LAUNCHER_MAX_FDS];
+  for (int i = 0; i < GO_CRUN_LAUNCHER_MAX_FDS; i++) {
+    slots[i] = (fd_mask & (1u << i)) ? GO_CRUN_SPAWN_STDIO_FD + i : -1;
+  }
+  go_crun_child_exec(ctx, container, NULL, flags, slots[0], slots[1], slots[2], slots[3], GO_CRUN_SPAWN_ERROR_FD);
+}
+
+// Runs before the Go runtime is initialized. Only processes started by
+// go_crun_spawn_with_pipes carry the marker; everything else returns at once.
+__attribute__((constructor)) static void go_crun_spawn_init(void) {
+  const char *marker = getenv(GO_CRUN_SPAWN_ENV);
+  if (marker == NULL || strcmp(marker, "1") != 0) return;
+  unsetenv(GO_CRUN_SPAWN_ENV);
+  go_crun_spawn_main();
+}
+
+int go_crun_spawn_with_pipes(
+    libcrun_context_t *ctx,
+    libcrun_container_t *container,
+    const struct go_crun_overrides *overrides,
+    unsigned int flags,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    libcrun_error_t *err
+) {
+  int in[GO_CRUN_LAUNCHER_MAX_FDS] = { stdin_fd, stdout_fd, stderr_fd, log_fd };
+  int moved[GO_CRUN_LAUNCHER_MAX_FDS] = { -1, -1, -1, -1 };
+  int error_pipe[2] = { -1, -1 };
+  int request_fd = -1, tmp_fd = -1;
+  char **envp = NULL;
+  struct go_crun_buf b = {0};
+  posix_spawn_file_actions_t fa;
+  bool fa_init = false;
+  posix_spawnattr_t attr;
+  bool attr_init = false;
+  int ret = -1;
+  uint32_t fd_mask = 0;
+
+  for (int i = 0; i < GO_CRUN_LAUNCHER_MAX_FDS; i++) {
+    if (in[i] < 0) continue;
+    fd_mask |= 1u << i;
+    moved[i] = fcntl(in[i], F_DUPFD_CLOEXEC, GO_CRUN_SPAWN_SOURCE_MIN_FD);
+    if (moved[i] < 0) {
+      libcrun_make_error(err, errno, "fcntl F_DUPFD_CLOEXEC failed");
+      goto out;
+    }
+  }
+
+  if (go_crun_encode_run_request(&b, ctx, container, overrides, flags, fd_mask, err) < 0) goto out;
+
+  tmp_fd = memfd_create("libcrun-go-request", MFD_CLOEXEC);
+  if (tmp_fd < 0) {
+    libcrun_make_error(err, errno, "memfd_create failed");
+    goto out;
+  }
+  request_fd = fcntl(tmp_fd, F_DUPFD_CLOEXEC, GO_CRUN_SPAWN_SOURCE_MIN_FD);
+  close(tmp_fd);
+  tmp_fd = -1;
+  if (request_fd < 0 || go_crun_write_all(request_fd, b.data, b.len) < 0) {
+    libcrun_make_error(err, errno, "cannot write run request");
+    goto out;
+  }
+
+  if (pipe2(error_pipe, O_CLOEXEC) < 0) {
+    libcrun_make_error(err, errno, "pipe failed");
+    goto out;
+  }
+  tmp_fd = fcntl(error_pipe[1], F_DUPFD_CLOEXEC, GO_CRUN_SPAWN_SOURCE_MIN_FD);
+  close(error_pipe[1]);
+  error_pipe[1] = tmp_fd;
+  tmp_fd = -1;
+  if (error_pipe[1] < 0) {
+    libcrun_make_error(err, errno, "fcntl F_DUPFD_CLOEXEC failed");
+    goto out;
+  }
+
+  size_t nenv = 0;
+  while (environ && environ[nenv]) nenv++;
+  envp = calloc(nenv + 2, sizeof(char *));
+  if (!envp) {
+    libcrun_make_error(err, ENOMEM, "cannot allocate environment");
+    goto out;
+  }
+  memcpy(envp, environ, nenv * sizeof(char *));
+  envp[nenv] = (char *)GO_CRUN_SPAWN_ENV "=1";
+
+  posix_spawn_file_actions_init(&fa);
+  fa_init = true;
+  posix_spawn_file_actions_adddup2(&fa, request_fd, GO_CRUN_SPAWN_REQUEST_FD);
+  posix_spawn_file_actions_adddup2(&fa, error_pipe[1], GO_CRUN_SPAWN_ERROR_FD);
+  for (int i = 0; i < GO_CRUN_LAUNCHER_MAX_FDS; i++) {
+    if (moved[i] >= 0) posix_spawn_file_actions_adddup2(&fa, moved[i], GO_CRUN_SPAWN_STDIO_FD + i);
+  }
+
+  // Signal handlers are reset by exec, but the Go runtime's signal mask is
+  // inherited: start with a clean one and default dispositions
+  sigset_t none, all;
+  sigemptyset(&none);
+  sigfillset(&all);
+  sigdelset(&all, SIGKILL);
+  sigdelset(&all, SIGSTOP);
+  posix_spawnattr_init(&attr);
+  attr_init = true;
+  posix_spawnattr_setsigmask(&attr, &none);
+  posix_spawnattr_setsigdefault(&attr, &all);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+  char *argv[] = { (char *)"libcrun-go-spawn", NULL };
+  pid_t pid;
+  int rc = posix_spawn(&pid, "/proc/self/exe", &fa, &attr, argv, envp);
+  if (rc != 0) {
+    libcrun_make_error(err, rc, "posix_spawn failed");
+    goto out;
+  }
+
+  close(error_pipe[1]);
+  error_pipe[1] = -1;
+
+  int child_errno = go_crun_read_child_setup(error_pipe[0]);
+  if (child_errno < 0) {
+    waitpid(pid, NULL, 0);
+    libcrun_make_error(err, 0, "child process failed unexpectedly");
+    goto out;
+  }
+  if (child_errno != 0) {
+    waitpid(pid, NULL, 0);
+    libcrun_make_error(err, child_errno, "child process setup failed");
+    goto out;
+  }
+
+  *out_pid = pid;
+  ret = 0;
+
+out:
+  if (attr_init) posix_spawnattr_destroy(&attr);
+  if (fa_init) posix_spawn_file_actions_destroy(&fa);
+  free(envp);
+  free(b.data);
+  if (tmp_fd >= 0) close(tmp_fd);
+  if (request_fd >= 0) close(request_fd);
+  if (error_pipe[0] >= 0) close(error_pipe[0]);
+  if (error_pipe[1] >= 0) close(error_pipe[1]);
+  for (int i = 0; i < GO_CRUN_LAUNCHER_MAX_FDS; i++) {
+    if (moved[i] >= 0) close(moved[i]);
+  }
+  return ret;
+}
+
+// ---- Hot mounts ----
+// libcrun only reads mounts from a file: hand it the JSON through a memfd,
+// opened by its /proc/self/fd path, so nothing touches the disk.
+int go_crun_update_mounts(libcrun_context_t *ctx, const char *id, const char *json, size_t len, int add,
+                          libcrun_error_t *err) {
+  char path[64];
+  int ret;
+  int fd = memfd_create("libcrun-go-mounts", MFD_CLOEXEC);
+  if (fd < 0) return libcrun_make_error(err, errno, "memfd_create failed");
+  if (go_crun_write_all(fd, json, len) < 0) {
+    ret = libcrun_make_error(err, errno, "cannot write mounts");
+    goto out;
+  }
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+  if (add)
+    ret = libcrun_container_add_mounts_from_file(ctx, id, path, err);
+  else
+    ret = libcrun_container_remove_mounts_from_file(ctx, id, path, err);
+out:
+  close(fd);
+  return ret;
+}
+
+// ---- Network namespaces ----
+int go_crun_netns_new(const char *path, libcrun_error_t *err) {
+  char self[64];
+  int ret = 0;
+  int orig;
+  snprintf(self, sizeof(self), "/proc/self/task/%ld/ns/net", (long) syscall(SYS_gettid));
+  orig = open(self, O_RDONLY | O_CLOEXEC);
+  if (orig < 0) return libcrun_make_error(err, errno, "cannot open %s", self);
+  if (unshare(CLONE_NEWNET) < 0) {
+    ret = libcrun_make_error(err, errno, "unshare(CLONE_NEWNET) failed");
+    goto out;
+  }
+  if (mount(self, path, NULL, MS_BIND, NULL) < 0)
+    ret = libcrun_make_error(err, errno, "cannot bind mount the network namespace at %s", path);
+  if (setns(orig, CLONE_NEWNET) < 0) {
+    if (ret == 0) {
+      umount2(path, MNT_DETACH);
+      libcrun_make_error(err, errno, "cannot return to the original network namespace");
+    }
+    ret = 1;
+  }
+out:
+  close(orig);
+  return ret;
+}
+
+// ---- Probes ----
+// Namespaces a probe joins, in setns order: the user namespace first, for
+// the capabilities over the others, and the mount namespace last
+static const char *const go_crun_probe_ns[GO_CRUN_PROBE_NS] = {
+  "user", "cgroup", "ipc", "uts", "net", "pid", "time", "mnt",
+};
+
+#define GO_CRUN_PROBE_STACK (64 << 10)
+#define GO_CRUN_PROBE_PATH "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin"
+
+void go_crun_probe_free(struct go_crun_probe *p) {
+  if (!p) return;
+  for (int i = 0; i < GO_CRUN_PROBE_NS; i++)
+    if (p->ns_fd[i] >= 0) close(p->ns_fd[i]);
+  if (p->root_fd >= 0) close(p->root_fd);
+  if (p->cgroup_fd >= 0) close(p->cgroup_fd);
+  if (p->pidfd >= 0) close(p->pidfd);
+  if (p->stack) munmap(p->stack, GO_CRUN_PROBE_STACK);
+  free(p);
+}
+
+// Opens the namespaces, root and cgroup v2 directory of the container's
+// init process, as the cached status of ref has it. The namespaces this
+// process shares are left out. The status is checked again once they are
+// open, as the pid may have been reused in between.
+int go_crun_probe_open(libcrun_context_t *ctx, struct go_crun_container_ref *ref, struct go_crun_probe **out,
+                       libcrun_error_t *err) {
+  char path[PATH_MAX];
+  struct stat theirs, ours;
+  int rc = go_crun_ref_status(ctx, ref, err);
+  if (rc < 0) return rc;
+  if (rc == 0) return libcrun_make_error(err, 0, "container `%s` is not running", ref->id);
+  pid_t pid = ref->status.pid;
+
+  struct go_crun_probe *p = calloc(1, sizeof(*p));
+  if (!p) return libcrun_make_error(err, ENOMEM, "cannot allocate probe");
+  for (int i = 0; i < GO_CRUN_PROBE_NS; i++) p->ns_fd[i] = -1;
+  p->root_fd = p->cgroup_fd = -1;
+  p->pidfd = go_crun_pidfd_open(pid);
+
+  for (int i = 0; i < GO_CRUN_PROBE_NS; i++) {
+    snprintf(path, sizeof(path), "/proc/%d/ns/%s", (int) pid, go_crun_probe_ns[i]);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      if (errno == ENOENT) continue; // not supported by the kernel
+      rc = libcrun_make_error(err, errno, "cannot open `%s`", path);
+      goto fail;
+    }
+    snprintf(path, sizeof(path), "/proc/self/ns/%s", go_crun_probe_ns[i]);
+    if (fstat(fd, &theirs) == 0 && stat(path, &ours) == 0 && theirs.st_dev == ours.st_dev &&
+        theirs.st_ino == ours.st_ino) {
+      close(fd); // joining one's own user namespace fails, the others cost a syscall
+      continue;
+    }
+    p->ns_fd[i] = fd;
+  }
+  snprintf(path, sizeof(path), "/proc/%d/root", (int) pid);
+  p->root_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (p->root_fd < 0) {
+    rc = libcrun_make_error(err, errno, "cannot open `%s`", path);
+    goto fail;
+  }
+  if (ref->status.cgroup_path && ref->status.cgroup_path[0]) {
+    libcrun_error_t tmp = NULL;
+    if (libcrun_get_cgroup_mode(&tmp) == CGROUP_MODE_UNIFIED) {
+      snprintf(path, sizeof(path), CGROUP_ROOT "/%s", ref->status.cgroup_path);
+      p->cgroup_fd = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (tmp) libcrun_error_release(&tmp);
+  }
+  rc = libcrun_check_pid_valid(&ref->status, err);
+  if (rc < 0) goto fail;
+  if (rc == 0) {
+    rc = libcrun_make_error(err, 0, "container `%s` is not running", ref->id);
+    goto fail;
+  }
+  p->stack = mmap(NULL, GO_CRUN_PROBE_STACK, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (p->stack == MAP_FAILED) {
+    p->stack = NULL;
+    rc = libcrun_make_error(err, errno, "cannot allocate the probe stack");
+    goto fail;
+  }
+  *out = p;
+  return 0;
+
+fail:
+  go_crun_probe_free(p);
+  return rc;
+}
+
+// Fails once the container's init exited: its namespaces are kept by the
+// probe's fds, but are no longer the container's. Without a pidfd this is
+// not checked.
+static int go_crun_probe_check(struct go_crun_probe *p, libcrun_error_t *err) {
+  struct pollfd pfd = { .fd = p->pidfd, .events = POLLIN };
+  if (p->pidfd >= 0 && poll(&pfd, 1, 0) == 1)
+    return libcrun_make_error(err, ESRCH, "container is not running");
+  return 0;
+}
+
+struct go_crun_probe_child {
+  const struct go_crun_probe *p;
+  char *const *argv;
+  int out_fd;
+  sigset_t mask;
+  int err; // errno of the failed step, set by the child
+  const char *step;
+};
+
+// Runs in the clone(CLONE_VM | CLONE_VFORK) child, on the probe's stack:
+// only async-signal-safe calls until execve.
+static int go_crun_probe_child_main(void *arg) {
+  struct go_crun_probe_child *c = arg;
+  const struct go_crun_probe *p = c->p;
+  static char *const envp[] = { (char *) "PATH=" GO_CRUN_PROBE_PATH, NULL };
+  struct sigaction dfl = { .sa_handler = SIG_DFL };
+  char buf[PATH_MAX];
+  int fd;
+
+  // The handlers are the Go runtime's, in the memory shared with it
+  for (int sig = 1; sig < NSIG; sig++)
+    if (sig != SIGKILL && sig != SIGSTOP) sigaction(sig, &dfl, NULL);
+  sigemptyset(&c->mask);
+  sigprocmask(SIG_SETMASK, &c->mask, NULL);
+
+  if (p->cgroup_fd >= 0) {
+    c->step = "cgroup.procs";
+    fd = openat(p->cgroup_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || write(fd, "0", 1) != 1) goto fail;
+    close(fd);
+  }
+  c->step = "setns";
+  for (int i = 0; i < GO_CRUN_PROBE_NS; i++)
+    if (p->ns_fd[i] >= 0 && setns(p->ns_fd[i], 0) < 0) goto fail;
+  // The mount namespace's root is not the container's under no_pivot
+  c->step = "chroot";
+  if (fchdir(p->root_fd) < 0 || chroot(".") < 0 || chdir("/") < 0) goto fail;
+
+  c->step = "dup2";
+  fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  if (fd >= 0 && fd != 0) {
+    dup2(fd, 0);
+    close(fd);
+  }
+  if (dup2(c->out_fd, 1) < 0 || dup2(c->out_fd, 2) < 0) goto fail;
+#ifdef SYS_close_range
+  syscall(SYS_close_range, 3, ~0U, 4 /* CLOSE_RANGE_CLOEXEC */);
+#endif
+
+  c->step = "capabilities";
+  if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0) goto fail;
+  for (int cap = 0; prctl(PR_CAPBSET_READ, cap, 0, 0, 0) >= 0; cap++)
+    prctl(PR_CAPBSET_DROP, cap, 0, 0, 0);
+  struct __user_cap_header_struct hdr = { _LINUX_CAPABILITY_VERSION_3, 0 };
+  struct __user_cap_data_struct data[_LINUX_CAPABILITY_U32S_3] = { { 0 } };
+  if (syscall(SYS_capset, &hdr, data) < 0) goto fail;
+
+  c->step = "execve";
+  const char *name = c->argv[0];
+  if (strchr(name, '/')) {
+    execve(name, c->argv, envp);
+    goto fail;
+  }
+  // As execvpe, on the fixed PATH
+  int last = ENOENT;
+  for (const char *dir = GO_CRUN_PROBE_PATH; *dir;) {
+    const char *end = strchrnul(dir, ':');
+    size_t dlen = (size_t) (end - dir), nlen = strlen(name);
+    if (dlen + nlen + 2 <= sizeof(buf)) {
+      memcpy(buf, dir, dlen);
+      buf[dlen] = '/';
+      memcpy(buf + dlen + 1, name, nlen + 1);
+      execve(buf, c->argv, envp);
+      if (errno != ENOENT && errno != ENOTDIR) last = errno;
+    }
+    dir = *end ? end + 1 : end;
+  }
+  errno = last;
+
+fail:
+  c->err = errno ? errno : EINVAL;
+  _exit(127);
+}
+
+// Starts argv in the probe's namespaces, with out_fd as its stdout and
+// stderr. It returns once the child has exec'd, or failed to, like
+// posix_spawn. A child that failed is reaped.
+int go_crun_probe_spawn(struct go_crun_probe *p, char *const argv[], int out_fd, pid_t *out_pid,
+                        libcrun_error_t *err) {
+  struct go_crun_probe_child c = { .p = p, .argv = argv, .out_fd = out_fd };
+  sigset_t all, old;
+  if (go_crun_probe_check(p, err) < 0) return -1;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  pid_t pid = clone(go_crun_probe_child_main, (char *) p->stack + GO_CRUN_PROBE_STACK,
+                    CLONE_VM | CLONE_VFORK | SIGCHLD, &c);
+  int clone_errno = errno;
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (pid < 0) return libcrun_make_error(err, clone_errno, "clone failed");
+  if (c.err) {
+    while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+      ;
+    return libcrun_make_error(err, c.err, "probe `%s`: %s failed", argv[0], c.step);
+  }
+  *out_pid = pid;
+  return 0;
+}
+
+// Creates a socket in the probe's network namespace, from the calling
+// thread, which then returns to its own. If it could not, *tainted is set
+// and the thread must not be used again.
+int go_crun_probe_socket(struct go_crun_probe *p, int family, int *tainted, libcrun_error_t *err) {
+  int netfd = p->ns_fd[GO_CRUN_PROBE_NS_NET];
+  int fd;
+  *tainted = 0;
+  if (go_crun_probe_check(p, err) < 0) return -1;
+  if (netfd < 0) {
+    fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return libcrun_make_error(err, errno, "socket failed");
+    return fd;
+  }
+  int orig = open("/proc/thread-self/ns/net", O_RDONLY | O_CLOEXEC);
+  if (orig < 0) return libcrun_make_error(err, errno, "cannot open /proc/thread-self/ns/net");
+  if (setns(netfd, CLONE_NEWNET) < 0) {
+    int e = errno;
+    close(orig);
+    return libcrun_make_error(err, e, "setns into the container's network namespace failed");
+  }
+  fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int sock_errno = errno;
+  if (setns(orig, CLONE_NEWNET) < 0) *tainted = 1;
+  close(orig);
+  if (fd < 0) return libcrun_make_error(err, sock_errno, "socket failed");
+  return fd;
+}
+
+// ---- Seccomp ----
+// Compile the container's seccomp profile into a memfd, skipping libcrun's
+// on-disk cache, and return the BPF program in a malloc'd buffer.
+int go_crun_seccomp_compile(libcrun_container_t *container, int fail_unknown, char **out, size_t *out_len,
+                            libcrun_error_t *err) {
+  struct libcrun_seccomp_gen_ctx_s gen;
+  struct stat st;
+  char *buf = NULL;
+  ssize_t n;
+  unsigned int options = LIBCRUN_SECCOMP_SKIP_CACHE;
+  int ret;
+  int fd = memfd_create("libcrun-go-seccomp", MFD_CLOEXEC);
+  if (fd < 0) return libcrun_make_error(err, errno, "memfd_create failed");
+  if (fail_unknown) options |= LIBCRUN_SECCOMP_FAIL_UNKNOWN_SYSCALL;
+  libcrun_seccomp_gen_ctx_init(&gen, container, true, options);
+  gen.fd = fd;
+  ret = libcrun_generate_seccomp(&gen, err);
+  if (ret < 0) goto out;
+  if (fstat(fd, &st) < 0) {
+    ret = libcrun_make_error(err, errno, "fstat failed");
+    goto out;
+  }
+  buf = malloc(st.st_size > 0 ? st.st_size : 1);
+  if (buf == NULL) {
+    ret = libcrun_make_error(err, ENOMEM, "cannot allocate the seccomp program");
+    goto out;
+  }
+  n = pread(fd, buf, st.st_size, 0);
+  if (n < 0) {
+    free(buf);
+    ret = libcrun_make_error(err, errno, "cannot read the seccomp program");
+    goto out;
+  }
+  *out = buf;
+  *out_len = n;
+  ret = 0;
+out:
+  close(fd);
+  return ret;
+}
+
+// ---- Device eBPF program reuse ----
+// libcrun loads and verifies a device-filter program for every container
+// on cgroup v2, though the programs of containers with the same device
+// allowlist are identical. The library is linked with
+// -Wl,--wrap=libcrun_ebpf_load, so those loads land here: a program equal
+// to one loaded before (libcrun_ebpf_cmp_programs) is attached by fd
+// instead. Loaded programs are also pinned under GO_CRUN_EBPF_DIR, keyed
+// by a hash of their instructions, for forked and spawned launchers and
+// other processes; a pinned program is only used once read back equal.
+// go_crun_ebpf_purge removes the pins. Reuse is off unless turned on by
+// go_crun_set_ebpf_reuse, and stays off if the layout of struct
+// bpf_program, read through a mirror, does not match the linked libcrun.
+
+#define GO_CRUN_EBPF_DIR SYS_FS_BPF "/libcrun-go"
+#define GO_CRUN_EBPF_CACHE_MAX 16
+#define GO_CRUN_EBPF_MAX_PROGS 64
+
+int __real_libcrun_ebpf_load(struct bpf_program *program, int dirfd, const char *pin, libcrun_error_t *err);
+
+// Layout of struct bpf_program in libcrun's ebpf.c (crun 1.26), which
+// keeps it private. The asserts pin the mirror to that layout; the linked
+// library is checked against it at run time (go_crun_ebpf_layout_check).
+struct go_crun_bpf_program {
+  size_t allocated;
+  size_t used;
+  unsigned int private;
+  char program[];
+};
+_Static_assert(offsetof(struct go_crun_bpf_program, used) == sizeof(size_t), "bpf_program.used moved");
+_Static_assert(offsetof(struct go_crun_bpf_program, program) == 2 * sizeof(size_t) + sizeof(unsigned int),
+               "bpf_program.program moved");
+
+struct go_crun_ebpf_entry {
+  struct bpf_program *program;
+  int fd;
+  uint32_t id;
+};
+
+static pthread_mutex_t go_crun_ebpf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t go_crun_ebpf_once = PTHREAD_ONCE_INIT;
+static struct go_crun_ebpf_entry go_crun_ebpf_cache[GO_CRUN_EBPF_CACHE_MAX];
+static size_t go_crun_ebpf_cached = 0;
+static int go_crun_ebpf_layout_ok = 0;
+
+// Whether the mirror reads the programs libcrun builds: one made by
+// bpf_program_new and bpf_program_append must read back as appended
+static int go_crun_ebpf_layout_check(void) {
+  static const char data[24] = "libcrun-go-layout-check";
+  const struct go_crun_bpf_program *p;
+  struct bpf_program *program = bpf_program_new(8);
+  int ok;
+  program = bpf_program_append(program, (void *) data, 16);
+  program = bpf_program_append(program, (void *) (data + 16), 8);
+  p = (const struct go_crun_bpf_program *) program;
+  ok = p->used == sizeof(data) && p->allocated >= p->used && memcmp(p->program, data, sizeof(data)) == 0;
+  free(program);
+  return ok;
+}
+
+// libcrun may load from a child forked while another thread holds the lock
+static void go_crun_ebpf_prefork(void) { pthread_mutex_lock(&go_crun_ebpf_lock); }
+static void go_crun_ebpf_postfork(void) { pthread_mutex_unlock(&go_crun_ebpf_lock); }
+static void go_crun_ebpf_init(void) {
+  pthread_atfork(go_crun_ebpf_prefork, go_crun_ebpf_postfork, go_crun_ebpf_postfork);
+  go_crun_ebpf_layout_ok = go_crun_ebpf_layout_check();
+}
+
+void go_crun_set_ebpf_reuse(int enabled) {
+  go_crun_ebpf_reuse = enabled != 0;
+}
+
+// Drop the programs cached by this process and remove every pin under
+// GO_CRUN_EBPF_DIR, including those of other processes, which load and pin
+// their programs again on next use. Programs attached to cgroups stay
+// loaded until those are removed.
+int go_crun_ebpf_purge(void) {
+  DIR *d;
+  struct dirent *de;
+  int ret = 0;
+  pthread_mutex_lock(&go_crun_ebpf_lock);
+  for (size_t i = 0; i < go_crun_ebpf_cached; i++) {
+    close(go_crun_ebpf_cache[i].fd);
+    free(go_crun_ebpf_cache[i].program);
+  }
+  go_crun_ebpf_cached = 0;
+  d = opendir(GO_CRUN_EBPF_DIR);
+  if (d == NULL) {
+    ret = errno == ENOENT ? 0 : -errno;
+    pthread_mutex_unlock(&go_crun_ebpf_lock);
+    return ret;
+  }
+  while ((de = readdir(d)) != NULL) {
+    if (strncmp(de->d_name, "dev-", 4) != 0) continue;
+    if (unlinkat(dirfd(d), de->d_name, 0) < 0 && errno != ENOENT && ret == 0) ret = -errno;
+  }
+  closedir(d);
+  if (rmdir(GO_CRUN_EBPF_DIR) < 0 && errno != ENOENT && errno != ENOTEMPTY && ret == 0) ret = -errno;
+  pthread_mutex_unlock(&go_crun_ebpf_lock);
+  return ret;
+}
+
+static int go_crun_bpf(int cmd, union bpf_attr *attr) {
+  return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+static int go_crun_ebpf_prog_id(int fd, uint32_t *id) {
+  struct bpf_prog_info info;
+  union bpf_attr attr;
+  memset(&info, 0, sizeof(info));
+  memset(&attr, 0, sizeof(attr));
+  attr.info.bpf_fd = fd;
+  attr.info.info_len = sizeof(info);
+  attr.info.info = (uint64_t) (uintptr_t) &info;
+  if (go_crun_bpf(BPF_OBJ_GET_INFO_BY_FD, &attr) < 0) return -1;
+  *id = info.id;
+  return 0;
+}
+
+// Ids of the device programs attached to the cgroup dirfd
+static int go_crun_ebpf_query(int dirfd, uint32_t *ids, uint32_t *n) {
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.query.target_fd = dirfd;
+  attr.query.attach_type = BPF_CGROUP_DEVICE;
+  attr.query.prog_ids = (uint64_t) (uintptr_t) ids;
+  attr.query.prog_cnt = GO_CRUN_EBPF_MAX_PROGS;
+  if (go_crun_bpf(BPF_PROG_QUERY, &attr) < 0) return -1;
+  *n = attr.query.prog_cnt;
+  return 0;
+}
+
+static int go_crun_ebpf_fd_by_id(uint32_t id) {
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.prog_id = id;
+  return go_crun_bpf(BPF_PROG_GET_FD_BY_ID, &attr);
+}
+
+static void go_crun_ebpf_pin_path(struct bpf_program *program, char *path, size_t size) {
+  const struct go_crun_bpf_program *p = (const struct go_crun_bpf_program *) program;
+  uint64_t h = 14695981039346656037ULL; // FNV-1a
+  for (size_t i = 0; i < p->used; i++) h = (h ^ (unsigned char) p->program[i]) * 1099511628211ULL;
+  snprintf(path, size, GO_CRUN_EBPF_DIR "/dev-%016llx-%zu", (unsigned long long) h, p->used);
+}
+
+// Cache program, loaded as fd (owned by the cache from now on)
+static void go_crun_ebpf_add(struct bpf_program *program, int fd) {
+  const struct go_crun_bpf_program *p = (const struct go_crun_bpf_program *) program;
+  struct go_crun_ebpf_entry *e;
+  uint32_t id;
+  if (go_crun_ebpf_cached == GO_CRUN_EBPF_CACHE_MAX || go_crun_ebpf_prog_id(fd, &id) < 0) {
+    close(fd);
+    return;
+  }
+  e = &go_crun_ebpf_cache[go_crun_ebpf_cached++];
+  e->program = bpf_program_append(bpf_program_new(p->used), (void *) p->program, p->used);
+  e->fd = fd;
+  e->id = id;
+}
+
+// fd of a program equal to program, from the cache or a pin of another process
+static struct go_crun_ebpf_entry *go_crun_ebpf_lookup(struct bpf_program *program) {
+  struct bpf_program *pinned = NULL;
+  libcrun_error_t err = NULL;
+  union bpf_attr attr;
+  char path[PATH_MAX];
+  size_t n = go_crun_ebpf_cached;
+  int fd;
+  for (size_t i = 0; i < go_crun_ebpf_cached; i++) {
+    if (libcrun_ebpf_cmp_programs(go_crun_ebpf_cache[i].program, program)) return &go_crun_ebpf_cache[i];
+  }
+  go_crun_ebpf_pin_path(program, path, sizeof(path));
+  if (libcrun_ebpf_read_program(&pinned, path, &err) < 0) {
+    libcrun_error_release(&err);
+    return NULL;
+  }
+  fd = -1;
+  if (libcrun_ebpf_cmp_programs(pinned, program)) {
+    memset(&attr, 0, sizeof(attr));
+    attr.pathname = (uint64_t) (uintptr_t) path;
+    fd = go_crun_bpf(BPF_OBJ_GET, &attr);
+  }
+  free(pinned);
+  if (fd < 0) return NULL;
+  go_crun_ebpf_add(program, fd);
+  return go_crun_ebpf_cached > n ? &go_crun_ebpf_cache[n] : NULL;
+}
+
+// Attach e to the cgroup dirfd in place of its device programs, and pin it
+// at pin, as libcrun_ebpf_load does with a program it just loaded
+static int go_crun_ebpf_attach(struct go_crun_ebpf_entry *e, int dirfd, const char *pin, libcrun_error_t *err) {
+  uint32_t ids[GO_CRUN_EBPF_MAX_PROGS];
+  uint32_t n = 0;
+  union bpf_attr attr;
+  int replace_fd = -1;
+  int ret;
+  if (go_crun_ebpf_query(dirfd, ids, &n) < 0) return libcrun_make_error(err, errno, "bpf query");
+  if (!(n == 1 && ids[0] == e->id)) {
+    memset(&attr, 0, sizeof(attr));
+    attr.target_fd = dirfd;
+    attr.attach_bpf_fd = e->fd;
+    attr.attach_type = BPF_CGROUP_DEVICE;
+    attr.attach_flags = BPF_F_ALLOW_MULTI;
+    if (n == 1) {
+      replace_fd = go_crun_ebpf_fd_by_id(ids[0]);
+      if (replace_fd >= 0) {
+        attr.attach_flags |= BPF_F_REPLACE;
+        attr.replace_bpf_fd = replace_fd;
+      }
+    }
+    ret = go_crun_bpf(BPF_PROG_ATTACH, &attr);
+    if (replace_fd >= 0) close(replace_fd);
+    if (ret < 0) return libcrun_make_error(err, errno, "bpf attach");
+    for (uint32_t i = 0; replace_fd < 0 && i < n; i++) {
+      int old = go_crun_ebpf_fd_by_id(ids[i]);
+      if (old < 0) continue;
+      memset(&attr, 0, sizeof(attr));
+      attr.target_fd = dirfd;
+      attr.attach_bpf_fd = old;
+      attr.attach_type = BPF_CGROUP_DEVICE;
+      go_crun_bpf(BPF_PROG_DETACH, &attr);
+      close(old);
+    }
+  }
+  if (pin) {
+    memset(&attr, 0, sizeof(attr));
+    attr.pathname = (uint64_t) (uintptr_t) pin;
+    attr.bpf_fd = e->fd;
+    unlink(pin);
+    if (go_crun_bpf(BPF_OBJ_PIN, &attr) < 0) return libcrun_make_error(err, errno, "bpf pin to `%s`", pin);
+  }
+  return 0;
+}
+
+// Cache the program libcrun just attached to dirfd, its only device program
+static void go_crun_ebpf_learn(struct bpf_program *program, int dirfd) {
+  uint32_t ids[GO_CRUN_EBPF_MAX_PROGS];
+  uint32_t n = 0;
+  union bpf_attr attr;
+  char path[PATH_MAX];
+  size_t cached = go_crun_ebpf_cached;
+  int fd;
+  if (go_crun_ebpf_query(dirfd, ids, &n) < 0 || n != 1) return;
+  fd = go_crun_ebpf_fd_by_id(ids[0]);
+  if (fd < 0) return;
+  go_crun_ebpf_add(program, fd);
+  if (go_crun_ebpf_cached == cached) return;
+  go_crun_ebpf_pin_path(program, path, sizeof(path));
+  if (mkdir(GO_CRUN_EBPF_DIR, 0700) < 0 && errno != EEXIST) return;
+  memset(&attr, 0, sizeof(attr));
+  attr.pathname = (uint64_t) (uintptr_t) path;
+  attr.bpf_fd = go_crun_ebpf_cache[cached].fd;
+  go_crun_bpf(BPF_OBJ_PIN, &attr); // EEXIST: pinned by another process
+}
+
+int __wrap_libcrun_ebpf_load(struct bpf_program *program, int dirfd, const char *pin, libcrun_error_t *err) {
+  struct go_crun_ebpf_entry *e;
+  int ret;
+  if (!go_crun_ebpf_reuse) return __real_libcrun_ebpf_load(program, dirfd, pin, err);
+  pthread_once(&go_crun_ebpf_once, go_crun_ebpf_init);
+  if (!go_crun_ebpf_layout_ok) return __real_libcrun_ebpf_load(program, dirfd, pin, err);
+
+  pthread_mutex_lock(&go_crun_ebpf_lock);
+  e = go_crun_ebpf_lookup(program);
+  if (e != NULL) {
+    ret = go_crun_ebpf_attach(e, dirfd, pin, err);
+    pthread_mutex_unlock(&go_crun_ebpf_lock);
+    return ret;
+  }
+  pthread_mutex_unlock(&go_crun_ebpf_lock);
+
+  ret = __real_libcrun_ebpf_load(program, dirfd, pin, err);
+  if (ret < 0) return ret;
+  pthread_mutex_lock(&go_crun_ebpf_lock);
+  go_crun_ebpf_learn(program, dirfd);
+  pthread_mutex_unlock(&go_crun_ebpf_lock);
+  return ret;
+}
+
+// ---- Cgroup recycling ----
+// A CgroupPool assigns each container it serves, by state root and id, an
+// empty cgroup it created beforehand. The library is linked with
+// -Wl,--wrap for libcrun_cgroup_preenter, libcrun_cgroup_enter and
+// libcrun_cgroup_destroy: a cgroupfs launch without linux.cgroupsPath
+// enters the assigned cgroup, and destroying it only kills its processes,
+// leaving the directory for the pool to reset and hand out again. The
+// table is copied into the child forked for a launch along with the rest
+// of memory; Launcher helpers, forked earlier, and Spawn's program have
+// no assignments.
+
+int __real_libcrun_cgroup_preenter(struct libcrun_cgroup_args *args, int *dirfd, libcrun_error_t *err);
+int __real_libcrun_cgroup_enter(struct libcrun_cgroup_args *args, struct libcrun_cgroup_status **out,
+                                libcrun_error_t *err);
+int __real_libcrun_cgroup_destroy(struct libcrun_cgroup_status *cgroup_status, libcrun_error_t *err);
+
+struct go_crun_cgroup_assignment {
+  char *state_root; // NULL for libcrun's default
+  char *id;
+  char *path;
+};
+
+static pthread_mutex_t go_crun_cgroup_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t go_crun_cgroup_pool_once = PTHREAD_ONCE_INIT;
+static struct go_crun_cgroup_assignment *go_crun_cgroup_assignments = NULL;
+static size_t go_crun_cgroup_assigned = 0, go_crun_cgroup_allocated = 0;
+
+static void go_crun_cgroup_pool_prefork(void) { pthread_mutex_lock(&go_crun_cgroup_pool_lock); }
+static void go_crun_cgroup_pool_postfork(void) { pthread_mutex_unlock(&go_crun_cgroup_pool_lock); }
+static void go_crun_cgroup_pool_init(void) {
+  pthread_atfork(go_crun_cgroup_pool_prefork, go_crun_cgroup_pool_postfork, go_crun_cgroup_pool_postfork);
+}
+
+static int go_crun_str_eq(const char *a, const char *b) {
+  if (a == NULL || b == NULL) return a == b;
+  return strcmp(a, b) == 0;
+}
+
+// The assignment of id in state_root; unless exact, a NULL state root on
+// either side, libcrun's default, matches any
+static struct go_crun_cgroup_assignment *go_crun_cgroup_lookup(const char *state_root, const char *id, int exact) {
+  for (size_t i = 0; i < go_crun_cgroup_assigned; i++) {
+    struct go_crun_cgroup_assignment *a = &go_crun_cgroup_assignments[i];
+    if (strcmp(a->id, id) != 0) continue;
+    if (go_crun_str_eq(a->state_root, state_root) || (!exact && (a->state_root == NULL || state_root == NULL)))
+      return a;
+  }
+  return NULL;
+}
+
+int go_crun_cgroup_pool_assign(const char *state_root, const char *id, const char *path) {
+  struct go_crun_cgroup_assignment *a, b = {NULL, NULL, NULL};
+  int ret = 0;
+  if (path != NULL) {
+    b.state_root = state_root ? strdup(state_root) : NULL;
+    b.id = strdup(id);
+    b.path = strdup(path);
+    if ((state_root && !b.state_root) || !b.id || !b.path) {
+      free(b.state_root);
+      free(b.id);
+      free(b.path);
+      return -1;
+    }
+  }
+  pthread_once(&go_crun_cgroup_pool_once, go_crun_cgroup_pool_init);
+  pthread_mutex_lock(&go_crun_cgroup_pool_lock);
+  a = go_crun_cgroup_lookup(state_root, id, 1);
+  if (a != NULL) {
+    free(a->state_root);
+    free(a->id);
+    free(a->path);
+    *a = go_crun_cgroup_assignments[--go_crun_cgroup_assigned];
+  }
+  if (path != NULL) {
+    if (go_crun_cgroup_assigned == go_crun_cgroup_allocated) {
+      size_t n = go_crun_cgroup_allocated ? 2 * go_crun_cgroup_allocated : 16;
+      void *v = realloc(go_crun_cgroup_assignments, n * sizeof(*go_crun_cgroup_assignments));
+      if (v == NULL) {
+        ret = -1;
+        goto out;
+      }
+      go_crun_cgroup_assignments = v;
+      go_crun_cgroup_allocated = n;
+    }
+    go_crun_cgroup_assignments[go_crun_cgroup_assigned++] = b;
+    b.state_root = b.id = b.path = NULL;
+  }
+out:
+  pthread_mutex_unlock(&go_crun_cgroup_pool_lock);
+  free(b.state_root);
+  free(b.id);
+  free(b.path);
+  return ret;
+}
+
+// Point args at a copy of the cgroup path assigned to its container, if
+// any, and return the copy. The assignment may be released by a racing
+// Delete meanwhile, so libcrun never sees the table's own string; the
+// caller restores args and frees the copy once the wrapped call returned
+// (libcrun keeps paths of its own in the cgroup status past it).
+static char *go_crun_cgroup_pool_apply(struct libcrun_cgroup_args *args) {
+  struct go_crun_cgroup_assignment *a;
+  char *path = NULL;
+  if (args->manager != CGROUP_MANAGER_CGROUPFS || (args->cgroup_path != NULL && args->cgroup_path[0] != '\0'))
+    return NULL;
+  pthread_mutex_lock(&go_crun_cgroup_pool_lock);
+  a = args->id ? go_crun_cgroup_lookup(args->state_root, args->id, 0) : NULL;
+  if (a != NULL) path = xstrdup(a->path);
+  pthread_mutex_unlock(&go_crun_cgroup_pool_lock);
+  if (path != NULL) args->cgroup_path = path;
+  return path;
+}
+
+int __wrap_libcrun_cgroup_preenter(struct libcrun_cgroup_args *args, int *dirfd, libcrun_error_t *err) {
+  const char *cgroup_path = args->cgroup_path;
+  char *pooled = go_crun_cgroup_pool_apply(args);
+  int ret = __real_libcrun_cgroup_preenter(args, dirfd, err);
+  if (pooled != NULL) {
+    args->cgroup_path = cgroup_path;
+    free(pooled);
+  }
+  return ret;
+}
+
+int __wrap_libcrun_cgroup_enter(struct libcrun_cgroup_args *args, struct libcrun_cgroup_status **out,
+                                libcrun_error_t *err) {
+  const char *cgroup_path = args->cgroup_path;
+  char *pooled = go_crun_cgroup_pool_apply(args);
+  int ret = __real_libcrun_cgroup_enter(args, out, err);
+  if (pooled != NULL) {
+    args->cgroup_path = cgroup_path;
+    free(pooled);
+  }
+  return ret;
+}
+
+int __wrap_libcrun_cgroup_destroy(struct libcrun_cgroup_status *cgroup_status, libcrun_error_t *err) {
+  const char *path;
+  int pooled = 0;
+  go_crun_exit_snapshot(cgroup_status);
+  if (cgroup_status == NULL || cgroup_status->path == NULL || cgroup_status->manager != CGROUP_MANAGER_CGROUPFS)
+    return __real_libcrun_cgroup_destroy(cgroup_status, err);
+  path = cgroup_status->path;
+  while (*path == '/') path++;
+  pthread_mutex_lock(&go_crun_cgroup_pool_lock);
+  for (size_t i = 0; i < go_crun_cgroup_assigned && !pooled; i++) {
+    const char *p = go_crun_cgroup_assignments[i].path;
+    while (*p == '/') p++;
+    pooled = strcmp(p, path) == 0;
+  }
+  pthread_mutex_unlock(&go_crun_cgroup_pool_lock);
+  if (!pooled) return __real_libcrun_cgroup_destroy(cgroup_status, err);
+  // The pool waits for the cgroup to empty before reusing it
+  if (libcrun_cgroup_killall(cgroup_status, SIGKILL, err) < 0) libcrun_error_release(err);
+  return 0;
+}
+
+// ---- systemd slices ----
+// sd-bus, declared here: the bundled headers do not include systemd's
+typedef struct sd_bus sd_bus;
+typedef struct sd_bus_message sd_bus_message;
+typedef struct {
+  const char *name;
+  const char *message;
+  int _need_free;
+} sd_bus_error;
+typedef int (*sd_bus_message_handler_t)(sd_bus_message *m, void *userdata, sd_bus_error *ret_error);
+int sd_bus_open_system(sd_bus **ret);
+int sd_bus_open_user(sd_bus **ret);
+sd_bus *sd_bus_flush_close_unref(sd_bus *bus);
+int sd_bus_call_method_async(sd_bus *bus, void **slot, const char *destination, const char *path,
+                             const char *interface, const char *member, sd_bus_message_handler_t callback,
+                             void *userdata, const char *types, ...);
+int sd_bus_process(sd_bus *bus, sd_bus_message **r);
+int sd_bus_wait(sd_bus *bus, uint64_t timeout_usec);
+int sd_bus_message_is_method_error(sd_bus_message *m, const char *name);
+const sd_bus_error *sd_bus_message_get_error(sd_bus_message *m);
+int sd_bus_message_get_errno(sd_bus_message *m);
+
+struct go_crun_slice_reply {
+  int *pending;
+  int error;            // errno of the failure, 0 on success
+  char msg[256];
+};
+
+static int go_crun_slice_started(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+  struct go_crun_slice_reply *r = userdata;
+  (void) ret_error;
+  (*r->pending)--;
+  // A slice already there is what was asked for
+  if (sd_bus_message_is_method_error(m, NULL) &&
+      !sd_bus_message_is_method_error(m, "org.freedesktop.systemd1.UnitExists")) {
+    const sd_bus_error *e = sd_bus_message_get_error(m);
+    r->error = sd_bus_message_get_errno(m);
+    if (r->error <= 0) r->error = EIO;
+    snprintf(r->msg, sizeof(r->msg), "%s", e && e->message ? e->message : "unknown error");
+  }
+  return 0;
+}
+
+int go_crun_systemd_start_slices(const char **names, int n, int user, libcrun_error_t *err) {
+  sd_bus *bus = NULL;
+  struct go_crun_slice_reply *replies;
+  int pending = 0, rc, i;
+
+  rc = user ? sd_bus_open_user(&bus) : sd_bus_open_system(&bus);
+  if (rc < 0) return libcrun_make_error(err, -rc, "cannot connect to the systemd bus");
+  replies = calloc(n > 0 ? n : 1, sizeof(*replies));
+  if (!replies) {
+    sd_bus_flush_close_unref(bus);
+    return libcrun_make_error(err, ENOMEM, "cannot allocate replies");
+  }
+  // Queue every StartTransientUnit, then collect the replies: the slices
+  // cost one round trip to systemd together
+  for (i = 0; i < n; i++) {
+    replies[i].pending = &pending;
+    rc = sd_bus_call_method_async(bus, NULL, "org.freedesktop.systemd1", "/org/freedesktop/systemd1",
+                                  "org.freedesktop.systemd1.Manager", "StartTransientUnit",
+                                  go_crun_slice_started, &replies[i], "ssa(sv)a(sa(sv))",
+                                  names[i], "fail", 1, "Description", "s", "libcrun-go tenant slice", 0);
+    if (rc < 0) {
+      libcrun_make_error(err, -rc, "cannot start slice `%s`", names[i]);
+      goto out;
+    }
+    pending++;
+  }
+  while (pending > 0) {
+    rc = sd_bus_process(bus, NULL);
+    if (rc < 0) {
+      libcrun_make_error(err, -rc, "cannot read from the systemd bus");
+      goto out;
+    }
+    if (rc > 0) continue;
+    rc = sd_bus_wait(bus, (uint64_t) -1);
+    if (rc < 0 && rc != -EINTR) {
+      libcrun_make_error(err, -rc, "cannot wait on the systemd bus");
+      goto out;
+    }
+  }
+  rc = 0;
+  for (i = 0; i < n; i++) {
+    if (replies[i].error) {
+      rc = libcrun_make_error(err, replies[i].error, "cannot start slice `%s`: %s", names[i], replies[i].msg);
+      break;
+    }
+  }
+out:
+  // Drops the callbacks still pending, whose userdata is in replies
+  sd_bus_flush_close_unref(bus);
+  free(replies);
+  return rc;
+}
@@ -0,0 +1,165 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"sort"
+	"strconv"
+	"strings"
+	"unsafe"
+)
+
+// resctrlRoot is the resctrl mount point (a variable so tests can point it
+// at a fake hierarchy).
+var resctrlRoot = "/sys/fs/resctrl"
+
+// IntelRdtUpdate changes the schemata of a running container's resctrl
+// group. Empty fields are left unchanged.
+type IntelRdtUpdate struct {
+	L3CacheSchema string   // e.g. "L3:0=ff;1=ff"
+	MemBwSchema   string   // e.g. "MB:0=50;1=50"
+	Schemata      []string // other lines written to the group's schemata file
+}
+
+// UpdateIntelRdt rewrites the schemata of the container's resctrl group.
+// The group must have been set up at creation, see WithIntelRdt; when it
+// is shared through a closID, the change applies to every container in it.
+func (c *Container) UpdateIntelRdt(u IntelRdtUpdate) error {
+	x := c.runtime
+	if x == nil || x.c == nil {
+		return errors.New("libcrun: invalid runtime context")
+	}
+	r := c.ref()
+	cid := r.cidFor(c.ID)
+	defer r.release(cid)
+	l3 := optCString(u.L3CacheSchema)
+	defer C.free(unsafe.Pointer(l3))
+	mb := optCString(u.MemBwSchema)
+	defer C.free(unsafe.Pointer(mb))
+	var schemata **C.char
+	if len(u.Schemata) > 0 {
+		schemata = cStringVector(u.Schemata)
+		defer freeCStringVector(schemata, len(u.Schemata))
+	}
+
+	var err C.libcrun_error_t
+	logged := x.beginLog(cid)
+	rc := C.go_crun_update_intel_rdt(x.c, cid, l3, mb, schemata, &err)
+	endLog(logged)
+	if rc < 0 {
+		return fromLibcrunErr(&err)
+	}
+	return nil
+}
+
+// IntelRdtDomainStats holds the resctrl monitoring counters of one L3
+// cache domain (mon_data/mon_L3_<id>). Counters the hardware does not
+// support, or reports as unavailable, are 0.
+type IntelRdtDomainStats struct {
+	Domain        int    // L3 cache id
+	LLCOccupancy  uint64 // bytes of L3 currently held
+	MBMTotalBytes uint64 // total memory bandwidth used, cumulative
+	MBMLocalBytes uint64 // local-node memory bandwidth used, cumulative
+}
+
+// IntelRdtStats returns the resctrl monitoring counters of the container,
+// one entry per L3 domain, sorted by domain.
+//
+// The counters come from the container's own monitoring group when it was
+// created with WithIntelRdtMonitoring. Without one they are read from its
+// resctrl group, which is only accepted when the group is private to the
+// container (no closID given); the counters of a shared CLOS would cover
+// its other containers too.
+func (c *Container) IntelRdtStats() ([]IntelRdtDomainStats, error) {
+	dir, err := c.resctrlMonDir()
+	if err != nil {
+		return nil, err
+	}
+	return readResctrlMonData(filepath.Join(dir, "mon_data"))
+}
+
+// resctrlMonDir returns the resctrl directory whose mon_data covers
+// exactly the container's tasks.
+func (c *Container) resctrlMonDir() (string, error) {
+	x := c.runtime
+	if x == nil || x.c == nil {
+		return "", errors.New("libcrun: invalid runtime context")
+	}
+	r := c.ref()
+	cid := r.cidFor(c.ID)
+	defer r.release(cid)
+	var closID *C.char
+	var monitoring C.int
+	var err C.libcrun_error_t
+	rc := C.go_crun_intel_rdt_group(x.c, cid, &closID, &monitoring, &err)
+	if rc < 0 {
+		return "", fromLibcrunErr(&err)
+	}
+	defer C.free(unsafe.Pointer(closID))
+	if rc == 0 {
+		return "", errors.New("libcrun: container has no intelRdt configuration")
+	}
+
+	group := c.ID
+	if closID != nil {
+		group = C.GoString(closID)
+	}
+	switch {
+	case monitoring != 0:
+		return filepath.Join(resctrlRoot, group, "mon_groups", c.ID), nil
+	case closID == nil:
+		return filepath.Join(resctrlRoot, group), nil
+	default:
+		return "", errors.New("libcrun: intelRdt monitoring is not enabled for a container in a shared closID")
+	}
+}
+
+func readResctrlMonData(dir string) ([]IntelRdtDomainStats, error) {
+	entries, err := os.ReadDir(dir)
+	if err != nil {
+		return nil, err
+	}
+	var out []IntelRdtDomainStats
+	for _, e := range entries {
+		name, ok := strings.CutPrefix(e.Name(), "mon_L3_")
+		if !ok {
+			continue
+		}
+		domain, err := strconv.Atoi(name)
+		if err != nil {
+			continue
+		}
+		d := IntelRdtDomainStats{Domain: domain}
+		for _, f := range []struct {
+			name string
+			dst  *uint64
+		}{
+			{"llc_occupancy", &d.LLCOccupancy},
+			{"mbm_total_bytes", &d.MBMTotalBytes},
+			{"mbm_local_bytes", &d.MBMLocalBytes},
+		} {
+			b, err := os.ReadFile(filepath.Join(dir, e.Name(), f.name))
+			if err != nil {
+				if errors.Is(err, os.ErrNotExist) {
+					continue
+				}
+				return nil, err
+			}
+			// "Unavailable" (or "Error") is reported while a counter has no value
+			if v, err := strconv.ParseUint(strings.TrimSpace(string(b)), 10, 64); err == nil {
+				*f.dst = v
+			}
+		}
+		out = append(out, d)
+	}
+	sort.Slice(out, func(i, j int) bool { return out[i].Domain < out[j].Domain })
+	return out, nil
+}
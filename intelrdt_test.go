@@ -0,0 +1,131 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"testing"
+	"unsafe"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+func TestWithIntelRdt(t *testing.T) {
+	sp := &specs.Spec{}
+	WithIntelRdt("gold", "L3:0=ff", "MB:0=50")(sp)
+	WithIntelRdtMonitoring()(sp)
+	rdt := sp.Linux.IntelRdt
+	if rdt.ClosID != "gold" || rdt.L3CacheSchema != "L3:0=ff" || rdt.MemBwSchema != "MB:0=50" {
+		t.Errorf("intelRdt = %+v", rdt)
+	}
+	if !rdt.EnableCMT || !rdt.EnableMBM {
+		t.Errorf("monitoring not enabled: %+v", rdt)
+	}
+
+	spec, err := NewSpec(false, WithIntelRdt("", "L3:0=f", ""), WithIntelRdtMonitoring())
+	if !resctrlMounted() {
+		if !errors.Is(err, ErrInvalidContainerSpec) {
+			t.Errorf("NewSpec without resctrl = %v, want ErrInvalidContainerSpec", err)
+		}
+		return
+	}
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	spec.Close()
+}
+
+// fakeResctrl points resctrlRoot at a temp dir and gives the container
+// whose config is rewritten an intelRdt section.
+func fakeResctrl(t *testing.T, rc *RuntimeContext, id, intelRdt string) string {
+	t.Helper()
+	root := t.TempDir()
+	old := resctrlRoot
+	resctrlRoot = root
+	t.Cleanup(func() { resctrlRoot = old })
+
+	config := `{"ociVersion":"1.0.0","root":{"path":"/rootfs"},"process":{"cwd":"/","args":["sh"]},` +
+		`"linux":{"intelRdt":` + intelRdt + `}}`
+	stateRoot := goStringAt(unsafe.Pointer(rc.c.state_root))
+	if err := os.WriteFile(filepath.Join(stateRoot, id, "config.json"), []byte(config), 0o600); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+	return root
+}
+
+func writeMonData(t *testing.T, dir string, files map[string]string) {
+	t.Helper()
+	for name, content := range files {
+		p := filepath.Join(dir, "mon_data", name)
+		if err := os.MkdirAll(filepath.Dir(p), 0o755); err != nil {
+			t.Fatalf("MkdirAll failed: %v", err)
+		}
+		if err := os.WriteFile(p, []byte(content), 0o644); err != nil {
+			t.Fatalf("WriteFile failed: %v", err)
+		}
+	}
+}
+
+func TestIntelRdtStatsMonitoringGroup(t *testing.T) {
+	rc := fakeStateRoot(t, "c1")
+	root := fakeResctrl(t, rc, "c1", `{"closID":"gold","enableMonitoring":true}`)
+	writeMonData(t, filepath.Join(root, "gold", "mon_groups", "c1"), map[string]string{
+		"mon_L3_01/llc_occupancy":   "2048\n",
+		"mon_L3_01/mbm_total_bytes": "Unavailable\n",
+		"mon_L3_00/llc_occupancy":   "1024\n",
+		"mon_L3_00/mbm_total_bytes": "4096\n",
+		"mon_L3_00/mbm_local_bytes": "512\n",
+	})
+
+	got, err := rc.Get("c1").IntelRdtStats()
+	if err != nil {
+		t.Fatalf("IntelRdtStats failed: %v", err)
+	}
+	want := []IntelRdtDomainStats{
+		{Domain: 0, LLCOccupancy: 1024, MBMTotalBytes: 4096, MBMLocalBytes: 512},
+		{Domain: 1, LLCOccupancy: 2048},
+	}
+	if len(got) != len(want) {
+		t.Fatalf("got %+v, want %+v", got, want)
+	}
+	for i := range want {
+		if got[i] != want[i] {
+			t.Errorf("domain %d = %+v, want %+v", i, got[i], want[i])
+		}
+	}
+}
+
+func TestIntelRdtStatsPrivateGroup(t *testing.T) {
+	rc := fakeStateRoot(t, "c1")
+	root := fakeResctrl(t, rc, "c1", `{"l3CacheSchema":"L3:0=f"}`)
+	writeMonData(t, filepath.Join(root, "c1"), map[string]string{
+		"mon_L3_00/llc_occupancy": "64\n",
+	})
+
+	got, err := rc.Get("c1").IntelRdtStats()
+	if err != nil {
+		t.Fatalf("IntelRdtStats failed: %v", err)
+	}
+	if len(got) != 1 || got[0].LLCOccupancy != 64 {
+		t.Errorf("got %+v", got)
+	}
+}
+
+func TestIntelRdtStatsErrors(t *testing.T) {
+	rc := fakeStateRoot(t, "plain", "shared")
+	if _, err := rc.Get("plain").IntelRdtStats(); err == nil {
+		t.Error("IntelRdtStats without intelRdt succeeded")
+	}
+	fakeResctrl(t, rc, "shared", `{"closID":"gold"}`)
+	if _, err := rc.Get("shared").IntelRdtStats(); err == nil {
+		t.Error("IntelRdtStats of a shared CLOS without monitoring succeeded")
+	}
+	if _, err := rc.Get("missing").IntelRdtStats(); err == nil {
+		t.Error("IntelRdtStats of a missing container succeeded")
+	}
+	if err := rc.Get("missing").UpdateIntelRdt(IntelRdtUpdate{L3CacheSchema: "L3:0=f"}); err == nil {
+		t.Error("UpdateIntelRdt of a missing container succeeded")
+	}
+}
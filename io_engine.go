@@ -0,0 +1,331 @@
+//go:build linux
+
+package crun
+
+import (
+	"encoding/binary"
+	"errors"
+	"io"
+	"os"
+	"sync"
+	"sync/atomic"
+	"syscall"
+)
+
+// IOEngineOptions configures NewIOEngine.
+type IOEngineOptions struct {
+	// Loops is the number of event loops, each on a thread of its own
+	// while it waits. 0 selects 1.
+	Loops int
+	// BufferSize is the size of the read buffer of each loop, shared by
+	// all the streams of the loop. 0 selects 64 KiB.
+	BufferSize int
+}
+
+const (
+	defaultIOEngineBuffer = 64 * 1024
+	// reads of one stream per wakeup before the loop serves the others
+	ioEngineReadsPerWake = 16
+	// syscall.EPOLLET is negative, which EpollEvent.Events cannot hold
+	epollET = 1 << 31
+)
+
+// IOEngine serves the stdout, stderr and log pipes of many containers from
+// a few event loops (epoll, edge-triggered, non-blocking reads into a
+// buffer per loop) instead of a goroutine and a buffer per stream, so
+// that memory and scheduling overhead do not grow with every container.
+// Set IOConfig.Engine to use it:
+//
+//	engine, err := crun.NewIOEngine(crun.IOEngineOptions{Loops: 2})
+//	...
+//	defer engine.Close()
+//	result, err := rc.RunWithIO(id, spec, &crun.IOConfig{Stdout: out, Engine: engine})
+//
+// The loops call the writers of IOConfig.Stdout and Stderr, and log
+// handlers, themselves: those must not block, or they stall every stream
+// of their loop.
+type IOEngine struct {
+	loops []*ioLoop
+	next  atomic.Uint32
+}
+
+// NewIOEngine starts the event loops.
+func NewIOEngine(o IOEngineOptions) (*IOEngine, error) {
+	if o.Loops <= 0 {
+		o.Loops = 1
+	}
+	if o.BufferSize <= 0 {
+		o.BufferSize = defaultIOEngineBuffer
+	}
+	e := &IOEngine{}
+	for i := 0; i < o.Loops; i++ {
+		l, err := newIOLoop(o.BufferSize)
+		if err != nil {
+			e.Close()
+			return nil, err
+		}
+		e.loops = append(e.loops, l)
+	}
+	return e, nil
+}
+
+// Close stops the loops. Streams still open are closed, which the
+// containers writing them see as a broken pipe. Close is idempotent.
+func (e *IOEngine) Close() error {
+	for _, l := range e.loops {
+		l.stop()
+	}
+	return nil
+}
+
+// Streams returns the number of pipes the engine serves.
+func (e *IOEngine) Streams() int {
+	n := 0
+	for _, l := range e.loops {
+		l.mu.Lock()
+		n += len(l.streams)
+		l.mu.Unlock()
+	}
+	return n
+}
+
+// addOutput hands f, the read end of an output pipe, to a loop that
+// copies it to dst until EOF, then closes f and calls done. It fails
+// (leaving f alone) once the engine is closed.
+func (e *IOEngine) addOutput(f *os.File, dst io.Writer, bytes, full *atomic.Int64, done func()) error {
+	return e.add(&ioStream{file: f, dst: dst, bytes: bytes, full: full, done: done})
+}
+
+// addLog is addOutput for the log pipe, whose records go to handler.
+func (e *IOEngine) addLog(f *os.File, id string, handler LogHandler, done func()) error {
+	return e.add(&ioStream{file: f, log: &logDecoder{id: id, handler: handler}, done: done})
+}
+
+func (e *IOEngine) add(s *ioStream) error {
+	l := e.loops[int(e.next.Add(1))%len(e.loops)]
+	return l.add(s)
+}
+
+// ioStream is a pipe served by a loop.
+type ioStream struct {
+	file        *os.File
+	fd          int
+	dst         io.Writer
+	log         *logDecoder
+	bytes, full *atomic.Int64
+	capacity    int // of the pipe, when probing for full
+	done        func()
+	finished    bool
+}
+
+type ioLoop struct {
+	epfd         int
+	wakeR, wakeW int
+	buf          []byte
+
+	mu      sync.Mutex
+	streams map[int32]*ioStream
+	closed  bool
+	stopped chan struct{}
+}
+
+func newIOLoop(bufSize int) (*ioLoop, error) {
+	epfd, err := syscall.EpollCreate1(syscall.EPOLL_CLOEXEC)
+	if err != nil {
+		return nil, os.NewSyscallError("epoll_create1", err)
+	}
+	var p [2]int
+	if err := syscall.Pipe2(p[:], syscall.O_NONBLOCK|syscall.O_CLOEXEC); err != nil {
+		syscall.Close(epfd)
+		return nil, os.NewSyscallError("pipe2", err)
+	}
+	l := &ioLoop{
+		epfd: epfd, wakeR: p[0], wakeW: p[1],
+		buf:     make([]byte, bufSize),
+		streams: map[int32]*ioStream{},
+		stopped: make(chan struct{}),
+	}
+	ev := syscall.EpollEvent{Events: syscall.EPOLLIN, Fd: int32(l.wakeR)}
+	if err := syscall.EpollCtl(epfd, syscall.EPOLL_CTL_ADD, l.wakeR, &ev); err != nil {
+		l.closeFds()
+		return nil, os.NewSyscallError("epoll_ctl", err)
+	}
+	go l.run()
+	return l, nil
+}
+
+func (l *ioLoop) add(s *ioStream) error {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	if l.closed {
+		return errors.New("libcrun: I/O engine closed")
+	}
+	// The loop reads the descriptor directly, in non-blocking mode; it
+	// stays valid until finish closes the file. (Fd would switch the
+	// file, which may be shared, to blocking mode.)
+	rc, err := s.file.SyscallConn()
+	if err != nil {
+		return err
+	}
+	_ = rc.Control(func(fd uintptr) { s.fd = int(fd) })
+	if err := syscall.SetNonblock(s.fd, true); err != nil {
+		return os.NewSyscallError("fcntl", err)
+	}
+	if s.full != nil {
+		s.capacity = fdPipeSize(uintptr(s.fd))
+	}
+	l.streams[int32(s.fd)] = s
+	// Registering a descriptor that is already readable reports it, so
+	// nothing written before this point is missed.
+	ev := syscall.EpollEvent{Events: syscall.EPOLLIN | syscall.EPOLLRDHUP | epollET, Fd: int32(s.fd)}
+	if err := syscall.EpollCtl(l.epfd, syscall.EPOLL_CTL_ADD, s.fd, &ev); err != nil {
+		delete(l.streams, int32(s.fd))
+		return os.NewSyscallError("epoll_ctl", err)
+	}
+	return nil
+}
+
+func (l *ioLoop) run() {
+	defer close(l.stopped)
+	events := make([]syscall.EpollEvent, 128)
+	var ready, again []*ioStream
+	for {
+		timeout := -1
+		if len(again) > 0 {
+			timeout = 0 // streams left readable: poll, then serve them
+		}
+		n, err := syscall.EpollWait(l.epfd, events, timeout)
+		if err != nil && err != syscall.EINTR {
+			n = 0
+			l.mu.Lock()
+			l.closed = true
+			l.mu.Unlock()
+		}
+		ready = append(ready[:0], again...)
+		again = again[:0]
+		l.mu.Lock()
+		for _, ev := range events[:max(n, 0)] {
+			if ev.Fd == int32(l.wakeR) {
+				continue
+			}
+			if s := l.streams[ev.Fd]; s != nil {
+				ready = append(ready, s)
+			}
+		}
+		closed := l.closed
+		l.mu.Unlock()
+		if closed {
+			l.shutdown()
+			return
+		}
+		for _, s := range ready {
+			if !s.finished && l.serve(s) {
+				again = append(again, s)
+			}
+		}
+		clear(ready)
+	}
+}
+
+// serve reads s until it would block, and reports whether it is still
+// readable after its share of reads.
+func (l *ioLoop) serve(s *ioStream) bool {
+	for i := 0; i < ioEngineReadsPerWake; i++ {
+		if s.capacity > 0 && fdQueued(uintptr(s.fd)) >= s.capacity {
+			s.full.Add(1)
+		}
+		n, err := syscall.Read(s.fd, l.buf)
+		if n > 0 {
+			if s.bytes != nil {
+				s.bytes.Add(int64(n))
+			}
+			if s.log != nil {
+				s.log.feed(l.buf[:n])
+			} else if _, werr := s.dst.Write(l.buf[:n]); werr != nil {
+				l.finish(s)
+				return false
+			}
+			continue
+		}
+		switch err {
+		case syscall.EAGAIN:
+			return false
+		case syscall.EINTR:
+			continue
+		}
+		l.finish(s) // EOF or error
+		return false
+	}
+	return true
+}
+
+func (l *ioLoop) finish(s *ioStream) {
+	l.mu.Lock()
+	delete(l.streams, int32(s.fd))
+	l.mu.Unlock()
+	_ = syscall.EpollCtl(l.epfd, syscall.EPOLL_CTL_DEL, s.fd, nil)
+	s.finished = true
+	s.file.Close()
+	s.done()
+}
+
+func (l *ioLoop) stop() {
+	l.mu.Lock()
+	if !l.closed {
+		l.closed = true
+		_, _ = syscall.Write(l.wakeW, []byte{0})
+	}
+	l.mu.Unlock()
+	<-l.stopped
+}
+
+// shutdown finishes the streams still registered and releases the loop.
+func (l *ioLoop) shutdown() {
+	l.mu.Lock()
+	streams := make([]*ioStream, 0, len(l.streams))
+	for _, s := range l.streams {
+		streams = append(streams, s)
+	}
+	l.mu.Unlock()
+	for _, s := range streams {
+		l.finish(s)
+	}
+	l.closeFds()
+}
+
+func (l *ioLoop) closeFds() {
+	syscall.Close(l.wakeR)
+	syscall.Close(l.wakeW)
+	syscall.Close(l.epfd)
+}
+
+// logDecoder is readLogPipe for data pushed by a loop: it decodes the
+// records of the log pipe, keeping an incomplete one until the rest
+// arrives.
+type logDecoder struct {
+	id      string
+	handler LogHandler
+	pending []byte
+}
+
+func (d *logDecoder) feed(p []byte) {
+	if len(d.pending) > 0 {
+		d.pending = append(d.pending, p...)
+		p = d.pending
+	}
+	for len(p) >= 12 {
+		// Header: errno, verbosity, message length (little endian)
+		msgLen := int(binary.LittleEndian.Uint32(p[8:12]))
+		if len(p) < 12+msgLen {
+			break
+		}
+		d.handler(LogEntry{
+			Errno:       int(int32(binary.LittleEndian.Uint32(p[0:4]))),
+			Message:     string(p[12 : 12+msgLen]),
+			Verbosity:   int(int32(binary.LittleEndian.Uint32(p[4:8]))),
+			ContainerID: d.id,
+		})
+		p = p[12+msgLen:]
+	}
+	d.pending = append(d.pending[:0], p...)
+}
@@ -0,0 +1,155 @@
+//go:build linux
+
+package crun
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"syscall"
+	"testing"
+	"time"
+)
+
+func newTestIOEngine(t *testing.T, o IOEngineOptions) *IOEngine {
+	t.Helper()
+	e, err := NewIOEngine(o)
+	if err != nil {
+		t.Fatalf("NewIOEngine failed: %v", err)
+	}
+	t.Cleanup(func() { e.Close() })
+	return e
+}
+
+func TestIOEngineCopiesOutputs(t *testing.T) {
+	e := newTestIOEngine(t, IOEngineOptions{Loops: 2, BufferSize: 4096})
+	const streams = 50
+	var wg sync.WaitGroup
+	outs := make([]bytes.Buffer, streams)
+	counts := make([]atomic.Int64, streams)
+	payload := func(i int) string { return strings.Repeat("stream "+strconv.Itoa(i)+"\n", 2000) }
+	for i := 0; i < streams; i++ {
+		r, w, err := os.Pipe()
+		if err != nil {
+			t.Fatalf("Pipe failed: %v", err)
+		}
+		wg.Add(1)
+		if err := e.addOutput(r, &outs[i], &counts[i], nil, wg.Done); err != nil {
+			t.Fatalf("addOutput failed: %v", err)
+		}
+		go func(i int) {
+			defer w.Close()
+			p := payload(i)
+			for len(p) > 0 { // in pieces, so that the loops interleave
+				k := min(len(p), 1000)
+				w.WriteString(p[:k])
+				p = p[k:]
+			}
+		}(i)
+	}
+	wg.Wait()
+	for i := range outs {
+		if want := payload(i); outs[i].String() != want || counts[i].Load() != int64(len(want)) {
+			t.Errorf("stream %d: copied %d bytes (counted %d), want %d", i, outs[i].Len(), counts[i].Load(), len(want))
+		}
+	}
+	if n := e.Streams(); n != 0 {
+		t.Errorf("Streams = %d after EOF", n)
+	}
+}
+
+type failingWriter struct{}
+
+func (failingWriter) Write([]byte) (int, error) { return 0, errors.New("full") }
+
+func TestIOEngineStopsOnWriteError(t *testing.T) {
+	e := newTestIOEngine(t, IOEngineOptions{})
+	r, w, err := os.Pipe()
+	if err != nil {
+		t.Fatalf("Pipe failed: %v", err)
+	}
+	defer w.Close()
+	done := make(chan struct{})
+	if err := e.addOutput(r, failingWriter{}, nil, nil, func() { close(done) }); err != nil {
+		t.Fatalf("addOutput failed: %v", err)
+	}
+	w.WriteString("x")
+	<-done
+	if _, err := w.WriteString("y"); !errors.Is(err, syscall.EPIPE) {
+		t.Errorf("write after the stream ended = %v, want EPIPE", err)
+	}
+}
+
+func TestIOEngineClose(t *testing.T) {
+	e, err := NewIOEngine(IOEngineOptions{})
+	if err != nil {
+		t.Fatalf("NewIOEngine failed: %v", err)
+	}
+	r, w, err := os.Pipe()
+	if err != nil {
+		t.Fatalf("Pipe failed: %v", err)
+	}
+	defer w.Close()
+	var done atomic.Bool
+	if err := e.addOutput(r, &bytes.Buffer{}, nil, nil, func() { done.Store(true) }); err != nil {
+		t.Fatalf("addOutput failed: %v", err)
+	}
+	e.Close()
+	e.Close()
+	if !done.Load() {
+		t.Error("open stream not finished by Close")
+	}
+	r2, w2, _ := os.Pipe()
+	defer r2.Close()
+	defer w2.Close()
+	if err := e.addOutput(r2, &bytes.Buffer{}, nil, nil, func() {}); err == nil {
+		t.Error("addOutput after Close succeeded")
+	}
+}
+
+func logRecord(errno, verbosity int, msg string) []byte {
+	b := make([]byte, 12, 12+len(msg))
+	binary.LittleEndian.PutUint32(b[0:], uint32(errno))
+	binary.LittleEndian.PutUint32(b[4:], uint32(verbosity))
+	binary.LittleEndian.PutUint32(b[8:], uint32(len(msg)))
+	return append(b, msg...)
+}
+
+func TestIOEngineLog(t *testing.T) {
+	e := newTestIOEngine(t, IOEngineOptions{})
+	r, w, err := os.Pipe()
+	if err != nil {
+		t.Fatalf("Pipe failed: %v", err)
+	}
+	var entries []LogEntry
+	done := make(chan struct{})
+	if err := e.addLog(r, "ctr", func(le LogEntry) { entries = append(entries, le) }, func() { close(done) }); err != nil {
+		t.Fatalf("addLog failed: %v", err)
+	}
+	stream := append(logRecord(2, 1, "first"), logRecord(0, 0, strings.Repeat("m", 100000))...)
+	stream = append(stream, logRecord(0, 0, "truncated")[:15]...)
+	for len(stream) > 0 { // split records across reads
+		k := min(len(stream), 7)
+		w.Write(stream[:k])
+		stream = stream[k:]
+		if len(stream)%1000 == 0 {
+			time.Sleep(time.Millisecond)
+		}
+	}
+	w.Close()
+	<-done
+	if len(entries) != 2 {
+		t.Fatalf("got %d entries, want 2", len(entries))
+	}
+	if le := entries[0]; le.Errno != 2 || le.Verbosity != 1 || le.Message != "first" || le.ContainerID != "ctr" {
+		t.Errorf("entry = %+v", le)
+	}
+	if len(entries[1].Message) != 100000 {
+		t.Errorf("second message is %d bytes", len(entries[1].Message))
+	}
+}
@@ -0,0 +1,200 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"sync"
+)
+
+// ErrLauncherClosed is returned when running through a closed [Launcher].
+var ErrLauncherClosed = errors.New("libcrun: launcher is closed")
+
+// Launcher is a pool of pre-forked helper processes used by RunWithIO to
+// launch containers.
+//
+// RunWithIO normally forks the calling Go process, so every launch pays for
+// duplicating its page tables; with a large heap this dominates startup
+// latency. A helper is forked once, while the process is still small, and
+// clones container processes from its own tiny address space instead.
+// Launched containers are still direct children of the Go process.
+//
+// Create the launcher early (before the heap grows), share it between
+// goroutines, and Close it when done:
+//
+//	launcher, _ := crun.NewLauncher(4)
+//	defer launcher.Close()
+//
+//	result, _ := rc.RunWithIO("my-container", spec, &crun.IOConfig{
+//	    Stdout:   os.Stdout,
+//	    Launcher: launcher,
+//	})
+type Launcher struct {
+	idle chan *launcherProc
+	done chan struct{} // closed by Close
+
+	mu     sync.Mutex
+	closed bool
+	procs  map[*launcherProc]struct{}
+}
+
+// launcherProc is one helper process and the socket used to talk to it.
+type launcherProc struct {
+	sock C.int
+	pid  C.pid_t
+}
+
+// NewLauncher starts size helper processes. Each helper serves one launch at
+// a time; size therefore bounds the number of concurrent launches.
+func NewLauncher(size int) (*Launcher, error) {
+	if size <= 0 {
+		return nil, errors.New("libcrun: launcher size must be positive")
+	}
+	l := &Launcher{
+		idle:  make(chan *launcherProc, size),
+		done:  make(chan struct{}),
+		procs: make(map[*launcherProc]struct{}, size),
+	}
+	for i := 0; i < size; i++ {
+		p, err := startLauncherProc()
+		if err != nil {
+			l.Close()
+			return nil, err
+		}
+		l.procs[p] = struct{}{}
+		l.idle <- p
+	}
+	return l, nil
+}
+
+// Size returns the number of helper processes in the pool.
+func (l *Launcher) Size() int {
+	return cap(l.idle)
+}
+
+// Close stops all helper processes. Launches in progress complete first.
+// Containers already launched are not affected. Close is idempotent.
+func (l *Launcher) Close() error {
+	l.mu.Lock()
+	if l.closed {
+		l.mu.Unlock()
+		return nil
+	}
+	l.closed = true
+	close(l.done)
+	l.mu.Unlock()
+
+	// Collect every helper as it becomes idle, waiting for busy ones.
+	for {
+		l.mu.Lock()
+		n := len(l.procs)
+		l.mu.Unlock()
+		if n == 0 {
+			return nil
+		}
+		p := <-l.idle
+		if p == nil {
+			continue
+		}
+		l.mu.Lock()
+		delete(l.procs, p)
+		l.mu.Unlock()
+		p.stop()
+	}
+}
+
+func startLauncherProc() (*launcherProc, error) {
+	var cerr C.libcrun_error_t
+	p := &launcherProc{sock: -1}
+	if C.go_crun_launcher_start(&p.sock, &p.pid, &cerr) < 0 {
+		return nil, fromLibcrunErr(&cerr)
+	}
+	return p, nil
+}
+
+func (p *launcherProc) stop() {
+	C.go_crun_launcher_stop(p.sock, p.pid)
+}
+
+// acquire takes an idle helper, waiting for one, or returns
+// ErrLauncherClosed once Close was called. It may return nil, for a slot
+// whose helper could not be replaced.
+func (l *Launcher) acquire() (*launcherProc, error) {
+	select {
+	case <-l.done:
+		return nil, ErrLauncherClosed
+	case p := <-l.idle:
+		select {
+		case <-l.done:
+			// Close collects it
+			l.idle <- p
+			return nil, ErrLauncherClosed
+		default:
+			return p, nil
+		}
+	}
+}
+
+// startSlot starts and registers a helper for an empty slot, unless the
+// launcher is closed. l.mu is held across the start so that Close, which
+// collects the registered helpers, cannot miss it.
+func (l *Launcher) startSlot() (*launcherProc, error) {
+	l.mu.Lock()
+	defer l.mu.Unlock()
+	if l.closed {
+		return nil, ErrLauncherClosed
+	}
+	p, err := startLauncherProc()
+	if err != nil {
+		return nil, err
+	}
+	l.procs[p] = struct{}{}
+	return p, nil
+}
+
+// release returns p to the pool. A broken helper is replaced by a fresh one
+// so the pool keeps its size.
+func (l *Launcher) release(p *launcherProc, broken bool) {
+	if broken {
+		l.mu.Lock()
+		delete(l.procs, p)
+		l.mu.Unlock()
+		p.stop()
+
+		// On failure, keep the slot usable: a nil entry is refilled on next
+		// use.
+		p, _ = l.startSlot()
+	}
+	l.idle <- p
+}
+
+// run launches the container through one of the helpers. The fds follow the
+// go_crun_run_with_pipes conventions.
+func (l *Launcher) run(ctx *C.libcrun_context_t, spec *ContainerSpec, ov *C.struct_go_crun_overrides, flags C.uint,
+	stdinFd, stdoutFd, stderrFd, logFd C.int) (C.pid_t, error) {
+	p, err := l.acquire()
+	if err != nil {
+		return 0, err
+	}
+	if p == nil {
+		if p, err = l.startSlot(); err != nil {
+			l.idle <- nil
+			return 0, err
+		}
+	}
+
+	var childPid C.pid_t
+	var broken C.int
+	var cerr C.libcrun_error_t
+	rc := C.go_crun_launcher_run(p.sock, ctx, spec.c, ov, flags,
+		stdinFd, stdoutFd, stderrFd, logFd, &childPid, &broken, &cerr)
+	l.release(p, broken != 0)
+	if rc < 0 {
+		return 0, fromLibcrunErr(&cerr)
+	}
+	return childPid, nil
+}
@@ -0,0 +1,110 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"errors"
+	"testing"
+	"time"
+)
+
+func TestNewLauncherInvalidSize(t *testing.T) {
+	for _, size := range []int{0, -1} {
+		if _, err := NewLauncher(size); err == nil {
+			t.Errorf("NewLauncher(%d) should fail", size)
+		}
+	}
+}
+
+func TestLauncherStartClose(t *testing.T) {
+	l, err := NewLauncher(2)
+	if err != nil {
+		t.Fatalf("NewLauncher failed: %v", err)
+	}
+	if l.Size() != 2 {
+		t.Errorf("Size() = %d, want 2", l.Size())
+	}
+
+	if err := l.Close(); err != nil {
+		t.Fatalf("Close failed: %v", err)
+	}
+	// Close is idempotent
+	if err := l.Close(); err != nil {
+		t.Fatalf("second Close failed: %v", err)
+	}
+
+	if _, err := l.acquire(); !errors.Is(err, ErrLauncherClosed) {
+		t.Errorf("acquire after Close = %v, want ErrLauncherClosed", err)
+	}
+}
+
+func TestLauncherReplacesBrokenHelper(t *testing.T) {
+	l, err := NewLauncher(1)
+	if err != nil {
+		t.Fatalf("NewLauncher failed: %v", err)
+	}
+	defer l.Close()
+
+	p, err := l.acquire()
+	if err != nil {
+		t.Fatalf("acquire failed: %v", err)
+	}
+	l.release(p, true)
+
+	np, err := l.acquire()
+	if err != nil {
+		t.Fatalf("acquire failed: %v", err)
+	}
+	if np == nil || np == p {
+		t.Error("broken helper was not replaced")
+	}
+	l.release(np, false)
+}
+
+func TestLauncherCloseUnblocksAcquire(t *testing.T) {
+	l, err := NewLauncher(1)
+	if err != nil {
+		t.Fatalf("NewLauncher failed: %v", err)
+	}
+	p, err := l.acquire()
+	if err != nil {
+		t.Fatalf("acquire failed: %v", err)
+	}
+
+	acquired := make(chan error, 1)
+	go func() {
+		_, err := l.acquire()
+		acquired <- err
+	}()
+	closed := make(chan struct{})
+	go func() {
+		l.Close()
+		close(closed)
+	}()
+	// The waiting acquire fails while Close still waits for the busy helper
+	select {
+	case err := <-acquired:
+		if !errors.Is(err, ErrLauncherClosed) {
+			t.Errorf("acquire = %v, want %v", err, ErrLauncherClosed)
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("acquire still blocked after Close")
+	}
+
+	// A helper broken after Close is not replaced
+	l.release(p, true)
+	select {
+	case <-closed:
+	case <-time.After(5 * time.Second):
+		t.Fatal("Close did not return")
+	}
+	l.mu.Lock()
+	n := len(l.procs)
+	l.mu.Unlock()
+	if n != 0 {
+		t.Errorf("%d helpers left after Close", n)
+	}
+	if _, err := l.startSlot(); !errors.Is(err, ErrLauncherClosed) {
+		t.Errorf("startSlot after Close = %v, want %v", err, ErrLauncherClosed)
+	}
+}
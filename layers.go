@@ -0,0 +1,163 @@
+//go:build linux
+
+package crun
+
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"strings"
+	"syscall"
+)
+
+// LayerStore is a content-addressed cache of extracted image layers. Each
+// layer is unpacked once, into <root>/<algorithm>/<hex> of its digest, and
+// is then shared read-only by every rootfs assembled from it with
+// NewOverlayRootfs, so a warm start does not depend on the image size.
+//
+// Layers must be extracted for overlayfs: whiteouts as 0:0 character
+// devices and opaque directories with the trusted.overlay.opaque xattr.
+type LayerStore struct {
+	root string
+}
+
+// NewLayerStore opens (creating it if needed) the layer store at root.
+func NewLayerStore(root string) (*LayerStore, error) {
+	if err := os.MkdirAll(root, 0o700); err != nil {
+		return nil, err
+	}
+	return &LayerStore{root: root}, nil
+}
+
+// Path returns the directory of the layer with the given digest, such as
+// "sha256:<hex>" (the layer's DiffID), whether or not it is cached.
+func (s *LayerStore) Path(digest string) (string, error) {
+	algo, hex, ok := strings.Cut(digest, ":")
+	if !ok || !validDigestPart(algo, "abcdefghijklmnopqrstuvwxyz0123456789") || len(hex) < 32 ||
+		!validDigestPart(hex, "abcdef0123456789") {
+		return "", errors.New("libcrun: invalid layer digest " + digest)
+	}
+	return filepath.Join(s.root, algo, hex), nil
+}
+
+func validDigestPart(s, chars string) bool {
+	if s == "" {
+		return false
+	}
+	for i := 0; i < len(s); i++ {
+		if strings.IndexByte(chars, s[i]) < 0 {
+			return false
+		}
+	}
+	return true
+}
+
+// Has reports whether the layer is cached.
+func (s *LayerStore) Has(digest string) bool {
+	p, err := s.Path(digest)
+	if err != nil {
+		return false
+	}
+	_, err = os.Stat(p)
+	return err == nil
+}
+
+// Ensure returns the directory of the layer, calling extract to unpack it
+// into an empty staging directory if it is not cached yet. The staging
+// directory is renamed into place only once extract succeeds, so a failed
+// or concurrent extraction never leaves a partial layer behind.
+func (s *LayerStore) Ensure(digest string, extract func(dir string) error) (string, error) {
+	dst, err := s.Path(digest)
+	if err != nil {
+		return "", err
+	}
+	if _, err := os.Stat(dst); err == nil {
+		return dst, nil
+	}
+	if err := os.MkdirAll(filepath.Dir(dst), 0o700); err != nil {
+		return "", err
+	}
+	tmp, err := os.MkdirTemp(filepath.Dir(dst), ".extract-")
+	if err != nil {
+		return "", err
+	}
+	if err = os.Chmod(tmp, 0o755); err == nil {
+		err = extract(tmp)
+	}
+	if err == nil {
+		err = os.Rename(tmp, dst)
+	}
+	if err != nil {
+		os.RemoveAll(tmp)
+		if _, serr := os.Stat(dst); serr == nil {
+			return dst, nil // extracted concurrently
+		}
+		return "", err
+	}
+	return dst, nil
+}
+
+// Remove deletes a cached layer. It must not be in use by a rootfs.
+func (s *LayerStore) Remove(digest string) error {
+	p, err := s.Path(digest)
+	if err != nil {
+		return err
+	}
+	return os.RemoveAll(p)
+}
+
+// OverlayRootfs is a container rootfs mounted as an overlayfs of read-only
+// layers, with the container's changes in a private upper directory. Pass
+// Path to WithRootPath.
+type OverlayRootfs struct {
+	Path string // mount point of the merged tree
+	dir  string
+}
+
+// NewOverlayRootfs mounts layers (bottom first, e.g. LayerStore
+// directories) at dir/rootfs, with dir/upper and dir/work beside it.
+// Close unmounts it and removes dir.
+func NewOverlayRootfs(dir string, layers ...string) (*OverlayRootfs, error) {
+	if len(layers) == 0 {
+		return nil, errors.New("libcrun: overlay rootfs needs at least one layer")
+	}
+	o := &OverlayRootfs{Path: filepath.Join(dir, "rootfs"), dir: dir}
+	upper, work := filepath.Join(dir, "upper"), filepath.Join(dir, "work")
+	for _, d := range []string{o.Path, upper, work} {
+		if err := os.MkdirAll(d, 0o755); err != nil {
+			return nil, err
+		}
+	}
+	data := strings.Join(OverlayMountOptions(layers, upper, work), ",")
+	if err := syscall.Mount("overlay", o.Path, "overlay", 0, data); err != nil {
+		for _, d := range []string{o.Path, upper, work} {
+			os.RemoveAll(d)
+		}
+		return nil, &os.PathError{Op: "mount overlay", Path: o.Path, Err: err}
+	}
+	return o, nil
+}
+
+// Close unmounts the rootfs and removes its directory, upper included.
+func (o *OverlayRootfs) Close() error {
+	if err := syscall.Unmount(o.Path, 0); err != nil && err != syscall.EINVAL {
+		return &os.PathError{Op: "unmount", Path: o.Path, Err: err}
+	}
+	return os.RemoveAll(o.dir)
+}
+
+// OverlayMountOptions returns the options of an overlay mount of layers
+// (bottom first) with the given upper and work directories, e.g. for
+// WithMount("overlay", dest, "overlay", opts) to assemble a volume inside
+// the container. Without upper and work the mount is read-only.
+func OverlayMountOptions(layers []string, upper, work string) []string {
+	lower := make([]string, len(layers))
+	for i, l := range layers {
+		lower[len(layers)-1-i] = l // overlayfs lists the top layer first
+	}
+	opts := []string{"lowerdir=" + strings.Join(lower, ":")}
+	if upper != "" && work != "" {
+		opts = append(opts, "upperdir="+upper, "workdir="+work)
+	}
+	return opts
+}
@@ -0,0 +1,124 @@
+//go:build linux
+
+package crun
+
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+)
+
+const testDigest = "sha256:0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+
+func TestLayerStorePath(t *testing.T) {
+	s, err := NewLayerStore(t.TempDir())
+	if err != nil {
+		t.Fatalf("NewLayerStore failed: %v", err)
+	}
+	p, err := s.Path(testDigest)
+	if err != nil || !strings.HasSuffix(p, "/sha256/0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef") {
+		t.Errorf("Path = %q, %v", p, err)
+	}
+	for _, d := range []string{"", "sha256", "sha256:", "sha256:../../etc", "SHA256:0123456789abcdef0123456789abcdef", "sha256:0123"} {
+		if _, err := s.Path(d); err == nil {
+			t.Errorf("Path(%q) succeeded", d)
+		}
+	}
+}
+
+func TestLayerStoreEnsure(t *testing.T) {
+	s, err := NewLayerStore(t.TempDir())
+	if err != nil {
+		t.Fatalf("NewLayerStore failed: %v", err)
+	}
+	if _, err := s.Ensure(testDigest, func(dir string) error {
+		os.WriteFile(filepath.Join(dir, "partial"), nil, 0o644)
+		return errors.New("truncated layer")
+	}); err == nil {
+		t.Fatal("Ensure with a failing extract succeeded")
+	}
+	if s.Has(testDigest) {
+		t.Fatal("failed extraction left a layer behind")
+	}
+
+	var calls atomic.Int32
+	var wg sync.WaitGroup
+	paths := make([]string, 4)
+	for i := range paths {
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			paths[i], _ = s.Ensure(testDigest, func(dir string) error {
+				calls.Add(1)
+				return os.WriteFile(filepath.Join(dir, "file"), []byte("x"), 0o644)
+			})
+		}(i)
+	}
+	wg.Wait()
+	for _, p := range paths {
+		if p == "" || p != paths[0] {
+			t.Fatalf("Ensure paths = %v", paths)
+		}
+	}
+	if _, err := os.Stat(filepath.Join(paths[0], "file")); err != nil {
+		t.Errorf("layer content missing: %v", err)
+	}
+	n := calls.Load()
+	if _, err := s.Ensure(testDigest, func(string) error { calls.Add(1); return nil }); err != nil || calls.Load() != n {
+		t.Errorf("cached Ensure extracted again (err %v)", err)
+	}
+	if err := s.Remove(testDigest); err != nil || s.Has(testDigest) {
+		t.Errorf("Remove = %v, Has = %v", err, s.Has(testDigest))
+	}
+}
+
+func TestOverlayMountOptions(t *testing.T) {
+	got := OverlayMountOptions([]string{"/l/base", "/l/app"}, "/c/upper", "/c/work")
+	want := []string{"lowerdir=/l/app:/l/base", "upperdir=/c/upper", "workdir=/c/work"}
+	if strings.Join(got, ",") != strings.Join(want, ",") {
+		t.Errorf("OverlayMountOptions = %v, want %v", got, want)
+	}
+	if got := OverlayMountOptions([]string{"/l/a"}, "", ""); len(got) != 1 {
+		t.Errorf("read-only OverlayMountOptions = %v", got)
+	}
+}
+
+func TestOverlayRootfs(t *testing.T) {
+	root := t.TempDir()
+	base, app := filepath.Join(root, "base"), filepath.Join(root, "app")
+	for _, f := range []struct{ dir, name, data string }{
+		{base, "etc/os-release", "base"},
+		{base, "bin/sh", "sh"},
+		{app, "etc/os-release", "app"},
+	} {
+		os.MkdirAll(filepath.Join(f.dir, filepath.Dir(f.name)), 0o755)
+		os.WriteFile(filepath.Join(f.dir, f.name), []byte(f.data), 0o644)
+	}
+
+	o, err := NewOverlayRootfs(filepath.Join(root, "ctr"), base, app)
+	if err != nil {
+		if errors.Is(err, os.ErrPermission) {
+			t.Skip("overlay mounts need CAP_SYS_ADMIN")
+		}
+		t.Fatalf("NewOverlayRootfs failed: %v", err)
+	}
+	if b, _ := os.ReadFile(filepath.Join(o.Path, "etc/os-release")); string(b) != "app" {
+		t.Errorf("top layer not on top: os-release = %q", b)
+	}
+	if err := os.WriteFile(filepath.Join(o.Path, "bin/sh"), []byte("changed"), 0o644); err != nil {
+		t.Fatalf("write through overlay failed: %v", err)
+	}
+	if b, _ := os.ReadFile(filepath.Join(base, "bin/sh")); string(b) != "sh" {
+		t.Errorf("write reached the cached layer: %q", b)
+	}
+	if err := o.Close(); err != nil {
+		t.Fatalf("Close failed: %v", err)
+	}
+	if _, err := os.Stat(filepath.Join(root, "ctr")); !os.IsNotExist(err) {
+		t.Errorf("Close left the rootfs directory: %v", err)
+	}
+}
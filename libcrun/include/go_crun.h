@@ -9,6 +9,7 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/resource.h>
 
 #include <libcrun/container.h>
 #include <libcrun/status.h>
@@ -19,14 +20,33 @@
 
 #include <ocispec/runtime_spec_schema_config_schema.h>
 
-// Error handling: convert libcrun error to C string
-char* go_crun_err_to_cstr(libcrun_error_t *err, int *status);
+// Error categories, numerically equal to the Go ErrorCode values
+#define GO_CRUN_ERR_UNKNOWN               0
+#define GO_CRUN_ERR_NOT_FOUND             1
+#define GO_CRUN_ERR_ALREADY_EXISTS        2
+#define GO_CRUN_ERR_INVALID_SPEC          3
+#define GO_CRUN_ERR_PERMISSION_DENIED     4
+#define GO_CRUN_ERR_CONTAINER_RUNNING     5
+#define GO_CRUN_ERR_CONTAINER_NOT_RUNNING 6
+
+// Error handling: category of a libcrun error message and errno
+int go_crun_err_category(const char *msg, int status);
+// Classify *err, then release it. The caller copies msg/status first.
+int go_crun_err_classify_release(libcrun_error_t *err);
+
+// Process-wide custom handler manager, set on every new context (NULL if
+// libcrun could not create it)
+struct custom_handler_manager_s *go_crun_handler_manager(void);
 
 // RuntimeContext allocation / free
 libcrun_context_t* go_crun_new_context(void);
 void go_crun_free_context(libcrun_context_t *ctx);
 
-// Container release (mirror Python binding: free container_def)
+// Per-operation shallow context clones (share the base strings, own the id)
+libcrun_context_t* go_crun_clone_context(libcrun_context_t *dst, const libcrun_context_t *base, const char *id);
+void go_crun_free_context_clone(libcrun_context_t *ctx);
+
+// Container release (libcrun_container_free)
 void go_crun_free_container(libcrun_container_t *ctr);
 
 // JSON sinks via open_memstream
@@ -37,8 +57,13 @@ char* go_crun_spec_json(bool rootless, int *out_len, libcrun_error_t *err);
 int go_crun_list(const char *state_root, char ***out, int *out_len, libcrun_error_t *err);
 void go_crun_free_strv(char **v, int n);
 
-// Exec with runtime process JSON
-int go_crun_exec_json(libcrun_context_t *ctx, const char *id, const char *json, libcrun_error_t *err);
+// Resolve the state root directory libcrun uses for state_root (NULL for
+// the default); *out is malloc'd
+int go_crun_state_dir(const char *state_root, char **out, libcrun_error_t *err);
+
+// Exec with runtime process JSON; cgroup (NULL = the container's) places
+// the process in a sub-cgroup of the container
+int go_crun_exec_json(libcrun_context_t *ctx, const char *id, const char *json, const char *cgroup, libcrun_error_t *err);
 
 // Pause/Unpause
 int go_crun_pause(libcrun_context_t *ctx, const char *id, libcrun_error_t *err);
@@ -50,20 +75,184 @@ int go_crun_killall(libcrun_context_t *ctx, const char *id, const char *signal,
 // Update container resources
 int go_crun_update(libcrun_context_t *ctx, const char *id, const char *content, size_t len, libcrun_error_t *err);
 
+// Update container resources from section/name/value triples, without JSON
+int go_crun_update_values(libcrun_context_t *ctx, const char *id, struct libcrun_update_value_s *values, size_t len,
+                          libcrun_error_t *err);
+
+// Batched go_crun_update_values: every item is updated in turn, a failing
+// item does not stop the others. With route_logs, the log id follows the
+// item being updated. Returns the number of failed items.
+struct go_crun_update_item {
+  const char *id;
+  struct libcrun_update_value_s *values;
+  size_t len;
+  libcrun_error_t err;
+};
+
+int go_crun_update_batch(libcrun_context_t *ctx, struct go_crun_update_item *items, int n, int route_logs);
+
+// Live update of the container's Intel RDT schemata (NULL = unchanged)
+int go_crun_update_intel_rdt(libcrun_context_t *ctx, const char *id, const char *l3_cache_schema,
+                             const char *mem_bw_schema, char *const *schemata, libcrun_error_t *err);
+
+// Reads the intelRdt section of the container's saved config: returns 1
+// with clos_id (malloc'd, NULL when unset) and whether monitoring is
+// enabled, 0 when the container has no intelRdt section, -1 on error
+int go_crun_intel_rdt_group(libcrun_context_t *ctx, const char *id, char **clos_id, int *monitoring,
+                            libcrun_error_t *err);
+
+// Features supported by this libcrun build
+int go_crun_get_features(struct features_info_s **out, libcrun_error_t *err);
+void go_crun_free_features(struct features_info_s *info);
+
+// Add (add != 0) or remove the mounts of a {"mounts": [...]} JSON document
+// in a running container, in one pass through its mount namespace
+int go_crun_update_mounts(libcrun_context_t *ctx, const char *id, const char *json, size_t len, int add,
+                          libcrun_error_t *err);
+
+// Create a network namespace and bind-mount it at path, an existing file,
+// from the calling thread, which moves back to its own namespace after.
+// Returns 1 if it could not: the thread must then not be reused.
+int go_crun_netns_new(const char *path, libcrun_error_t *err);
+
+// Compile the seccomp profile of container to BPF (*out, malloc'd), as
+// libcrun would at create; fail_unknown rejects unknown syscall names.
+int go_crun_seccomp_compile(libcrun_container_t *container, int fail_unknown, char **out, size_t *out_len,
+                            libcrun_error_t *err);
+
+// Reuse identical cgroup v2 device programs across containers instead of
+// loading each (off by default), see __wrap_libcrun_ebpf_load
+void go_crun_set_ebpf_reuse(int enabled);
+// Drop the cached device programs and remove their pins; -errno on failure
+int go_crun_ebpf_purge(void);
+
+// Assign container id of state_root (NULL for the default) the cgroup at
+// path, entered by its cgroupfs launches without linux.cgroupsPath and
+// kept when destroyed, see __wrap_libcrun_cgroup_enter; a NULL path drops
+// the assignment. Returns -1 when out of memory
+int go_crun_cgroup_pool_assign(const char *state_root, const char *id, const char *path);
+
+// C side of a Go Container handle: the id, and its status as last read
+// from state_root. cached is set while status.pid is known to be alive
+// with status.process_start_time, so that the go_crun_ref_* calls can skip
+// the status file; otherwise they read it again. With use_pidfd (handles
+// of containers this process started), go_crun_ref_kill signals through
+// pidfd, opened on first use (-1 until then).
+struct go_crun_container_ref {
+  char *id;
+  int cached;
+  libcrun_container_status_t status;
+  int use_pidfd;
+  int pidfd;
+};
+void go_crun_ref_invalidate(struct go_crun_container_ref *ref);
+void go_crun_ref_free(struct go_crun_container_ref *ref);
+int go_crun_ref_is_running(libcrun_context_t *ctx, struct go_crun_container_ref *ref, libcrun_error_t *err);
+int go_crun_ref_kill(libcrun_context_t *ctx, struct go_crun_container_ref *ref, const char *signal, libcrun_error_t *err);
+int go_crun_ref_read_pids(libcrun_context_t *ctx, struct go_crun_container_ref *ref, int recurse, pid_t **out_pids,
+                          int *out_len, libcrun_error_t *err);
+
+// Probes: the namespaces (-1 when shared with this process), root, cgroup
+// v2 directory and pidfd of a container's init, opened once, and the
+// stack of the clone that starts probe processes
+#define GO_CRUN_PROBE_NS 8
+#define GO_CRUN_PROBE_NS_NET 4
+struct go_crun_probe {
+  int ns_fd[GO_CRUN_PROBE_NS];
+  int root_fd;
+  int cgroup_fd;
+  int pidfd;
+  void *stack;
+};
+int go_crun_probe_open(libcrun_context_t *ctx, struct go_crun_container_ref *ref, struct go_crun_probe **out,
+                       libcrun_error_t *err);
+void go_crun_probe_free(struct go_crun_probe *p);
+int go_crun_probe_spawn(struct go_crun_probe *p, char *const argv[], int out_fd, pid_t *out_pid, libcrun_error_t *err);
+int go_crun_probe_socket(struct go_crun_probe *p, int family, int *tainted, libcrun_error_t *err);
+
 // Check if container is running
 int go_crun_is_running(const char *state_root, const char *id, libcrun_error_t *err);
+// Pid recorded in the status file of container id, running or not
+int go_crun_status_pid(const char *state_root, const char *id, pid_t *pid, libcrun_error_t *err);
+
+// Typed container state. status is a static string; bundle, created and
+// the annotations (borrowed from container) are only set with
+// GO_CRUN_STATE_DETAILS, cgroup_path with GO_CRUN_STATE_CGROUP.
+#define GO_CRUN_STATE_DETAILS 1
+#define GO_CRUN_STATE_CGROUP  2
+struct go_crun_state {
+  pid_t pid; // 0 unless running
+  const char *status;
+  char *bundle;
+  char *created;
+  char *cgroup_path;
+  char **annotation_keys;
+  char **annotation_values;
+  int annotations_len;
+  libcrun_container_t *container;
+  libcrun_error_t err; // set when go_crun_read_state fails
+};
+int go_crun_read_state(libcrun_context_t *ctx, const char *id, int flags, struct go_crun_state *out);
+void go_crun_free_state(struct go_crun_state *s);
+// go_crun_read_state without GO_CRUN_STATE_DETAILS, from the status
+// cached in ref
+int go_crun_ref_read_state(libcrun_context_t *ctx, struct go_crun_container_ref *ref, int flags,
+                           struct go_crun_state *out);
+
+// One container of the state root, as listed by go_crun_list_entries and
+// filled in by go_crun_read_list_states (status stays NULL on failure,
+// with err set)
+struct go_crun_list_entry {
+  char *id;
+  pid_t pid; // 0 unless running
+  const char *status;
+  char *bundle;
+  char *created;
+  libcrun_error_t err;
+};
+int go_crun_list_entries(const char *state_root, struct go_crun_list_entry **out, int *out_len, libcrun_error_t *err);
+// Reads the status of entries [from, to); ranges may be read concurrently
+void go_crun_read_list_states(const char *state_root, struct go_crun_list_entry *entries, int from, int to);
+void go_crun_free_list_entries(struct go_crun_list_entry *entries, int n);
 
 // Read PIDs
 int go_crun_read_pids(libcrun_context_t *ctx, const char *id, int recurse, pid_t **out_pids, int *out_len, libcrun_error_t *err);
 void go_crun_free_pids(pid_t *pids);
 
+// Per-run overrides of a parsed spec. NULL fields (and a NULL args/env
+// vector) keep the spec's value. Strings are copied when applied.
+struct go_crun_overrides {
+  char **args;
+  int args_len;
+  char **env;
+  int env_len;
+  const char *cwd;
+  const char *hostname;
+  const char *root_path;
+  int verbosity; // libcrun verbosity in the child, < 0 = inherit
+};
+
+// Apply overrides to container in place (spec tree and saved config JSON)
+int go_crun_apply_overrides(libcrun_container_t *container, const struct go_crun_overrides *ov, libcrun_error_t *err);
+
+// Sets linux.intelRdt.enableMonitoring on a loaded spec (no-op without an
+// intelRdt section); runtime-spec 1.2's enableCMT/enableMBM map onto it
+int go_crun_spec_enable_rdt_monitoring(libcrun_container_t *container, libcrun_error_t *err);
+
+// Sets linux.memoryPolicy and process.execCPUAffinity (runtime-spec 1.3,
+// JSON objects; NULL leaves one alone) on a loaded spec
+int go_crun_spec_set_placement(libcrun_container_t *container, const char *memory_policy, const char *exec_cpu_affinity,
+                               libcrun_error_t *err);
+
 // Run container with isolated I/O via fork
 // stdin_fd, stdout_fd, stderr_fd: pipe fds (-1 = use /dev/null for stdin, inherit for stdout/stderr)
 // log_fd: write end of log pipe (-1 = use stderr for logs)
 // out_pid: receives the forked child PID for later waitpid
+// overrides: applied in the child only (NULL = run the spec as is)
 int go_crun_run_with_pipes(
     libcrun_context_t *ctx,
     libcrun_container_t *container,
+    const struct go_crun_overrides *overrides,
     unsigned int flags,
     int stdin_fd,
     int stdout_fd,
@@ -73,8 +262,183 @@ int go_crun_run_with_pipes(
     libcrun_error_t *err
 );
 
-// Wait for forked container child process
-int go_crun_wait(pid_t pid, int *exit_code, libcrun_error_t *err);
+// Same as go_crun_run_with_pipes, but the child is started with posix_spawn
+// (re-executing the current binary) instead of fork, so the parent's page
+// tables are not duplicated
+int go_crun_spawn_with_pipes(
+    libcrun_context_t *ctx,
+    libcrun_container_t *container,
+    const struct go_crun_overrides *overrides,
+    unsigned int flags,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    libcrun_error_t *err
+);
+
+// Exec into a running container from a forked child with isolated I/O
+// (fds as for go_crun_run_with_pipes). The child runs the exec without
+// detaching and exits with the process' exit code; wait for it with
+// go_crun_wait or a pidfd. ov (NULL = none) replaces args, env and cwd of
+// the process and sets the child's verbosity.
+int go_crun_exec_with_pipes(
+    libcrun_context_t *ctx,
+    const char *id,
+    const char *process_json,
+    const struct go_crun_overrides *ov,
+    const char *cgroup,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    libcrun_error_t *err
+);
+
+// Prepared exec: a parsed process executed any number of times, against
+// any container. proc is never modified, so it may be used concurrently;
+// ov (NULL = none) replaces its args, env and cwd for one exec.
+runtime_spec_schema_config_schema_process *go_crun_prepare_process(const char *json, libcrun_error_t *err);
+void go_crun_free_process(runtime_spec_schema_config_schema_process *proc);
+int go_crun_exec_prepared(libcrun_context_t *ctx, const char *id,
+                          const runtime_spec_schema_config_schema_process *proc,
+                          const struct go_crun_overrides *ov, const char *cgroup, libcrun_error_t *err);
+int go_crun_exec_prepared_with_pipes(
+    libcrun_context_t *ctx,
+    const char *id,
+    const runtime_spec_schema_config_schema_process *proc,
+    const struct go_crun_overrides *ov,
+    const char *cgroup,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    libcrun_error_t *err
+);
+
+// Restore ctx->id from a checkpoint in a forked child with isolated I/O
+// (fds as for go_crun_run_with_pipes). The child restores without
+// detaching and exits with the container's exit code. verbosity < 0
+// inherits.
+int go_crun_restore_with_pipes(
+    libcrun_context_t *ctx,
+    libcrun_checkpoint_restore_t *cr_options,
+    int verbosity,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    libcrun_error_t *err
+);
+
+// Batch launch: forks one child per item (as go_crun_run_with_pipes), then
+// collects all setup handshakes. Pipes are created on the C side for the
+// streams selected in want_fds; the parent ends are returned in the item
+// (-1 when absent) and are owned by the caller. For a stream not selected
+// in want_fds, pass_fds (stdin, stdout, stderr; -1 = none) gives a
+// descriptor the child uses directly. On failure err is set, pid
+// is 0 and no parent fd is returned. Returns the number of failed items.
+#define GO_CRUN_BATCH_STDIN  1
+#define GO_CRUN_BATCH_STDOUT 2
+#define GO_CRUN_BATCH_STDERR 4
+#define GO_CRUN_BATCH_LOG    8
+
+struct go_crun_batch_item {
+  libcrun_context_t *ctx;
+  libcrun_container_t *container;
+  const struct go_crun_overrides *overrides;
+  unsigned int flags;
+  int want_fds;
+  int pass_fds[3];
+
+  int stdin_fd;
+  int stdout_fd;
+  int stderr_fd;
+  int log_fd;
+  pid_t pid;
+  libcrun_error_t err;
+};
+
+int go_crun_run_batch(struct go_crun_batch_item *items, int n);
+
+// Lifecycle operations in a forked child, for the context-aware variants:
+// go_crun_call_forked forks a child that runs op and writes a
+// go_crun_call_reply to *out_fd (the read end, close-on-exec, owned by the
+// caller) before exiting; reap it with go_crun_wait or a pidfd. The child
+// logs to log_fd when >= 0. go_crun_call_reply_result turns a reply into
+// the operation's return value, setting err on failure.
+#define GO_CRUN_CALL_CREATE 0
+#define GO_CRUN_CALL_RUN    1
+#define GO_CRUN_CALL_START  2
+#define GO_CRUN_CALL_EXEC   3
+
+struct go_crun_call {
+  int op;
+  libcrun_context_t *ctx;
+  libcrun_container_t *container; // create, run
+  unsigned int flags;             // create, run
+  const char *id;                 // start, exec
+  const char *process_json;       // exec
+  const char *cgroup;             // exec, may be NULL
+  int verbosity;                  // -1 = inherit
+  int log_fd;
+};
+
+struct go_crun_call_reply {
+  int32_t rc;     // the operation's return value, -1 on failure
+  int32_t status; // errno associated with the failure
+  char msg[500];
+};
+
+int go_crun_call_forked(const struct go_crun_call *call, pid_t *out_pid, int *out_fd, libcrun_error_t *err);
+int go_crun_call_reply_result(const struct go_crun_call_reply *reply, libcrun_error_t *err);
+
+// Wait for forked container child process; usage, if not NULL, receives
+// its resource usage
+int go_crun_wait(pid_t pid, int *exit_code, struct rusage *usage, libcrun_error_t *err);
+
+// pidfd-based wait: go_crun_pidfd_open returns -1 when pidfds are not
+// supported; go_crun_wait_pidfd never blocks and returns 1 once the child
+// was reaped (filling usage, if not NULL), 0 while it is still running
+int go_crun_pidfd_open(pid_t pid);
+int go_crun_wait_pidfd(int pidfd, int *exit_code, struct rusage *usage, libcrun_error_t *err);
+// Reports (without blocking) whether the process behind pidfd has exited;
+// works for any process, not only children
+int go_crun_pidfd_exited(int pidfd);
+// pidfd_send_signal(2); -1 with errno ENOSYS when unsupported
+int go_crun_pidfd_send_signal(int pidfd, int sig);
+
+// Launcher helper processes (zygote)
+// go_crun_launcher_start forks a helper that serves run requests on out_sock.
+// go_crun_launcher_run asks the helper to launch the container; the launched
+// child is a direct child of the calling process (wait with go_crun_wait).
+// out_broken is set when the helper is unusable and must be replaced.
+// go_crun_launcher_stop closes the socket and reaps the helper.
+int go_crun_launcher_start(int *out_sock, pid_t *out_pid, libcrun_error_t *err);
+int go_crun_launcher_run(
+    int sock,
+    libcrun_context_t *ctx,
+    libcrun_container_t *container,
+    const struct go_crun_overrides *overrides,
+    unsigned int flags,
+    int stdin_fd,
+    int stdout_fd,
+    int stderr_fd,
+    int log_fd,
+    pid_t *out_pid,
+    int *out_broken,
+    libcrun_error_t *err
+);
+void go_crun_launcher_stop(int sock, pid_t pid);
+
+// Start the transient slice units names over one private systemd bus
+// connection (the user's with user set), their StartTransientUnit calls
+// pipelined. Slices that exist already are not an error.
+int go_crun_systemd_start_slices(const char **names, int n, int user, libcrun_error_t *err);
 
 // Logging callback support - allows Go to receive libcrun logs
 // handle: opaque pointer from cgo.Handle for Go callback routing
@@ -83,5 +447,10 @@ void go_crun_set_log_handler(uintptr_t handle);
 // Reset log handler to default (stderr)
 void go_crun_reset_log_handler(void);
 
+// Route logs emitted by libcrun on the calling thread to handle (0 = the
+// global handler), tagged with id, until go_crun_log_leave
+void go_crun_log_enter(uintptr_t handle, const char *id);
+void go_crun_log_leave(void);
+
 #endif // GO_CRUN_H
 
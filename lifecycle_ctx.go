@@ -0,0 +1,335 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"context"
+	"errors"
+	"os"
+	"strconv"
+	"sync"
+	"syscall"
+	"time"
+	"unsafe"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+// Context-aware variants of the lifecycle operations.
+//
+// The operations that run libcrun in the calling process (Run, Create,
+// Start, Exec) cannot be interrupted: a create stuck on a hung mount ties
+// up the goroutine, and an OS thread, for good. Their ...Ctx variants run
+// the operation in a forked child instead, which costs a fork, and kill it
+// when ctx is done first, along with the processes it forked and, except
+// for Exec, the container's. They return ctx.Err() without waiting for
+// the killed processes to exit; a container left half-created is for
+// Delete(true). Log entries reach the log handler as for the in-process
+// calls.
+//
+// RunWithIOCtx and ExecWithIOCtx already fork: ctx bounds the whole run,
+// and RunResult.WaitCtx bounds a single wait.
+
+// RunCtx is Run, bounded by ctx.
+func (x *RuntimeContext) RunCtx(ctx context.Context, id string, spec *ContainerSpec, o RunOptions) (_ *Container, rerr error) {
+	defer x.trace(OpRun, id).end(&rerr)
+	if x == nil || x.c == nil || spec == nil || spec.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context or container spec")
+	}
+	if err := ctx.Err(); err != nil {
+		return nil, err
+	}
+	c, err := x.acquireLaunchContext(id, spec, true)
+	if err != nil {
+		return nil, err
+	}
+	defer x.cgroupLaunchDone(id)
+	defer x.releaseContext(c)
+	call := C.struct_go_crun_call{op: C.GO_CRUN_CALL_RUN, ctx: c, container: spec.c, flags: runFlags(o)}
+	var callErr error
+	_, oerr := x.launchInProcess(id, spec, bool(x.c.detach), func() C.int {
+		_, callErr = x.callForked(ctx, &call, id, true)
+		if callErr != nil {
+			return -1
+		}
+		return 0
+	})
+	if oerr != nil {
+		return nil, oerr
+	}
+	if callErr != nil {
+		return nil, callErr
+	}
+	x.indexLaunch(id, bool(x.c.detach))
+	return &Container{ID: id, runtime: x, launched: true}, nil
+}
+
+// CreateCtx is Create, bounded by ctx. The container's init is not a child
+// of the calling process, as it is after Create, but of its reaper.
+func (x *RuntimeContext) CreateCtx(ctx context.Context, id string, spec *ContainerSpec, o CreateOptions) (_ *Container, rerr error) {
+	defer x.trace(OpCreate, id).end(&rerr)
+	if x == nil || x.c == nil || spec == nil || spec.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context or container spec")
+	}
+	if err := ctx.Err(); err != nil {
+		return nil, err
+	}
+	c, err := x.acquireLaunchContext(id, spec, true)
+	if err != nil {
+		return nil, err
+	}
+	defer x.cgroupLaunchDone(id)
+	defer x.releaseContext(c)
+	call := C.struct_go_crun_call{op: C.GO_CRUN_CALL_CREATE, ctx: c, container: spec.c, flags: createFlags(o)}
+	var callErr error
+	_, oerr := x.launchInProcess(id, spec, true, func() C.int {
+		_, callErr = x.callForked(ctx, &call, id, true)
+		if callErr != nil {
+			return -1
+		}
+		return 0
+	})
+	if oerr != nil {
+		return nil, oerr
+	}
+	if callErr != nil {
+		return nil, callErr
+	}
+	x.indexLaunch(id, true)
+	return &Container{ID: id, runtime: x, launched: true}, nil
+}
+
+// RunWithIOCtx is RunWithIO, bounded by ctx: when ctx is done before the
+// container exits, the child and the container's processes are killed,
+// and Wait returns ctx.Err().
+func (x *RuntimeContext) RunWithIOCtx(ctx context.Context, id string, spec *ContainerSpec, ioCfg *IOConfig) (*RunResult, error) {
+	if err := ctx.Err(); err != nil {
+		return nil, err
+	}
+	res, err := x.runWithIO(id, spec, nil, ioCfg)
+	if err != nil {
+		return nil, err
+	}
+	res.bind(ctx)
+	return res, nil
+}
+
+// StartCtx is Start, bounded by ctx.
+func (c *Container) StartCtx(ctx context.Context) (rerr error) {
+	x := c.runtime
+	defer x.trace(OpStart, c.ID).end(&rerr)
+	if x == nil || x.c == nil {
+		return errors.New("libcrun: invalid runtime context")
+	}
+	if err := ctx.Err(); err != nil {
+		return err
+	}
+	r := c.ref()
+	cid := r.cidFor(c.ID)
+	defer r.release(cid)
+	call := C.struct_go_crun_call{op: C.GO_CRUN_CALL_START, ctx: x.c, id: cid}
+	if x.notify != nil {
+		cl, err := x.acquireContext(c.ID)
+		if err != nil {
+			return err
+		}
+		defer x.releaseContext(cl)
+		call.ctx = cl
+	}
+	_, err := x.callForked(ctx, &call, c.ID, true)
+	return err
+}
+
+// ExecCtx is Exec, bounded by ctx: when ctx is done first, the process is
+// killed (along with the child performing the exec), not the container.
+func (c *Container) ExecCtx(ctx context.Context, proc *specs.Process, opts ...ExecOption) (rerr error) {
+	x := c.runtime
+	defer x.trace(OpExec, c.ID).end(&rerr)
+	if x == nil || x.c == nil {
+		return errors.New("libcrun: invalid runtime context")
+	}
+	if err := ctx.Err(); err != nil {
+		return err
+	}
+	b, cfg, err := execProcessJSON(proc, opts)
+	if err != nil {
+		return err
+	}
+	r := c.ref()
+	cid := r.cidFor(c.ID)
+	defer r.release(cid)
+	cjson := C.CString(string(b))
+	defer C.free(unsafe.Pointer(cjson))
+	ccgroup := optCString(cfg.cgroup)
+	defer C.free(unsafe.Pointer(ccgroup))
+	call := C.struct_go_crun_call{op: C.GO_CRUN_CALL_EXEC, ctx: x.c, id: cid, process_json: cjson, cgroup: ccgroup}
+	_, err = x.callForked(ctx, &call, c.ID, false)
+	return err
+}
+
+// ExecWithIOCtx is ExecWithIO, bounded by ctx: when ctx is done before the
+// process exits, it is killed, and Wait returns ctx.Err().
+func (c *Container) ExecWithIOCtx(ctx context.Context, proc *specs.Process, ioCfg *IOConfig, opts ...ExecOption) (*RunResult, error) {
+	if err := ctx.Err(); err != nil {
+		return nil, err
+	}
+	res, err := c.ExecWithIO(proc, ioCfg, opts...)
+	if err != nil {
+		return nil, err
+	}
+	res.bind(ctx)
+	return res, nil
+}
+
+// WaitCtx is Wait, bounded by ctx. When ctx is done first, the child and
+// the processes it runs are killed (the container's, unless the result is
+// an exec's), and WaitCtx returns ctx.Err() without waiting for them: they
+// are reaped in the background, and a later Wait fails.
+func (r *RunResult) WaitCtx(ctx context.Context) (int, error) {
+	if ctx.Done() == nil {
+		return r.Wait()
+	}
+	type waited struct {
+		code int
+		err  error
+	}
+	ch := make(chan waited, 1)
+	go func() {
+		code, err := r.Wait()
+		ch <- waited{code, err}
+	}()
+	select {
+	case w := <-ch:
+		return w.code, w.err
+	case <-ctx.Done():
+	}
+	r.abort()
+	return -1, ctx.Err()
+}
+
+// bind makes ctx bound the child: once it is done, the child is killed and
+// Wait returns ctx.Err().
+func (r *RunResult) bind(ctx context.Context) {
+	stop := context.AfterFunc(ctx, r.abort)
+	wait := r.Wait
+	r.Wait = func() (int, error) {
+		code, err := wait()
+		if !stop() && ctx.Err() != nil {
+			return -1, ctx.Err()
+		}
+		return code, err
+	}
+}
+
+// abort kills the child of the RunResult, and the container's processes
+// unless the child execs.
+func (r *RunResult) abort() {
+	if r.waiter == nil {
+		return
+	}
+	if !r.exec {
+		_ = r.Container.KillAll(SIGKILL)
+	}
+	r.waiter.kill()
+}
+
+// callForked runs call in a forked child (go_crun_call_forked) and returns
+// the operation's result once the child is reaped. When ctx is done first,
+// the child and the processes it forked are killed, and, with container
+// set, the processes of container id; callForked then returns ctx.Err()
+// at once, leaving the reaping to a goroutine.
+func (x *RuntimeContext) callForked(ctx context.Context, call *C.struct_go_crun_call, id string, container bool) (C.int, error) {
+	handler := x.effectiveLogHandler()
+	var logR, logW *os.File
+	call.log_fd = -1
+	if handler != nil {
+		var err error
+		if logR, logW, err = os.Pipe(); err != nil {
+			return -1, err
+		}
+		call.log_fd = C.int(logW.Fd())
+	}
+	call.verbosity = C.int(x.childVerbosity())
+
+	var pid C.pid_t
+	var replyFd C.int
+	var cerr C.libcrun_error_t
+	rc := C.go_crun_call_forked(call, &pid, &replyFd, &cerr)
+	if logW != nil {
+		logW.Close()
+	}
+	if rc < 0 {
+		if logR != nil {
+			logR.Close()
+		}
+		return -1, fromLibcrunErr(&cerr)
+	}
+	waiter := newChildWaiter(int(pid))
+
+	var logs sync.WaitGroup
+	if logR != nil {
+		logs.Add(1)
+		go func() {
+			defer logs.Done()
+			defer logR.Close()
+			readLogPipe(logR, id, handler)
+		}()
+	}
+
+	type outcome struct {
+		rc  C.int
+		err error
+	}
+	done := make(chan outcome, 1)
+	go func() {
+		code, werr := waiter.wait()
+		if logR != nil {
+			// What the child logged is in the pipe by now; the processes
+			// it forked may still hold it open until they exec.
+			_ = logR.SetReadDeadline(time.Now())
+			logs.Wait()
+		}
+		rc, replied, err := readCallReply(int(replyFd))
+		if werr != nil {
+			err = werr
+		} else if !replied {
+			err = errors.New("libcrun: operation child exited without a reply, exit code " + strconv.Itoa(code))
+		}
+		done <- outcome{rc, err}
+	}()
+
+	select {
+	case o := <-done:
+		return o.rc, o.err
+	case <-ctx.Done():
+	}
+	if container {
+		_ = x.killAllContainer(id, nil, SIGKILL)
+	}
+	waiter.kill()
+	return -1, ctx.Err()
+}
+
+// readCallReply reads the go_crun_call_reply the reaped child left in the
+// pipe fd, closes fd, and returns the operation's result. replied is false
+// when there is no reply.
+func readCallReply(fd int) (rc C.int, replied bool, err error) {
+	defer syscall.Close(fd)
+	var reply C.struct_go_crun_call_reply
+	buf := unsafe.Slice((*byte)(unsafe.Pointer(&reply)), unsafe.Sizeof(reply))
+	if err := syscall.SetNonblock(fd, true); err != nil {
+		return -1, false, os.NewSyscallError("fcntl", err)
+	}
+	if n, err := syscall.Read(fd, buf); err != nil || n != len(buf) {
+		return -1, false, nil
+	}
+	var cerr C.libcrun_error_t
+	if rc = C.go_crun_call_reply_result(&reply, &cerr); rc < 0 {
+		return -1, true, fromLibcrunErr(&cerr)
+	}
+	return rc, true, nil
+}
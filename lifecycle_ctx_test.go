@@ -0,0 +1,105 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"context"
+	"errors"
+	"syscall"
+	"testing"
+	"time"
+)
+
+func TestLifecycleCtxCanceled(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+	spec, err := NewSpec(false, WithRootPath(t.TempDir()), WithContainerTTY(false))
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	defer spec.Close()
+
+	ctx, cancel := context.WithCancel(context.Background())
+	cancel()
+	ctr := rc.Get("missing")
+	for name, call := range map[string]func() error{
+		"RunCtx":        func() error { _, err := rc.RunCtx(ctx, "c", spec, RunOptions{}); return err },
+		"CreateCtx":     func() error { _, err := rc.CreateCtx(ctx, "c", spec, CreateOptions{}); return err },
+		"RunWithIOCtx":  func() error { _, err := rc.RunWithIOCtx(ctx, "c", spec, nil); return err },
+		"StartCtx":      func() error { return ctr.StartCtx(ctx) },
+		"ExecCtx":       func() error { return ctr.ExecCtx(ctx, nil) },
+		"ExecWithIOCtx": func() error { _, err := ctr.ExecWithIOCtx(ctx, nil, nil); return err },
+	} {
+		if err := call(); !errors.Is(err, context.Canceled) {
+			t.Errorf("%s = %v, want context.Canceled", name, err)
+		}
+	}
+}
+
+func TestStartCtxReportsErrors(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+
+	// The forked child's error travels back as the in-process call's would
+	ctr := rc.Get("missing")
+	want := ctr.Start()
+	got := ctr.StartCtx(context.Background())
+	if want == nil || got == nil {
+		t.Fatalf("Start = %v, StartCtx = %v; want errors", want, got)
+	}
+	var we, ge *Error
+	if !errors.As(want, &we) || !errors.As(got, &ge) {
+		t.Fatalf("Start = %T, StartCtx = %T; want *Error", want, got)
+	}
+	if ge.Message != we.Message || ge.Status != we.Status || ge.Code != we.Code {
+		t.Errorf("StartCtx = %+v, want %+v", ge, we)
+	}
+}
+
+func TestRunResultWaitCtx(t *testing.T) {
+	pid := startChild(t, "sleep 30")
+	w := newChildWaiter(pid)
+	res := &RunResult{Wait: w.wait, waiter: w, exec: true}
+
+	ctx, cancel := context.WithTimeout(context.Background(), 50*time.Millisecond)
+	defer cancel()
+	start := time.Now()
+	if _, err := res.WaitCtx(ctx); !errors.Is(err, context.DeadlineExceeded) {
+		t.Fatalf("WaitCtx = %v, want DeadlineExceeded", err)
+	}
+	if d := time.Since(start); d > 5*time.Second {
+		t.Errorf("WaitCtx took %v", d)
+	}
+	// killed, then reaped in the background
+	waitFor(t, "the child to be reaped", func() bool {
+		return syscall.Kill(pid, 0) == syscall.ESRCH
+	})
+}
+
+func TestRunResultBind(t *testing.T) {
+	w := newChildWaiter(startChild(t, "sleep 30"))
+	res := &RunResult{Wait: w.wait, waiter: w, exec: true}
+	ctx, cancel := context.WithCancel(context.Background())
+	res.bind(ctx)
+	cancel()
+	if _, err := res.Wait(); !errors.Is(err, context.Canceled) {
+		t.Errorf("Wait = %v, want context.Canceled", err)
+	}
+
+	// Unaffected by a context done after the exit
+	w = newChildWaiter(startChild(t, "exit 3"))
+	res = &RunResult{Wait: w.wait, waiter: w, exec: true}
+	ctx, cancel = context.WithCancel(context.Background())
+	res.bind(ctx)
+	code, err := res.Wait()
+	cancel()
+	if code != 3 || err != nil {
+		t.Errorf("Wait = %d, %v; want 3, nil", code, err)
+	}
+}
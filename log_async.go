@@ -0,0 +1,229 @@
+//go:build linux
+
+package crun
+
+import (
+	"sync"
+	"sync/atomic"
+)
+
+// LogDropPolicy selects what an [AsyncLogHandler] does when its queue is full.
+type LogDropPolicy int
+
+const (
+	// DropNewest discards the entry being logged, keeping the queue as is.
+	DropNewest LogDropPolicy = iota
+	// DropOldest discards the oldest queued entry to make room.
+	DropOldest
+)
+
+// defaultAsyncLogSize is the queue size used when AsyncLogOptions.Size is 0.
+const defaultAsyncLogSize = 1024
+
+// AsyncLogOptions configures NewAsyncLogHandler.
+type AsyncLogOptions struct {
+	// Size is the queue capacity, rounded up to a power of two.
+	// 0 selects 1024.
+	Size int
+	// Policy selects which entry is discarded when the queue is full.
+	Policy LogDropPolicy
+}
+
+// AsyncLogHandler decouples a slow LogHandler from libcrun.
+//
+// Handlers installed with SetLogHandler run synchronously in the middle of
+// container operations. AsyncLogHandler.Handle only enqueues the entry into
+// a fixed-size lock-free ring; a dedicated goroutine drains it into the
+// wrapped handler. When the ring is full entries are dropped according to
+// the policy and counted, so logging never blocks the caller.
+//
+//	async := crun.NewAsyncLogHandler(sendToCollector, crun.AsyncLogOptions{Size: 4096})
+//	defer async.Close()
+//	crun.SetLogHandler(async.Handle)
+type AsyncLogHandler struct {
+	ring    logRing
+	handler LogHandler
+	policy  LogDropPolicy
+
+	wake    chan struct{}
+	done    chan struct{}
+	stopped chan struct{}
+	closeMu sync.Once
+	closed  atomic.Bool
+
+	dropped   atomic.Uint64
+	delivered atomic.Uint64
+}
+
+// NewAsyncLogHandler starts the goroutine delivering entries to handler.
+func NewAsyncLogHandler(handler LogHandler, opts AsyncLogOptions) *AsyncLogHandler {
+	size := opts.Size
+	if size <= 0 {
+		size = defaultAsyncLogSize
+	}
+	a := &AsyncLogHandler{
+		handler: handler,
+		policy:  opts.Policy,
+		wake:    make(chan struct{}, 1),
+		done:    make(chan struct{}),
+		stopped: make(chan struct{}),
+	}
+	a.ring.init(size)
+	go a.drain()
+	return a
+}
+
+// Handle queues entry for delivery. It never blocks; it has the LogHandler
+// signature so it can be passed to SetLogHandler. Entries logged after Close
+// are dropped.
+func (a *AsyncLogHandler) Handle(entry LogEntry) {
+	if a.closed.Load() {
+		a.dropped.Add(1)
+		return
+	}
+	for !a.ring.push(entry) {
+		if a.policy != DropOldest {
+			a.dropped.Add(1)
+			return
+		}
+		// Make room by discarding the oldest entry, then retry.
+		if _, ok := a.ring.pop(); ok {
+			a.dropped.Add(1)
+		}
+	}
+	select {
+	case a.wake <- struct{}{}:
+	default:
+	}
+}
+
+// Dropped returns the number of entries discarded so far.
+func (a *AsyncLogHandler) Dropped() uint64 { return a.dropped.Load() }
+
+// Delivered returns the number of entries passed to the wrapped handler.
+func (a *AsyncLogHandler) Delivered() uint64 { return a.delivered.Load() }
+
+// Depth returns the number of entries currently queued.
+func (a *AsyncLogHandler) Depth() int { return a.ring.len() }
+
+// Capacity returns the queue capacity.
+func (a *AsyncLogHandler) Capacity() int { return len(a.ring.slots) }
+
+// Close delivers the entries still queued and stops the goroutine. Uninstall
+// the handler (SetLogHandler(nil)) first if it is installed. Close is
+// idempotent.
+func (a *AsyncLogHandler) Close() {
+	a.closeMu.Do(func() {
+		a.closed.Store(true)
+		close(a.done)
+	})
+	<-a.stopped
+}
+
+func (a *AsyncLogHandler) drain() {
+	defer close(a.stopped)
+	for {
+		for {
+			e, ok := a.ring.pop()
+			if !ok {
+				break
+			}
+			a.handler(e)
+			a.delivered.Add(1)
+		}
+		select {
+		case <-a.wake:
+		case <-a.done:
+			// Flush what producers racing with Close managed to queue.
+			for {
+				e, ok := a.ring.pop()
+				if !ok {
+					return
+				}
+				a.handler(e)
+				a.delivered.Add(1)
+			}
+		}
+	}
+}
+
+// logRing is a bounded multi-producer queue (Vyukov's sequence-numbered
+// ring). Pops are also safe from several goroutines, which DropOldest
+// relies on when producers evict entries.
+type logRing struct {
+	slots []logSlot
+	mask  uint64
+	_     [56]byte // keep head and tail on separate cache lines
+	head  atomic.Uint64
+	_     [56]byte
+	tail  atomic.Uint64
+}
+
+type logSlot struct {
+	seq   atomic.Uint64
+	entry LogEntry
+}
+
+func (r *logRing) init(size int) {
+	n := 1
+	for n < size {
+		n <<= 1
+	}
+	r.slots = make([]logSlot, n)
+	r.mask = uint64(n - 1)
+	for i := range r.slots {
+		r.slots[i].seq.Store(uint64(i))
+	}
+}
+
+// push appends e, returning false if the ring is full.
+func (r *logRing) push(e LogEntry) bool {
+	pos := r.head.Load()
+	for {
+		s := &r.slots[pos&r.mask]
+		switch dif := int64(s.seq.Load()) - int64(pos); {
+		case dif == 0:
+			if r.head.CompareAndSwap(pos, pos+1) {
+				s.entry = e
+				s.seq.Store(pos + 1)
+				return true
+			}
+			pos = r.head.Load()
+		case dif < 0:
+			return false
+		default:
+			pos = r.head.Load()
+		}
+	}
+}
+
+// pop removes the oldest entry, returning false if the ring is empty.
+func (r *logRing) pop() (LogEntry, bool) {
+	pos := r.tail.Load()
+	for {
+		s := &r.slots[pos&r.mask]
+		switch dif := int64(s.seq.Load()) - int64(pos+1); {
+		case dif == 0:
+			if r.tail.CompareAndSwap(pos, pos+1) {
+				e := s.entry
+				s.entry = LogEntry{}
+				s.seq.Store(pos + r.mask + 1)
+				return e, true
+			}
+			pos = r.tail.Load()
+		case dif < 0:
+			return LogEntry{}, false
+		default:
+			pos = r.tail.Load()
+		}
+	}
+}
+
+func (r *logRing) len() int {
+	tail := r.tail.Load()
+	head := r.head.Load()
+	if head < tail {
+		return 0
+	}
+	return int(head - tail)
+}
@@ -0,0 +1,124 @@
+//go:build linux
+
+package crun
+
+import (
+	"fmt"
+	"runtime"
+	"sync"
+	"testing"
+)
+
+func TestAsyncLogHandlerDelivers(t *testing.T) {
+	var mu sync.Mutex
+	var got []string
+	a := NewAsyncLogHandler(func(e LogEntry) {
+		mu.Lock()
+		got = append(got, e.Message)
+		mu.Unlock()
+	}, AsyncLogOptions{Size: 16})
+
+	for i := 0; i < 10; i++ {
+		a.Handle(LogEntry{Message: fmt.Sprint(i)})
+	}
+	a.Close()
+
+	if len(got) != 10 {
+		t.Fatalf("delivered %d entries, want 10", len(got))
+	}
+	for i, m := range got {
+		if m != fmt.Sprint(i) {
+			t.Errorf("entry %d = %q, want %q (order not preserved)", i, m, fmt.Sprint(i))
+		}
+	}
+	if a.Delivered() != 10 || a.Dropped() != 0 {
+		t.Errorf("delivered=%d dropped=%d, want 10/0", a.Delivered(), a.Dropped())
+	}
+
+	// After Close entries are dropped, not delivered
+	a.Handle(LogEntry{Message: "late"})
+	if a.Dropped() != 1 {
+		t.Errorf("dropped after close = %d, want 1", a.Dropped())
+	}
+	a.Close() // idempotent
+}
+
+func TestAsyncLogHandlerDropPolicies(t *testing.T) {
+	for _, tc := range []struct {
+		policy LogDropPolicy
+		want   []string
+	}{
+		{DropNewest, []string{"0", "1", "2", "3"}},
+		{DropOldest, []string{"6", "7", "8", "9"}},
+	} {
+		release := make(chan struct{})
+		var got []string
+		first := true
+		a := NewAsyncLogHandler(func(e LogEntry) {
+			if first {
+				// Block the drain goroutine so the ring fills up
+				first = false
+				<-release
+				return
+			}
+			got = append(got, e.Message)
+		}, AsyncLogOptions{Size: 4, Policy: tc.policy})
+
+		a.Handle(LogEntry{Message: "blocker"})
+		for a.Depth() != 0 {
+			runtime.Gosched() // wait for the drain goroutine to pick up the blocker
+		}
+		for i := 0; i < 10; i++ {
+			a.Handle(LogEntry{Message: fmt.Sprint(i)})
+		}
+		if a.Depth() != a.Capacity() {
+			t.Errorf("policy %d: depth = %d, want full (%d)", tc.policy, a.Depth(), a.Capacity())
+		}
+		if a.Dropped() != 6 {
+			t.Errorf("policy %d: dropped = %d, want 6", tc.policy, a.Dropped())
+		}
+		close(release)
+		a.Close()
+
+		if fmt.Sprint(got) != fmt.Sprint(tc.want) {
+			t.Errorf("policy %d: delivered %v, want %v", tc.policy, got, tc.want)
+		}
+	}
+}
+
+func TestAsyncLogHandlerConcurrentProducers(t *testing.T) {
+	var n int
+	a := NewAsyncLogHandler(func(LogEntry) { n++ }, AsyncLogOptions{Size: 64, Policy: DropOldest})
+
+	var wg sync.WaitGroup
+	for p := 0; p < 8; p++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for i := 0; i < 1000; i++ {
+				a.Handle(LogEntry{Message: "x"})
+			}
+		}()
+	}
+	wg.Wait()
+	a.Close()
+
+	if uint64(n) != a.Delivered() {
+		t.Errorf("handler saw %d entries, Delivered() = %d", n, a.Delivered())
+	}
+	if a.Delivered()+a.Dropped() != 8000 {
+		t.Errorf("delivered+dropped = %d, want 8000", a.Delivered()+a.Dropped())
+	}
+}
+
+func BenchmarkAsyncLogHandle(b *testing.B) {
+	a := NewAsyncLogHandler(func(LogEntry) {}, AsyncLogOptions{Size: 4096})
+	defer a.Close()
+	e := LogEntry{Message: "debug: setting up cgroup for container"}
+	b.ReportAllocs()
+	b.RunParallel(func(pb *testing.PB) {
+		for pb.Next() {
+			a.Handle(e)
+		}
+	})
+}
@@ -0,0 +1,122 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"runtime"
+	"runtime/cgo"
+	"sync/atomic"
+)
+
+// VerbosityInherit makes SetLogVerbosity fall back to the process-wide
+// verbosity set with SetVerbosity.
+const VerbosityInherit = -1
+
+// logRoute holds the handler of one RuntimeContext. The context's cgo
+// handle refers to it rather than to the context, so the handle does not
+// keep the context reachable.
+type logRoute struct {
+	handler atomic.Pointer[LogHandler]
+}
+
+func (r *logRoute) get() LogHandler {
+	if p := r.handler.Load(); p != nil {
+		return *p
+	}
+	return nil
+}
+
+// SetLogHandler routes the libcrun logs of operations on this context to
+// handler instead of the process-wide handler set with the package-level
+// SetLogHandler. Entries carry the ContainerID they relate to.
+//
+// This covers both direct libcrun calls made through the context (Create,
+// Start, Kill, Delete, ...) and the forked children of RunWithIO and
+// RunBatch. Pass nil to fall back to the process-wide handler.
+func (x *RuntimeContext) SetLogHandler(handler LogHandler) {
+	if x == nil {
+		return
+	}
+	x.logMu.Lock()
+	defer x.logMu.Unlock()
+	r := x.logRoute.Load()
+	if r == nil {
+		if handler == nil {
+			return
+		}
+		// The handle lives until Close so that calls in flight on other
+		// threads never see a deleted handle.
+		r = &logRoute{}
+		x.logRoute.Store(r)
+		x.logHandle.Store(uintptr(cgo.NewHandle(r)))
+	}
+	if handler == nil {
+		r.handler.Store(nil)
+		return
+	}
+	r.handler.Store(&handler)
+}
+
+// SetLogVerbosity sets the libcrun verbosity of containers launched from
+// this context with RunWithIO or RunBatch. Those run libcrun in a child
+// process, so enabling VerbosityDebug here does not slow down containers
+// launched from other contexts. Direct libcrun calls keep using the
+// process-wide SetVerbosity. VerbosityInherit restores the default.
+func (x *RuntimeContext) SetLogVerbosity(v int) {
+	if x == nil {
+		return
+	}
+	if v < 0 {
+		v = VerbosityInherit
+	}
+	x.childLogLevel.Store(int32(v + 1))
+}
+
+// childVerbosity returns the verbosity for launched children (< 0 = inherit).
+func (x *RuntimeContext) childVerbosity() int {
+	return int(x.childLogLevel.Load()) - 1
+}
+
+// effectiveLogHandler returns the handler that receives this context's
+// logs: its own, or else the process-wide one.
+func (x *RuntimeContext) effectiveLogHandler() LogHandler {
+	if h := x.ownLogHandler(); h != nil {
+		return h
+	}
+	return getLogHandler()
+}
+
+func (x *RuntimeContext) ownLogHandler() LogHandler {
+	if r := x.logRoute.Load(); r != nil {
+		return r.get()
+	}
+	return nil
+}
+
+// beginLog routes the logs libcrun emits on the calling thread to this
+// context's handler, tagged with id, until endLog. The goroutine stays on
+// its thread meanwhile. It does nothing (and returns false) when no handler
+// would receive the logs.
+func (x *RuntimeContext) beginLog(id *C.char) bool {
+	h := x.logHandle.Load()
+	if h != 0 && x.ownLogHandler() == nil {
+		h = 0
+	}
+	if h == 0 && !logHandlerSet.Load() {
+		return false
+	}
+	runtime.LockOSThread()
+	C.go_crun_log_enter(C.uintptr_t(h), id)
+	return true
+}
+
+func endLog(active bool) {
+	if active {
+		C.go_crun_log_leave()
+		runtime.UnlockOSThread()
+	}
+}
@@ -0,0 +1,260 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"context"
+	"errors"
+	"os"
+	"path/filepath"
+	"sync"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// MemoryEventType is a counter of a cgroup v2 memory.events file.
+type MemoryEventType string
+
+// Memory events reported by Container.Events, in memory.events order.
+const (
+	MemoryLow          MemoryEventType = "low"            // reclaimed below memory.low
+	MemoryHigh         MemoryEventType = "high"           // throttled above memory.high
+	MemoryMax          MemoryEventType = "max"            // allocation hit memory.max
+	MemoryOOM          MemoryEventType = "oom"            // OOM triggered, an allocation failed
+	MemoryOOMKill      MemoryEventType = "oom_kill"       // a process was OOM killed
+	MemoryOOMGroupKill MemoryEventType = "oom_group_kill" // the cgroup was OOM killed as a whole
+)
+
+var memoryEventTypes = [...]MemoryEventType{MemoryLow, MemoryHigh, MemoryMax, MemoryOOM, MemoryOOMKill, MemoryOOMGroupKill}
+
+// MemoryEvent reports that a memory.events counter of a container increased.
+type MemoryEvent struct {
+	Type  MemoryEventType
+	ID    string
+	Count uint64    // increase since the previous event of this type
+	Total uint64    // value of the counter
+	Time  time.Time // when the change was observed
+}
+
+// memEventsBuffer is the channel capacity of a Container.Events subscriber.
+const memEventsBuffer = 64
+
+// Events reports the memory events (OOM, OOM kills, memory.max and
+// memory.high breaches) of the container as they happen, until ctx is
+// cancelled or the container's cgroup is removed; the channel is then
+// closed. Only increases after the call are reported. cgroup v2 only.
+//
+// All subscriptions of a RuntimeContext share one inotify instance, polled
+// by the runtime's netpoller, and one reader goroutine; each container adds
+// a watch on its memory.events file and nothing else. When the reader of
+// the channel falls behind, increases are coalesced into the next event of
+// the same type rather than dropped (Count then covers several breaches).
+func (c *Container) Events(ctx context.Context) (<-chan MemoryEvent, error) {
+	x := c.runtime
+	if x == nil || x.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context")
+	}
+	var st ContainerState
+	var cgroup string
+	if err := x.readState(c.ID, c.ref(), false, &st, &cgroup); err != nil {
+		return nil, err
+	}
+	if cgroup == "" {
+		return nil, errors.New("libcrun: container " + c.ID + " has no cgroup")
+	}
+	return x.memEvents.subscribe(ctx, c.ID, filepath.Join(cgroupRoot, cgroup, "memory.events"))
+}
+
+// memEventsWatcher multiplexes memory.events watches of a RuntimeContext
+// over one inotify descriptor.
+type memEventsWatcher struct {
+	mu      sync.Mutex
+	fd      int
+	ino     *os.File // nil until the first subscription
+	watches map[int32]*memWatch
+	closed  bool
+}
+
+// memWatch is one watched memory.events file and its subscribers.
+type memWatch struct {
+	wd   int32
+	path string
+	subs []*memSub
+}
+
+type memSub struct {
+	id     string
+	ch     chan MemoryEvent
+	last   [len(memoryEventTypes)]uint64 // counters last reported
+	stop   func() bool                   // cancels the context.AfterFunc
+	closed bool
+}
+
+func (w *memEventsWatcher) subscribe(ctx context.Context, id, path string) (<-chan MemoryEvent, error) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	if w.closed {
+		return nil, errors.New("libcrun: runtime context closed")
+	}
+	if w.ino == nil {
+		fd, err := syscall.InotifyInit1(syscall.IN_NONBLOCK | syscall.IN_CLOEXEC)
+		if err != nil {
+			return nil, os.NewSyscallError("inotify_init1", err)
+		}
+		w.fd = fd
+		w.ino = os.NewFile(uintptr(fd), "inotify") // nonblocking: served by the netpoller
+		w.watches = make(map[int32]*memWatch)
+		go w.read(w.ino)
+	}
+	wd, err := syscall.InotifyAddWatch(w.fd, path, syscall.IN_MODIFY)
+	if err != nil {
+		return nil, errnoError("cannot watch memory events of container "+id, err)
+	}
+	mw := w.watches[int32(wd)]
+	if mw == nil {
+		// Watching the same file again yields the same descriptor
+		mw = &memWatch{wd: int32(wd), path: path}
+		w.watches[mw.wd] = mw
+	}
+
+	s := &memSub{id: id, ch: make(chan MemoryEvent, memEventsBuffer)}
+	var buf [512]byte
+	if b, err := readMemoryEvents(path, buf[:]); err == nil {
+		parseMemoryEvents(b, &s.last) // baseline: report only what happens next
+	}
+	mw.subs = append(mw.subs, s)
+	s.stop = context.AfterFunc(ctx, func() { w.unsubscribe(mw, s) })
+	return s.ch, nil
+}
+
+func (w *memEventsWatcher) unsubscribe(mw *memWatch, s *memSub) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	if s.closed {
+		return
+	}
+	s.closed = true
+	close(s.ch)
+	for i, o := range mw.subs {
+		if o == s {
+			mw.subs = append(mw.subs[:i], mw.subs[i+1:]...)
+			break
+		}
+	}
+	if len(mw.subs) == 0 && w.watches[mw.wd] == mw {
+		delete(w.watches, mw.wd)
+		_, _ = syscall.InotifyRmWatch(w.fd, uint32(mw.wd))
+	}
+}
+
+// close ends every subscription; called by RuntimeContext.Close.
+func (w *memEventsWatcher) close() {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	if w.closed {
+		return
+	}
+	w.closed = true
+	for _, mw := range w.watches {
+		w.dropWatch(mw)
+	}
+	if w.ino != nil {
+		w.ino.Close() // stops the reader
+	}
+}
+
+// dropWatch closes the subscribers of mw. Called with mu held.
+func (w *memEventsWatcher) dropWatch(mw *memWatch) {
+	delete(w.watches, mw.wd)
+	for _, s := range mw.subs {
+		s.stop()
+		s.closed = true
+		close(s.ch)
+	}
+	mw.subs = nil
+}
+
+// read dispatches inotify events until the descriptor is closed.
+func (w *memEventsWatcher) read(ino *os.File) {
+	buf := make([]byte, 16*1024)
+	var content [512]byte
+	for {
+		n, err := ino.Read(buf)
+		if err != nil {
+			return
+		}
+		now := time.Now()
+		w.mu.Lock()
+		for off := 0; off+syscall.SizeofInotifyEvent <= n; {
+			raw := (*syscall.InotifyEvent)(unsafe.Pointer(&buf[off]))
+			off += syscall.SizeofInotifyEvent + int(raw.Len)
+			if raw.Mask&syscall.IN_Q_OVERFLOW != 0 {
+				for _, mw := range w.watches {
+					w.update(mw, content[:], now)
+				}
+				continue
+			}
+			mw := w.watches[raw.Wd]
+			if mw == nil {
+				continue
+			}
+			switch {
+			case raw.Mask&syscall.IN_IGNORED != 0:
+				// The cgroup was removed
+				w.dropWatch(mw)
+			case raw.Mask&syscall.IN_MODIFY != 0:
+				w.update(mw, content[:], now)
+			}
+		}
+		w.mu.Unlock()
+	}
+}
+
+// update re-reads the counters of mw and notifies its subscribers of the
+// increases. Called with mu held.
+func (w *memEventsWatcher) update(mw *memWatch, buf []byte, now time.Time) {
+	b, err := readMemoryEvents(mw.path, buf)
+	if err != nil {
+		return
+	}
+	var cur [len(memoryEventTypes)]uint64
+	parseMemoryEvents(b, &cur)
+	for _, s := range mw.subs {
+		for i, v := range cur {
+			if v <= s.last[i] {
+				continue
+			}
+			select {
+			case s.ch <- MemoryEvent{Type: memoryEventTypes[i], ID: s.id, Count: v - s.last[i], Total: v, Time: now}:
+				s.last[i] = v
+			default:
+				// Reader behind: keep last so the next event covers this one
+			}
+		}
+	}
+}
+
+func readMemoryEvents(path string, buf []byte) ([]byte, error) {
+	fd, err := syscall.Open(path, syscall.O_RDONLY|syscall.O_CLOEXEC, 0)
+	if err != nil {
+		return nil, err
+	}
+	defer syscall.Close(fd)
+	n, err := syscall.Read(fd, buf)
+	if err != nil {
+		return nil, err
+	}
+	return buf[:n], nil
+}
+
+func parseMemoryEvents(b []byte, out *[len(memoryEventTypes)]uint64) {
+	forEachKV(b, func(k, v []byte) {
+		for i, t := range memoryEventTypes {
+			if string(k) == string(t) {
+				out[i] = parseUint(v)
+				return
+			}
+		}
+	})
+}
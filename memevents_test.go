@@ -0,0 +1,149 @@
+//go:build linux
+
+package crun
+
+import (
+	"context"
+	"os"
+	"path/filepath"
+	"strconv"
+	"testing"
+	"time"
+)
+
+func writeMemoryEvents(t *testing.T, id, content string) {
+	t.Helper()
+	path := filepath.Join(cgroupRoot, "crun", id, "memory.events")
+	if err := os.WriteFile(path, []byte(content), 0o644); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+}
+
+func nextMemoryEvent(t *testing.T, ch <-chan MemoryEvent) MemoryEvent {
+	t.Helper()
+	select {
+	case ev, ok := <-ch:
+		if !ok {
+			t.Fatal("memory event channel closed")
+		}
+		return ev
+	case <-time.After(5 * time.Second):
+		t.Fatal("timed out waiting for a memory event")
+	}
+	return MemoryEvent{}
+}
+
+func TestContainerEvents(t *testing.T) {
+	rc := fakeStatsRoot(t, "c1", "c2")
+	writeMemoryEvents(t, "c1", "low 0\nhigh 2\nmax 0\noom 0\noom_kill 0\noom_group_kill 0\n")
+	writeMemoryEvents(t, "c2", "low 0\nhigh 0\nmax 0\noom 0\noom_kill 0\noom_group_kill 0\n")
+
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+	ev1, err := rc.Get("c1").Events(ctx)
+	if err != nil {
+		t.Fatalf("Events failed: %v", err)
+	}
+	ev2, err := rc.Get("c2").Events(ctx)
+	if err != nil {
+		t.Fatalf("Events failed: %v", err)
+	}
+
+	// Counters already set at subscription time are not reported
+	writeMemoryEvents(t, "c1", "low 0\nhigh 2\nmax 1\noom 1\noom_kill 1\noom_group_kill 0\n")
+	for _, want := range []MemoryEventType{MemoryMax, MemoryOOM, MemoryOOMKill} {
+		ev := nextMemoryEvent(t, ev1)
+		if ev.Type != want || ev.ID != "c1" || ev.Count != 1 || ev.Total != 1 {
+			t.Fatalf("got %+v, want %s c1 count 1", ev, want)
+		}
+	}
+
+	writeMemoryEvents(t, "c2", "low 0\nhigh 5\nmax 0\noom 0\noom_kill 0\noom_group_kill 0\n")
+	if ev := nextMemoryEvent(t, ev2); ev.Type != MemoryHigh || ev.ID != "c2" || ev.Count != 5 {
+		t.Fatalf("got %+v, want high c2 count 5", ev)
+	}
+	select {
+	case ev := <-ev1:
+		t.Fatalf("unexpected event on c1: %+v", ev)
+	default:
+	}
+
+	cancel()
+	for _, ch := range []<-chan MemoryEvent{ev1, ev2} {
+		select {
+		case _, ok := <-ch:
+			if ok {
+				t.Error("no more events expected after cancel")
+			}
+		case <-time.After(5 * time.Second):
+			t.Fatal("channel not closed after cancel")
+		}
+	}
+	rc.memEvents.mu.Lock()
+	n := len(rc.memEvents.watches)
+	rc.memEvents.mu.Unlock()
+	if n != 0 {
+		t.Errorf("%d watches left after cancel", n)
+	}
+}
+
+func TestContainerEventsCgroupRemoved(t *testing.T) {
+	rc := fakeStatsRoot(t, "c1")
+	writeMemoryEvents(t, "c1", "oom 0\n")
+	ch, err := rc.Get("c1").Events(context.Background())
+	if err != nil {
+		t.Fatalf("Events failed: %v", err)
+	}
+	if err := os.RemoveAll(filepath.Join(cgroupRoot, "crun", "c1")); err != nil {
+		t.Fatalf("RemoveAll failed: %v", err)
+	}
+	select {
+	case _, ok := <-ch:
+		if ok {
+			t.Error("unexpected event")
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("channel not closed after the cgroup was removed")
+	}
+}
+
+func TestContainerEventsCoalesce(t *testing.T) {
+	rc := fakeStatsRoot(t, "c1")
+	writeMemoryEvents(t, "c1", "max 0\n")
+	ch, err := rc.Get("c1").Events(context.Background())
+	if err != nil {
+		t.Fatalf("Events failed: %v", err)
+	}
+	// Fill the channel without reading it
+	for i := 1; i <= memEventsBuffer+3; i++ {
+		writeMemoryEvents(t, "c1", "max "+strconv.Itoa(i)+"\n")
+		time.Sleep(time.Millisecond)
+	}
+	deadline := time.Now().Add(5 * time.Second)
+	for len(ch) < memEventsBuffer && time.Now().Before(deadline) {
+		time.Sleep(time.Millisecond)
+	}
+	var total uint64
+	for len(ch) > 0 {
+		total += (<-ch).Count
+	}
+	// The breaches that did not fit are carried by the next event
+	writeMemoryEvents(t, "c1", "max "+strconv.Itoa(memEventsBuffer+4)+"\n")
+	ev := nextMemoryEvent(t, ch)
+	total += ev.Count
+	if total != memEventsBuffer+4 || ev.Total != memEventsBuffer+4 {
+		t.Errorf("counts add up to %d (last total %d), want %d", total, ev.Total, memEventsBuffer+4)
+	}
+
+	rc.Close()
+	if _, ok := <-ch; ok {
+		t.Error("channel not closed by RuntimeContext.Close")
+	}
+}
+
+func TestContainerEventsNoCgroup(t *testing.T) {
+	rc := fakeStateRoot(t, "c1")
+	if _, err := rc.Get("c1").Events(context.Background()); err == nil {
+		t.Fatal("Events of a container without cgroup succeeded")
+	}
+}
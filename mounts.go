@@ -0,0 +1,64 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"encoding/json"
+	"errors"
+	"runtime"
+	"unsafe"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+// AddMounts mounts each entry of mounts into the running container, as if
+// it had been listed in the spec. The mounts are applied in order, all in
+// a single entry into the container's mount namespace.
+//
+// The list is handed to libcrun through a memfd, without temporary files.
+func (c *Container) AddMounts(mounts []specs.Mount) error {
+	return c.updateMounts(mounts, true)
+}
+
+// RemoveMounts unmounts the destinations of mounts from the running
+// container, in a single entry into its mount namespace.
+func (c *Container) RemoveMounts(mounts []specs.Mount) error {
+	return c.updateMounts(mounts, false)
+}
+
+func (c *Container) updateMounts(mounts []specs.Mount, add bool) error {
+	x := c.runtime
+	if x == nil || x.c == nil {
+		return errors.New("libcrun: invalid runtime context")
+	}
+	if len(mounts) == 0 {
+		return nil
+	}
+	b, err := json.Marshal(struct {
+		Mounts []specs.Mount `json:"mounts"`
+	}{mounts})
+	if err != nil {
+		return err
+	}
+	r := c.ref()
+	cid := r.cidFor(c.ID)
+	defer r.release(cid)
+	var cadd C.int
+	if add {
+		cadd = 1
+	}
+
+	var cerr C.libcrun_error_t
+	logged := x.beginLog(cid)
+	rc := C.go_crun_update_mounts(x.c, cid, (*C.char)(unsafe.Pointer(&b[0])), C.size_t(len(b)), cadd, &cerr)
+	endLog(logged)
+	runtime.KeepAlive(b)
+	if rc < 0 {
+		return fromLibcrunErr(&cerr)
+	}
+	return nil
+}
@@ -0,0 +1,28 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"testing"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+func TestUpdateMountsErrors(t *testing.T) {
+	rc := fakeStateRoot(t, "c1")
+	m := []specs.Mount{{Destination: "/data", Type: "bind", Source: t.TempDir(), Options: []string{"rbind"}}}
+
+	if err := rc.Get("c1").AddMounts(nil); err != nil {
+		t.Errorf("AddMounts(nil) = %v, want nil", err)
+	}
+	if err := rc.Get("missing").AddMounts(m); err == nil {
+		t.Error("AddMounts on a missing container succeeded")
+	}
+	if err := rc.Get("missing").RemoveMounts(m); err == nil {
+		t.Error("RemoveMounts on a missing container succeeded")
+	}
+	// c1 is not running: there is no mount namespace to enter
+	if err := rc.Get("c1").AddMounts(m); err == nil {
+		t.Error("AddMounts on a stopped container succeeded")
+	}
+}
@@ -0,0 +1,311 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"context"
+	"errors"
+	"os"
+	"runtime"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// NetnsPoolOptions configures NewNetnsPool.
+type NetnsPoolOptions struct {
+	// Size is the number of network namespaces kept ready. It must be
+	// positive.
+	Size int
+	// Dir holds the bind mounts of the namespaces. Defaults to
+	// "/run/netns", where iproute2 finds them ("ip -n <name> ...").
+	Dir string
+	// Configure, if set, is called with the path of each new namespace
+	// before it joins the pool, e.g. to move a veth in and set up its
+	// addresses and routes. Namespaces it fails on are destroyed.
+	Configure func(path string) error
+	// Reset, if set, is called with the path of each namespace given back
+	// with Put before it is handed out again. Namespaces it fails on are
+	// destroyed. Without Reset, namespaces are reused as they are.
+	Reset func(path string) error
+}
+
+// NetnsPool keeps network namespaces created and configured in the
+// background, bind-mounted under a directory, so that launching a
+// networked container (WithNetworkNamespace(path)) creates none: netns
+// creation and its configuration serialize on the kernel's rtnl lock and
+// dominate start latency under bursts. Namespaces are handed out with Get
+// and recycled with Put once their container is deleted.
+//
+//	pool, err := crun.NewNetnsPool(crun.NetnsPoolOptions{Size: 32, Configure: setupVeth})
+//	...
+//	ns, err := pool.Get(ctx)
+//	spec, err := crun.NewSpec(false, crun.WithNetworkNamespace(ns), ...)
+//	...
+//	pool.Put(ns)
+type NetnsPool struct {
+	opts    NetnsPoolOptions
+	create  func(path string) error
+	destroy func(path string) error
+
+	mu     sync.Mutex
+	idle   []string
+	out    map[string]bool // handed out by Get
+	closed bool
+	seq    atomic.Uint64
+
+	wake    chan struct{}
+	done    chan struct{}
+	stopped chan struct{}
+	lastErr atomic.Pointer[error]
+}
+
+// NewNetnsPool starts filling a pool of network namespaces. Creating them
+// needs CAP_SYS_ADMIN.
+func NewNetnsPool(o NetnsPoolOptions) (*NetnsPool, error) {
+	if o.Size <= 0 {
+		return nil, errors.New("libcrun: netns pool size must be positive")
+	}
+	if o.Dir == "" {
+		o.Dir = "/run/netns"
+	}
+	if err := os.MkdirAll(o.Dir, 0o755); err != nil {
+		return nil, err
+	}
+	return newNetnsPool(o, createNetns, destroyNetns), nil
+}
+
+func newNetnsPool(o NetnsPoolOptions, create, destroy func(string) error) *NetnsPool {
+	p := &NetnsPool{
+		opts:    o,
+		create:  create,
+		destroy: destroy,
+		out:     map[string]bool{},
+		wake:    make(chan struct{}, 1),
+		done:    make(chan struct{}),
+		stopped: make(chan struct{}),
+	}
+	go p.refill()
+	return p
+}
+
+// Get hands out the path of a configured network namespace, for
+// WithNetworkNamespace. When the pool is empty one is created
+// synchronously instead of waiting for the refill.
+func (p *NetnsPool) Get(ctx context.Context) (string, error) {
+	if err := ctx.Err(); err != nil {
+		return "", err
+	}
+	p.mu.Lock()
+	if p.closed {
+		p.mu.Unlock()
+		return "", errors.New("libcrun: netns pool closed")
+	}
+	var path string
+	if n := len(p.idle); n > 0 {
+		path = p.idle[0]
+		p.idle = append(p.idle[:0], p.idle[1:]...)
+		p.out[path] = true
+	}
+	p.mu.Unlock()
+	p.kick()
+	if path != "" {
+		return path, nil
+	}
+	path, err := p.newNetns()
+	if err != nil {
+		return "", err
+	}
+	p.mu.Lock()
+	p.out[path] = true
+	p.mu.Unlock()
+	return path, nil
+}
+
+// Put gives back a namespace handed out by Get, once no container uses
+// it. It is reset and reused if the pool needs it, destroyed otherwise.
+func (p *NetnsPool) Put(path string) error {
+	p.mu.Lock()
+	if !p.out[path] {
+		p.mu.Unlock()
+		return errors.New("libcrun: network namespace " + path + " is not from this pool")
+	}
+	delete(p.out, path)
+	reuse := !p.closed && len(p.idle) < p.opts.Size
+	p.mu.Unlock()
+	if reuse && p.opts.Reset != nil {
+		if err := p.opts.Reset(path); err != nil {
+			_ = p.destroy(path)
+			p.kick()
+			return err
+		}
+	}
+	if !reuse || !p.put(path) {
+		return p.destroy(path)
+	}
+	return nil
+}
+
+// Len returns the number of namespaces ready to be handed out.
+func (p *NetnsPool) Len() int {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	return len(p.idle)
+}
+
+// Err returns the error of the last failed background creation, or nil
+// once a creation succeeded again.
+func (p *NetnsPool) Err() error {
+	if e := p.lastErr.Load(); e != nil {
+		return *e
+	}
+	return nil
+}
+
+// Close stops refilling and destroys the namespaces still in the pool.
+// Namespaces handed out by Get are destroyed when they are Put back.
+func (p *NetnsPool) Close() error {
+	p.mu.Lock()
+	if p.closed {
+		p.mu.Unlock()
+		<-p.stopped
+		return nil
+	}
+	p.closed = true
+	close(p.done)
+	p.mu.Unlock()
+	<-p.stopped
+
+	p.mu.Lock()
+	idle := p.idle
+	p.idle = nil
+	p.mu.Unlock()
+	var firstErr error
+	for _, path := range idle {
+		if err := p.destroy(path); err != nil && firstErr == nil {
+			firstErr = err
+		}
+	}
+	return firstErr
+}
+
+// newNetns creates and configures a namespace under Dir.
+func (p *NetnsPool) newNetns() (string, error) {
+	path := p.opts.Dir + "/libcrun-" + strconv.Itoa(os.Getpid()) + "-" + strconv.FormatUint(p.seq.Add(1), 10)
+	if err := p.create(path); err != nil {
+		return "", err
+	}
+	if p.opts.Configure != nil {
+		if err := p.opts.Configure(path); err != nil {
+			_ = p.destroy(path)
+			return "", err
+		}
+	}
+	return path, nil
+}
+
+func (p *NetnsPool) kick() {
+	select {
+	case p.wake <- struct{}{}:
+	default:
+	}
+}
+
+// refill keeps the pool at its target size until Close.
+func (p *NetnsPool) refill() {
+	defer close(p.stopped)
+	backoff := warmPoolMinBackoff
+	for {
+		failed := false
+		for !failed && p.need() {
+			path, err := p.newNetns()
+			if err != nil {
+				p.lastErr.Store(&err)
+				failed = true
+				break
+			}
+			p.lastErr.Store(nil)
+			backoff = warmPoolMinBackoff
+			if !p.put(path) {
+				_ = p.destroy(path) // closed meanwhile
+				return
+			}
+		}
+		var retry <-chan time.Time
+		if failed {
+			retry = time.After(backoff)
+			backoff = min(backoff*2, warmPoolMaxBackoff)
+		}
+		select {
+		case <-p.done:
+			return
+		case <-p.wake:
+		case <-retry:
+		}
+	}
+}
+
+// need reports whether the pool is below its target size.
+func (p *NetnsPool) need() bool {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	return !p.closed && len(p.idle) < p.opts.Size
+}
+
+func (p *NetnsPool) put(path string) bool {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.closed {
+		return false
+	}
+	p.idle = append(p.idle, path)
+	return true
+}
+
+// createNetns creates a network namespace and bind-mounts it at path,
+// from a thread of its own, which is only handed back to the Go scheduler
+// once it is back in the process's namespace.
+func createNetns(path string) error {
+	f, err := os.OpenFile(path, os.O_CREATE|os.O_EXCL|os.O_RDONLY, 0o444)
+	if err != nil {
+		return err
+	}
+	f.Close()
+	cpath := C.CString(path)
+	defer C.free(unsafe.Pointer(cpath))
+	errc := make(chan error, 1)
+	go func() {
+		runtime.LockOSThread()
+		var cerr C.libcrun_error_t
+		rc := C.go_crun_netns_new(cpath, &cerr)
+		if rc == 0 {
+			runtime.UnlockOSThread()
+			errc <- nil
+			return
+		}
+		// rc > 0: stuck in the new namespace, the thread exits with us
+		errc <- fromLibcrunErr(&cerr)
+	}()
+	if err := <-errc; err != nil {
+		os.Remove(path)
+		return err
+	}
+	return nil
+}
+
+// destroyNetns unmounts the namespace bound at path, which the kernel
+// frees once no process is left in it, and removes the mount point.
+func destroyNetns(path string) error {
+	if err := syscall.Unmount(path, syscall.MNT_DETACH); err != nil && err != syscall.EINVAL {
+		return &os.PathError{Op: "unmount netns", Path: path, Err: err}
+	}
+	return os.Remove(path)
+}
@@ -0,0 +1,168 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"context"
+	"errors"
+	"os"
+	"path/filepath"
+	"sync/atomic"
+	"syscall"
+	"testing"
+)
+
+// fakeNetnsPool returns a pool whose namespaces are plain files.
+func fakeNetnsPool(t *testing.T, o NetnsPoolOptions, fail *atomic.Bool) *NetnsPool {
+	t.Helper()
+	o.Dir = t.TempDir()
+	p := newNetnsPool(o, func(path string) error {
+		if fail != nil && fail.Load() {
+			return errWarmTest
+		}
+		return os.WriteFile(path, nil, 0o444)
+	}, os.Remove)
+	t.Cleanup(func() { p.Close() })
+	return p
+}
+
+func TestNetnsPoolConfiguresOffTheHotPath(t *testing.T) {
+	var configured atomic.Int32
+	p := fakeNetnsPool(t, NetnsPoolOptions{Size: 2, Configure: func(path string) error {
+		configured.Add(1)
+		return nil
+	}}, nil)
+	waitFor(t, "pool to fill", func() bool { return p.Len() == 2 })
+	if n := configured.Load(); n != 2 {
+		t.Fatalf("configured %d namespaces, want 2", n)
+	}
+
+	ns, err := p.Get(context.Background())
+	if err != nil {
+		t.Fatalf("Get failed: %v", err)
+	}
+	if _, err := os.Stat(ns); err != nil {
+		t.Fatalf("handed out namespace missing: %v", err)
+	}
+	waitFor(t, "refill", func() bool { return p.Len() == 2 })
+	if n := configured.Load(); n != 3 {
+		t.Errorf("configured %d namespaces, want 3", n)
+	}
+}
+
+func TestNetnsPoolRecycles(t *testing.T) {
+	var resets atomic.Int32
+	p := fakeNetnsPool(t, NetnsPoolOptions{Size: 1, Reset: func(string) error {
+		resets.Add(1)
+		return nil
+	}}, nil)
+	waitFor(t, "pool to fill", func() bool { return p.Len() == 1 })
+
+	a, err := p.Get(context.Background())
+	if err != nil {
+		t.Fatalf("Get failed: %v", err)
+	}
+	b, err := p.Get(context.Background()) // empty: created synchronously
+	if err != nil {
+		t.Fatalf("Get failed: %v", err)
+	}
+	waitFor(t, "refill", func() bool { return p.Len() == 1 })
+
+	if err := p.Put(a); err != nil {
+		t.Fatalf("Put failed: %v", err)
+	}
+	if _, err := os.Stat(a); !os.IsNotExist(err) {
+		t.Errorf("namespace beyond the pool size kept: %v", err)
+	}
+	if err := p.Put(a); err == nil {
+		t.Error("second Put of the same namespace succeeded")
+	}
+
+	c, err := p.Get(context.Background())
+	if err != nil {
+		t.Fatalf("Get failed: %v", err)
+	}
+	if err := p.Put(c); err != nil {
+		t.Fatalf("Put failed: %v", err)
+	}
+	if p.Len() != 1 || resets.Load() != 1 {
+		t.Errorf("Len = %d, resets = %d after recycling; want 1, 1", p.Len(), resets.Load())
+	}
+	if err := p.Put(filepath.Join(filepath.Dir(b), "other")); err == nil {
+		t.Error("Put of a foreign namespace succeeded")
+	}
+	if err := p.Put(b); err != nil {
+		t.Fatalf("Put failed: %v", err)
+	}
+}
+
+func TestNetnsPoolCloseAndErrors(t *testing.T) {
+	var fail atomic.Bool
+	fail.Store(true)
+	p := fakeNetnsPool(t, NetnsPoolOptions{Size: 2}, &fail)
+	waitFor(t, "creation error", func() bool { return p.Err() != nil })
+	if _, err := p.Get(context.Background()); !errors.Is(err, errWarmTest) {
+		t.Errorf("Get with failing creation = %v", err)
+	}
+	fail.Store(false)
+	waitFor(t, "pool to fill", func() bool { return p.Len() == 2 })
+	if p.Err() != nil {
+		t.Errorf("Err after recovery = %v", p.Err())
+	}
+
+	ns, err := p.Get(context.Background())
+	if err != nil {
+		t.Fatalf("Get failed: %v", err)
+	}
+	waitFor(t, "refill", func() bool { return p.Len() == 2 })
+	p.mu.Lock()
+	idle := append([]string(nil), p.idle...)
+	p.mu.Unlock()
+	if err := p.Close(); err != nil {
+		t.Fatalf("Close failed: %v", err)
+	}
+	for _, path := range idle {
+		if _, err := os.Stat(path); !os.IsNotExist(err) {
+			t.Errorf("idle namespace %s survived Close: %v", path, err)
+		}
+	}
+	if _, err := p.Get(context.Background()); err == nil {
+		t.Error("Get after Close succeeded")
+	}
+	if err := p.Put(ns); err != nil {
+		t.Fatalf("Put after Close failed: %v", err)
+	}
+	if _, err := os.Stat(ns); !os.IsNotExist(err) {
+		t.Errorf("namespace put back after Close kept: %v", err)
+	}
+}
+
+func TestCreateNetns(t *testing.T) {
+	if os.Geteuid() != 0 {
+		t.Skip("creating network namespaces needs root")
+	}
+	path := filepath.Join(t.TempDir(), "ns")
+	if err := createNetns(path); err != nil {
+		var cerr *Error
+		if errors.As(err, &cerr) && cerr.Status == int(syscall.EPERM) {
+			t.Skip("creating network namespaces not permitted")
+		}
+		t.Fatalf("createNetns failed: %v", err)
+	}
+	var ns, self syscall.Stat_t
+	if err := syscall.Stat(path, &ns); err != nil {
+		t.Fatalf("stat %s: %v", path, err)
+	}
+	if err := syscall.Stat("/proc/self/ns/net", &self); err != nil {
+		t.Fatalf("stat own netns: %v", err)
+	}
+	if ns.Ino == self.Ino && ns.Dev == self.Dev {
+		t.Error("bind mount is not a new network namespace")
+	}
+	if err := destroyNetns(path); err != nil {
+		t.Fatalf("destroyNetns failed: %v", err)
+	}
+	if _, err := os.Stat(path); !os.IsNotExist(err) {
+		t.Errorf("mount point left behind: %v", err)
+	}
+}
@@ -0,0 +1,319 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"bytes"
+	"context"
+	"errors"
+	"os"
+	"path/filepath"
+	"strconv"
+	"sync"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// NotifyState is what a container reported over its notify socket, per
+// the sd_notify protocol.
+type NotifyState struct {
+	// Ready is set once READY=1 was received.
+	Ready bool
+	// Stopping is set once STOPPING=1 was received.
+	Stopping bool
+	// Status is the last STATUS= text.
+	Status string
+	// MainPID is the last MAINPID=, 0 if none.
+	MainPID int
+	// Errno is the last ERRNO=, 0 if none.
+	Errno int
+	// Watchdog is the time of the last WATCHDOG=1 keep-alive, zero if
+	// none.
+	Watchdog time.Time
+}
+
+// NotifyHub serves the notify sockets of many containers from one
+// directory and one event loop, so that callers learn when a container is
+// READY without running a unixgram server each. Set RuntimeConfig.Notify
+// to use it: every container the context launches gets a socket of its
+// own in the hub's directory, as its NOTIFY_SOCKET (RuntimeConfig's is
+// ignored), and Container.Ready waits for its readiness.
+//
+//	hub, err := crun.NewNotifyHub("")
+//	...
+//	defer hub.Close()
+//	rc, err := crun.NewRuntimeContext(crun.RuntimeConfig{Notify: hub, ...})
+//	...
+//	res, err := rc.RunWithIO(id, spec, &crun.IOConfig{})
+//	err = res.Container.Ready(ctx)
+//
+// libcrun relays to the socket what the container's process sends to its
+// own (READY=1 along with MAINPID=), from the launching call, which Run,
+// Create and Start make wait until then: use the forking variants
+// (RunWithIO, the ...Ctx ones) or a goroutine to wait with Ready instead.
+// A socket lives until the container is deleted through the context.
+type NotifyHub struct {
+	dir    string
+	ownDir bool
+	epoll  *epollLoop // of the sockets
+
+	mu      sync.Mutex
+	byID    map[string]*notifySocket
+	byFd    map[int32]*notifySocket
+	seq     uint64
+	closed  bool
+	stopped chan struct{}
+}
+
+// notifySocket is the notify socket of a container.
+type notifySocket struct {
+	id    string
+	name  string  // of the socket
+	path  *C.char // name, for the context clones of the container's launches
+	fd    int
+	state NotifyState
+	ready chan struct{} // closed on READY=1
+	gone  chan struct{} // closed when the socket is released
+}
+
+// NewNotifyHub creates a hub serving sockets in dir, created if needed, or
+// in a private temporary directory, removed by Close, when dir is "".
+// Socket paths must fit in 108 bytes, which leaves dir about 90.
+func NewNotifyHub(dir string) (*NotifyHub, error) {
+	h := &NotifyHub{
+		dir:     dir,
+		byID:    map[string]*notifySocket{},
+		byFd:    map[int32]*notifySocket{},
+		stopped: make(chan struct{}),
+	}
+	if dir == "" {
+		d, err := os.MkdirTemp("", "libcrun-notify-")
+		if err != nil {
+			return nil, err
+		}
+		h.dir, h.ownDir = d, true
+	} else if err := os.MkdirAll(dir, 0o700); err != nil {
+		return nil, err
+	}
+	epoll, err := newEpollLoop("notify-epoll")
+	if err != nil {
+		h.removeDir()
+		return nil, err
+	}
+	h.epoll = epoll
+	go h.run()
+	return h, nil
+}
+
+// Dir returns the directory of the sockets.
+func (h *NotifyHub) Dir() string { return h.dir }
+
+// State returns what container id reported so far, and false when the hub
+// has no socket for it.
+func (h *NotifyHub) State(id string) (NotifyState, bool) {
+	h.mu.Lock()
+	defer h.mu.Unlock()
+	s := h.byID[id]
+	if s == nil {
+		return NotifyState{}, false
+	}
+	return s.state, true
+}
+
+// Close stops the event loop and removes the sockets, and the directory
+// if the hub created it. Ready calls in progress fail. No launch through a
+// context using the hub may be in progress. Close is idempotent.
+func (h *NotifyHub) Close() error {
+	h.mu.Lock()
+	if h.closed {
+		h.mu.Unlock()
+		return nil
+	}
+	h.closed = true
+	for _, s := range h.byID {
+		h.releaseLocked(s)
+	}
+	h.epoll.close() // ends run
+	h.mu.Unlock()
+	<-h.stopped
+	h.removeDir()
+	return nil
+}
+
+func (h *NotifyHub) removeDir() {
+	if h.ownDir {
+		os.RemoveAll(h.dir)
+	}
+}
+
+// register returns the socket path of container id, creating the socket
+// on first use, which fresh reports. The path stays valid until release.
+func (h *NotifyHub) register(id string) (path *C.char, fresh bool, err error) {
+	h.mu.Lock()
+	defer h.mu.Unlock()
+	if h.closed {
+		return nil, false, errors.New("libcrun: notify hub closed")
+	}
+	if s := h.byID[id]; s != nil {
+		return s.path, false, nil
+	}
+	// Sequence numbers, not IDs, name the sockets: a container ID may be
+	// longer than a socket path can be
+	h.seq++
+	name := filepath.Join(h.dir, strconv.FormatUint(h.seq, 10)+".sock")
+	fd, err := syscall.Socket(syscall.AF_UNIX, syscall.SOCK_DGRAM|syscall.SOCK_NONBLOCK|syscall.SOCK_CLOEXEC, 0)
+	if err != nil {
+		return nil, false, os.NewSyscallError("socket", err)
+	}
+	_ = os.Remove(name) // left by a previous process
+	if err := syscall.Bind(fd, &syscall.SockaddrUnix{Name: name}); err != nil {
+		syscall.Close(fd)
+		return nil, false, os.NewSyscallError("bind", err)
+	}
+	// libcrun relays the messages to the socket from the host, possibly
+	// from a child in a user namespace
+	_ = os.Chmod(name, 0o666)
+	ev := syscall.EpollEvent{Events: syscall.EPOLLIN, Fd: int32(fd)}
+	if err := syscall.EpollCtl(h.epoll.fd(), syscall.EPOLL_CTL_ADD, fd, &ev); err != nil {
+		syscall.Close(fd)
+		os.Remove(name)
+		return nil, false, os.NewSyscallError("epoll_ctl", err)
+	}
+	s := &notifySocket{
+		id:    id,
+		name:  name,
+		path:  C.CString(name),
+		fd:    fd,
+		ready: make(chan struct{}),
+		gone:  make(chan struct{}),
+	}
+	h.byID[id] = s
+	h.byFd[int32(fd)] = s
+	return s.path, true, nil
+}
+
+// release removes the socket of container id, if any.
+func (h *NotifyHub) release(id string) {
+	if h == nil {
+		return
+	}
+	h.mu.Lock()
+	defer h.mu.Unlock()
+	if s := h.byID[id]; s != nil {
+		h.releaseLocked(s)
+	}
+}
+
+func (h *NotifyHub) releaseLocked(s *notifySocket) {
+	delete(h.byID, s.id)
+	delete(h.byFd, int32(s.fd))
+	_ = syscall.EpollCtl(h.epoll.fd(), syscall.EPOLL_CTL_DEL, s.fd, nil)
+	syscall.Close(s.fd)
+	os.Remove(s.name)
+	close(s.gone)
+	C.free(unsafe.Pointer(s.path))
+	s.path = nil
+}
+
+func (h *NotifyHub) run() {
+	defer close(h.stopped)
+	events := make([]syscall.EpollEvent, 64)
+	buf := make([]byte, 4096)
+	for {
+		n, err := h.epoll.wait(events)
+		if err != nil {
+			return
+		}
+		h.mu.Lock()
+		for _, ev := range events[:n] {
+			if s := h.byFd[ev.Fd]; s != nil {
+				h.receiveLocked(s, buf)
+			}
+		}
+		h.mu.Unlock()
+	}
+}
+
+// receiveLocked reads the datagrams queued on s.
+func (h *NotifyHub) receiveLocked(s *notifySocket, buf []byte) {
+	for {
+		n, _, err := syscall.Recvfrom(s.fd, buf, 0)
+		if err == syscall.EINTR {
+			continue
+		}
+		if err != nil {
+			return
+		}
+		s.parse(buf[:n])
+	}
+}
+
+// parse applies the newline-separated assignments of a notify message.
+func (s *notifySocket) parse(msg []byte) {
+	for _, line := range bytes.Split(msg, []byte("\n")) {
+		key, value, ok := bytes.Cut(line, []byte("="))
+		if !ok {
+			continue
+		}
+		switch string(key) {
+		case "READY":
+			if string(value) == "1" && !s.state.Ready {
+				s.state.Ready = true
+				close(s.ready)
+			}
+		case "STOPPING":
+			s.state.Stopping = string(value) == "1"
+		case "STATUS":
+			s.state.Status = string(value)
+		case "MAINPID":
+			if pid, err := strconv.Atoi(string(value)); err == nil {
+				s.state.MainPID = pid
+			}
+		case "ERRNO":
+			if e, err := strconv.Atoi(string(value)); err == nil {
+				s.state.Errno = e
+			}
+		case "WATCHDOG":
+			if string(value) == "1" {
+				s.state.Watchdog = time.Now()
+			}
+		}
+	}
+}
+
+// Ready waits until the container reported READY=1 over its notify
+// socket, which needs a RuntimeContext with a NotifyHub. It fails when
+// the container is deleted, or the hub closed, first, and returns
+// ctx.Err() when ctx is done first.
+func (c *Container) Ready(ctx context.Context) error {
+	x := c.runtime
+	if x == nil || x.notify == nil {
+		return errors.New("libcrun: Ready needs a runtime context with a notify hub")
+	}
+	h := x.notify
+	h.mu.Lock()
+	s := h.byID[c.ID]
+	h.mu.Unlock()
+	if s == nil {
+		return errors.New("libcrun: no notify socket for container " + c.ID)
+	}
+	select {
+	case <-s.ready:
+		return nil
+	case <-s.gone:
+		select {
+		case <-s.ready:
+			return nil
+		default:
+		}
+		return errors.New("libcrun: notify socket of container " + c.ID + " released before READY")
+	case <-ctx.Done():
+		return ctx.Err()
+	}
+}
@@ -0,0 +1,116 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"context"
+	"errors"
+	"net"
+	"os"
+	"testing"
+	"time"
+)
+
+func notifySend(t *testing.T, h *NotifyHub, id, msg string) {
+	t.Helper()
+	h.mu.Lock()
+	s := h.byID[id]
+	h.mu.Unlock()
+	if s == nil {
+		t.Fatalf("no socket for %s", id)
+	}
+	conn, err := net.DialUnix("unixgram", nil, &net.UnixAddr{Name: s.name, Net: "unixgram"})
+	if err != nil {
+		t.Fatalf("dial failed: %v", err)
+	}
+	defer conn.Close()
+	if _, err := conn.Write([]byte(msg)); err != nil {
+		t.Fatalf("write failed: %v", err)
+	}
+}
+
+func TestNotifyHubReady(t *testing.T) {
+	h, err := NewNotifyHub("")
+	if err != nil {
+		t.Fatalf("NewNotifyHub failed: %v", err)
+	}
+	defer h.Close()
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir(), Notify: h})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+
+	// A launch registers the container's socket
+	cl, err := rc.acquireContext("svc")
+	if err != nil {
+		t.Fatalf("acquireContext failed: %v", err)
+	}
+	rc.releaseContext(cl)
+	if _, ok := h.State("svc"); !ok {
+		t.Fatal("no notify state after a launch")
+	}
+	ctr := rc.Get("svc")
+
+	ctx, cancel := context.WithTimeout(context.Background(), 20*time.Millisecond)
+	err = ctr.Ready(ctx)
+	cancel()
+	if !errors.Is(err, context.DeadlineExceeded) {
+		t.Fatalf("Ready before READY = %v, want deadline exceeded", err)
+	}
+
+	notifySend(t, h, "svc", "STATUS=starting\nMAINPID=42")
+	notifySend(t, h, "svc", "READY=1\nSTATUS=serving")
+	if err := ctr.Ready(context.Background()); err != nil {
+		t.Fatalf("Ready failed: %v", err)
+	}
+	notifySend(t, h, "svc", "WATCHDOG=1")
+	waitFor(t, "the watchdog ping", func() bool {
+		st, _ := h.State("svc")
+		return !st.Watchdog.IsZero()
+	})
+	st, _ := h.State("svc")
+	if !st.Ready || st.Status != "serving" || st.MainPID != 42 || st.Stopping {
+		t.Errorf("state = %+v", st)
+	}
+
+	if err := rc.Get("other").Ready(context.Background()); err == nil {
+		t.Error("Ready of a container without a socket succeeded")
+	}
+}
+
+func TestNotifyHubRelease(t *testing.T) {
+	h, err := NewNotifyHub("")
+	if err != nil {
+		t.Fatalf("NewNotifyHub failed: %v", err)
+	}
+	if _, _, err := h.register("a"); err != nil {
+		t.Fatalf("register failed: %v", err)
+	}
+	h.mu.Lock()
+	name := h.byID["a"].name
+	h.mu.Unlock()
+	ctr := &Container{ID: "a", runtime: &RuntimeContext{notify: h}}
+	errc := make(chan error, 1)
+	go func() { errc <- ctr.Ready(context.Background()) }()
+	h.release("a")
+	if err := <-errc; err == nil {
+		t.Error("Ready succeeded after the socket was released")
+	}
+	if _, err := os.Stat(name); !os.IsNotExist(err) {
+		t.Errorf("socket left after release: %v", err)
+	}
+
+	if _, _, err := h.register("b"); err != nil {
+		t.Fatalf("register failed: %v", err)
+	}
+	dir := h.Dir()
+	h.Close()
+	h.Close()
+	if _, err := os.Stat(dir); !os.IsNotExist(err) {
+		t.Errorf("directory left after Close: %v", err)
+	}
+	if _, _, err := h.register("c"); err == nil {
+		t.Error("register succeeded after Close")
+	}
+}
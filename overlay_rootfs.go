@@ -0,0 +1,188 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"syscall"
+	"unsafe"
+)
+
+// Annotations through which WithOverlayRootfs asks the launch for an
+// ephemeral overlay rootfs. libcrun ignores them.
+const (
+	overlayLowerAnnotation     = "io.github.danielealbano.libcrun-go.overlay.lower"
+	overlayUpperSizeAnnotation = "io.github.danielealbano.libcrun-go.overlay.upper-size"
+)
+
+// overlayRootfs is the ephemeral overlay rootfs requested by a spec.
+type overlayRootfs struct {
+	lower []string // bottom first
+	size  int64    // of the upper tmpfs, 0 for the tmpfs default
+}
+
+// overlayRootfs returns the overlay rootfs requested by the spec's
+// annotations, or nil. It is parsed once per spec.
+func (s *ContainerSpec) overlayRootfs() *overlayRootfs {
+	if s == nil || s.c == nil {
+		return nil
+	}
+	s.overlayOnce.Do(func() {
+		lower, ok := s.annotation(overlayLowerAnnotation)
+		if !ok || lower == "" {
+			return
+		}
+		o := overlayRootfs{lower: strings.Split(lower, ":")}
+		if size, ok := s.annotation(overlayUpperSizeAnnotation); ok {
+			o.size, _ = strconv.ParseInt(size, 10, 64)
+		}
+		s.overlay = &o
+	})
+	return s.overlay
+}
+
+// overlayDir is where the overlay rootfs of container id is assembled: a
+// directory of the state root's ".overlay", which container listings skip.
+func (x *RuntimeContext) overlayDir(id string) string {
+	return filepath.Join(x.stateRootDir(), ".overlay", id)
+}
+
+// mountOverlay mounts a tmpfs at the overlay directory of container id,
+// holding the upper and work directories, and the overlay of o.lower over
+// it, and returns the path of the merged tree.
+func (x *RuntimeContext) mountOverlay(id string, o *overlayRootfs) (string, error) {
+	dir := x.overlayDir(id)
+	if err := os.MkdirAll(filepath.Dir(dir), 0o700); err != nil {
+		return "", err
+	}
+	if err := os.Mkdir(dir, 0o700); err != nil {
+		return "", err
+	}
+	data := "mode=0700"
+	if o.size > 0 {
+		data += ",size=" + strconv.FormatInt(o.size, 10)
+	}
+	if err := syscall.Mount("tmpfs", dir, "tmpfs", syscall.MS_NOSUID|syscall.MS_NODEV, data); err != nil {
+		os.Remove(dir)
+		return "", &os.PathError{Op: "mount tmpfs", Path: dir, Err: err}
+	}
+	rootfs, upper, work := filepath.Join(dir, "rootfs"), filepath.Join(dir, "upper"), filepath.Join(dir, "work")
+	for _, d := range []string{rootfs, upper, work} {
+		if err := os.Mkdir(d, 0o755); err != nil {
+			x.releaseOverlay(id)
+			return "", err
+		}
+	}
+	opts := strings.Join(OverlayMountOptions(o.lower, upper, work), ",")
+	if err := syscall.Mount("overlay", rootfs, "overlay", 0, opts); err != nil {
+		x.releaseOverlay(id)
+		return "", &os.PathError{Op: "mount overlay", Path: rootfs, Err: err}
+	}
+	return rootfs, nil
+}
+
+// releaseOverlay unmounts the overlay rootfs of container id, if it has
+// one, dropping the container's changes with the tmpfs.
+func (x *RuntimeContext) releaseOverlay(id string) {
+	dir := x.overlayDir(id)
+	if _, err := os.Lstat(dir); err != nil {
+		return
+	}
+	syscall.Unmount(filepath.Join(dir, "rootfs"), syscall.MNT_DETACH)
+	syscall.Unmount(dir, syscall.MNT_DETACH)
+	os.Remove(dir)
+}
+
+// launchInProcess calls launch, which creates container id from spec
+// without forking (Create, Run), after mounting the spec's overlay rootfs
+// if it requests one. The spec's root path then points at it for the
+// duration of the call, so such launches of one spec are serialized, and
+// forked launches of it wait (see overlayLaunchIO). If
+// keep is false, or launch fails, the overlay is released once it returns.
+func (x *RuntimeContext) launchInProcess(id string, spec *ContainerSpec, keep bool, launch func() C.int) (C.int, error) {
+	o := spec.overlayRootfs()
+	if o == nil {
+		return launch(), nil
+	}
+	rootfs, err := x.mountOverlay(id, o)
+	if err != nil {
+		return 0, err
+	}
+	spec.rootMu.Lock()
+	rc, err := spec.withRootPath(rootfs, launch)
+	spec.rootMu.Unlock()
+	if err != nil || rc < 0 || !keep {
+		x.releaseOverlay(id)
+	}
+	return rc, err
+}
+
+// withRootPath calls fn with the spec's root.path set to path.
+func (s *ContainerSpec) withRootPath(path string, fn func() C.int) (C.int, error) {
+	old := C.GoString(s.c.container_def.root.path)
+	set := func(p string) error {
+		var ov C.struct_go_crun_overrides
+		ov.root_path = C.CString(p)
+		defer C.free(unsafe.Pointer(ov.root_path))
+		var err C.libcrun_error_t
+		if C.go_crun_apply_overrides(s.c, &ov, &err) < 0 {
+			return fromLibcrunErr(&err)
+		}
+		return nil
+	}
+	if err := set(path); err != nil {
+		return 0, err
+	}
+	rc := fn()
+	if err := set(old); err != nil {
+		return rc, errors.Join(errors.New("libcrun: cannot restore the spec's root path"), err)
+	}
+	return rc, nil
+}
+
+// overlayLaunchIO mounts the overlay rootfs of spec, if it requests one,
+// for a launch by a forked child, and returns ov with the root path
+// pointing at it, and whether it did. The fork must then hold
+// spec.rootMu for reading, as in-process launches rewrite the spec's root
+// path. Release the overlay if the launch fails, else pass the result to
+// overlayLaunched.
+func (x *RuntimeContext) overlayLaunchIO(id string, spec *ContainerSpec, ov *RunOverrides) (*RunOverrides, bool, error) {
+	o := spec.overlayRootfs()
+	if o == nil {
+		return ov, false, nil
+	}
+	rootfs, err := x.mountOverlay(id, o)
+	if err != nil {
+		return nil, false, err
+	}
+	var withRoot RunOverrides
+	if ov != nil {
+		withRoot = *ov
+	}
+	withRoot.RootPath = rootfs
+	return &withRoot, true, nil
+}
+
+// overlayLaunched releases the overlay of a forked launch once the child
+// exits, unless the container was detached and the child succeeded;
+// Delete releases it then.
+func (x *RuntimeContext) overlayLaunched(id string, res *RunResult) {
+	detach := bool(x.c.detach)
+	wait := res.Wait
+	res.Wait = func() (int, error) {
+		code, err := wait()
+		if !detach || err != nil || code != 0 {
+			x.releaseOverlay(id)
+		}
+		return code, err
+	}
+}
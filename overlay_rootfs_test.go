@@ -0,0 +1,74 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"reflect"
+	"syscall"
+	"testing"
+	"unsafe"
+)
+
+func TestOverlayRootfsFromSpec(t *testing.T) {
+	spec, err := NewSpec(false, WithOverlayRootfs([]string{"/a", "/b"}, 1<<20))
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	defer spec.Close()
+	o := spec.overlayRootfs()
+	if o == nil || !reflect.DeepEqual(o.lower, []string{"/a", "/b"}) || o.size != 1<<20 {
+		t.Fatalf("overlayRootfs = %+v", o)
+	}
+
+	plain, err := NewSpec(false, WithRootPath("/a"))
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	defer plain.Close()
+	if o := plain.overlayRootfs(); o != nil {
+		t.Errorf("overlayRootfs of a plain spec = %+v", o)
+	}
+}
+
+func TestOverlayRootfsMountAndDelete(t *testing.T) {
+	lower := t.TempDir()
+	if err := os.WriteFile(filepath.Join(lower, "file"), []byte("lower"), 0o644); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+	rc := fakeStateRoot(t, "c1")
+	rootfs, err := rc.mountOverlay("c1", &overlayRootfs{lower: []string{lower}, size: 1 << 20})
+	if errors.Is(err, syscall.EPERM) {
+		t.Skip("mounting needs CAP_SYS_ADMIN")
+	}
+	if err != nil {
+		t.Fatalf("mountOverlay failed: %v", err)
+	}
+	if _, err := rc.mountOverlay("c1", &overlayRootfs{lower: []string{lower}}); err == nil {
+		t.Error("second mountOverlay for the same container succeeded")
+	}
+
+	if err := os.WriteFile(filepath.Join(rootfs, "file"), []byte("upper"), 0o644); err != nil {
+		t.Fatalf("writing through the overlay failed: %v", err)
+	}
+	if b, _ := os.ReadFile(filepath.Join(lower, "file")); string(b) != "lower" {
+		t.Errorf("lower file = %q after a write through the overlay", b)
+	}
+	var st syscall.Statfs_t
+	if err := syscall.Statfs(rootfs, &st); err != nil || st.Type != 0x794c7630 { // OVERLAYFS_SUPER_MAGIC
+		t.Errorf("rootfs f_type = %#x, %v; want overlayfs", st.Type, err)
+	}
+	if ids, err := rc.ListIDs(); err != nil || !reflect.DeepEqual(ids, []string{"c1"}) {
+		t.Errorf("ListIDs = %v, %v; want [c1]", ids, err)
+	}
+
+	if err := rc.Get("c1").Delete(false); err != nil {
+		t.Fatalf("Delete failed: %v", err)
+	}
+	stateRoot := goStringAt(unsafe.Pointer(rc.c.state_root))
+	if _, err := os.Lstat(filepath.Join(stateRoot, ".overlay", "c1")); !os.IsNotExist(err) {
+		t.Errorf("overlay of a deleted container left behind: %v", err)
+	}
+}
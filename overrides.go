@@ -0,0 +1,99 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import "unsafe"
+
+// RunOverrides replaces a few per-run fields of a ContainerSpec at launch.
+//
+// A ContainerSpec is parsed once and can be launched any number of times;
+// with overrides, specs that differ only in these fields no longer need to
+// be rebuilt and re-parsed per container. The overrides are applied to the
+// launched child's copy of the spec, so the ContainerSpec itself is never
+// modified and may be shared by concurrent launches.
+type RunOverrides struct {
+	Args     []string // replaces process.args when non-nil
+	Env      []string // replaces process.env ("KEY=value") when non-nil
+	Cwd      string   // replaces process.cwd when non-empty
+	Hostname string   // replaces hostname when non-empty
+	RootPath string   // replaces root.path when non-empty
+}
+
+// cOverrides is a C copy of RunOverrides, valid until free is called.
+type cOverrides struct {
+	c *C.struct_go_crun_overrides
+}
+
+// toC converts o to C memory, along with the child's log verbosity
+// (< 0 inherits the process setting). A nil o without a verbosity yields a
+// nil C pointer.
+func (o *RunOverrides) toC(verbosity int) cOverrides {
+	if o == nil && verbosity < 0 {
+		return cOverrides{}
+	}
+	c := (*C.struct_go_crun_overrides)(C.calloc(1, C.size_t(unsafe.Sizeof(C.struct_go_crun_overrides{}))))
+	c.verbosity = C.int(verbosity)
+	if o == nil {
+		return cOverrides{c: c}
+	}
+	if o.Args != nil {
+		c.args = cStringVector(o.Args)
+		c.args_len = C.int(len(o.Args))
+	}
+	if o.Env != nil {
+		c.env = cStringVector(o.Env)
+		c.env_len = C.int(len(o.Env))
+	}
+	if o.Cwd != "" {
+		c.cwd = C.CString(o.Cwd)
+	}
+	if o.Hostname != "" {
+		c.hostname = C.CString(o.Hostname)
+	}
+	if o.RootPath != "" {
+		c.root_path = C.CString(o.RootPath)
+	}
+	return cOverrides{c: c}
+}
+
+func (co cOverrides) free() {
+	if co.c == nil {
+		return
+	}
+	freeCStringVector(co.c.args, int(co.c.args_len))
+	freeCStringVector(co.c.env, int(co.c.env_len))
+	C.free(unsafe.Pointer(co.c.cwd))
+	C.free(unsafe.Pointer(co.c.hostname))
+	C.free(unsafe.Pointer(co.c.root_path))
+	C.free(unsafe.Pointer(co.c))
+}
+
+// cStringVector copies v into a C-allocated, NULL-terminated char* array.
+func cStringVector(v []string) **C.char {
+	p := (**C.char)(C.calloc(C.size_t(len(v)+1), C.size_t(unsafe.Sizeof((*C.char)(nil)))))
+	arr := unsafe.Slice(p, len(v)+1)
+	for i, s := range v {
+		arr[i] = C.CString(s)
+	}
+	return p
+}
+
+func freeCStringVector(v **C.char, n int) {
+	if v == nil {
+		return
+	}
+	for _, s := range unsafe.Slice(v, n) {
+		C.free(unsafe.Pointer(s))
+	}
+	C.free(unsafe.Pointer(v))
+}
+
+// RunWithOverrides is RunWithIO with per-run overrides applied to the
+// launched container. A nil ov runs the spec as is.
+func (x *RuntimeContext) RunWithOverrides(id string, spec *ContainerSpec, ov *RunOverrides, ioCfg *IOConfig) (*RunResult, error) {
+	return x.runWithIO(id, spec, ov, ioCfg)
+}
@@ -0,0 +1,51 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"testing"
+	"unsafe"
+)
+
+func TestRunOverridesToCNil(t *testing.T) {
+	var ov *RunOverrides
+	co := ov.toC(-1)
+	if co.c != nil {
+		t.Error("nil overrides should convert to a nil C pointer")
+	}
+	co.free()
+}
+
+func TestRunOverridesToC(t *testing.T) {
+	ov := &RunOverrides{
+		Args:     []string{"/bin/echo", "hi"},
+		Env:      []string{},
+		Hostname: "box",
+	}
+	co := ov.toC(-1)
+	defer co.free()
+
+	if co.c.args_len != 2 {
+		t.Fatalf("args_len = %d, want 2", co.c.args_len)
+	}
+	args := unsafe.Slice(co.c.args, 3)
+	for i, want := range ov.Args {
+		if got := goStringAt(unsafe.Pointer(args[i])); got != want {
+			t.Errorf("args[%d] = %q, want %q", i, got, want)
+		}
+	}
+	if args[2] != nil {
+		t.Error("args vector should be NULL-terminated")
+	}
+
+	// An empty, non-nil Env clears the environment; it must not read as "keep"
+	if co.c.env == nil || co.c.env_len != 0 {
+		t.Error("empty Env should produce an empty vector")
+	}
+	if co.c.cwd != nil || co.c.root_path != nil {
+		t.Error("unset fields should stay NULL")
+	}
+	if got := goStringAt(unsafe.Pointer(co.c.hostname)); got != "box" {
+		t.Errorf("hostname = %q, want %q", got, "box")
+	}
+}
@@ -0,0 +1,377 @@
+//go:build linux
+
+package crun
+
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"slices"
+	"strconv"
+	"strings"
+	"sync"
+)
+
+// PlacerOptions configures NewPlacer.
+type PlacerOptions struct {
+	// SysfsRoot is where the topology is read from. Defaults to "/sys".
+	SysfsRoot string
+	// Reserved CPUs are never handed out, e.g. those of the host's
+	// housekeeping threads and interrupts.
+	Reserved []int
+}
+
+// Placement is a set of CPUs handed out by a Placer, with the NUMA nodes
+// they belong to.
+type Placement struct {
+	CPUs  []int // ascending
+	Nodes []int // ascending
+}
+
+// CPUList returns the CPUs in list format, e.g. "0-3,8".
+func (pl *Placement) CPUList() string { return formatCPUList(pl.CPUs) }
+
+// NodeList returns the memory nodes in list format.
+func (pl *Placement) NodeList() string { return formatCPUList(pl.Nodes) }
+
+// SpecOptions confine a container to the placement: its cpuset, memory
+// bound to the nodes of its CPUs, and processes exec'd into it pinned to
+// its CPUs.
+func (pl *Placement) SpecOptions() []SpecOption {
+	cpus, nodes := pl.CPUList(), pl.NodeList()
+	return []SpecOption{
+		WithCpuset(cpus, nodes),
+		WithMemPolicy(MemPolicyBind, nodes),
+		WithExecCPUAffinity("", cpus),
+	}
+}
+
+// Placer hands out exclusive CPU sets to containers, so that
+// latency-critical ones do not float across sockets or share caches. It
+// reads the CPU topology from sysfs once, and places each container on
+// the last-level cache with the fewest free CPUs that fits it, else on
+// the NUMA node with the fewest free CPUs that fits it, else across
+// nodes; hyperthreads of one core go to the same container.
+//
+//	pl, err := placer.Place(id, 4)
+//	...
+//	spec, err := crun.NewSpec(false, append(opts, pl.SpecOptions()...)...)
+//	...
+//	placer.Release(id) // once the container is deleted
+type Placer struct {
+	llcs   []cacheGroup
+	nodeOf map[int]int // CPU -> NUMA node
+
+	mu   sync.Mutex
+	used map[int]bool // reserved or placed CPUs
+	byID map[string]*Placement
+}
+
+// cacheGroup is the set of CPUs sharing a last-level cache.
+type cacheGroup struct {
+	node  int
+	cores [][]int // hyperthreads of each core, ascending
+}
+
+// NewPlacer reads the topology of the online CPUs.
+func NewPlacer(o PlacerOptions) (*Placer, error) {
+	if o.SysfsRoot == "" {
+		o.SysfsRoot = "/sys"
+	}
+	llcs, err := readCacheGroups(filepath.Join(o.SysfsRoot, "devices", "system"))
+	if err != nil {
+		return nil, err
+	}
+	p := &Placer{llcs: llcs, nodeOf: map[int]int{}, used: map[int]bool{}, byID: map[string]*Placement{}}
+	for _, g := range llcs {
+		for _, core := range g.cores {
+			for _, cpu := range core {
+				p.nodeOf[cpu] = g.node
+			}
+		}
+	}
+	for _, cpu := range o.Reserved {
+		p.used[cpu] = true
+	}
+	return p, nil
+}
+
+// Place hands out n CPUs to container id, until Release.
+func (p *Placer) Place(id string, n int) (*Placement, error) {
+	if n <= 0 {
+		return nil, errors.New("libcrun: placement needs at least one CPU")
+	}
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if _, ok := p.byID[id]; ok {
+		return nil, errors.New("libcrun: container " + id + " is already placed")
+	}
+
+	var groups []*cacheGroup
+	if g := p.bestFit(n); g >= 0 {
+		groups = []*cacheGroup{&p.llcs[g]}
+	} else {
+		free := map[int]int{}
+		for i := range p.llcs {
+			free[p.llcs[i].node] += p.free(&p.llcs[i])
+		}
+		node, best := -1, 0
+		for nd, f := range free {
+			if f >= n && (node < 0 || f < best || f == best && nd < node) {
+				node, best = nd, f
+			}
+		}
+		groups = p.byFree(func(g *cacheGroup) bool { return node < 0 || g.node == node })
+	}
+
+	var cpus []int
+	for _, g := range groups {
+		cpus = append(cpus, p.take(g, n-len(cpus))...)
+		if len(cpus) == n {
+			break
+		}
+	}
+	if len(cpus) < n {
+		for _, cpu := range cpus {
+			delete(p.used, cpu)
+		}
+		return nil, errors.New("libcrun: not enough free CPUs to place " + id)
+	}
+	slices.Sort(cpus)
+	pl := &Placement{CPUs: cpus}
+	for _, cpu := range cpus {
+		if node := p.nodeOf[cpu]; !slices.Contains(pl.Nodes, node) {
+			pl.Nodes = append(pl.Nodes, node)
+		}
+	}
+	slices.Sort(pl.Nodes)
+	p.byID[id] = pl
+	return pl, nil
+}
+
+// Release returns the CPUs of container id.
+func (p *Placer) Release(id string) {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if pl, ok := p.byID[id]; ok {
+		for _, cpu := range pl.CPUs {
+			delete(p.used, cpu)
+		}
+		delete(p.byID, id)
+	}
+}
+
+// Placement returns the placement of container id, or nil.
+func (p *Placer) Placement(id string) *Placement {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	return p.byID[id]
+}
+
+// Free returns the number of CPUs left to hand out.
+func (p *Placer) Free() int {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	n := 0
+	for i := range p.llcs {
+		n += p.free(&p.llcs[i])
+	}
+	return n
+}
+
+func (p *Placer) free(g *cacheGroup) int {
+	n := 0
+	for _, core := range g.cores {
+		for _, cpu := range core {
+			if !p.used[cpu] {
+				n++
+			}
+		}
+	}
+	return n
+}
+
+// bestFit returns the index of the cache group with the fewest free CPUs
+// that still has n, or -1.
+func (p *Placer) bestFit(n int) int {
+	best, bestFree := -1, 0
+	for i := range p.llcs {
+		if f := p.free(&p.llcs[i]); f >= n && (best < 0 || f < bestFree) {
+			best, bestFree = i, f
+		}
+	}
+	return best
+}
+
+// byFree returns the cache groups accepted by keep, most free CPUs first.
+func (p *Placer) byFree(keep func(*cacheGroup) bool) []*cacheGroup {
+	var groups []*cacheGroup
+	for i := range p.llcs {
+		if g := &p.llcs[i]; keep(g) && p.free(g) > 0 {
+			groups = append(groups, g)
+		}
+	}
+	slices.SortStableFunc(groups, func(a, b *cacheGroup) int { return p.free(b) - p.free(a) })
+	return groups
+}
+
+// take marks up to n free CPUs of g used and returns them: whole free
+// cores first, then the free hyperthreads of partly used ones.
+func (p *Placer) take(g *cacheGroup, n int) []int {
+	var cpus []int
+	for _, whole := range []bool{true, false} {
+		for _, core := range g.cores {
+			free := 0
+			for _, cpu := range core {
+				if !p.used[cpu] {
+					free++
+				}
+			}
+			if free == 0 || whole != (free == len(core)) {
+				continue
+			}
+			for _, cpu := range core {
+				if len(cpus) < n && !p.used[cpu] {
+					p.used[cpu] = true
+					cpus = append(cpus, cpu)
+				}
+			}
+		}
+	}
+	return cpus
+}
+
+// readCacheGroups groups the online CPUs under sys (/sys/devices/system)
+// by the last-level cache they share.
+func readCacheGroups(sys string) ([]cacheGroup, error) {
+	online, err := readCPUList(filepath.Join(sys, "cpu", "online"))
+	if err != nil {
+		return nil, err
+	}
+	nodeOf := map[int]int{}
+	nodes, _ := filepath.Glob(filepath.Join(sys, "node", "node[0-9]*"))
+	for _, dir := range nodes {
+		node, err := strconv.Atoi(strings.TrimPrefix(filepath.Base(dir), "node"))
+		if err != nil {
+			continue
+		}
+		cpus, err := readCPUList(filepath.Join(dir, "cpulist"))
+		if err != nil {
+			return nil, err
+		}
+		for _, cpu := range cpus {
+			nodeOf[cpu] = node
+		}
+	}
+
+	var llcs []cacheGroup
+	index := map[string]int{} // shared_cpu_list -> llcs index
+	seen := map[int]bool{}
+	for _, cpu := range online {
+		if seen[cpu] {
+			continue
+		}
+		dir := filepath.Join(sys, "cpu", "cpu"+strconv.Itoa(cpu))
+		core, err := readCPUList(filepath.Join(dir, "topology", "thread_siblings_list"))
+		if err != nil || !slices.Contains(core, cpu) {
+			core = []int{cpu}
+		}
+		core = slices.DeleteFunc(core, func(c int) bool { return !slices.Contains(online, c) })
+		for _, c := range core {
+			seen[c] = true
+		}
+		key := lastLevelCache(dir)
+		if key == "" {
+			key = "node" + strconv.Itoa(nodeOf[cpu])
+		}
+		i, ok := index[key]
+		if !ok {
+			i = len(llcs)
+			index[key] = i
+			llcs = append(llcs, cacheGroup{node: nodeOf[cpu]})
+		}
+		llcs[i].cores = append(llcs[i].cores, core)
+	}
+	if len(llcs) == 0 {
+		return nil, errors.New("libcrun: no online CPUs under " + sys)
+	}
+	return llcs, nil
+}
+
+// lastLevelCache returns the shared_cpu_list of the highest level data
+// or unified cache of the CPU at dir, or "" if sysfs has none.
+func lastLevelCache(dir string) string {
+	indexes, _ := filepath.Glob(filepath.Join(dir, "cache", "index[0-9]*"))
+	shared, best := "", -1
+	for _, idx := range indexes {
+		if typ, _ := os.ReadFile(filepath.Join(idx, "type")); strings.TrimSpace(string(typ)) == "Instruction" {
+			continue
+		}
+		b, err := os.ReadFile(filepath.Join(idx, "level"))
+		if err != nil {
+			continue
+		}
+		level, err := strconv.Atoi(strings.TrimSpace(string(b)))
+		if err != nil || level <= best {
+			continue
+		}
+		if list, err := os.ReadFile(filepath.Join(idx, "shared_cpu_list")); err == nil {
+			shared, best = strings.TrimSpace(string(list)), level
+		}
+	}
+	return shared
+}
+
+func readCPUList(path string) ([]int, error) {
+	b, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	return parseCPUList(strings.TrimSpace(string(b)))
+}
+
+// parseCPUList parses a list in the kernel's list format ("0-3,8").
+func parseCPUList(s string) ([]int, error) {
+	var out []int
+	if s == "" {
+		return nil, nil
+	}
+	for _, part := range strings.Split(s, ",") {
+		lo, hi, isRange := strings.Cut(part, "-")
+		a, err := strconv.Atoi(lo)
+		if err != nil {
+			return nil, errors.New("libcrun: invalid CPU list " + strconv.Quote(s))
+		}
+		b := a
+		if isRange {
+			if b, err = strconv.Atoi(hi); err != nil || b < a {
+				return nil, errors.New("libcrun: invalid CPU list " + strconv.Quote(s))
+			}
+		}
+		for i := a; i <= b; i++ {
+			out = append(out, i)
+		}
+	}
+	return out, nil
+}
+
+// formatCPUList formats ascending ids in list format.
+func formatCPUList(ids []int) string {
+	var sb strings.Builder
+	for i := 0; i < len(ids); {
+		j := i
+		for j+1 < len(ids) && ids[j+1] == ids[j]+1 {
+			j++
+		}
+		if sb.Len() > 0 {
+			sb.WriteByte(',')
+		}
+		sb.WriteString(strconv.Itoa(ids[i]))
+		if j > i {
+			sb.WriteByte('-')
+			sb.WriteString(strconv.Itoa(ids[j]))
+		}
+		i = j + 1
+	}
+	return sb.String()
+}
@@ -0,0 +1,158 @@
+//go:build linux
+
+package crun
+
+import (
+	"os"
+	"path/filepath"
+	"reflect"
+	"strconv"
+	"testing"
+)
+
+// fakeTopology writes a sysfs with two nodes of two last-level caches of
+// two cores of two hyperthreads: core c of 0-7 has siblings c and c+8,
+// cores 0-1 share a cache, 2-3 the next, ... and node0 has cores 0-3.
+func fakeTopology(t *testing.T) string {
+	t.Helper()
+	root := t.TempDir()
+	sys := filepath.Join(root, "devices", "system")
+	write := func(path, content string) {
+		t.Helper()
+		path = filepath.Join(sys, path)
+		if err := os.MkdirAll(filepath.Dir(path), 0o755); err != nil {
+			t.Fatal(err)
+		}
+		if err := os.WriteFile(path, []byte(content+"\n"), 0o644); err != nil {
+			t.Fatal(err)
+		}
+	}
+	write("cpu/online", "0-15")
+	write("node/node0/cpulist", "0-3,8-11")
+	write("node/node1/cpulist", "4-7,12-15")
+	for cpu := 0; cpu < 16; cpu++ {
+		core := cpu % 8
+		dir := "cpu/cpu" + strconv.Itoa(cpu)
+		write(dir+"/topology/thread_siblings_list", strconv.Itoa(core)+","+strconv.Itoa(core+8))
+		write(dir+"/cache/index0/level", "1")
+		write(dir+"/cache/index0/type", "Data")
+		write(dir+"/cache/index0/shared_cpu_list", strconv.Itoa(core)+","+strconv.Itoa(core+8))
+		llc := core / 2 * 2
+		write(dir+"/cache/index3/level", "3")
+		write(dir+"/cache/index3/type", "Unified")
+		write(dir+"/cache/index3/shared_cpu_list", formatCPUList([]int{llc, llc + 1, llc + 8, llc + 9}))
+	}
+	return root
+}
+
+func TestPlacer(t *testing.T) {
+	p, err := NewPlacer(PlacerOptions{SysfsRoot: fakeTopology(t)})
+	if err != nil {
+		t.Fatalf("NewPlacer failed: %v", err)
+	}
+	place := func(id string, n int, cpus string, nodes []int) {
+		t.Helper()
+		pl, err := p.Place(id, n)
+		if err != nil {
+			t.Fatalf("Place(%s, %d) failed: %v", id, n, err)
+		}
+		if pl.CPUList() != cpus || !reflect.DeepEqual(pl.Nodes, nodes) {
+			t.Errorf("Place(%s, %d) = %s on nodes %v, want %s on %v", id, n, pl.CPUList(), pl.Nodes, cpus, nodes)
+		}
+	}
+	place("siblings", 2, "0,8", []int{0})       // both threads of one core
+	place("llc", 4, "2-3,10-11", []int{0})      // a whole cache, not the part-used one
+	place("node", 6, "4-6,12-14", []int{1})     // two caches of the free node
+	place("spread", 4, "1,7,9,15", []int{0, 1}) // what is left, across nodes
+
+	if n := p.Free(); n != 0 {
+		t.Errorf("Free = %d, want 0", n)
+	}
+	if _, err := p.Place("more", 1); err == nil {
+		t.Error("Place beyond capacity succeeded")
+	}
+	if _, err := p.Place("llc", 1); err == nil {
+		t.Error("Place of a placed container succeeded")
+	}
+	p.Release("llc")
+	if p.Placement("llc") != nil || p.Free() != 4 {
+		t.Errorf("after Release: placement %v, Free = %d", p.Placement("llc"), p.Free())
+	}
+	place("again", 3, "2-3,10", []int{0})
+	if got := p.Placement("again"); got == nil || got.CPUList() != "2-3,10" {
+		t.Errorf("Placement = %v", got)
+	}
+}
+
+func TestPlacerReserved(t *testing.T) {
+	p, err := NewPlacer(PlacerOptions{SysfsRoot: fakeTopology(t), Reserved: []int{0, 8}})
+	if err != nil {
+		t.Fatalf("NewPlacer failed: %v", err)
+	}
+	if n := p.Free(); n != 14 {
+		t.Errorf("Free = %d, want 14", n)
+	}
+	pl, err := p.Place("a", 2)
+	if err != nil {
+		t.Fatalf("Place failed: %v", err)
+	}
+	if pl.CPUList() != "1,9" {
+		t.Errorf("Place = %s, want the free core of the reserved one's cache", pl.CPUList())
+	}
+}
+
+func TestPlacerWithoutCacheInfo(t *testing.T) {
+	root := fakeTopology(t)
+	for cpu := 0; cpu < 16; cpu++ {
+		os.RemoveAll(filepath.Join(root, "devices", "system", "cpu", "cpu"+strconv.Itoa(cpu), "cache"))
+	}
+	p, err := NewPlacer(PlacerOptions{SysfsRoot: root})
+	if err != nil {
+		t.Fatalf("NewPlacer failed: %v", err)
+	}
+	pl, err := p.Place("a", 8)
+	if err != nil {
+		t.Fatalf("Place failed: %v", err)
+	}
+	if pl.CPUList() != "0-3,8-11" {
+		t.Errorf("Place = %s, want node0", pl.CPUList())
+	}
+}
+
+func TestPlacementSpecOptions(t *testing.T) {
+	pl := &Placement{CPUs: []int{2, 3, 10}, Nodes: []int{0}}
+	sp, err := DefaultSpec(false)
+	if err != nil {
+		t.Fatalf("DefaultSpec failed: %v", err)
+	}
+	for _, opt := range pl.SpecOptions() {
+		opt(sp)
+	}
+	if cpu := sp.Linux.Resources.CPU; cpu.Cpus != "2-3,10" || cpu.Mems != "0" {
+		t.Errorf("cpuset = %q/%q", cpu.Cpus, cpu.Mems)
+	}
+	if got := sp.Annotations[memPolicyAnnotation]; got != `{"mode":"MPOL_BIND","nodes":"0"}` {
+		t.Errorf("memory policy = %s", got)
+	}
+	if got := sp.Annotations[execCPUAffinityAnnotation]; got != `{"final":"2-3,10"}` {
+		t.Errorf("exec CPU affinity = %s", got)
+	}
+}
+
+func TestParseCPUList(t *testing.T) {
+	for _, s := range []string{"", "0", "0-3", "0-3,8", "1,3,5-7"} {
+		ids, err := parseCPUList(s)
+		if err != nil {
+			t.Errorf("parseCPUList(%q) failed: %v", s, err)
+			continue
+		}
+		if got := formatCPUList(ids); got != s {
+			t.Errorf("formatCPUList(parseCPUList(%q)) = %q", s, got)
+		}
+	}
+	for _, s := range []string{"a", "3-1", "1-", ",1"} {
+		if _, err := parseCPUList(s); err == nil {
+			t.Errorf("parseCPUList(%q) succeeded", s)
+		}
+	}
+}
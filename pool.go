@@ -0,0 +1,256 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"context"
+	"errors"
+	"strconv"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// WarmPoolOptions configures NewWarmPool.
+type WarmPoolOptions struct {
+	// Size is the number of created containers kept ready. It must be
+	// positive.
+	Size int
+	// MaxIdle, if positive, deletes containers that waited longer than
+	// this and creates fresh ones in their place.
+	MaxIdle time.Duration
+	// IDPrefix prefixes the generated container IDs (followed by a
+	// sequence number). Defaults to "warm-".
+	IDPrefix string
+	// Create is passed to RuntimeContext.Create. Prefork is always set.
+	Create CreateOptions
+}
+
+// Backoff bounds of the refill loop after a failed creation.
+const (
+	warmPoolMinBackoff = 100 * time.Millisecond
+	warmPoolMaxBackoff = 5 * time.Second
+)
+
+// WarmPool keeps containers of one spec in the created state, with
+// namespaces, cgroup and mounts already set up, so that serving a request
+// only costs Container.Start. A background goroutine refills the pool
+// after each Get and replaces containers idle for longer than MaxIdle.
+//
+// Pooled containers are created with the spec's process and stdio: to
+// talk to them use a terminal with a console socket, or files and sockets
+// set up in the spec. Use one pool per spec template.
+//
+//	pool, err := rc.NewWarmPool(spec, crun.WarmPoolOptions{Size: 8, MaxIdle: 10 * time.Minute})
+//	...
+//	ctr, err := pool.Get(ctx)
+//	...
+//	err = ctr.Start()
+type WarmPool struct {
+	x      *RuntimeContext
+	spec   *ContainerSpec
+	opts   WarmPoolOptions
+	create func(id string) (*Container, error)
+
+	mu     sync.Mutex
+	idle   []warmEntry // oldest first
+	closed bool
+	seq    atomic.Uint64
+
+	wake    chan struct{}
+	done    chan struct{}
+	stopped chan struct{}
+	lastErr atomic.Pointer[error]
+}
+
+type warmEntry struct {
+	ctr     *Container
+	created time.Time
+}
+
+// NewWarmPool starts filling a pool of created containers from spec,
+// which must stay valid until the pool is closed.
+func (x *RuntimeContext) NewWarmPool(spec *ContainerSpec, o WarmPoolOptions) (*WarmPool, error) {
+	if x == nil || x.c == nil || spec == nil || spec.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context or container spec")
+	}
+	if o.Size <= 0 {
+		return nil, errors.New("libcrun: warm pool size must be positive")
+	}
+	if o.IDPrefix == "" {
+		o.IDPrefix = "warm-"
+	}
+	o.Create.Prefork = true
+	p := newWarmPool(x, spec, o, func(id string) (*Container, error) {
+		return x.Create(id, spec, o.Create)
+	})
+	return p, nil
+}
+
+func newWarmPool(x *RuntimeContext, spec *ContainerSpec, o WarmPoolOptions, create func(string) (*Container, error)) *WarmPool {
+	p := &WarmPool{
+		x:       x,
+		spec:    spec,
+		opts:    o,
+		create:  create,
+		wake:    make(chan struct{}, 1),
+		done:    make(chan struct{}),
+		stopped: make(chan struct{}),
+	}
+	go p.refill()
+	return p
+}
+
+// Get hands out a created container; the caller owns it and is expected
+// to Start it and eventually Delete it. When the pool is empty a
+// container is created synchronously instead of waiting for the refill.
+func (p *WarmPool) Get(ctx context.Context) (*Container, error) {
+	if err := ctx.Err(); err != nil {
+		return nil, err
+	}
+	p.mu.Lock()
+	if p.closed {
+		p.mu.Unlock()
+		return nil, errors.New("libcrun: warm pool closed")
+	}
+	var ctr *Container
+	if n := len(p.idle); n > 0 {
+		ctr = p.idle[0].ctr
+		p.idle = append(p.idle[:0], p.idle[1:]...)
+	}
+	p.mu.Unlock()
+	p.kick()
+	if ctr != nil {
+		return ctr, nil
+	}
+	return p.create(p.nextID())
+}
+
+// Len returns the number of containers ready to be handed out.
+func (p *WarmPool) Len() int {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	return len(p.idle)
+}
+
+// Err returns the error of the last failed background creation, or nil
+// once a creation succeeded again.
+func (p *WarmPool) Err() error {
+	if e := p.lastErr.Load(); e != nil {
+		return *e
+	}
+	return nil
+}
+
+// Close stops refilling and deletes the containers still in the pool.
+// Containers handed out by Get are not affected.
+func (p *WarmPool) Close() error {
+	p.mu.Lock()
+	if p.closed {
+		p.mu.Unlock()
+		<-p.stopped
+		return nil
+	}
+	p.closed = true
+	close(p.done)
+	p.mu.Unlock()
+	<-p.stopped
+
+	p.mu.Lock()
+	idle := p.idle
+	p.idle = nil
+	p.mu.Unlock()
+	var firstErr error
+	for _, e := range idle {
+		if err := e.ctr.Delete(true); err != nil && firstErr == nil {
+			firstErr = err
+		}
+	}
+	return firstErr
+}
+
+func (p *WarmPool) nextID() string {
+	return p.opts.IDPrefix + strconv.FormatUint(p.seq.Add(1), 10)
+}
+
+func (p *WarmPool) kick() {
+	select {
+	case p.wake <- struct{}{}:
+	default:
+	}
+}
+
+// refill keeps the pool at its target size until Close.
+func (p *WarmPool) refill() {
+	defer close(p.stopped)
+	var expire <-chan time.Time
+	if p.opts.MaxIdle > 0 {
+		t := time.NewTicker(max(p.opts.MaxIdle/2, time.Millisecond))
+		defer t.Stop()
+		expire = t.C
+	}
+	backoff := warmPoolMinBackoff
+	for {
+		failed := false
+		for !failed && p.need() {
+			ctr, err := p.create(p.nextID())
+			if err != nil {
+				p.lastErr.Store(&err)
+				failed = true
+				break
+			}
+			p.lastErr.Store(nil)
+			backoff = warmPoolMinBackoff
+			if !p.put(ctr) {
+				_ = ctr.Delete(true) // closed meanwhile
+				return
+			}
+		}
+		var retry <-chan time.Time
+		if failed {
+			retry = time.After(backoff)
+			backoff = min(backoff*2, warmPoolMaxBackoff)
+		}
+		select {
+		case <-p.done:
+			return
+		case <-p.wake:
+		case <-retry:
+		case <-expire:
+			p.evictExpired()
+		}
+	}
+}
+
+// need reports whether the pool is below its target size.
+func (p *WarmPool) need() bool {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	return !p.closed && len(p.idle) < p.opts.Size
+}
+
+func (p *WarmPool) put(ctr *Container) bool {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.closed {
+		return false
+	}
+	p.idle = append(p.idle, warmEntry{ctr: ctr, created: time.Now()})
+	return true
+}
+
+// evictExpired deletes the containers idle for longer than MaxIdle.
+func (p *WarmPool) evictExpired() {
+	cutoff := time.Now().Add(-p.opts.MaxIdle)
+	p.mu.Lock()
+	n := 0
+	for n < len(p.idle) && p.idle[n].created.Before(cutoff) {
+		n++
+	}
+	expired := append([]warmEntry(nil), p.idle[:n]...)
+	p.idle = append(p.idle[:0], p.idle[n:]...)
+	p.mu.Unlock()
+	for _, e := range expired {
+		_ = e.ctr.Delete(true)
+	}
+}
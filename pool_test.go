@@ -0,0 +1,118 @@
+//go:build linux
+
+package crun
+
+import (
+	"context"
+	"errors"
+	"os"
+	"path/filepath"
+	"sync/atomic"
+	"testing"
+	"time"
+	"unsafe"
+)
+
+// fakeWarmPool returns a pool whose containers are fake state directories.
+func fakeWarmPool(t *testing.T, o WarmPoolOptions, fail *atomic.Bool) (*WarmPool, string) {
+	t.Helper()
+	rc := fakeStateRoot(t)
+	root := goStringAt(unsafe.Pointer(rc.c.state_root))
+	if o.IDPrefix == "" {
+		o.IDPrefix = "warm-"
+	}
+	p := newWarmPool(rc, nil, o, func(id string) (*Container, error) {
+		if fail != nil && fail.Load() {
+			return nil, errWarmTest
+		}
+		writeFakeContainer(t, root, id)
+		return rc.Get(id), nil
+	})
+	t.Cleanup(func() { p.Close() })
+	return p, root
+}
+
+var errWarmTest = errors.New("boom")
+
+func waitFor(t *testing.T, what string, cond func() bool) {
+	t.Helper()
+	deadline := time.Now().Add(5 * time.Second)
+	for !cond() {
+		if time.Now().After(deadline) {
+			t.Fatalf("timed out waiting for %s", what)
+		}
+		time.Sleep(time.Millisecond)
+	}
+}
+
+func TestWarmPoolRefill(t *testing.T) {
+	p, root := fakeWarmPool(t, WarmPoolOptions{Size: 3}, nil)
+	waitFor(t, "pool to fill", func() bool { return p.Len() == 3 })
+
+	seen := map[string]bool{}
+	for i := 0; i < 5; i++ {
+		ctr, err := p.Get(context.Background())
+		if err != nil {
+			t.Fatalf("Get failed: %v", err)
+		}
+		if seen[ctr.ID] {
+			t.Fatalf("container %s handed out twice", ctr.ID)
+		}
+		seen[ctr.ID] = true
+	}
+	waitFor(t, "pool to refill", func() bool { return p.Len() == 3 })
+
+	// Close deletes only the containers still pooled
+	if err := p.Close(); err != nil {
+		t.Fatalf("Close failed: %v", err)
+	}
+	entries, _ := os.ReadDir(root)
+	if len(entries) != len(seen) {
+		t.Errorf("%d state directories left after Close, want the %d handed out", len(entries), len(seen))
+	}
+	for _, e := range entries {
+		if !seen[e.Name()] {
+			t.Errorf("pooled container %s not deleted by Close", e.Name())
+		}
+	}
+	if _, err := p.Get(context.Background()); err == nil {
+		t.Error("Get after Close succeeded")
+	}
+}
+
+func TestWarmPoolMaxIdle(t *testing.T) {
+	p, root := fakeWarmPool(t, WarmPoolOptions{Size: 2, MaxIdle: 20 * time.Millisecond}, nil)
+	waitFor(t, "pool to fill", func() bool { return p.Len() == 2 })
+	first := map[string]bool{}
+	p.mu.Lock()
+	for _, e := range p.idle {
+		first[e.ctr.ID] = true
+	}
+	p.mu.Unlock()
+
+	waitFor(t, "idle containers to be replaced", func() bool {
+		for id := range first {
+			if _, err := os.Stat(filepath.Join(root, id)); err == nil {
+				return false
+			}
+		}
+		return p.Len() == 2
+	})
+}
+
+func TestWarmPoolCreateError(t *testing.T) {
+	var fail atomic.Bool
+	fail.Store(true)
+	p, _ := fakeWarmPool(t, WarmPoolOptions{Size: 1}, &fail)
+	waitFor(t, "background error", func() bool { return p.Err() != nil })
+	if _, err := p.Get(context.Background()); err != errWarmTest {
+		t.Errorf("Get = %v, want the creation error", err)
+	}
+
+	fail.Store(false)
+	// The refill loop retries after its backoff
+	waitFor(t, "pool to recover", func() bool { return p.Len() == 1 })
+	if p.Err() != nil {
+		t.Errorf("Err = %v after recovery, want nil", p.Err())
+	}
+}
@@ -0,0 +1,96 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"runtime"
+	"unsafe"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+// PreparedExec is a process parsed once on the C side and executed any
+// number of times, against any container.
+//
+// Container.Exec serializes the process to JSON and has libcrun parse it
+// back on every call. For periodic execs of the same command (health
+// checks, probes) a PreparedExec skips that work; ExecOverrides still lets
+// each call change the environment and working directory. A PreparedExec
+// may be used concurrently; call Close when done.
+type PreparedExec struct {
+	c      *C.runtime_spec_schema_config_schema_process
+	cgroup string
+}
+
+// ExecOverrides replaces fields of a PreparedExec for one exec.
+type ExecOverrides struct {
+	Env []string // replaces process.env ("KEY=value") when non-nil
+	Cwd string   // replaces process.cwd when non-empty
+}
+
+// PrepareExec parses proc, with opts applied (see Container.Exec), into a
+// reusable PreparedExec.
+func PrepareExec(proc *specs.Process, opts ...ExecOption) (*PreparedExec, error) {
+	if proc == nil {
+		return nil, errors.New("libcrun: nil process")
+	}
+	b, cfg, err := execProcessJSON(proc, opts)
+	if err != nil {
+		return nil, err
+	}
+	cjson := C.CString(string(b))
+	defer C.free(unsafe.Pointer(cjson))
+	var cerr C.libcrun_error_t
+	c := C.go_crun_prepare_process(cjson, &cerr)
+	if c == nil {
+		return nil, fromLibcrunErr(&cerr)
+	}
+	p := &PreparedExec{c: c, cgroup: cfg.cgroup}
+	runtime.SetFinalizer(p, func(pp *PreparedExec) { _ = pp.Close() })
+	return p, nil
+}
+
+// Exec executes the prepared process in ctr, as Container.Exec does. A nil
+// ov runs it as prepared.
+func (p *PreparedExec) Exec(ctr *Container, ov *ExecOverrides) error {
+	if p == nil || p.c == nil {
+		return errors.New("libcrun: prepared exec closed")
+	}
+	err := ctr.runtime.execPrepared(ctr.ID, ctr.ref(), p.c, ov.runOverrides(), p.cgroup)
+	runtime.KeepAlive(p)
+	return err
+}
+
+// ExecWithIO executes the prepared process in ctr with isolated I/O, as
+// Container.ExecWithIO does. The PreparedExec may be closed once it
+// returns.
+func (p *PreparedExec) ExecWithIO(ctr *Container, ov *ExecOverrides, ioCfg *IOConfig) (*RunResult, error) {
+	if p == nil || p.c == nil {
+		return nil, errors.New("libcrun: prepared exec closed")
+	}
+	res, err := ctr.runtime.execWithIO(ctr.ID, ctr.ref(), "", p.c, ov.runOverrides(), p.cgroup, ioCfg)
+	runtime.KeepAlive(p)
+	return res, err
+}
+
+// Close releases the parsed process. It must not race with Exec calls.
+func (p *PreparedExec) Close() error {
+	if p == nil || p.c == nil {
+		return nil
+	}
+	C.go_crun_free_process(p.c)
+	p.c = nil
+	return nil
+}
+
+func (o *ExecOverrides) runOverrides() *RunOverrides {
+	if o == nil || (o.Env == nil && o.Cwd == "") {
+		return nil
+	}
+	return &RunOverrides{Env: o.Env, Cwd: o.Cwd}
+}
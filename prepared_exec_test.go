@@ -0,0 +1,61 @@
+//go:build linux
+
+package crun
+
+import (
+	"testing"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+func TestPrepareExec(t *testing.T) {
+	p, err := PrepareExec(&specs.Process{Args: []string{"true"}, Cwd: "/"}, WithExecCgroup("probes"))
+	if err != nil {
+		t.Fatalf("PrepareExec failed: %v", err)
+	}
+	if p.cgroup != "probes" {
+		t.Errorf("cgroup = %q, want probes", p.cgroup)
+	}
+	if err := p.Close(); err != nil {
+		t.Fatalf("Close failed: %v", err)
+	}
+	if err := p.Close(); err != nil {
+		t.Errorf("second Close failed: %v", err)
+	}
+	if err := p.Exec(fakeStateRoot(t).Get("c1"), nil); err == nil {
+		t.Error("Exec after Close succeeded")
+	}
+	if _, err := PrepareExec(nil); err == nil {
+		t.Error("PrepareExec(nil) succeeded")
+	}
+}
+
+func TestPreparedExecWithIONotRunning(t *testing.T) {
+	p, err := PrepareExec(&specs.Process{Args: []string{"true"}, Cwd: "/"})
+	if err != nil {
+		t.Fatalf("PrepareExec failed: %v", err)
+	}
+	defer p.Close()
+	ctr := fakeStateRoot(t, "c1").Get("c1")
+	// The same prepared process, run repeatedly with and without overrides
+	for _, ov := range []*ExecOverrides{nil, {Env: []string{"A=1"}, Cwd: "/tmp"}, nil} {
+		res, err := p.ExecWithIO(ctr, ov, &IOConfig{})
+		if err != nil {
+			t.Fatalf("ExecWithIO failed: %v", err)
+		}
+		if code, err := res.Wait(); err != nil || code == 0 {
+			t.Errorf("Wait = %d, %v; want a non-zero exit code", code, err)
+		}
+	}
+}
+
+func TestExecOverridesRunOverrides(t *testing.T) {
+	var nilOv *ExecOverrides
+	if nilOv.runOverrides() != nil || (&ExecOverrides{}).runOverrides() != nil {
+		t.Error("empty overrides should convert to nil")
+	}
+	ro := (&ExecOverrides{Env: []string{"A=1"}, Cwd: "/x"}).runOverrides()
+	if ro == nil || len(ro.Env) != 1 || ro.Cwd != "/x" || ro.Args != nil {
+		t.Errorf("runOverrides = %+v", ro)
+	}
+}
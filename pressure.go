@@ -0,0 +1,322 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"context"
+	"errors"
+	"path/filepath"
+	"strconv"
+	"sync"
+	"syscall"
+	"time"
+)
+
+// PressureResource is a resource tracked by pressure stall information.
+type PressureResource string
+
+// Resources accepted in a PressureTrigger.
+const (
+	PressureCPU    PressureResource = "cpu"
+	PressureMemory PressureResource = "memory"
+	PressureIO     PressureResource = "io"
+)
+
+// PressureKind selects which stall a PressureTrigger measures.
+type PressureKind string
+
+const (
+	// PressureSome counts time during which at least one task stalled.
+	PressureSome PressureKind = "some"
+	// PressureFull counts time during which all non-idle tasks stalled.
+	PressureFull PressureKind = "full"
+)
+
+// Kernel limits of a PSI trigger window.
+const (
+	minPressureWindow = 500 * time.Millisecond
+	maxPressureWindow = 10 * time.Second
+)
+
+// PressureTrigger fires when the tasks of a cgroup stall on Resource for
+// more than Threshold within any Window. Window must be between 500ms and
+// 10s, and a multiple of 2s for callers without CAP_SYS_RESOURCE; Threshold
+// must not exceed it. The kernel limits the rate of events to one per window.
+type PressureTrigger struct {
+	Resource  PressureResource
+	Kind      PressureKind // "" means PressureSome
+	Threshold time.Duration
+	Window    time.Duration
+}
+
+// PressureEvent reports that a trigger fired.
+type PressureEvent struct {
+	ID      string
+	Trigger PressureTrigger
+	Time    time.Time
+}
+
+// pressureEventsBuffer is the channel capacity of a WatchPressure subscriber.
+const pressureEventsBuffer = 16
+
+// WatchPressure registers PSI triggers on the container's cgroup and
+// delivers an event each time one fires, until ctx is cancelled or the
+// cgroup is removed; the channel is then closed. cgroup v2 only.
+//
+// The triggers of all containers of a RuntimeContext are multiplexed on a
+// single epoll instance served by one goroutine. Events that find the
+// channel full are dropped: the next one follows at most one window later
+// if the stall persists.
+func (c *Container) WatchPressure(ctx context.Context, triggers ...PressureTrigger) (<-chan PressureEvent, error) {
+	x := c.runtime
+	if x == nil || x.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context")
+	}
+	if len(triggers) == 0 {
+		return nil, errors.New("libcrun: no pressure trigger")
+	}
+	triggers = append([]PressureTrigger(nil), triggers...) // command fills in defaults
+	cmds := make([][]byte, len(triggers))
+	for i := range triggers {
+		cmd, err := triggers[i].command()
+		if err != nil {
+			return nil, err
+		}
+		cmds[i] = cmd
+	}
+
+	var st ContainerState
+	var cgroup string
+	if err := x.readState(c.ID, c.ref(), false, &st, &cgroup); err != nil {
+		return nil, err
+	}
+	if cgroup == "" {
+		return nil, errors.New("libcrun: container " + c.ID + " has no cgroup")
+	}
+	dir := filepath.Join(cgroupRoot, cgroup)
+
+	fds := make([]int, 0, len(triggers))
+	closeAll := func() {
+		for _, fd := range fds {
+			syscall.Close(fd)
+		}
+	}
+	for i, t := range triggers {
+		path := filepath.Join(dir, string(t.Resource)+".pressure")
+		fd, err := syscall.Open(path, syscall.O_RDWR|syscall.O_NONBLOCK|syscall.O_CLOEXEC, 0)
+		if err != nil {
+			closeAll()
+			return nil, errnoError("cannot open "+path, err)
+		}
+		fds = append(fds, fd)
+		// The trigger lives as long as the descriptor
+		if _, err := syscall.Write(fd, cmds[i]); err != nil {
+			closeAll()
+			return nil, errnoError("cannot register pressure trigger on "+path, err)
+		}
+	}
+	ch, err := x.pressure.subscribe(ctx, c.ID, triggers, fds)
+	if err != nil {
+		closeAll()
+		return nil, err
+	}
+	return ch, nil
+}
+
+// command returns the line written to the pressure file.
+func (t *PressureTrigger) command() ([]byte, error) {
+	switch t.Resource {
+	case PressureCPU, PressureMemory, PressureIO:
+	default:
+		return nil, errors.New("libcrun: invalid pressure resource " + strconv.Quote(string(t.Resource)))
+	}
+	if t.Kind == "" {
+		t.Kind = PressureSome
+	}
+	if t.Kind != PressureSome && t.Kind != PressureFull {
+		return nil, errors.New("libcrun: invalid pressure kind " + strconv.Quote(string(t.Kind)))
+	}
+	if t.Window < minPressureWindow || t.Window > maxPressureWindow {
+		return nil, errors.New("libcrun: pressure window must be between 500ms and 10s")
+	}
+	if t.Threshold <= 0 || t.Threshold > t.Window {
+		return nil, errors.New("libcrun: pressure threshold must be positive and within the window")
+	}
+	b := append([]byte(t.Kind), ' ')
+	b = strconv.AppendInt(b, t.Threshold.Microseconds(), 10)
+	b = append(b, ' ')
+	b = strconv.AppendInt(b, t.Window.Microseconds(), 10)
+	return append(b, 0), nil // the kernel wants the terminating NUL
+}
+
+// pressureWatcher is the epoll loop shared by the WatchPressure
+// subscriptions of a RuntimeContext.
+type pressureWatcher struct {
+	mu       sync.Mutex
+	epfd     int
+	wake     [2]int // pipe waking the loop on close
+	started  bool
+	closed   bool
+	next     uint64 // token generator: epoll data, never reused
+	triggers map[uint64]*pressureTrig
+}
+
+type pressureSub struct {
+	id     string
+	ch     chan PressureEvent
+	trigs  []*pressureTrig
+	stop   func() bool
+	closed bool
+}
+
+type pressureTrig struct {
+	sub     *pressureSub
+	token   uint64
+	fd      int
+	trigger PressureTrigger
+}
+
+// pressureWakeToken identifies the wake pipe in the epoll set.
+const pressureWakeToken = 0
+
+func epollData(ev *syscall.EpollEvent, token uint64) {
+	ev.Fd = int32(uint32(token))
+	ev.Pad = int32(uint32(token >> 32))
+}
+
+func epollToken(ev *syscall.EpollEvent) uint64 {
+	return uint64(uint32(ev.Fd)) | uint64(uint32(ev.Pad))<<32
+}
+
+func (w *pressureWatcher) start() error {
+	epfd, err := syscall.EpollCreate1(syscall.EPOLL_CLOEXEC)
+	if err != nil {
+		return errors.New("libcrun: epoll_create1: " + err.Error())
+	}
+	var p [2]int
+	if err := syscall.Pipe2(p[:], syscall.O_NONBLOCK|syscall.O_CLOEXEC); err != nil {
+		syscall.Close(epfd)
+		return errors.New("libcrun: pipe2: " + err.Error())
+	}
+	ev := syscall.EpollEvent{Events: syscall.EPOLLIN}
+	epollData(&ev, pressureWakeToken)
+	if err := syscall.EpollCtl(epfd, syscall.EPOLL_CTL_ADD, p[0], &ev); err != nil {
+		syscall.Close(epfd)
+		syscall.Close(p[0])
+		syscall.Close(p[1])
+		return errors.New("libcrun: epoll_ctl: " + err.Error())
+	}
+	w.epfd, w.wake, w.started = epfd, p, true
+	w.next = pressureWakeToken + 1
+	w.triggers = make(map[uint64]*pressureTrig)
+	go w.loop()
+	return nil
+}
+
+func (w *pressureWatcher) subscribe(ctx context.Context, id string, triggers []PressureTrigger, fds []int) (<-chan PressureEvent, error) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	if w.closed {
+		return nil, errors.New("libcrun: runtime context closed")
+	}
+	if !w.started {
+		if err := w.start(); err != nil {
+			return nil, err
+		}
+	}
+	s := &pressureSub{id: id, ch: make(chan PressureEvent, pressureEventsBuffer)}
+	for i, fd := range fds {
+		t := &pressureTrig{sub: s, token: w.next, fd: fd, trigger: triggers[i]}
+		w.next++
+		ev := syscall.EpollEvent{Events: syscall.EPOLLPRI}
+		epollData(&ev, t.token)
+		if err := syscall.EpollCtl(w.epfd, syscall.EPOLL_CTL_ADD, fd, &ev); err != nil {
+			for _, t := range s.trigs {
+				_ = syscall.EpollCtl(w.epfd, syscall.EPOLL_CTL_DEL, t.fd, nil)
+				delete(w.triggers, t.token)
+			}
+			return nil, errors.New("libcrun: epoll_ctl: " + err.Error())
+		}
+		s.trigs = append(s.trigs, t)
+		w.triggers[t.token] = t
+	}
+	s.stop = context.AfterFunc(ctx, func() {
+		w.mu.Lock()
+		defer w.mu.Unlock()
+		w.drop(s)
+	})
+	return s.ch, nil
+}
+
+// drop removes the triggers of s and closes its channel. Called with mu
+// held.
+func (w *pressureWatcher) drop(s *pressureSub) {
+	if s.closed {
+		return
+	}
+	s.closed = true
+	if s.stop != nil {
+		s.stop()
+	}
+	for _, t := range s.trigs {
+		delete(w.triggers, t.token)
+		_ = syscall.EpollCtl(w.epfd, syscall.EPOLL_CTL_DEL, t.fd, nil)
+		syscall.Close(t.fd) // unregisters the kernel trigger
+	}
+	close(s.ch)
+}
+
+// close ends every subscription and stops the loop; called by
+// RuntimeContext.Close.
+func (w *pressureWatcher) close() {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	if w.closed {
+		return
+	}
+	w.closed = true
+	if !w.started {
+		return
+	}
+	for _, t := range w.triggers {
+		w.drop(t.sub)
+	}
+	_, _ = syscall.Write(w.wake[1], []byte{0})
+}
+
+func (w *pressureWatcher) loop() {
+	var evs [32]syscall.EpollEvent
+	for {
+		n, err := syscall.EpollWait(w.epfd, evs[:], -1)
+		if err == syscall.EINTR {
+			continue
+		}
+		now := time.Now()
+		w.mu.Lock()
+		if err != nil || w.closed {
+			syscall.Close(w.epfd)
+			syscall.Close(w.wake[0])
+			syscall.Close(w.wake[1])
+			w.mu.Unlock()
+			return
+		}
+		for i := 0; i < n; i++ {
+			t := w.triggers[epollToken(&evs[i])]
+			if t == nil {
+				continue // the wake pipe, or a trigger dropped meanwhile
+			}
+			if evs[i].Events&syscall.EPOLLERR != 0 {
+				// The cgroup was removed
+				w.drop(t.sub)
+				continue
+			}
+			if evs[i].Events&syscall.EPOLLPRI != 0 {
+				select {
+				case t.sub.ch <- PressureEvent{ID: t.sub.id, Trigger: t.trigger, Time: now}:
+				default:
+				}
+			}
+		}
+		w.mu.Unlock()
+	}
+}
@@ -0,0 +1,103 @@
+//go:build linux
+
+package crun
+
+import (
+	"context"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"runtime"
+	"testing"
+	"time"
+)
+
+func TestPressureTriggerCommand(t *testing.T) {
+	for _, tc := range []struct {
+		trig PressureTrigger
+		want string // "" means invalid
+	}{
+		{PressureTrigger{Resource: PressureCPU, Threshold: 150 * time.Millisecond, Window: time.Second}, "some 150000 1000000\x00"},
+		{PressureTrigger{Resource: PressureIO, Kind: PressureFull, Threshold: 50 * time.Millisecond, Window: 500 * time.Millisecond}, "full 50000 500000\x00"},
+		{PressureTrigger{Resource: "disk", Threshold: time.Millisecond, Window: time.Second}, ""},
+		{PressureTrigger{Resource: PressureMemory, Kind: "most", Threshold: time.Millisecond, Window: time.Second}, ""},
+		{PressureTrigger{Resource: PressureMemory, Threshold: time.Millisecond, Window: 100 * time.Millisecond}, ""},
+		{PressureTrigger{Resource: PressureMemory, Threshold: 2 * time.Second, Window: time.Second}, ""},
+		{PressureTrigger{Resource: PressureMemory, Window: time.Second}, ""},
+	} {
+		got, err := tc.trig.command()
+		if tc.want == "" {
+			if err == nil {
+				t.Errorf("%+v: accepted, want error", tc.trig)
+			}
+			continue
+		}
+		if err != nil || string(got) != tc.want {
+			t.Errorf("%+v: got %q, %v; want %q", tc.trig, got, err, tc.want)
+		}
+	}
+}
+
+func TestWatchPressureInvalid(t *testing.T) {
+	rc := fakeStatsRoot(t, "c1")
+	ctr := rc.Get("c1")
+	if _, err := ctr.WatchPressure(context.Background()); err == nil {
+		t.Error("WatchPressure without triggers succeeded")
+	}
+	// Regular files do not support triggers
+	os.WriteFile(filepath.Join(cgroupRoot, "crun", "c1", "cpu.pressure"), nil, 0o644)
+	if _, err := ctr.WatchPressure(context.Background(),
+		PressureTrigger{Resource: PressureCPU, Threshold: 100 * time.Millisecond, Window: time.Second}); err == nil {
+		t.Error("WatchPressure on a regular file succeeded")
+	}
+}
+
+// TestWatchPressure registers a trigger on the system-wide CPU pressure
+// file, which has the cgroup file format, and creates CPU contention.
+func TestWatchPressure(t *testing.T) {
+	if _, err := os.Stat("/proc/pressure/cpu"); err != nil {
+		t.Skip("PSI not available")
+	}
+	rc := fakeStatsRoot(t, "c1")
+	if err := os.Symlink("/proc/pressure/cpu", filepath.Join(cgroupRoot, "crun", "c1", "cpu.pressure")); err != nil {
+		t.Fatalf("Symlink failed: %v", err)
+	}
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+	trig := PressureTrigger{Resource: PressureCPU, Threshold: 50 * time.Millisecond, Window: 2 * time.Second}
+	ch, err := rc.Get("c1").WatchPressure(ctx, trig)
+	if err != nil {
+		t.Skipf("cannot register a PSI trigger here: %v", err)
+	}
+
+	for i := 0; i < runtime.NumCPU()+1; i++ {
+		spin := exec.Command("sh", "-c", "while :; do :; done")
+		if err := spin.Start(); err != nil {
+			t.Fatalf("Start failed: %v", err)
+		}
+		defer func() { spin.Process.Kill(); spin.Wait() }()
+	}
+
+	select {
+	case ev := <-ch:
+		trig.Kind = PressureSome
+		if ev.ID != "c1" || ev.Trigger != trig {
+			t.Errorf("got %+v, want c1 with %+v", ev, trig)
+		}
+	case <-time.After(10 * time.Second):
+		t.Fatal("no pressure event under CPU contention")
+	}
+
+	cancel()
+	deadline := time.After(5 * time.Second)
+	for {
+		select {
+		case _, ok := <-ch:
+			if !ok {
+				return
+			}
+		case <-deadline:
+			t.Fatal("channel not closed after cancel")
+		}
+	}
+}
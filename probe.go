@@ -0,0 +1,263 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"context"
+	"errors"
+	"io"
+	"net"
+	"os"
+	"runtime"
+	"strconv"
+	"sync"
+	"syscall"
+	"time"
+)
+
+// probeOutputLimit is how much of an Exec probe's output is kept, as for
+// the kubelet's exec probes.
+const probeOutputLimit = 10 << 10
+
+// Probe runs readiness and liveness checks in a running container, from
+// its namespaces opened once by Container.Probe, for a fraction of the
+// cost of an Exec: without the process's JSON, the status read or
+// libcrun's exec setup. It is meant to be kept for the container's life
+// and used every few seconds. A Probe is safe for concurrent use; Exec
+// calls are serialized.
+type Probe struct {
+	mu sync.RWMutex // Exec holds it to use the clone stack, Close to free c
+	c  *C.struct_go_crun_probe
+}
+
+// ProbeResult is the outcome of Probe.Exec.
+type ProbeResult struct {
+	// ExitCode is the process's exit code, 128+signal when killed by a
+	// signal.
+	ExitCode int
+	// Output is what the process wrote to its stdout and stderr, cut at
+	// 10 KiB.
+	Output []byte
+}
+
+// Probe opens the namespaces, root and cgroup (cgroup v2) of the
+// container's init process for probing. Close it once done; it is
+// unusable once the container's init exited.
+func (c *Container) Probe() (*Probe, error) {
+	x := c.runtime
+	if x == nil || x.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context")
+	}
+	r := c.ref()
+	var cp *C.struct_go_crun_probe
+	var err C.libcrun_error_t
+	rc := x.onWorker(func() C.int {
+		r.mu.Lock()
+		defer r.mu.Unlock()
+		return C.go_crun_probe_open(x.c, r.c, &cp, &err)
+	})
+	if rc < 0 {
+		return nil, fromLibcrunErr(&err)
+	}
+	p := &Probe{c: cp}
+	runtime.SetFinalizer(p, (*Probe).Close)
+	return p, nil
+}
+
+// Close releases the probe's namespace fds. Close is idempotent.
+func (p *Probe) Close() error {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.c != nil {
+		C.go_crun_probe_free(p.c)
+		p.c = nil
+		runtime.SetFinalizer(p, nil)
+	}
+	return nil
+}
+
+// Exec runs args in the container and returns once the process exited
+// and its output was closed. The process joins the container's
+// namespaces, root and cgroup, and runs as root of the container's user
+// namespace without any capability and with no_new_privs set, stdin
+// /dev/null and only PATH in its environment, searched for args[0]. Being
+// set up by setns, it stays in the caller's pid namespace; what it starts
+// is in the container's. Without cgroup v2 it stays in the caller's
+// cgroup. When ctx is done first, the process and its children are
+// killed and ctx.Err() returned.
+func (p *Probe) Exec(ctx context.Context, args ...string) (ProbeResult, error) {
+	if len(args) == 0 {
+		return ProbeResult{}, errors.New("libcrun: probe without a command")
+	}
+	r, w, err := os.Pipe()
+	if err != nil {
+		return ProbeResult{}, err
+	}
+	defer r.Close()
+
+	argv := cStringVector(args)
+	defer freeCStringVector(argv, len(args))
+
+	var pid C.pid_t
+	var cerr C.libcrun_error_t
+	p.mu.Lock()
+	if p.c == nil {
+		p.mu.Unlock()
+		w.Close()
+		return ProbeResult{}, errors.New("libcrun: probe closed")
+	}
+	rc := C.go_crun_probe_spawn(p.c, argv, C.int(w.Fd()), &pid, &cerr)
+	p.mu.Unlock()
+	w.Close()
+	if rc < 0 {
+		return ProbeResult{}, fromLibcrunErr(&cerr)
+	}
+
+	waiter := newChildWaiter(int(pid))
+	stop := context.AfterFunc(ctx, func() {
+		waiter.kill()
+		_ = r.SetReadDeadline(time.Now())
+	})
+	out := readProbeOutput(r)
+	code, werr := waiter.wait()
+	stop()
+	res := ProbeResult{ExitCode: code, Output: out}
+	if err := ctx.Err(); err != nil {
+		return res, err
+	}
+	return res, werr
+}
+
+// readProbeOutput reads r to EOF, keeping the first probeOutputLimit
+// bytes.
+func readProbeOutput(r io.Reader) []byte {
+	var out []byte
+	var chunk [4096]byte
+	for {
+		n, err := r.Read(chunk[:])
+		if room := probeOutputLimit - len(out); room > 0 {
+			out = append(out, chunk[:min(n, room)]...)
+		}
+		if err != nil {
+			return out
+		}
+	}
+}
+
+// TCP connects to addr, an IP and a port such as "127.0.0.1:8080" or
+// ":8080" (the host defaults to 127.0.0.1), from the container's network
+// namespace, and closes the connection once established. Only the socket
+// is created in the namespace, from a thread that joins it for that call;
+// the connection waits in the netpoller. It returns ctx.Err() when ctx is
+// done first.
+func (p *Probe) TCP(ctx context.Context, addr string) error {
+	host, portStr, err := net.SplitHostPort(addr)
+	if err != nil {
+		return err
+	}
+	port, err := strconv.Atoi(portStr)
+	if err != nil || port <= 0 || port > 0xffff {
+		return errors.New("libcrun: invalid probe port " + strconv.Quote(portStr))
+	}
+	ip := net.IPv4(127, 0, 0, 1)
+	if host != "" {
+		if ip = net.ParseIP(host); ip == nil {
+			return errors.New("libcrun: probe address " + strconv.Quote(host) + " is not an IP")
+		}
+	}
+	family, sa := syscall.AF_INET6, syscall.Sockaddr(nil)
+	if ip4 := ip.To4(); ip4 != nil {
+		sa4 := &syscall.SockaddrInet4{Port: port}
+		copy(sa4.Addr[:], ip4)
+		family, sa = syscall.AF_INET, sa4
+	} else {
+		sa6 := &syscall.SockaddrInet6{Port: port}
+		copy(sa6.Addr[:], ip.To16())
+		sa = sa6
+	}
+
+	fd, err := p.socket(family)
+	if err != nil {
+		return err
+	}
+	// A nonblocking fd makes os.NewFile register it with the netpoller
+	f := os.NewFile(uintptr(fd), "probe-socket")
+	defer f.Close()
+	stop := context.AfterFunc(ctx, func() { _ = f.SetDeadline(time.Now()) })
+	defer stop()
+	rawConn, err := f.SyscallConn()
+	if err != nil {
+		return err
+	}
+	var connErr error
+	started := false
+	err = rawConn.Write(func(fd uintptr) bool {
+		if !started {
+			started = true
+			connErr = syscall.Connect(int(fd), sa)
+			// Completes once the socket is writable
+			return connErr != syscall.EINPROGRESS && connErr != syscall.EINTR
+		}
+		v, gerr := syscall.GetsockoptInt(int(fd), syscall.SOL_SOCKET, syscall.SO_ERROR)
+		switch {
+		case gerr != nil:
+			connErr = gerr
+		case v != 0:
+			connErr = syscall.Errno(v)
+		default:
+			connErr = nil
+		}
+		return true
+	})
+	if cerr := ctx.Err(); cerr != nil {
+		return cerr
+	}
+	if err != nil {
+		return err
+	}
+	if connErr != nil {
+		return &net.OpError{Op: "dial", Net: "tcp", Addr: &net.TCPAddr{IP: ip, Port: port}, Err: os.NewSyscallError("connect", connErr)}
+	}
+	return nil
+}
+
+// socket creates a nonblocking TCP socket in the container's network
+// namespace. The thread that joins the namespace for it is its own
+// goroutine's, and ends with it if it could not leave the namespace.
+func (p *Probe) socket(family int) (int, error) {
+	type result struct {
+		fd  int
+		err error
+	}
+	ch := make(chan result, 1)
+	go func() {
+		runtime.LockOSThread()
+		var tainted C.int
+		var cerr C.libcrun_error_t
+		p.mu.RLock()
+		fd := C.int(-1)
+		if p.c != nil {
+			fd = C.go_crun_probe_socket(p.c, C.int(family), &tainted, &cerr)
+		}
+		closed := p.c == nil
+		p.mu.RUnlock()
+		if tainted == 0 {
+			runtime.UnlockOSThread()
+		}
+		switch {
+		case closed:
+			ch <- result{-1, errors.New("libcrun: probe closed")}
+		case fd < 0:
+			ch <- result{-1, fromLibcrunErr(&cerr)}
+		default:
+			ch <- result{int(fd), nil}
+		}
+	}()
+	res := <-ch
+	return res.fd, res.err
+}
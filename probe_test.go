@@ -0,0 +1,237 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"context"
+	"errors"
+	"net"
+	"os"
+	"os/exec"
+	"strings"
+	"syscall"
+	"testing"
+	"time"
+)
+
+// openTestProbe returns a probe of a fake container whose init is cmd.
+func openTestProbe(t *testing.T, cmd *exec.Cmd) *Probe {
+	t.Helper()
+	if os.Getuid() != 0 {
+		t.Skip("Probes require root privileges")
+	}
+	rc := fakeStateRoot(t)
+	fakeLiveContainerCmd(t, rc, "c1", cmd)
+	p, err := rc.Get("c1").Probe()
+	if err != nil {
+		t.Fatalf("Probe failed: %v", err)
+	}
+	t.Cleanup(func() { p.Close() })
+	return p
+}
+
+func TestProbeExec(t *testing.T) {
+	p := openTestProbe(t, exec.Command("sleep", "60"))
+
+	res, err := p.Exec(context.Background(), "sh", "-c", "echo out; echo err >&2; exit 3")
+	if err != nil {
+		t.Fatalf("Exec failed: %v", err)
+	}
+	if res.ExitCode != 3 {
+		t.Errorf("ExitCode = %d, want 3", res.ExitCode)
+	}
+	if string(res.Output) != "out\nerr\n" {
+		t.Errorf("Output = %q, want %q", res.Output, "out\nerr\n")
+	}
+
+	res, err = p.Exec(context.Background(), "grep", "-E", "^(CapEff|CapBnd|NoNewPrivs):", "/proc/self/status")
+	if err != nil {
+		t.Fatalf("Exec failed: %v", err)
+	}
+	for _, want := range []string{"CapEff:\t0000000000000000", "CapBnd:\t0000000000000000", "NoNewPrivs:\t1"} {
+		if !strings.Contains(string(res.Output), want) {
+			t.Errorf("Output = %q, want it to contain %q", res.Output, want)
+		}
+	}
+}
+
+func TestProbeExecOutputLimit(t *testing.T) {
+	p := openTestProbe(t, exec.Command("sleep", "60"))
+
+	res, err := p.Exec(context.Background(), "head", "-c", "100000", "/dev/zero")
+	if err != nil {
+		t.Fatalf("Exec failed: %v", err)
+	}
+	if res.ExitCode != 0 || len(res.Output) != probeOutputLimit {
+		t.Errorf("ExitCode = %d, len(Output) = %d, want 0, %d", res.ExitCode, len(res.Output), probeOutputLimit)
+	}
+}
+
+func TestProbeExecNotFound(t *testing.T) {
+	p := openTestProbe(t, exec.Command("sleep", "60"))
+
+	if _, err := p.Exec(context.Background(), "nonexistent-probe-binary"); err == nil {
+		t.Error("Exec of a missing binary succeeded")
+	}
+	if _, err := p.Exec(context.Background()); err == nil {
+		t.Error("Exec without a command succeeded")
+	}
+}
+
+func TestProbeExecCanceled(t *testing.T) {
+	p := openTestProbe(t, exec.Command("sleep", "60"))
+
+	ctx, cancel := context.WithTimeout(context.Background(), 100*time.Millisecond)
+	defer cancel()
+	start := time.Now()
+	// The grandchild keeps the output open once the shell was killed
+	_, err := p.Exec(ctx, "sh", "-c", "sleep 10; true")
+	if !errors.Is(err, context.DeadlineExceeded) {
+		t.Errorf("Exec = %v, want %v", err, context.DeadlineExceeded)
+	}
+	if d := time.Since(start); d > 5*time.Second {
+		t.Errorf("Exec returned after %v", d)
+	}
+}
+
+func TestProbeContainerExited(t *testing.T) {
+	if os.Getuid() != 0 {
+		t.Skip("Probes require root privileges")
+	}
+	rc := fakeStateRoot(t)
+	cmd := fakeLiveContainer(t, rc, "c1")
+	p, err := rc.Get("c1").Probe()
+	if err != nil {
+		t.Fatalf("Probe failed: %v", err)
+	}
+	defer p.Close()
+
+	cmd.Process.Kill()
+	cmd.Wait()
+	var e *Error
+	if _, err := p.Exec(context.Background(), "true"); !errors.As(err, &e) || e.Code != ErrContainerNotRunning {
+		t.Errorf("Exec = %v, want a not running error", err)
+	}
+	if _, err := rc.Get("c1").Probe(); !errors.As(err, &e) || e.Code != ErrContainerNotRunning {
+		t.Errorf("Probe = %v, want a not running error", err)
+	}
+}
+
+func TestProbeClose(t *testing.T) {
+	p := openTestProbe(t, exec.Command("sleep", "60"))
+
+	if err := p.Close(); err != nil {
+		t.Fatalf("Close failed: %v", err)
+	}
+	if err := p.Close(); err != nil {
+		t.Errorf("second Close failed: %v", err)
+	}
+	if _, err := p.Exec(context.Background(), "true"); err == nil {
+		t.Error("Exec after Close succeeded")
+	}
+	if err := p.TCP(context.Background(), ":1"); err == nil {
+		t.Error("TCP after Close succeeded")
+	}
+}
+
+func TestProbeTCP(t *testing.T) {
+	p := openTestProbe(t, exec.Command("sleep", "60"))
+
+	ln, err := net.Listen("tcp", "127.0.0.1:0")
+	if err != nil {
+		t.Fatalf("Listen failed: %v", err)
+	}
+	addr := ln.Addr().String()
+	_, port, _ := net.SplitHostPort(addr)
+	if err := p.TCP(context.Background(), addr); err != nil {
+		t.Errorf("TCP(%s) failed: %v", addr, err)
+	}
+	if err := p.TCP(context.Background(), ":"+port); err != nil {
+		t.Errorf("TCP(:%s) failed: %v", port, err)
+	}
+	ln.Close()
+	if err := p.TCP(context.Background(), addr); !errors.Is(err, syscall.ECONNREFUSED) {
+		t.Errorf("TCP to a closed port = %v, want %v", err, syscall.ECONNREFUSED)
+	}
+
+	for _, bad := range []string{"", "127.0.0.1", ":0", ":http", "localhost:80"} {
+		if err := p.TCP(context.Background(), bad); err == nil {
+			t.Errorf("TCP(%q) succeeded", bad)
+		}
+	}
+}
+
+func TestProbeTCPContainerNetns(t *testing.T) {
+	cmd := exec.Command("sleep", "60")
+	cmd.SysProcAttr = &syscall.SysProcAttr{Cloneflags: syscall.CLONE_NEWNET}
+	p := openTestProbe(t, cmd)
+
+	ln, err := net.Listen("tcp", "127.0.0.1:0")
+	if err != nil {
+		t.Fatalf("Listen failed: %v", err)
+	}
+	defer ln.Close()
+	// The container's loopback is down and is not ours
+	if err := p.TCP(context.Background(), ln.Addr().String()); err == nil {
+		t.Error("TCP reached a listener outside the container's network namespace")
+	}
+	// The thread that created the socket left the namespace again
+	ln2, err := net.Listen("tcp", "127.0.0.1:0")
+	if err != nil {
+		t.Fatalf("Listen after TCP failed: %v", err)
+	}
+	ln2.Close()
+}
+
+func BenchmarkProbeExec(b *testing.B) {
+	if os.Getuid() != 0 {
+		b.Skip("Probes require root privileges")
+	}
+	rc := fakeStateRoot(b)
+	fakeLiveContainer(b, rc, "c1")
+	p, err := rc.Get("c1").Probe()
+	if err != nil {
+		b.Fatalf("Probe failed: %v", err)
+	}
+	defer p.Close()
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if _, err := p.Exec(context.Background(), "true"); err != nil {
+			b.Fatalf("Exec failed: %v", err)
+		}
+	}
+}
+
+func BenchmarkProbeTCP(b *testing.B) {
+	if os.Getuid() != 0 {
+		b.Skip("Probes require root privileges")
+	}
+	rc := fakeStateRoot(b)
+	fakeLiveContainer(b, rc, "c1")
+	p, err := rc.Get("c1").Probe()
+	if err != nil {
+		b.Fatalf("Probe failed: %v", err)
+	}
+	defer p.Close()
+	ln, err := net.Listen("tcp", "127.0.0.1:0")
+	if err != nil {
+		b.Fatalf("Listen failed: %v", err)
+	}
+	defer ln.Close()
+	go func() {
+		for {
+			c, err := ln.Accept()
+			if err != nil {
+				return
+			}
+			c.Close()
+		}
+	}()
+	addr := ln.Addr().String()
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		if err := p.TCP(context.Background(), addr); err != nil {
+			b.Fatalf("TCP failed: %v", err)
+		}
+	}
+}
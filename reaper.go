@@ -0,0 +1,280 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"os"
+	"os/signal"
+	"sync"
+	"sync/atomic"
+	"syscall"
+)
+
+// ReaperOptions configures EnableReaper.
+type ReaperOptions struct {
+	// Subreaper makes the process a child subreaper
+	// (PR_SET_CHILD_SUBREAPER): descendants orphaned by their parent, such
+	// as the init of a container whose launcher child was killed, are
+	// reparented to it instead of the host's init, and the reaper reaps
+	// them. It reaps every child nobody registered with it, so it must not
+	// be set in a process that also waits for children of its own
+	// (os/exec, os.StartProcess): their exits would be taken.
+	Subreaper bool
+}
+
+// processReaper is the reaper of EnableReaper, nil until then.
+var processReaper atomic.Pointer[reaper]
+
+var enableReaperMu sync.Mutex
+
+// EnableReaper starts a process-wide reaper for the children forked by
+// RunWithIO, ExecWithIO, RunBatch, Restore and the ...Ctx variants: once
+// enabled, one goroutine collects their exits, from an epoll instance of
+// their pidfds that is itself polled by the runtime's netpoller, and hands
+// exit code and resource usage (RunResult.Usage) to the matching Wait. No
+// goroutine or thread is parked per child, and a child whose Wait is never
+// called is still reaped, so zombies do not pile up. Children without a
+// pidfd (before Linux 5.3) are collected on SIGCHLD.
+//
+// Only children launched after the call are concerned. The reaper cannot
+// be disabled; a second call fails.
+func EnableReaper(o ReaperOptions) error {
+	enableReaperMu.Lock()
+	defer enableReaperMu.Unlock()
+	if processReaper.Load() != nil {
+		return errors.New("libcrun: reaper already enabled")
+	}
+	r, err := newReaper(o)
+	if err != nil {
+		return err
+	}
+	processReaper.Store(r)
+	return nil
+}
+
+// prSetChildSubreaper is PR_SET_CHILD_SUBREAPER, which package syscall
+// lacks.
+const prSetChildSubreaper = 36
+
+// maxOrphanExits bounds the exits of unregistered children the reaper
+// remembers, for children reaped between their fork and their add.
+const maxOrphanExits = 1024
+
+// reaperChild is a child registered with the reaper.
+type reaperChild struct {
+	r     *reaper
+	pid   int
+	pidfd int // -1 without pidfds
+	done  chan struct{}
+	code  int
+	usage syscall.Rusage
+	err   error
+}
+
+type reaper struct {
+	epoll     *epollLoop // of the pidfds
+	sigch     chan os.Signal
+	subreaper bool
+
+	mu      sync.Mutex
+	byFd    map[int32]*reaperChild
+	byPid   map[int]*reaperChild
+	noPidfd int // registered children without a pidfd
+	// exits of unregistered children (Subreaper), oldest first in order
+	orphans map[int]reaperChild
+	order   []int
+}
+
+func newReaper(o ReaperOptions) (*reaper, error) {
+	epoll, err := newEpollLoop("reaper-epoll")
+	if err != nil {
+		return nil, err
+	}
+	if o.Subreaper {
+		if _, _, errno := syscall.RawSyscall(syscall.SYS_PRCTL, prSetChildSubreaper, 1, 0); errno != 0 {
+			epoll.close()
+			return nil, os.NewSyscallError("prctl", errno)
+		}
+	}
+	r := &reaper{
+		epoll:     epoll,
+		sigch:     make(chan os.Signal, 1),
+		subreaper: o.Subreaper,
+		byFd:      map[int32]*reaperChild{},
+		byPid:     map[int]*reaperChild{},
+		orphans:   map[int]reaperChild{},
+	}
+	go r.run()
+	// SIGCHLD drives the children without a pidfd and, for a subreaper,
+	// the orphans. Deliveries coalesce; each one makes the reaper reap all
+	// it can.
+	signal.Notify(r.sigch, syscall.SIGCHLD)
+	go func() {
+		for range r.sigch {
+			r.reapSIGCHLD()
+		}
+	}()
+	return r, nil
+}
+
+// close stops the reaper (tests only: EnableReaper's runs for good).
+func (r *reaper) close() {
+	signal.Stop(r.sigch)
+	close(r.sigch)
+	r.epoll.close()
+}
+
+// add registers pid, a child of this process, and returns the handle its
+// exit is delivered to.
+func (r *reaper) add(pid int) *reaperChild {
+	ch := &reaperChild{r: r, pid: pid, pidfd: -1, done: make(chan struct{})}
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	if o, ok := r.orphans[pid]; ok {
+		// Reaped as an orphan before it was registered
+		delete(r.orphans, pid)
+		ch.code, ch.usage, ch.err = o.code, o.usage, o.err
+		close(ch.done)
+		return ch
+	}
+	r.byPid[pid] = ch
+	if fd := int(C.go_crun_pidfd_open(C.pid_t(pid))); fd >= 0 {
+		syscall.CloseOnExec(fd)
+		ev := syscall.EpollEvent{Events: syscall.EPOLLIN, Fd: int32(fd)}
+		if err := syscall.EpollCtl(r.epoll.fd(), syscall.EPOLL_CTL_ADD, fd, &ev); err == nil {
+			ch.pidfd = fd
+			r.byFd[int32(fd)] = ch
+			return ch
+		}
+		syscall.Close(fd)
+	}
+	r.noPidfd++
+	// It may have exited before SIGCHLD was watched for it
+	r.reapLocked(ch)
+	return ch
+}
+
+func (r *reaper) run() {
+	events := make([]syscall.EpollEvent, 128)
+	for {
+		n, err := r.epoll.wait(events)
+		if err != nil {
+			return
+		}
+		r.mu.Lock()
+		for _, ev := range events[:n] {
+			if ch := r.byFd[ev.Fd]; ch != nil {
+				r.reapLocked(ch)
+			}
+		}
+		r.mu.Unlock()
+	}
+}
+
+// reapSIGCHLD reaps the children without a pidfd that exited and, for a
+// subreaper, any other exited child.
+func (r *reaper) reapSIGCHLD() {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	if r.subreaper {
+		for {
+			var ws syscall.WaitStatus
+			var usage syscall.Rusage
+			pid, err := syscall.Wait4(-1, &ws, syscall.WNOHANG, &usage)
+			if err == syscall.EINTR {
+				continue
+			}
+			if err != nil || pid <= 0 {
+				return
+			}
+			if ch := r.byPid[pid]; ch != nil {
+				r.finishLocked(ch, exitCodeOf(ws), usage, nil)
+				continue
+			}
+			r.rememberOrphanLocked(pid, reaperChild{code: exitCodeOf(ws), usage: usage})
+		}
+	}
+	if r.noPidfd == 0 {
+		return
+	}
+	for _, ch := range r.byPid {
+		if ch.pidfd < 0 {
+			r.reapLocked(ch)
+		}
+	}
+}
+
+// reapLocked reaps ch if it exited.
+func (r *reaper) reapLocked(ch *reaperChild) {
+	var ws syscall.WaitStatus
+	var usage syscall.Rusage
+	for {
+		pid, err := syscall.Wait4(ch.pid, &ws, syscall.WNOHANG, &usage)
+		switch {
+		case err == syscall.EINTR:
+			continue
+		case err != nil:
+			r.finishLocked(ch, -1, usage, os.NewSyscallError("wait4", err))
+		case pid == ch.pid:
+			r.finishLocked(ch, exitCodeOf(ws), usage, nil)
+		}
+		return
+	}
+}
+
+func (r *reaper) finishLocked(ch *reaperChild, code int, usage syscall.Rusage, err error) {
+	delete(r.byPid, ch.pid)
+	if ch.pidfd >= 0 {
+		delete(r.byFd, int32(ch.pidfd))
+		_ = syscall.EpollCtl(r.epoll.fd(), syscall.EPOLL_CTL_DEL, ch.pidfd, nil)
+		syscall.Close(ch.pidfd)
+		ch.pidfd = -1
+	} else {
+		r.noPidfd--
+	}
+	ch.code, ch.usage, ch.err = code, usage, err
+	close(ch.done)
+}
+
+func (r *reaper) rememberOrphanLocked(pid int, exit reaperChild) {
+	if len(r.order) >= maxOrphanExits {
+		delete(r.orphans, r.order[0])
+		r.order = r.order[1:]
+	}
+	r.orphans[pid] = exit
+	r.order = append(r.order, pid)
+}
+
+// kill sends SIGKILL to the processes the child forked, then to the child,
+// unless it was reaped: the reaper's lock keeps it from reaping the child,
+// and so its pid from being reused, meanwhile.
+func (ch *reaperChild) kill() {
+	ch.r.mu.Lock()
+	defer ch.r.mu.Unlock()
+	select {
+	case <-ch.done:
+		return
+	default:
+	}
+	for _, pid := range childPIDs(ch.pid) {
+		_ = syscall.Kill(pid, syscall.SIGKILL)
+	}
+	_ = syscall.Kill(ch.pid, syscall.SIGKILL)
+}
+
+// exitCodeOf is the exit code of a child as Wait reports it (128+signal
+// when killed by a signal).
+func exitCodeOf(ws syscall.WaitStatus) int {
+	switch {
+	case ws.Exited():
+		return ws.ExitStatus()
+	case ws.Signaled():
+		return 128 + int(ws.Signal())
+	}
+	return -1
+}
@@ -0,0 +1,127 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"testing"
+	"time"
+)
+
+// withTestReaper makes a fresh reaper the process reaper for the test.
+func withTestReaper(t *testing.T) *reaper {
+	t.Helper()
+	r, err := newReaper(ReaperOptions{})
+	if err != nil {
+		t.Fatalf("newReaper failed: %v", err)
+	}
+	processReaper.Store(r)
+	t.Cleanup(func() {
+		processReaper.Store(nil)
+		r.close()
+	})
+	return r
+}
+
+func TestReaperCollectsExits(t *testing.T) {
+	r := withTestReaper(t)
+	const n = 32
+	waiters := make([]*childWaiter, n)
+	for i := range waiters {
+		waiters[i] = newChildWaiter(startChild(t, "exit "+string(rune('0'+i%8))))
+		if waiters[i].central == nil {
+			t.Fatal("waiter is not served by the reaper")
+		}
+	}
+	for i, w := range waiters {
+		code, err := w.wait()
+		if err != nil || code != i%8 {
+			t.Errorf("child %d: wait = %d, %v; want %d", i, code, err, i%8)
+		}
+		if w.usage.Load() == nil {
+			t.Errorf("child %d: no resource usage", i)
+		}
+	}
+	if _, err := waiters[0].wait(); err == nil {
+		t.Error("second wait succeeded")
+	}
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	if len(r.byPid) != 0 || len(r.byFd) != 0 {
+		t.Errorf("reaper still tracks %d children (%d pidfds)", len(r.byPid), len(r.byFd))
+	}
+}
+
+func TestReaperReapsUnwaited(t *testing.T) {
+	r := withTestReaper(t)
+	w := newChildWaiter(startChild(t, "exit 0"))
+	// Nobody calls wait: the reaper reaps the child anyway
+	waitFor(t, "the child to be reaped", func() bool {
+		select {
+		case <-w.central.done:
+			return true
+		default:
+			return false
+		}
+	})
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	if len(r.byPid) != 0 {
+		t.Errorf("reaper still tracks %d children", len(r.byPid))
+	}
+}
+
+func TestReaperKill(t *testing.T) {
+	withTestReaper(t)
+	w := newChildWaiter(startChild(t, "sleep 30"))
+	res := &RunResult{Wait: w.wait, waiter: w, exec: true}
+	w.kill()
+	code, err := res.Wait()
+	if err != nil || code != 128+9 {
+		t.Errorf("Wait = %d, %v; want %d", code, err, 128+9)
+	}
+	if res.Usage() == nil {
+		t.Error("Usage = nil after Wait")
+	}
+	w.kill() // reaped: no-op
+}
+
+func TestReaperOrphanBeforeAdd(t *testing.T) {
+	r := withTestReaper(t)
+	r.mu.Lock()
+	r.subreaper = true // reap unregistered children, without the prctl
+	r.mu.Unlock()
+
+	pid := startChild(t, "exit 5")
+	waitFor(t, "the orphan to be reaped", func() bool {
+		r.mu.Lock()
+		defer r.mu.Unlock()
+		_, ok := r.orphans[pid]
+		return ok
+	})
+	ch := r.add(pid)
+	select {
+	case <-ch.done:
+	case <-time.After(time.Second):
+		t.Fatal("exit reaped before add was not delivered")
+	}
+	if ch.code != 5 || ch.err != nil {
+		t.Errorf("exit = %d, %v; want 5", ch.code, ch.err)
+	}
+}
+
+func TestRunResultUsageWithoutReaper(t *testing.T) {
+	w := newChildWaiter(startChild(t, "exit 0"))
+	res := &RunResult{Wait: w.wait, waiter: w}
+	if res.Usage() != nil {
+		t.Error("Usage before Wait")
+	}
+	if _, err := res.Wait(); err != nil {
+		t.Fatalf("Wait failed: %v", err)
+	}
+	if res.Usage() == nil {
+		t.Error("Usage = nil after Wait")
+	}
+	if (&RunResult{}).Usage() != nil {
+		t.Error("Usage of an unknown child")
+	}
+}
@@ -57,6 +57,7 @@
 // Use WithXxx options to configure container specs ergonomically:
 //   - [WithRootPath], [WithArgs], [WithEnv], [WithCwd] - basic process config
 //   - [WithMemoryLimit], [WithCPUShares], [WithCPUQuota], [WithPidsLimit] - resource limits
+//   - [WithScheduler], [WithIOPriority], [WithTier] - CPU and I/O scheduling
 //   - [WithMount], [WithHostname], [WithAnnotation] - container config
 //   - [WithNetworkNamespace], [WithMountNamespace], [WithHostNetwork] - namespace control
 //
@@ -82,6 +83,9 @@
 //	defer spec.Close()
 //
 // Finalizers are installed as a safety net, but explicit Close() is preferred.
+// [ReadCMemStats] reports the C memory held and how much of it only
+// finalizers released; past [SetCMemGCThreshold], the binding forces a
+// collection so that unreachable specs do not pile up.
 package crun
 
 /*
@@ -95,21 +99,25 @@ package crun
 // System dependencies required: libsystemd-dev, libseccomp-dev, libcap-dev
 
 #cgo linux,amd64 CFLAGS: -I${SRCDIR}/libcrun/include
-#cgo linux,amd64 LDFLAGS: -L${SRCDIR}/libcrun/lib/x64 -lcrun -lsystemd -lseccomp -lcap -lm
+#cgo linux,amd64 LDFLAGS: -L${SRCDIR}/libcrun/lib/x64 -lcrun -lsystemd -lseccomp -lcap -lm -Wl,--wrap=libcrun_ebpf_load -Wl,--wrap=libcrun_cgroup_preenter -Wl,--wrap=libcrun_cgroup_enter -Wl,--wrap=libcrun_cgroup_destroy
 #cgo linux,arm64 CFLAGS: -I${SRCDIR}/libcrun/include
-#cgo linux,arm64 LDFLAGS: -L${SRCDIR}/libcrun/lib/aarch64 -lcrun -lsystemd -lseccomp -lcap -lm
+#cgo linux,arm64 LDFLAGS: -L${SRCDIR}/libcrun/lib/aarch64 -lcrun -lsystemd -lseccomp -lcap -lm -Wl,--wrap=libcrun_ebpf_load -Wl,--wrap=libcrun_cgroup_preenter -Wl,--wrap=libcrun_cgroup_enter -Wl,--wrap=libcrun_cgroup_destroy
 
 #include "go_crun.h"
 */
 import "C"
 import (
+	"bufio"
 	"encoding/binary"
 	"errors"
 	"io"
 	"os"
-	"runtime"
 	"runtime/cgo"
+	"strings"
 	"sync"
+	"sync/atomic"
+	"syscall"
+	"time"
 	"unsafe"
 )
 
@@ -124,20 +132,30 @@ func fromLibcrunErr(cerr *C.libcrun_error_t) error {
 	if cerr == nil {
 		return errors.New("libcrun: unknown error (nil)")
 	}
-	var status C.int
-	msg := C.go_crun_err_to_cstr(cerr, &status)
-	if msg == nil {
+	if *cerr == nil || (*cerr).msg == nil {
+		C.libcrun_error_release(cerr)
 		return errors.New("libcrun: error without message")
 	}
-	defer C.free(unsafe.Pointer(msg))
-	message := C.GoString(msg)
+	// Copy the fields, then classify and release in a single call; the
+	// errno text is only formatted if Error() is called.
+	message := C.GoString((*cerr).msg)
+	status := int((*cerr).status)
+	code := ErrorCode(C.go_crun_err_classify_release(cerr))
 	return &Error{
-		Code:    classifyError(message, int(status)),
+		Code:    code,
 		Message: message,
-		Status:  int(status),
+		Status:  status,
 	}
 }
 
+// classifyMessage returns the ErrorCode libcrun errors with this message and
+// errno are given.
+func classifyMessage(msg string, status int) ErrorCode {
+	cmsg := C.CString(msg)
+	defer C.free(unsafe.Pointer(cmsg))
+	return ErrorCode(C.go_crun_err_category(cmsg, C.int(status)))
+}
+
 // RuntimeConfig configures a RuntimeContext (maps to libcrun_context_t fields).
 type RuntimeConfig struct {
 	ID            string
@@ -153,14 +171,86 @@ type RuntimeConfig struct {
 	NoNewKeyring  bool
 	ForceNoCgroup bool
 	NoPivot       bool
+
+	// EphemeralState trades durability for speed, for containers that
+	// never need to outlive the host's uptime. StateRoot (required) is
+	// kept on tmpfs, where libcrun's status writes never reach a disk: if
+	// it is not on tmpfs already, a private tmpfs is mounted over it,
+	// which needs CAP_SYS_ADMIN and is left in place by Close. StateRoot
+	// must then be empty (or not exist yet): NewRuntimeContext fails
+	// rather than hide the containers whose state it holds. The
+	// context also keeps an in-process index of its containers, built
+	// from StateRoot once, so that List, ListIDs and ListWithState do not
+	// read the directory; containers created or deleted there by other
+	// processes or contexts are not seen.
+	EphemeralState bool
+
+	// Workers, if positive, runs the blocking libcrun calls of the context
+	// (create, start, delete, kill, state, exec, pids, the forks of
+	// RunWithIO and ExecWithIO, ...) on that many dedicated OS threads, in
+	// the order they are made, instead of on the calling goroutine's: the
+	// threads blocked in libcrun stay bounded under bursts of calls, and
+	// calls never run on a thread a goroutine locked and altered, nor
+	// leave one altered. Run and Exec without Detach, which block until
+	// the process exits, keep running on the caller's thread.
+	// ExecutorStats reports the queue.
+	Workers int
+
+	// Notify, if set, gives every container the context launches a
+	// notify socket of its own, served by the hub, in place of
+	// NotifySocket: see NotifyHub and Container.Ready.
+	Notify *NotifyHub
+
+	// CgroupPool, if set, has the containers the context launches enter
+	// recycled cgroups of the pool, unless their spec sets
+	// linux.cgroupsPath: see CgroupPool. It is ignored with SystemdCgroup
+	// or ForceNoCgroup.
+	CgroupPool *CgroupPool
+
+	// DeviceProgramReuse loads each distinct cgroup v2 device program once
+	// and attaches it by fd to the containers using it, instead of having
+	// the kernel verify one per container: see PurgeDevicePrograms. The
+	// setting is process-wide: reuse is on while a context created with it
+	// is open.
+	DeviceProgramReuse bool
 }
 
 // RuntimeContext is the per-operation environment used by libcrun.
+//
+// Operations that need a container ID on the context (Run, RunWithIO,
+// Create) work on a per-call shallow clone, so concurrent launches on one
+// RuntimeContext do not serialize on a lock.
 type RuntimeContext struct {
-	c  *C.libcrun_context_t
-	mu sync.Mutex // protects c.id during concurrent operations
+	c *C.libcrun_context_t
+
+	clonesMu sync.Mutex // protects clones
+	clones   []*C.libcrun_context_t
+
+	logMu         sync.Mutex               // serializes SetLogHandler
+	logRoute      atomic.Pointer[logRoute] // this context's handler, nil until set
+	logHandle     atomic.Uintptr           // cgo.Handle of logRoute (0 = none)
+	childLogLevel atomic.Int32             // child log verbosity + 1 (0 = inherit)
+
+	cgroups   cgroupDirs       // open cgroup directories used by Stats
+	memEvents memEventsWatcher // memory.events subscriptions of Container.Events
+	pressure  pressureWatcher  // PSI triggers of Container.WatchPressure
+
+	tracer atomic.Pointer[tracerBox] // see SetTracer
+
+	index *stateIndex // containers of an EphemeralState context, else nil
+
+	cost int64 // estimated C memory of c, see CMemStats
+
+	exec       *executor   // see RuntimeConfig.Workers, nil without
+	notify     *NotifyHub  // see RuntimeConfig.Notify
+	cgroupPool *CgroupPool // see RuntimeConfig.CgroupPool
+
+	deviceProgramReuse bool // see RuntimeConfig.DeviceProgramReuse
 }
 
+// maxIdleContextClones bounds the free list of per-call context clones.
+const maxIdleContextClones = 64
+
 // NewRuntimeContext creates a new RuntimeContext. Call Close() when done.
 func NewRuntimeContext(cfg RuntimeConfig) (*RuntimeContext, error) {
 	c := C.go_crun_new_context()
@@ -191,8 +281,26 @@ func NewRuntimeContext(cfg RuntimeConfig) (*RuntimeContext, error) {
 	c.force_no_cgroup = C.bool(cfg.ForceNoCgroup)
 	c.no_pivot = C.bool(cfg.NoPivot)
 
-	rc := &RuntimeContext{c: c}
-	runtime.SetFinalizer(rc, func(x *RuntimeContext) { _ = x.Close() })
+	rc := &RuntimeContext{c: c, notify: cfg.Notify}
+	if !cfg.SystemdCgroup && !cfg.ForceNoCgroup {
+		rc.cgroupPool = cfg.CgroupPool
+	}
+	trackContext(rc)
+	if cfg.DeviceProgramReuse {
+		rc.deviceProgramReuse = true
+		retainDeviceProgramReuse()
+	}
+	if cfg.Workers > 0 {
+		rc.exec = newExecutor(cfg.Workers)
+	}
+	if cfg.EphemeralState {
+		idx, err := prepareEphemeralRoot(c, cfg.StateRoot)
+		if err != nil {
+			rc.Close()
+			return nil, err
+		}
+		rc.index = idx
+	}
 	return rc, nil
 }
 
@@ -201,8 +309,28 @@ func (x *RuntimeContext) Close() error {
 	if x == nil || x.c == nil {
 		return nil
 	}
+	x.clonesMu.Lock()
+	for _, cl := range x.clones {
+		freeContextClone(cl)
+	}
+	x.clones = nil
+	x.clonesMu.Unlock()
+	if h := x.logHandle.Swap(0); h != 0 {
+		cgo.Handle(h).Delete()
+	}
+	x.cgroups.closeAll()
+	x.memEvents.close()
+	x.pressure.close()
+	if x.exec != nil {
+		x.exec.close()
+	}
 	C.go_crun_free_context(x.c)
 	x.c = nil
+	untrackContext(x)
+	if x.deviceProgramReuse {
+		x.deviceProgramReuse = false
+		releaseDeviceProgramReuse()
+	}
 	return nil
 }
 
@@ -239,41 +367,256 @@ func createFlags(o CreateOptions) C.uint {
 }
 
 // IOConfig configures container I/O streams for RunWithIO.
+//
+// A stream backed by an *os.File in blocking mode (a regular file, a
+// terminal, os.Stdout, ...) is given to the container directly, without a
+// pipe or copy goroutine. Other readers and writers are served through a
+// pipe and io.Copy. To capture output with a memory cap, use a [Capture].
 type IOConfig struct {
 	Stdin  io.Reader // If nil, container stdin reads from /dev/null
 	Stdout io.Writer // If nil, container stdout is discarded
 	Stderr io.Writer // If nil, container stderr is discarded
+
+	// Launcher, if set, launches the container from one of its pre-forked
+	// helper processes instead of forking the calling process.
+	Launcher *Launcher
+
+	// Spawn starts the container child with posix_spawn (re-executing the
+	// current binary) instead of fork, so the cost does not grow with the
+	// size of the Go heap. Ignored when Launcher is set.
+	Spawn bool
+
+	// DetachChild makes the forked child exit as soon as the container
+	// started, instead of staying in libcrun for the container's life with
+	// a copy-on-write image of this process that grows as either side
+	// dirties pages. The container's init is reparented to this process,
+	// which must run the reaper as a subreaper (EnableReaper with
+	// Subreaper), and Wait follows it through its pidfd: it returns the
+	// init's exit code and usage, then deletes the container as the child
+	// would have. Ignored when the context is Detach.
+	DetachChild bool
+
+	// PipeSize sets the capacity of the stdio pipes in bytes (F_SETPIPE_SZ),
+	// clamped to /proc/sys/fs/pipe-max-size. 0 keeps the kernel default
+	// (64 KiB). Larger pipes mean fewer wakeups for chatty containers.
+	PipeSize int
+
+	// Stats, if set, receives byte and pipe-full counters for the streams.
+	Stats *IOStats
+
+	// OnLines, if set, receives the container's stdout and stderr split
+	// into lines, in batches and from a goroutine of its own; Stdout and
+	// Stderr are then ignored. Lines are framed in pooled buffers, which
+	// the StreamLines point into for the duration of the call. Wait
+	// returns once the last batch is delivered.
+	OnLines func(lines []StreamLine)
+	// Lines configures the framing and queueing of OnLines.
+	Lines LineOptions
+
+	// Engine, if set, serves the stdout, stderr and log pipes from the
+	// event loops of a shared IOEngine instead of a goroutine each. Stdin
+	// and OnLines keep their goroutines.
+	Engine *IOEngine
+
+	// consoleSocket, set by RunWithTTY, replaces the context's console
+	// socket for this launch.
+	consoleSocket string
 }
 
-// RunResult holds the result of a container run with I/O.
+// outputs returns what the container's stdout and stderr go to: the
+// writers, or with OnLines a value that needs a pipe, or nil.
+func (c *IOConfig) outputs() (stdout, stderr any) {
+	if c.OnLines != nil {
+		return lineFramed{}, lineFramed{}
+	}
+	return c.Stdout, c.Stderr
+}
+
+// lineFramed stands for the output streams of an IOConfig with OnLines.
+type lineFramed struct{}
+
+// RunResult holds the result of a container run or exec with I/O.
 type RunResult struct {
 	Container *Container
-	Wait      func() (int, error) // blocks until container exits, returns exit code
+	Wait      func() (int, error) // blocks until the container (or exec'd process) exits, returns exit code
+
+	waiter *childWaiter // the forked child, nil when unknown (see abort)
+	exec   bool         // the child execs into Container rather than runs it
+	final  atomic.Pointer[Stats]
+}
+
+// RunStatus is how a container child ended, for accounting.
+type RunStatus struct {
+	ExitCode int
+	// Usage is the child's resource usage, as Usage returns it.
+	Usage *syscall.Rusage
+	// Cgroup is the container's cgroup, as FinalStats returns it.
+	Cgroup *Stats
+}
+
+// Usage returns the resource usage of the forked child once Wait has
+// returned its exit code, as wait4(2) reports it: it includes the
+// processes the child waited for, such as the container's init. It is nil
+// before, and when unknown.
+func (r *RunResult) Usage() *syscall.Rusage {
+	if r.waiter == nil {
+		return nil
+	}
+	return r.waiter.usage.Load()
+}
+
+// followInit makes res, whose child exits once the container started
+// (IOConfig.DetachChild), follow the container's init instead. Once the
+// init exited, Wait reads the container's final cgroup counters and
+// deletes it.
+func (x *RuntimeContext) followInit(id string, res *RunResult) {
+	// A copy: the child may exit after the context was closed
+	hasRoot, root := x.c.state_root != nil, C.GoString(x.c.state_root)
+	res.waiter.handOff(func() (int, error) {
+		var stateRoot *C.char
+		if hasRoot {
+			stateRoot = C.CString(root)
+			defer C.free(unsafe.Pointer(stateRoot))
+		}
+		cid := C.CString(id)
+		defer C.free(unsafe.Pointer(cid))
+		var pid C.pid_t
+		var err C.libcrun_error_t
+		if C.go_crun_status_pid(stateRoot, cid, &pid, &err) < 0 {
+			return -1, fromLibcrunErr(&err)
+		}
+		return int(pid), nil
+	})
+	wait := res.Wait
+	res.Wait = func() (int, error) {
+		code, err := wait()
+		if st := x.finalStats(id); st != nil {
+			res.final.Store(st)
+		}
+		if derr := res.Container.Delete(true); derr != nil && !errors.Is(derr, ErrContainerNotFound) && err == nil {
+			return -1, derr
+		}
+		return code, err
+	}
+}
+
+// FinalStats returns the counters of the container's cgroup v2 read just
+// before libcrun destroyed the cgroup, once Wait has returned: unlike
+// Stats, they cover the container's whole life, memory.peak included. It
+// is nil for an exec, without cgroup v2, and when the child did not run
+// the container to its deletion (RestoreWithIO, a failed launch).
+func (r *RunResult) FinalStats() *Stats {
+	return r.final.Load()
+}
+
+// WaitStatus is Wait, returning the exit code along with the child's
+// resource usage and the container's final cgroup counters.
+func (r *RunResult) WaitStatus() (*RunStatus, error) {
+	code, err := r.Wait()
+	if err != nil {
+		return nil, err
+	}
+	return &RunStatus{ExitCode: code, Usage: r.Usage(), Cgroup: r.FinalStats()}, nil
+}
+
+// acquireContext returns a shallow clone of the base context carrying id,
+// taken from the free list when possible. Release it with releaseContext.
+func (x *RuntimeContext) acquireContext(id string) (*C.libcrun_context_t, error) {
+	return x.acquireLaunchContext(id, nil, false)
+}
+
+// acquireLaunchContext is acquireContext for the launch of container id,
+// which also assigns it a cgroup of the context's CgroupPool if pooled and
+// spec (nil when not known) does not set linux.cgroupsPath. pooled is for
+// launches run by libcrun in this process or a child forked from it, which
+// sees the assignment.
+func (x *RuntimeContext) acquireLaunchContext(id string, spec *ContainerSpec, pooled bool) (*C.libcrun_context_t, error) {
+	var cl *C.libcrun_context_t
+	x.clonesMu.Lock()
+	if n := len(x.clones); n > 0 {
+		cl = x.clones[n-1]
+		x.clones = x.clones[:n-1]
+	}
+	x.clonesMu.Unlock()
+
+	cid := C.CString(id)
+	defer C.free(unsafe.Pointer(cid))
+	c := C.go_crun_clone_context(cl, x.c, cid)
+	if c == nil {
+		freeContextClone(cl)
+		return nil, errors.New("libcrun: failed to allocate context")
+	}
+	if cl == nil {
+		trackContextClone()
+	}
+	registered := false
+	if x.notify != nil {
+		// the next acquireContext copies the base's back over it
+		path, fresh, err := x.notify.register(id)
+		if err != nil {
+			x.releaseContext(c)
+			return nil, err
+		}
+		c.notify_socket = path
+		registered = fresh
+	}
+	if x.cgroupPool != nil && pooled && (spec == nil || !spec.hasCgroupsPath()) {
+		if err := x.cgroupPool.assign(x.c.state_root, id); err != nil {
+			if registered {
+				x.notify.release(id)
+			}
+			x.releaseContext(c)
+			return nil, err
+		}
+	}
+	return c, nil
 }
 
-// setContextID sets the container ID on the context for create/run operations.
-func (x *RuntimeContext) setContextID(id string) {
-	if x.c.id != nil {
-		C.free(unsafe.Pointer(x.c.id))
+// releaseContext returns a clone obtained from acquireContext to the free list.
+func (x *RuntimeContext) releaseContext(c *C.libcrun_context_t) {
+	x.clonesMu.Lock()
+	if len(x.clones) < maxIdleContextClones {
+		x.clones = append(x.clones, c)
+		c = nil
 	}
-	x.c.id = C.CString(id)
+	x.clonesMu.Unlock()
+	freeContextClone(c)
 }
 
 // Run creates and starts the container in one operation.
 // Returns a Container handle for further operations.
 // WARNING: This method may hang if the container writes to stdout/stderr without
 // proper I/O handling. Consider using RunWithIO for reliable operation.
-func (x *RuntimeContext) Run(id string, spec *ContainerSpec, o RunOptions) (*Container, error) {
+func (x *RuntimeContext) Run(id string, spec *ContainerSpec, o RunOptions) (_ *Container, rerr error) {
+	defer x.trace(OpRun, id).end(&rerr)
 	if x == nil || x.c == nil || spec == nil || spec.c == nil {
 		return nil, errors.New("libcrun: invalid runtime context or container spec")
 	}
-	x.setContextID(id)
+	c, cerr := x.acquireLaunchContext(id, spec, true)
+	if cerr != nil {
+		return nil, cerr
+	}
+	defer x.cgroupLaunchDone(id)
+	defer x.releaseContext(c)
 	var err C.libcrun_error_t
-	rc := C.libcrun_container_run(x.c, spec.c, runFlags(o), &err)
+	run := func() C.int { return C.libcrun_container_run(c, spec.c, runFlags(o), &err) }
+	rc, oerr := x.launchInProcess(id, spec, bool(x.c.detach), func() C.int {
+		if !bool(x.c.detach) {
+			// Blocks until the container exits: not for a worker
+			logged := x.beginLog(c.id)
+			defer endLog(logged)
+			return run()
+		}
+		return x.blocking(c.id, run)
+	})
+	if oerr != nil {
+		return nil, oerr
+	}
 	if rc < 0 {
 		return nil, fromLibcrunErr(&err)
 	}
-	return &Container{ID: id, runtime: x}, nil
+	x.indexLaunch(id, bool(x.c.detach))
+	return &Container{ID: id, runtime: x, launched: true}, nil
 }
 
 // RunWithIO creates and starts the container with isolated I/O streams using pipes.
@@ -300,6 +643,11 @@ func (x *RuntimeContext) Run(id string, spec *ContainerSpec, o RunOptions) (*Con
 //
 // See the crungo example for a complete implementation of TTY support.
 func (x *RuntimeContext) RunWithIO(id string, spec *ContainerSpec, ioCfg *IOConfig) (*RunResult, error) {
+	return x.runWithIO(id, spec, nil, ioCfg)
+}
+
+func (x *RuntimeContext) runWithIO(id string, spec *ContainerSpec, ov *RunOverrides, ioCfg *IOConfig) (_ *RunResult, rerr error) {
+	defer x.trace(OpRun, id).end(&rerr)
 	if x == nil || x.c == nil || spec == nil || spec.c == nil {
 		return nil, errors.New("libcrun: invalid runtime context or container spec")
 	}
@@ -307,198 +655,322 @@ func (x *RuntimeContext) RunWithIO(id string, spec *ContainerSpec, ioCfg *IOConf
 		ioCfg = &IOConfig{}
 	}
 
-	// Create pipes for I/O (before locking to minimize lock time)
-	var stdinR, stdinW, stdoutR, stdoutW, stderrR, stderrW *os.File
-	var logR, logW *os.File
-	var err error
-
-	// Helper to close all opened pipes on error
-	closePipes := func() {
-		if stdinR != nil {
-			stdinR.Close()
-		}
-		if stdinW != nil {
-			stdinW.Close()
-		}
-		if stdoutR != nil {
-			stdoutR.Close()
-		}
-		if stdoutW != nil {
-			stdoutW.Close()
-		}
-		if stderrR != nil {
-			stderrR.Close()
-		}
-		if stderrW != nil {
-			stderrW.Close()
-		}
-		if logR != nil {
-			logR.Close()
-		}
-		if logW != nil {
-			logW.Close()
+	detachChild := ioCfg.DetachChild && !bool(x.c.detach)
+	if detachChild {
+		if r := processReaper.Load(); r == nil || !r.subreaper {
+			return nil, errors.New("libcrun: DetachChild needs EnableReaper with Subreaper")
 		}
 	}
 
-	// Stdin pipe (Go writes to stdinW, child reads from stdinR)
-	stdinFd := C.int(-1)
-	if ioCfg.Stdin != nil {
-		stdinR, stdinW, err = os.Pipe()
-		if err != nil {
-			return nil, err
-		}
-		stdinFd = C.int(stdinR.Fd())
+	// Create pipes for I/O (before cloning the context)
+	handler := x.effectiveLogHandler()
+	p, err := openRunPipes(ioCfg, handler != nil)
+	if err != nil {
+		return nil, err
 	}
+	stdinFd, stdoutFd, stderrFd, logFd := p.childFds()
 
-	// Stdout pipe (child writes to stdoutW, Go reads from stdoutR)
-	stdoutFd := C.int(-1)
-	if ioCfg.Stdout != nil {
-		stdoutR, stdoutW, err = os.Pipe()
-		if err != nil {
-			closePipes()
-			return nil, err
-		}
-		stdoutFd = C.int(stdoutW.Fd())
+	// Per-call context clone carrying the ID (fork copies it into the child)
+	// A Launcher's helpers, forked earlier, and Spawn's program do not see
+	// the cgroup pool's assignments
+	c, runErr := x.acquireLaunchContext(id, spec, ioCfg.Launcher == nil && !ioCfg.Spawn)
+	if runErr != nil {
+		p.closeChild()
+		p.closeParent()
+		return nil, runErr
+	}
+	if ioCfg.consoleSocket != "" {
+		// the next acquireContext copies the base's back over it
+		cs := C.CString(ioCfg.consoleSocket)
+		defer C.free(unsafe.Pointer(cs))
+		c.console_socket = cs
+	}
+	if detachChild {
+		c.detach = true
+	}
+	ov, overlay, runErr := x.overlayLaunchIO(id, spec, ov)
+	if runErr != nil {
+		x.releaseContext(c)
+		x.cgroupLaunchDone(id)
+		p.closeChild()
+		p.closeParent()
+		return nil, runErr
 	}
 
-	// Stderr pipe (child writes to stderrW, Go reads from stderrR)
-	stderrFd := C.int(-1)
-	if ioCfg.Stderr != nil {
-		stderrR, stderrW, err = os.Pipe()
-		if err != nil {
-			closePipes()
-			return nil, err
+	// Call C function to fork and run, or hand the launch to a helper
+	cov := ov.toC(x.childVerbosity())
+	var childPid C.pid_t
+	var cerr C.libcrun_error_t
+	if overlay {
+		spec.rootMu.RLock()
+	}
+	if ioCfg.Launcher != nil {
+		childPid, runErr = ioCfg.Launcher.run(c, spec, cov.c, runFlags(RunOptions{}),
+			stdinFd, stdoutFd, stderrFd, logFd)
+	} else if ioCfg.Spawn {
+		if rc := x.onWorker(func() C.int {
+			return C.go_crun_spawn_with_pipes(c, spec.c, cov.c, runFlags(RunOptions{}),
+				stdinFd, stdoutFd, stderrFd, logFd, &childPid, &cerr)
+		}); rc < 0 {
+			runErr = fromLibcrunErr(&cerr)
 		}
-		stderrFd = C.int(stderrW.Fd())
+	} else if rc := x.onWorker(func() C.int {
+		return C.go_crun_run_with_pipes(c, spec.c, cov.c, runFlags(RunOptions{}),
+			stdinFd, stdoutFd, stderrFd, logFd, &childPid, &cerr)
+	}); rc < 0 {
+		runErr = fromLibcrunErr(&cerr)
+	}
+	if overlay {
+		spec.rootMu.RUnlock()
 	}
+	cov.free()
+	x.releaseContext(c)
 
-	// Log pipe (child writes structured logs, Go reads and forwards to handler)
-	// Only create if a log handler is registered
-	logFd := C.int(-1)
-	handler := getLogHandler()
-	if handler != nil {
-		logR, logW, err = os.Pipe()
-		if err != nil {
-			closePipes()
-			return nil, err
+	// Close child-side fds in Go (Go owns all fds, C doesn't close them)
+	p.closeChild()
+	if runErr != nil {
+		p.closeParent()
+		if overlay {
+			x.releaseOverlay(id)
 		}
-		logFd = C.int(logW.Fd())
+		x.cgroupLaunchDone(id)
+		return nil, runErr
 	}
 
-	// Lock to protect context ID during fork (fork copies the context)
-	x.mu.Lock()
-	x.setContextID(id)
+	res := x.startRunIO(id, ioCfg, handler, p.stdinW, p.stdoutR, p.stderrR, p.logR, childPid)
+	if detachChild {
+		x.followInit(id, res)
+	}
+	x.indexLaunchIO(id, res)
+	x.cgroupLaunchedIO(id, res)
+	if overlay {
+		x.overlayLaunched(id, res)
+	}
+	return res, nil
+}
 
-	// Call C function to fork and run
-	var childPid C.pid_t
-	var cerr C.libcrun_error_t
-	rc := C.go_crun_run_with_pipes(x.c, spec.c, runFlags(RunOptions{}),
-		stdinFd, stdoutFd, stderrFd, logFd, &childPid, &cerr)
-	x.mu.Unlock()
+// runPipes holds the stdio and log pipes of a RunWithIO or ExecWithIO
+// child. Streams backed by a blocking *os.File are handed to the child as
+// is (see passthroughFile); only the others get a pipe and, later, a copy
+// goroutine. Any field may be nil.
+type runPipes struct {
+	stdinR, stdinW   *os.File // Go writes to stdinW, child reads from stdinR
+	stdoutR, stdoutW *os.File // child writes to stdoutW, Go reads from stdoutR
+	stderrR, stderrW *os.File // child writes to stderrW, Go reads from stderrR
+	logR, logW       *os.File // child writes structured logs, Go forwards them
+}
 
-	// Close child-side fds in Go (Go owns all fds, C doesn't close them)
-	if stdinR != nil {
-		stdinR.Close()
+// openRunPipes creates the pipes selected by ioCfg, plus the log pipe when
+// withLog is set.
+func openRunPipes(ioCfg *IOConfig, withLog bool) (*runPipes, error) {
+	p := &runPipes{}
+	var err error
+	fail := func() (*runPipes, error) {
+		p.closeChild()
+		p.closeParent()
+		return nil, err
 	}
-	if stdoutW != nil {
-		stdoutW.Close()
+	if ioCfg.Stdin != nil {
+		if p.stdinR = passthroughFile(ioCfg.Stdin); p.stdinR == nil {
+			if p.stdinR, p.stdinW, err = os.Pipe(); err != nil {
+				return fail()
+			}
+			resizePipe(p.stdinW, ioCfg.PipeSize)
+		}
 	}
-	if stderrW != nil {
-		stderrW.Close()
+	stdout, stderr := ioCfg.outputs()
+	if stdout != nil {
+		if p.stdoutW = passthroughFile(stdout); p.stdoutW == nil {
+			if p.stdoutR, p.stdoutW, err = os.Pipe(); err != nil {
+				return fail()
+			}
+			resizePipe(p.stdoutR, ioCfg.PipeSize)
+		}
 	}
-	if logW != nil {
-		logW.Close()
+	if stderr != nil {
+		if p.stderrW = passthroughFile(stderr); p.stderrW == nil {
+			if p.stderrR, p.stderrW, err = os.Pipe(); err != nil {
+				return fail()
+			}
+			resizePipe(p.stderrR, ioCfg.PipeSize)
+		}
 	}
-
-	if rc < 0 {
-		// Cleanup remaining pipes on error
-		if stdinW != nil {
-			stdinW.Close()
+	if withLog {
+		if p.logR, p.logW, err = os.Pipe(); err != nil {
+			return fail()
 		}
-		if stdoutR != nil {
-			stdoutR.Close()
+	}
+	return p, nil
+}
+
+// childFds returns the descriptors the child uses (-1 when absent).
+func (p *runPipes) childFds() (stdin, stdout, stderr, log C.int) {
+	fd := func(f *os.File) C.int {
+		if f == nil {
+			return -1
 		}
-		if stderrR != nil {
-			stderrR.Close()
+		return C.int(f.Fd())
+	}
+	return fd(p.stdinR), fd(p.stdoutW), fd(p.stderrW), fd(p.logW)
+}
+
+// closeChild closes the child-side ends once the child holds its copies.
+func (p *runPipes) closeChild() {
+	for _, f := range []*os.File{p.stdinR, p.stdoutW, p.stderrW, p.logW} {
+		if f != nil {
+			f.Close()
 		}
-		if logR != nil {
-			logR.Close()
+	}
+}
+
+// closeParent closes the parent-side ends when the launch failed.
+func (p *runPipes) closeParent() {
+	for _, f := range []*os.File{p.stdinW, p.stdoutR, p.stderrR, p.logR} {
+		if f != nil {
+			f.Close()
 		}
-		return nil, fromLibcrunErr(&cerr)
 	}
+}
 
+// startRunIO starts the I/O goroutines for a launched RunWithIO child and
+// builds its RunResult. The parent-side pipe ends (any may be nil) are
+// closed by the goroutines once the streams end.
+func (x *RuntimeContext) startRunIO(id string, ioCfg *IOConfig, handler LogHandler,
+	stdinW, stdoutR, stderrR, logR *os.File, childPid C.pid_t) *RunResult {
 	// Start I/O goroutines
 	var wg sync.WaitGroup
 
-	if ioCfg.Stdin != nil && stdinW != nil {
-		wg.Add(1)
-		go func() {
-			defer wg.Done()
-			defer stdinW.Close()
-			_, _ = io.Copy(stdinW, ioCfg.Stdin)
-		}()
+	var inBytes, inFull, outBytes, outFull, errBytes, errFull *atomic.Int64
+	if st := ioCfg.Stats; st != nil {
+		inBytes, inFull = &st.StdinBytes, &st.StdinFull
+		outBytes, outFull = &st.StdoutBytes, &st.StdoutFull
+		errBytes, errFull = &st.StderrBytes, &st.StderrFull
 	}
 
-	if ioCfg.Stdout != nil && stdoutR != nil {
+	if ioCfg.Stdin != nil && stdinW != nil {
 		wg.Add(1)
 		go func() {
 			defer wg.Done()
-			defer stdoutR.Close()
-			_, _ = io.Copy(ioCfg.Stdout, stdoutR)
+			defer stdinW.Close()
+			copyStream(stdinW, ioCfg.Stdin, stdinW, inBytes, inFull)
 		}()
 	}
 
-	if ioCfg.Stderr != nil && stderrR != nil {
+	if ioCfg.OnLines != nil {
+		var queueFull *atomic.Int64
+		if st := ioCfg.Stats; st != nil {
+			queueFull = &st.LinesQueueFull
+		}
+		streams := 0
+		for _, f := range []*os.File{stdoutR, stderrR} {
+			if f != nil {
+				streams++
+			}
+		}
+		sink := newLineSink(ioCfg.OnLines, ioCfg.Lines, streams, queueFull)
 		wg.Add(1)
 		go func() {
 			defer wg.Done()
-			defer stderrR.Close()
-			_, _ = io.Copy(ioCfg.Stderr, stderrR)
+			sink.deliver()
 		}()
+		if stdoutR != nil {
+			wg.Add(1)
+			go func() {
+				defer wg.Done()
+				defer stdoutR.Close()
+				sink.frame(stdoutR, StreamStdout, stdoutR, outBytes, outFull)
+			}()
+		}
+		if stderrR != nil {
+			wg.Add(1)
+			go func() {
+				defer wg.Done()
+				defer stderrR.Close()
+				sink.frame(stderrR, StreamStderr, stderrR, errBytes, errFull)
+			}()
+		}
+	} else {
+		output := func(dst io.Writer, r *os.File, n, full *atomic.Int64) {
+			wg.Add(1)
+			if e := ioCfg.Engine; e != nil && e.addOutput(r, dst, n, full, wg.Done) == nil {
+				return
+			}
+			go func() {
+				defer wg.Done()
+				defer r.Close()
+				copyStream(dst, r, r, n, full)
+			}()
+		}
+		if ioCfg.Stdout != nil && stdoutR != nil {
+			output(ioCfg.Stdout, stdoutR, outBytes, outFull)
+		}
+		if ioCfg.Stderr != nil && stderrR != nil {
+			output(ioCfg.Stderr, stderrR, errBytes, errFull)
+		}
 	}
 
 	// Start log reader goroutine if handler is set
 	if handler != nil && logR != nil {
 		wg.Add(1)
-		go func() {
-			defer wg.Done()
-			defer logR.Close()
-			readLogPipe(logR, handler)
-		}()
+		if e := ioCfg.Engine; e == nil || e.addLog(logR, id, handler, wg.Done) != nil {
+			go func() {
+				defer wg.Done()
+				defer logR.Close()
+				readLogPipe(logR, id, handler)
+			}()
+		}
 	}
 
 	// Create Wait function
-	waitFn := func() (int, error) {
-		var exitCode C.int
-		var werr C.libcrun_error_t
-		wrc := C.go_crun_wait(childPid, &exitCode, &werr)
-		if wrc < 0 {
-			return -1, fromLibcrunErr(&werr)
+	waiter := newChildWaiter(int(childPid))
+	res := &RunResult{
+		Container: &Container{ID: id, runtime: x, launched: true},
+		waiter:    waiter,
+	}
+	snapshot := exitSnapshotDir(x.stateRootDir(), int(childPid))
+	res.Wait = func() (_ int, rerr error) {
+		defer x.trace(OpWait, id).end(&rerr)
+		exitCode, err := waiter.wait()
+		if !res.exec {
+			if st := loadExitSnapshot(snapshot, id); st != nil {
+				res.final.Store(st)
+			}
+		}
+		if err != nil {
+			return -1, err
 		}
 		// Wait for I/O goroutines to finish
 		wg.Wait()
-		return int(exitCode), nil
+		return exitCode, nil
 	}
-
-	return &RunResult{
-		Container: &Container{ID: id, runtime: x},
-		Wait:      waitFn,
-	}, nil
+	return res
 }
 
 // Create creates the container (does not start).
 // Returns a Container handle for further operations.
-func (x *RuntimeContext) Create(id string, spec *ContainerSpec, o CreateOptions) (*Container, error) {
+func (x *RuntimeContext) Create(id string, spec *ContainerSpec, o CreateOptions) (_ *Container, rerr error) {
+	defer x.trace(OpCreate, id).end(&rerr)
 	if x == nil || x.c == nil || spec == nil || spec.c == nil {
 		return nil, errors.New("libcrun: invalid runtime context or container spec")
 	}
-	x.setContextID(id)
+	c, cerr := x.acquireLaunchContext(id, spec, true)
+	if cerr != nil {
+		return nil, cerr
+	}
+	defer x.cgroupLaunchDone(id)
+	defer x.releaseContext(c)
 	var err C.libcrun_error_t
-	rc := C.libcrun_container_create(x.c, spec.c, createFlags(o), &err)
+	rc, oerr := x.launchInProcess(id, spec, true, func() C.int {
+		return x.blocking(c.id, func() C.int { return C.libcrun_container_create(c, spec.c, createFlags(o), &err) })
+	})
+	if oerr != nil {
+		return nil, oerr
+	}
 	if rc < 0 {
 		return nil, fromLibcrunErr(&err)
 	}
-	return &Container{ID: id, runtime: x}, nil
+	x.indexLaunch(id, true)
+	return &Container{ID: id, runtime: x, launched: true}, nil
 }
 
 // List returns Container handles for all containers under the configured state root.
@@ -506,100 +978,243 @@ func (x *RuntimeContext) List() ([]*Container, error) {
 	if x == nil || x.c == nil {
 		return nil, errors.New("libcrun: invalid runtime context")
 	}
-	var arr **C.char
-	var n C.int
-	var err C.libcrun_error_t
-	rc := C.go_crun_list(x.c.state_root, &arr, &n, &err)
-	if rc < 0 {
-		return nil, fromLibcrunErr(&err)
+	if x.index != nil {
+		ids := x.index.list()
+		out := make([]*Container, len(ids))
+		for i, id := range ids {
+			out[i] = &Container{ID: id, runtime: x}
+		}
+		return out, nil
 	}
-	defer C.go_crun_free_strv(arr, n)
-
-	out := make([]*Container, int(n))
-	elems := unsafe.Slice((**C.char)(unsafe.Pointer(arr)), int(n))
-	for i := 0; i < int(n); i++ {
-		out[i] = &Container{ID: C.GoString(elems[i]), runtime: x}
+	out := []*Container{}
+	err := x.IterIDs(func(id string) bool {
+		out = append(out, &Container{ID: id, runtime: x})
+		return true
+	})
+	if err != nil {
+		return nil, err
 	}
 	return out, nil
 }
 
-// ListIDs returns container IDs under the configured state root.
+// ListIDs returns container IDs under the configured state root. IterIDs
+// walks them without building the list.
 func (x *RuntimeContext) ListIDs() ([]string, error) {
 	if x == nil || x.c == nil {
 		return nil, errors.New("libcrun: invalid runtime context")
 	}
-	var arr **C.char
+	if x.index != nil {
+		return x.index.list(), nil
+	}
+	out := []string{}
+	err := x.IterIDs(func(id string) bool {
+		out = append(out, id)
+		return true
+	})
+	if err != nil {
+		return nil, err
+	}
+	return out, nil
+}
+
+// ListOptions controls ListWithState.
+type ListOptions struct {
+	// Workers fans the status reads out over this many goroutines.
+	// 0 or 1 reads them sequentially in a single cgo call.
+	Workers int
+}
+
+// listChunk is the minimum number of containers per ListWithState worker.
+const listChunk = 64
+
+// ListWithState returns the state of every container under the state root,
+// appending to dst[:0] so that a caller polling periodically can reuse the
+// same slice. ID and Bundle strings of dst entries are reused when they
+// are unchanged, which makes repeated sweeps nearly allocation-free.
+//
+// Entries have OciVersion, ID, Status, Pid, Bundle and Created set;
+// Annotations are not loaded (use Container.State). Containers deleted
+// while the sweep runs are left out. If a status cannot be read for
+// another reason, the first such error is returned along with the
+// entries that were read.
+func (x *RuntimeContext) ListWithState(dst []ContainerState, o ListOptions) ([]ContainerState, error) {
+	if x == nil || x.c == nil {
+		return dst[:0], errors.New("libcrun: invalid runtime context")
+	}
+	var entries *C.struct_go_crun_list_entry
 	var n C.int
-	var err C.libcrun_error_t
-	rc := C.go_crun_list(x.c.state_root, &arr, &n, &err)
-	if rc < 0 {
-		return nil, fromLibcrunErr(&err)
+	if x.index != nil {
+		entries, n = x.index.listEntries()
+	} else {
+		var err C.libcrun_error_t
+		if x.onWorker(func() C.int { return C.go_crun_list_entries(x.c.state_root, &entries, &n, &err) }) < 0 {
+			return dst[:0], fromLibcrunErr(&err)
+		}
+	}
+	defer C.go_crun_free_list_entries(entries, n)
+
+	total := int(n)
+	workers := o.Workers
+	if max := (total + listChunk - 1) / listChunk; workers > max {
+		workers = max
+	}
+	if workers <= 1 {
+		x.onWorker(func() C.int { C.go_crun_read_list_states(x.c.state_root, entries, 0, n); return 0 })
+	} else {
+		var wg sync.WaitGroup
+		per := (total + workers - 1) / workers
+		for from := 0; from < total; from += per {
+			to := min(from+per, total)
+			wg.Add(1)
+			go func(from, to int) {
+				defer wg.Done()
+				x.onWorker(func() C.int {
+					C.go_crun_read_list_states(x.c.state_root, entries, C.int(from), C.int(to))
+					return 0
+				})
+			}(from, to)
+		}
+		wg.Wait()
+	}
+
+	prev := dst[:cap(dst)]
+	out := dst[:0]
+	var firstErr error
+	es := unsafe.Slice(entries, total)
+	for i := range es {
+		e := &es[i] // by reference: fromLibcrunErr releases e.err in place
+		if e.status == nil {
+			if e.err != nil && (*e.err).status != C.int(syscall.ENOENT) && firstErr == nil {
+				firstErr = fromLibcrunErr(&e.err)
+			}
+			continue
+		}
+		var old ContainerState
+		if len(out) < len(prev) {
+			old = prev[len(out)]
+		}
+		out = append(out, ContainerState{
+			OciVersion: stateOCIVersion,
+			ID:         reuseCString(old.ID, e.id),
+			Status:     containerStatusFromC(e.status),
+			Pid:        int(e.pid),
+			Bundle:     reuseCString(old.Bundle, e.bundle),
+			Created:    parseCTime(e.created),
+		})
+	}
+	return out, firstErr
+}
+
+// reuseCString returns old if it equals the C string s, else a copy of s.
+func reuseCString(old string, s *C.char) string {
+	if s == nil {
+		return ""
+	}
+	if v := unsafe.String((*byte)(unsafe.Pointer(s)), int(C.strlen(s))); v != old {
+		return strings.Clone(v)
 	}
-	defer C.go_crun_free_strv(arr, n)
+	return old
+}
 
-	out := make([]string, int(n))
-	elems := unsafe.Slice((**C.char)(unsafe.Pointer(arr)), int(n))
-	for i := 0; i < int(n); i++ {
-		out[i] = C.GoString(elems[i])
+// parseCTime parses an RFC 3339 timestamp held in C memory, returning the
+// zero time if s is NULL or malformed.
+func parseCTime(s *C.char) time.Time {
+	if s == nil {
+		return time.Time{}
 	}
-	return out, nil
+	// time.Parse keeps no reference to its input
+	t, err := time.Parse(time.RFC3339Nano, unsafe.String((*byte)(unsafe.Pointer(s)), int(C.strlen(s))))
+	if err != nil {
+		return time.Time{}
+	}
+	return t
 }
 
 // internal methods for Container to use
 
-func (x *RuntimeContext) deleteContainer(id string, force bool) error {
+func (x *RuntimeContext) deleteContainer(id string, r *containerRef, force bool) (rerr error) {
+	defer x.trace(OpDelete, id).end(&rerr)
 	if x == nil || x.c == nil {
 		return errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
-	defer C.free(unsafe.Pointer(cid))
+	cid := r.cidFor(id)
+	defer r.release(cid)
 	var err C.libcrun_error_t
-	rc := C.libcrun_container_delete(x.c, nil, cid, C.bool(force), &err)
+	rc := x.blocking(cid, func() C.int { return C.libcrun_container_delete(x.c, nil, cid, C.bool(force), &err) })
 	if rc < 0 {
 		return fromLibcrunErr(&err)
 	}
+	r.invalidate()
+	x.index.remove(id)
+	x.releaseOverlay(id)
+	x.notify.release(id)
+	x.cgroupPool.release(x.c.state_root, id)
 	return nil
 }
 
-func (x *RuntimeContext) killContainer(id string, signal Signal) error {
+func (x *RuntimeContext) killContainer(id string, r *containerRef, signal Signal) (rerr error) {
+	defer x.trace(OpKill, id).end(&rerr)
 	if x == nil || x.c == nil {
 		return errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
+	cid := r.cidFor(id)
 	csig := C.CString(string(signal))
-	defer C.free(unsafe.Pointer(cid))
+	defer r.release(cid)
 	defer C.free(unsafe.Pointer(csig))
 	var err C.libcrun_error_t
-	rc := C.libcrun_container_kill(x.c, cid, csig, &err)
+	rc := x.blocking(cid, func() C.int {
+		if r != nil {
+			r.mu.Lock()
+			defer r.mu.Unlock()
+			return C.go_crun_ref_kill(x.c, r.c, csig, &err)
+		}
+		return C.libcrun_container_kill(x.c, cid, csig, &err)
+	})
 	if rc < 0 {
 		return fromLibcrunErr(&err)
 	}
 	return nil
 }
 
-func (x *RuntimeContext) startContainer(id string) error {
+func (x *RuntimeContext) startContainer(id string, r *containerRef) (rerr error) {
+	defer x.trace(OpStart, id).end(&rerr)
 	if x == nil || x.c == nil {
 		return errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
-	defer C.free(unsafe.Pointer(cid))
+	cid := r.cidFor(id)
+	defer r.release(cid)
+	ctx := x.c
+	if x.notify != nil {
+		// libcrun relays the container's readiness from start
+		c, err := x.acquireContext(id)
+		if err != nil {
+			return err
+		}
+		defer x.releaseContext(c)
+		ctx = c
+	}
 	var err C.libcrun_error_t
-	rc := C.libcrun_container_start(x.c, cid, &err)
+	rc := x.blocking(cid, func() C.int { return C.libcrun_container_start(ctx, cid, &err) })
 	if rc < 0 {
 		return fromLibcrunErr(&err)
 	}
 	return nil
 }
 
-func (x *RuntimeContext) containerStateJSON(id string) (string, error) {
+func (x *RuntimeContext) containerStateJSON(id string, r *containerRef) (_ string, rerr error) {
+	defer x.trace(OpState, id).end(&rerr)
 	if x == nil || x.c == nil {
 		return "", errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
-	defer C.free(unsafe.Pointer(cid))
+	cid := r.cidFor(id)
+	defer r.release(cid)
 	var err C.libcrun_error_t
 	var ln C.int
-	buf := C.go_crun_state_json(x.c, cid, &ln, &err)
+	var buf *C.char
+	x.blocking(cid, func() C.int {
+		buf = C.go_crun_state_json(x.c, cid, &ln, &err)
+		return 0
+	})
 	if buf == nil {
 		return "", fromLibcrunErr(&err)
 	}
@@ -607,102 +1222,298 @@ func (x *RuntimeContext) containerStateJSON(id string) (string, error) {
 	return C.GoStringN(buf, ln), nil
 }
 
-func (x *RuntimeContext) execJSON(id string, processJSON string) error {
+// stateOCIVersion is the ociVersion libcrun_container_state reports.
+const stateOCIVersion = "1.0.0"
+
+// readState fills st for container id straight from libcrun's status file.
+// Without details only Status and Pid are set, which skips loading the
+// saved config for the annotations. A non-nil cgroupPath receives the
+// container's cgroup path. Without details, a non-nil r serves the status
+// from its cache.
+func (x *RuntimeContext) readState(id string, r *containerRef, details bool, st *ContainerState, cgroupPath *string) (rerr error) {
+	defer x.trace(OpState, id).end(&rerr)
 	if x == nil || x.c == nil {
 		return errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
+	cid := r.cidFor(id)
+	defer r.release(cid)
+	// C memory: a Go variable passed to C would escape to the heap, and
+	// Status is meant for allocation-free polling
+	cs := (*C.struct_go_crun_state)(C.calloc(1, C.size_t(unsafe.Sizeof(C.struct_go_crun_state{}))))
+	defer C.free(unsafe.Pointer(cs))
+	flags := C.int(0)
+	if details {
+		flags |= C.GO_CRUN_STATE_DETAILS
+	}
+	if cgroupPath != nil {
+		flags |= C.GO_CRUN_STATE_CGROUP
+	}
+	var rc C.int
+	if x.exec != nil {
+		rc = x.readStateOnWorker(cid, r, details, flags, cs)
+	} else {
+		logged := x.beginLog(cid)
+		rc = x.readStateC(cid, r, details, flags, cs)
+		endLog(logged)
+	}
+	if rc < 0 {
+		return fromLibcrunErr(&cs.err)
+	}
+	defer C.go_crun_free_state(cs)
+
+	st.Status = containerStatusFromC(cs.status)
+	st.Pid = int(cs.pid)
+	if cgroupPath != nil && cs.cgroup_path != nil {
+		*cgroupPath = C.GoString(cs.cgroup_path)
+	}
+	if !details {
+		return nil
+	}
+	st.OciVersion = stateOCIVersion
+	st.ID = id
+	if cs.bundle != nil {
+		st.Bundle = C.GoString(cs.bundle)
+	}
+	st.Created = parseCTime(cs.created)
+	if n := int(cs.annotations_len); n > 0 {
+		keys := unsafe.Slice(cs.annotation_keys, n)
+		values := unsafe.Slice(cs.annotation_values, n)
+		st.Annotations = make(map[string]string, n)
+		for i := 0; i < n; i++ {
+			st.Annotations[C.GoString(keys[i])] = C.GoString(values[i])
+		}
+	}
+	return nil
+}
+
+// readStateC reads the state of readState into cs.
+func (x *RuntimeContext) readStateC(cid *C.char, r *containerRef, details bool, flags C.int, cs *C.struct_go_crun_state) C.int {
+	if r != nil && !details {
+		r.mu.Lock()
+		defer r.mu.Unlock()
+		return C.go_crun_ref_read_state(x.c, r.c, flags, cs)
+	}
+	return C.go_crun_read_state(x.c, cid, flags, cs)
+}
+
+// readStateOnWorker is readStateC on the executor. A function of its own,
+// so that readState without an executor does not allocate the closure.
+func (x *RuntimeContext) readStateOnWorker(cid *C.char, r *containerRef, details bool, flags C.int, cs *C.struct_go_crun_state) C.int {
+	return x.blocking(cid, func() C.int { return x.readStateC(cid, r, details, flags, cs) })
+}
+
+// containerStatusFromC maps libcrun's static status strings to the
+// ContainerStatus constants without allocating.
+func containerStatusFromC(s *C.char) ContainerStatus {
+	if s == nil {
+		return ""
+	}
+	switch v := unsafe.String((*byte)(unsafe.Pointer(s)), int(C.strlen(s))); v {
+	case string(StatusCreating):
+		return StatusCreating
+	case string(StatusCreated):
+		return StatusCreated
+	case string(StatusRunning):
+		return StatusRunning
+	case string(StatusStopped):
+		return StatusStopped
+	case string(StatusPaused):
+		return StatusPaused
+	default:
+		return ContainerStatus(strings.Clone(v))
+	}
+}
+
+func (x *RuntimeContext) execJSON(id string, r *containerRef, processJSON string, cgroup string) (rerr error) {
+	defer x.trace(OpExec, id).end(&rerr)
+	if x == nil || x.c == nil {
+		return errors.New("libcrun: invalid runtime context")
+	}
+	cid := r.cidFor(id)
 	cjson := C.CString(processJSON)
-	defer C.free(unsafe.Pointer(cid))
+	defer r.release(cid)
 	defer C.free(unsafe.Pointer(cjson))
+	ccgroup := optCString(cgroup)
+	defer C.free(unsafe.Pointer(ccgroup))
 	var err C.libcrun_error_t
-	rc := C.go_crun_exec_json(x.c, cid, cjson, &err)
+	rc := x.blockingUnlessAttached(cid, func() C.int { return C.go_crun_exec_json(x.c, cid, cjson, ccgroup, &err) })
 	if rc < 0 {
 		return fromLibcrunErr(&err)
 	}
 	return nil
 }
 
-func (x *RuntimeContext) pauseContainer(id string) error {
+// execWithIO forks a child that execs into container id with the streams
+// of ioCfg, like runWithIO does for a container. The process is proc when
+// set (a PreparedExec, with ov applied), else processJSON.
+func (x *RuntimeContext) execWithIO(id string, r *containerRef, processJSON string, proc *C.runtime_spec_schema_config_schema_process,
+	ov *RunOverrides, cgroup string, ioCfg *IOConfig) (_ *RunResult, rerr error) {
+	defer x.trace(OpExec, id).end(&rerr)
+	if x == nil || x.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context")
+	}
+	if ioCfg == nil {
+		ioCfg = &IOConfig{}
+	}
+	handler := x.effectiveLogHandler()
+	p, err := openRunPipes(ioCfg, handler != nil)
+	if err != nil {
+		return nil, err
+	}
+	stdinFd, stdoutFd, stderrFd, logFd := p.childFds()
+
+	cid := r.cidFor(id)
+	ccgroup := optCString(cgroup)
+	cov := ov.toC(x.childVerbosity())
+	var childPid C.pid_t
+	var cerr C.libcrun_error_t
+	var rc C.int
+	if proc != nil {
+		rc = x.onWorker(func() C.int {
+			return C.go_crun_exec_prepared_with_pipes(x.c, cid, proc, cov.c, ccgroup,
+				stdinFd, stdoutFd, stderrFd, logFd, &childPid, &cerr)
+		})
+	} else {
+		cjson := C.CString(processJSON)
+		rc = x.onWorker(func() C.int {
+			return C.go_crun_exec_with_pipes(x.c, cid, cjson, cov.c, ccgroup,
+				stdinFd, stdoutFd, stderrFd, logFd, &childPid, &cerr)
+		})
+		C.free(unsafe.Pointer(cjson))
+	}
+	cov.free()
+	r.release(cid)
+	C.free(unsafe.Pointer(ccgroup))
+
+	p.closeChild()
+	if rc < 0 {
+		p.closeParent()
+		return nil, fromLibcrunErr(&cerr)
+	}
+	res := x.startRunIO(id, ioCfg, handler, p.stdinW, p.stdoutR, p.stderrR, p.logR, childPid)
+	res.exec = true
+	return res, nil
+}
+
+// execPrepared execs proc, with ov applied, into container id in-process.
+func (x *RuntimeContext) execPrepared(id string, r *containerRef, proc *C.runtime_spec_schema_config_schema_process, ov *RunOverrides, cgroup string) (rerr error) {
+	defer x.trace(OpExec, id).end(&rerr)
 	if x == nil || x.c == nil {
 		return errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
-	defer C.free(unsafe.Pointer(cid))
+	cid := r.cidFor(id)
+	defer r.release(cid)
+	ccgroup := optCString(cgroup)
+	defer C.free(unsafe.Pointer(ccgroup))
+	cov := ov.toC(-1)
+	defer cov.free()
 	var err C.libcrun_error_t
-	rc := C.go_crun_pause(x.c, cid, &err)
+	rc := x.blockingUnlessAttached(cid, func() C.int { return C.go_crun_exec_prepared(x.c, cid, proc, cov.c, ccgroup, &err) })
 	if rc < 0 {
 		return fromLibcrunErr(&err)
 	}
 	return nil
 }
 
-func (x *RuntimeContext) unpauseContainer(id string) error {
+// optCString is C.CString, with NULL for "".
+func optCString(s string) *C.char {
+	if s == "" {
+		return nil
+	}
+	return C.CString(s)
+}
+
+func (x *RuntimeContext) pauseContainer(id string, r *containerRef) (rerr error) {
+	defer x.trace(OpPause, id).end(&rerr)
 	if x == nil || x.c == nil {
 		return errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
-	defer C.free(unsafe.Pointer(cid))
+	cid := r.cidFor(id)
+	defer r.release(cid)
 	var err C.libcrun_error_t
-	rc := C.go_crun_unpause(x.c, cid, &err)
+	rc := x.blocking(cid, func() C.int { return C.go_crun_pause(x.c, cid, &err) })
 	if rc < 0 {
 		return fromLibcrunErr(&err)
 	}
 	return nil
 }
 
-func (x *RuntimeContext) killAllContainer(id string, signal Signal) error {
+func (x *RuntimeContext) unpauseContainer(id string, r *containerRef) (rerr error) {
+	defer x.trace(OpUnpause, id).end(&rerr)
 	if x == nil || x.c == nil {
 		return errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
+	cid := r.cidFor(id)
+	defer r.release(cid)
+	var err C.libcrun_error_t
+	rc := x.blocking(cid, func() C.int { return C.go_crun_unpause(x.c, cid, &err) })
+	if rc < 0 {
+		return fromLibcrunErr(&err)
+	}
+	return nil
+}
+
+func (x *RuntimeContext) killAllContainer(id string, r *containerRef, signal Signal) (rerr error) {
+	defer x.trace(OpKillAll, id).end(&rerr)
+	if x == nil || x.c == nil {
+		return errors.New("libcrun: invalid runtime context")
+	}
+	cid := r.cidFor(id)
 	csig := C.CString(string(signal))
-	defer C.free(unsafe.Pointer(cid))
+	defer r.release(cid)
 	defer C.free(unsafe.Pointer(csig))
 	var err C.libcrun_error_t
-	rc := C.go_crun_killall(x.c, cid, csig, &err)
+	rc := x.blocking(cid, func() C.int { return C.go_crun_killall(x.c, cid, csig, &err) })
 	if rc < 0 {
 		return fromLibcrunErr(&err)
 	}
 	return nil
 }
 
-func (x *RuntimeContext) updateContainer(id string, content string) error {
+func (x *RuntimeContext) updateContainer(id string, r *containerRef, content string) (rerr error) {
+	defer x.trace(OpUpdate, id).end(&rerr)
 	if x == nil || x.c == nil {
 		return errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
+	cid := r.cidFor(id)
 	ccontent := C.CString(content)
-	defer C.free(unsafe.Pointer(cid))
+	defer r.release(cid)
 	defer C.free(unsafe.Pointer(ccontent))
 	var err C.libcrun_error_t
-	rc := C.go_crun_update(x.c, cid, ccontent, C.size_t(len(content)), &err)
+	rc := x.blocking(cid, func() C.int { return C.go_crun_update(x.c, cid, ccontent, C.size_t(len(content)), &err) })
 	if rc < 0 {
 		return fromLibcrunErr(&err)
 	}
 	return nil
 }
 
-func (x *RuntimeContext) isContainerRunning(id string) (bool, error) {
+func (x *RuntimeContext) isContainerRunning(id string, r *containerRef) (bool, error) {
 	if x == nil || x.c == nil {
 		return false, errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
-	defer C.free(unsafe.Pointer(cid))
+	cid := r.cidFor(id)
+	defer r.release(cid)
 	var err C.libcrun_error_t
-	rc := C.go_crun_is_running(x.c.state_root, cid, &err)
+	rc := x.onWorker(func() C.int {
+		if r != nil {
+			r.mu.Lock()
+			defer r.mu.Unlock()
+			return C.go_crun_ref_is_running(x.c, r.c, &err)
+		}
+		return C.go_crun_is_running(x.c.state_root, cid, &err)
+	})
 	if rc < 0 {
 		return false, fromLibcrunErr(&err)
 	}
 	return rc > 0, nil
 }
 
-func (x *RuntimeContext) containerPIDs(id string, recurse bool) ([]int, error) {
+func (x *RuntimeContext) containerPIDs(id string, r *containerRef, recurse bool) ([]int, error) {
 	if x == nil || x.c == nil {
 		return nil, errors.New("libcrun: invalid runtime context")
 	}
-	cid := C.CString(id)
-	defer C.free(unsafe.Pointer(cid))
+	cid := r.cidFor(id)
+	defer r.release(cid)
 	var pids *C.pid_t
 	var n C.int
 	var err C.libcrun_error_t
@@ -710,11 +1521,19 @@ func (x *RuntimeContext) containerPIDs(id string, recurse bool) ([]int, error) {
 	if recurse {
 		recurseInt = 1
 	}
-	rc := C.go_crun_read_pids(x.c, cid, C.int(recurseInt), &pids, &n, &err)
+	rc := x.blocking(cid, func() C.int {
+		if r != nil {
+			r.mu.Lock()
+			defer r.mu.Unlock()
+			return C.go_crun_ref_read_pids(x.c, r.c, C.int(recurseInt), &pids, &n, &err)
+		}
+		return C.go_crun_read_pids(x.c, cid, C.int(recurseInt), &pids, &n, &err)
+	})
 	if rc < 0 {
 		return nil, fromLibcrunErr(&err)
 	}
 	defer C.go_crun_free_pids(pids)
+	defer trackPidArray(int(n))()
 
 	out := make([]int, int(n))
 	if n > 0 {
@@ -732,11 +1551,56 @@ func SetVerbosity(v int) { C.libcrun_set_verbosity(C.int(v)) }
 // GetVerbosity returns the current libcrun logging verbosity level.
 func GetVerbosity() int { return int(C.libcrun_get_verbosity()) }
 
+// deviceProgramUsers counts the open contexts created with
+// RuntimeConfig.DeviceProgramReuse.
+var deviceProgramUsers struct {
+	sync.Mutex
+	n int
+}
+
+func retainDeviceProgramReuse() {
+	deviceProgramUsers.Lock()
+	defer deviceProgramUsers.Unlock()
+	if deviceProgramUsers.n++; deviceProgramUsers.n == 1 {
+		C.go_crun_set_ebpf_reuse(1)
+	}
+}
+
+// releaseDeviceProgramReuse turns reuse off, and purges the pinned
+// programs, with the last context using it.
+func releaseDeviceProgramReuse() {
+	deviceProgramUsers.Lock()
+	defer deviceProgramUsers.Unlock()
+	if deviceProgramUsers.n--; deviceProgramUsers.n == 0 {
+		C.go_crun_set_ebpf_reuse(0)
+		_ = PurgeDevicePrograms()
+	}
+}
+
+// PurgeDevicePrograms removes the cgroup v2 device programs pinned for
+// RuntimeConfig.DeviceProgramReuse. libcrun loads, and the kernel
+// verifies, an eBPF device filter for every container; with reuse, a
+// program identical to one loaded before by this process or its launchers
+// is attached by fd instead. Programs are shared across processes by
+// pinning them under /sys/fs/bpf/libcrun-go, and only used once read back
+// identical. A pin keeps its program loaded after the containers using it
+// are gone, so the pins are purged when the last context with
+// DeviceProgramReuse is closed; call PurgeDevicePrograms for those left by
+// a process that exited without closing it. Running containers keep their
+// programs, and other processes reusing programs pin them again.
+func PurgeDevicePrograms() error {
+	if rc := C.go_crun_ebpf_purge(); rc < 0 {
+		return os.NewSyscallError("purge device programs", syscall.Errno(-rc))
+	}
+	return nil
+}
+
 // LogEntry represents a log message from libcrun.
 type LogEntry struct {
-	Errno     int    // System errno if applicable, 0 otherwise
-	Message   string // Log message
-	Verbosity int    // VerbosityError, VerbosityWarning, or VerbosityDebug
+	Errno       int    // System errno if applicable, 0 otherwise
+	Message     string // Log message
+	Verbosity   int    // VerbosityError, VerbosityWarning, or VerbosityDebug
+	ContainerID string // Container the message relates to, if known
 }
 
 // LogHandler is the callback type for receiving libcrun logs.
@@ -746,18 +1610,31 @@ var (
 	logHandleMu sync.Mutex
 	logHandler  LogHandler // current handler (nil = no handler)
 	logHandle   cgo.Handle // handle for C callback (0 when no handler)
+
+	logHandlerSet atomic.Bool // lock-free view of logHandler != nil
 )
 
 //export goLogCallback
-func goLogCallback(handle C.uintptr_t, errno C.int, msg *C.char, verbosity C.int) {
-	h := cgo.Handle(handle)
-	handler := h.Value().(LogHandler)
+func goLogCallback(handle C.uintptr_t, errno C.int, msg *C.char, verbosity C.int, id *C.char) {
+	var handler LogHandler
+	switch v := cgo.Handle(handle).Value().(type) {
+	case LogHandler:
+		handler = v
+	case *logRoute:
+		if handler = v.get(); handler == nil {
+			handler = getLogHandler()
+		}
+	}
 	if handler != nil {
-		handler(LogEntry{
+		entry := LogEntry{
 			Errno:     int(errno),
 			Message:   C.GoString(msg),
 			Verbosity: int(verbosity),
-		})
+		}
+		if id != nil {
+			entry.ContainerID = C.GoString(id)
+		}
+		handler(entry)
 	}
 }
 
@@ -770,37 +1647,53 @@ func getLogHandler() LogHandler {
 
 // readLogPipe reads structured log entries from a pipe and calls the handler.
 // Wire format: [errno:4][verbosity:4][msg_len:4][message:msg_len]
-func readLogPipe(r io.Reader, handler LogHandler) {
-	for {
-		var errno, verbosity int32
-		var msgLen uint32
+func readLogPipe(r io.Reader, id string, handler LogHandler) {
+	br := logReaderPool.Get().(*bufio.Reader)
+	br.Reset(r)
+	bp := logMsgPool.Get().(*[]byte)
+	defer func() {
+		br.Reset(nil)
+		logReaderPool.Put(br)
+		if cap(*bp) <= maxPooledLogMsg {
+			logMsgPool.Put(bp)
+		}
+	}()
 
-		// Read header
-		if err := binary.Read(r, binary.LittleEndian, &errno); err != nil {
+	var hdr [12]byte
+	for {
+		// Header: errno, verbosity, message length (little endian)
+		if _, err := io.ReadFull(br, hdr[:]); err != nil {
 			return // pipe closed or error
 		}
-		if err := binary.Read(r, binary.LittleEndian, &verbosity); err != nil {
-			return
-		}
-		if err := binary.Read(r, binary.LittleEndian, &msgLen); err != nil {
-			return
-		}
+		errno := int32(binary.LittleEndian.Uint32(hdr[0:4]))
+		verbosity := int32(binary.LittleEndian.Uint32(hdr[4:8]))
+		msgLen := int(binary.LittleEndian.Uint32(hdr[8:12]))
 
-		// Read message
-		msg := make([]byte, msgLen)
-		if _, err := io.ReadFull(r, msg); err != nil {
+		if cap(*bp) < msgLen {
+			*bp = make([]byte, msgLen)
+		}
+		msg := (*bp)[:msgLen]
+		if _, err := io.ReadFull(br, msg); err != nil {
 			return
 		}
 
-		// Call handler
 		handler(LogEntry{
-			Errno:     int(errno),
-			Message:   string(msg),
-			Verbosity: int(verbosity),
+			Errno:       int(errno),
+			Message:     string(msg),
+			Verbosity:   int(verbosity),
+			ContainerID: id,
 		})
 	}
 }
 
+// maxPooledLogMsg bounds the message buffers kept in logMsgPool.
+const maxPooledLogMsg = 64 * 1024
+
+var (
+	logReaderPool = sync.Pool{New: func() any { return bufio.NewReaderSize(nil, 4096) }}
+	logMsgPool    = sync.Pool{New: func() any { b := make([]byte, 0, 512); return &b }}
+)
+
 // SetLogHandler sets a Go function to receive all libcrun log messages.
 // Pass nil to disable custom logging (reverts to stderr output).
 //
@@ -809,7 +1702,7 @@ func readLogPipe(r io.Reader, handler LogHandler) {
 //   - Forked child processes (RunWithIO) via a log pipe
 //
 // Note: The handler is called synchronously, so it should be fast and
-// non-blocking. For expensive operations, consider using a buffered channel.
+// non-blocking. For expensive operations, wrap it in an [AsyncLogHandler].
 //
 // Example:
 //
@@ -827,6 +1720,7 @@ func SetLogHandler(handler LogHandler) {
 		logHandle = 0
 	}
 	logHandler = nil
+	logHandlerSet.Store(handler != nil)
 
 	if handler == nil {
 		C.go_crun_reset_log_handler()
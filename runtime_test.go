@@ -3,7 +3,11 @@
 package crun
 
 import (
+	"bytes"
+	"encoding/binary"
+	"strings"
 	"testing"
+	"unsafe"
 )
 
 func TestRuntimeConfigDefaults(t *testing.T) {
@@ -84,3 +88,263 @@ func TestLogEntry(t *testing.T) {
 	}
 }
 
+func TestRuntimeContextLogHandler(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+
+	if rc.effectiveLogHandler() != nil {
+		t.Fatal("no handler should be set initially")
+	}
+	if rc.beginLog(nil) {
+		t.Error("beginLog should be a no-op without handlers")
+	}
+
+	var global, own int
+	SetLogHandler(func(LogEntry) { global++ })
+	defer SetLogHandler(nil)
+	rc.effectiveLogHandler()(LogEntry{})
+	if global != 1 {
+		t.Error("context without a handler should fall back to the global one")
+	}
+
+	rc.SetLogHandler(func(LogEntry) { own++ })
+	rc.effectiveLogHandler()(LogEntry{})
+	if own != 1 || global != 1 {
+		t.Errorf("own=%d global=%d, want context handler to take precedence", own, global)
+	}
+	active := rc.beginLog(nil)
+	endLog(active)
+	if !active {
+		t.Error("beginLog should route when a handler is set")
+	}
+
+	rc.SetLogHandler(nil)
+	rc.effectiveLogHandler()(LogEntry{})
+	if global != 2 {
+		t.Error("clearing the context handler should fall back to the global one")
+	}
+	if rc.logHandle.Load() == 0 {
+		t.Error("the context handle should stay valid until Close")
+	}
+	rc.Close()
+	if rc.logHandle.Load() != 0 {
+		t.Error("Close should release the context handle")
+	}
+}
+
+func TestRuntimeContextLogVerbosity(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+
+	if rc.childVerbosity() != VerbosityInherit {
+		t.Errorf("default child verbosity = %d, want inherit", rc.childVerbosity())
+	}
+	rc.SetLogVerbosity(VerbosityError)
+	if rc.childVerbosity() != VerbosityError {
+		t.Errorf("child verbosity = %d, want %d", rc.childVerbosity(), VerbosityError)
+	}
+
+	// A verbosity alone still produces C overrides carrying it
+	var ov *RunOverrides
+	co := ov.toC(rc.childVerbosity())
+	defer co.free()
+	if co.c == nil || int(co.c.verbosity) != VerbosityError {
+		t.Error("toC should carry the child verbosity")
+	}
+
+	rc.SetLogVerbosity(VerbosityInherit)
+	if rc.childVerbosity() != VerbosityInherit {
+		t.Errorf("child verbosity = %d, want inherit", rc.childVerbosity())
+	}
+}
+
+// logFrame encodes one entry the way the child's log_write_to_pipe does.
+func logFrame(errno, verbosity int32, msg string) []byte {
+	b := make([]byte, 12, 12+len(msg))
+	binary.LittleEndian.PutUint32(b[0:], uint32(errno))
+	binary.LittleEndian.PutUint32(b[4:], uint32(verbosity))
+	binary.LittleEndian.PutUint32(b[8:], uint32(len(msg)))
+	return append(b, msg...)
+}
+
+func TestReadLogPipe(t *testing.T) {
+	long := strings.Repeat("y", 100*1024) // larger than the reader buffer
+	var stream bytes.Buffer
+	stream.Write(logFrame(0, 2, "first"))
+	stream.Write(logFrame(2, 0, ""))
+	stream.Write(logFrame(13, 1, long))
+	stream.Write(logFrame(0, 2, "short again"))
+	stream.Write([]byte{1, 2, 3}) // truncated trailing header is dropped
+
+	var got []LogEntry
+	readLogPipe(&stream, "c1", func(e LogEntry) { got = append(got, e) })
+
+	want := []LogEntry{
+		{Errno: 0, Verbosity: 2, Message: "first", ContainerID: "c1"},
+		{Errno: 2, Verbosity: 0, Message: "", ContainerID: "c1"},
+		{Errno: 13, Verbosity: 1, Message: long, ContainerID: "c1"},
+		{Errno: 0, Verbosity: 2, Message: "short again", ContainerID: "c1"},
+	}
+	if len(got) != len(want) {
+		t.Fatalf("got %d entries, want %d", len(got), len(want))
+	}
+	for i := range want {
+		if got[i] != want[i] {
+			t.Errorf("entry %d = {%d %d %.20q}, want {%d %d %.20q}", i,
+				got[i].Errno, got[i].Verbosity, got[i].Message,
+				want[i].Errno, want[i].Verbosity, want[i].Message)
+		}
+	}
+}
+
+func BenchmarkReadLogPipe(b *testing.B) {
+	var stream []byte
+	for i := 0; i < 100; i++ {
+		stream = append(stream, logFrame(0, 2, "debug: setting up cgroup for container")...)
+	}
+	r := bytes.NewReader(nil)
+	handler := func(LogEntry) {}
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		r.Reset(stream)
+		readLogPipe(r, "bench", handler)
+	}
+}
+
+func TestRuntimeContextClones(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+
+	c1, err := rc.acquireContext("first")
+	if err != nil {
+		t.Fatalf("acquireContext failed: %v", err)
+	}
+	if got := goStringAt(unsafe.Pointer(c1.id)); got != "first" {
+		t.Errorf("clone id = %q, want %q", got, "first")
+	}
+	if c1.state_root != rc.c.state_root {
+		t.Error("clone should share the base state_root")
+	}
+	if rc.c.id != nil {
+		t.Error("base context id must not be modified")
+	}
+	rc.releaseContext(c1)
+
+	// The free list hands the released clone back with the new id
+	c2, err := rc.acquireContext("second")
+	if err != nil {
+		t.Fatalf("acquireContext failed: %v", err)
+	}
+	if c2 != c1 {
+		t.Error("released clone was not reused")
+	}
+	if got := goStringAt(unsafe.Pointer(c2.id)); got != "second" {
+		t.Errorf("clone id = %q, want %q", got, "second")
+	}
+	rc.releaseContext(c2)
+}
+
+func TestRuntimeContextHandlerManager(t *testing.T) {
+	a, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer a.Close()
+	b, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir(), Handler: "wasm"})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer b.Close()
+
+	// Every context shares the one manager of the process, clones included
+	if a.c.handler_manager == nil {
+		t.Fatal("context has no handler manager")
+	}
+	if b.c.handler_manager != a.c.handler_manager {
+		t.Error("contexts have different handler managers")
+	}
+	cl, err := b.acquireContext("wasm")
+	if err != nil {
+		t.Fatalf("acquireContext failed: %v", err)
+	}
+	defer b.releaseContext(cl)
+	if cl.handler_manager != b.c.handler_manager {
+		t.Error("clone does not share the handler manager")
+	}
+}
+
+// goStringAt copies a NUL-terminated C string (test files cannot use cgo).
+func goStringAt(p unsafe.Pointer) string {
+	if p == nil {
+		return ""
+	}
+	var b []byte
+	for i := uintptr(0); ; i++ {
+		c := *(*byte)(unsafe.Add(p, i))
+		if c == 0 {
+			return string(b)
+		}
+		b = append(b, c)
+	}
+}
+
+func TestRunWithIODetachChildNeedsSubreaper(t *testing.T) {
+	if r := processReaper.Load(); r != nil && r.subreaper {
+		t.Skip("the process reaper is a subreaper")
+	}
+	rc := fakeStateRoot(t)
+	spec, err := NewSpec(false, WithArgs("/bin/true"))
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	defer spec.Close()
+	if _, err := rc.RunWithIO("c1", spec, &IOConfig{DetachChild: true}); err == nil || !strings.Contains(err.Error(), "Subreaper") {
+		t.Errorf("RunWithIO without a subreaper = %v, want an error", err)
+	}
+}
+
+func TestDeviceProgramReuseOptIn(t *testing.T) {
+	users := func() int {
+		deviceProgramUsers.Lock()
+		defer deviceProgramUsers.Unlock()
+		return deviceProgramUsers.n
+	}
+	base := users()
+	off, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer off.Close()
+	if got := users(); got != base {
+		t.Errorf("device program reuse users = %d without DeviceProgramReuse, want %d", got, base)
+	}
+
+	var rcs []*RuntimeContext
+	for i := 0; i < 2; i++ {
+		rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir(), DeviceProgramReuse: true})
+		if err != nil {
+			t.Fatalf("NewRuntimeContext failed: %v", err)
+		}
+		rcs = append(rcs, rc)
+	}
+	if got := users(); got != base+2 {
+		t.Errorf("device program reuse users = %d, want %d", got, base+2)
+	}
+	for _, rc := range rcs {
+		rc.Close()
+		rc.Close()
+	}
+	if got := users(); got != base {
+		t.Errorf("device program reuse users = %d after Close, want %d", got, base)
+	}
+}
@@ -0,0 +1,475 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"encoding/json"
+	"errors"
+	"os"
+	"path/filepath"
+	"sync"
+	"syscall"
+	"unsafe"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+// Seccomp user-notification ioctls (linux/seccomp.h)
+const (
+	seccompIoctlNotifRecv    = 0xc0502100
+	seccompIoctlNotifSend    = 0xc0182101
+	seccompIoctlNotifIDValid = 0x40082102
+	seccompIoctlNotifAddFD   = 0x40182103
+
+	seccompUserNotifFlagContinue = 1 << 0
+	seccompAddFDFlagSend         = 1 << 1
+)
+
+// seccompNotif, seccompNotifResp and seccompNotifAddFD mirror struct
+// seccomp_notif, seccomp_notif_resp and seccomp_notif_addfd.
+type seccompNotif struct {
+	id    uint64
+	pid   uint32
+	flags uint32
+	nr    int32
+	arch  uint32
+	ip    uint64
+	args  [6]uint64
+}
+
+type seccompNotifResp struct {
+	id    uint64
+	val   int64
+	error int32
+	flags uint32
+}
+
+type seccompNotifAddFD struct {
+	id         uint64
+	flags      uint32
+	srcfd      uint32
+	newfd      uint32
+	newfdFlags uint32
+}
+
+// seccompAgentBatch is the most notifications SeccompAgent takes from one
+// epoll_wait before it answers them.
+const seccompAgentBatch = 64
+
+// SeccompRequest is a syscall that a container's seccomp profile turned
+// into a notification (SCMP_ACT_NOTIFY). The process is blocked in the
+// syscall until it is answered. A request is only valid during the
+// HandleSeccomp call it is passed to.
+type SeccompRequest struct {
+	// Container is the ID of the container the process belongs to.
+	Container string
+	// Metadata is the listenerMetadata of the container's seccomp profile.
+	Metadata string
+	// PID is the process's pid, in the agent's pid namespace.
+	PID int
+	// Syscall is the syscall number, in the table of Arch.
+	Syscall int
+	// Arch is the AUDIT_ARCH_* value of the syscall's convention.
+	Arch uint32
+	// InstructionPointer is the process's at the syscall.
+	InstructionPointer uint64
+	// Args are the syscall's arguments. Pointers are in the process's
+	// memory, which /proc/<PID>/mem reads; check Valid after reading it.
+	Args [6]uint64
+
+	id uint64
+	fd int // listener
+}
+
+// Valid reports whether the process is still blocked in the syscall, so
+// that what was read from its memory, or about its PID, was not changed
+// by a process that replaced it.
+func (r *SeccompRequest) Valid() bool {
+	id := r.id
+	_, _, errno := syscall.Syscall(syscall.SYS_IOCTL, uintptr(r.fd), seccompIoctlNotifIDValid, uintptr(unsafe.Pointer(&id)))
+	return errno == 0
+}
+
+// AddFD installs a duplicate of fd in the process and returns its number
+// there, for the response to report (e.g. as the Val of an emulated
+// open). With cloexec the duplicate is close-on-exec. SeccompResponse's
+// SendFD does the same and answers the request at once.
+func (r *SeccompRequest) AddFD(fd int, cloexec bool) (int, error) {
+	addfd := seccompNotifAddFD{id: r.id, srcfd: uint32(fd)}
+	if cloexec {
+		addfd.newfdFlags = syscall.O_CLOEXEC
+	}
+	n, _, errno := syscall.Syscall(syscall.SYS_IOCTL, uintptr(r.fd), seccompIoctlNotifAddFD, uintptr(unsafe.Pointer(&addfd)))
+	if errno != 0 {
+		return -1, os.NewSyscallError("ioctl SECCOMP_IOCTL_NOTIF_ADDFD", errno)
+	}
+	return int(n), nil
+}
+
+// SeccompResponse answers a SeccompRequest. The zero value makes the
+// syscall return 0 without running it.
+type SeccompResponse struct {
+	// Val is the syscall's result, when Errno is 0.
+	Val int64
+	// Errno, if not 0, fails the syscall with it.
+	Errno syscall.Errno
+	// Continue runs the syscall as the process made it, as if it had not
+	// been intercepted. The syscall's arguments are read again by the
+	// kernel, after the agent did: Continue must not be used to allow a
+	// syscall based on what its pointers point to.
+	Continue bool
+	// SendFD, if set, is installed in the process and its number returned
+	// by the syscall, in one step (Linux 5.14). The agent does not close
+	// it.
+	SendFD *os.File
+}
+
+// SeccompNotifyHandler handles the seccomp notifications a SeccompAgent
+// receives. HandleSeccomp is called from the agent's event loop, one
+// request at a time for all the containers: it must answer quickly, and
+// hand off to a goroutine of its own what may block.
+type SeccompNotifyHandler interface {
+	HandleSeccomp(req *SeccompRequest) SeccompResponse
+}
+
+// SeccompNotifyHandlerFunc adapts a function to SeccompNotifyHandler.
+type SeccompNotifyHandlerFunc func(req *SeccompRequest) SeccompResponse
+
+// HandleSeccomp calls f(req).
+func (f SeccompNotifyHandlerFunc) HandleSeccomp(req *SeccompRequest) SeccompResponse {
+	return f(req)
+}
+
+// SeccompAgent serves, in Go, the seccomp notifications of many
+// containers, e.g. to emulate mount or mknod for rootless tenants, where
+// libcrun's notify plugins must be C shared libraries. It is an OCI
+// seccomp agent: WithSeccompNotify points a spec's listenerPath at its
+// socket, over which libcrun hands it the container's listener fd at
+// create. One event loop serves all the listeners, with neither a
+// goroutine nor a thread per container: each epoll_wait takes up to 64
+// pending notifications, which the handler answers in turn.
+//
+//	agent, err := crun.NewSeccompAgent("", handler)
+//	...
+//	defer agent.Close()
+//	spec, err := crun.NewSpec(true, crun.WithSeccompNotify(agent, "mount", "mknod"), ...)
+type SeccompAgent struct {
+	path    string
+	ownDir  string // removed by Close, if not ""
+	handler SeccompNotifyHandler
+	sock    int        // listening socket
+	epoll   *epollLoop // of the socket, connections and listeners
+
+	mu      sync.Mutex
+	byFd    map[int32]*seccompPeer
+	closed  bool
+	stopped chan struct{}
+}
+
+// seccompPeer is a connection from libcrun, until it handed over a
+// listener, then that container's listener.
+type seccompPeer struct {
+	fd       int
+	listener bool
+	payload  []byte // the container's state, as the connection sends it
+	fds      []int  // received with the payload
+	// of the listener
+	container string
+	metadata  string
+}
+
+// NewSeccompAgent creates an agent listening on the socket at path, or in
+// a private temporary directory, removed by Close, when path is "". The
+// path must fit in 108 bytes.
+func NewSeccompAgent(path string, handler SeccompNotifyHandler) (*SeccompAgent, error) {
+	if handler == nil {
+		return nil, errors.New("libcrun: seccomp agent needs a handler")
+	}
+	a := &SeccompAgent{
+		path:    path,
+		handler: handler,
+		byFd:    map[int32]*seccompPeer{},
+		stopped: make(chan struct{}),
+	}
+	if path == "" {
+		d, err := os.MkdirTemp("", "libcrun-seccomp-")
+		if err != nil {
+			return nil, err
+		}
+		a.path, a.ownDir = filepath.Join(d, "agent.sock"), d
+	}
+	fd, err := syscall.Socket(syscall.AF_UNIX, syscall.SOCK_STREAM|syscall.SOCK_NONBLOCK|syscall.SOCK_CLOEXEC, 0)
+	if err != nil {
+		a.removeDir()
+		return nil, os.NewSyscallError("socket", err)
+	}
+	_ = os.Remove(a.path) // left by a previous process
+	if err := syscall.Bind(fd, &syscall.SockaddrUnix{Name: a.path}); err != nil {
+		syscall.Close(fd)
+		a.removeDir()
+		return nil, os.NewSyscallError("bind", err)
+	}
+	if err := syscall.Listen(fd, syscall.SOMAXCONN); err != nil {
+		syscall.Close(fd)
+		a.removeSocket()
+		return nil, os.NewSyscallError("listen", err)
+	}
+	a.sock = fd
+	epoll, err := newEpollLoop("seccomp-epoll")
+	if err != nil {
+		syscall.Close(fd)
+		a.removeSocket()
+		return nil, err
+	}
+	ev := syscall.EpollEvent{Events: syscall.EPOLLIN, Fd: int32(fd)}
+	if err := syscall.EpollCtl(epoll.fd(), syscall.EPOLL_CTL_ADD, fd, &ev); err != nil {
+		epoll.close()
+		syscall.Close(fd)
+		a.removeSocket()
+		return nil, os.NewSyscallError("epoll_ctl", err)
+	}
+	a.epoll = epoll
+	go a.run()
+	return a, nil
+}
+
+// Path returns the path of the agent's socket.
+func (a *SeccompAgent) Path() string { return a.path }
+
+// Containers returns the number of container listeners the agent serves.
+func (a *SeccompAgent) Containers() int {
+	a.mu.Lock()
+	defer a.mu.Unlock()
+	n := 0
+	for _, p := range a.byFd {
+		if p.listener {
+			n++
+		}
+	}
+	return n
+}
+
+// Close stops the event loop, closes the listeners and removes the
+// socket, and its directory if the agent created it. The processes
+// blocked in a notified syscall, and those making one later, get ENOSYS.
+// Close is idempotent.
+func (a *SeccompAgent) Close() error {
+	a.mu.Lock()
+	if a.closed {
+		a.mu.Unlock()
+		return nil
+	}
+	a.closed = true
+	a.epoll.close() // ends run
+	a.mu.Unlock()
+	<-a.stopped
+	a.mu.Lock()
+	for _, p := range a.byFd {
+		a.dropLocked(p)
+	}
+	a.mu.Unlock()
+	syscall.Close(a.sock)
+	a.removeSocket()
+	return nil
+}
+
+func (a *SeccompAgent) removeSocket() {
+	os.Remove(a.path)
+	a.removeDir()
+}
+
+func (a *SeccompAgent) removeDir() {
+	if a.ownDir != "" {
+		os.RemoveAll(a.ownDir)
+	}
+}
+
+func (a *SeccompAgent) run() {
+	defer close(a.stopped)
+	events := make([]syscall.EpollEvent, seccompAgentBatch)
+	reqs := make([]SeccompRequest, 0, seccompAgentBatch)
+	for {
+		n, err := a.epoll.wait(events)
+		if err != nil {
+			return
+		}
+		// Take the batch, then answer it: the listeners are level
+		// triggered, and report the notifications left in the next wait
+		reqs = reqs[:0]
+		a.mu.Lock()
+		for _, ev := range events[:n] {
+			if ev.Fd == int32(a.sock) {
+				a.acceptLocked()
+				continue
+			}
+			p := a.byFd[ev.Fd]
+			switch {
+			case p == nil:
+			case !p.listener:
+				a.readPeerLocked(p)
+			case ev.Events&syscall.EPOLLIN != 0:
+				if req, ok := p.recv(); ok {
+					reqs = append(reqs, req)
+				}
+			default:
+				// EPOLLHUP: the container's processes are gone
+				a.dropLocked(p)
+			}
+		}
+		a.mu.Unlock()
+		for i := range reqs {
+			respondSeccomp(&reqs[i], a.handler.HandleSeccomp(&reqs[i]))
+		}
+	}
+}
+
+// acceptLocked accepts the pending connections from libcrun.
+func (a *SeccompAgent) acceptLocked() {
+	for {
+		fd, _, err := syscall.Accept4(a.sock, syscall.SOCK_NONBLOCK|syscall.SOCK_CLOEXEC)
+		if err == syscall.EINTR || err == syscall.ECONNABORTED {
+			continue
+		}
+		if err != nil {
+			return
+		}
+		ev := syscall.EpollEvent{Events: syscall.EPOLLIN, Fd: int32(fd)}
+		if err := syscall.EpollCtl(a.epoll.fd(), syscall.EPOLL_CTL_ADD, fd, &ev); err != nil {
+			syscall.Close(fd)
+			continue
+		}
+		a.byFd[int32(fd)] = &seccompPeer{fd: fd}
+	}
+}
+
+// readPeerLocked reads what connection p sent so far. Once libcrun closed
+// it, the listener named in the container state it sent replaces p.
+func (a *SeccompAgent) readPeerLocked(p *seccompPeer) {
+	var buf [4096]byte
+	oob := make([]byte, syscall.CmsgSpace(4*4))
+	for {
+		n, oobn, _, _, err := syscall.Recvmsg(p.fd, buf[:], oob, syscall.MSG_CMSG_CLOEXEC)
+		if err == syscall.EINTR {
+			continue
+		}
+		if err == syscall.EAGAIN {
+			return
+		}
+		if err != nil {
+			a.dropLocked(p)
+			return
+		}
+		if oobn > 0 {
+			if msgs, perr := syscall.ParseSocketControlMessage(oob[:oobn]); perr == nil {
+				for _, m := range msgs {
+					if fds, rerr := syscall.ParseUnixRights(&m); rerr == nil {
+						p.fds = append(p.fds, fds...)
+					}
+				}
+			}
+		}
+		if n == 0 {
+			break
+		}
+		p.payload = append(p.payload, buf[:n]...)
+	}
+
+	// The connection is done with: keep the seccomp listener only
+	delete(a.byFd, int32(p.fd))
+	_ = syscall.EpollCtl(a.epoll.fd(), syscall.EPOLL_CTL_DEL, p.fd, nil)
+	syscall.Close(p.fd)
+	var state specs.ContainerProcessState
+	listener := -1
+	if json.Unmarshal(p.payload, &state) == nil {
+		for i, name := range state.Fds {
+			if name == specs.SeccompFdName && i < len(p.fds) {
+				listener = p.fds[i]
+			}
+		}
+	}
+	for _, fd := range p.fds {
+		if fd != listener {
+			syscall.Close(fd)
+		}
+	}
+	if listener < 0 {
+		return
+	}
+	ev := syscall.EpollEvent{Events: syscall.EPOLLIN, Fd: int32(listener)}
+	if err := syscall.EpollCtl(a.epoll.fd(), syscall.EPOLL_CTL_ADD, listener, &ev); err != nil {
+		syscall.Close(listener)
+		return
+	}
+	a.byFd[int32(listener)] = &seccompPeer{
+		fd:        listener,
+		listener:  true,
+		container: state.State.ID,
+		metadata:  state.Metadata,
+	}
+}
+
+func (a *SeccompAgent) dropLocked(p *seccompPeer) {
+	delete(a.byFd, int32(p.fd))
+	_ = syscall.EpollCtl(a.epoll.fd(), syscall.EPOLL_CTL_DEL, p.fd, nil)
+	syscall.Close(p.fd)
+	for _, fd := range p.fds {
+		syscall.Close(fd)
+	}
+	p.fds = nil
+}
+
+// recv takes one notification from listener p. It fails when the process
+// that made it is gone already.
+func (p *seccompPeer) recv() (SeccompRequest, bool) {
+	var n seccompNotif // must be zeroed
+	for {
+		_, _, errno := syscall.Syscall(syscall.SYS_IOCTL, uintptr(p.fd), seccompIoctlNotifRecv, uintptr(unsafe.Pointer(&n)))
+		if errno == syscall.EINTR {
+			continue
+		}
+		if errno != 0 {
+			return SeccompRequest{}, false
+		}
+		break
+	}
+	return SeccompRequest{
+		Container:          p.container,
+		Metadata:           p.metadata,
+		PID:                int(n.pid),
+		Syscall:            int(n.nr),
+		Arch:               n.arch,
+		InstructionPointer: n.ip,
+		Args:               n.args,
+		id:                 n.id,
+		fd:                 p.fd,
+	}, true
+}
+
+// respondSeccomp answers req with resp. Errors mean the process is gone,
+// and are ignored.
+func respondSeccomp(req *SeccompRequest, resp SeccompResponse) {
+	if resp.SendFD != nil && !resp.Continue && resp.Errno == 0 {
+		addfd := seccompNotifAddFD{id: req.id, flags: seccompAddFDFlagSend, srcfd: uint32(resp.SendFD.Fd())}
+		_, _, errno := syscall.Syscall(syscall.SYS_IOCTL, uintptr(req.fd), seccompIoctlNotifAddFD, uintptr(unsafe.Pointer(&addfd)))
+		if errno == 0 || errno == syscall.ENOENT {
+			return
+		}
+		// Still blocked: fail the syscall rather than leave it so
+		resp = SeccompResponse{Errno: errno}
+	}
+	r := seccompNotifResp{id: req.id}
+	switch {
+	case resp.Continue:
+		r.flags = seccompUserNotifFlagContinue
+	case resp.Errno != 0:
+		r.error = -int32(resp.Errno)
+	default:
+		r.val = resp.Val
+	}
+	for {
+		_, _, errno := syscall.Syscall(syscall.SYS_IOCTL, uintptr(req.fd), seccompIoctlNotifSend, uintptr(unsafe.Pointer(&r)))
+		if errno != syscall.EINTR {
+			return
+		}
+	}
+}
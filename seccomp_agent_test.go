@@ -0,0 +1,184 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"encoding/json"
+	"net"
+	"os"
+	"runtime"
+	"syscall"
+	"testing"
+	"time"
+	"unsafe"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+// sendSeccompListener hands fd to agent as libcrun does for container id.
+func sendSeccompListener(agent *SeccompAgent, id string, fd int) error {
+	conn, err := net.DialUnix("unix", nil, &net.UnixAddr{Name: agent.Path(), Net: "unix"})
+	if err != nil {
+		return err
+	}
+	defer conn.Close()
+	payload, _ := json.Marshal(specs.ContainerProcessState{
+		Version:  specs.Version,
+		Fds:      []string{specs.SeccompFdName},
+		Pid:      os.Getpid(),
+		Metadata: "meta",
+		State:    specs.State{ID: id, Status: specs.StateCreating},
+	})
+	_, _, err = conn.WriteMsgUnix(payload, syscall.UnixRights(fd), nil)
+	return err
+}
+
+func TestSeccompAgentNeedsHandler(t *testing.T) {
+	if _, err := NewSeccompAgent("", nil); err == nil {
+		t.Fatal("NewSeccompAgent succeeded without a handler")
+	}
+}
+
+func TestSeccompAgentListenerLifetime(t *testing.T) {
+	agent, err := NewSeccompAgent("", SeccompNotifyHandlerFunc(func(*SeccompRequest) SeccompResponse {
+		return SeccompResponse{}
+	}))
+	if err != nil {
+		t.Fatalf("NewSeccompAgent failed: %v", err)
+	}
+	path := agent.Path()
+	defer agent.Close()
+
+	// A pipe stands in for the listener: its closed write end hangs it up
+	// as the exit of the container's last process does
+	var p [2]int
+	if err := syscall.Pipe2(p[:], syscall.O_CLOEXEC); err != nil {
+		t.Fatal(err)
+	}
+	if err := sendSeccompListener(agent, "a", p[0]); err != nil {
+		t.Fatalf("sending the listener failed: %v", err)
+	}
+	syscall.Close(p[0])
+	waitFor(t, "the listener to be served", func() bool { return agent.Containers() == 1 })
+	syscall.Close(p[1])
+	waitFor(t, "the listener to be dropped", func() bool { return agent.Containers() == 0 })
+
+	if err := agent.Close(); err != nil {
+		t.Fatalf("Close failed: %v", err)
+	}
+	if _, err := os.Stat(path); !os.IsNotExist(err) {
+		t.Errorf("socket left after Close: %v", err)
+	}
+	if err := agent.Close(); err != nil {
+		t.Fatalf("second Close failed: %v", err)
+	}
+}
+
+func TestSeccompAgentIgnoresBadPayload(t *testing.T) {
+	agent, err := NewSeccompAgent("", SeccompNotifyHandlerFunc(func(*SeccompRequest) SeccompResponse {
+		return SeccompResponse{}
+	}))
+	if err != nil {
+		t.Fatalf("NewSeccompAgent failed: %v", err)
+	}
+	defer agent.Close()
+
+	conn, err := net.DialUnix("unix", nil, &net.UnixAddr{Name: agent.Path(), Net: "unix"})
+	if err != nil {
+		t.Fatalf("Dial failed: %v", err)
+	}
+	if _, _, err := conn.WriteMsgUnix([]byte("not json"), syscall.UnixRights(int(os.Stdin.Fd())), nil); err != nil {
+		t.Fatalf("WriteMsgUnix failed: %v", err)
+	}
+	conn.Close()
+	var p [2]int
+	if err := syscall.Pipe2(p[:], syscall.O_CLOEXEC); err != nil {
+		t.Fatal(err)
+	}
+	defer syscall.Close(p[1])
+	if err := sendSeccompListener(agent, "b", p[0]); err != nil {
+		t.Fatalf("sending the listener failed: %v", err)
+	}
+	syscall.Close(p[0])
+	waitFor(t, "the valid listener to be served", func() bool { return agent.Containers() == 1 })
+	time.Sleep(10 * time.Millisecond)
+	if n := agent.Containers(); n != 1 {
+		t.Errorf("Containers() = %d, want only the valid listener", n)
+	}
+}
+
+// seccompSyscallNr is the number of seccomp(2), which package syscall
+// lacks on amd64.
+var seccompSyscallNr = map[string]uintptr{"amd64": 317, "arm64": 277}
+
+// TestSeccompAgentAnswers installs a filter notifying getppid on a thread
+// of the test, retired with the goroutine, and checks the agent's answer
+// reaches it.
+func TestSeccompAgentAnswers(t *testing.T) {
+	nr, ok := seccompSyscallNr[runtime.GOARCH]
+	if !ok {
+		t.Skip("seccomp syscall number unknown on " + runtime.GOARCH)
+	}
+	reqs := make(chan SeccompRequest, 1)
+	agent, err := NewSeccompAgent("", SeccompNotifyHandlerFunc(func(req *SeccompRequest) SeccompResponse {
+		if req.Syscall != syscall.SYS_GETPPID {
+			return SeccompResponse{Continue: true}
+		}
+		reqs <- *req
+		return SeccompResponse{Val: 4242}
+	}))
+	if err != nil {
+		t.Fatalf("NewSeccompAgent failed: %v", err)
+	}
+	defer agent.Close()
+
+	got := make(chan uintptr, 1)
+	failed := make(chan error, 1)
+	go func() {
+		runtime.LockOSThread() // never unlocked: the thread goes with the filter
+		if _, _, errno := syscall.RawSyscall6(syscall.SYS_PRCTL, 38 /* PR_SET_NO_NEW_PRIVS */, 1, 0, 0, 0, 0); errno != 0 {
+			failed <- errno
+			return
+		}
+		filter := []syscall.SockFilter{
+			{Code: syscall.BPF_LD | syscall.BPF_W | syscall.BPF_ABS, K: 0},
+			{Code: syscall.BPF_JMP | syscall.BPF_JEQ | syscall.BPF_K, Jt: 0, Jf: 1, K: syscall.SYS_GETPPID},
+			{Code: syscall.BPF_RET | syscall.BPF_K, K: 0x7fc00000}, // SECCOMP_RET_USER_NOTIF
+			{Code: syscall.BPF_RET | syscall.BPF_K, K: 0x7fff0000}, // SECCOMP_RET_ALLOW
+		}
+		prog := syscall.SockFprog{Len: uint16(len(filter)), Filter: &filter[0]}
+		// SECCOMP_SET_MODE_FILTER, SECCOMP_FILTER_FLAG_NEW_LISTENER
+		fd, _, errno := syscall.RawSyscall(nr, 1, 1<<3, uintptr(unsafe.Pointer(&prog)))
+		if errno != 0 {
+			failed <- errno
+			return
+		}
+		err := sendSeccompListener(agent, "answered", int(fd))
+		syscall.Close(int(fd))
+		if err != nil {
+			failed <- err
+			return
+		}
+		// Not RawSyscall: blocked there, the thread would hold up the GC
+		ppid, _, _ := syscall.Syscall(syscall.SYS_GETPPID, 0, 0, 0)
+		got <- ppid
+	}()
+
+	select {
+	case err := <-failed:
+		if _, ok := err.(syscall.Errno); ok {
+			t.Skipf("cannot install a seccomp listener: %v", err)
+		}
+		t.Fatalf("sending the listener failed: %v", err)
+	case ppid := <-got:
+		if ppid != 4242 {
+			t.Errorf("getppid() = %d, want the agent's 4242", ppid)
+		}
+	case <-time.After(10 * time.Second):
+		t.Fatal("getppid was not answered")
+	}
+	req := <-reqs
+	if req.Container != "answered" || req.Metadata != "meta" || req.PID <= 0 {
+		t.Errorf("request = %+v", req)
+	}
+}
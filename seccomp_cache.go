@@ -0,0 +1,117 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"crypto/sha256"
+	"encoding/base64"
+	"encoding/json"
+	"io"
+	"runtime"
+	"sync"
+	"unsafe"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+// libcrun loads the (base64) BPF program in seccompBPFAnnotation instead
+// of compiling the spec's seccomp profile through libseccomp at create.
+const (
+	seccompBPFAnnotation         = "run.oci.seccomp_bpf_data"
+	seccompFailUnknownAnnotation = "run.oci.seccomp_fail_unknown_syscall"
+)
+
+// maxSeccompCacheEntries bounds the compiled profiles kept; specs with
+// profiles beyond it are compiled by libcrun as usual.
+const maxSeccompCacheEntries = 64
+
+// seccompCache holds the compiled BPF of each distinct seccomp profile
+// seen by NewContainerSpec, keyed by seccompCacheKey. A few milliseconds
+// of libseccomp work per create become one compile per profile.
+var seccompCache struct {
+	mu  sync.RWMutex
+	bpf map[[sha256.Size]byte]string // base64
+}
+
+// seccompCacheKey returns the cache key of the seccomp profile of sp, and
+// false if sp has none or already carries a compiled one. The key covers
+// everything the BPF depends on: the profile, the architecture and
+// whether unknown syscalls are fatal.
+func seccompCacheKey(sp *specs.Spec) (key [sha256.Size]byte, ok bool) {
+	if sp.Linux == nil || sp.Linux.Seccomp == nil {
+		return key, false
+	}
+	if _, set := sp.Annotations[seccompBPFAnnotation]; set {
+		return key, false
+	}
+	h := sha256.New()
+	io.WriteString(h, runtime.GOARCH)
+	if seccompFailUnknown(sp) {
+		io.WriteString(h, ":fail-unknown")
+	}
+	if err := json.NewEncoder(h).Encode(sp.Linux.Seccomp); err != nil {
+		return key, false
+	}
+	h.Sum(key[:0])
+	return key, true
+}
+
+// seccompFailUnknown mirrors libcrun's reading of the annotation.
+func seccompFailUnknown(sp *specs.Spec) bool {
+	v, ok := sp.Annotations[seccompFailUnknownAnnotation]
+	return ok && v != "0"
+}
+
+func cachedSeccompBPF(key [sha256.Size]byte) (string, bool) {
+	seccompCache.mu.RLock()
+	defer seccompCache.mu.RUnlock()
+	bpf, ok := seccompCache.bpf[key]
+	return bpf, ok
+}
+
+// withSeccompBPF returns a shallow copy of sp carrying the compiled
+// profile, leaving the caller's annotations alone.
+func withSeccompBPF(sp *specs.Spec, bpf string) *specs.Spec {
+	cp := *sp
+	cp.Annotations = make(map[string]string, len(sp.Annotations)+1)
+	for k, v := range sp.Annotations {
+		cp.Annotations[k] = v
+	}
+	cp.Annotations[seccompBPFAnnotation] = bpf
+	return &cp
+}
+
+// cacheSeccompBPF compiles the seccomp profile of c, loaded from sp, and
+// caches it under key. It reports whether the cache now has it; on
+// failure libcrun compiles the profile at create, and reports the error.
+func (c *ContainerSpec) cacheSeccompBPF(sp *specs.Spec, key [sha256.Size]byte) bool {
+	var failUnknown C.int
+	if seccompFailUnknown(sp) {
+		failUnknown = 1
+	}
+	var out *C.char
+	var n C.size_t
+	var cerr C.libcrun_error_t
+	if C.go_crun_seccomp_compile(c.c, failUnknown, &out, &n, &cerr) < 0 {
+		C.libcrun_error_release(&cerr)
+		return false
+	}
+	bpf := base64.StdEncoding.EncodeToString(unsafe.Slice((*byte)(unsafe.Pointer(out)), int(n)))
+	C.free(unsafe.Pointer(out))
+
+	seccompCache.mu.Lock()
+	defer seccompCache.mu.Unlock()
+	if seccompCache.bpf == nil {
+		seccompCache.bpf = map[[sha256.Size]byte]string{}
+	}
+	if _, ok := seccompCache.bpf[key]; !ok && len(seccompCache.bpf) >= maxSeccompCacheEntries {
+		return false
+	}
+	seccompCache.bpf[key] = bpf
+	return true
+}
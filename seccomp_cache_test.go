@@ -0,0 +1,82 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"encoding/base64"
+	"testing"
+
+	specs "github.com/opencontainers/runtime-spec/specs-go"
+)
+
+func seccompTestSpec(t *testing.T, allow ...string) *specs.Spec {
+	t.Helper()
+	sp, err := DefaultSpec(false)
+	if err != nil {
+		t.Fatalf("DefaultSpec failed: %v", err)
+	}
+	sp.Linux.Seccomp = &specs.LinuxSeccomp{
+		DefaultAction: specs.ActErrno,
+		Syscalls:      []specs.LinuxSyscall{{Names: allow, Action: specs.ActAllow}},
+	}
+	return sp
+}
+
+func TestSeccompCompiledOncePerProfile(t *testing.T) {
+	sp := seccompTestSpec(t, "read", "write", "exit_group")
+	key, ok := seccompCacheKey(sp)
+	if !ok {
+		t.Fatal("spec with a seccomp profile has no cache key")
+	}
+
+	first, err := NewContainerSpec(sp)
+	if err != nil {
+		t.Fatalf("NewContainerSpec failed: %v", err)
+	}
+	defer first.Close()
+	cached, ok := cachedSeccompBPF(key)
+	if !ok {
+		t.Fatal("profile not cached after NewContainerSpec")
+	}
+	if bpf, err := base64.StdEncoding.DecodeString(cached); err != nil || len(bpf) == 0 || len(bpf)%8 != 0 {
+		t.Fatalf("cached program is %d bytes, %v; want sock_filter instructions", len(bpf), err)
+	}
+	if _, set := sp.Annotations[seccompBPFAnnotation]; set {
+		t.Error("NewContainerSpec annotated the caller's spec")
+	}
+
+	second, err := NewContainerSpec(seccompTestSpec(t, "read", "write", "exit_group"))
+	if err != nil {
+		t.Fatalf("NewContainerSpec failed: %v", err)
+	}
+	defer second.Close()
+	for _, c := range []*ContainerSpec{first, second} {
+		if got, _ := c.annotation(seccompBPFAnnotation); got != cached {
+			t.Errorf("spec carries %d bytes of BPF, want the cached %d", len(got), len(cached))
+		}
+	}
+}
+
+func TestSeccompCacheKey(t *testing.T) {
+	base, _ := seccompCacheKey(seccompTestSpec(t, "read"))
+	other, _ := seccompCacheKey(seccompTestSpec(t, "write"))
+	if base == other {
+		t.Error("different profiles share a key")
+	}
+	strict := seccompTestSpec(t, "read")
+	strict.Annotations = map[string]string{seccompFailUnknownAnnotation: "1"}
+	if k, _ := seccompCacheKey(strict); k == base {
+		t.Error("fail-unknown-syscall profile shares the key of the plain one")
+	}
+
+	none := seccompTestSpec(t)
+	none.Linux.Seccomp = nil
+	if _, ok := seccompCacheKey(none); ok {
+		t.Error("spec without a profile has a key")
+	}
+	precompiled := seccompTestSpec(t, "read")
+	precompiled.Annotations = map[string]string{seccompBPFAnnotation: "AAAA"}
+	if _, ok := seccompCacheKey(precompiled); ok {
+		t.Error("spec with a compiled profile has a key")
+	}
+}
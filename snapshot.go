@@ -0,0 +1,66 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"errors"
+	"os"
+)
+
+// Snapshot is a golden checkpoint of a warmed-up container from which new
+// instances are started by restoring instead of booting.
+type Snapshot struct {
+	ImagePath string // CRIU images
+	Bundle    string // bundle of the template container
+}
+
+// Snapshot checkpoints the running container into dir as a golden image,
+// leaving it running. TCP connections are not saved, and are closed in
+// the instances. Stdio should be pipes (as with RunWithIO) so that
+// instances can be given their own.
+func (c *Container) Snapshot(dir string) (*Snapshot, error) {
+	st, err := c.State()
+	if err != nil {
+		return nil, err
+	}
+	if err := os.MkdirAll(dir, 0o700); err != nil {
+		return nil, err
+	}
+	if err := c.Checkpoint(CheckpointOptions{ImagePath: dir, LeaveRunning: true, TCPClose: true}); err != nil {
+		return nil, err
+	}
+	return &Snapshot{ImagePath: dir, Bundle: st.Bundle}, nil
+}
+
+// StartFromSnapshot starts a new container id by restoring s, with ioCfg's
+// streams as its stdio. The start latency is the restore latency: the
+// warm-up work done by the template before the snapshot is not repeated.
+//
+// The images are only read, so any number of instances can be started
+// from one Snapshot, concurrently. Each restore gets its own CRIU work
+// directory, removed when Wait returns.
+func (x *RuntimeContext) StartFromSnapshot(id string, s *Snapshot, ioCfg *IOConfig) (*RunResult, error) {
+	if s == nil || s.ImagePath == "" {
+		return nil, errors.New("libcrun: invalid snapshot")
+	}
+	work, err := os.MkdirTemp("", "crun-restore-")
+	if err != nil {
+		return nil, err
+	}
+	res, err := x.RestoreWithIO(id, RestoreOptions{
+		ImagePath: s.ImagePath,
+		WorkPath:  work,
+		Bundle:    s.Bundle,
+		TCPClose:  true,
+	}, ioCfg)
+	if err != nil {
+		os.RemoveAll(work)
+		return nil, err
+	}
+	wait := res.Wait
+	res.Wait = func() (int, error) {
+		defer os.RemoveAll(work)
+		return wait()
+	}
+	return res, nil
+}
@@ -0,0 +1,45 @@
+//go:build linux
+
+package crun
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+func TestSnapshotStoppedContainer(t *testing.T) {
+	ctr := fakeStateRoot(t, "c1").Get("c1")
+	// The fake container is not running: CRIU cannot dump it
+	if _, err := ctr.Snapshot(filepath.Join(t.TempDir(), "golden")); err == nil {
+		t.Error("Snapshot of a stopped container succeeded")
+	}
+}
+
+func TestStartFromSnapshotInvalid(t *testing.T) {
+	rc := fakeStateRoot(t)
+	if _, err := rc.StartFromSnapshot("i1", nil, nil); err == nil {
+		t.Error("StartFromSnapshot(nil) succeeded")
+	}
+	if _, err := rc.StartFromSnapshot("i1", &Snapshot{}, nil); err == nil {
+		t.Error("StartFromSnapshot without image succeeded")
+	}
+}
+
+func TestStartFromSnapshotRemovesWorkDir(t *testing.T) {
+	rc := fakeStateRoot(t)
+	tmp := t.TempDir()
+	t.Setenv("TMPDIR", tmp)
+	// Restoring from an empty image fails in the child; the work
+	// directory must be gone once Wait returns
+	res, err := rc.StartFromSnapshot("i1", &Snapshot{ImagePath: t.TempDir(), Bundle: t.TempDir()}, &IOConfig{})
+	if err != nil {
+		t.Fatalf("StartFromSnapshot failed: %v", err)
+	}
+	if code, _ := res.Wait(); code == 0 {
+		t.Error("restore from an empty image succeeded")
+	}
+	if entries, _ := os.ReadDir(tmp); len(entries) != 0 {
+		t.Errorf("work directories left behind: %v", entries)
+	}
+}
@@ -0,0 +1,245 @@
+//go:build linux && cgo && integration
+
+package crun
+
+import (
+	"bufio"
+	"encoding/json"
+	"fmt"
+	"os"
+	"runtime"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+// soakSample is one point of the BenchmarkSoak time series.
+type soakSample struct {
+	Elapsed    float64 `json:"elapsed_s"`
+	FDs        int     `json:"fds"`
+	Threads    int     `json:"threads"`
+	Goroutines int     `json:"goroutines"`
+	RSS        int64   `json:"rss_bytes"`
+	CMem       int64   `json:"cmem_bytes"` // CMemStats.Bytes
+	Rate       float64 `json:"containers_per_s"`
+	Completed  int64   `json:"completed"`
+	Failed     int64   `json:"failed"`
+	Skipped    int64   `json:"skipped"` // ticks with every worker busy
+}
+
+// BenchmarkSoak churns containers at a fixed rate for a long time and
+// checks that the process's open fds, OS threads, goroutines, RSS and C
+// memory level off, to catch the slow leaks short benchmarks miss. One
+// launch in ten runs a missing binary and one in fifty reuses the id of a
+// live container, to churn the error paths too. It is skipped unless
+// SOAK_DURATION is set:
+//
+//	SOAK_DURATION  how long to churn ("30m")
+//	SOAK_RATE      launches per second (default 20)
+//	SOAK_PARALLEL  launches in flight at most (default 8)
+//	SOAK_JSON      file to write the per-second samples to
+//
+// Run with: make soak
+func BenchmarkSoak(b *testing.B) {
+	duration, _ := time.ParseDuration(os.Getenv("SOAK_DURATION"))
+	if duration <= 0 {
+		b.Skip("Set SOAK_DURATION to run the soak benchmark")
+	}
+	if os.Getuid() != 0 {
+		b.Skip("Benchmark requires root privileges")
+	}
+	rootfs := os.Getenv("TEST_ROOTFS")
+	if rootfs == "" {
+		rootfs = "/tmp/test-rootfs"
+	}
+	if _, err := os.Stat(rootfs); os.IsNotExist(err) {
+		b.Skip("No test rootfs found. Set TEST_ROOTFS env var or create /tmp/test-rootfs with busybox")
+	}
+	rate := soakEnvInt("SOAK_RATE", 20)
+	parallel := soakEnvInt("SOAK_PARALLEL", 8)
+
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: b.TempDir()})
+	if err != nil {
+		b.Fatalf("Failed to create runtime context: %v", err)
+	}
+	defer rc.Close()
+
+	// The live container whose id the duplicate launches reuse
+	dupSpec, err := NewSpec(false, WithRootPath(rootfs), WithContainerTTY(false), WithArgs("/bin/sleep", "3600"))
+	if err != nil {
+		b.Fatalf("Failed to create spec: %v", err)
+	}
+	defer dupSpec.Close()
+	dup, err := rc.Create("soak-dup", dupSpec, CreateOptions{})
+	if err != nil {
+		b.Fatalf("Create failed: %v", err)
+	}
+	defer dup.Delete(true)
+
+	var completed, failed, skipped atomic.Int64
+	launch := func(i int) {
+		id := fmt.Sprintf("soak-%d", i)
+		args := []string{"/bin/true"}
+		switch {
+		case i%50 == 49:
+			id = "soak-dup"
+		case i%10 == 9:
+			args = []string{"/nonexistent-soak-binary"}
+		}
+		spec, err := NewSpec(false, WithRootPath(rootfs), WithContainerTTY(false), WithArgs(args...))
+		if err != nil {
+			failed.Add(1)
+			return
+		}
+		defer spec.Close()
+		res, err := rc.RunWithIO(id, spec, &IOConfig{})
+		if err != nil {
+			failed.Add(1)
+			return
+		}
+		code, err := res.Wait()
+		if id != "soak-dup" {
+			_ = res.Container.Delete(true)
+		}
+		if err != nil || code != 0 {
+			failed.Add(1)
+			return
+		}
+		completed.Add(1)
+	}
+
+	var samples []soakSample
+	sem := make(chan struct{}, parallel)
+	var wg sync.WaitGroup
+	start := time.Now()
+	tick := time.NewTicker(time.Second / time.Duration(rate))
+	defer tick.Stop()
+	sample := time.NewTicker(time.Second)
+	defer sample.Stop()
+	end := time.After(duration)
+	lastCompleted := int64(0)
+	lastSample := start
+
+	b.ResetTimer()
+loop:
+	for i := 0; ; {
+		select {
+		case <-end:
+			break loop
+		case <-tick.C:
+			select {
+			case sem <- struct{}{}:
+			default:
+				skipped.Add(1)
+				continue
+			}
+			wg.Add(1)
+			go func(i int) {
+				defer wg.Done()
+				defer func() { <-sem }()
+				launch(i)
+			}(i)
+			i++
+		case now := <-sample.C:
+			s := soakSnapshot()
+			s.Elapsed = now.Sub(start).Seconds()
+			s.Completed, s.Failed, s.Skipped = completed.Load(), failed.Load(), skipped.Load()
+			s.Rate = float64(s.Completed-lastCompleted) / now.Sub(lastSample).Seconds()
+			lastCompleted, lastSample = s.Completed, now
+			samples = append(samples, s)
+		}
+	}
+	wg.Wait()
+	b.StopTimer()
+
+	total := time.Since(start)
+	b.ReportMetric(float64(completed.Load())/total.Seconds(), "containers/s")
+	b.ReportMetric(float64(failed.Load()), "failed")
+	b.ReportMetric(float64(skipped.Load()), "skipped")
+
+	if path := os.Getenv("SOAK_JSON"); path != "" {
+		out, err := json.MarshalIndent(samples, "", "  ")
+		if err != nil {
+			b.Fatalf("Marshal failed: %v", err)
+		}
+		if err := os.WriteFile(path, out, 0o644); err != nil {
+			b.Fatalf("WriteFile failed: %v", err)
+		}
+	}
+	soakCheckPlateau(b, samples)
+}
+
+func soakEnvInt(name string, def int) int {
+	if v, err := strconv.Atoi(os.Getenv(name)); err == nil && v > 0 {
+		return v
+	}
+	return def
+}
+
+// soakSnapshot samples the process's resources.
+func soakSnapshot() soakSample {
+	s := soakSample{Goroutines: runtime.NumGoroutine(), CMem: ReadCMemStats().Bytes()}
+	if fds, err := os.ReadDir("/proc/self/fd"); err == nil {
+		s.FDs = len(fds)
+	}
+	f, err := os.Open("/proc/self/status")
+	if err != nil {
+		return s
+	}
+	defer f.Close()
+	sc := bufio.NewScanner(f)
+	for sc.Scan() {
+		key, value, _ := strings.Cut(sc.Text(), ":")
+		fields := strings.Fields(value)
+		if len(fields) == 0 {
+			continue
+		}
+		switch key {
+		case "Threads":
+			s.Threads, _ = strconv.Atoi(fields[0])
+		case "VmRSS":
+			kb, _ := strconv.ParseInt(fields[0], 10, 64)
+			s.RSS = kb << 10
+		}
+	}
+	return s
+}
+
+// soakCheckPlateau fails b if a resource is still growing: past a first
+// quarter of warm-up, the peak of the last half of the samples may only
+// exceed the peak of the first half by a small margin.
+func soakCheckPlateau(b *testing.B, samples []soakSample) {
+	warm := samples[len(samples)/4:]
+	if len(warm) < 8 {
+		b.Logf("%d samples after warm-up: too few to check for a plateau", len(warm))
+		return
+	}
+	first, last := warm[:len(warm)/2], warm[len(warm)/2:]
+	metrics := []struct {
+		name     string
+		of       func(soakSample) float64
+		abs, rel float64
+	}{
+		{"fds", func(s soakSample) float64 { return float64(s.FDs) }, 8, 0.05},
+		{"threads", func(s soakSample) float64 { return float64(s.Threads) }, 4, 0.10},
+		{"goroutines", func(s soakSample) float64 { return float64(s.Goroutines) }, 16, 0.10},
+		{"rss", func(s soakSample) float64 { return float64(s.RSS) }, 16 << 20, 0.10},
+		{"cmem", func(s soakSample) float64 { return float64(s.CMem) }, 1 << 20, 0.10},
+	}
+	peak := func(ss []soakSample, of func(soakSample) float64) float64 {
+		m := 0.0
+		for _, s := range ss {
+			m = max(m, of(s))
+		}
+		return m
+	}
+	for _, m := range metrics {
+		a, z := peak(first, m.of), peak(last, m.of)
+		if z > a+m.abs+a*m.rel {
+			b.Errorf("%s still growing: peak %.0f in the first half after warm-up, %.0f in the last", m.name, a, z)
+		}
+	}
+}
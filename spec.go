@@ -7,8 +7,10 @@ package crun
 */
 import "C"
 import (
+	"bytes"
 	"encoding/json"
 	"runtime"
+	"sync"
 	"unsafe"
 
 	specs "github.com/opencontainers/runtime-spec/specs-go"
@@ -18,6 +20,12 @@ import (
 // This is the spec holder - create a Container via RuntimeContext.Create/Run.
 type ContainerSpec struct {
 	c *C.libcrun_container_t
+
+	overlayOnce sync.Once
+	overlay     *overlayRootfs // see WithOverlayRootfs
+	rootMu      sync.RWMutex   // written while root.path points at an overlay
+
+	cost int64 // estimated C memory, see CMemStats
 }
 
 // LoadContainerSpecFromFile loads an OCI spec from file.
@@ -30,7 +38,7 @@ func LoadContainerSpecFromFile(path string) (*ContainerSpec, error) {
 		return nil, fromLibcrunErr(&err)
 	}
 	c := &ContainerSpec{c: ctr}
-	runtime.SetFinalizer(c, func(cc *ContainerSpec) { _ = cc.Close() })
+	trackSpec(c)
 	return c, nil
 }
 
@@ -44,17 +52,134 @@ func LoadContainerSpecFromJSON(def string) (*ContainerSpec, error) {
 		return nil, fromLibcrunErr(&err)
 	}
 	c := &ContainerSpec{c: ctr}
-	runtime.SetFinalizer(c, func(cc *ContainerSpec) { _ = cc.Close() })
+	trackSpec(c)
 	return c, nil
 }
 
+// specBufPool holds encode buffers for NewContainerSpec.
+var specBufPool = sync.Pool{New: func() any { return new(bytes.Buffer) }}
+
+// maxPooledSpecBuf keeps unusually large specs from pinning pool memory.
+const maxPooledSpecBuf = 1 << 20
+
 // NewContainerSpec creates a ContainerSpec from a typed specs.Spec.
+//
+// The spec is encoded into a pooled buffer and handed to libcrun in place:
+// there is no intermediate Go string and no C copy of the JSON on our side.
+// Settings this libcrun cannot apply are rejected first, see ValidateSpec.
+//
+// A seccomp profile is compiled to BPF once per distinct profile and
+// process, and later specs with the same profile carry the program, so
+// creating their containers skips the libseccomp compilation.
 func NewContainerSpec(sp *specs.Spec) (*ContainerSpec, error) {
-	b, err := json.Marshal(sp)
+	if err := ValidateSpec(sp); err != nil {
+		return nil, err
+	}
+	seccompKey, compile := seccompCacheKey(sp)
+	if compile {
+		if bpf, ok := cachedSeccompBPF(seccompKey); ok {
+			sp, compile = withSeccompBPF(sp, bpf), false
+		}
+	}
+	buf := specBufPool.Get().(*bytes.Buffer)
+	buf.Reset()
+	defer func() {
+		if buf.Cap() <= maxPooledSpecBuf {
+			specBufPool.Put(buf)
+		}
+	}()
+
+	enc := json.NewEncoder(buf)
+	enc.SetEscapeHTML(false)
+	if err := enc.Encode(sp); err != nil {
+		return nil, err
+	}
+	// Encode terminates with '\n'; turn it into the NUL libcrun expects
+	b := buf.Bytes()
+	b[len(b)-1] = 0
+	c, err := loadContainerSpecFromCString(b)
 	if err != nil {
 		return nil, err
 	}
-	return LoadContainerSpecFromJSON(string(b))
+	if compile && c.cacheSeccompBPF(sp, seccompKey) {
+		c.Close()
+		return NewContainerSpec(sp) // first use of the profile: load it compiled
+	}
+	if err := c.setPlacement(sp); err != nil {
+		c.Close()
+		return nil, err
+	}
+	// libcrun follows runtime-spec 1.3, where enableCMT and enableMBM were
+	// folded into enableMonitoring
+	if l := sp.Linux; l != nil && l.IntelRdt != nil && (l.IntelRdt.EnableCMT || l.IntelRdt.EnableMBM) {
+		var cerr C.libcrun_error_t
+		if C.go_crun_spec_enable_rdt_monitoring(c.c, &cerr) < 0 {
+			c.Close()
+			return nil, fromLibcrunErr(&cerr)
+		}
+	}
+	return c, nil
+}
+
+// setPlacement installs the memory policy and exec CPU affinity that
+// WithMemPolicy and WithExecCPUAffinity left in the annotations of sp.
+func (c *ContainerSpec) setPlacement(sp *specs.Spec) error {
+	mp, hasMP := sp.Annotations[memPolicyAnnotation]
+	aff, hasAff := sp.Annotations[execCPUAffinityAnnotation]
+	if !hasMP && !hasAff {
+		return nil
+	}
+	var cmp, caff *C.char
+	if hasMP {
+		cmp = C.CString(mp)
+		defer C.free(unsafe.Pointer(cmp))
+	}
+	if hasAff {
+		caff = C.CString(aff)
+		defer C.free(unsafe.Pointer(caff))
+	}
+	var cerr C.libcrun_error_t
+	if C.go_crun_spec_set_placement(c.c, cmp, caff, &cerr) < 0 {
+		return fromLibcrunErr(&cerr)
+	}
+	return nil
+}
+
+// loadContainerSpecFromCString loads a NUL-terminated JSON document directly
+// from Go memory. libcrun copies the document before returning, so b may be
+// reused afterwards.
+func loadContainerSpecFromCString(b []byte) (*ContainerSpec, error) {
+	var err C.libcrun_error_t
+	ctr := C.libcrun_container_load_from_memory((*C.char)(unsafe.Pointer(&b[0])), &err)
+	runtime.KeepAlive(b)
+	if ctr == nil {
+		return nil, fromLibcrunErr(&err)
+	}
+	c := &ContainerSpec{c: ctr}
+	trackSpec(c)
+	return c, nil
+}
+
+// annotation returns the value of the spec's annotation key.
+func (c *ContainerSpec) annotation(key string) (string, bool) {
+	ann := c.c.container_def.annotations
+	if ann == nil {
+		return "", false
+	}
+	keys := unsafe.Slice(ann.keys, int(ann.len))
+	values := unsafe.Slice(ann.values, int(ann.len))
+	for i := range keys {
+		if C.GoString(keys[i]) == key {
+			return C.GoString(values[i]), true
+		}
+	}
+	return "", false
+}
+
+// hasCgroupsPath reports whether the spec sets linux.cgroupsPath.
+func (c *ContainerSpec) hasCgroupsPath() bool {
+	l := c.c.container_def.linux
+	return l != nil && l.cgroups_path != nil && *l.cgroups_path != 0
 }
 
 // Close releases the heavy spec memory associated with the ContainerSpec.
@@ -64,6 +189,7 @@ func (c *ContainerSpec) Close() error {
 	}
 	C.go_crun_free_container(c.c)
 	c.c = nil
+	untrackSpec(c)
 	return nil
 }
 
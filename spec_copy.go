@@ -0,0 +1,70 @@
+//go:build linux
+
+package crun
+
+import "reflect"
+
+// cloneSpecValue returns a deep copy of v. It handles the kinds that appear
+// in specs-go types (pointers, structs, slices, maps, interfaces and plain
+// values); specs-go has no unexported fields or cycles.
+func cloneSpecValue(v reflect.Value) reflect.Value {
+	switch v.Kind() {
+	case reflect.Pointer:
+		if v.IsNil() {
+			return reflect.Zero(v.Type())
+		}
+		p := reflect.New(v.Type().Elem())
+		p.Elem().Set(cloneSpecValue(v.Elem()))
+		return p
+	case reflect.Struct:
+		s := reflect.New(v.Type()).Elem()
+		for i := 0; i < v.NumField(); i++ {
+			s.Field(i).Set(cloneSpecValue(v.Field(i)))
+		}
+		return s
+	case reflect.Slice:
+		if v.IsNil() {
+			return reflect.Zero(v.Type())
+		}
+		s := reflect.MakeSlice(v.Type(), v.Len(), v.Len())
+		if isFlatKind(v.Type().Elem().Kind()) {
+			reflect.Copy(s, v)
+			return s
+		}
+		for i := 0; i < v.Len(); i++ {
+			s.Index(i).Set(cloneSpecValue(v.Index(i)))
+		}
+		return s
+	case reflect.Map:
+		if v.IsNil() {
+			return reflect.Zero(v.Type())
+		}
+		m := reflect.MakeMapWithSize(v.Type(), v.Len())
+		iter := v.MapRange()
+		for iter.Next() {
+			m.SetMapIndex(iter.Key(), cloneSpecValue(iter.Value()))
+		}
+		return m
+	case reflect.Interface:
+		if v.IsNil() {
+			return reflect.Zero(v.Type())
+		}
+		c := reflect.New(v.Type()).Elem()
+		c.Set(cloneSpecValue(v.Elem()))
+		return c
+	default:
+		return v
+	}
+}
+
+// isFlatKind reports whether values of kind k hold no references, so slices
+// of them can be copied in bulk.
+func isFlatKind(k reflect.Kind) bool {
+	switch k {
+	case reflect.Bool, reflect.Int, reflect.Int8, reflect.Int16, reflect.Int32, reflect.Int64,
+		reflect.Uint, reflect.Uint8, reflect.Uint16, reflect.Uint32, reflect.Uint64, reflect.Uintptr,
+		reflect.Float32, reflect.Float64, reflect.String:
+		return true
+	}
+	return false
+}
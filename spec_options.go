@@ -4,6 +4,11 @@ package crun
 
 import (
 	"encoding/json"
+	"reflect"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
 
 	specs "github.com/opencontainers/runtime-spec/specs-go"
 )
@@ -83,6 +88,32 @@ func WithRootPath(path string) SpecOption {
 	}
 }
 
+// WithOverlayRootfs gives every container launched from the spec a
+// private, writable overlay of the read-only lower directories (bottom
+// first, e.g. LayerStore directories or a shared rootfs), so that many
+// containers can share one page-cached image. The container's changes go
+// to a tmpfs of upperSize bytes (0 for the tmpfs default of half the RAM)
+// and are dropped when it is deleted. The overlay is mounted under the
+// state root's ".overlay" directory at launch; it replaces the root path,
+// which this sets to the top lower directory.
+func WithOverlayRootfs(lower []string, upperSize int64) SpecOption {
+	return func(sp *specs.Spec) {
+		if len(lower) == 0 {
+			return
+		}
+		if sp.Root == nil {
+			sp.Root = &specs.Root{}
+		}
+		sp.Root.Path = lower[len(lower)-1]
+		sp.Root.Readonly = false
+		if sp.Annotations == nil {
+			sp.Annotations = make(map[string]string)
+		}
+		sp.Annotations[overlayLowerAnnotation] = strings.Join(lower, ":")
+		sp.Annotations[overlayUpperSizeAnnotation] = strconv.FormatInt(upperSize, 10)
+	}
+}
+
 // WithArgs sets the process arguments.
 func WithArgs(args ...string) SpecOption {
 	return func(sp *specs.Spec) {
@@ -148,6 +179,23 @@ func WithCPUQuota(quota int64) SpecOption {
 	}
 }
 
+// WithCpuset confines the container to the CPUs and memory nodes of the
+// cgroup cpuset, in list format ("0-3,8"). Empty lists are left unset.
+func WithCpuset(cpus, mems string) SpecOption {
+	return func(sp *specs.Spec) {
+		ensureLinuxResources(sp)
+		if sp.Linux.Resources.CPU == nil {
+			sp.Linux.Resources.CPU = &specs.LinuxCPU{}
+		}
+		if cpus != "" {
+			sp.Linux.Resources.CPU.Cpus = cpus
+		}
+		if mems != "" {
+			sp.Linux.Resources.CPU.Mems = mems
+		}
+	}
+}
+
 // WithPidsLimit sets the pids limit.
 func WithPidsLimit(limit int64) SpecOption {
 	return func(sp *specs.Spec) {
@@ -159,6 +207,186 @@ func WithPidsLimit(limit int64) SpecOption {
 	}
 }
 
+// WithIntelRdt places the container in the resctrl group closID (a group
+// named after the container when empty) with the given L3 cache and memory
+// bandwidth schemata, e.g. "L3:0=ff" and "MB:0=50". Empty schemata are left
+// unset.
+func WithIntelRdt(closID, l3Schema, memBwSchema string) SpecOption {
+	return func(sp *specs.Spec) {
+		ensureLinuxIntelRdt(sp)
+		sp.Linux.IntelRdt.ClosID = closID
+		sp.Linux.IntelRdt.L3CacheSchema = l3Schema
+		sp.Linux.IntelRdt.MemBwSchema = memBwSchema
+	}
+}
+
+// WithIntelRdtMonitoring creates a resctrl monitoring group for the
+// container, whose counters Container.IntelRdtStats reports.
+func WithIntelRdtMonitoring() SpecOption {
+	return func(sp *specs.Spec) {
+		ensureLinuxIntelRdt(sp)
+		sp.Linux.IntelRdt.EnableCMT = true
+		sp.Linux.IntelRdt.EnableMBM = true
+	}
+}
+
+// MemPolicyMode is a NUMA memory policy mode, see set_mempolicy(2).
+type MemPolicyMode string
+
+// Memory policy modes.
+const (
+	MemPolicyDefault            MemPolicyMode = "MPOL_DEFAULT"
+	MemPolicyBind               MemPolicyMode = "MPOL_BIND"
+	MemPolicyInterleave         MemPolicyMode = "MPOL_INTERLEAVE"
+	MemPolicyWeightedInterleave MemPolicyMode = "MPOL_WEIGHTED_INTERLEAVE"
+	MemPolicyPreferred          MemPolicyMode = "MPOL_PREFERRED"
+	MemPolicyPreferredMany      MemPolicyMode = "MPOL_PREFERRED_MANY"
+	MemPolicyLocal              MemPolicyMode = "MPOL_LOCAL"
+)
+
+// MemPolicyFlag is a mode flag of a memory policy.
+type MemPolicyFlag string
+
+// Memory policy flags.
+const (
+	MemPolicyNumaBalancing MemPolicyFlag = "MPOL_F_NUMA_BALANCING"
+	MemPolicyRelativeNodes MemPolicyFlag = "MPOL_F_RELATIVE_NODES"
+	MemPolicyStaticNodes   MemPolicyFlag = "MPOL_F_STATIC_NODES"
+)
+
+// runtime-spec 1.3 settings that specs-go 1.2 has no fields for travel
+// to NewContainerSpec in these annotations, as JSON objects of the spec.
+const (
+	memPolicyAnnotation       = "io.github.danielealbano.libcrun-go.memory-policy"
+	execCPUAffinityAnnotation = "io.github.danielealbano.libcrun-go.exec-cpu-affinity"
+)
+
+// WithMemPolicy sets the NUMA memory policy of the container's processes
+// (linux.memoryPolicy): mode over the memory nodes in list format
+// ("0-1"), which MemPolicyDefault and MemPolicyLocal take none of.
+func WithMemPolicy(mode MemPolicyMode, nodes string, flags ...MemPolicyFlag) SpecOption {
+	b, _ := json.Marshal(struct {
+		Mode  MemPolicyMode   `json:"mode"`
+		Nodes string          `json:"nodes,omitempty"`
+		Flags []MemPolicyFlag `json:"flags,omitempty"`
+	}{mode, nodes, flags})
+	return WithAnnotation(memPolicyAnnotation, string(b))
+}
+
+// WithExecCPUAffinity sets the CPU affinity, in list format, of processes
+// exec'd into the container (process.execCPUAffinity): initial while
+// they join the container, final from then on. Empty lists are left
+// unset.
+func WithExecCPUAffinity(initial, final string) SpecOption {
+	b, _ := json.Marshal(struct {
+		Initial string `json:"initial,omitempty"`
+		Final   string `json:"final,omitempty"`
+	}{initial, final})
+	return WithAnnotation(execCPUAffinityAnnotation, string(b))
+}
+
+// WithScheduler sets the scheduling policy of the container's processes
+// (process.scheduler): nice applies to SCHED_OTHER and SCHED_BATCH,
+// priority to SCHED_FIFO and SCHED_RR. See sched_setattr(2).
+func WithScheduler(policy specs.LinuxSchedulerPolicy, nice, priority int32, flags ...specs.LinuxSchedulerFlag) SpecOption {
+	return func(sp *specs.Spec) {
+		if sp.Process == nil {
+			sp.Process = &specs.Process{}
+		}
+		sp.Process.Scheduler = &specs.Scheduler{Policy: policy, Nice: nice, Priority: priority, Flags: flags}
+	}
+}
+
+// WithDeadlineScheduler runs the container's processes under
+// SCHED_DEADLINE: each gets runtime of CPU time within every period,
+// by deadline from the start of the period. A zero deadline is the
+// period.
+func WithDeadlineScheduler(runtime, deadline, period time.Duration, flags ...specs.LinuxSchedulerFlag) SpecOption {
+	return func(sp *specs.Spec) {
+		if sp.Process == nil {
+			sp.Process = &specs.Process{}
+		}
+		if deadline == 0 {
+			deadline = period
+		}
+		sp.Process.Scheduler = &specs.Scheduler{
+			Policy:   specs.SchedDeadline,
+			Flags:    flags,
+			Runtime:  uint64(runtime.Nanoseconds()),
+			Deadline: uint64(deadline.Nanoseconds()),
+			Period:   uint64(period.Nanoseconds()),
+		}
+	}
+}
+
+// WithIOPriority sets the I/O scheduling class of the container's
+// processes, and their level within it: 0 (highest) to 7 for
+// IOPRIO_CLASS_RT and IOPRIO_CLASS_BE. See ioprio_set(2).
+func WithIOPriority(class specs.IOPriorityClass, level int) SpecOption {
+	return func(sp *specs.Spec) {
+		if sp.Process == nil {
+			sp.Process = &specs.Process{}
+		}
+		sp.Process.IOPriority = &specs.IOPriority{Class: class, Priority: level}
+	}
+}
+
+// WithBlockIOWeight sets the proportional block I/O weight of the
+// container's cgroup, from 10 to 1000 (io.weight on cgroup v2).
+func WithBlockIOWeight(weight uint16) SpecOption {
+	return func(sp *specs.Spec) {
+		ensureLinuxResources(sp)
+		if sp.Linux.Resources.BlockIO == nil {
+			sp.Linux.Resources.BlockIO = &specs.LinuxBlockIO{}
+		}
+		sp.Linux.Resources.BlockIO.Weight = &weight
+	}
+}
+
+// Tier is a named bundle of CPU and I/O scheduling settings, so that
+// background work yields to latency-sensitive containers on a shared
+// host.
+type Tier string
+
+// Tiers.
+const (
+	// TierLatencyCritical raises the nice level (-10) and best-effort I/O
+	// priority of the processes, and gives the cgroup 10x the CPU and
+	// twice the block I/O weight of a default one.
+	TierLatencyCritical Tier = "latency-critical"
+	// TierDefault is the kernel's defaults: SCHED_OTHER at nice 0 and
+	// best-effort I/O at level 4, with the CPU and block I/O weights of
+	// the host's other cgroups.
+	TierDefault Tier = "default"
+	// TierBatch runs the processes under SCHED_BATCH at nice 19, with idle
+	// I/O priority, and the cgroup at the smallest CPU and block I/O
+	// weights, so that it only gets what the other tiers leave.
+	TierBatch Tier = "batch"
+)
+
+// WithTier applies the scheduling settings of tier; unknown tiers leave
+// the spec unchanged. The block I/O weight needs an I/O controller that
+// supports it (io.weight on cgroup v2, BFQ or CFQ on cgroup v1).
+func WithTier(tier Tier) SpecOption {
+	return func(sp *specs.Spec) {
+		switch tier {
+		case TierLatencyCritical:
+			WithScheduler(specs.SchedOther, -10, 0)(sp)
+			WithIOPriority(specs.IOPRIO_CLASS_BE, 0)(sp)
+			WithCPUShares(10240)(sp)
+			WithBlockIOWeight(1000)(sp)
+		case TierDefault:
+			WithScheduler(specs.SchedOther, 0, 0)(sp)
+			WithIOPriority(specs.IOPRIO_CLASS_BE, 4)(sp)
+		case TierBatch:
+			WithScheduler(specs.SchedBatch, 19, 0)(sp)
+			WithIOPriority(specs.IOPRIO_CLASS_IDLE, 0)(sp)
+			WithCPUShares(2)(sp)
+			WithBlockIOWeight(10)(sp)
+		}
+	}
+}
+
 // WithNetworkNamespace sets the network namespace path.
 // If path is empty, a new network namespace is created.
 func WithNetworkNamespace(path string) SpecOption {
@@ -175,6 +403,19 @@ func WithMountNamespace(path string) SpecOption {
 	}
 }
 
+// WithCgroupsPath sets the cgroup of the container. With the systemd
+// cgroup manager (RuntimeConfig.SystemdCgroup), it reads
+// "<slice>:<prefix>:<name>" and places the container in the scope
+// "<prefix>-<name>.scope" of slice; see RuntimeContext.PrepareSlices.
+func WithCgroupsPath(path string) SpecOption {
+	return func(sp *specs.Spec) {
+		if sp.Linux == nil {
+			sp.Linux = &specs.Linux{}
+		}
+		sp.Linux.CgroupsPath = path
+	}
+}
+
 // WithHostname sets the container hostname.
 func WithHostname(name string) SpecOption {
 	return func(sp *specs.Spec) {
@@ -204,6 +445,41 @@ func WithAnnotation(key, value string) SpecOption {
 	}
 }
 
+// WithSeccompNotify makes syscalls notify agent instead of running
+// (SCMP_ACT_NOTIFY): the agent's handler answers them. The rule is added
+// to the spec's seccomp profile, or to one allowing everything else if the
+// spec has none, and the syscalls must have no other rule in it.
+func WithSeccompNotify(agent *SeccompAgent, syscalls ...string) SpecOption {
+	return func(sp *specs.Spec) {
+		if sp.Linux == nil {
+			sp.Linux = &specs.Linux{}
+		}
+		if sp.Linux.Seccomp == nil {
+			sp.Linux.Seccomp = &specs.LinuxSeccomp{DefaultAction: specs.ActAllow}
+		}
+		sp.Linux.Seccomp.ListenerPath = agent.Path()
+		sp.Linux.Seccomp.Syscalls = append(sp.Linux.Seccomp.Syscalls, specs.LinuxSyscall{
+			Names:  syscalls,
+			Action: specs.ActNotify,
+		})
+	}
+}
+
+// wasmModuleCacheDir is where WithWasmModuleCache mounts the cache: the
+// default cache directory of wasmtime under HOME=/root, the only variable
+// the spin handler starts spin with.
+const wasmModuleCacheDir = "/root/.cache"
+
+// WithWasmModuleCache shares the host directory dir, which must exist, as
+// the module cache of a Wasm container run by the spin handler. spin
+// compiles the module in the container with wasmtime, which caches the
+// machine code keyed by a hash of the module and the compiler settings:
+// the containers sharing dir compile each module once, and later launches
+// of the same module load the cached code instead.
+func WithWasmModuleCache(dir string) SpecOption {
+	return WithMount(dir, wasmModuleCacheDir, "bind", []string{"rbind", "rw"})
+}
+
 // WithUser sets the user (UID and GID) for the container process.
 func WithUser(uid, gid uint32) SpecOption {
 	return func(sp *specs.Spec) {
@@ -282,9 +558,47 @@ func ensureLinuxResources(sp *specs.Spec) {
 	}
 }
 
+func ensureLinuxIntelRdt(sp *specs.Spec) {
+	if sp.Linux == nil {
+		sp.Linux = &specs.Linux{}
+	}
+	if sp.Linux.IntelRdt == nil {
+		sp.Linux.IntelRdt = &specs.LinuxIntelRdt{}
+	}
+}
+
+// defaultSpecTemplate caches the parsed libcrun template for one rootless
+// setting. The template only depends on the process credentials, so it is
+// generated once per process.
+type defaultSpecTemplate struct {
+	once sync.Once
+	spec *specs.Spec
+	err  error
+}
+
+var defaultSpecTemplates [2]defaultSpecTemplate // [rootful, rootless]
+
 // DefaultSpec returns a typed OCI spec using libcrun's baseline template,
 // unmarshalled into specs-go. Set rootless=true for an unprivileged template.
+//
+// The template is generated and parsed once per process; each call returns
+// an independent deep copy that the caller may modify freely.
 func DefaultSpec(rootless bool) (*specs.Spec, error) {
+	t := &defaultSpecTemplates[0]
+	if rootless {
+		t = &defaultSpecTemplates[1]
+	}
+	t.once.Do(func() {
+		t.spec, t.err = parseDefaultSpec(rootless)
+	})
+	if t.err != nil {
+		return nil, t.err
+	}
+	return cloneSpec(t.spec), nil
+}
+
+// parseDefaultSpec generates libcrun's template and unmarshals it.
+func parseDefaultSpec(rootless bool) (*specs.Spec, error) {
 	js, err := Spec(rootless)
 	if err != nil {
 		return nil, err
@@ -296,6 +610,11 @@ func DefaultSpec(rootless bool) (*specs.Spec, error) {
 	return &sp, nil
 }
 
+// cloneSpec returns a deep copy of sp.
+func cloneSpec(sp *specs.Spec) *specs.Spec {
+	return cloneSpecValue(reflect.ValueOf(sp)).Interface().(*specs.Spec)
+}
+
 // SetOrReplaceLinuxNamespace sets or replaces a Linux namespace entry on the Spec.
 // If path != "", it attaches an existing namespace (e.g. "/proc/<pid>/ns/net").
 // If path == "", it means "create a fresh namespace" of that type.
@@ -3,7 +3,9 @@
 package crun
 
 import (
+	"reflect"
 	"testing"
+	"time"
 
 	specs "github.com/opencontainers/runtime-spec/specs-go"
 )
@@ -137,6 +139,15 @@ func TestSpecOptionWithHostname(t *testing.T) {
 	}
 }
 
+func TestSpecOptionWithCgroupsPath(t *testing.T) {
+	sp := &specs.Spec{}
+	WithCgroupsPath("tenant-a.slice:crun:c1")(sp)
+
+	if sp.Linux == nil || sp.Linux.CgroupsPath != "tenant-a.slice:crun:c1" {
+		t.Errorf("WithCgroupsPath failed: got %v", sp.Linux)
+	}
+}
+
 func TestSpecOptionWithMount(t *testing.T) {
 	sp := &specs.Spec{}
 	opt := WithMount("/host/data", "/container/data", "none", []string{"bind", "ro"})
@@ -362,3 +373,189 @@ func TestSpecOptionWithCapabilityNoDuplicates(t *testing.T) {
 		}
 	}
 }
+
+func TestDefaultSpecReturnsIndependentCopies(t *testing.T) {
+	for _, rootless := range []bool{false, true} {
+		a, err := DefaultSpec(rootless)
+		if err != nil {
+			t.Fatalf("DefaultSpec(%v) failed: %v", rootless, err)
+		}
+		fresh, err := parseDefaultSpec(rootless)
+		if err != nil {
+			t.Fatalf("parseDefaultSpec(%v) failed: %v", rootless, err)
+		}
+		if !reflect.DeepEqual(a, fresh) {
+			t.Errorf("DefaultSpec(%v) differs from a fresh parse", rootless)
+		}
+
+		// Mutating one copy must not leak into the template
+		WithArgs("/bin/false")(a)
+		WithEnv("FOO", "bar")(a)
+		WithMount("/src", "/dst", "bind", []string{"rbind"})(a)
+		if a.Linux != nil && len(a.Linux.Namespaces) > 0 {
+			a.Linux.Namespaces[0].Path = "/proc/1/ns/x"
+		}
+
+		b, err := DefaultSpec(rootless)
+		if err != nil {
+			t.Fatalf("DefaultSpec(%v) failed: %v", rootless, err)
+		}
+		if !reflect.DeepEqual(b, fresh) {
+			t.Errorf("DefaultSpec(%v) template was modified through a copy", rootless)
+		}
+	}
+}
+
+func TestCloneSpecValue(t *testing.T) {
+	limit := int64(42)
+	src := &specs.Spec{
+		Process:     &specs.Process{Args: []string{"a", "b"}},
+		Annotations: map[string]string{"k": "v"},
+		Linux: &specs.Linux{
+			Resources: &specs.LinuxResources{Pids: &specs.LinuxPids{Limit: limit}},
+		},
+	}
+	dst := cloneSpec(src)
+	if !reflect.DeepEqual(src, dst) {
+		t.Fatal("clone differs from source")
+	}
+	dst.Process.Args[0] = "x"
+	dst.Annotations["k"] = "w"
+	dst.Linux.Resources.Pids.Limit = 1
+	if src.Process.Args[0] != "a" || src.Annotations["k"] != "v" || src.Linux.Resources.Pids.Limit != limit {
+		t.Error("clone shares memory with source")
+	}
+}
+
+func BenchmarkDefaultSpec(b *testing.B) {
+	b.Run("cached", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			if _, err := DefaultSpec(false); err != nil {
+				b.Fatal(err)
+			}
+		}
+	})
+	b.Run("uncached", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			if _, err := parseDefaultSpec(false); err != nil {
+				b.Fatal(err)
+			}
+		}
+	})
+}
+
+func BenchmarkNewSpec(b *testing.B) {
+	opts := []SpecOption{
+		WithRootPath("/tmp/rootfs"),
+		WithArgs("/bin/sh", "-c", "true"),
+		WithEnv("TERM", "xterm"),
+		WithHostname("bench"),
+		WithMemoryLimit(64 << 20),
+		WithCPUShares(512),
+		WithPidsLimit(64),
+	}
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		spec, err := NewSpec(false, opts...)
+		if err != nil {
+			b.Fatal(err)
+		}
+		spec.Close()
+	}
+}
+
+func TestSpecOptionWithOverlayRootfs(t *testing.T) {
+	sp := &specs.Spec{Root: &specs.Root{Path: "/old", Readonly: true}}
+	WithOverlayRootfs([]string{"/layers/base", "/layers/app"}, 64<<20)(sp)
+
+	if sp.Root.Path != "/layers/app" || sp.Root.Readonly {
+		t.Errorf("Root = %+v, want the top layer, writable", sp.Root)
+	}
+	if got := sp.Annotations[overlayLowerAnnotation]; got != "/layers/base:/layers/app" {
+		t.Errorf("lower annotation = %q", got)
+	}
+	if got := sp.Annotations[overlayUpperSizeAnnotation]; got != "67108864" {
+		t.Errorf("upper size annotation = %q", got)
+	}
+}
+
+func TestSpecOptionWithScheduler(t *testing.T) {
+	sp := &specs.Spec{}
+	WithScheduler(specs.SchedFIFO, 0, 50, specs.SchedFlagResetOnFork)(sp)
+	want := &specs.Scheduler{Policy: specs.SchedFIFO, Priority: 50, Flags: []specs.LinuxSchedulerFlag{specs.SchedFlagResetOnFork}}
+	if !reflect.DeepEqual(sp.Process.Scheduler, want) {
+		t.Errorf("Scheduler = %+v, want %+v", sp.Process.Scheduler, want)
+	}
+
+	WithDeadlineScheduler(2*time.Millisecond, 0, 10*time.Millisecond)(sp)
+	if s := sp.Process.Scheduler; s.Policy != specs.SchedDeadline || s.Runtime != 2e6 || s.Deadline != 1e7 || s.Period != 1e7 {
+		t.Errorf("deadline Scheduler = %+v", s)
+	}
+
+	WithIOPriority(specs.IOPRIO_CLASS_RT, 3)(sp)
+	if p := sp.Process.IOPriority; p == nil || p.Class != specs.IOPRIO_CLASS_RT || p.Priority != 3 {
+		t.Errorf("IOPriority = %+v", p)
+	}
+}
+
+func TestSpecOptionWithTier(t *testing.T) {
+	critical, batch := &specs.Spec{}, &specs.Spec{}
+	WithTier(TierLatencyCritical)(critical)
+	WithTier(TierBatch)(batch)
+
+	if c, b := critical.Process.Scheduler, batch.Process.Scheduler; c.Nice >= 0 || b.Policy != specs.SchedBatch || b.Nice <= 0 {
+		t.Errorf("schedulers = %+v, %+v", c, b)
+	}
+	if c, b := critical.Process.IOPriority, batch.Process.IOPriority; c.Class != specs.IOPRIO_CLASS_BE || b.Class != specs.IOPRIO_CLASS_IDLE {
+		t.Errorf("I/O priorities = %+v, %+v", c, b)
+	}
+	cr, br := critical.Linux.Resources, batch.Linux.Resources
+	if *cr.CPU.Shares <= *br.CPU.Shares || *cr.BlockIO.Weight <= *br.BlockIO.Weight {
+		t.Errorf("weights: critical %d/%d, batch %d/%d", *cr.CPU.Shares, *cr.BlockIO.Weight, *br.CPU.Shares, *br.BlockIO.Weight)
+	}
+
+	def := &specs.Spec{}
+	WithTier(TierDefault)(def)
+	if def.Linux != nil || def.Process.Scheduler.Policy != specs.SchedOther || def.Process.IOPriority.Priority != 4 {
+		t.Errorf("default tier = %+v, %+v", def.Process, def.Linux)
+	}
+	unknown := &specs.Spec{}
+	WithTier("gold")(unknown)
+	if !reflect.DeepEqual(unknown, &specs.Spec{}) {
+		t.Errorf("unknown tier changed the spec: %+v", unknown)
+	}
+}
+
+func TestSpecOptionWithWasmModuleCache(t *testing.T) {
+	sp := &specs.Spec{}
+	WithWasmModuleCache("/var/lib/wasm-cache")(sp)
+	if len(sp.Mounts) != 1 || sp.Mounts[0].Source != "/var/lib/wasm-cache" || sp.Mounts[0].Destination != wasmModuleCacheDir ||
+		!containsString(sp.Mounts[0].Options, "rw") {
+		t.Errorf("mounts = %+v", sp.Mounts)
+	}
+}
+
+func TestSpecOptionWithSeccompNotify(t *testing.T) {
+	agent := &SeccompAgent{path: "/run/agent.sock"}
+	sp := &specs.Spec{}
+	WithSeccompNotify(agent, "mount", "mknod")(sp)
+	sc := sp.Linux.Seccomp
+	if sc.DefaultAction != specs.ActAllow || sc.ListenerPath != "/run/agent.sock" {
+		t.Fatalf("seccomp = %+v", sc)
+	}
+	if len(sc.Syscalls) != 1 || sc.Syscalls[0].Action != specs.ActNotify || !reflect.DeepEqual(sc.Syscalls[0].Names, []string{"mount", "mknod"}) {
+		t.Errorf("rules = %+v", sc.Syscalls)
+	}
+
+	// An existing profile keeps its default action and rules
+	sp = &specs.Spec{Linux: &specs.Linux{Seccomp: &specs.LinuxSeccomp{
+		DefaultAction: specs.ActErrno,
+		Syscalls:      []specs.LinuxSyscall{{Names: []string{"read"}, Action: specs.ActAllow}},
+	}}}
+	WithSeccompNotify(agent, "mount")(sp)
+	if sc := sp.Linux.Seccomp; sc.DefaultAction != specs.ActErrno || len(sc.Syscalls) != 2 {
+		t.Errorf("seccomp = %+v", sc)
+	}
+}
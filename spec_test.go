@@ -5,6 +5,7 @@ package crun
 import (
 	"strings"
 	"testing"
+	"unsafe"
 
 	specs "github.com/opencontainers/runtime-spec/specs-go"
 )
@@ -110,3 +111,80 @@ func TestContainerSpecClose(t *testing.T) {
 	}
 }
 
+func TestNewContainerSpecBufferReuse(t *testing.T) {
+	// Specs built back to back share the pooled encode buffer; each must
+	// keep its own document
+	var loaded []*ContainerSpec
+	for _, path := range []string{"/tmp/rootfs-a", "/tmp/rootfs-bb", "/tmp/c"} {
+		spec, err := NewContainerSpec(&specs.Spec{
+			Version: "1.0.0",
+			Root:    &specs.Root{Path: path},
+			Process: &specs.Process{Args: []string{"/bin/sh"}, Cwd: "/"},
+		})
+		if err != nil {
+			t.Fatalf("NewContainerSpec failed: %v", err)
+		}
+		defer spec.Close()
+		loaded = append(loaded, spec)
+	}
+
+	for i, want := range []string{"/tmp/rootfs-a", "/tmp/rootfs-bb", "/tmp/c"} {
+		got := goStringAt(unsafe.Pointer(loaded[i].c.container_def.root.path))
+		if got != want {
+			t.Errorf("spec %d root path = %q, want %q", i, got, want)
+		}
+	}
+}
+
+func TestNewSpecPlacement(t *testing.T) {
+	spec, err := NewSpec(false,
+		WithMemPolicy(MemPolicyBind, "0", MemPolicyStaticNodes),
+		WithExecCPUAffinity("0", "0-1"))
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	defer spec.Close()
+	config := goStringAt(unsafe.Pointer(spec.c.config_file_content))
+	for _, want := range []string{`"memoryPolicy"`, `"MPOL_BIND"`, `"MPOL_F_STATIC_NODES"`, `"execCPUAffinity"`, `"0-1"`} {
+		if !strings.Contains(config, want) {
+			t.Errorf("config lacks %s: %s", want, config)
+		}
+	}
+
+	if _, err := NewSpec(false, WithAnnotation(memPolicyAnnotation, "{")); err == nil {
+		t.Error("NewSpec with a malformed memory policy succeeded")
+	}
+}
+
+func TestNewSpecTier(t *testing.T) {
+	spec, err := NewSpec(false, WithTier(TierBatch))
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	defer spec.Close()
+	p := spec.c.container_def.process
+	if got := goStringAt(unsafe.Pointer(p.scheduler.policy)); got != "SCHED_BATCH" || p.scheduler.nice != 19 {
+		t.Errorf("scheduler = %s at nice %d", got, p.scheduler.nice)
+	}
+	if got := goStringAt(unsafe.Pointer(p.io_priority._class)); got != "IOPRIO_CLASS_IDLE" {
+		t.Errorf("I/O priority class = %s", got)
+	}
+}
+
+func BenchmarkNewContainerSpec(b *testing.B) {
+	sp, err := DefaultSpec(false)
+	if err != nil {
+		b.Fatalf("DefaultSpec failed: %v", err)
+	}
+	WithRootPath("/tmp/rootfs")(sp)
+	WithArgs("/bin/true")(sp)
+
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		spec, err := NewContainerSpec(sp)
+		if err != nil {
+			b.Fatal(err)
+		}
+		spec.Close()
+	}
+}
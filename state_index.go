@@ -0,0 +1,154 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"io"
+	"os"
+	"sort"
+	"sync"
+	"syscall"
+	"unsafe"
+)
+
+// tmpfsMagic is the f_type of tmpfs.
+const tmpfsMagic = 0x01021994
+
+// stateIndex is the in-process list of containers kept with
+// RuntimeConfig.EphemeralState, so that List, ListIDs and ListWithState do
+// not read the state root directory.
+type stateIndex struct {
+	mu  sync.Mutex
+	ids map[string]struct{}
+}
+
+// prepareEphemeralRoot makes sure root exists and is on tmpfs, mounting a
+// private tmpfs over it otherwise, and returns an index of the containers
+// it already holds. It refuses to mount over a non-empty directory, whose
+// containers the mount would hide while their processes keep running.
+func prepareEphemeralRoot(c *C.libcrun_context_t, root string) (*stateIndex, error) {
+	if root == "" {
+		return nil, errors.New("libcrun: EphemeralState needs a StateRoot")
+	}
+	if err := os.MkdirAll(root, 0o700); err != nil {
+		return nil, err
+	}
+	var st syscall.Statfs_t
+	if err := syscall.Statfs(root, &st); err != nil {
+		return nil, err
+	}
+	if st.Type != tmpfsMagic {
+		empty, err := dirEmpty(root)
+		if err != nil {
+			return nil, err
+		}
+		if !empty {
+			return nil, errors.New("libcrun: EphemeralState cannot mount a tmpfs over " + root + ", which is not empty")
+		}
+		if err := syscall.Mount("tmpfs", root, "tmpfs", syscall.MS_NOSUID|syscall.MS_NODEV|syscall.MS_NOEXEC, "mode=0700"); err != nil {
+			return nil, &os.PathError{Op: "mount tmpfs", Path: root, Err: err}
+		}
+	}
+
+	var arr **C.char
+	var n C.int
+	var err C.libcrun_error_t
+	if C.go_crun_list(c.state_root, &arr, &n, &err) < 0 {
+		return nil, fromLibcrunErr(&err)
+	}
+	defer C.go_crun_free_strv(arr, n)
+	idx := &stateIndex{ids: make(map[string]struct{}, int(n))}
+	for _, s := range unsafe.Slice(arr, int(n)) {
+		idx.ids[C.GoString(s)] = struct{}{}
+	}
+	return idx, nil
+}
+
+// dirEmpty reports whether the directory dir has no entries.
+func dirEmpty(dir string) (bool, error) {
+	f, err := os.Open(dir)
+	if err != nil {
+		return false, err
+	}
+	defer f.Close()
+	if _, err := f.Readdirnames(1); err != io.EOF {
+		return false, err
+	}
+	return true, nil
+}
+
+func (s *stateIndex) add(id string) {
+	if s == nil {
+		return
+	}
+	s.mu.Lock()
+	s.ids[id] = struct{}{}
+	s.mu.Unlock()
+}
+
+func (s *stateIndex) remove(id string) {
+	if s == nil {
+		return
+	}
+	s.mu.Lock()
+	delete(s.ids, id)
+	s.mu.Unlock()
+}
+
+// list returns the indexed ids, sorted.
+func (s *stateIndex) list() []string {
+	s.mu.Lock()
+	out := make([]string, 0, len(s.ids))
+	for id := range s.ids {
+		out = append(out, id)
+	}
+	s.mu.Unlock()
+	sort.Strings(out)
+	return out
+}
+
+// listEntries returns the indexed ids as entries for
+// go_crun_read_list_states, to be released with go_crun_free_list_entries.
+func (s *stateIndex) listEntries() (*C.struct_go_crun_list_entry, C.int) {
+	ids := s.list()
+	entries := (*C.struct_go_crun_list_entry)(C.calloc(C.size_t(len(ids)+1), C.size_t(unsafe.Sizeof(C.struct_go_crun_list_entry{}))))
+	es := unsafe.Slice(entries, len(ids))
+	for i, id := range ids {
+		es[i].id = C.CString(id)
+	}
+	return entries, C.int(len(ids))
+}
+
+// indexLaunch records a container started through this context by an
+// in-process call (Create, Run, Restore). Unless detached, a run
+// container has already been deleted by libcrun when the call returns.
+func (x *RuntimeContext) indexLaunch(id string, detached bool) {
+	if detached {
+		x.index.add(id)
+	}
+}
+
+// indexLaunchIO records a container started by a forked child (RunWithIO,
+// RunBatch, RestoreWithIO). It is dropped once the child exits, unless the
+// container was detached and the child succeeded.
+func (x *RuntimeContext) indexLaunchIO(id string, res *RunResult) {
+	if x.index == nil {
+		return
+	}
+	x.index.add(id)
+	detach := bool(x.c.detach)
+	wait := res.Wait
+	res.Wait = func() (int, error) {
+		code, err := wait()
+		if !detach || err != nil || code != 0 {
+			x.index.remove(id)
+		}
+		return code, err
+	}
+}
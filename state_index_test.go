@@ -0,0 +1,112 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"os"
+	"reflect"
+	"strings"
+	"syscall"
+	"testing"
+)
+
+// ephemeralRoot returns a fresh directory on tmpfs, or skips.
+func ephemeralRoot(t testing.TB) string {
+	t.Helper()
+	var st syscall.Statfs_t
+	if err := syscall.Statfs("/dev/shm", &st); err != nil || st.Type != tmpfsMagic {
+		t.Skip("/dev/shm is not a tmpfs")
+	}
+	root, err := os.MkdirTemp("/dev/shm", "crun-state-")
+	if err != nil {
+		t.Fatalf("MkdirTemp failed: %v", err)
+	}
+	t.Cleanup(func() { os.RemoveAll(root) })
+	return root
+}
+
+func TestEphemeralStateIndex(t *testing.T) {
+	root := ephemeralRoot(t)
+	writeFakeContainer(t, root, "b")
+	writeFakeContainer(t, root, "a")
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: root, EphemeralState: true})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+
+	// Containers written behind the context's back are not listed
+	writeFakeContainer(t, root, "c")
+	ids, err := rc.ListIDs()
+	if err != nil || !reflect.DeepEqual(ids, []string{"a", "b"}) {
+		t.Fatalf("ListIDs = %v, %v; want [a b]", ids, err)
+	}
+	list, err := rc.List()
+	if err != nil || len(list) != 2 || list[0].ID != "a" || list[1].ID != "b" {
+		t.Fatalf("List = %v, %v", list, err)
+	}
+	states, err := rc.ListWithState(nil, ListOptions{})
+	if err != nil || len(states) != 2 || states[0].ID != "a" || states[0].Status != StatusStopped {
+		t.Fatalf("ListWithState = %+v, %v", states, err)
+	}
+
+	if err := rc.Get("a").Delete(false); err != nil {
+		t.Fatalf("Delete failed: %v", err)
+	}
+	if ids, _ := rc.ListIDs(); !reflect.DeepEqual(ids, []string{"b"}) {
+		t.Errorf("ListIDs after Delete = %v, want [b]", ids)
+	}
+	// An indexed container deleted elsewhere is left out of ListWithState
+	os.RemoveAll(root + "/b")
+	if states, err := rc.ListWithState(states, ListOptions{}); err != nil || len(states) != 0 {
+		t.Errorf("ListWithState after external delete = %+v, %v", states, err)
+	}
+}
+
+func TestEphemeralStateNeedsStateRoot(t *testing.T) {
+	if _, err := NewRuntimeContext(RuntimeConfig{EphemeralState: true}); err == nil {
+		t.Error("EphemeralState without StateRoot succeeded")
+	}
+}
+
+func BenchmarkListIDs(b *testing.B) {
+	root := ephemeralRoot(b)
+	for _, id := range fakeIDs(256) {
+		writeFakeContainer(b, root, id)
+	}
+	for _, ephemeral := range []bool{false, true} {
+		name := "dir"
+		if ephemeral {
+			name = "index"
+		}
+		b.Run(name, func(b *testing.B) {
+			rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: root, EphemeralState: ephemeral})
+			if err != nil {
+				b.Fatalf("NewRuntimeContext failed: %v", err)
+			}
+			defer rc.Close()
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				if ids, err := rc.ListIDs(); err != nil || len(ids) != 256 {
+					b.Fatalf("ListIDs = %d ids, %v", len(ids), err)
+				}
+			}
+		})
+	}
+}
+
+func TestEphemeralStateRefusesNonEmptyRoot(t *testing.T) {
+	root := t.TempDir()
+	var st syscall.Statfs_t
+	if err := syscall.Statfs(root, &st); err != nil || st.Type == tmpfsMagic {
+		t.Skip("the temporary directory is on tmpfs")
+	}
+	writeFakeContainer(t, root, "a")
+	_, err := NewRuntimeContext(RuntimeConfig{StateRoot: root, EphemeralState: true})
+	if err == nil || !strings.Contains(err.Error(), root) {
+		t.Fatalf("NewRuntimeContext over a non-empty root = %v, want an error naming %s", err, root)
+	}
+	if err := syscall.Statfs(root, &st); err != nil || st.Type == tmpfsMagic {
+		t.Error("tmpfs mounted over a non-empty root")
+	}
+}
@@ -0,0 +1,107 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"os"
+	"sync"
+	"syscall"
+	"unsafe"
+)
+
+// direntBufSize is the getdents64 buffer of IterIDs: a few hundred
+// entries per call.
+const direntBufSize = 32 << 10
+
+var direntBufPool = sync.Pool{New: func() any { b := make([]byte, direntBufSize); return &b }}
+
+// Offsets in a struct linux_dirent64: d_ino, d_off, then these
+const (
+	direntReclenOff = 16
+	direntTypeOff   = 18
+	direntNameOff   = 19
+)
+
+// IterIDs calls fn with the id of each container under the state root, as
+// ListIDs lists them, until fn returns false. It reads the state root in
+// batches with getdents64 and keeps nothing between them: memory stays
+// flat however many containers the root holds, and the first ids come
+// before the directory was read through. Containers created or deleted
+// during the walk may or may not be reported. The order is the
+// directory's.
+func (x *RuntimeContext) IterIDs(fn func(id string) bool) error {
+	if x == nil || x.c == nil {
+		return errors.New("libcrun: invalid runtime context")
+	}
+	if x.index != nil {
+		for _, id := range x.index.list() {
+			if !fn(id) {
+				break
+			}
+		}
+		return nil
+	}
+	var cdir *C.char
+	var err C.libcrun_error_t
+	if x.onWorker(func() C.int { return C.go_crun_state_dir(x.c.state_root, &cdir, &err) }) < 0 {
+		return fromLibcrunErr(&err)
+	}
+	dir := C.GoString(cdir)
+	C.free(unsafe.Pointer(cdir))
+
+	fd, oerr := syscall.Open(dir, syscall.O_RDONLY|syscall.O_DIRECTORY|syscall.O_CLOEXEC, 0)
+	if oerr != nil {
+		return &os.PathError{Op: "open", Path: dir, Err: oerr}
+	}
+	defer syscall.Close(fd)
+	bp := direntBufPool.Get().(*[]byte)
+	defer direntBufPool.Put(bp)
+	buf := *bp
+	var status []byte // "<id>/status\0", for faccessat
+	for {
+		n, rerr := syscall.ReadDirent(fd, buf)
+		if rerr == syscall.EINTR {
+			continue
+		}
+		if rerr != nil {
+			return &os.PathError{Op: "getdents64", Path: dir, Err: rerr}
+		}
+		if n <= 0 {
+			return nil
+		}
+		for off := 0; off < n; {
+			rec := buf[off:n]
+			reclen := int(binary.NativeEndian.Uint16(rec[direntReclenOff:]))
+			off += reclen
+			name := rec[direntNameOff:reclen]
+			if i := bytes.IndexByte(name, 0); i >= 0 {
+				name = name[:i]
+			}
+			// As libcrun: hidden entries are skipped, and so are
+			// directories without a status file, of containers being
+			// created or deleted
+			if len(name) == 0 || name[0] == '.' {
+				continue
+			}
+			if t := rec[direntTypeOff]; t != syscall.DT_DIR && t != syscall.DT_UNKNOWN {
+				continue
+			}
+			status = append(append(status[:0], name...), "/status\x00"...)
+			if _, _, errno := syscall.Syscall6(syscall.SYS_FACCESSAT, uintptr(fd),
+				uintptr(unsafe.Pointer(&status[0])), 0, 0, 0, 0); errno != 0 {
+				continue
+			}
+			if !fn(string(name)) {
+				return nil
+			}
+		}
+	}
+}
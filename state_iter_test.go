@@ -0,0 +1,100 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"reflect"
+	"sort"
+	"testing"
+	"unsafe"
+)
+
+func TestIterIDs(t *testing.T) {
+	rc := fakeStateRoot(t, "a", "b", "c")
+	root := goStringAt(unsafe.Pointer(rc.c.state_root))
+	// Neither hidden entries, nor directories without a status, nor files
+	// are containers
+	for _, d := range []string{".overlay", "half-created"} {
+		if err := os.Mkdir(filepath.Join(root, d), 0o700); err != nil {
+			t.Fatal(err)
+		}
+	}
+	if err := os.WriteFile(filepath.Join(root, "stray"), nil, 0o600); err != nil {
+		t.Fatal(err)
+	}
+
+	var ids []string
+	if err := rc.IterIDs(func(id string) bool { ids = append(ids, id); return true }); err != nil {
+		t.Fatalf("IterIDs failed: %v", err)
+	}
+	sort.Strings(ids)
+	if want := []string{"a", "b", "c"}; !reflect.DeepEqual(ids, want) {
+		t.Errorf("IterIDs = %v, want %v", ids, want)
+	}
+	list, err := rc.ListIDs()
+	sort.Strings(list)
+	if err != nil || !reflect.DeepEqual(list, ids) {
+		t.Errorf("ListIDs = %v, %v; want %v", list, err, ids)
+	}
+
+	n := 0
+	if err := rc.IterIDs(func(string) bool { n++; return false }); err != nil || n != 1 {
+		t.Errorf("IterIDs stopping at once = %d calls, %v; want 1", n, err)
+	}
+}
+
+func TestIterIDsManyBatches(t *testing.T) {
+	// Enough long names to need several getdents64 calls
+	const count = 1500
+	ids := make([]string, count)
+	for i := range ids {
+		ids[i] = fmt.Sprintf("container-with-a-rather-long-id-%04d", i)
+	}
+	rc := fakeStateRoot(t)
+	root := goStringAt(unsafe.Pointer(rc.c.state_root))
+	for _, id := range ids {
+		if err := os.Mkdir(filepath.Join(root, id), 0o700); err != nil {
+			t.Fatal(err)
+		}
+		if err := os.WriteFile(filepath.Join(root, id, "status"), []byte("{}"), 0o600); err != nil {
+			t.Fatal(err)
+		}
+	}
+	seen := map[string]bool{}
+	if err := rc.IterIDs(func(id string) bool { seen[id] = true; return true }); err != nil {
+		t.Fatalf("IterIDs failed: %v", err)
+	}
+	if len(seen) != count {
+		t.Fatalf("IterIDs reported %d containers, want %d", len(seen), count)
+	}
+	for _, id := range ids {
+		if !seen[id] {
+			t.Fatalf("IterIDs missed %s", id)
+		}
+	}
+}
+
+func BenchmarkIterIDs(b *testing.B) {
+	rc := fakeStateRoot(b)
+	root := goStringAt(unsafe.Pointer(rc.c.state_root))
+	for i := 0; i < 1000; i++ {
+		dir := filepath.Join(root, fmt.Sprintf("c%d", i))
+		os.Mkdir(dir, 0o700)
+		os.WriteFile(filepath.Join(dir, "status"), []byte("{}"), 0o600)
+	}
+	b.Run("IterIDs", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			rc.IterIDs(func(string) bool { return true })
+		}
+	})
+	b.Run("ListIDs", func(b *testing.B) {
+		b.ReportAllocs()
+		for i := 0; i < b.N; i++ {
+			rc.ListIDs()
+		}
+	})
+}
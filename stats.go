@@ -0,0 +1,535 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"os"
+	"path/filepath"
+	"strconv"
+	"sync"
+	"syscall"
+	"unsafe"
+)
+
+// CPUStats is the content of cpu.stat.
+type CPUStats struct {
+	UsageUsec     uint64
+	UserUsec      uint64
+	SystemUsec    uint64
+	NrPeriods     uint64
+	NrThrottled   uint64
+	ThrottledUsec uint64
+}
+
+// MemoryStats holds memory.current, memory.max, memory.peak,
+// memory.swap.current and the main memory.stat counters, in bytes.
+type MemoryStats struct {
+	Current     uint64
+	Max         uint64 // 0 when unlimited
+	Peak        uint64 // 0 before Linux 5.19
+	SwapCurrent uint64
+	Anon        uint64
+	File        uint64
+	Kernel      uint64
+	Shmem       uint64
+	PgFault     uint64
+	PgMajFault  uint64
+}
+
+// PidsStats holds pids.current and pids.max.
+type PidsStats struct {
+	Current uint64
+	Max     uint64 // 0 when unlimited
+}
+
+// IODeviceStats is one line of io.stat.
+type IODeviceStats struct {
+	Major, Minor uint32
+	RBytes       uint64
+	WBytes       uint64
+	RIOs         uint64
+	WIOs         uint64
+	DBytes       uint64
+	DIOs         uint64
+}
+
+// Stats is a snapshot of a container's cgroup v2 resource usage. Counters
+// of controllers that are not enabled for the cgroup stay zero.
+type Stats struct {
+	ID     string
+	CPU    CPUStats
+	Memory MemoryStats
+	Pids   PidsStats
+	IO     []IODeviceStats
+}
+
+// Stats returns the resource usage of the container (cgroup v2 only).
+func (c *Container) Stats() (*Stats, error) {
+	st := &Stats{}
+	if err := c.StatsInto(st); err != nil {
+		return nil, err
+	}
+	return st, nil
+}
+
+// StatsInto is Stats filling a caller-provided value. The IO slice of st is
+// reused, so a scraper keeping one Stats per container does not allocate.
+func (c *Container) StatsInto(st *Stats) error {
+	if st.ID != c.ID {
+		st.ID = c.ID
+	}
+	return c.runtime.readStats(c.ID, st)
+}
+
+// StatsAll returns the resource usage of every container under the state
+// root that has a cgroup, appending to dst[:0]. As with ListWithState, the
+// entries, their IO slices and their ID strings are reused from dst, so a
+// periodic scrape reading into the same slice does not allocate per
+// container.
+//
+// Cgroup directories are resolved once per container and kept open (one
+// descriptor each) until the container goes away or the RuntimeContext is
+// closed; each scrape then costs an openat and a pread per file. Containers
+// deleted during the scrape are left out.
+func (x *RuntimeContext) StatsAll(dst []Stats) ([]Stats, error) {
+	if x == nil || x.c == nil {
+		return dst[:0], errors.New("libcrun: invalid runtime context")
+	}
+	var entries *C.struct_go_crun_list_entry
+	var n C.int
+	var err C.libcrun_error_t
+	if C.go_crun_list_entries(x.c.state_root, &entries, &n, &err) < 0 {
+		return dst[:0], fromLibcrunErr(&err)
+	}
+	defer C.go_crun_free_list_entries(entries, n)
+
+	es := unsafe.Slice(entries, int(n))
+	out := dst[:0]
+	live := make(map[string]struct{}, len(es))
+	for i := range es {
+		if len(out) == cap(out) {
+			out = append(out, Stats{})
+		} else {
+			out = out[:len(out)+1]
+		}
+		st := &out[len(out)-1]
+		st.ID = reuseCString(st.ID, es[i].id)
+		live[st.ID] = struct{}{}
+		if x.readStats(st.ID, st) != nil {
+			out = out[:len(out)-1] // gone, or no cgroup
+		}
+	}
+	x.cgroups.prune(live)
+	return out, nil
+}
+
+// cgroupDirs caches open cgroup directories by container id. The cache
+// owns the descriptors: an entry is closed once it left the cache and the
+// last read holding it released it, so a concurrent drop, prune or close
+// never closes a descriptor a read is using.
+type cgroupDirs struct {
+	mu  sync.Mutex
+	fds map[string]*cgroupDir
+}
+
+// cgroupDir is an open cgroup directory, held by the cache and by the reads
+// in progress.
+type cgroupDir struct {
+	fd   int
+	refs int // the cache's while cached, plus one per holder
+}
+
+// get returns the cached directory of id, held until release.
+func (d *cgroupDirs) get(id string) (*cgroupDir, bool) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	e, ok := d.fds[id]
+	if ok {
+		e.refs++
+	}
+	return e, ok
+}
+
+// put caches fd as the directory of id and returns it held until release.
+// When another caller cached one first, fd is closed and that one is
+// returned instead.
+func (d *cgroupDirs) put(id string, fd int) *cgroupDir {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	if e, ok := d.fds[id]; ok {
+		syscall.Close(fd)
+		e.refs++
+		return e
+	}
+	if d.fds == nil {
+		d.fds = make(map[string]*cgroupDir)
+	}
+	e := &cgroupDir{fd: fd, refs: 2}
+	d.fds[id] = e
+	return e
+}
+
+// release lets go of a directory from get or put.
+func (d *cgroupDirs) release(e *cgroupDir) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	d.unrefLocked(e)
+}
+
+func (d *cgroupDirs) unrefLocked(e *cgroupDir) {
+	if e.refs--; e.refs == 0 {
+		syscall.Close(e.fd)
+	}
+}
+
+// drop removes e, found removed from the cgroup tree, from the cache.
+func (d *cgroupDirs) drop(id string, e *cgroupDir) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	if d.fds[id] == e {
+		delete(d.fds, id)
+		d.unrefLocked(e)
+	}
+}
+
+// prune drops the directories of containers not in live.
+func (d *cgroupDirs) prune(live map[string]struct{}) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	for id, e := range d.fds {
+		if _, ok := live[id]; !ok {
+			delete(d.fds, id)
+			d.unrefLocked(e)
+		}
+	}
+}
+
+func (d *cgroupDirs) closeAll() {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	for id, e := range d.fds {
+		delete(d.fds, id)
+		d.unrefLocked(e)
+	}
+}
+
+// statBufPool holds the read buffers of readStats.
+var statBufPool = sync.Pool{New: func() any { b := make([]byte, 8192); return &b }}
+
+// readStats fills st from the cgroup of id, resolving and caching its
+// directory on first use or when the cached one was removed.
+func (x *RuntimeContext) readStats(id string, st *Stats) error {
+	bp := statBufPool.Get().(*[]byte)
+	defer statBufPool.Put(bp)
+
+	for attempt := 0; attempt < 2; attempt++ {
+		dir, ok := x.cgroups.get(id)
+		if !ok {
+			fd, err := x.openCgroupDir(id)
+			if err != nil {
+				return err
+			}
+			dir = x.cgroups.put(id, fd)
+		}
+		err := readCgroupStats(dir.fd, *bp, st)
+		if err == syscall.ENOENT {
+			// The cgroup was removed (container deleted or re-created)
+			x.cgroups.drop(id, dir)
+		}
+		x.cgroups.release(dir)
+		if err != syscall.ENOENT {
+			return err
+		}
+	}
+	return errors.New("libcrun: cgroup of container " + id + " disappeared")
+}
+
+// exitSnapshotDir is where the child of pid leaves the cgroup counters of
+// its container when libcrun destroys the cgroup (go_crun_exit_snapshot).
+func exitSnapshotDir(stateRoot string, pid int) string {
+	return filepath.Join(stateRoot, ".exit-"+strconv.Itoa(pid))
+}
+
+// loadExitSnapshot reads the counters left in dir as a Stats of container
+// id and removes dir. It returns nil when there are none.
+func loadExitSnapshot(dir, id string) *Stats {
+	fd, err := syscall.Open(dir, syscall.O_RDONLY|syscall.O_DIRECTORY|syscall.O_CLOEXEC, 0)
+	if err != nil {
+		return nil
+	}
+	st := &Stats{ID: id}
+	bp := statBufPool.Get().(*[]byte)
+	err = readCgroupStats(fd, *bp, st)
+	statBufPool.Put(bp)
+	syscall.Close(fd)
+	_ = os.RemoveAll(dir)
+	if err != nil {
+		return nil
+	}
+	return st
+}
+
+// finalStats reads the counters of the cgroup of id, about to be deleted,
+// without caching its directory. It returns nil when they cannot be read.
+func (x *RuntimeContext) finalStats(id string) *Stats {
+	dirfd, err := x.openCgroupDir(id)
+	if err != nil {
+		return nil
+	}
+	defer syscall.Close(dirfd)
+	st := &Stats{ID: id}
+	bp := statBufPool.Get().(*[]byte)
+	defer statBufPool.Put(bp)
+	if readCgroupStats(dirfd, *bp, st) != nil {
+		return nil
+	}
+	return st
+}
+
+func (x *RuntimeContext) openCgroupDir(id string) (int, error) {
+	var state ContainerState
+	var cgroup string
+	if err := x.readState(id, nil, false, &state, &cgroup); err != nil {
+		return -1, err
+	}
+	if cgroup == "" {
+		return -1, errors.New("libcrun: container " + id + " has no cgroup")
+	}
+	fd, err := syscall.Open(filepath.Join(cgroupRoot, cgroup), syscall.O_RDONLY|syscall.O_DIRECTORY|syscall.O_CLOEXEC, 0)
+	if err != nil {
+		return -1, errnoError("cannot open cgroup of container "+id, err)
+	}
+	return fd, nil
+}
+
+// readCgroupStats reads the stat files below dirfd into st. It returns
+// syscall.ENOENT when the directory itself is gone.
+func readCgroupStats(dirfd int, buf []byte, st *Stats) error {
+	// cgroup.controllers exists in every cgroup v2 directory
+	if _, err := readCgroupFile(dirfd, cgControllers, buf); err != nil {
+		if err == syscall.ENOENT {
+			return err
+		}
+		return errors.New("libcrun: cannot read cgroup: " + err.Error())
+	}
+
+	st.CPU = CPUStats{}
+	if b, err := readCgroupFile(dirfd, cgCPUStat, buf); err == nil {
+		forEachKV(b, func(k, v []byte) {
+			switch string(k) {
+			case "usage_usec":
+				st.CPU.UsageUsec = parseUint(v)
+			case "user_usec":
+				st.CPU.UserUsec = parseUint(v)
+			case "system_usec":
+				st.CPU.SystemUsec = parseUint(v)
+			case "nr_periods":
+				st.CPU.NrPeriods = parseUint(v)
+			case "nr_throttled":
+				st.CPU.NrThrottled = parseUint(v)
+			case "throttled_usec":
+				st.CPU.ThrottledUsec = parseUint(v)
+			}
+		})
+	}
+
+	st.Memory = MemoryStats{
+		Current:     readCgroupUint(dirfd, cgMemCurrent, buf),
+		Max:         readCgroupUint(dirfd, cgMemMax, buf),
+		Peak:        readCgroupUint(dirfd, cgMemPeak, buf),
+		SwapCurrent: readCgroupUint(dirfd, cgMemSwap, buf),
+	}
+	if b, err := readCgroupFile(dirfd, cgMemStat, buf); err == nil {
+		forEachKV(b, func(k, v []byte) {
+			switch string(k) {
+			case "anon":
+				st.Memory.Anon = parseUint(v)
+			case "file":
+				st.Memory.File = parseUint(v)
+			case "kernel":
+				st.Memory.Kernel = parseUint(v)
+			case "shmem":
+				st.Memory.Shmem = parseUint(v)
+			case "pgfault":
+				st.Memory.PgFault = parseUint(v)
+			case "pgmajfault":
+				st.Memory.PgMajFault = parseUint(v)
+			}
+		})
+	}
+
+	st.Pids = PidsStats{
+		Current: readCgroupUint(dirfd, cgPidsCurrent, buf),
+		Max:     readCgroupUint(dirfd, cgPidsMax, buf),
+	}
+
+	st.IO = st.IO[:0]
+	if b, err := readCgroupFile(dirfd, cgIOStat, buf); err == nil {
+		st.IO = parseIOStat(b, st.IO)
+	}
+	return nil
+}
+
+// cgroupFile is a NUL-terminated file name, so opening it needs no
+// per-call conversion.
+type cgroupFile []byte
+
+func cgroupName(s string) cgroupFile { return cgroupFile(s + "\x00") }
+
+var (
+	cgControllers = cgroupName("cgroup.controllers")
+	cgCPUStat     = cgroupName("cpu.stat")
+	cgMemCurrent  = cgroupName("memory.current")
+	cgMemMax      = cgroupName("memory.max")
+	cgMemPeak     = cgroupName("memory.peak")
+	cgMemSwap     = cgroupName("memory.swap.current")
+	cgMemStat     = cgroupName("memory.stat")
+	cgPidsCurrent = cgroupName("pids.current")
+	cgPidsMax     = cgroupName("pids.max")
+	cgIOStat      = cgroupName("io.stat")
+)
+
+// readCgroupFile reads name below dirfd into buf and returns the content.
+func readCgroupFile(dirfd int, name cgroupFile, buf []byte) ([]byte, error) {
+	r, _, e := syscall.Syscall6(syscall.SYS_OPENAT, uintptr(dirfd), uintptr(unsafe.Pointer(&name[0])),
+		uintptr(syscall.O_RDONLY|syscall.O_CLOEXEC), 0, 0, 0)
+	if e != 0 {
+		return nil, e
+	}
+	fd := int(r)
+	defer syscall.Close(fd)
+	n := 0
+	for n < len(buf) {
+		m, err := syscall.Pread(fd, buf[n:], int64(n))
+		if err == syscall.EINTR {
+			continue
+		}
+		if err != nil {
+			return nil, err
+		}
+		if m == 0 {
+			break
+		}
+		n += m
+	}
+	return buf[:n], nil
+}
+
+// readCgroupUint reads a single-value file; "max" and missing files read
+// as 0.
+func readCgroupUint(dirfd int, name cgroupFile, buf []byte) uint64 {
+	b, err := readCgroupFile(dirfd, name, buf)
+	if err != nil {
+		return 0
+	}
+	return parseUint(trimSpace(b))
+}
+
+// forEachKV calls fn for every "key value" line of b.
+func forEachKV(b []byte, fn func(k, v []byte)) {
+	for len(b) > 0 {
+		line := b
+		if i := indexByte(b, '\n'); i >= 0 {
+			line, b = b[:i], b[i+1:]
+		} else {
+			b = nil
+		}
+		if i := indexByte(line, ' '); i > 0 {
+			fn(line[:i], trimSpace(line[i+1:]))
+		}
+	}
+}
+
+// parseIOStat parses io.stat lines ("MAJ:MIN rbytes=N wbytes=N ..."),
+// appending to dst.
+func parseIOStat(b []byte, dst []IODeviceStats) []IODeviceStats {
+	for len(b) > 0 {
+		line := b
+		if i := indexByte(b, '\n'); i >= 0 {
+			line, b = b[:i], b[i+1:]
+		} else {
+			b = nil
+		}
+		var dev IODeviceStats
+		first := true
+		for len(line) > 0 {
+			field := line
+			if i := indexByte(line, ' '); i >= 0 {
+				field, line = line[:i], line[i+1:]
+			} else {
+				line = nil
+			}
+			if len(field) == 0 {
+				continue
+			}
+			if first {
+				first = false
+				if i := indexByte(field, ':'); i > 0 {
+					dev.Major = uint32(parseUint(field[:i]))
+					dev.Minor = uint32(parseUint(field[i+1:]))
+				}
+				continue
+			}
+			i := indexByte(field, '=')
+			if i <= 0 {
+				continue
+			}
+			v := parseUint(field[i+1:])
+			switch string(field[:i]) {
+			case "rbytes":
+				dev.RBytes = v
+			case "wbytes":
+				dev.WBytes = v
+			case "rios":
+				dev.RIOs = v
+			case "wios":
+				dev.WIOs = v
+			case "dbytes":
+				dev.DBytes = v
+			case "dios":
+				dev.DIOs = v
+			}
+		}
+		if !first {
+			dst = append(dst, dev)
+		}
+	}
+	return dst
+}
+
+// parseUint parses a decimal number, stopping at the first non-digit
+// ("max" thus reads as 0).
+func parseUint(b []byte) uint64 {
+	var v uint64
+	for _, c := range b {
+		if c < '0' || c > '9' {
+			break
+		}
+		v = v*10 + uint64(c-'0')
+	}
+	return v
+}
+
+func indexByte(b []byte, c byte) int {
+	for i, x := range b {
+		if x == c {
+			return i
+		}
+	}
+	return -1
+}
+
+func trimSpace(b []byte) []byte {
+	for len(b) > 0 && (b[len(b)-1] == '\n' || b[len(b)-1] == ' ') {
+		b = b[:len(b)-1]
+	}
+	for len(b) > 0 && b[0] == ' ' {
+		b = b[1:]
+	}
+	return b
+}
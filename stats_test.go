@@ -0,0 +1,316 @@
+//go:build linux
+
+package crun
+
+import (
+	"os"
+	"path/filepath"
+	"reflect"
+	"sort"
+	"strings"
+	"syscall"
+	"testing"
+	"unsafe"
+)
+
+// writeFakeCgroup creates a cgroup v2 directory below root holding stat
+// files, and points the status of container id at it.
+func writeFakeCgroup(t testing.TB, stateRoot, root, id string) string {
+	t.Helper()
+	dir := filepath.Join(root, "crun", id)
+	if err := os.MkdirAll(dir, 0o755); err != nil {
+		t.Fatalf("MkdirAll failed: %v", err)
+	}
+	files := map[string]string{
+		"cgroup.controllers":  "cpu memory pids io\n",
+		"cpu.stat":            "usage_usec 1500\nuser_usec 1000\nsystem_usec 500\nnr_periods 10\nnr_throttled 2\nthrottled_usec 300\n",
+		"memory.current":      "4096\n",
+		"memory.max":          "max\n",
+		"memory.peak":         "8192\n",
+		"memory.swap.current": "0\n",
+		"memory.stat":         "anon 1024\nfile 2048\nkernel 512\nkernel_stack 64\nshmem 128\npgfault 77\npgmajfault 3\n",
+		"pids.current":        "3\n",
+		"pids.max":            "100\n",
+		"io.stat":             "8:0 rbytes=4096 wbytes=8192 rios=1 wios=2 dbytes=0 dios=0\n253:1 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=5 dios=6\n",
+	}
+	for name, content := range files {
+		if err := os.WriteFile(filepath.Join(dir, name), []byte(content), 0o644); err != nil {
+			t.Fatalf("WriteFile failed: %v", err)
+		}
+	}
+	statusPath := filepath.Join(stateRoot, id, "status")
+	status, err := os.ReadFile(statusPath)
+	if err != nil {
+		t.Fatalf("ReadFile failed: %v", err)
+	}
+	status = []byte(strings.Replace(string(status), `"cgroup-path":""`, `"cgroup-path":"/crun/`+id+`"`, 1))
+	if err := os.WriteFile(statusPath, status, 0o600); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+	return dir
+}
+
+// fakeStatsRoot returns a context with fake containers ids, each with a
+// fake cgroup.
+func fakeStatsRoot(t testing.TB, ids ...string) *RuntimeContext {
+	t.Helper()
+	rc := fakeStateRoot(t, ids...)
+	root := t.TempDir()
+	old := cgroupRoot
+	cgroupRoot = root
+	t.Cleanup(func() { cgroupRoot = old })
+	for _, id := range ids {
+		writeFakeCgroup(t, goStringAt(unsafe.Pointer(rc.c.state_root)), root, id)
+	}
+	return rc
+}
+
+func TestContainerStats(t *testing.T) {
+	rc := fakeStatsRoot(t, "c1")
+	st, err := rc.Get("c1").Stats()
+	if err != nil {
+		t.Fatalf("Stats failed: %v", err)
+	}
+	want := Stats{
+		ID:     "c1",
+		CPU:    CPUStats{UsageUsec: 1500, UserUsec: 1000, SystemUsec: 500, NrPeriods: 10, NrThrottled: 2, ThrottledUsec: 300},
+		Memory: MemoryStats{Current: 4096, Peak: 8192, Anon: 1024, File: 2048, Kernel: 512, Shmem: 128, PgFault: 77, PgMajFault: 3},
+		Pids:   PidsStats{Current: 3, Max: 100},
+	}
+	if st.ID != want.ID || st.CPU != want.CPU || st.Memory != want.Memory || st.Pids != want.Pids {
+		t.Errorf("Stats = %+v, want %+v", *st, want)
+	}
+	wantIO := []IODeviceStats{
+		{Major: 8, Minor: 0, RBytes: 4096, WBytes: 8192, RIOs: 1, WIOs: 2},
+		{Major: 253, Minor: 1, RBytes: 1, WBytes: 2, RIOs: 3, WIOs: 4, DBytes: 5, DIOs: 6},
+	}
+	if len(st.IO) != len(wantIO) {
+		t.Fatalf("IO = %+v, want %+v", st.IO, wantIO)
+	}
+	for i := range wantIO {
+		if st.IO[i] != wantIO[i] {
+			t.Errorf("IO[%d] = %+v, want %+v", i, st.IO[i], wantIO[i])
+		}
+	}
+}
+
+func TestContainerStatsMissingControllers(t *testing.T) {
+	rc := fakeStatsRoot(t, "c1")
+	dir := filepath.Join(cgroupRoot, "crun", "c1")
+	for _, name := range []string{"io.stat", "pids.current", "pids.max", "memory.swap.current"} {
+		os.Remove(filepath.Join(dir, name))
+	}
+	st, err := rc.Get("c1").Stats()
+	if err != nil {
+		t.Fatalf("Stats failed: %v", err)
+	}
+	if st.Pids != (PidsStats{}) || len(st.IO) != 0 {
+		t.Errorf("missing controllers should read as zero, got pids=%+v io=%+v", st.Pids, st.IO)
+	}
+	if st.Memory.Current != 4096 {
+		t.Errorf("Memory.Current = %d, want 4096", st.Memory.Current)
+	}
+}
+
+func TestContainerStatsRecreatedCgroup(t *testing.T) {
+	rc := fakeStatsRoot(t, "c1")
+	ctr := rc.Get("c1")
+	if _, err := ctr.Stats(); err != nil {
+		t.Fatalf("Stats failed: %v", err)
+	}
+	// Replace the cgroup directory; the cached dirfd now points at a
+	// removed directory and must be re-resolved.
+	dir := filepath.Join(cgroupRoot, "crun", "c1")
+	if err := os.RemoveAll(dir); err != nil {
+		t.Fatalf("RemoveAll failed: %v", err)
+	}
+	writeFakeCgroup(t, goStringAt(unsafe.Pointer(rc.c.state_root)), cgroupRoot, "c1")
+	if err := os.WriteFile(filepath.Join(dir, "pids.current"), []byte("9\n"), 0o644); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+	st, err := ctr.Stats()
+	if err != nil {
+		t.Fatalf("Stats after re-creation failed: %v", err)
+	}
+	if st.Pids.Current != 9 {
+		t.Errorf("Pids.Current = %d, want 9 (stale cgroup dirfd)", st.Pids.Current)
+	}
+}
+
+func TestContainerStatsNoCgroup(t *testing.T) {
+	rc := fakeStateRoot(t, "c1")
+	if _, err := rc.Get("c1").Stats(); err == nil {
+		t.Fatal("Stats of a container without cgroup succeeded")
+	}
+}
+
+func TestLoadExitSnapshot(t *testing.T) {
+	rc := fakeStatsRoot(t, "c1")
+	want, err := rc.Get("c1").Stats()
+	if err != nil {
+		t.Fatalf("Stats failed: %v", err)
+	}
+	// The snapshot is a copy of the cgroup's files
+	dir := filepath.Join(cgroupRoot, "crun", "c1")
+	st := loadExitSnapshot(dir, "c1")
+	if !reflect.DeepEqual(st, want) {
+		t.Errorf("loadExitSnapshot = %+v, want %+v", st, want)
+	}
+	if _, err := os.Stat(dir); !os.IsNotExist(err) {
+		t.Errorf("snapshot left behind: %v", err)
+	}
+	if st := loadExitSnapshot(dir, "c1"); st != nil {
+		t.Errorf("loadExitSnapshot of a missing snapshot = %+v", st)
+	}
+}
+
+func TestExitSnapshotDirHidden(t *testing.T) {
+	rc := fakeStateRoot(t, "c1")
+	stateRoot := goStringAt(unsafe.Pointer(rc.c.state_root))
+	dir := exitSnapshotDir(stateRoot, 1234)
+	if err := os.Mkdir(dir, 0o700); err != nil {
+		t.Fatalf("Mkdir failed: %v", err)
+	}
+	ids, err := rc.ListIDs()
+	if err != nil {
+		t.Fatalf("ListIDs failed: %v", err)
+	}
+	if len(ids) != 1 || ids[0] != "c1" {
+		t.Errorf("ListIDs = %v, want [c1]", ids)
+	}
+}
+
+func TestStatsAll(t *testing.T) {
+	rc := fakeStatsRoot(t, "a", "b", "c")
+	writeFakeContainer(t, goStringAt(unsafe.Pointer(rc.c.state_root)), "nocgroup")
+
+	all, err := rc.StatsAll(nil)
+	if err != nil {
+		t.Fatalf("StatsAll failed: %v", err)
+	}
+	var ids []string
+	for _, st := range all {
+		ids = append(ids, st.ID)
+		if st.Memory.Current != 4096 || len(st.IO) != 2 {
+			t.Errorf("%s: unexpected stats %+v", st.ID, st)
+		}
+	}
+	sort.Strings(ids)
+	if strings.Join(ids, ",") != "a,b,c" {
+		t.Errorf("StatsAll ids = %v, want [a b c]", ids)
+	}
+
+	// Deleted containers drop out and their directories are closed.
+	os.RemoveAll(filepath.Join(goStringAt(unsafe.Pointer(rc.c.state_root)), "b"))
+	all, err = rc.StatsAll(all)
+	if err != nil {
+		t.Fatalf("StatsAll failed: %v", err)
+	}
+	if len(all) != 2 {
+		t.Errorf("StatsAll returned %d entries after delete, want 2", len(all))
+	}
+	if _, ok := rc.cgroups.get("b"); ok {
+		t.Error("cgroup dirfd of deleted container still cached")
+	}
+}
+
+func TestStatsAllReuseDoesNotAllocate(t *testing.T) {
+	rc := fakeStatsRoot(t, "a", "b", "c")
+	all, err := rc.StatsAll(nil)
+	if err != nil {
+		t.Fatalf("StatsAll failed: %v", err)
+	}
+	ctr := rc.Get("a")
+	st := &all[0]
+	if n := testing.AllocsPerRun(50, func() { _ = ctr.StatsInto(st) }); n != 0 {
+		t.Errorf("StatsInto allocated %v times per call, want 0", n)
+	}
+}
+
+func TestParseIOStat(t *testing.T) {
+	got := parseIOStat([]byte("8:16 rbytes=10 wbytes=20 rios=1 wios=2 dbytes=0 dios=0\n\n"), nil)
+	if len(got) != 1 || got[0] != (IODeviceStats{Major: 8, Minor: 16, RBytes: 10, WBytes: 20, RIOs: 1, WIOs: 2}) {
+		t.Errorf("parseIOStat = %+v", got)
+	}
+}
+
+func BenchmarkStatsAll(b *testing.B) {
+	ids := fakeIDs(100)
+	rc := fakeStatsRoot(b, ids...)
+	all, err := rc.StatsAll(nil)
+	if err != nil {
+		b.Fatalf("StatsAll failed: %v", err)
+	}
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		all, _ = rc.StatsAll(all)
+	}
+}
+
+func TestCgroupDirsOwnFds(t *testing.T) {
+	open := func() int {
+		fd, err := syscall.Open(t.TempDir(), syscall.O_RDONLY|syscall.O_DIRECTORY|syscall.O_CLOEXEC, 0)
+		if err != nil {
+			t.Fatal(err)
+		}
+		return fd
+	}
+	isOpen := func(fd int) bool {
+		_, err := fdFlags(fd, syscall.F_GETFD)
+		return err == nil
+	}
+	var d cgroupDirs
+
+	// Two first reads racing: the second's fd is closed, the first kept
+	fd1, fd2 := open(), open()
+	e1 := d.put("a", fd1)
+	e2 := d.put("a", fd2)
+	if e1 != e2 || isOpen(fd2) || !isOpen(fd1) {
+		t.Errorf("second put: same entry %v, fd2 open %v, fd1 open %v", e1 == e2, isOpen(fd2), isOpen(fd1))
+	}
+
+	// Dropped, pruned or closed while read: closed on the last release
+	d.drop("a", e1)
+	if !isOpen(fd1) {
+		t.Error("fd closed by drop while held")
+	}
+	d.release(e1)
+	if !isOpen(fd1) {
+		t.Error("fd closed while still held")
+	}
+	d.release(e2)
+	if isOpen(fd1) {
+		t.Error("fd left open after the last release")
+	}
+
+	fd3 := open()
+	d.release(d.put("b", fd3))
+	e3, ok := d.get("b")
+	if !ok {
+		t.Fatal("cached dir not found")
+	}
+	d.prune(map[string]struct{}{})
+	if !isOpen(fd3) {
+		t.Error("fd closed by prune while held")
+	}
+	d.release(e3)
+	if isOpen(fd3) {
+		t.Error("fd left open after prune and release")
+	}
+
+	fd4 := open()
+	d.release(d.put("c", fd4))
+	d.closeAll()
+	if isOpen(fd4) {
+		t.Error("fd left open after closeAll")
+	}
+}
+
+func fdFlags(fd, cmd int) (int, error) {
+	r, _, e := syscall.Syscall(syscall.SYS_FCNTL, uintptr(fd), uintptr(cmd), 0)
+	if e != 0 {
+		return -1, e
+	}
+	return int(r), nil
+}
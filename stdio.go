@@ -0,0 +1,223 @@
+//go:build linux
+
+package crun
+
+import (
+	"io"
+	"net"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"syscall"
+	"unsafe"
+)
+
+// passthroughFile returns a close-on-exec duplicate of the descriptor behind
+// v when the container can use it directly, or nil when v needs a pipe and a
+// copy goroutine.
+//
+// Only *os.File values in blocking mode qualify: regular files, terminals
+// and blocking pipes. Nonblocking descriptors (os.Pipe ends, sockets behind
+// net.Conn) are shared open file descriptions whose O_NONBLOCK flag the
+// container would inherit, so they stay behind a pipe; io.Copy from that
+// pipe then uses splice(2)/sendfile(2) where the kernel supports it.
+func passthroughFile(v any) *os.File {
+	f, ok := v.(*os.File)
+	if !ok || f == nil {
+		return nil
+	}
+	rc, err := f.SyscallConn()
+	if err != nil {
+		return nil
+	}
+	var dup int
+	var dupErr error
+	err = rc.Control(func(fd uintptr) {
+		flags, _, errno := syscall.Syscall(syscall.SYS_FCNTL, fd, syscall.F_GETFL, 0)
+		if errno != 0 {
+			dupErr = errno
+			return
+		}
+		if flags&syscall.O_NONBLOCK != 0 {
+			dupErr = syscall.EAGAIN
+			return
+		}
+		r, _, errno := syscall.Syscall(syscall.SYS_FCNTL, fd, syscall.F_DUPFD_CLOEXEC, 0)
+		if errno != 0 {
+			dupErr = errno
+			return
+		}
+		dup = int(r)
+	})
+	if err != nil || dupErr != nil {
+		return nil
+	}
+	return os.NewFile(uintptr(dup), f.Name())
+}
+
+// Pipe capacity fcntl commands (linux/fcntl.h).
+const (
+	fSetPipeSz = 1031
+	fGetPipeSz = 1032
+)
+
+var (
+	pipeMaxSizeOnce sync.Once
+	pipeMaxSize     int
+)
+
+// maxPipeSize returns /proc/sys/fs/pipe-max-size (0 if unreadable).
+func maxPipeSize() int {
+	pipeMaxSizeOnce.Do(func() {
+		b, err := os.ReadFile("/proc/sys/fs/pipe-max-size")
+		if err != nil {
+			return
+		}
+		pipeMaxSize, _ = strconv.Atoi(strings.TrimSpace(string(b)))
+	})
+	return pipeMaxSize
+}
+
+// setPipeSize resizes the pipe behind fd to size bytes, clamped to the
+// system maximum. Failures are ignored: the pipe keeps its current size.
+func setPipeSize(fd uintptr, size int) {
+	if size <= 0 {
+		return
+	}
+	if max := maxPipeSize(); max > 0 && size > max {
+		size = max
+	}
+	_, _, _ = syscall.Syscall(syscall.SYS_FCNTL, fd, fSetPipeSz, uintptr(size))
+}
+
+// resizePipe applies size to the pipe behind f.
+func resizePipe(f *os.File, size int) {
+	if f == nil || size <= 0 {
+		return
+	}
+	if rc, err := f.SyscallConn(); err == nil {
+		_ = rc.Control(func(fd uintptr) { setPipeSize(fd, size) })
+	}
+}
+
+// IOStats collects stdio counters for a container started with RunWithIO.
+// Set IOConfig.Stats to a zero IOStats to enable it; the counters can be
+// read while the container runs.
+type IOStats struct {
+	StdinBytes  atomic.Int64 // bytes copied into the container's stdin
+	StdoutBytes atomic.Int64 // bytes copied out of the container's stdout
+	StderrBytes atomic.Int64 // bytes copied out of the container's stderr
+
+	// Number of times a pipe was found full: the container was blocked
+	// writing stdout/stderr, or we were blocked writing stdin.
+	StdinFull  atomic.Int64
+	StdoutFull atomic.Int64
+	StderrFull atomic.Int64
+
+	// Number of times IOConfig.OnLines fell QueueLimit lines behind and
+	// reading the container's output waited for it.
+	LinesQueueFull atomic.Int64
+}
+
+// copyBufPool holds the buffers used by copyStream.
+var copyBufPool = sync.Pool{New: func() any { b := make([]byte, 32*1024); return &b }}
+
+// copyStream copies src to dst until EOF or error.
+//
+// pipe is our end of the container's stdio pipe (dst for stdin, src for
+// stdout/stderr). Without counters, endpoints that the kernel can move data
+// between directly (files and sockets) use io.Copy and its splice/sendfile
+// fast paths; everything else goes through a pooled buffer instead of a
+// fresh 32 KiB allocation per stream. With counters, the pooled loop is
+// always used so that a full pipe can be detected before each transfer.
+func copyStream(dst io.Writer, src io.Reader, pipe *os.File, bytes, full *atomic.Int64) {
+	if bytes == nil {
+		if kernelCopyable(dst) || kernelCopyable(src) {
+			_, _ = io.Copy(dst, src)
+			return
+		}
+	}
+
+	var probe pipeProbe
+	if full != nil {
+		probe = newPipeProbe(pipe)
+	}
+
+	bp := copyBufPool.Get().(*[]byte)
+	defer copyBufPool.Put(bp)
+	buf := *bp
+	for {
+		if probe.full() {
+			full.Add(1)
+		}
+		n, rerr := src.Read(buf)
+		if n > 0 {
+			w, werr := dst.Write(buf[:n])
+			if bytes != nil {
+				bytes.Add(int64(w))
+			}
+			if werr != nil {
+				return
+			}
+		}
+		if rerr != nil {
+			return
+		}
+	}
+}
+
+// pipeProbe tells whether a pipe is full. The zero value never is.
+type pipeProbe struct {
+	rc       syscall.RawConn
+	capacity int
+}
+
+func newPipeProbe(pipe *os.File) pipeProbe {
+	var p pipeProbe
+	if c, err := pipe.SyscallConn(); err == nil {
+		p.rc = c
+		_ = p.rc.Control(func(fd uintptr) { p.capacity = fdPipeSize(fd) })
+	}
+	return p
+}
+
+func (p pipeProbe) full() bool {
+	return p.capacity > 0 && pipeQueued(p.rc) >= p.capacity
+}
+
+// kernelCopyable reports whether v is backed by a descriptor io.Copy can
+// splice or sendfile from/to.
+func kernelCopyable(v any) bool {
+	switch v.(type) {
+	case *os.File, net.Conn:
+		return true
+	}
+	return false
+}
+
+// pipeQueued returns the number of bytes queued in the pipe (FIONREAD).
+func pipeQueued(rc syscall.RawConn) int {
+	queued := 0
+	_ = rc.Control(func(fd uintptr) { queued = fdQueued(fd) })
+	return queued
+}
+
+func fdQueued(fd uintptr) int {
+	var n int32
+	_, _, errno := syscall.Syscall(syscall.SYS_IOCTL, fd, syscall.TIOCINQ, uintptr(unsafe.Pointer(&n)))
+	if errno != 0 {
+		return 0
+	}
+	return int(n)
+}
+
+// fdPipeSize returns the capacity of the pipe behind fd, or 0.
+func fdPipeSize(fd uintptr) int {
+	r, _, errno := syscall.Syscall(syscall.SYS_FCNTL, fd, fGetPipeSz, 0)
+	if errno != 0 {
+		return 0
+	}
+	return int(r)
+}
@@ -0,0 +1,235 @@
+//go:build linux
+
+package crun
+
+import (
+	"bytes"
+	"io"
+	"os"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// Stream identifies the container output stream a StreamLine comes from.
+type Stream int
+
+// Output streams.
+const (
+	StreamStdout Stream = 1
+	StreamStderr Stream = 2
+)
+
+// StreamLine is a line of container output delivered to IOConfig.OnLines.
+type StreamLine struct {
+	Stream Stream
+	// Time is when the line was read (it carries a monotonic reading).
+	Time time.Time
+	// Data is the line without its newline. It is only valid during the
+	// OnLines call: the buffer behind it is reused afterwards.
+	Data []byte
+	// Partial is set on a line cut at LineOptions.MaxLine, whose rest
+	// follows, and on output left without a newline when the stream ends.
+	Partial bool
+}
+
+// LineOptions configures the framing of IOConfig.OnLines.
+type LineOptions struct {
+	// MaxLine is the length at which lines are cut. 0 selects 16 KiB;
+	// values above 32 KiB are clamped.
+	MaxLine int
+	// Chunks delivers the output as read, in pieces of at most MaxLine
+	// bytes, instead of splitting it at newlines.
+	Chunks bool
+	// QueueLimit is the number of lines read but not yet delivered at
+	// which reading stops, so that the container blocks writing instead
+	// of buffering growing without bound. 0 selects 1024.
+	QueueLimit int
+	// BatchSize is the largest number of lines passed to one OnLines
+	// call. 0 selects 64.
+	BatchSize int
+}
+
+const (
+	lineBlockSize        = 64 * 1024
+	defaultMaxLine       = 16 * 1024
+	defaultLineQueue     = 1024
+	defaultLineBatchSize = 64
+)
+
+// lineBlock is a pooled read buffer that the lines framed in it point
+// into. It goes back to the pool once the framer has moved on and all its
+// lines are delivered.
+type lineBlock struct {
+	buf  [lineBlockSize]byte
+	refs atomic.Int32
+}
+
+var lineBlockPool = sync.Pool{New: func() any { return new(lineBlock) }}
+
+func getLineBlock() *lineBlock {
+	b := lineBlockPool.Get().(*lineBlock)
+	b.refs.Store(1)
+	return b
+}
+
+func (b *lineBlock) release() {
+	if b.refs.Add(-1) == 0 {
+		lineBlockPool.Put(b)
+	}
+}
+
+type lineRecord struct {
+	block   *lineBlock
+	stream  Stream
+	time    time.Time
+	data    []byte
+	partial bool
+}
+
+// lineSink frames the output streams of one container and delivers the
+// lines from a goroutine of its own, so that a slow consumer only blocks
+// the container once QueueLimit lines are pending.
+type lineSink struct {
+	fn      func([]StreamLine)
+	opts    LineOptions
+	queue   chan lineRecord
+	writers atomic.Int32
+	full    *atomic.Int64
+}
+
+func newLineSink(fn func([]StreamLine), o LineOptions, streams int, full *atomic.Int64) *lineSink {
+	if o.MaxLine <= 0 {
+		o.MaxLine = defaultMaxLine
+	}
+	o.MaxLine = min(o.MaxLine, lineBlockSize/2)
+	if o.QueueLimit <= 0 {
+		o.QueueLimit = defaultLineQueue
+	}
+	if o.BatchSize <= 0 {
+		o.BatchSize = defaultLineBatchSize
+	}
+	s := &lineSink{fn: fn, opts: o, queue: make(chan lineRecord, o.QueueLimit), full: full}
+	s.writers.Store(int32(streams))
+	if streams == 0 {
+		close(s.queue)
+	}
+	return s
+}
+
+// frame reads src until EOF or error, queueing the lines read. pipe is
+// src's descriptor, probed for the IOStats pipe-full counter.
+func (s *lineSink) frame(src io.Reader, stream Stream, pipe *os.File, bytesRead, full *atomic.Int64) {
+	defer func() {
+		if s.writers.Add(-1) == 0 {
+			close(s.queue)
+		}
+	}()
+	var probe pipeProbe
+	if full != nil {
+		probe = newPipeProbe(pipe)
+	}
+	maxLine := s.opts.MaxLine
+	blk := getLineBlock()
+	start, fill := 0, 0 // blk.buf[start:fill] is not queued yet
+	for {
+		if fill == len(blk.buf) {
+			// The unfinished line is shorter than MaxLine, so it leaves
+			// at least half of the next block to read into.
+			next := getLineBlock()
+			fill = copy(next.buf[:], blk.buf[start:fill])
+			start = 0
+			blk.release()
+			blk = next
+		}
+		if probe.full() {
+			full.Add(1)
+		}
+		n, err := src.Read(blk.buf[fill:])
+		if n > 0 {
+			if bytesRead != nil {
+				bytesRead.Add(int64(n))
+			}
+			now := time.Now()
+			scan := fill
+			fill += n
+			if s.opts.Chunks {
+				for start < fill {
+					end := min(fill, start+maxLine)
+					s.emit(blk, stream, now, start, end, false)
+					start = end
+				}
+			} else {
+				for {
+					i := bytes.IndexByte(blk.buf[scan:fill], '\n')
+					if i < 0 {
+						break
+					}
+					for scan+i-start > maxLine {
+						s.emit(blk, stream, now, start, start+maxLine, true)
+						start += maxLine
+					}
+					s.emit(blk, stream, now, start, scan+i, false)
+					start = scan + i + 1
+					scan = start
+				}
+				for fill-start >= maxLine {
+					s.emit(blk, stream, now, start, start+maxLine, true)
+					start += maxLine
+				}
+			}
+		}
+		if err != nil {
+			if start < fill {
+				s.emit(blk, stream, time.Now(), start, fill, true)
+			}
+			blk.release()
+			return
+		}
+	}
+}
+
+func (s *lineSink) emit(blk *lineBlock, stream Stream, t time.Time, start, end int, partial bool) {
+	blk.refs.Add(1)
+	rec := lineRecord{block: blk, stream: stream, time: t, data: blk.buf[start:end:end], partial: partial}
+	select {
+	case s.queue <- rec:
+	default:
+		if s.full != nil {
+			s.full.Add(1)
+		}
+		s.queue <- rec
+	}
+}
+
+// deliver passes the queued lines to the callback in batches until every
+// stream has ended.
+func (s *lineSink) deliver() {
+	recs := make([]lineRecord, 0, s.opts.BatchSize)
+	batch := make([]StreamLine, 0, s.opts.BatchSize)
+	for rec := range s.queue {
+		recs = append(recs[:0], rec)
+	fill:
+		for len(recs) < cap(recs) {
+			select {
+			case rec, ok := <-s.queue:
+				if !ok {
+					break fill
+				}
+				recs = append(recs, rec)
+			default:
+				break fill
+			}
+		}
+		batch = batch[:0]
+		for _, r := range recs {
+			batch = append(batch, StreamLine{Stream: r.stream, Time: r.time, Data: r.data, Partial: r.partial})
+		}
+		s.fn(batch)
+		for i, r := range recs {
+			r.block.release()
+			recs[i] = lineRecord{}
+			batch[i].Data = nil
+		}
+	}
+}
@@ -0,0 +1,175 @@
+//go:build linux
+
+package crun
+
+import (
+	"bytes"
+	"io"
+	"strconv"
+	"strings"
+	"sync/atomic"
+	"testing"
+	"testing/iotest"
+	"time"
+)
+
+type framedLine struct {
+	stream  Stream
+	data    string
+	partial bool
+}
+
+// frameAll frames the readers as stdout and stderr and returns the lines
+// delivered.
+func frameAll(t *testing.T, o LineOptions, stdout, stderr io.Reader) []framedLine {
+	t.Helper()
+	var got []framedLine
+	last := map[Stream]time.Time{}
+	maxBatch := o.BatchSize
+	if maxBatch == 0 {
+		maxBatch = defaultLineBatchSize
+	}
+	readers := []io.Reader{stdout, stderr}
+	streams := 0
+	for _, r := range readers {
+		if r != nil {
+			streams++
+		}
+	}
+	s := newLineSink(func(lines []StreamLine) {
+		if len(lines) == 0 || len(lines) > maxBatch {
+			t.Errorf("batch of %d lines", len(lines))
+		}
+		for _, l := range lines {
+			if l.Time.Before(last[l.Stream]) {
+				t.Errorf("line %q stamped before the previous one", l.Data)
+			}
+			last[l.Stream] = l.Time
+			got = append(got, framedLine{l.Stream, string(l.Data), l.Partial})
+		}
+	}, o, streams, nil)
+	for i, r := range readers {
+		if r != nil {
+			go s.frame(r, Stream(i+1), nil, nil, nil)
+		}
+	}
+	s.deliver()
+	return got
+}
+
+func TestLineSinkFramesLines(t *testing.T) {
+	long := strings.Repeat("x", 40000)
+	got := frameAll(t, LineOptions{}, strings.NewReader("a\n\nbb\n"+long+"\ntail"), nil)
+	want := []framedLine{
+		{StreamStdout, "a", false},
+		{StreamStdout, "", false},
+		{StreamStdout, "bb", false},
+		{StreamStdout, long[:16384], true},
+		{StreamStdout, long[16384:32768], true},
+		{StreamStdout, long[32768:], false},
+		{StreamStdout, "tail", true},
+	}
+	if len(got) != len(want) {
+		t.Fatalf("got %d lines, want %d", len(got), len(want))
+	}
+	for i := range want {
+		if got[i] != want[i] {
+			t.Errorf("line %d = %.20q (partial %v), want %.20q (partial %v)", i, got[i].data, got[i].partial, want[i].data, want[i].partial)
+		}
+	}
+}
+
+func TestLineSinkAcrossBlocks(t *testing.T) {
+	var in bytes.Buffer
+	for i := 0; i < 20000; i++ {
+		in.WriteString("line-" + strconv.Itoa(i) + "\n")
+	}
+	stderr := iotest.HalfReader(strings.NewReader("err-0\nerr-1\n"))
+	got := frameAll(t, LineOptions{QueueLimit: 8, BatchSize: 3}, iotest.HalfReader(&in), stderr)
+
+	next := map[Stream]int{}
+	for _, l := range got {
+		prefix := "line-"
+		if l.stream == StreamStderr {
+			prefix = "err-"
+		}
+		if want := prefix + strconv.Itoa(next[l.stream]); l.data != want || l.partial {
+			t.Fatalf("stream %d line = %q, want %q", l.stream, l.data, want)
+		}
+		next[l.stream]++
+	}
+	if next[StreamStdout] != 20000 || next[StreamStderr] != 2 {
+		t.Errorf("got %d stdout and %d stderr lines", next[StreamStdout], next[StreamStderr])
+	}
+}
+
+func TestLineSinkChunks(t *testing.T) {
+	got := frameAll(t, LineOptions{Chunks: true, MaxLine: 4}, iotest.OneByteReader(strings.NewReader("ab\ncd")), nil)
+	var joined strings.Builder
+	for _, l := range got {
+		if len(l.data) != 1 || l.partial {
+			t.Errorf("chunk %q (partial %v), want the single byte read", l.data, l.partial)
+		}
+		joined.WriteString(l.data)
+	}
+	if joined.String() != "ab\ncd" {
+		t.Errorf("chunks = %q", joined.String())
+	}
+}
+
+func TestLineSinkBackpressure(t *testing.T) {
+	release := make(chan struct{})
+	var delivered atomic.Int32
+	var queueFull atomic.Int64
+	s := newLineSink(func(lines []StreamLine) {
+		<-release
+		delivered.Add(int32(len(lines)))
+	}, LineOptions{QueueLimit: 2, BatchSize: 1}, 1, &queueFull)
+	done := make(chan struct{})
+	go func() {
+		defer close(done)
+		s.frame(strings.NewReader(strings.Repeat("l\n", 10)), StreamStdout, nil, nil, nil)
+	}()
+	go s.deliver()
+
+	waitFor(t, "reading to wait for the consumer", func() bool { return queueFull.Load() > 0 })
+	select {
+	case <-done:
+		t.Fatal("framing finished with the consumer stalled")
+	default:
+	}
+	close(release)
+	<-done
+	waitFor(t, "delivery", func() bool { return delivered.Load() == 10 })
+}
+
+func TestLineSinkAllocations(t *testing.T) {
+	var payload bytes.Buffer
+	for payload.Len() < 1<<20 {
+		payload.WriteString("a fairly ordinary line of container output\n")
+	}
+	lines := 0
+	allocs := testing.AllocsPerRun(10, func() {
+		s := newLineSink(func(l []StreamLine) { lines += len(l) }, LineOptions{}, 1, nil)
+		go s.frame(bytes.NewReader(payload.Bytes()), StreamStdout, nil, nil, nil)
+		s.deliver()
+	})
+	// the sink, its queue and batches, the goroutine: nothing per line
+	if allocs > 50 {
+		t.Errorf("%.0f allocations framing %d lines", allocs, lines/11)
+	}
+}
+
+func BenchmarkLineSink(b *testing.B) {
+	var payload bytes.Buffer
+	for payload.Len() < 1<<20 {
+		payload.WriteString("a fairly ordinary line of container output\n")
+	}
+	b.SetBytes(int64(payload.Len()))
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		s := newLineSink(func([]StreamLine) {}, LineOptions{}, 1, nil)
+		go s.frame(bytes.NewReader(payload.Bytes()), StreamStdout, nil, nil, nil)
+		s.deliver()
+	}
+}
@@ -0,0 +1,160 @@
+//go:build linux
+
+package crun
+
+import (
+	"bytes"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync/atomic"
+	"syscall"
+	"testing"
+	"time"
+)
+
+func TestPassthroughFileRegularFile(t *testing.T) {
+	f, err := os.Create(filepath.Join(t.TempDir(), "out"))
+	if err != nil {
+		t.Fatalf("Create failed: %v", err)
+	}
+	defer f.Close()
+
+	dup := passthroughFile(f)
+	if dup == nil {
+		t.Fatal("regular file should be passed through")
+	}
+	defer dup.Close()
+	if dup.Fd() == f.Fd() {
+		t.Error("passthrough should return a duplicate descriptor")
+	}
+
+	// Writes through the duplicate land in the original file
+	if _, err := dup.WriteString("hello"); err != nil {
+		t.Fatalf("write through duplicate failed: %v", err)
+	}
+	got, _ := os.ReadFile(f.Name())
+	if string(got) != "hello" {
+		t.Errorf("file content = %q, want %q", got, "hello")
+	}
+}
+
+func TestPassthroughFileRejects(t *testing.T) {
+	// os.Pipe ends are nonblocking and must keep going through a pipe
+	r, w, err := os.Pipe()
+	if err != nil {
+		t.Fatalf("Pipe failed: %v", err)
+	}
+	defer r.Close()
+	defer w.Close()
+	if f := passthroughFile(w); f != nil {
+		f.Close()
+		t.Error("nonblocking pipe should not be passed through")
+	}
+
+	if f := passthroughFile(&bytes.Buffer{}); f != nil {
+		t.Error("non-file writer should not be passed through")
+	}
+	var nilFile *os.File
+	if f := passthroughFile(nilFile); f != nil {
+		t.Error("nil file should not be passed through")
+	}
+}
+
+func pipeCapacity(t *testing.T, f *os.File) int {
+	t.Helper()
+	r, _, errno := syscall.Syscall(syscall.SYS_FCNTL, f.Fd(), fGetPipeSz, 0)
+	if errno != 0 {
+		t.Fatalf("F_GETPIPE_SZ failed: %v", errno)
+	}
+	return int(r)
+}
+
+func TestResizePipe(t *testing.T) {
+	r, w, err := os.Pipe()
+	if err != nil {
+		t.Fatalf("Pipe failed: %v", err)
+	}
+	defer r.Close()
+	defer w.Close()
+
+	resizePipe(w, 256*1024)
+	if got := pipeCapacity(t, w); got < 256*1024 && got != maxPipeSize() {
+		t.Errorf("pipe capacity = %d, want 256 KiB", got)
+	}
+
+	// Requests above the system maximum are clamped rather than failing
+	max := maxPipeSize()
+	if max <= 0 {
+		t.Skip("pipe-max-size not readable")
+	}
+	resizePipe(r, max*4)
+	if got := pipeCapacity(t, r); got != max {
+		t.Errorf("pipe capacity = %d, want clamped to %d", got, max)
+	}
+}
+
+func TestCopyStreamCounts(t *testing.T) {
+	r, w, err := os.Pipe()
+	if err != nil {
+		t.Fatalf("Pipe failed: %v", err)
+	}
+	payload := strings.Repeat("x", 100*1024)
+	go func() {
+		_, _ = w.WriteString(payload)
+		w.Close()
+	}()
+
+	var out bytes.Buffer
+	var n, full atomic.Int64
+	copyStream(&out, r, r, &n, &full)
+	r.Close()
+	if out.String() != payload {
+		t.Errorf("copied %d bytes, want %d", out.Len(), len(payload))
+	}
+	if n.Load() != int64(len(payload)) {
+		t.Errorf("byte counter = %d, want %d", n.Load(), len(payload))
+	}
+}
+
+func TestCopyStreamDetectsFullPipe(t *testing.T) {
+	r, w, err := os.Pipe()
+	if err != nil {
+		t.Fatalf("Pipe failed: %v", err)
+	}
+	defer r.Close()
+
+	// Fill the pipe completely before the copier starts reading
+	capacity := pipeCapacity(t, w)
+	done := make(chan struct{})
+	go func() {
+		defer close(done)
+		_, _ = w.Write(make([]byte, capacity))
+		w.Close()
+	}()
+	deadline := time.Now().Add(5 * time.Second)
+	rc, _ := r.SyscallConn()
+	for pipeQueued(rc) < capacity && time.Now().Before(deadline) {
+		time.Sleep(time.Millisecond)
+	}
+
+	var out bytes.Buffer
+	var n, full atomic.Int64
+	copyStream(&out, r, r, &n, &full)
+	<-done
+	if full.Load() == 0 {
+		t.Error("full pipe was not detected")
+	}
+	if n.Load() != int64(capacity) {
+		t.Errorf("byte counter = %d, want %d", n.Load(), capacity)
+	}
+}
+
+func BenchmarkCopyStream(b *testing.B) {
+	payload := bytes.Repeat([]byte("x"), 4096)
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		var out bytes.Buffer
+		copyStream(&out, bytes.NewReader(payload), nil, nil, nil)
+	}
+}
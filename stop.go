@@ -0,0 +1,239 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"bytes"
+	"context"
+	"errors"
+	"os"
+	"path/filepath"
+	"syscall"
+	"time"
+)
+
+// StopResult reports how Container.Stop went.
+type StopResult struct {
+	// Duration is the time from the stop signal until the container's
+	// processes were seen to exit.
+	Duration time.Duration
+	// Killed is set when the processes outlived the grace period, or ctx,
+	// and were sent SIGKILL.
+	Killed bool
+}
+
+// stopPollInterval paces the status checks of Stop when neither a pidfd
+// nor cgroup.events can report the exit.
+const stopPollInterval = 10 * time.Millisecond
+
+// Stop stops the container gracefully: it sends SIGTERM to the init
+// process, waits up to grace for the container's processes to exit, then
+// sends SIGKILL to all of them (KillAll, through cgroup.kill when
+// available) and waits for them to exit. A grace of 0 or less kills them
+// at once. When ctx is done first, the processes are sent SIGKILL, and Stop
+// returns ctx.Err() without waiting further.
+//
+// The exit is observed as it happens, not polled: through a pidfd of the
+// init process, then, on cgroup v2, cgroup.events reporting the cgroup
+// unpopulated (processes outside the container's pid namespace may outlive
+// its init). Stopping a container that is not running returns a zero
+// StopResult. The container is not deleted.
+//
+// An init process without a SIGTERM handler ignores the signal, as pid 1
+// of its namespace, and so does a paused container: both are stopped by
+// SIGKILL once grace runs out.
+func (c *Container) Stop(ctx context.Context, grace time.Duration) (StopResult, error) {
+	x := c.runtime
+	if x == nil || x.c == nil {
+		return StopResult{}, errors.New("libcrun: invalid runtime context")
+	}
+	var st ContainerState
+	var cgroup string
+	if err := x.readState(c.ID, c.ref(), false, &st, &cgroup); err != nil {
+		return StopResult{}, err
+	}
+	if st.Status == StatusStopped || st.Pid <= 0 {
+		return StopResult{}, nil
+	}
+	w := newExitWaiter(st.Pid, cgroup)
+	defer w.close()
+	// The pid may have been reused before the pidfd was opened
+	if running, err := c.IsRunning(); err != nil || !running {
+		return StopResult{}, err
+	}
+
+	start := time.Now()
+	var res StopResult
+	exited := false
+	if grace > 0 {
+		if err := c.Kill(SIGTERM); err != nil {
+			if !w.exited() {
+				return res, err
+			}
+			exited = true
+		}
+		if !exited {
+			graceCtx, cancel := context.WithTimeout(ctx, grace)
+			exited = w.wait(graceCtx, c)
+			cancel()
+		}
+	}
+	if !exited {
+		res.Killed = true
+		if err := x.killAllFast(c.ID, SIGKILL); err != nil && !w.exited() {
+			return res, err
+		}
+		if err := ctx.Err(); err != nil {
+			res.Duration = time.Since(start)
+			return res, err
+		}
+		if !w.wait(ctx, c) {
+			res.Duration = time.Since(start)
+			return res, ctx.Err()
+		}
+	}
+	res.Duration = time.Since(start)
+	return res, nil
+}
+
+// exitWaiter waits for the processes of a container to exit.
+type exitWaiter struct {
+	pidfd  *os.File // of the init process, nil without pidfds
+	events string   // cgroup.events of the container, "" without cgroup v2
+}
+
+func newExitWaiter(pid int, cgroup string) *exitWaiter {
+	w := &exitWaiter{}
+	if fd := int(C.go_crun_pidfd_open(C.pid_t(pid))); fd >= 0 {
+		// A non-blocking descriptor makes os.NewFile register it with the
+		// netpoller
+		if err := syscall.SetNonblock(fd, true); err != nil {
+			syscall.Close(fd)
+		} else {
+			w.pidfd = os.NewFile(uintptr(fd), "pidfd")
+		}
+	}
+	if cgroup != "" {
+		events := filepath.Join(cgroupRoot, cgroup, "cgroup.events")
+		if _, err := os.Stat(events); err == nil {
+			w.events = events
+		}
+	}
+	return w
+}
+
+func (w *exitWaiter) close() {
+	if w.pidfd != nil {
+		w.pidfd.Close()
+	}
+}
+
+// exited reports, without blocking, whether the processes have exited.
+func (w *exitWaiter) exited() bool {
+	if w.pidfd != nil && !w.initExited() {
+		return false
+	}
+	if w.events != "" {
+		return !cgroupPopulated(w.events)
+	}
+	return w.pidfd != nil
+}
+
+func (w *exitWaiter) initExited() bool {
+	rawConn, err := w.pidfd.SyscallConn()
+	if err != nil {
+		return true
+	}
+	exited := false
+	_ = rawConn.Control(func(fd uintptr) { exited = C.go_crun_pidfd_exited(C.int(fd)) == 1 })
+	return exited
+}
+
+// wait blocks until the processes have exited, and reports whether they
+// did before ctx was done. Without a pidfd or cgroup.events, it polls the
+// status of c.
+func (w *exitWaiter) wait(ctx context.Context, c *Container) bool {
+	if w.pidfd == nil && w.events == "" {
+		for {
+			if running, err := c.IsRunning(); err != nil || !running {
+				return true
+			}
+			select {
+			case <-ctx.Done():
+				return false
+			case <-time.After(stopPollInterval):
+			}
+		}
+	}
+	if w.pidfd != nil && !waitReadable(ctx, w.pidfd, func(fd uintptr) bool {
+		return C.go_crun_pidfd_exited(C.int(fd)) == 1
+	}) {
+		return false
+	}
+	if w.events != "" {
+		return waitUnpopulated(ctx, w.events)
+	}
+	return true
+}
+
+// waitReadable parks on f in the netpoller until ready reports true, or
+// ctx is done (false).
+func waitReadable(ctx context.Context, f *os.File, ready func(fd uintptr) bool) bool {
+	rawConn, err := f.SyscallConn()
+	if err != nil {
+		return true // closed
+	}
+	_ = f.SetReadDeadline(time.Time{})
+	stop := context.AfterFunc(ctx, func() { _ = f.SetReadDeadline(time.Unix(1, 0)) })
+	defer stop()
+	return rawConn.Read(ready) == nil
+}
+
+// waitUnpopulated waits for cgroup.events at path to report no process
+// left in the cgroup (or the cgroup to be removed), using inotify: the
+// kernel signals a change of the file as a modification.
+func waitUnpopulated(ctx context.Context, path string) bool {
+	fd, err := syscall.InotifyInit1(syscall.IN_NONBLOCK | syscall.IN_CLOEXEC)
+	if err != nil {
+		return !cgroupPopulated(path) // cannot watch: report what is known
+	}
+	ino := os.NewFile(uintptr(fd), "inotify")
+	defer ino.Close()
+	if _, err := syscall.InotifyAddWatch(fd, path, syscall.IN_MODIFY|syscall.IN_DELETE_SELF|syscall.IN_IGNORED); err != nil {
+		return true // the cgroup is gone
+	}
+	var buf [4096]byte
+	return waitReadable(ctx, ino, func(fd uintptr) bool {
+		// Drain the events before checking, so that a change after the
+		// check wakes the next park
+		for {
+			_, err := syscall.Read(int(fd), buf[:])
+			if err == syscall.EAGAIN {
+				break
+			}
+			if err != nil && err != syscall.EINTR {
+				return true
+			}
+		}
+		return !cgroupPopulated(path)
+	})
+}
+
+// cgroupPopulated reports whether cgroup.events at path lists processes in
+// the cgroup or its descendants; a cgroup that is gone has none.
+func cgroupPopulated(path string) bool {
+	b, err := os.ReadFile(path)
+	if err != nil {
+		return false
+	}
+	for _, line := range bytes.Split(b, []byte("\n")) {
+		if v, ok := bytes.CutPrefix(line, []byte("populated ")); ok {
+			return string(v) != "0"
+		}
+	}
+	return false
+}
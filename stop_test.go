@@ -0,0 +1,85 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"context"
+	"os"
+	"path/filepath"
+	"syscall"
+	"testing"
+	"time"
+)
+
+func TestCgroupPopulated(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "cgroup.events")
+	for content, want := range map[string]bool{
+		"populated 1\nfrozen 0\n": true,
+		"populated 0\nfrozen 0\n": false,
+		"frozen 0\n":              false,
+	} {
+		os.WriteFile(path, []byte(content), 0o644)
+		if got := cgroupPopulated(path); got != want {
+			t.Errorf("cgroupPopulated(%q) = %v, want %v", content, got, want)
+		}
+	}
+	if cgroupPopulated(filepath.Join(t.TempDir(), "missing")) {
+		t.Error("a missing cgroup is populated")
+	}
+}
+
+func TestWaitUnpopulated(t *testing.T) {
+	path := filepath.Join(t.TempDir(), "cgroup.events")
+	os.WriteFile(path, []byte("populated 1\nfrozen 0\n"), 0o644)
+
+	ctx, cancel := context.WithTimeout(context.Background(), 20*time.Millisecond)
+	defer cancel()
+	if waitUnpopulated(ctx, path) {
+		t.Fatal("waitUnpopulated returned while populated")
+	}
+
+	done := make(chan bool, 1)
+	go func() { done <- waitUnpopulated(context.Background(), path) }()
+	time.Sleep(20 * time.Millisecond)
+	os.WriteFile(path, []byte("populated 0\nfrozen 0\n"), 0o644)
+	select {
+	case ok := <-done:
+		if !ok {
+			t.Error("waitUnpopulated = false")
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("waitUnpopulated missed the change")
+	}
+}
+
+func TestExitWaiter(t *testing.T) {
+	pid := startChild(t, "sleep 30")
+	w := newExitWaiter(pid, "")
+	defer w.close()
+	if w.pidfd == nil {
+		syscall.Kill(pid, syscall.SIGKILL)
+		newChildWaiter(pid).wait()
+		t.Skip("pidfds not supported")
+	}
+	if w.exited() {
+		t.Fatal("exited before the kill")
+	}
+	ctx, cancel := context.WithTimeout(context.Background(), 20*time.Millisecond)
+	defer cancel()
+	if w.wait(ctx, nil) {
+		t.Fatal("wait returned before the kill")
+	}
+
+	start := time.Now()
+	go func() {
+		time.Sleep(20 * time.Millisecond)
+		syscall.Kill(pid, syscall.SIGKILL)
+	}()
+	if !w.wait(context.Background(), nil) || !w.exited() {
+		t.Error("wait did not observe the exit")
+	}
+	if d := time.Since(start); d > 5*time.Second {
+		t.Errorf("wait took %v", d)
+	}
+	newChildWaiter(pid).wait()
+}
@@ -0,0 +1,61 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"os"
+	"strings"
+	"unsafe"
+)
+
+// PrepareSlices starts the systemd slice units the context's containers
+// are to be placed in (cgroupsPath "<slice>:<prefix>:<name>", see
+// WithCgroupsPath), e.g. one per tenant, so that creating a container
+// only adds a scope to a running slice rather than having systemd load
+// and start the slice too. The calls are pipelined over one connection,
+// and slices that exist already are left alone. Nested slices follow
+// systemd's naming ("tenant-a-web.slice" is in "tenant-a.slice").
+//
+// It needs RuntimeConfig.SystemdCgroup. The slices are transient: they
+// stay until stopped, or until systemd restarts.
+func (x *RuntimeContext) PrepareSlices(slices ...string) error {
+	if x == nil || x.c == nil {
+		return errors.New("libcrun: invalid runtime context")
+	}
+	if !bool(x.c.systemd_cgroup) {
+		return errors.New("libcrun: PrepareSlices needs RuntimeConfig.SystemdCgroup")
+	}
+	if len(slices) == 0 {
+		return nil
+	}
+	for _, s := range slices {
+		if !strings.HasSuffix(s, ".slice") || len(s) == len(".slice") || strings.ContainsAny(s, "/:") {
+			return errors.New("libcrun: invalid slice name " + s)
+		}
+	}
+	names := C.malloc(C.size_t(len(slices)) * C.size_t(unsafe.Sizeof((*C.char)(nil))))
+	defer C.free(names)
+	cnames := unsafe.Slice((**C.char)(names), len(slices))
+	for i, s := range slices {
+		cnames[i] = C.CString(s)
+		defer C.free(unsafe.Pointer(cnames[i]))
+	}
+	// libcrun talks to the user's systemd when rootless
+	user := C.int(0)
+	if os.Geteuid() != 0 {
+		user = 1
+	}
+	var err C.libcrun_error_t
+	if x.onWorker(func() C.int {
+		return C.go_crun_systemd_start_slices((**C.char)(names), C.int(len(slices)), user, &err)
+	}) < 0 {
+		return fromLibcrunErr(&err)
+	}
+	return nil
+}
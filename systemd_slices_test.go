@@ -0,0 +1,60 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"os"
+	"testing"
+)
+
+func TestPrepareSlicesValidation(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+	if err := rc.PrepareSlices("tenant-a.slice"); err == nil {
+		t.Error("PrepareSlices without SystemdCgroup succeeded")
+	}
+
+	sd, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir(), SystemdCgroup: true})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer sd.Close()
+	if err := sd.PrepareSlices(); err != nil {
+		t.Errorf("PrepareSlices of nothing failed: %v", err)
+	}
+	for _, name := range []string{"tenant-a", ".slice", "a/b.slice", "a:b.slice"} {
+		if err := sd.PrepareSlices(name); err == nil {
+			t.Errorf("PrepareSlices(%q) succeeded", name)
+		}
+	}
+}
+
+func TestPrepareSlices(t *testing.T) {
+	if os.Geteuid() != 0 {
+		t.Skip("needs root")
+	}
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir(), SystemdCgroup: true})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+	if _, err := os.Stat("/run/systemd/system"); err != nil {
+		if _, err := os.Stat("/run/dbus/system_bus_socket"); err == nil {
+			t.Skip("a system bus without systemd")
+		}
+		if err := rc.PrepareSlices("libcrun-go-test.slice"); err == nil {
+			t.Error("PrepareSlices without systemd succeeded")
+		}
+		return
+	}
+	slices := []string{"libcrun-go-test.slice", "libcrun-go-test-a.slice", "libcrun-go-test-b.slice"}
+	if err := rc.PrepareSlices(slices...); err != nil {
+		t.Fatalf("PrepareSlices failed: %v", err)
+	}
+	if err := rc.PrepareSlices(slices...); err != nil {
+		t.Errorf("PrepareSlices of existing slices failed: %v", err)
+	}
+}
@@ -0,0 +1,58 @@
+//go:build linux
+
+package crun
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+	"unsafe"
+)
+
+func TestDeleteMany(t *testing.T) {
+	ids := fakeIDs(20)
+	rc := fakeStateRoot(t, ids...)
+	root := goStringAt(unsafe.Pointer(rc.c.state_root))
+
+	errs := rc.DeleteMany(append(ids, "missing"), TeardownOptions{Workers: 4})
+	if len(errs) != len(ids)+1 {
+		t.Fatalf("got %d results, want %d", len(errs), len(ids)+1)
+	}
+	for i, id := range ids {
+		if errs[i] != nil {
+			t.Errorf("DeleteMany(%s) failed: %v", id, errs[i])
+		}
+		if _, err := os.Stat(filepath.Join(root, id)); !os.IsNotExist(err) {
+			t.Errorf("state directory of %s still present", id)
+		}
+	}
+	// As with Delete(true), a container that is already gone is not an error
+	if want := rc.Get("missing").Delete(true); (errs[len(ids)] == nil) != (want == nil) {
+		t.Errorf("DeleteMany(missing) = %v, Delete(true) = %v", errs[len(ids)], want)
+	}
+}
+
+func TestKillAllManyCgroupKill(t *testing.T) {
+	rc := fakeStatsRoot(t, "a", "b")
+	for _, id := range []string{"a", "b"} {
+		os.WriteFile(filepath.Join(cgroupRoot, "crun", id, "cgroup.kill"), nil, 0o644)
+	}
+	errs := rc.KillAllMany([]string{"a", "b"}, SIGKILL, TeardownOptions{Workers: 2})
+	for i, id := range []string{"a", "b"} {
+		if errs[i] != nil {
+			t.Errorf("KillAllMany(%s) failed: %v", id, errs[i])
+		}
+		b, _ := os.ReadFile(filepath.Join(cgroupRoot, "crun", id, "cgroup.kill"))
+		if string(b) != "1" {
+			t.Errorf("cgroup.kill of %s = %q, want \"1\"", id, b)
+		}
+	}
+}
+
+func TestIsSigKill(t *testing.T) {
+	for sig, want := range map[Signal]bool{SIGKILL: true, "KILL": true, "9": true, "sigkill": true, SIGTERM: false, "15": false} {
+		if got := isSigKill(sig); got != want {
+			t.Errorf("isSigKill(%q) = %v, want %v", sig, got, want)
+		}
+	}
+}
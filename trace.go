@@ -0,0 +1,101 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"errors"
+	"time"
+)
+
+// TraceOp names a traced RuntimeContext operation.
+type TraceOp string
+
+// Traced operations.
+const (
+	OpCreate  TraceOp = "create"
+	OpStart   TraceOp = "start"
+	OpRun     TraceOp = "run" // Run, or RunWithIO up to the child handshake
+	OpKill    TraceOp = "kill"
+	OpKillAll TraceOp = "killall"
+	OpDelete  TraceOp = "delete"
+	OpState   TraceOp = "state"
+	OpExec    TraceOp = "exec" // Exec, or ExecWithIO up to the child handshake
+	OpUpdate  TraceOp = "update"
+	OpPause   TraceOp = "pause"
+	OpUnpause TraceOp = "unpause"
+	OpWait    TraceOp = "wait" // RunResult.Wait
+)
+
+// TraceEvent describes a finished operation.
+type TraceEvent struct {
+	Op       TraceOp
+	ID       string // container id
+	Start    time.Time
+	Duration time.Duration
+	Err      error     // nil on success
+	Code     ErrorCode // classification of Err; ErrUnknown when Err is not an *Error
+}
+
+// Tracer observes the libcrun operations of a RuntimeContext, e.g. to
+// export them as spans or latency metrics.
+//
+// OpStart is called when an operation begins; the value it returns is
+// passed back to OpEnd when the operation finishes. Both are called on
+// the goroutine running the operation and must be safe for concurrent
+// use.
+type Tracer interface {
+	OpStart(op TraceOp, id string) any
+	OpEnd(state any, ev TraceEvent)
+}
+
+// tracerBox lets a Tracer interface live in an atomic.Pointer.
+type tracerBox struct{ t Tracer }
+
+// SetTracer installs t to observe this context's operations; nil removes
+// it. Without a tracer, the instrumentation costs one atomic load per
+// operation.
+func (x *RuntimeContext) SetTracer(t Tracer) {
+	if x == nil {
+		return
+	}
+	if t == nil {
+		x.tracer.Store(nil)
+		return
+	}
+	x.tracer.Store(&tracerBox{t: t})
+}
+
+// traceSpan is one operation in flight; the zero value (no tracer) does
+// nothing.
+type traceSpan struct {
+	t     Tracer
+	state any
+	op    TraceOp
+	id    string
+	start time.Time
+}
+
+// trace begins op on container id. Use it as
+// defer x.trace(op, id).end(&err) with a named error result.
+func (x *RuntimeContext) trace(op TraceOp, id string) traceSpan {
+	if x == nil {
+		return traceSpan{}
+	}
+	b := x.tracer.Load()
+	if b == nil {
+		return traceSpan{}
+	}
+	return traceSpan{t: b.t, state: b.t.OpStart(op, id), op: op, id: id, start: time.Now()}
+}
+
+func (s traceSpan) end(err *error) {
+	if s.t == nil {
+		return
+	}
+	ev := TraceEvent{Op: s.op, ID: s.id, Start: s.start, Duration: time.Since(s.start), Err: *err}
+	var e *Error
+	if errors.As(ev.Err, &e) {
+		ev.Code = e.Code
+	}
+	s.t.OpEnd(s.state, ev)
+}
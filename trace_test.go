@@ -0,0 +1,90 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"errors"
+	"sync"
+	"testing"
+)
+
+type recordingTracer struct {
+	mu     sync.Mutex
+	starts []TraceOp
+	events []TraceEvent
+}
+
+func (r *recordingTracer) OpStart(op TraceOp, id string) any {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	r.starts = append(r.starts, op)
+	return len(r.starts)
+}
+
+func (r *recordingTracer) OpEnd(state any, ev TraceEvent) {
+	r.mu.Lock()
+	defer r.mu.Unlock()
+	if state != len(r.starts) {
+		panic("OpEnd got another operation's state")
+	}
+	r.events = append(r.events, ev)
+}
+
+func TestTracer(t *testing.T) {
+	rc := fakeStateRoot(t, "c1")
+	tr := &recordingTracer{}
+	rc.SetTracer(tr)
+
+	if _, _, err := rc.Get("c1").Status(); err != nil {
+		t.Fatalf("Status failed: %v", err)
+	}
+	startErr := rc.Get("missing").Start()
+	if startErr == nil {
+		t.Fatal("Start of a missing container succeeded")
+	}
+
+	if len(tr.events) != 2 {
+		t.Fatalf("got %d events, want 2: %+v", len(tr.events), tr.events)
+	}
+	st := tr.events[0]
+	if st.Op != OpState || st.ID != "c1" || st.Err != nil || st.Start.IsZero() || st.Duration <= 0 {
+		t.Errorf("state event = %+v", st)
+	}
+	start := tr.events[1]
+	var e *Error
+	if start.Op != OpStart || start.ID != "missing" || start.Err != startErr {
+		t.Errorf("start event = %+v", start)
+	}
+	if errors.As(startErr, &e) && start.Code != e.Code {
+		t.Errorf("start event code = %v, want %v", start.Code, e.Code)
+	}
+
+	rc.SetTracer(nil)
+	_, _, _ = rc.Get("c1").Status()
+	if len(tr.events) != 2 {
+		t.Errorf("events recorded after SetTracer(nil)")
+	}
+}
+
+func BenchmarkStatusTraced(b *testing.B) {
+	rc := fakeStateRoot(b, "c1")
+	ctr := rc.Get("c1")
+	for _, traced := range []bool{false, true} {
+		name := "off"
+		if traced {
+			name = "on"
+			rc.SetTracer(&discardTracer{})
+		}
+		b.Run(name, func(b *testing.B) {
+			b.ReportAllocs()
+			for i := 0; i < b.N; i++ {
+				_, _, _ = ctr.Status()
+			}
+		})
+	}
+}
+
+type discardTracer struct{}
+
+func (discardTracer) OpStart(TraceOp, string) any { return nil }
+func (discardTracer) OpEnd(any, TraceEvent)       {}
@@ -0,0 +1,292 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"errors"
+	"io"
+	"net"
+	"os"
+	"os/signal"
+	"path/filepath"
+	"sync"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// defaultTTYTimeout bounds the wait for the container's terminal.
+const defaultTTYTimeout = 10 * time.Second
+
+// TTYConfig configures RunWithTTY.
+type TTYConfig struct {
+	// Stdin, if set, is copied to the terminal. Wait does not wait for the
+	// copy, which ends when Stdin does.
+	Stdin io.Reader
+	// Stdout, if set, receives the output of the terminal, until every
+	// process in the container has closed it.
+	Stdout io.Writer
+	// Engine, if set, relays the output from its event loops instead of a
+	// goroutine.
+	Engine *IOEngine
+
+	// Terminal, if set, is the local terminal whose window size the
+	// container's follows, initially and on SIGWINCH, until Wait returns.
+	// Putting it in raw mode is up to the caller.
+	Terminal *os.File
+	// Rows and Cols set the initial window size when Terminal is nil.
+	Rows, Cols uint16
+
+	// Timeout bounds the wait for the container to hand over its
+	// terminal. 0 selects 10 seconds.
+	Timeout time.Duration
+}
+
+// TTYResult is the result of RunWithTTY.
+type TTYResult struct {
+	Container *Container
+	// PTY is the master side of the container's terminal, in non-blocking
+	// mode so that reads and writes park on the Go netpoller. It is the
+	// caller's to close, after Wait.
+	PTY *os.File
+	// Wait blocks until the container exits and the output relay, if any,
+	// ends, and returns the exit code.
+	Wait func() (int, error)
+}
+
+// RunWithTTY creates and starts the container with a pseudo-terminal, as
+// RunWithIO does with pipes. The spec must have process.terminal set
+// (WithContainerTTY(true)). The console socket that libcrun hands the
+// PTY master over is managed internally, whatever RuntimeConfig's.
+//
+//	res, err := rc.RunWithTTY(id, spec, crun.TTYConfig{
+//	    Stdin: os.Stdin, Stdout: os.Stdout, Terminal: os.Stdin,
+//	})
+//	...
+//	code, err := res.Wait()
+//	res.PTY.Close()
+func (x *RuntimeContext) RunWithTTY(id string, spec *ContainerSpec, cfg TTYConfig) (*TTYResult, error) {
+	if x == nil || x.c == nil || spec == nil || spec.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context or container spec")
+	}
+	if p := spec.c.container_def.process; p == nil || !bool(p.terminal) {
+		return nil, errors.New("libcrun: RunWithTTY needs a spec with process.terminal set")
+	}
+	timeout := cfg.Timeout
+	if timeout <= 0 {
+		timeout = defaultTTYTimeout
+	}
+	if cfg.Terminal != nil {
+		var ws winsize
+		if err := winsizeIoctl(cfg.Terminal, syscall.TIOCGWINSZ, &ws); err != nil {
+			return nil, err // not a terminal
+		}
+	}
+
+	dir, err := os.MkdirTemp("", "libcrun-tty-")
+	if err != nil {
+		return nil, err
+	}
+	defer os.RemoveAll(dir)
+	ln, err := net.ListenUnix("unix", &net.UnixAddr{Name: filepath.Join(dir, "console.sock"), Net: "unix"})
+	if err != nil {
+		return nil, err
+	}
+	defer ln.Close()
+
+	res, err := x.runWithIO(id, spec, nil, &IOConfig{consoleSocket: ln.Addr().String()})
+	if err != nil {
+		return nil, err
+	}
+	var code int
+	var waitErr error
+	exited := make(chan struct{})
+	go func() {
+		code, waitErr = res.Wait()
+		close(exited)
+	}()
+
+	pty, err := acceptPTY(ln, exited, timeout)
+	if err != nil {
+		_ = res.Container.Kill(SIGKILL)
+		return nil, err
+	}
+	if cfg.Terminal != nil {
+		_ = copyWinsize(pty, cfg.Terminal)
+	} else if cfg.Rows != 0 || cfg.Cols != 0 {
+		_ = setWinsize(pty, cfg.Rows, cfg.Cols)
+	}
+
+	var relay sync.WaitGroup
+	if cfg.Stdout != nil {
+		out, err := dupFile(pty)
+		if err != nil {
+			pty.Close()
+			_ = res.Container.Kill(SIGKILL)
+			return nil, err
+		}
+		relay.Add(1)
+		if cfg.Engine == nil || cfg.Engine.addOutput(out, cfg.Stdout, nil, nil, relay.Done) != nil {
+			go func() {
+				defer relay.Done()
+				defer out.Close()
+				copyStream(cfg.Stdout, out, out, nil, nil)
+			}()
+		}
+	}
+	if cfg.Stdin != nil {
+		go copyStream(pty, cfg.Stdin, pty, nil, nil)
+	}
+	if cfg.Terminal != nil {
+		winch := make(chan os.Signal, 1)
+		signal.Notify(winch, syscall.SIGWINCH)
+		go func() {
+			defer signal.Stop(winch)
+			for {
+				select {
+				case <-winch:
+					_ = copyWinsize(pty, cfg.Terminal)
+				case <-exited:
+					return
+				}
+			}
+		}()
+	}
+
+	return &TTYResult{
+		Container: res.Container,
+		PTY:       pty,
+		Wait: func() (int, error) {
+			<-exited
+			relay.Wait()
+			return code, waitErr
+		},
+	}, nil
+}
+
+// Resize sets the window size of the container's terminal.
+func (r *TTYResult) Resize(rows, cols uint16) error {
+	return setWinsize(r.PTY, rows, cols)
+}
+
+// acceptPTY receives the PTY master libcrun sends over the console socket
+// ln, unless the container exits first or timeout passes.
+func acceptPTY(ln *net.UnixListener, exited <-chan struct{}, timeout time.Duration) (*os.File, error) {
+	type accepted struct {
+		f   *os.File
+		err error
+	}
+	ch := make(chan accepted, 1)
+	go func() {
+		f, err := receivePTY(ln)
+		ch <- accepted{f, err}
+	}()
+	select {
+	case a := <-ch:
+		return a.f, a.err
+	case <-exited:
+	case <-time.After(timeout):
+	}
+	ln.Close() // unblocks receivePTY
+	if a := <-ch; a.err == nil {
+		return a.f, nil // raced with the exit: the caller waits for it anyway
+	}
+	select {
+	case <-exited:
+		return nil, errors.New("libcrun: container exited before handing over its terminal")
+	default:
+		return nil, errors.New("libcrun: timed out waiting for the container's terminal")
+	}
+}
+
+func receivePTY(ln *net.UnixListener) (*os.File, error) {
+	conn, err := ln.AcceptUnix()
+	if err != nil {
+		return nil, err
+	}
+	defer conn.Close()
+	buf := make([]byte, 1)
+	oob := make([]byte, syscall.CmsgSpace(4))
+	_, oobn, _, _, err := conn.ReadMsgUnix(buf, oob)
+	if err != nil {
+		return nil, err
+	}
+	msgs, err := syscall.ParseSocketControlMessage(oob[:oobn])
+	if err != nil {
+		return nil, err
+	}
+	for _, m := range msgs {
+		fds, err := syscall.ParseUnixRights(&m)
+		if err != nil || len(fds) == 0 {
+			continue
+		}
+		for _, fd := range fds[1:] {
+			syscall.Close(fd)
+		}
+		syscall.CloseOnExec(fds[0])
+		// A non-blocking descriptor makes os.NewFile register it with the
+		// netpoller
+		if err := syscall.SetNonblock(fds[0], true); err != nil {
+			syscall.Close(fds[0])
+			return nil, os.NewSyscallError("fcntl", err)
+		}
+		return os.NewFile(uintptr(fds[0]), "pty-master"), nil
+	}
+	return nil, errors.New("libcrun: console socket message carries no descriptor")
+}
+
+// dupFile returns a close-on-exec duplicate of f, which shares its open
+// file description (and non-blocking mode).
+func dupFile(f *os.File) (*os.File, error) {
+	rc, err := f.SyscallConn()
+	if err != nil {
+		return nil, err
+	}
+	dup := -1
+	var dupErr error
+	_ = rc.Control(func(fd uintptr) {
+		r, _, errno := syscall.Syscall(syscall.SYS_FCNTL, fd, syscall.F_DUPFD_CLOEXEC, 0)
+		if errno != 0 {
+			dupErr = os.NewSyscallError("fcntl", errno)
+			return
+		}
+		dup = int(r)
+	})
+	if dupErr != nil {
+		return nil, dupErr
+	}
+	return os.NewFile(uintptr(dup), f.Name()), nil
+}
+
+// winsize is struct winsize of TIOCGWINSZ/TIOCSWINSZ.
+type winsize struct {
+	Row, Col, Xpixel, Ypixel uint16
+}
+
+func winsizeIoctl(f *os.File, req uintptr, ws *winsize) error {
+	rc, err := f.SyscallConn()
+	if err != nil {
+		return err
+	}
+	var errno syscall.Errno
+	_ = rc.Control(func(fd uintptr) {
+		_, _, errno = syscall.Syscall(syscall.SYS_IOCTL, fd, req, uintptr(unsafe.Pointer(ws)))
+	})
+	if errno != 0 {
+		return os.NewSyscallError("ioctl", errno)
+	}
+	return nil
+}
+
+func setWinsize(pty *os.File, rows, cols uint16) error {
+	return winsizeIoctl(pty, syscall.TIOCSWINSZ, &winsize{Row: rows, Col: cols})
+}
+
+// copyWinsize gives pty the window size of the terminal term.
+func copyWinsize(pty, term *os.File) error {
+	var ws winsize
+	if err := winsizeIoctl(term, syscall.TIOCGWINSZ, &ws); err != nil {
+		return err
+	}
+	return winsizeIoctl(pty, syscall.TIOCSWINSZ, &ws)
+}
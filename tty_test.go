@@ -0,0 +1,115 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"net"
+	"os"
+	"path/filepath"
+	"syscall"
+	"testing"
+)
+
+func TestRunWithTTYNeedsTerminal(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+	spec, err := NewSpec(false, WithRootPath(t.TempDir()), WithContainerTTY(false))
+	if err != nil {
+		t.Fatalf("NewSpec failed: %v", err)
+	}
+	defer spec.Close()
+
+	if _, err := rc.RunWithTTY("tty", spec, TTYConfig{}); err == nil {
+		t.Error("RunWithTTY accepted a spec without process.terminal")
+	}
+	var nilRC *RuntimeContext
+	if _, err := nilRC.RunWithTTY("tty", spec, TTYConfig{}); err == nil {
+		t.Error("RunWithTTY on a nil context succeeded")
+	}
+}
+
+func openTestPTY(t *testing.T) *os.File {
+	t.Helper()
+	f, err := os.OpenFile("/dev/ptmx", os.O_RDWR, 0)
+	if err != nil {
+		t.Skipf("no pseudo-terminals: %v", err)
+	}
+	t.Cleanup(func() { f.Close() })
+	return f
+}
+
+func TestWinsize(t *testing.T) {
+	pty := openTestPTY(t)
+	if err := setWinsize(pty, 40, 132); err != nil {
+		t.Fatalf("setWinsize failed: %v", err)
+	}
+	other := openTestPTY(t)
+	if err := copyWinsize(other, pty); err != nil {
+		t.Fatalf("copyWinsize failed: %v", err)
+	}
+	var ws winsize
+	if err := winsizeIoctl(other, syscall.TIOCGWINSZ, &ws); err != nil || ws.Row != 40 || ws.Col != 132 {
+		t.Errorf("window size = %dx%d (%v), want 40x132", ws.Row, ws.Col, err)
+	}
+
+	r, w, _ := os.Pipe()
+	defer r.Close()
+	defer w.Close()
+	if err := copyWinsize(pty, r); err == nil {
+		t.Error("copyWinsize from a pipe succeeded")
+	}
+}
+
+func TestReceivePTY(t *testing.T) {
+	pty := openTestPTY(t)
+	ln, err := net.ListenUnix("unix", &net.UnixAddr{Name: filepath.Join(t.TempDir(), "console.sock"), Net: "unix"})
+	if err != nil {
+		t.Fatalf("ListenUnix failed: %v", err)
+	}
+	defer ln.Close()
+	fd := int(pty.Fd())
+	sent := make(chan struct{})
+	defer func() { <-sent }()
+	go func() {
+		defer close(sent)
+		conn, err := net.DialUnix("unix", nil, ln.Addr().(*net.UnixAddr))
+		if err != nil {
+			return
+		}
+		defer conn.Close()
+		_, _, _ = conn.WriteMsgUnix([]byte{0}, syscall.UnixRights(fd), nil)
+	}()
+
+	exited := make(chan struct{})
+	got, err := acceptPTY(ln, exited, defaultTTYTimeout)
+	if err != nil {
+		t.Fatalf("acceptPTY failed: %v", err)
+	}
+	defer got.Close()
+	// The received descriptor is the same terminal, now non-blocking
+	if err := setWinsize(got, 10, 20); err != nil {
+		t.Fatalf("setWinsize failed: %v", err)
+	}
+	var ws winsize
+	if err := winsizeIoctl(pty, syscall.TIOCGWINSZ, &ws); err != nil || ws.Row != 10 || ws.Col != 20 {
+		t.Errorf("window size = %dx%d (%v), want 10x20", ws.Row, ws.Col, err)
+	}
+	if _, err := got.SyscallConn(); err != nil {
+		t.Errorf("SyscallConn failed: %v", err)
+	}
+}
+
+func TestAcceptPTYExited(t *testing.T) {
+	ln, err := net.ListenUnix("unix", &net.UnixAddr{Name: filepath.Join(t.TempDir(), "console.sock"), Net: "unix"})
+	if err != nil {
+		t.Fatalf("ListenUnix failed: %v", err)
+	}
+	exited := make(chan struct{})
+	close(exited)
+	if _, err := acceptPTY(ln, exited, defaultTTYTimeout); err == nil {
+		t.Error("acceptPTY succeeded without a terminal")
+	}
+}
@@ -89,3 +89,15 @@ func TestContainerStateUnmarshal(t *testing.T) {
 	}
 }
 
+func BenchmarkContainerStateUnmarshal(b *testing.B) {
+	data := []byte(`{"ociVersion":"1.0.0","id":"test-container","status":"running","pid":1234,` +
+		`"bundle":"/var/lib/containers/test","annotations":{"key":"value"},"created":"2024-01-15T10:30:00Z"}`)
+	b.ReportAllocs()
+	b.SetBytes(int64(len(data)))
+	for i := 0; i < b.N; i++ {
+		var state ContainerState
+		if err := json.Unmarshal(data, &state); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
@@ -0,0 +1,342 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include <stdlib.h>
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"strconv"
+	"sync"
+	"unsafe"
+)
+
+// ResourceUpdate is a typed, partial update of a container's resources for
+// Container.Update. Nil fields are left unchanged.
+type ResourceUpdate struct {
+	CPUShares          *uint64
+	CPUQuota           *int64
+	CPUPeriod          *uint64
+	CPURealtimeRuntime *int64
+	CPURealtimePeriod  *uint64
+	CPUs               *string // cpuset, e.g. "0-3"
+	Mems               *string // cpuset memory nodes
+	MemoryLimit        *int64
+	MemoryReservation  *int64
+	MemorySwap         *int64
+	PidsLimit          *int64
+	BlockIOWeight      *uint16
+}
+
+// updateKnob identifies one section/name pair of
+// libcrun_container_update_from_values.
+type updateKnob int
+
+const (
+	knobCPUShares updateKnob = iota
+	knobCPUQuota
+	knobCPUPeriod
+	knobCPURealtimeRuntime
+	knobCPURealtimePeriod
+	knobCPUs
+	knobMems
+	knobMemoryLimit
+	knobMemoryReservation
+	knobMemorySwap
+	knobPidsLimit
+	knobBlockIOWeight
+	numUpdateKnobs
+)
+
+// updateKnobNames maps each knob to the linux.resources section and key
+// libcrun writes it to; the C strings live for the life of the process.
+var updateKnobNames = func() (names [numUpdateKnobs]struct {
+	section, name *C.char
+	numeric       bool
+}) {
+	for k, n := range [numUpdateKnobs]struct {
+		section, name string
+		numeric       bool
+	}{
+		knobCPUShares:          {"cpu", "shares", true},
+		knobCPUQuota:           {"cpu", "quota", true},
+		knobCPUPeriod:          {"cpu", "period", true},
+		knobCPURealtimeRuntime: {"cpu", "realtimeRuntime", true},
+		knobCPURealtimePeriod:  {"cpu", "realtimePeriod", true},
+		knobCPUs:               {"cpu", "cpus", false},
+		knobMems:               {"cpu", "mems", false},
+		knobMemoryLimit:        {"memory", "limit", true},
+		knobMemoryReservation:  {"memory", "reservation", true},
+		knobMemorySwap:         {"memory", "swap", true},
+		knobPidsLimit:          {"pids", "limit", true},
+		knobBlockIOWeight:      {"blockIO", "weight", true},
+	} {
+		names[k].section = C.CString(n.section)
+		names[k].name = C.CString(n.name)
+		names[k].numeric = n.numeric
+	}
+	return names
+}()
+
+// resourceValues holds one formatted value per knob; set marks the knobs
+// that carry a value.
+type resourceValues struct {
+	set [numUpdateKnobs]bool
+	val [numUpdateKnobs]string
+}
+
+func (v *resourceValues) put(k updateKnob, s string) {
+	v.set[k] = true
+	v.val[k] = s
+}
+
+func (u *ResourceUpdate) values() resourceValues {
+	var v resourceValues
+	if u.CPUShares != nil {
+		v.put(knobCPUShares, strconv.FormatUint(*u.CPUShares, 10))
+	}
+	if u.CPUQuota != nil {
+		v.put(knobCPUQuota, strconv.FormatInt(*u.CPUQuota, 10))
+	}
+	if u.CPUPeriod != nil {
+		v.put(knobCPUPeriod, strconv.FormatUint(*u.CPUPeriod, 10))
+	}
+	if u.CPURealtimeRuntime != nil {
+		v.put(knobCPURealtimeRuntime, strconv.FormatInt(*u.CPURealtimeRuntime, 10))
+	}
+	if u.CPURealtimePeriod != nil {
+		v.put(knobCPURealtimePeriod, strconv.FormatUint(*u.CPURealtimePeriod, 10))
+	}
+	if u.CPUs != nil {
+		v.put(knobCPUs, *u.CPUs)
+	}
+	if u.Mems != nil {
+		v.put(knobMems, *u.Mems)
+	}
+	if u.MemoryLimit != nil {
+		v.put(knobMemoryLimit, strconv.FormatInt(*u.MemoryLimit, 10))
+	}
+	if u.MemoryReservation != nil {
+		v.put(knobMemoryReservation, strconv.FormatInt(*u.MemoryReservation, 10))
+	}
+	if u.MemorySwap != nil {
+		v.put(knobMemorySwap, strconv.FormatInt(*u.MemorySwap, 10))
+	}
+	if u.PidsLimit != nil {
+		v.put(knobPidsLimit, strconv.FormatInt(*u.PidsLimit, 10))
+	}
+	if u.BlockIOWeight != nil {
+		v.put(knobBlockIOWeight, strconv.FormatUint(uint64(*u.BlockIOWeight), 10))
+	}
+	return v
+}
+
+// resourceCache remembers the values last applied through a Container
+// handle, so that Update only writes the knobs that change.
+type resourceCache struct {
+	mu      sync.Mutex
+	applied resourceValues
+}
+
+// diff returns the knobs of want that differ from the applied values.
+func (r *resourceCache) diff(want *resourceValues) resourceValues {
+	var d resourceValues
+	for k := range want.set {
+		if want.set[k] && (!r.applied.set[k] || r.applied.val[k] != want.val[k]) {
+			d.put(updateKnob(k), want.val[k])
+		}
+	}
+	return d
+}
+
+func (r *resourceCache) merge(d *resourceValues) {
+	for k := range d.set {
+		if d.set[k] {
+			r.applied.put(updateKnob(k), d.val[k])
+		}
+	}
+}
+
+func (r *resourceCache) reset() {
+	r.mu.Lock()
+	r.applied = resourceValues{}
+	r.mu.Unlock()
+}
+
+// count returns the number of knobs set in v.
+func (v *resourceValues) count() int {
+	n := 0
+	for _, s := range v.set {
+		if s {
+			n++
+		}
+	}
+	return n
+}
+
+// fill writes the knobs of v into dst, which has room for v.count()
+// entries, allocating the value strings in C memory; freeUpdateValues
+// releases them.
+func (v *resourceValues) fill(dst []C.struct_libcrun_update_value_s) {
+	i := 0
+	for k := range v.set {
+		if !v.set[k] {
+			continue
+		}
+		n := &updateKnobNames[k]
+		dst[i] = C.struct_libcrun_update_value_s{
+			section: n.section,
+			name:    n.name,
+			numeric: C.bool(n.numeric),
+			value:   C.CString(v.val[k]),
+		}
+		i++
+	}
+}
+
+func freeUpdateValues(vals []C.struct_libcrun_update_value_s) {
+	for i := range vals {
+		C.free(unsafe.Pointer(vals[i].value))
+	}
+}
+
+// Update applies the non-nil fields of u to the container's resources
+// through libcrun_container_update_from_values, without a JSON round trip
+// on the Go side.
+//
+// The handle remembers the values it last applied and only writes the
+// knobs that change; an update that changes nothing returns without
+// calling into libcrun. Changes made through other handles or
+// UpdateResources are not seen by this cache (UpdateResources on the same
+// handle clears it).
+func (c *Container) Update(u ResourceUpdate) (rerr error) {
+	if c.runtime == nil || c.runtime.c == nil {
+		return errors.New("libcrun: invalid runtime context")
+	}
+	want := u.values()
+	c.res.mu.Lock()
+	defer c.res.mu.Unlock()
+	d := c.res.diff(&want)
+	n := d.count()
+	if n == 0 {
+		return nil
+	}
+
+	defer c.runtime.trace(OpUpdate, c.ID).end(&rerr)
+	var buf [numUpdateKnobs]C.struct_libcrun_update_value_s
+	vals := buf[:n]
+	d.fill(vals)
+	defer freeUpdateValues(vals)
+	r := c.ref()
+	cid := r.cidFor(c.ID)
+	defer r.release(cid)
+
+	var err C.libcrun_error_t
+	logged := c.runtime.beginLog(cid)
+	rc := C.go_crun_update_values(c.runtime.c, cid, &vals[0], C.size_t(n), &err)
+	endLog(logged)
+	if rc < 0 {
+		return fromLibcrunErr(&err)
+	}
+	c.res.merge(&d)
+	return nil
+}
+
+// ResourceUpdateItem is one container updated by UpdateMany.
+type ResourceUpdateItem struct {
+	Container *Container
+	Update    ResourceUpdate
+}
+
+// UpdateMany applies each item's update like Container.Update, in a single
+// cgo call, and returns one error per item (nil on success), in the order
+// of items. Items that change nothing are skipped; a failing item does not
+// stop the others. Each Container must belong to x.
+func (x *RuntimeContext) UpdateMany(items []ResourceUpdateItem) []error {
+	errs := make([]error, len(items))
+	if len(items) == 0 {
+		return errs
+	}
+	if x == nil || x.c == nil {
+		for i := range errs {
+			errs[i] = errors.New("libcrun: invalid runtime context")
+		}
+		return errs
+	}
+
+	diffs := make([]resourceValues, len(items))
+	var total int
+	for i := range items {
+		ctr := items[i].Container
+		if ctr == nil || ctr.runtime != x {
+			errs[i] = errors.New("libcrun: container does not belong to this runtime context")
+			continue
+		}
+		want := items[i].Update.values()
+		ctr.res.mu.Lock()
+		diffs[i] = ctr.res.diff(&want)
+		ctr.res.mu.Unlock()
+		total += diffs[i].count()
+	}
+	if total == 0 {
+		return errs
+	}
+
+	// The items reference the value arrays, so those live in C memory.
+	cvals := (*C.struct_libcrun_update_value_s)(C.calloc(C.size_t(total), C.sizeof_struct_libcrun_update_value_s))
+	if cvals == nil {
+		for i := range errs {
+			if errs[i] == nil && diffs[i].count() > 0 {
+				errs[i] = errors.New("libcrun: cannot allocate update values")
+			}
+		}
+		return errs
+	}
+	all := unsafe.Slice(cvals, total)
+	defer C.free(unsafe.Pointer(cvals))
+	defer freeUpdateValues(all)
+
+	cItems := make([]C.struct_go_crun_update_item, 0, len(items))
+	index := make([]int, 0, len(items)) // cItems position -> items position
+	off := 0
+	for i := range items {
+		n := diffs[i].count()
+		if errs[i] != nil || n == 0 {
+			continue
+		}
+		vals := all[off : off+n]
+		diffs[i].fill(vals)
+		off += n
+		cItems = append(cItems, C.struct_go_crun_update_item{
+			id:     C.CString(items[i].Container.ID),
+			values: &vals[0],
+			len:    C.size_t(n),
+		})
+		index = append(index, i)
+	}
+
+	var route C.int
+	logged := x.beginLog(nil)
+	if logged {
+		route = 1
+	}
+	C.go_crun_update_batch(x.c, &cItems[0], C.int(len(cItems)), route)
+	endLog(logged)
+
+	for k := range cItems {
+		i := index[k]
+		C.free(unsafe.Pointer(cItems[k].id))
+		if cItems[k].err != nil {
+			errs[i] = fromLibcrunErr(&cItems[k].err)
+			continue
+		}
+		ctr := items[i].Container
+		ctr.res.mu.Lock()
+		ctr.res.merge(&diffs[i])
+		ctr.res.mu.Unlock()
+	}
+	return errs
+}
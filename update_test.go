@@ -0,0 +1,127 @@
+//go:build linux && cgo
+
+package crun
+
+import "testing"
+
+func TestResourceUpdateValues(t *testing.T) {
+	shares, limit, weight, cpus := uint64(512), int64(-1), uint16(100), "0-1"
+	v := (&ResourceUpdate{CPUShares: &shares, MemoryLimit: &limit, BlockIOWeight: &weight, CPUs: &cpus}).values()
+
+	want := map[updateKnob]string{
+		knobCPUShares:     "512",
+		knobMemoryLimit:   "-1",
+		knobBlockIOWeight: "100",
+		knobCPUs:          "0-1",
+	}
+	if v.count() != len(want) {
+		t.Errorf("count = %d, want %d", v.count(), len(want))
+	}
+	for k, s := range want {
+		if !v.set[k] || v.val[k] != s {
+			t.Errorf("knob %d = %v %q, want %q", k, v.set[k], v.val[k], s)
+		}
+	}
+}
+
+func TestResourceCacheDiff(t *testing.T) {
+	var r resourceCache
+	quota, period := int64(50000), uint64(100000)
+	u := ResourceUpdate{CPUQuota: &quota, CPUPeriod: &period}
+	want := u.values()
+
+	d := r.diff(&want)
+	if d.count() != 2 {
+		t.Fatalf("first diff has %d knobs, want 2", d.count())
+	}
+	r.merge(&d)
+	if d = r.diff(&want); d.count() != 0 {
+		t.Errorf("diff after merge has %d knobs, want 0", d.count())
+	}
+
+	quota = 25000
+	want = u.values()
+	d = r.diff(&want)
+	if d.count() != 1 || !d.set[knobCPUQuota] || d.val[knobCPUQuota] != "25000" {
+		t.Errorf("diff = %+v, want only the quota", d)
+	}
+
+	r.reset()
+	if d = r.diff(&want); d.count() != 2 {
+		t.Errorf("diff after reset has %d knobs, want 2", d.count())
+	}
+}
+
+func TestUpdateUnchangedSkipsLibcrun(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+
+	pids := int64(64)
+	u := ResourceUpdate{PidsLimit: &pids}
+	ctr := rc.Get("missing")
+	if err := ctr.Update(u); err == nil {
+		t.Fatal("Update of a missing container succeeded")
+	}
+	// A failed update is not cached
+	if ctr.res.applied.count() != 0 {
+		t.Errorf("failed update was cached")
+	}
+
+	want := u.values()
+	ctr.res.merge(&want)
+	if err := ctr.Update(u); err != nil {
+		t.Errorf("unchanged Update = %v, want nil without calling libcrun", err)
+	}
+	if err := ctr.Update(ResourceUpdate{}); err != nil {
+		t.Errorf("empty Update = %v", err)
+	}
+}
+
+func TestUpdateMany(t *testing.T) {
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+	other, err := NewRuntimeContext(RuntimeConfig{StateRoot: t.TempDir()})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer other.Close()
+
+	if errs := rc.UpdateMany(nil); len(errs) != 0 {
+		t.Errorf("UpdateMany(nil) returned %d errors", len(errs))
+	}
+
+	limit := int64(1 << 20)
+	u := ResourceUpdate{MemoryLimit: &limit}
+	cached := rc.Get("cached")
+	want := u.values()
+	cached.res.merge(&want)
+
+	errs := rc.UpdateMany([]ResourceUpdateItem{
+		{Container: rc.Get("a"), Update: u},
+		{Container: cached, Update: u},
+		{Container: other.Get("b"), Update: u},
+		{Container: nil, Update: u},
+		{Container: rc.Get("c"), Update: u},
+	})
+	if len(errs) != 5 {
+		t.Fatalf("got %d errors, want 5", len(errs))
+	}
+	for i, wantErr := range []bool{true, false, true, true, true} {
+		if (errs[i] != nil) != wantErr {
+			t.Errorf("item %d: err = %v, want error %v", i, errs[i], wantErr)
+		}
+	}
+
+	var nilRC *RuntimeContext
+	for i, err := range nilRC.UpdateMany([]ResourceUpdateItem{{Update: u}}) {
+		if err == nil {
+			t.Errorf("nil context item %d: want error", i)
+		}
+	}
+}
@@ -0,0 +1,210 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"errors"
+	"os"
+	"strconv"
+	"strings"
+	"sync/atomic"
+	"syscall"
+	"unsafe"
+)
+
+// childWaiter reaps a container child started by RunWithIO.
+//
+// When the kernel supports pidfds, waiting parks the goroutine on the pidfd
+// through the Go netpoller instead of blocking an OS thread in waitpid, so
+// the number of threads stays flat however many containers are running.
+// With the process-wide reaper enabled (EnableReaper), the reaper collects
+// the exit and wait receives it.
+type childWaiter struct {
+	pid     C.pid_t
+	pidfd   *os.File     // nil when pidfds are unavailable
+	central *reaperChild // set when the reaper collects the exit
+	reaped  atomic.Bool
+	usage   atomic.Pointer[syscall.Rusage] // set once reaped
+	handoff chan childHandoff              // set by handOff
+}
+
+// childHandoff is what the child of a handOff left behind: the process
+// that replaces it, or its own exit when there is none.
+type childHandoff struct {
+	next *childWaiter
+	code int
+	err  error
+}
+
+// newChildWaiter prepares to wait for pid, which must be a child of this
+// process that nobody else reaps.
+func newChildWaiter(pid int) *childWaiter {
+	if r := processReaper.Load(); r != nil {
+		return &childWaiter{pid: C.pid_t(pid), central: r.add(pid)}
+	}
+	w := &childWaiter{pid: C.pid_t(pid)}
+	fd := int(C.go_crun_pidfd_open(w.pid))
+	if fd < 0 {
+		return w
+	}
+	// A nonblocking fd makes os.NewFile register it with the netpoller
+	if err := syscall.SetNonblock(fd, true); err != nil {
+		syscall.Close(fd)
+		return w
+	}
+	w.pidfd = os.NewFile(uintptr(fd), "pidfd")
+	return w
+}
+
+// handOff makes wait follow, in place of the child, the process whose pid
+// next returns once the child exited with code 0: the container init a
+// child started detached, reparented to this process (see
+// IOConfig.DetachChild). A goroutine waits for the child, so that the init
+// is registered with the reaper as soon as the child is gone; it ends
+// there. Call handOff before wait.
+func (w *childWaiter) handOff(next func() (int, error)) {
+	w.handoff = make(chan childHandoff, 1)
+	go func() {
+		code, err := w.waitChild()
+		h := childHandoff{code: code, err: err}
+		if err == nil && code == 0 {
+			var pid int
+			if pid, h.err = next(); h.err == nil {
+				h.next = newChildWaiter(pid)
+			}
+		}
+		w.handoff <- h
+	}()
+}
+
+// wait blocks until the child exits, or the process it handed off to
+// (handOff), and returns its exit code (128+signal when killed by a
+// signal).
+func (w *childWaiter) wait() (int, error) {
+	if w.handoff == nil {
+		return w.waitChild()
+	}
+	h, ok := <-w.handoff
+	if !ok {
+		return -1, errors.New("libcrun: container already waited for")
+	}
+	close(w.handoff)
+	if h.err != nil {
+		return -1, h.err
+	}
+	if h.next == nil {
+		return h.code, nil
+	}
+	code, err := h.next.wait()
+	if u := h.next.usage.Load(); u != nil {
+		w.usage.Store(u)
+	}
+	return code, err
+}
+
+// waitChild is wait for the child itself.
+func (w *childWaiter) waitChild() (int, error) {
+	if w.central != nil {
+		if w.reaped.Swap(true) {
+			return -1, errors.New("libcrun: container already waited for")
+		}
+		<-w.central.done
+		if w.central.err != nil {
+			return -1, w.central.err
+		}
+		w.usage.Store(&w.central.usage)
+		return w.central.code, nil
+	}
+	var usage syscall.Rusage
+	cusage := (*C.struct_rusage)(unsafe.Pointer(&usage))
+	if w.pidfd == nil {
+		var exitCode C.int
+		var werr C.libcrun_error_t
+		rc := C.go_crun_wait(w.pid, &exitCode, cusage, &werr)
+		w.reaped.Store(true)
+		if rc < 0 {
+			return -1, fromLibcrunErr(&werr)
+		}
+		w.usage.Store(&usage)
+		return int(exitCode), nil
+	}
+
+	rawConn, err := w.pidfd.SyscallConn()
+	if err != nil {
+		return -1, err
+	}
+	var exitCode C.int
+	var waitErr error
+	err = rawConn.Read(func(fd uintptr) bool {
+		var werr C.libcrun_error_t
+		rc := C.go_crun_wait_pidfd(C.int(fd), &exitCode, cusage, &werr)
+		if rc < 0 {
+			waitErr = fromLibcrunErr(&werr)
+			return true
+		}
+		// rc == 0: still running, park until the pidfd becomes readable
+		return rc == 1
+	})
+	w.reaped.Store(true)
+	if errors.Is(err, os.ErrClosed) {
+		return -1, errors.New("libcrun: container already waited for")
+	}
+	w.pidfd.Close()
+	if err != nil {
+		return -1, err
+	}
+	if waitErr != nil {
+		return -1, waitErr
+	}
+	w.usage.Store(&usage)
+	return int(exitCode), nil
+}
+
+// kill sends SIGKILL to the processes the child forked, then to the child,
+// unless it was reaped. Through the pidfd the child cannot be mistaken for
+// a reused pid; without pidfds, kill races wait. Its children are
+// signalled by pid, which is only reused once the child reaps them: a
+// window kill accepts.
+func (w *childWaiter) kill() {
+	if w.central != nil {
+		w.central.kill()
+		return
+	}
+	if w.reaped.Load() {
+		return
+	}
+	for _, pid := range childPIDs(int(w.pid)) {
+		_ = syscall.Kill(pid, syscall.SIGKILL)
+	}
+	if w.pidfd == nil {
+		_ = syscall.Kill(int(w.pid), syscall.SIGKILL)
+		return
+	}
+	rawConn, err := w.pidfd.SyscallConn()
+	if err != nil {
+		return
+	}
+	_ = rawConn.Control(func(fd uintptr) {
+		C.go_crun_pidfd_send_signal(C.int(fd), C.int(syscall.SIGKILL))
+	})
+}
+
+// childPIDs returns the children of process pid's main thread, or nil when
+// /proc does not list them.
+func childPIDs(pid int) []int {
+	b, err := os.ReadFile("/proc/" + strconv.Itoa(pid) + "/task/" + strconv.Itoa(pid) + "/children")
+	if err != nil {
+		return nil
+	}
+	var pids []int
+	for _, f := range strings.Fields(string(b)) {
+		if p, err := strconv.Atoi(f); err == nil {
+			pids = append(pids, p)
+		}
+	}
+	return pids
+}
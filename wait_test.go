@@ -0,0 +1,153 @@
+//go:build linux && cgo
+
+package crun
+
+import (
+	"errors"
+	"os"
+	"runtime"
+	"strconv"
+	"strings"
+	"sync"
+	"syscall"
+	"testing"
+	"time"
+)
+
+// startChild starts /bin/sh -c script without letting os/exec reap it.
+func startChild(t *testing.T, script string) int {
+	t.Helper()
+	pid, err := syscall.ForkExec("/bin/sh", []string{"sh", "-c", script}, &syscall.ProcAttr{})
+	if err != nil {
+		t.Skipf("cannot start /bin/sh: %v", err)
+	}
+	return pid
+}
+
+func TestChildWaiterExitCode(t *testing.T) {
+	w := newChildWaiter(startChild(t, "exit 3"))
+	code, err := w.wait()
+	if err != nil {
+		t.Fatalf("wait failed: %v", err)
+	}
+	if code != 3 {
+		t.Errorf("exit code = %d, want 3", code)
+	}
+
+	if _, err := w.wait(); err == nil {
+		t.Error("second wait should fail")
+	}
+}
+
+func TestChildWaiterSignal(t *testing.T) {
+	w := newChildWaiter(startChild(t, "kill -9 $$"))
+	code, err := w.wait()
+	if err != nil {
+		t.Fatalf("wait failed: %v", err)
+	}
+	if code != 128+9 {
+		t.Errorf("exit code = %d, want %d", code, 128+9)
+	}
+}
+
+func TestChildWaiterDoesNotPinThreads(t *testing.T) {
+	const n = 64
+	waiters := make([]*childWaiter, n)
+	for i := range waiters {
+		waiters[i] = newChildWaiter(startChild(t, "sleep 0.5"))
+		if waiters[i].pidfd == nil {
+			t.Skip("pidfds not supported")
+		}
+	}
+
+	var wg sync.WaitGroup
+	for _, w := range waiters {
+		wg.Add(1)
+		go func(w *childWaiter) {
+			defer wg.Done()
+			if _, err := w.wait(); err != nil {
+				t.Errorf("wait failed: %v", err)
+			}
+		}(w)
+	}
+
+	// With netpoller-based waits the goroutines park without holding
+	// threads, so the thread count stays well below the number of waiters
+	time.Sleep(200 * time.Millisecond)
+	threads, _ := runtime.ThreadCreateProfile(nil)
+	wg.Wait()
+	if threads >= n {
+		t.Errorf("%d threads for %d waiters", threads, n)
+	}
+}
+
+func TestChildWaiterKill(t *testing.T) {
+	w := newChildWaiter(startChild(t, "sleep 30 & wait"))
+	w.kill()
+	code, err := w.wait()
+	if err != nil || code != 128+9 {
+		t.Errorf("wait = %d, %v; want %d", code, err, 128+9)
+	}
+	w.kill() // reaped: no-op
+}
+
+func TestChildPIDs(t *testing.T) {
+	w := newChildWaiter(startChild(t, "sleep 30 & wait"))
+	defer w.wait()
+	defer w.kill()
+	if _, err := os.Stat("/proc/self/task/" + strconv.Itoa(os.Getpid()) + "/children"); err != nil {
+		t.Skip("/proc does not list children")
+	}
+	waitFor(t, "the sleep to start", func() bool { return len(childPIDs(int(w.pid))) == 1 })
+}
+
+func TestChildWaiterHandOff(t *testing.T) {
+	r := withTestReaper(t)
+	if _, _, errno := syscall.RawSyscall(syscall.SYS_PRCTL, prSetChildSubreaper, 1, 0); errno != 0 {
+		t.Skipf("prctl(PR_SET_CHILD_SUBREAPER) failed: %v", errno)
+	}
+	t.Cleanup(func() { syscall.RawSyscall(syscall.SYS_PRCTL, prSetChildSubreaper, 0, 0) })
+	r.mu.Lock()
+	r.subreaper = true
+	r.mu.Unlock()
+
+	// The child exits at once, leaving its own child to this process
+	pidFile := t.TempDir() + "/pid"
+	w := newChildWaiter(startChild(t, "(sleep 0.2; exit 7) & echo $! > "+pidFile))
+	w.handOff(func() (int, error) {
+		b, err := os.ReadFile(pidFile)
+		if err != nil {
+			return -1, err
+		}
+		return strconv.Atoi(strings.TrimSpace(string(b)))
+	})
+	code, err := w.wait()
+	if err != nil || code != 7 {
+		t.Fatalf("wait = %d, %v; want the grandchild's 7", code, err)
+	}
+	if w.usage.Load() == nil {
+		t.Error("no resource usage")
+	}
+	if _, err := w.wait(); err == nil {
+		t.Error("second wait succeeded")
+	}
+}
+
+func TestChildWaiterHandOffChildFailed(t *testing.T) {
+	w := newChildWaiter(startChild(t, "exit 3"))
+	w.handOff(func() (int, error) {
+		t.Error("handed off after a failed child")
+		return -1, errors.New("unreachable")
+	})
+	if code, err := w.wait(); err != nil || code != 3 {
+		t.Errorf("wait = %d, %v; want the child's 3", code, err)
+	}
+}
+
+func TestChildWaiterHandOffNextFails(t *testing.T) {
+	w := newChildWaiter(startChild(t, "exit 0"))
+	w.handOff(func() (int, error) { return -1, errors.New("no init") })
+	if _, err := w.wait(); err == nil || err.Error() != "no init" {
+		t.Errorf("wait error = %v, want the handoff's", err)
+	}
+}
@@ -0,0 +1,455 @@
+//go:build linux && cgo
+
+package crun
+
+/*
+#include "go_crun.h"
+*/
+import "C"
+import (
+	"context"
+	"errors"
+	"os"
+	"path/filepath"
+	"sync"
+	"syscall"
+	"time"
+	"unsafe"
+)
+
+// EventType identifies a container lifecycle transition reported by Watch.
+type EventType string
+
+// Lifecycle events reported by Watch.
+const (
+	EventCreated EventType = "created"
+	EventStarted EventType = "started"
+	EventPaused  EventType = "paused"
+	EventResumed EventType = "resumed"
+	EventExited  EventType = "exited"
+	EventDeleted EventType = "deleted"
+)
+
+// Event is one lifecycle transition of a container.
+type Event struct {
+	Type EventType
+	ID   string
+	Pid  int       // the container's init pid, when known
+	Time time.Time // when the transition was observed
+}
+
+// cgroupRoot is where container cgroup paths are resolved (a variable so
+// tests can point it at a fake hierarchy).
+var cgroupRoot = "/sys/fs/cgroup"
+
+const (
+	watchRootMask   = syscall.IN_CREATE | syscall.IN_DELETE | syscall.IN_MOVED_FROM | syscall.IN_MOVED_TO | syscall.IN_ONLYDIR
+	watchDirMask    = syscall.IN_CLOSE_WRITE | syscall.IN_MOVED_TO | syscall.IN_DELETE | syscall.IN_DELETE_SELF | syscall.IN_ONLYDIR
+	watchCgroupMask = syscall.IN_MODIFY
+)
+
+// Watch reports container lifecycle events under the state root until ctx
+// is cancelled, then closes the returned channel.
+//
+// Events are pushed, not polled. inotify on the state root and on each
+// container's state directory reports creation, start and deletion. The
+// pidfd of each container's init process reports its exit. inotify on
+// cgroup.events reports pause and resume (cgroup v2 only). An idle node
+// costs nothing, however many containers it runs.
+//
+// Containers that already exist when Watch is called are tracked from their
+// current state without generating events. Events of one container are
+// delivered in order; a slow reader delays further events but none are lost
+// unless the kernel's inotify queue overflows, in which case the state root
+// is rescanned.
+func (x *RuntimeContext) Watch(ctx context.Context) (<-chan Event, error) {
+	if x == nil || x.c == nil {
+		return nil, errors.New("libcrun: invalid runtime context")
+	}
+	root := C.GoString(x.c.state_root)
+	if root == "" {
+		return nil, errors.New("libcrun: Watch needs a state root")
+	}
+
+	fd, err := syscall.InotifyInit1(syscall.IN_NONBLOCK | syscall.IN_CLOEXEC)
+	if err != nil {
+		return nil, os.NewSyscallError("inotify_init1", err)
+	}
+	rootWd, err := syscall.InotifyAddWatch(fd, root, watchRootMask)
+	if err != nil {
+		syscall.Close(fd)
+		return nil, os.NewSyscallError("inotify_add_watch", err)
+	}
+
+	w := &watcher{
+		x:      x,
+		root:   root,
+		rootWd: int32(rootWd),
+		inoFd:  fd,
+		ino:    os.NewFile(uintptr(fd), "inotify"), // nonblocking: served by the netpoller
+		out:    make(chan Event, 64),
+		inoCh:  make(chan []inotifyEvent),
+		exitCh: make(chan exitNote),
+		done:   make(chan struct{}),
+		ctrs:   make(map[string]*watchedContainer),
+		wds:    make(map[int32]wdTarget),
+	}
+	w.rescan(context.Background(), true) // quiet: nothing is emitted
+
+	w.wg.Add(1)
+	go w.readInotify()
+	go w.loop(ctx)
+	return w.out, nil
+}
+
+type watcher struct {
+	x      *RuntimeContext
+	root   string
+	rootWd int32
+	inoFd  int
+	ino    *os.File
+
+	out    chan Event
+	inoCh  chan []inotifyEvent
+	exitCh chan exitNote
+	done   chan struct{} // closed when the loop stops
+	wg     sync.WaitGroup
+
+	// Owned by the loop goroutine
+	ctrs map[string]*watchedContainer
+	wds  map[int32]wdTarget
+}
+
+type watchedContainer struct {
+	id          string
+	dirWd, cgWd int32 // -1 when not watched
+	pid         int
+	pidfd       *os.File
+	created     bool
+	started     bool
+	paused      bool
+	exited      bool
+}
+
+// wdTarget is what an inotify watch descriptor refers to.
+type wdTarget struct {
+	id     string
+	cgroup bool
+}
+
+type inotifyEvent struct {
+	wd   int32
+	mask uint32
+	name string
+}
+
+type exitNote struct {
+	id    string
+	pidfd *os.File
+}
+
+func (w *watcher) loop(ctx context.Context) {
+	defer w.shutdown()
+	for {
+		select {
+		case <-ctx.Done():
+			return
+		case evs, ok := <-w.inoCh:
+			if !ok {
+				return
+			}
+			for _, ev := range evs {
+				if !w.handle(ctx, ev) {
+					return
+				}
+			}
+		case n := <-w.exitCh:
+			if c := w.ctrs[n.id]; c != nil && c.pidfd == n.pidfd {
+				if !w.exit(ctx, c) {
+					return
+				}
+			}
+		}
+	}
+}
+
+func (w *watcher) shutdown() {
+	close(w.done)
+	w.ino.Close()
+	for _, c := range w.ctrs {
+		if c.pidfd != nil {
+			c.pidfd.Close()
+		}
+	}
+	w.wg.Wait()
+	close(w.out)
+}
+
+// emit delivers ev, returning false once the watch is cancelled.
+func (w *watcher) emit(ctx context.Context, typ EventType, c *watchedContainer) bool {
+	select {
+	case w.out <- Event{Type: typ, ID: c.id, Pid: c.pid, Time: time.Now()}:
+		return true
+	case <-ctx.Done():
+		return false
+	}
+}
+
+// readInotify forwards batches of inotify events to the loop.
+func (w *watcher) readInotify() {
+	defer w.wg.Done()
+	defer close(w.inoCh)
+	buf := make([]byte, 64*1024)
+	for {
+		n, err := w.ino.Read(buf)
+		if err != nil {
+			return
+		}
+		var evs []inotifyEvent
+		for off := 0; off+syscall.SizeofInotifyEvent <= n; {
+			raw := (*syscall.InotifyEvent)(unsafe.Pointer(&buf[off]))
+			ev := inotifyEvent{wd: raw.Wd, mask: raw.Mask}
+			if raw.Len > 0 {
+				name := buf[off+syscall.SizeofInotifyEvent : off+syscall.SizeofInotifyEvent+int(raw.Len)]
+				for i, b := range name {
+					if b == 0 {
+						name = name[:i]
+						break
+					}
+				}
+				ev.name = string(name)
+			}
+			evs = append(evs, ev)
+			off += syscall.SizeofInotifyEvent + int(raw.Len)
+		}
+		select {
+		case w.inoCh <- evs:
+		case <-w.done:
+			return
+		}
+	}
+}
+
+// handle applies one inotify event, returning false once cancelled.
+func (w *watcher) handle(ctx context.Context, ev inotifyEvent) bool {
+	if ev.mask&syscall.IN_Q_OVERFLOW != 0 {
+		return w.rescan(ctx, false)
+	}
+	if ev.wd == w.rootWd {
+		isDir := ev.mask&syscall.IN_ISDIR != 0
+		switch {
+		case isDir && ev.mask&(syscall.IN_CREATE|syscall.IN_MOVED_TO) != 0:
+			return w.track(ctx, ev.name, false)
+		case isDir && ev.mask&(syscall.IN_DELETE|syscall.IN_MOVED_FROM) != 0:
+			return w.untrack(ctx, ev.name)
+		}
+		return true
+	}
+
+	t, ok := w.wds[ev.wd]
+	if !ok {
+		return true
+	}
+	if ev.mask&syscall.IN_IGNORED != 0 {
+		// The kernel dropped the watch (directory or cgroup removed)
+		delete(w.wds, ev.wd)
+		if c := w.ctrs[t.id]; c != nil {
+			if t.cgroup {
+				c.cgWd = -1
+			} else {
+				c.dirWd = -1
+			}
+		}
+		return true
+	}
+	if t.cgroup {
+		return w.refresh(ctx, t.id, false)
+	}
+	switch {
+	case ev.mask&syscall.IN_DELETE_SELF != 0:
+		return w.untrack(ctx, t.id)
+	case ev.name == "status" && ev.mask&(syscall.IN_CLOSE_WRITE|syscall.IN_MOVED_TO) != 0,
+		ev.name == "exec.fifo" && ev.mask&syscall.IN_DELETE != 0:
+		return w.refresh(ctx, t.id, false)
+	}
+	return true
+}
+
+// rescan syncs the tracked set with the state root: new containers are
+// tracked, vanished ones reported deleted, and all states refreshed.
+func (w *watcher) rescan(ctx context.Context, quiet bool) bool {
+	entries, err := os.ReadDir(w.root)
+	if err != nil {
+		return true
+	}
+	present := make(map[string]bool, len(entries))
+	for _, e := range entries {
+		if !e.IsDir() {
+			continue
+		}
+		present[e.Name()] = true
+		if _, ok := w.ctrs[e.Name()]; ok {
+			if !w.refresh(ctx, e.Name(), quiet) {
+				return false
+			}
+		} else if !w.track(ctx, e.Name(), quiet) {
+			return false
+		}
+	}
+	for id := range w.ctrs {
+		if !present[id] && !w.untrack(ctx, id) {
+			return false
+		}
+	}
+	return true
+}
+
+// track starts watching the state directory of id.
+func (w *watcher) track(ctx context.Context, id string, quiet bool) bool {
+	if _, ok := w.ctrs[id]; ok || id == "" {
+		return true
+	}
+	wd, err := syscall.InotifyAddWatch(w.inoFd, filepath.Join(w.root, id), watchDirMask)
+	if err != nil {
+		return true // already gone
+	}
+	c := &watchedContainer{id: id, dirWd: int32(wd), cgWd: -1}
+	w.ctrs[id] = c
+	w.wds[c.dirWd] = wdTarget{id: id}
+	// The status file may have been written before the watch was added
+	return w.refresh(ctx, id, quiet)
+}
+
+// untrack reports id deleted and releases its resources.
+func (w *watcher) untrack(ctx context.Context, id string) bool {
+	c := w.ctrs[id]
+	if c == nil {
+		return true
+	}
+	delete(w.ctrs, id)
+	for _, wd := range []int32{c.dirWd, c.cgWd} {
+		if wd >= 0 {
+			delete(w.wds, wd)
+			_, _ = syscall.InotifyRmWatch(w.inoFd, uint32(wd))
+		}
+	}
+	if c.pidfd != nil {
+		// Report an exit that raced with the deletion first
+		if exited := pidfdExited(c.pidfd); exited && !c.exited {
+			c.exited = true
+			if !w.emit(ctx, EventExited, c) {
+				return false
+			}
+		}
+		c.pidfd.Close()
+		c.pidfd = nil
+	}
+	if !c.created {
+		return true
+	}
+	return w.emit(ctx, EventDeleted, c)
+}
+
+// exit reports that the init process of c exited.
+func (w *watcher) exit(ctx context.Context, c *watchedContainer) bool {
+	if c.pidfd != nil {
+		c.pidfd.Close()
+		c.pidfd = nil
+	}
+	if c.exited {
+		return true
+	}
+	c.exited = true
+	return w.emit(ctx, EventExited, c)
+}
+
+// refresh re-reads the state of id and reports the transitions since the
+// last observation. quiet records the state without reporting it.
+func (w *watcher) refresh(ctx context.Context, id string, quiet bool) bool {
+	c := w.ctrs[id]
+	if c == nil {
+		return true
+	}
+	var st ContainerState
+	var cgroup string
+	if err := w.x.readState(id, nil, false, &st, &cgroup); err != nil {
+		return true // status not written yet, or being deleted
+	}
+	emit := func(typ EventType) bool { return quiet || w.emit(ctx, typ, c) }
+
+	if !c.created {
+		c.created = true
+		c.pid = st.Pid
+		if st.Pid > 0 {
+			if fd := int(C.go_crun_pidfd_open(C.pid_t(st.Pid))); fd >= 0 && syscall.SetNonblock(fd, true) == nil {
+				c.pidfd = os.NewFile(uintptr(fd), "pidfd")
+				w.wg.Add(1)
+				go w.awaitExit(id, c.pidfd)
+			} else if fd >= 0 {
+				syscall.Close(fd)
+			}
+		}
+		if cgroup != "" {
+			events := filepath.Join(cgroupRoot, cgroup, "cgroup.events")
+			if wd, err := syscall.InotifyAddWatch(w.inoFd, events, watchCgroupMask); err == nil {
+				c.cgWd = int32(wd)
+				w.wds[c.cgWd] = wdTarget{id: id, cgroup: true}
+			}
+		}
+		if !emit(EventCreated) {
+			return false
+		}
+	}
+	if !c.started && (st.Status == StatusRunning || st.Status == StatusPaused) {
+		c.started = true
+		if !emit(EventStarted) {
+			return false
+		}
+	}
+	if paused := st.Status == StatusPaused; paused != c.paused {
+		c.paused = paused
+		typ := EventResumed
+		if paused {
+			typ = EventPaused
+		}
+		if !emit(typ) {
+			return false
+		}
+	}
+	// Without a pidfd the status file is the only exit signal
+	if st.Status == StatusStopped && c.pidfd == nil && !c.exited {
+		c.exited = true
+		if !emit(EventExited) {
+			return false
+		}
+	}
+	return true
+}
+
+// awaitExit parks on the pidfd until the process exits, then notifies the
+// loop. Closing the pidfd stops it.
+func (w *watcher) awaitExit(id string, pidfd *os.File) {
+	defer w.wg.Done()
+	rc, err := pidfd.SyscallConn()
+	if err != nil {
+		return
+	}
+	err = rc.Read(func(fd uintptr) bool {
+		return C.go_crun_pidfd_exited(C.int(fd)) == 1
+	})
+	if err != nil {
+		return // closed by the loop
+	}
+	select {
+	case w.exitCh <- exitNote{id: id, pidfd: pidfd}:
+	case <-w.done:
+	}
+}
+
+func pidfdExited(f *os.File) bool {
+	exited := false
+	if rc, err := f.SyscallConn(); err == nil {
+		_ = rc.Control(func(fd uintptr) { exited = C.go_crun_pidfd_exited(C.int(fd)) == 1 })
+	}
+	return exited
+}
@@ -0,0 +1,136 @@
+//go:build linux
+
+package crun
+
+import (
+	"context"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strconv"
+	"testing"
+	"time"
+	"unsafe"
+)
+
+// writeFakeStatus writes a libcrun status file for id with the given pid,
+// the way libcrun does (temporary file renamed over status).
+func writeFakeStatus(t *testing.T, root, id string, pid int) {
+	t.Helper()
+	status := `{"pid":` + strconv.Itoa(pid) + `,"process-start-time":0,"cgroup-path":"","scope":"",` +
+		`"rootfs":"/rootfs","systemd-cgroup":false,"bundle":"/bundle","created":"2024-05-06T07:08:09Z",` +
+		`"detached":true,"external_descriptors":"[]"}`
+	dir := filepath.Join(root, id)
+	if err := os.WriteFile(filepath.Join(dir, "status.tmp"), []byte(status), 0o600); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+	if err := os.Rename(filepath.Join(dir, "status.tmp"), filepath.Join(dir, "status")); err != nil {
+		t.Fatalf("Rename failed: %v", err)
+	}
+}
+
+func nextEvent(t *testing.T, ch <-chan Event) Event {
+	t.Helper()
+	select {
+	case ev, ok := <-ch:
+		if !ok {
+			t.Fatal("event channel closed")
+		}
+		return ev
+	case <-time.After(5 * time.Second):
+		t.Fatal("timed out waiting for an event")
+	}
+	return Event{}
+}
+
+func TestWatchLifecycle(t *testing.T) {
+	root := t.TempDir()
+	rc, err := NewRuntimeContext(RuntimeConfig{StateRoot: root})
+	if err != nil {
+		t.Fatalf("NewRuntimeContext failed: %v", err)
+	}
+	defer rc.Close()
+
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+	events, err := rc.Watch(ctx)
+	if err != nil {
+		t.Fatalf("Watch failed: %v", err)
+	}
+
+	// A process standing in for the container's init
+	init := exec.Command("sleep", "60")
+	if err := init.Start(); err != nil {
+		t.Fatalf("Start failed: %v", err)
+	}
+	defer init.Process.Kill()
+	pid := init.Process.Pid
+
+	// Create: state directory with the exec fifo, then the status file
+	dir := filepath.Join(root, "c1")
+	if err := os.Mkdir(dir, 0o700); err != nil {
+		t.Fatalf("Mkdir failed: %v", err)
+	}
+	if err := os.WriteFile(filepath.Join(dir, "exec.fifo"), nil, 0o600); err != nil {
+		t.Fatalf("WriteFile failed: %v", err)
+	}
+	writeFakeStatus(t, root, "c1", pid)
+	if ev := nextEvent(t, events); ev.Type != EventCreated || ev.ID != "c1" || ev.Pid != pid {
+		t.Fatalf("got %+v, want created c1 with pid %d", ev, pid)
+	}
+
+	// Start: libcrun removes the exec fifo
+	if err := os.Remove(filepath.Join(dir, "exec.fifo")); err != nil {
+		t.Fatalf("Remove failed: %v", err)
+	}
+	if ev := nextEvent(t, events); ev.Type != EventStarted || ev.ID != "c1" {
+		t.Fatalf("got %+v, want started c1", ev)
+	}
+
+	// Exit: reported through the init's pidfd
+	init.Process.Kill()
+	_, _ = init.Process.Wait()
+	if ev := nextEvent(t, events); ev.Type != EventExited || ev.ID != "c1" {
+		t.Fatalf("got %+v, want exited c1", ev)
+	}
+
+	// Delete
+	if err := os.RemoveAll(dir); err != nil {
+		t.Fatalf("RemoveAll failed: %v", err)
+	}
+	if ev := nextEvent(t, events); ev.Type != EventDeleted || ev.ID != "c1" {
+		t.Fatalf("got %+v, want deleted c1", ev)
+	}
+
+	cancel()
+	for range events {
+	}
+}
+
+func TestWatchExistingContainersAreQuiet(t *testing.T) {
+	rc := fakeStateRoot(t, "old")
+	ctx, cancel := context.WithCancel(context.Background())
+	events, err := rc.Watch(ctx)
+	if err != nil {
+		t.Fatalf("Watch failed: %v", err)
+	}
+
+	// Only the deletion of the pre-existing container is reported
+	root := goStringAt(unsafe.Pointer(rc.c.state_root))
+	if err := os.RemoveAll(filepath.Join(root, "old")); err != nil {
+		t.Fatalf("RemoveAll failed: %v", err)
+	}
+	if ev := nextEvent(t, events); ev.Type != EventDeleted || ev.ID != "old" {
+		t.Fatalf("got %+v, want deleted old", ev)
+	}
+
+	cancel()
+	select {
+	case _, ok := <-events:
+		if ok {
+			t.Error("no more events expected after cancel")
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("channel not closed after cancel")
+	}
+}